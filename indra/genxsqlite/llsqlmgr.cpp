@@ -1,17 +1,254 @@
+#include "linden_common.h"
 #include "llsqlmgr.h"
 #include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include "llthread.h"
 #include "sqlite3.h"
 
+//
+// LLSqlMgr::DBThread
+//
+// Owns every statement run through queueWrite()/queueRead(). Prepared
+// statements are cached per db handle and SQL text for the lifetime of the
+// thread, and the writes found in the queue at each wake-up are committed
+// in a single transaction, so the main thread never waits on fsync.
+//
+class LLSqlMgr::DBThread : public LLThread
+{
+public:
+	struct Request
+	{
+		sqlite3* mHandle;
+		std::string mSQL;								// empty for a flush() barrier
+		LLSD mBinds;
+		std::unique_ptr<std::promise<rows_t> > mResult;	// NULL for writes
+	};
+
+	DBThread() : LLThread("SQLite DB") { }
+
+	void push(Request&& request);
+
+protected:
+	/*virtual*/ bool runCondition() { return !mQueue.empty(); }	// called with the run condition locked
+	/*virtual*/ void run();
+
+private:
+	void processBatch(std::deque<Request>& batch);
+	sqlite3_stmt* getStatement(sqlite3* handle, const std::string& sql);
+	static void bind(sqlite3_stmt* stmt, const LLSD& binds);
+	void finalizeStatements();
+
+	std::deque<Request> mQueue;		// protected by lockData()/unlockData()
+
+	typedef std::map<std::pair<sqlite3*, std::string>, sqlite3_stmt*> statement_cache_t;
+	statement_cache_t mStatements;	// DB thread only
+};
+
+void LLSqlMgr::DBThread::push(Request&& request)
+{
+	lockData();
+	mQueue.push_back(std::move(request));
+	unlockData();
+	wake();
+}
+
+void LLSqlMgr::DBThread::run()
+{
+	while (1)
+	{
+		// Sleeps until something is queued or we are asked to quit.
+		checkPause();
+
+		std::deque<Request> batch;
+		lockData();
+		batch.swap(mQueue);
+		unlockData();
+
+		if (batch.empty())
+		{
+			// Only leave once the queue is drained, so nothing is lost on shutdown.
+			if (isQuitting())
+			{
+				break;
+			}
+			continue;
+		}
+		processBatch(batch);
+	}
+	finalizeStatements();
+	LL_INFOS() << "SQLite DB thread EXITING." << LL_ENDL;
+}
+
+void LLSqlMgr::DBThread::processBatch(std::deque<Request>& batch)
+{
+	std::vector<sqlite3*> transactions;
+	std::vector<std::pair<std::promise<rows_t>*, rows_t> > results;
+
+	for (Request& request : batch)
+	{
+		if (request.mSQL.empty() || !request.mHandle)
+		{
+			if (request.mResult)
+			{
+				results.push_back(std::make_pair(request.mResult.get(), rows_t()));
+			}
+			continue;
+		}
+
+		if (!request.mResult && std::find(transactions.begin(), transactions.end(), request.mHandle) == transactions.end())
+		{
+			sqlite3_exec(request.mHandle, "BEGIN", NULL, NULL, NULL);
+			transactions.push_back(request.mHandle);
+		}
+
+		sqlite3_stmt* stmt = getStatement(request.mHandle, request.mSQL);
+		if (!stmt)
+		{
+			if (request.mResult)
+			{
+				results.push_back(std::make_pair(request.mResult.get(), rows_t()));
+			}
+			continue;
+		}
+		bind(stmt, request.mBinds);
+
+		rows_t rows;
+		int rc;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		{
+			if (!request.mResult)
+			{
+				continue;
+			}
+			LLSD row = LLSD::emptyArray();
+			for (int col = 0, count = sqlite3_column_count(stmt); col < count; ++col)
+			{
+				switch (sqlite3_column_type(stmt, col))
+				{
+					case SQLITE_INTEGER:
+						row.append((LLSD::Integer)sqlite3_column_int(stmt, col));
+						break;
+					case SQLITE_FLOAT:
+						row.append((LLSD::Real)sqlite3_column_double(stmt, col));
+						break;
+					case SQLITE_NULL:
+						row.append(LLSD());
+						break;
+					default:
+						row.append(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, col))));
+						break;
+				}
+			}
+			rows.push_back(row);
+		}
+		if (rc != SQLITE_DONE)
+		{
+			LL_WARNS() << "SQLite error " << rc << " running \"" << request.mSQL << "\": " << sqlite3_errmsg(request.mHandle) << LL_ENDL;
+		}
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+
+		if (request.mResult)
+		{
+			results.push_back(std::make_pair(request.mResult.get(), std::move(rows)));
+		}
+	}
+
+	for (sqlite3* handle : transactions)
+	{
+		if (sqlite3_exec(handle, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+		{
+			LL_WARNS() << "SQLite commit failed: " << sqlite3_errmsg(handle) << LL_ENDL;
+			sqlite3_exec(handle, "ROLLBACK", NULL, NULL, NULL);
+		}
+	}
+
+	// Readers and flush() waiters are only released once the batch is on disk.
+	for (auto& result : results)
+	{
+		result.first->set_value(std::move(result.second));
+	}
+}
+
+sqlite3_stmt* LLSqlMgr::DBThread::getStatement(sqlite3* handle, const std::string& sql)
+{
+	sqlite3_stmt*& stmt = mStatements[std::make_pair(handle, sql)];
+	if (!stmt && sqlite3_prepare_v2(handle, sql.c_str(), sql.size(), &stmt, NULL) != SQLITE_OK)
+	{
+		LL_WARNS() << "Cannot prepare \"" << sql << "\": " << sqlite3_errmsg(handle) << LL_ENDL;
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+	}
+	return stmt;
+}
 
-LLSqlMgr::LLSqlMgr() 
+//static
+void LLSqlMgr::DBThread::bind(sqlite3_stmt* stmt, const LLSD& binds)
 {
-	
+	int index = 1;
+	for (LLSD::array_const_iterator it = binds.beginArray(); it != binds.endArray(); ++it, ++index)
+	{
+		switch (it->type())
+		{
+			case LLSD::TypeBoolean:
+			case LLSD::TypeInteger:
+				sqlite3_bind_int(stmt, index, it->asInteger());
+				break;
+			case LLSD::TypeReal:
+				sqlite3_bind_double(stmt, index, it->asReal());
+				break;
+			case LLSD::TypeUndefined:
+				sqlite3_bind_null(stmt, index);
+				break;
+			default:
+			{
+				const std::string value = it->asString();
+				sqlite3_bind_text(stmt, index, value.c_str(), value.size(), SQLITE_TRANSIENT);
+				break;
+			}
+		}
+	}
+}
+
+void LLSqlMgr::DBThread::finalizeStatements()
+{
+	for (auto& statement : mStatements)
+	{
+		sqlite3_finalize(statement.second);
+	}
+	mStatements.clear();
+}
+
+//
+// LLSqlMgr
+//
+
+LLSqlMgr::LLSqlMgr()
+{
+
 }
 LLSqlMgr::~LLSqlMgr()
 {
-	
+	close();
+}
+
+static void set_journal_mode(sqlite3* handle)
+{
+	// With WAL and synchronous=NORMAL, a commit no longer waits for an fsync.
+	sqlite3_exec(handle, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+	sqlite3_exec(handle, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
 }
 
+void LLSqlMgr::startThread()
+{
+	if (!mThread)
+	{
+		mThread = new DBThread;
+		mThread->start();
+	}
+}
 
 char LLSqlMgr::initALLAgentsDB(std::string db_path) {
    LL_INFOS() << "Init Genesis DB :" << db_path << LL_ENDL;
@@ -23,8 +260,9 @@ char LLSqlMgr::initALLAgentsDB(std::string db_path) {
    if( rc ) {
     return rc;
    }
+   set_journal_mode(commondb);
+
 
-    
     //Colors from skin that can be updated
     sql = "CREATE TABLE IF NOT EXISTS COLOR_SETTINGS(" \
         "ID TEXT PRIMARY KEY     NOT NULL," \
@@ -32,13 +270,13 @@ char LLSqlMgr::initALLAgentsDB(std::string db_path) {
         "G               REAL    NOT NULL," \
         "B               REAL    NOT NULL," \
         "A               REAL    NOT NULL);";
-    rc = sqlite3_exec (commondb, sql, NULL, NULL, &zErrMsg);  
+    rc = sqlite3_exec (commondb, sql, NULL, NULL, &zErrMsg);
     if( rc ) {
         LL_WARNS() << "Can't initialise Genesis COLOR_SETTINGS table " << zErrMsg << LL_ENDL;
         return rc;
     }
-   
-    
+    startThread();
+    return SQLITE_OK;
 }
 char LLSqlMgr::initAgentDB(std::string db_path) {
    LL_INFOS() << "Init Genesis DB :" << db_path << LL_ENDL;
@@ -50,6 +288,7 @@ char LLSqlMgr::initAgentDB(std::string db_path) {
    if( rc ) {
     return rc;
    }
+   set_journal_mode(db);
 
     /* Create table contacts set */
    sql = "CREATE TABLE IF NOT EXISTS CONTACTS_SET("  \
@@ -59,7 +298,7 @@ char LLSqlMgr::initAgentDB(std::string db_path) {
       "G               REAL    NOT NULL," \
       "B               REAL    NOT NULL," \
       "A               REAL    NOT NULL);";
-    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);  
+    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);
     if( rc ) {
         LL_WARNS() << "Can't initialise Genesis Contacts set table " << zErrMsg << LL_ENDL;
         return rc;
@@ -68,13 +307,13 @@ char LLSqlMgr::initAgentDB(std::string db_path) {
     rc = sqlite3_exec(db, "INSERT INTO CONTACTS_SET VALUES( 'Contact set 1',NULL,1.0,0.0,0.0,1.0)", NULL, NULL, &zErrMsg);
     rc = sqlite3_exec(db, "INSERT INTO CONTACTS_SET VALUES( 'Contact set 2',NULL,0.0,1.0,0.0,1.0)", NULL, NULL, &zErrMsg);
     rc = sqlite3_exec(db, "INSERT INTO CONTACTS_SET VALUES( 'Contact set 3',NULL,0.0,0.0,1.0,1.0)", NULL, NULL, &zErrMsg);
-    
+
    /* Create SQL statement */
    sql = "CREATE TABLE IF NOT EXISTS CONTACT_SET_AVATARS("  \
       "CONTACT_SET_ID  TEXT NOT NULL," \
       "AVATAR_NAME     TEXT NOT NULL," \
       "AVATAR_ID       TEXT PRIMARY KEY     NOT NULL);";
-    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);  
+    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);
     if( rc ) {
         LL_WARNS() << "Can't initialise Genesis Tagged avatars table " << zErrMsg << LL_ENDL;
         return rc;
@@ -84,11 +323,11 @@ char LLSqlMgr::initAgentDB(std::string db_path) {
     sql = "CREATE TABLE IF NOT EXISTS FAV_BAR_ORDER(" \
         "FAV_UUID TEXT NOT NULL," \
         "FAV_ORDER INTEGER);";
-    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);  
+    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);
     if( rc ) {
         LL_WARNS() << "Can't initialise Genesis fav bar order table " << zErrMsg << LL_ENDL;
         return rc;
-    }    
+    }
 
     //Colors from skin that can be updated
     sql = "CREATE TABLE IF NOT EXISTS COLOR_SETTINGS(" \
@@ -97,27 +336,69 @@ char LLSqlMgr::initAgentDB(std::string db_path) {
         "G               REAL    NOT NULL," \
         "B               REAL    NOT NULL," \
         "A               REAL    NOT NULL);";
-    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);  
+    rc = sqlite3_exec (db, sql, NULL, NULL, &zErrMsg);
     if( rc ) {
         LL_WARNS() << "Can't initialise Genesis COLOR_SETTINGS table " << zErrMsg << LL_ENDL;
         return rc;
     }
     ready = TRUE;
-    
+    startThread();
+    return SQLITE_OK;
 }
 void LLSqlMgr::close() {
 
-   char *zErrMsg = 0;
-   int rc;
+   if (mThread) {
+      // The thread drains its queue before exiting.
+      mThread->shutdown();
+      delete mThread;
+      mThread = NULL;
+   }
 
    sqlite3_close(db);
    sqlite3_close(commondb);
+   db = NULL;
+   commondb = NULL;
+   ready = FALSE;
+}
+
+void LLSqlMgr::queueWrite(EDatabase which, const std::string& sql, const LLSD& binds)
+{
+	sqlite3* handle = which == AGENT_DB ? db : commondb;
+	if (!handle)
+	{
+		LL_WARNS() << "Dropping write to unopened DB: " << sql << LL_ENDL;
+		return;
+	}
+	startThread();
+	DBThread::Request request;
+	request.mHandle = handle;
+	request.mSQL = sql;
+	request.mBinds = binds;
+	mThread->push(std::move(request));
 }
 
-sqlite3 *LLSqlMgr::getDB() {
-    return db;
+LLSqlMgr::rows_future_t LLSqlMgr::queueRead(EDatabase which, const std::string& sql, const LLSD& binds)
+{
+	DBThread::Request request;
+	request.mHandle = which == AGENT_DB ? db : commondb;
+	request.mSQL = sql;
+	request.mBinds = binds;
+	request.mResult.reset(new std::promise<rows_t>);
+	rows_future_t result = request.mResult->get_future();
+	startThread();
+	mThread->push(std::move(request));
+	return result;
 }
 
-sqlite3 *LLSqlMgr::getAllAgentsDB() {
-    return commondb;
+void LLSqlMgr::flush()
+{
+	if (mThread)
+	{
+		DBThread::Request barrier;
+		barrier.mHandle = NULL;
+		barrier.mResult.reset(new std::promise<rows_t>);
+		rows_future_t done = barrier.mResult->get_future();
+		mThread->push(std::move(barrier));
+		done.wait();
+	}
 }
@@ -1,6 +1,7 @@
-
 #include <stdio.h>
+#include <future>
 #include "llsingleton.h"
+#include "llsd.h"
 #include "sqlite3.h"
 
 #ifndef LLSQLMGR_H
@@ -12,19 +13,46 @@ public:
 	LLSqlMgr();
 	~LLSqlMgr();
 
+    enum EDatabase
+    {
+        AGENT_DB = 0,       // db for the connected agent
+        ALL_AGENTS_DB,      // db shared by all agents
+        DB_COUNT
+    };
+
+    // One LLSD array per result row; columns map to Integer, Real, String or undefined (NULL).
+    typedef std::vector<LLSD> rows_t;
+    typedef std::future<rows_t> rows_future_t;
+
     // viewer auth version
 	char initAgentDB(std::string db_path);
     char initALLAgentsDB(std::string db_path);
-    sqlite3 *getDB();
-    sqlite3 *getAllAgentsDB();
+    // Commits all pending writes, stops the DB thread and closes both dbs.
     void close();
     bool isInit() {return ready;}
+
+    // Queues a write for the DB thread and returns immediately. 'binds' is
+    // an LLSD array of the statement parameters (undefined binds NULL).
+    // All writes pending when the DB thread wakes up are committed in one
+    // transaction.
+    void queueWrite(EDatabase which, const std::string& sql, const LLSD& binds = LLSD());
+    // Queues a query for the DB thread. It runs after every write queued
+    // before it, so it always sees them.
+    rows_future_t queueRead(EDatabase which, const std::string& sql, const LLSD& binds = LLSD());
+    // Blocks until every write queued so far has been committed.
+    void flush();
+
 private:
+    void startThread();
+
+    class DBThread;
+    DBThread* mThread = NULL;
+
     //db for a connected agent
-    sqlite3 *db;
+    sqlite3 *db = NULL;
     //db for all agents
-    sqlite3 *commondb;
-    
+    sqlite3 *commondb = NULL;
+
     bool ready = FALSE;
 };
 
@@ -41,13 +41,18 @@
 #include "llendianswizzle.h"
 #include "llassetstorage.h"
 #include "llrefcount.h"
+#include "llthread.h"
 
 #include "llvorbisencode.h"
 
 #include "vorbis/codec.h"
 #include "vorbis/vorbisfile.h"
+#include <atomic>
 #include <iterator>
 #include <deque>
+#include <list>
+#include <set>
+#include <thread>
 
 extern LLAudioEngine *gAudiop;
 
@@ -59,7 +64,9 @@ static const S32 WAV_HEADER_SIZE = 44;
 //////////////////////////////////////////////////////////////////////////////
 
 
-class LLVorbisDecodeState : public LLRefCount
+// Decoded on an LLAudioDecodeMgr worker (initDecode/decodeSection), then
+// finished on the main thread (finishDecode), so it must be thread-safe refcounted.
+class LLVorbisDecodeState : public LLThreadSafeRefCount
 {
 public:
 	class WriteResponder : public LLLFSThread::Responder
@@ -74,7 +81,7 @@ public:
 		LLPointer<LLVorbisDecodeState> mDecoder;
 	};
 	
-	LLVorbisDecodeState(const LLUUID &uuid, const std::string &out_filename);
+	LLVorbisDecodeState(const LLUUID &uuid, const std::string &out_filename, bool allow_large_sounds);
 
 	BOOL initDecode();
 	BOOL decodeSection(); // Return TRUE if done.
@@ -87,6 +94,9 @@ public:
 	BOOL isDone() const					{ return mDone; }
 	const LLUUID &getUUID() const		{ return mUUID; }
 
+	// Link in LLAudioDecodeMgr::Impl's completion list.
+	LLVorbisDecodeState* mNextCompleted;
+
 protected:
 	virtual ~LLVorbisDecodeState();
 
@@ -104,6 +114,7 @@ protected:
 	LLVFile *mInFilep;
 	OggVorbis_File mVF;
 	S32 mCurrentSection;
+	bool mAllowLargeSounds;
 };
 
 size_t vfs_read(void *ptr, size_t size, size_t nmemb, void *datasource)
@@ -170,12 +181,12 @@ long vfs_tell (void *datasource)
 	return file->tell();
 }
 
-LLVorbisDecodeState::LLVorbisDecodeState(const LLUUID &uuid, const std::string &out_filename) :
-	mValid(FALSE), mDone(FALSE), mBytesRead(-1), mUUID(uuid),
+LLVorbisDecodeState::LLVorbisDecodeState(const LLUUID &uuid, const std::string &out_filename, bool allow_large_sounds) :
+	mNextCompleted(NULL), mValid(FALSE), mDone(FALSE), mBytesRead(-1), mUUID(uuid),
 #if !defined(USE_WAV_VFILE)
 	mOutFilename(out_filename), mFileHandle(LLLFSThread::nullHandle()),
 #endif
-	mInFilep(NULL), mCurrentSection(0)
+	mInFilep(NULL), mCurrentSection(0), mAllowLargeSounds(allow_large_sounds)
 {
 }
 
@@ -245,7 +256,7 @@ BOOL LLVorbisDecodeState::initDecode()
 		LL_WARNS() << "Bad sound caught by zmagic" << LL_ENDL;
 		abort_decode = true;
 	}
-	else if(!gAudiop->getAllowLargeSounds())
+	else if(!mAllowLargeSounds)
 	{
 	// </edit> 
 	//Much more restrictive than zmagic. Perhaps make toggleable.
@@ -571,142 +582,270 @@ class LLAudioDecodeMgr::Impl
 {
 	friend class LLAudioDecodeMgr;
 public:
-	Impl() {};
-	~Impl() {};
+	Impl(U32 num_workers);
+	~Impl();
 
 	void processQueue(const F32 num_secs = 0.005);
 
 protected:
+	class Worker;
+	friend class Worker;
+
+	// WORKER THREAD: push a decoded state on the completion list.
+	void pushCompleted(LLVorbisDecodeState* decodep);
+	// MAIN THREAD: move the completion list to mFinishing, in completion order.
+	void popCompleted();
+	// MAIN THREAD: returns true once decodep needs no more attention.
+	bool finishDecode(LLVorbisDecodeState* decodep);
+
 	std::deque<LLUUID> mDecodeQueue;
-	LLPointer<LLVorbisDecodeState> mCurrentDecodep;
-};
+	std::set<LLUUID> mInFlight;		// queued to, or decoded by, the workers
+	std::list<LLPointer<LLVorbisDecodeState> > mFinishing;
 
+	// Decodes waiting for a worker, protected by mWorkCondition.
+	LLCondition mWorkCondition;
+	std::deque<LLPointer<LLVorbisDecodeState> > mPending;
+	std::vector<Worker*> mWorkers;
 
-void LLAudioDecodeMgr::Impl::processQueue(const F32 num_secs)
+	// Lock-free LIFO of decodes done by the workers, each holding a reference.
+	std::atomic<LLVorbisDecodeState*> mCompleted;
+};
+
+class LLAudioDecodeMgr::Impl::Worker : public LLThread
 {
-	LLUUID uuid;
+public:
+	Worker(Impl* owner, U32 index)
+		: LLThread(llformat("audiodecode %u", index)), mOwner(owner)
+	{
+	}
 
-	LLTimer decode_timer;
+protected:
+	/*virtual*/ void run();
 
-	BOOL done = FALSE;
-	while (!done)
+private:
+	Impl* mOwner;
+};
+
+void LLAudioDecodeMgr::Impl::Worker::run()
+{
+	while (1)
 	{
-		if (mCurrentDecodep)
+		LLPointer<LLVorbisDecodeState> decodep;
+		mOwner->mWorkCondition.lock();
+		while (!isQuitting() && mOwner->mPending.empty())
 		{
-			// <edit> rawrning
-			//BOOL res;
-			BOOL res = false;
-			// </edit>
-
-			// Decode in a loop until we're done or have run out of time.
-			/* <edit> */ try{ /* </edit> */
-			while(!(res = mCurrentDecodep->decodeSection()) && (decode_timer.getElapsedTimeF32() < num_secs))
-			{
-				// decodeSection does all of the work above
-			}
-			/* <edit> */ }catch(std::bad_alloc){LL_ERRS() << "bad_alloc whilst decoding" << LL_ENDL;} /* </edit> */
+			mOwner->mWorkCondition.wait();
+		}
+		if (!isQuitting())
+		{
+			decodep = mOwner->mPending.front();
+			mOwner->mPending.pop_front();
+		}
+		mOwner->mWorkCondition.unlock();
+		if (decodep.isNull())
+		{
+			break;
+		}
 
-			if (mCurrentDecodep->isDone() && !mCurrentDecodep->isValid())
+		LL_DEBUGS("AudioEngine") << "Decoding " << decodep->getUUID() << " from audio queue!" << LL_ENDL;
+		/* <edit> */ try{ /* </edit> */
+		if (decodep->initDecode())
+		{
+			while (!decodep->decodeSection())
 			{
-				// We had an error when decoding, abort.
-				LL_WARNS("AudioEngine") << mCurrentDecodep->getUUID() << " has invalid vorbis data, aborting decode" << LL_ENDL;
-				mCurrentDecodep->flushBadFile();
-
-				if (gAudiop)
+				if (isQuitting())
 				{
-					LLAudioData *adp = gAudiop->getAudioData(mCurrentDecodep->getUUID());
-					if(adp)
-					{
-						adp->setLoadState(LLAudioData::STATE_LOAD_ERROR);
-					}
+					return;
 				}
-				mCurrentDecodep = NULL;
-				done = TRUE;
 			}
+		}
+		/* <edit> */ }catch(std::bad_alloc){LL_ERRS() << "bad_alloc whilst decoding" << LL_ENDL;} /* </edit> */
 
-			if (!res)
-			{
-				// We've used up out time slice, bail...
-				done = TRUE;
-			}
-			else if (mCurrentDecodep)
-			{
-				if (gAudiop && mCurrentDecodep->finishDecode())
-				{
-					// We finished!
-					LLAudioData *adp = gAudiop->getAudioData(mCurrentDecodep->getUUID());
-					if (!adp)
-					{
-						LL_WARNS("AudioEngine") << "Missing LLAudioData for decode of " << mCurrentDecodep->getUUID() << LL_ENDL;
-					}
-					else if (mCurrentDecodep->isValid() && mCurrentDecodep->isDone())
-					{
-						adp->setLoadState(LLAudioData::STATE_LOAD_READY);
-						// At this point, we could see if anyone needs this sound immediately, but
-						// I'm not sure that there's a reason to - we need to poll all of the playing
-						// sounds anyway.
-						//LL_INFOS() << "Finished the vorbis decode, now what?" << LL_ENDL;
-					}
-					else
-					{
-						adp->setLoadState(LLAudioData::STATE_LOAD_ERROR);
-						LL_INFOS("AudioEngine") << "Vorbis decode failed for " << mCurrentDecodep->getUUID() << LL_ENDL;
-					}
-					mCurrentDecodep = NULL;
-				}
-				done = TRUE; // done for now
-			}
+		decodep->ref();
+		mOwner->pushCompleted(decodep);
+	}
+}
+
+LLAudioDecodeMgr::Impl::Impl(U32 num_workers)
+	: mCompleted(NULL)
+{
+	if (!num_workers)
+	{
+		// Sounds are small; a couple of threads keep up with a busy sim
+		// without competing with the texture decoders.
+		num_workers = llclamp(std::thread::hardware_concurrency() / 2, 1U, 4U);
+	}
+	for (U32 i = 0; i < num_workers; ++i)
+	{
+		Worker* worker = new Worker(this, i);
+		mWorkers.push_back(worker);
+		worker->start();
+	}
+	LL_INFOS("AudioEngine") << "Audio decode pool started with " << num_workers << " threads" << LL_ENDL;
+}
+
+LLAudioDecodeMgr::Impl::~Impl()
+{
+	for (Worker* worker : mWorkers)
+	{
+		worker->setQuitting();
+	}
+	mWorkCondition.lock();
+	mWorkCondition.broadcast();
+	mWorkCondition.unlock();
+	for (Worker* worker : mWorkers)
+	{
+		worker->shutdown();
+		delete worker;
+	}
+	mWorkers.clear();
+	mPending.clear();
+
+	popCompleted();
+	mFinishing.clear();
+}
+
+void LLAudioDecodeMgr::Impl::pushCompleted(LLVorbisDecodeState* decodep)
+{
+	LLVorbisDecodeState* head = mCompleted.load(std::memory_order_relaxed);
+	do
+	{
+		decodep->mNextCompleted = head;
+	}
+	while (!mCompleted.compare_exchange_weak(head, decodep, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void LLAudioDecodeMgr::Impl::popCompleted()
+{
+	LLVorbisDecodeState* head = mCompleted.exchange(NULL, std::memory_order_acquire);
+
+	// The list is newest first; reverse it so sounds are finished in the order they were decoded.
+	LLVorbisDecodeState* oldest = NULL;
+	while (head)
+	{
+		LLVorbisDecodeState* next = head->mNextCompleted;
+		head->mNextCompleted = oldest;
+		oldest = head;
+		head = next;
+	}
+	while (oldest)
+	{
+		LLVorbisDecodeState* next = oldest->mNextCompleted;
+		oldest->mNextCompleted = NULL;
+		mFinishing.push_back(oldest);
+		oldest->unref();
+		oldest = next;
+	}
+}
+
+bool LLAudioDecodeMgr::Impl::finishDecode(LLVorbisDecodeState* decodep)
+{
+	const LLUUID& uuid = decodep->getUUID();
+	if (!decodep->isDone())
+	{
+		// initDecode() failed.
+		LLAudioData *adp = gAudiop ? gAudiop->getAudioData(uuid) : NULL;
+		if (adp)
+		{
+			adp->setLoadState(LLAudioData::STATE_LOAD_ERROR);
 		}
+		return true;
+	}
+
+	if (!decodep->isValid())
+	{
+		// We had an error when decoding, abort.
+		LL_WARNS("AudioEngine") << uuid << " has invalid vorbis data, aborting decode" << LL_ENDL;
+		decodep->flushBadFile();
 
-		if (!done)
+		LLAudioData *adp = gAudiop ? gAudiop->getAudioData(uuid) : NULL;
+		if (adp)
 		{
-			if (mDecodeQueue.empty())
-			{
-				// Nothing else on the queue.
-				done = TRUE;
-			}
-			else
-			{
-				LLUUID uuid;
-				uuid = mDecodeQueue.front();
-				mDecodeQueue.pop_front();
-				if (!gAudiop || gAudiop->hasDecodedFile(uuid))
-				{
-					// This file has already been decoded, don't decode it again.
-					continue;
-				}
+			adp->setLoadState(LLAudioData::STATE_LOAD_ERROR);
+		}
+		return true;
+	}
+
+	if (!gAudiop)
+	{
+		return true;
+	}
+	if (!decodep->finishDecode())
+	{
+		// Still writing the .dsf file.
+		return false;
+	}
 
-				LL_DEBUGS() << "Decoding " << uuid << " from audio queue!" << LL_ENDL;
+	// We finished!
+	LLAudioData *adp = gAudiop->getAudioData(uuid);
+	if (!adp)
+	{
+		LL_WARNS("AudioEngine") << "Missing LLAudioData for decode of " << uuid << LL_ENDL;
+	}
+	else if (decodep->isValid() && decodep->isDone())
+	{
+		adp->setLoadState(LLAudioData::STATE_LOAD_READY);
+		// At this point, we could see if anyone needs this sound immediately, but
+		// I'm not sure that there's a reason to - we need to poll all of the playing
+		// sounds anyway.
+	}
+	else
+	{
+		adp->setLoadState(LLAudioData::STATE_LOAD_ERROR);
+		LL_INFOS("AudioEngine") << "Vorbis decode failed for " << uuid << LL_ENDL;
+	}
+	return true;
+}
 
-				std::string uuid_str;
-				std::string d_path;
+// Decoding itself runs on the workers; the main thread only writes the
+// WAV header, crossfades the loop point and starts the .dsf write.
+void LLAudioDecodeMgr::Impl::processQueue(const F32 num_secs)
+{
+	LLTimer decode_timer;
 
-				LLTimer timer;
-				timer.reset();
+	popCompleted();
+	for (std::list<LLPointer<LLVorbisDecodeState> >::iterator iter = mFinishing.begin();
+		 iter != mFinishing.end() && decode_timer.getElapsedTimeF32() < num_secs; )
+	{
+		if (finishDecode(*iter))
+		{
+			mInFlight.erase((*iter)->getUUID());
+			iter = mFinishing.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
 
-				uuid.toString(uuid_str);
-				d_path = gDirUtilp->getExpandedFilename(LL_PATH_CACHE,uuid_str) + ".dsf";
+	if (mDecodeQueue.empty())
+	{
+		return;
+	}
 
-				mCurrentDecodep = new LLVorbisDecodeState(uuid, d_path);
-				if (!mCurrentDecodep->initDecode())
-				{
-					LLAudioData *adp = gAudiop->getAudioData(uuid);
-					if(adp)
-					{
-						adp->setLoadState(LLAudioData::STATE_LOAD_ERROR);
-					}
-					mCurrentDecodep = NULL;
-				}
-			}
+	mWorkCondition.lock();
+	while (!mDecodeQueue.empty())
+	{
+		LLUUID uuid = mDecodeQueue.front();
+		mDecodeQueue.pop_front();
+		if (!gAudiop || gAudiop->hasDecodedFile(uuid) || !mInFlight.insert(uuid).second)
+		{
+			// This file has already been decoded, or is being decoded; don't decode it again.
+			continue;
 		}
+
+		std::string d_path = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, uuid.asString()) + ".dsf";
+		mPending.push_back(new LLVorbisDecodeState(uuid, d_path, gAudiop->getAllowLargeSounds()));
 	}
+	mWorkCondition.broadcast();
+	mWorkCondition.unlock();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
-LLAudioDecodeMgr::LLAudioDecodeMgr()
+LLAudioDecodeMgr::LLAudioDecodeMgr(U32 num_workers)
 {
-	mImpl = new Impl;
+	mImpl = new Impl(num_workers);
 }
 
 LLAudioDecodeMgr::~LLAudioDecodeMgr()
@@ -744,3 +883,12 @@ bool LLAudioDecodeMgr::addDecodeRequest(const LLUUID &uuid)
 	LL_DEBUGS("AudioEngine") << "addDecodeRequest for " << uuid << " no file available" << LL_ENDL;
 	return false;
 }
+
+void LLAudioDecodeMgr::addAudioRequest(const LLUUID &uuid)
+{
+	// The caller knows the sound is in the VFS already.
+	if (uuid.notNull())
+	{
+		mImpl->mDecodeQueue.push_back(uuid);
+	}
+}
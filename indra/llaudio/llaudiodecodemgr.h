@@ -39,11 +39,14 @@ class LLVorbisDecodeState;
 class LLAudioDecodeMgr
 {
 public:
-	LLAudioDecodeMgr();
+	// Sounds are decoded on num_workers threads (0: sized from the number
+	// of cores); processQueue() only finishes and writes the decoded sounds.
+	LLAudioDecodeMgr(U32 num_workers = 0);
 	~LLAudioDecodeMgr();
 
 	void processQueue(const F32 num_secs = 0.005);
 	bool addDecodeRequest(const LLUUID &uuid);
+	// Queues a sound already in the VFS for decoding, without checking the asset storage.
 	void addAudioRequest(const LLUUID &uuid);
 	
 protected:
@@ -0,0 +1,198 @@
+/**
+ * @file llaudiodecode_bench.cpp
+ * @brief Vorbis decode throughput of LLAudioDecodeMgr, and the main thread time it costs.
+ *
+ * Usage: llaudiodecode_bench <directory of .ogg files> [max workers]
+ *
+ * The .ogg files are stored in a scratch VFS under random sound ids, then
+ * decoded to .dsf files through a headless LLAudioEngine with 1, 2, 4...
+ * decode workers. For each pool size, reports the decode throughput and
+ * the time spent in LLAudioDecodeMgr::processQueue() on the calling thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llaudiodecodemgr.h"
+#include "llaudioengine.h"
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llerrorcontrol.h"
+#include "llfile.h"
+#include "lllfsthread.h"
+#include "lltimer.h"
+#include "llvfile.h"
+#include "llvfs.h"
+#include "llvfsthread.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+// An audio engine without an output device: enough for the decode manager.
+class LLAudioEngineBench : public LLAudioEngine
+{
+public:
+	/*virtual*/ std::string getDriverName(bool verbose) { return "bench"; }
+	/*virtual*/ void updateWind(LLVector3 direction, F32 camera_height_above_water) { }
+
+protected:
+	/*virtual*/ LLAudioBuffer* createBuffer() { return NULL; }
+	/*virtual*/ LLAudioChannel* createChannel() { return NULL; }
+	/*virtual*/ bool initWind() { return false; }
+	/*virtual*/ void cleanupWind() { }
+	/*virtual*/ void setInternalGain(F32 gain) { }
+	/*virtual*/ void allocateListener() { }
+};
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <directory of .ogg files> [max workers]" << std::endl;
+		return 1;
+	}
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const std::string dir = argv[1];
+	const std::string delim = gDirUtilp->getDirDelimiter();
+	U32 max_workers = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+
+	// The decoded .dsf files and the scratch VFS go to a subdirectory of the corpus.
+	const std::string scratch = dir + delim + "llaudiodecode_bench";
+	gDirUtilp->setCacheDir(scratch);
+	LLVFSThread::initClass(true);
+	LLLFSThread::initClass(true);
+	gVFS = LLVFS::createLLVFS(scratch + delim + "bench.index", scratch + delim + "bench.data", FALSE, 0, FALSE);
+	LLVFile::initClass();
+
+	std::vector<LLUUID> sounds;
+	U64 compressed_bytes = 0;
+	LLDirIterator iter(dir, "*.ogg");
+	std::string name;
+	while (iter.next(name))
+	{
+		std::ifstream file((dir + delim + name).c_str(), std::ios::binary);
+		std::vector<U8> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		LLUUID id;
+		id.generate();
+		if (!data.empty() && LLVFile::writeFile(&data[0], data.size(), gVFS, id, LLAssetType::AT_SOUND))
+		{
+			compressed_bytes += data.size();
+			sounds.push_back(id);
+		}
+	}
+	if (sounds.empty())
+	{
+		std::cerr << "No .ogg file found in " << dir << std::endl;
+		return 1;
+	}
+	std::cout << sounds.size() << " sounds, " << compressed_bytes / 1024 << " KB compressed" << std::endl;
+
+	std::vector<U32> pool_sizes;
+	for (U32 workers = 1; workers < max_workers; workers *= 2)
+	{
+		pool_sizes.push_back(workers);
+	}
+	pool_sizes.push_back(llmax(max_workers, 1U));
+
+	LLAudioEngineBench* engine = new LLAudioEngineBench;
+	gAudiop = engine;
+	engine->init(0, NULL);
+	engine->setAllowLargeSounds(true);
+
+	F64 single_worker_time = 0.0;
+	for (U32 workers : pool_sizes)
+	{
+		gDirUtilp->deleteFilesInDir(scratch, "*.dsf");
+		delete gAudioDecodeMgrp;
+		gAudioDecodeMgrp = new LLAudioDecodeMgr(workers);
+
+		std::vector<LLAudioData*> datas;
+		for (const LLUUID& id : sounds)
+		{
+			LLAudioData* adp = engine->getAudioData(id);
+			adp->setLoadState(LLAudioData::STATE_LOAD_DECODING);
+			datas.push_back(adp);
+			gAudioDecodeMgrp->addAudioRequest(id);
+		}
+
+		LLTimer timer;
+		F64 main_thread_time = 0.0;
+		F64 longest_frame = 0.0;
+		U32 frames = 0;
+		U32 pending = datas.size();
+		U32 failed = 0;
+		while (pending)
+		{
+			LLTimer frame_timer;
+			gAudioDecodeMgrp->processQueue();
+			const F64 frame_time = frame_timer.getElapsedTimeF64();
+			main_thread_time += frame_time;
+			longest_frame = llmax(longest_frame, frame_time);
+			++frames;
+
+			pending = 0;
+			failed = 0;
+			for (LLAudioData* adp : datas)
+			{
+				if (adp->getLoadState() == LLAudioData::STATE_LOAD_DECODING)
+				{
+					++pending;
+				}
+				else if (adp->getLoadState() == LLAudioData::STATE_LOAD_ERROR)
+				{
+					++failed;
+				}
+			}
+			ms_sleep(1);
+		}
+		const F64 elapsed = timer.getElapsedTimeF64();
+		if (workers == 1)
+		{
+			single_worker_time = elapsed;
+		}
+
+		std::cout << llformat("%2u workers: %7.1f ms, %7.1f sounds/s, %6.2f MB/s compressed, speedup %.2fx; "
+							  "main thread %.2f ms total, %.3f ms/frame avg, %.3f ms max",
+							  workers, elapsed * 1000.0, sounds.size() / elapsed,
+							  compressed_bytes / elapsed / (1024.0 * 1024.0), single_worker_time / elapsed,
+							  main_thread_time * 1000.0, main_thread_time * 1000.0 / frames, longest_frame * 1000.0);
+		if (failed)
+		{
+			std::cout << " (" << failed << " failed)";
+		}
+		std::cout << std::endl;
+	}
+
+	engine->shutdown();
+	delete engine;
+	gAudiop = NULL;
+	delete gVFS;
+	gVFS = NULL;
+	LLLFSThread::cleanupClass();
+	LLVFSThread::cleanupClass();
+	return 0;
+}
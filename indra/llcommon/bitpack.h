@@ -146,8 +146,13 @@ public:
 
 	U32 bitUnpack(U8 *total_retval, U32 total_dsize)
 	{
-		U32 dsize;
-		U8	*retval;
+		// Works on local copies, so the compiler can keep them in registers
+		// rather than reload them after every byte written through total_retval.
+		U32 dsize, count;
+		U32 load = mLoad;
+		U32 load_size = mLoadSize;
+		U32 buffer_size = mBufferSize;
+		U32 retval;
 
 		while (total_dsize > 0)
 		{
@@ -162,32 +167,60 @@ public:
 				total_dsize = 0;
 			}
 
-			retval = total_retval++;
-			*retval = 0x00;
+			retval = 0x00;
 			while (dsize > 0) 
 			{
-				if (mLoadSize == 0) 
+				if (load_size == 0) 
 				{
 #ifdef _DEBUG
-					if (mBufferSize > mMaxSize)
+					if (buffer_size > mMaxSize)
 					{
 						LL_ERRS() << "mBufferSize exceeding mMaxSize" << LL_ENDL;
-						LL_ERRS() << mBufferSize << " > " << mMaxSize << LL_ENDL;
+						LL_ERRS() << buffer_size << " > " << mMaxSize << LL_ENDL;
 					}
 #endif
-					mLoad = *(mBuffer + mBufferSize++);
-					mLoadSize = MAX_DATA_BITS;
+					load = *(mBuffer + buffer_size++);
+					load_size = MAX_DATA_BITS;
 				}
-				*retval <<= 1;
-				*retval |= (mLoad >> (MAX_DATA_BITS - 1));
-				mLoadSize--;
-				mLoad <<= 1;
-				dsize--;
+				// Take as many bits as the load still holds at once.
+				count = dsize < load_size ? dsize : load_size;
+				retval = (retval << count) | (load >> (MAX_DATA_BITS - count));
+				load = (load << count) & 0xFF;
+				load_size -= count;
+				dsize -= count;
 			}
+			*total_retval++ = (U8)retval;
 		}
+
+		mLoad = (U8)load;
+		mLoadSize = load_size;
+		mBufferSize = buffer_size;
 		return mBufferSize;
 	}
 
+	// Unpacking position, in bits from the start of the buffer, for decoders
+	// that read many fields in a row straight from getBuffer().
+	U32 getUnpackBitPosition() const
+	{
+		return mBufferSize * MAX_DATA_BITS - mLoadSize;
+	}
+
+	void setUnpackBitPosition(U32 position)
+	{
+		mBufferSize = position / MAX_DATA_BITS;
+		mLoad = 0x00;
+		mLoadSize = 0;
+		U32 offset = position % MAX_DATA_BITS;
+		if (offset)
+		{
+			mLoad = (U8)(*(mBuffer + mBufferSize++) << offset);
+			mLoadSize = MAX_DATA_BITS - offset;
+		}
+	}
+
+	const U8* getBuffer() const		{ return mBuffer; }
+	U32 getMaxSize() const			{ return mMaxSize; }
+
 	U32 flushBitPack()
 	{
 		if (mLoadSize) 
@@ -0,0 +1,333 @@
+/**
+ * @file lljobsystem.cpp
+ * @brief Shared pool of worker threads that subsystems submit jobs to.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lljobsystem.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "llformat.h"
+#include "llstl.h"
+
+//============================================================================
+
+/*static*/ LLJobSystem* LLJobSystem::sInstance = NULL;
+// Index of the worker running on this thread, -1 on any other thread.
+static ll_thread_local S32 sWorkerIndex = -1;
+
+class LLJobSystem::Worker : public LLThread
+{
+public:
+	Worker(LLJobSystem* owner, S32 index)
+		: LLThread(llformat("job worker %d", index)), mOwner(owner), mIndex(index)
+	{
+	}
+
+protected:
+	/*virtual*/ void run();
+
+private:
+	LLJobSystem* mOwner;
+	S32 mIndex;
+};
+
+void LLJobSystem::Worker::run()
+{
+	sWorkerIndex = mIndex;
+	LLCondition& condition = mOwner->mWorkCondition;
+	while (1)
+	{
+		Job* job = mOwner->pop(mIndex, false);
+		if (!job && mOwner->mQueued > 0)
+		{
+			// Every queue holding a job was busy: wait for their locks this
+			// time instead of coming straight back to fail again.
+			job = mOwner->pop(mIndex, true);
+		}
+		if (job)
+		{
+			mOwner->run(job);
+			continue;
+		}
+		condition.lock();
+		while (!isQuitting() && mOwner->mQueued <= 0)
+		{
+			condition.wait();
+		}
+		condition.unlock();
+		if (isQuitting())
+		{
+			break;
+		}
+	}
+}
+
+//============================================================================
+// MAIN THREAD
+
+//static
+void LLJobSystem::initClass(U32 num_workers)
+{
+	llassert(sInstance == NULL);
+	if (!num_workers)
+	{
+		// Leave a core to the main thread.
+		U32 cores = std::thread::hardware_concurrency();
+		num_workers = llclamp(cores > 1 ? cores - 1 : 1U, 1U, 16U);
+	}
+	sInstance = new LLJobSystem(num_workers);
+	LL_INFOS() << "Job system started with " << num_workers << " workers" << LL_ENDL;
+}
+
+//static
+void LLJobSystem::cleanupClass()
+{
+	delete sInstance;
+	sInstance = NULL;
+}
+
+LLJobSystem::LLJobSystem(U32 num_workers)
+	: mQueued(0),
+	  mNextQueue(0),
+	  mStolen(0),
+	  mNumChannels(0)
+{
+	for (S32 i = 0; i < MAX_CHANNELS; ++i)
+	{
+		mChannels[i] = NULL;
+	}
+	for (U32 i = 0; i < num_workers; ++i)
+	{
+		mQueues.push_back(new Queue);
+	}
+	for (U32 i = 0; i < num_workers; ++i)
+	{
+		Worker* worker = new Worker(this, i);
+		mWorkers.push_back(worker);
+		worker->start();
+	}
+}
+
+LLJobSystem::~LLJobSystem()
+{
+	for (Worker* worker : mWorkers)
+	{
+		worker->setQuitting();
+	}
+	mWorkCondition.lock();
+	mWorkCondition.broadcast();
+	mWorkCondition.unlock();
+	for (Worker* worker : mWorkers)
+	{
+		worker->shutdown();
+		delete worker;
+	}
+	mWorkers.clear();
+
+	// Whoever submitted these is gone by now; drop them unrun.
+	S32 dropped = 0;
+	for (Queue* queue : mQueues)
+	{
+		for (S32 p = 0; p < PRIORITY_COUNT; ++p)
+		{
+			dropped += queue->mJobs[p].size();
+			std::for_each(queue->mJobs[p].begin(), queue->mJobs[p].end(), DeletePointer());
+		}
+		delete queue;
+	}
+	mQueues.clear();
+	for (S32 i = 0; i < mNumChannels; ++i)
+	{
+		dropped += mChannels[i]->mParked.size();
+		std::for_each(mChannels[i]->mParked.begin(), mChannels[i]->mParked.end(), DeletePointer());
+		delete mChannels[i];
+	}
+	if (dropped)
+	{
+		LL_WARNS() << "~LLJobSystem() dropped " << dropped << " queued jobs" << LL_ENDL;
+	}
+}
+
+LLJobSystem::channel_t LLJobSystem::addChannel(const std::string& name, EPriority priority, U32 max_active)
+{
+	LLMutexLock lock(mChannelMutex);
+	channel_t id = mNumChannels;
+	if (id >= MAX_CHANNELS)
+	{
+		LL_WARNS() << "No job channel left for " << name << LL_ENDL;
+		return NO_CHANNEL;
+	}
+	Channel* channel = new Channel;
+	channel->mName = name;
+	channel->mPriority = priority;
+	channel->mMaxActive = max_active;
+	channel->mActive = 0;
+	channel->mOutstanding = 0;
+	channel->mCompleted = 0;
+	mChannels[id] = channel;
+	mNumChannels = id + 1;	// publish only once the channel is complete
+	return id;
+}
+
+//============================================================================
+// Any thread
+
+void LLJobSystem::submit(channel_t channel, const job_func_t& func)
+{
+	llassert_always(channel >= 0 && channel < mNumChannels);
+	Job* job = new Job;
+	job->mFunc = func;
+	job->mChannel = channel;
+	mChannels[channel]->mOutstanding++;
+	push(job);
+}
+
+S32 LLJobSystem::getOutstanding(channel_t channel) const
+{
+	return mChannels[channel]->mOutstanding;
+}
+
+U32 LLJobSystem::getCompleted(channel_t channel) const
+{
+	return mChannels[channel]->mCompleted;
+}
+
+void LLJobSystem::push(Job* job)
+{
+	// Jobs submitted by a job stay with that worker, the others are dealt
+	// round robin; idle workers steal either way.
+	U32 index = sWorkerIndex >= 0 ? (U32)sWorkerIndex : mNextQueue++ % mQueues.size();
+	Queue* queue = mQueues[index];
+	queue->mMutex.lock();
+	queue->mJobs[mChannels[job->mChannel]->mPriority].push_back(job);
+	queue->mMutex.unlock();
+	mQueued++;
+
+	mWorkCondition.lock();
+	mWorkCondition.signal();
+	mWorkCondition.unlock();
+}
+
+//============================================================================
+// Runs on the WORKER threads
+
+LLJobSystem::Job* LLJobSystem::pop(S32 index, bool wait_for_locks)
+{
+	const S32 count = mQueues.size();
+	for (S32 p = 0; p < PRIORITY_COUNT; ++p)
+	{
+		// Own queue first, oldest job first.
+		Queue* queue = mQueues[index];
+		queue->mMutex.lock();
+		if (!queue->mJobs[p].empty())
+		{
+			Job* job = queue->mJobs[p].front();
+			queue->mJobs[p].pop_front();
+			queue->mMutex.unlock();
+			mQueued -= 1;
+			return job;
+		}
+		queue->mMutex.unlock();
+
+		// Then steal the newest job of another worker. A busy queue is
+		// skipped rather than waited for, unless wait_for_locks; its owner
+		// is making progress.
+		for (S32 i = 1; i < count; ++i)
+		{
+			queue = mQueues[(index + i) % count];
+			if (wait_for_locks)
+			{
+				queue->mMutex.lock();
+			}
+			else if (!queue->mMutex.try_lock())
+			{
+				continue;
+			}
+			if (!queue->mJobs[p].empty())
+			{
+				Job* job = queue->mJobs[p].back();
+				queue->mJobs[p].pop_back();
+				queue->mMutex.unlock();
+				mQueued -= 1;
+				mStolen++;
+				return job;
+			}
+			queue->mMutex.unlock();
+		}
+	}
+	return NULL;
+}
+
+// Returns false when the job was parked because its channel is at its cap.
+bool LLJobSystem::admit(Job* job)
+{
+	Channel* channel = mChannels[job->mChannel];
+	if (!channel->mMaxActive)
+	{
+		return true;
+	}
+	LLMutexLock lock(channel->mMutex);
+	if (channel->mActive >= channel->mMaxActive)
+	{
+		channel->mParked.push_back(job);
+		return false;
+	}
+	++channel->mActive;
+	return true;
+}
+
+void LLJobSystem::run(Job* job)
+{
+	if (!admit(job))
+	{
+		return;
+	}
+	Channel* channel = mChannels[job->mChannel];
+	job->mFunc();
+	delete job;
+
+	if (channel->mMaxActive)
+	{
+		// Hand the freed slot to the oldest parked job. While anything is
+		// parked the channel has running jobs, so nothing is left behind.
+		Job* next = NULL;
+		channel->mMutex.lock();
+		--channel->mActive;
+		if (!channel->mParked.empty())
+		{
+			next = channel->mParked.front();
+			channel->mParked.pop_front();
+		}
+		channel->mMutex.unlock();
+		if (next)
+		{
+			push(next);
+		}
+	}
+	channel->mCompleted++;
+	channel->mOutstanding -= 1;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file lljobsystem.h
+ * @brief Shared pool of worker threads that subsystems submit jobs to.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLJOBSYSTEM_H
+#define LL_LLJOBSYSTEM_H
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "llthread.h"
+
+//============================================================================
+// A fixed pool of worker threads shared by the subsystems that used to own
+// a thread each. Every subsystem registers a channel, which gives its jobs
+// a priority and caps how many of them may run at the same time.
+//
+// Each worker has its own queue; a worker that runs out of work steals from
+// the others, so a burst of texture cache jobs spreads over every idle core.
+// Jobs are taken highest channel priority first. A job whose channel is at
+// its cap is parked on the channel and requeued when one of that channel's
+// running jobs finishes.
+
+class LL_COMMON_API LLJobSystem
+{
+public:
+	enum EPriority
+	{
+		PRIORITY_HIGH = 0,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_COUNT
+	};
+
+	typedef S32 channel_t;
+	typedef std::function<void()> job_func_t;
+
+	enum { NO_CHANNEL = -1, MAX_CHANNELS = 32 };
+
+	// MAIN THREAD. num_workers == 0 sizes the pool from the hardware concurrency.
+	static void initClass(U32 num_workers = 0);
+	static void cleanupClass();
+	// NULL before initClass() and after cleanupClass().
+	static LLJobSystem* getInstance() { return sInstance; }
+
+	// Channels live as long as the job system. max_active == 0 means no cap.
+	channel_t addChannel(const std::string& name, EPriority priority, U32 max_active);
+
+	// May be called from any thread, including from a job.
+	void submit(channel_t channel, const job_func_t& func);
+
+	// Jobs of this channel that are queued, parked or running.
+	S32 getOutstanding(channel_t channel) const;
+	U32 getCompleted(channel_t channel) const;
+	U32 getNumWorkers() const { return mWorkers.size(); }
+	// Jobs a worker took from another worker's queue.
+	U32 getStolen() const { return mStolen; }
+
+private:
+	LLJobSystem(U32 num_workers);
+	~LLJobSystem();
+
+	struct Job
+	{
+		job_func_t mFunc;
+		channel_t mChannel;
+	};
+
+	struct Channel
+	{
+		std::string mName;
+		EPriority mPriority;
+		U32 mMaxActive;
+		LLMutex mMutex;					// protects mActive and mParked
+		U32 mActive;
+		std::deque<Job*> mParked;		// jobs that found the channel at its cap
+		LLAtomicS32 mOutstanding;
+		LLAtomicU32 mCompleted;
+	};
+
+	struct Queue
+	{
+		LLMutex mMutex;
+		std::deque<Job*> mJobs[PRIORITY_COUNT];
+	};
+
+	class Worker;
+	friend class Worker;
+
+	void push(Job* job);
+	Job* pop(S32 index, bool wait_for_locks);
+	bool admit(Job* job);
+	void run(Job* job);
+
+	static LLJobSystem* sInstance;
+
+	std::vector<Worker*> mWorkers;
+	std::vector<Queue*> mQueues;
+	LLCondition mWorkCondition;			// idle workers sleep on this while mQueued == 0
+	LLAtomicS32 mQueued;				// jobs sitting in the worker queues
+	LLAtomicU32 mNextQueue;				// round robin for jobs submitted from outside the pool
+	LLAtomicU32 mStolen;
+
+	LLMutex mChannelMutex;
+	Channel* mChannels[MAX_CHANNELS];
+	LLAtomicS32 mNumChannels;
+};
+
+#endif // LL_LLJOBSYSTEM_H
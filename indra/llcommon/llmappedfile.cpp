@@ -0,0 +1,192 @@
+/**
+ * @file llmappedfile.cpp
+ * @brief A file mapped into memory.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "linden_common.h"
+#include "llmappedfile.h"
+#include "llstring.h"
+
+LLMappedFile::LLMappedFile()
+	: mData(NULL),
+	  mSize(0),
+#if LL_WINDOWS
+	  mFile(INVALID_HANDLE_VALUE),
+	  mMapping(NULL)
+#else
+	  mFD(-1)
+#endif
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+}
+
+bool LLMappedFile::open(const std::string& filename, EMode mode, size_t size)
+{
+	close();
+	const bool writable = (mode == READ_WRITE);
+
+#if LL_WINDOWS
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	mFile = CreateFileW((LPCWSTR)utf16filename.c_str(),
+						writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+						FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+						writable ? OPEN_ALWAYS : OPEN_EXISTING,
+						FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		LL_WARNS() << "Could not open " << filename << " for mapping" << LL_ENDL;
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(mFile, &file_size))
+	{
+		close();
+		return false;
+	}
+	// A read/write mapping larger than the file grows the file.
+	U64 map_size = (U64)file_size.QuadPart;
+	if (writable && (U64)size > map_size)
+	{
+		map_size = size;
+	}
+	if (!map_size)
+	{
+		close();
+		return false;
+	}
+	mMapping = CreateFileMappingW(mFile, NULL, writable ? PAGE_READWRITE : PAGE_WRITECOPY,
+								  (DWORD)(map_size >> 32), (DWORD)map_size, NULL);
+	if (mMapping)
+	{
+		mData = (U8*)MapViewOfFile(mMapping, writable ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, (SIZE_T)map_size);
+	}
+#else
+	mFD = ::open(filename.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+	if (mFD < 0)
+	{
+		LL_WARNS() << "Could not open " << filename << " for mapping" << LL_ENDL;
+		return false;
+	}
+	struct stat file_stat;
+	if (fstat(mFD, &file_stat) != 0)
+	{
+		close();
+		return false;
+	}
+	size_t map_size = (size_t)file_stat.st_size;
+	if (writable && size > map_size)
+	{
+		// Sparse where the file system allows it.
+		if (ftruncate(mFD, (off_t)size) != 0)
+		{
+			LL_WARNS() << "Could not grow " << filename << " to " << size << " bytes" << LL_ENDL;
+			close();
+			return false;
+		}
+		map_size = size;
+	}
+	if (!map_size)
+	{
+		close();
+		return false;
+	}
+	void* data = mmap(NULL, map_size, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, mFD, 0);
+	if (data != MAP_FAILED)
+	{
+		mData = (U8*)data;
+	}
+#endif
+
+	if (!mData)
+	{
+		LL_WARNS() << "Could not map " << map_size << " bytes of " << filename << LL_ENDL;
+		close();
+		return false;
+	}
+	mSize = (size_t)map_size;
+	return true;
+}
+
+void LLMappedFile::close()
+{
+#if LL_WINDOWS
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping)
+	{
+		CloseHandle(mMapping);
+		mMapping = NULL;
+	}
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mData)
+	{
+		munmap(mData, mSize);
+	}
+	if (mFD >= 0)
+	{
+		::close(mFD);
+		mFD = -1;
+	}
+#endif
+	mData = NULL;
+	mSize = 0;
+}
+
+void LLMappedFile::flush(bool wait)
+{
+	if (!mData)
+	{
+		return;
+	}
+#if LL_WINDOWS
+	FlushViewOfFile(mData, 0);
+	if (wait)
+	{
+		FlushFileBuffers(mFile);
+	}
+#else
+	msync(mData, mSize, wait ? MS_SYNC : MS_ASYNC);
+#endif
+}
@@ -0,0 +1,73 @@
+/**
+ * @file llmappedfile.h
+ * @brief A file mapped into memory.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <string>
+
+//============================================================================
+// Maps a whole file into memory. Stores into a READ_WRITE mapping reach the
+// file through the page cache, so they survive a crash of the process; a
+// COPY_ON_WRITE mapping can be modified but never writes the file back.
+
+class LL_COMMON_API LLMappedFile
+{
+public:
+	enum EMode
+	{
+		READ_WRITE,		// creates the file, and grows it to the requested size
+		COPY_ON_WRITE	// the file must exist; it is mapped at its current size
+	};
+
+	LLMappedFile();
+	~LLMappedFile();
+
+	bool open(const std::string& filename, EMode mode, size_t size = 0);
+	void close();
+
+	// Starts writing dirty pages back; wait == true blocks until they are on disk.
+	void flush(bool wait = false);
+
+	bool isOpen() const { return mData != NULL; }
+	U8* getData() const { return mData; }
+	size_t getSize() const { return mSize; }
+
+private:
+	LLMappedFile(const LLMappedFile&);
+	LLMappedFile& operator=(const LLMappedFile&);
+
+	U8* mData;
+	size_t mSize;
+#if LL_WINDOWS
+	void* mFile;
+	void* mMapping;
+#else
+	int mFD;
+#endif
+};
+
+#endif // LL_LLMAPPEDFILE_H
@@ -32,12 +32,16 @@
 //============================================================================
 
 // MAIN THREAD
-LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool should_pause) :
+LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool should_pause,
+							   U32 max_jobs, LLJobSystem::EPriority job_priority) :
 	LLThread(name),
 	mThreaded(threaded),
 	mIdleThread(true),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mJobChannel(LLJobSystem::NO_CHANNEL),
+	mMaxJobs(0),
+	mJobsInFlight(0)
 {
 	if (mThreaded)
 	{
@@ -46,7 +50,22 @@ LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool shou
 			pause() ; //call this before start the thread.
 		}
 
-		start();
+		LLJobSystem* jobs = LLJobSystem::getInstance();
+		if (max_jobs && jobs)
+		{
+			mJobChannel = jobs->addChannel(name, job_priority, max_jobs);
+		}
+		if (isPooled())
+		{
+			mMaxJobs = max_jobs;
+			// There is no thread to start; RUNNING is what isPaused() and isQuitting() look at.
+			mStatus = RUNNING;
+			mStarted = TRUE;
+		}
+		else
+		{
+			start();
+		}
 	}
 }
 
@@ -66,7 +85,28 @@ void LLQueuedThread::shutdown()
 	setQuitting();
 
 	unpause(); // MAIN THREAD
-	if (mThreaded)
+	if (isPooled())
+	{
+		// Jobs in flight see isQuitting() and return without processing.
+		S32 timeout = 10000;
+		for ( ; timeout>0; timeout--)
+		{
+			lockData();
+			bool done = !mJobsInFlight;
+			unlockData();
+			if (done)
+			{
+				break;
+			}
+			ms_sleep(1);
+		}
+		if (timeout == 0)
+		{
+			LL_WARNS() << "~LLQueuedThread (" << mName << ") timed out!" << LL_ENDL;
+		}
+		mStatus = STOPPED;
+	}
+	else if (mThreaded)
 	{
 		S32 timeout = 100;
 		for ( ; timeout>0; timeout--)
@@ -135,6 +175,10 @@ S32 LLQueuedThread::updateQueue(F32 max_time_ms)
 		if(pending > 0)
 		{
 			unpause();
+			if (isPooled())
+			{
+				scheduleJobs();
+			}
 		}
 	}
 	else
@@ -154,13 +198,55 @@ void LLQueuedThread::incQueue()
 	// Something has been added to the queue
 	if (!isPaused())
 	{
-		if (mThreaded)
+		if (isPooled())
+		{
+			scheduleJobs();
+		}
+		else if (mThreaded)
 		{
 			wake(); // Wake the thread up if necessary.
 		}
 	}
 }
 
+// May be called from any thread
+void LLQueuedThread::scheduleJobs()
+{
+	lockData();
+	// One job per queued request, up to mMaxJobs; each job processes one
+	// request and reschedules, so other channels get a turn in between.
+	U32 wanted = llmin((U32)mRequestQueue.size(), mMaxJobs);
+	if (isPaused() || isQuitting())
+	{
+		wanted = 0;
+	}
+	while (mJobsInFlight < wanted)
+	{
+		++mJobsInFlight;
+		mIdleThread = false;
+		LLJobSystem::getInstance()->submit(mJobChannel, [this]() { runJob(); });
+	}
+	unlockData();
+}
+
+// Runs on a LLJobSystem worker
+void LLQueuedThread::runJob()
+{
+	// Paused or quitting: leave the queue alone, like a thread of our own would.
+	if (!isPaused() && !isQuitting())
+	{
+		processNextRequest();
+	}
+	lockData();
+	--mJobsInFlight;
+	scheduleJobs();
+	if (!mJobsInFlight)
+	{
+		mIdleThread = true;
+	}
+	unlockData();
+}
+
 //virtual
 // May be called from any thread
 S32 LLQueuedThread::getPending()
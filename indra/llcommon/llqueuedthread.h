@@ -32,12 +32,19 @@
 #include <map>
 #include <set>
 
+#include "lljobsystem.h"
 #include "llthread.h"
 #include "llsimplehash.h"
 
 //============================================================================
 // Note: ~LLQueuedThread is O(N) N=# of queued threads, assumed to be small
 //   It is assumed that LLQueuedThreads are rarely created/destroyed.
+//
+// When constructed threaded with max_jobs > 0 and LLJobSystem is running,
+// no thread is started: requests are processed by jobs on the shared pool,
+// at most max_jobs of them at a time. startThread(), threadedUpdate() and
+// endThread() are never called in that mode, so subclasses that need them
+// must keep a thread of their own.
 
 class LL_COMMON_API LLQueuedThread : public LLThread
 {
@@ -153,7 +160,8 @@ public:
 	static handle_t nullHandle() { return handle_t(0); }
 	
 public:
-	LLQueuedThread(const std::string& name, bool threaded = true, bool should_pause = false);
+	LLQueuedThread(const std::string& name, bool threaded = true, bool should_pause = false,
+				   U32 max_jobs = 0, LLJobSystem::EPriority job_priority = LLJobSystem::PRIORITY_NORMAL);
 	virtual ~LLQueuedThread();	
 	virtual void shutdown();
 	
@@ -174,6 +182,10 @@ protected:
 	S32  processNextRequest(void);
 	void incQueue();
 
+private:
+	void scheduleJobs();
+	void runJob();
+
 public:
 	bool waitForResult(handle_t handle, bool auto_complete = true);
 
@@ -185,6 +197,8 @@ public:
 
 	virtual S32 getPending();
 	bool getThreaded() { return mThreaded ? true : false; }
+	// True when the requests run on LLJobSystem rather than on this thread.
+	bool isPooled() const { return mJobChannel != LLJobSystem::NO_CHANNEL; }
 
 	// Request accessors
 	status_t getRequestStatus(handle_t handle);
@@ -212,6 +226,10 @@ protected:
 	request_hash_t mRequestHash;
 
 	handle_t mNextHandle;
+
+	LLJobSystem::channel_t mJobChannel;
+	U32 mMaxJobs;
+	U32 mJobsInFlight;	// protected by mRunCondition
 };
 
 #endif // LL_LLQUEUEDTHREAD_H
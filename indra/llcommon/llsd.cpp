@@ -83,7 +83,13 @@ protected:
 		//	 finally initialized.
 		
 	virtual ~Impl();
-	
+
+public:
+	// Values come out of the arena of the parser building them, if any.
+	static void* operator new(size_t size)		{ return llsd::allocate(size); }
+	static void operator delete(void* ptr)		{ llsd::deallocate(ptr); }
+
+protected:
 	bool shared() const							{ return (mUseCount > 1) && (mUseCount != STATIC_USAGE_COUNT); }
 	
 	U32 mUseCount;
@@ -140,12 +146,12 @@ public:
 	virtual void erase(Integer)					{ }
 	virtual const LLSD& ref(Integer) const		{ return undef(); }
 
-	virtual const std::map<String, LLSD>& map() const { static const std::map<String, LLSD> empty; return empty; }
-	virtual std::map<String, LLSD>& map() { static std::map<String, LLSD> empty; return empty; }
+	virtual const LLSD::map_t& map() const { static const LLSD::map_t empty; return empty; }
+	virtual LLSD::map_t& map() { static LLSD::map_t empty; return empty; }
 	LLSD::map_const_iterator beginMap() const { return map().begin(); }
 	LLSD::map_const_iterator endMap() const { return map().end(); }
-	virtual const std::vector<LLSD>& array() const { static const std::vector<LLSD> empty; return empty; }
-	virtual std::vector<LLSD>& array() { static std::vector<LLSD> empty; return empty; }
+	virtual const LLSD::array_t& array() const { static const LLSD::array_t empty; return empty; }
+	virtual LLSD::array_t& array() { static LLSD::array_t empty; return empty; }
 	LLSD::array_const_iterator beginArray() const { return array().begin(); }
 	LLSD::array_const_iterator endArray() const { return array().end(); }
 
@@ -364,7 +370,7 @@ namespace
 	class ImplMap final : public LLSD::Impl
 	{
 	private:
-		typedef std::map<LLSD::String, LLSD>	DataMap;
+		typedef LLSD::map_t		DataMap;
 		
 		DataMap mData;
 		
@@ -496,7 +502,7 @@ namespace
 	class ImplArray final : public LLSD::Impl
 	{
 	private:
-		typedef std::vector<LLSD>	DataVector;
+		typedef LLSD::array_t	DataVector;
 		
 		DataVector mData;
 		
@@ -957,16 +963,16 @@ const char *LLSD::dump(const LLSD &llsd)
 	return llsd_dump(llsd, false);
 }
 
-std::map<LLSD::String, LLSD>& LLSD::map()           { return makeMap(impl).map(); }
-const std::map<LLSD::String, LLSD>& LLSD::map() const { return safe(impl).map(); }
+LLSD::map_t&                LLSD::map()             { return makeMap(impl).map(); }
+const LLSD::map_t&          LLSD::map() const       { return safe(impl).map(); }
 
 LLSD::map_iterator          LLSD::beginMap()        { return map().begin(); }
 LLSD::map_iterator          LLSD::endMap()          { return map().end(); }
 LLSD::map_const_iterator    LLSD::beginMap() const  { return map().cbegin(); }
 LLSD::map_const_iterator    LLSD::endMap() const    { return map().cend(); }
 
-std::vector<LLSD>&          LLSD::array()           { return makeArray(impl).array(); }
-const std::vector<LLSD>&    LLSD::array() const     { return safe(impl).array(); }
+LLSD::array_t&              LLSD::array()           { return makeArray(impl).array(); }
+const LLSD::array_t&        LLSD::array() const     { return safe(impl).array(); }
 
 LLSD::array_iterator        LLSD::beginArray()		{ return array().begin(); }
 LLSD::array_iterator        LLSD::endArray()        { return array().end(); }
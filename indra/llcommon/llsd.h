@@ -34,6 +34,7 @@
 #include "stdtypes.h"
 
 #include "lldate.h"
+#include "llsdarena.h"
 #include "lluri.h"
 #include "lluuid.h"
 
@@ -317,22 +318,27 @@ public:
 	//@{
 		int size() const;
 
-		typedef std::map<String, LLSD>::iterator		map_iterator;
-		typedef std::map<String, LLSD>::const_iterator	map_const_iterator;
+		/// The containers of maps and arrays, which come out of the arena
+		/// of the parser that built them (see llsdarena.h).
+		typedef std::map<String, LLSD, std::less<String>, llsd::arena_allocator<std::pair<const String, LLSD> > > map_t;
+		typedef std::vector<LLSD, llsd::arena_allocator<LLSD> > array_t;
+
+		typedef map_t::iterator			map_iterator;
+		typedef map_t::const_iterator	map_const_iterator;
 		
-		std::map<String, LLSD>& map();
-		const std::map<String, LLSD>& map() const;
+		map_t& map();
+		const map_t& map() const;
 		map_iterator		beginMap();
 		map_iterator		endMap();
 		map_const_iterator	beginMap() const;
 		map_const_iterator	endMap() const;
 		
-		typedef std::vector<LLSD>::iterator			array_iterator;
-		typedef std::vector<LLSD>::const_iterator	array_const_iterator;
-		typedef std::vector<LLSD>::reverse_iterator reverse_array_iterator;
+		typedef array_t::iterator			array_iterator;
+		typedef array_t::const_iterator		array_const_iterator;
+		typedef array_t::reverse_iterator	reverse_array_iterator;
 		
-		std::vector<LLSD>&      array();
-		const std::vector<LLSD>& array() const;
+		array_t&		array();
+		const array_t&	array() const;
 		array_iterator			beginArray();
 		array_iterator			endArray();
 		array_const_iterator	beginArray() const;
@@ -0,0 +1,178 @@
+/**
+ * @file llsdarena.cpp
+ * @brief Arena storage for the values of parsed LLSD documents.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llsdarena.h"
+
+#include "llatomic.h"
+
+namespace
+{
+	// Every allocation starts with the block it was made in, or NULL when it
+	// comes from the heap, and is aligned as operator new aligns it.
+	const size_t ALIGNMENT = alignof(std::max_align_t);
+	const size_t PREFIX_SIZE = ALIGNMENT;
+
+	// Blocks grow from the first one, so that a small document kept for long
+	// does not keep much more than itself, and stop growing early, so that a
+	// single value kept from a large one does not either.
+	const size_t FIRST_BLOCK_SIZE = 2 * 1024;
+	const size_t MAX_BLOCK_SIZE = 8 * 1024;
+	// Larger allocations, such as the storage of long arrays, are left to the heap.
+	const size_t MAX_ARENA_ALLOCATION = 1024;
+
+	inline size_t align(size_t size)
+	{
+		return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	struct Block
+	{
+		// The allocations made in the block and not freed yet, plus one while
+		// the arena allocates from it.
+		LLAtomicU32 mLive;
+	};
+
+	void release(Block* block)
+	{
+		if (!--block->mLive)
+		{
+			block->~Block();
+			::operator delete(block);
+		}
+	}
+
+	class Arena
+	{
+	public:
+		Arena() : mBlock(NULL), mTop(NULL), mEnd(NULL), mNextBlockSize(FIRST_BLOCK_SIZE) { }
+		~Arena()
+		{
+			if (mBlock)
+			{
+				release(mBlock);
+			}
+		}
+
+		// Returns NULL for what should come from the heap.
+		char* allocate(size_t size)
+		{
+			if (size > MAX_ARENA_ALLOCATION)
+			{
+				return NULL;
+			}
+			if ((size_t)(mEnd - mTop) < size)
+			{
+				newBlock();
+			}
+			char* ptr = mTop;
+			mTop += size;
+			mBlock->mLive++;
+			*reinterpret_cast<Block**>(ptr) = mBlock;
+			return ptr;
+		}
+
+	private:
+		void newBlock()
+		{
+			if (mBlock)
+			{
+				release(mBlock);
+			}
+			const size_t size = mNextBlockSize;
+			mNextBlockSize = llmin(size * 2, MAX_BLOCK_SIZE);
+
+			char* memory = static_cast<char*>(::operator new(size));
+			mBlock = new (memory) Block;
+			mBlock->mLive = 1;
+			mTop = memory + align(sizeof(Block));
+			mEnd = memory + size;
+		}
+
+		Block* mBlock;
+		char* mTop;
+		char* mEnd;
+		size_t mNextBlockSize;
+	};
+
+	thread_local Arena* sArena = NULL;
+}
+
+namespace llsd
+{
+
+void* allocate(size_t size)
+{
+	const size_t total = PREFIX_SIZE + align(size);
+	char* ptr = sArena ? sArena->allocate(total) : NULL;
+	if (!ptr)
+	{
+		ptr = static_cast<char*>(::operator new(total));
+		*reinterpret_cast<Block**>(ptr) = NULL;
+	}
+	return ptr + PREFIX_SIZE;
+}
+
+void deallocate(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	char* start = static_cast<char*>(ptr) - PREFIX_SIZE;
+	Block* block = *reinterpret_cast<Block**>(start);
+	if (block)
+	{
+		release(block);
+	}
+	else
+	{
+		::operator delete(start);
+	}
+}
+
+bool ArenaScope::sEnabled = true;
+
+ArenaScope::ArenaScope()
+:	mOpened(sEnabled && !sArena)
+{
+	if (mOpened)
+	{
+		sArena = new Arena;
+	}
+}
+
+ArenaScope::~ArenaScope()
+{
+	if (mOpened)
+	{
+		delete sArena;
+		sArena = NULL;
+	}
+}
+
+} // namespace llsd
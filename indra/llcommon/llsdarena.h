@@ -0,0 +1,110 @@
+/**
+ * @file llsdarena.h
+ * @brief Arena storage for the values of parsed LLSD documents.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDARENA_H
+#define LL_LLSDARENA_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+#include "stdtypes.h"
+
+namespace llsd
+{
+
+// Every LLSD value, and every node of its maps and arrays, is allocated
+// here. While an ArenaScope is open on the calling thread, which the parsers
+// do for the document they build, these come one after the other out of
+// blocks of the arena, at the cost of bumping a pointer. Otherwise they come
+// from the heap.
+//
+// A block is freed once every allocation made in it is, from whichever
+// thread; a value kept from a document keeps the block it lives in, and the
+// other values of that block with it. Blocks stop growing at 8 KB for this,
+// so that a setting or a capability URL kept out of a large document keeps
+// at most that much of it.
+LL_COMMON_API void* allocate(size_t size);
+LL_COMMON_API void deallocate(void* ptr);
+
+// Makes the LLSD allocations of the calling thread come from an arena until
+// it goes out of scope. Scopes nest: an inner scope uses the outer arena.
+class LL_COMMON_API ArenaScope
+{
+public:
+	ArenaScope();
+	~ArenaScope();
+
+	// With arenas disabled, every allocation comes from the heap, where
+	// memory debuggers can see them one by one.
+	static void setEnabled(bool enabled)	{ sEnabled = enabled; }
+
+private:
+	ArenaScope(const ArenaScope&);
+	ArenaScope& operator=(const ArenaScope&);
+
+	bool mOpened;
+	static bool sEnabled;
+};
+
+// The allocator of the maps and arrays of LLSD.
+template<class T>
+class arena_allocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U> struct rebind { typedef arena_allocator<U> other; };
+
+	arena_allocator() { }
+	template<class U> arena_allocator(const arena_allocator<U>&) { }
+
+	T* allocate(size_t n, const void* = 0)
+	{
+		if (n > max_size())
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(llsd::allocate(n * sizeof(T)));
+	}
+	void deallocate(T* ptr, size_t)				{ llsd::deallocate(ptr); }
+	size_t max_size() const						{ return std::numeric_limits<size_t>::max() / sizeof(T); }
+};
+
+template<class T, class U>
+inline bool operator==(const arena_allocator<T>&, const arena_allocator<U>&)	{ return true; }
+template<class T, class U>
+inline bool operator!=(const arena_allocator<T>&, const arena_allocator<U>&)	{ return false; }
+
+} // namespace llsd
+
+#endif // LL_LLSDARENA_H
@@ -0,0 +1,295 @@
+/**
+ * @file llsdscan.cpp
+ * @brief Helpers of the parsers that scan serialized LLSD in memory.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llsdscan.h"
+
+#include "lluuid.h"
+
+namespace
+{
+	inline bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline S32 hex_value(char c)
+	{
+		if (c >= '0' && c <= '9')
+		{
+			return c - '0';
+		}
+		if (c >= 'a' && c <= 'f')
+		{
+			return c - 'a' + 10;
+		}
+		if (c >= 'A' && c <= 'F')
+		{
+			return c - 'A' + 10;
+		}
+		return -1;
+	}
+
+	// Every power of ten that a double holds exactly.
+	const F64 POWERS_OF_TEN[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const S32 MAX_EXACT_POWER = 22;
+	const S32 MAX_EXACT_DIGITS = 15;
+
+	const U8 BASE64_WHITESPACE = 64;
+	const U8 BASE64_PAD = 65;
+	const U8 BASE64_INVALID = 0xff;
+
+	struct Base64Table
+	{
+		Base64Table()
+		{
+			memset(mValues, BASE64_INVALID, sizeof(mValues));
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for (U8 i = 0; i < 64; ++i)
+			{
+				mValues[(U8)alphabet[i]] = i;
+			}
+			mValues[(U8)'='] = BASE64_PAD;
+		}
+
+		U8 mValues[256];
+	};
+	const Base64Table sBase64;
+
+	// What the regular expression "\s" that LLSDXMLParser strips matches.
+	inline bool is_base64_whitespace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	}
+}
+
+namespace llsd
+{
+
+const char* scan_decimal(const char* ptr, const char* end)
+{
+	if (ptr < end && (*ptr == '-' || *ptr == '+'))
+	{
+		++ptr;
+	}
+	const char* digits = ptr;
+	while (ptr < end && is_digit(*ptr))
+	{
+		++ptr;
+	}
+	if (ptr == digits)
+	{
+		return NULL;
+	}
+	if (ptr < end && *ptr == '.')
+	{
+		++ptr;
+		while (ptr < end && is_digit(*ptr))
+		{
+			++ptr;
+		}
+	}
+	if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+	{
+		++ptr;
+		if (ptr < end && (*ptr == '-' || *ptr == '+'))
+		{
+			++ptr;
+		}
+		digits = ptr;
+		while (ptr < end && is_digit(*ptr))
+		{
+			++ptr;
+		}
+		if (ptr == digits)
+		{
+			return NULL;
+		}
+	}
+	return ptr;
+}
+
+bool decimal_to_real(const char* begin, const char* end, F64& value)
+{
+	const char* ptr = begin;
+	bool negative = false;
+	if (*ptr == '-' || *ptr == '+')
+	{
+		negative = *ptr++ == '-';
+	}
+
+	U64 mantissa = 0;
+	S32 digits = 0;
+	S32 exponent = 0;
+	for ( ; ptr < end && is_digit(*ptr); ++ptr)
+	{
+		if (mantissa || *ptr != '0')
+		{
+			if (++digits > MAX_EXACT_DIGITS)
+			{
+				return false;
+			}
+			mantissa = mantissa * 10 + (*ptr - '0');
+		}
+	}
+	if (ptr < end && *ptr == '.')
+	{
+		for (++ptr; ptr < end && is_digit(*ptr); ++ptr)
+		{
+			if (mantissa || *ptr != '0')
+			{
+				if (++digits > MAX_EXACT_DIGITS)
+				{
+					return false;
+				}
+				mantissa = mantissa * 10 + (*ptr - '0');
+			}
+			--exponent;
+		}
+	}
+	if (ptr < end)
+	{
+		// The exponent.
+		++ptr;
+		bool negative_exponent = false;
+		if (*ptr == '-' || *ptr == '+')
+		{
+			negative_exponent = *ptr++ == '-';
+		}
+		S32 written = 0;
+		for ( ; ptr < end; ++ptr)
+		{
+			if (written < 10000)
+			{
+				written = written * 10 + (*ptr - '0');
+			}
+		}
+		exponent += negative_exponent ? -written : written;
+	}
+
+	if (!mantissa)
+	{
+		value = negative ? -0.0 : 0.0;
+		return true;
+	}
+	if (exponent < -MAX_EXACT_POWER || exponent > MAX_EXACT_POWER)
+	{
+		return false;
+	}
+	// Both operands are exact, so the one rounding is that of strtod().
+	F64 result = (F64)mantissa;
+	result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+	value = negative ? -result : result;
+	return true;
+}
+
+bool decode_uuid(const char* text, LLUUID& id)
+{
+	S32 pos = 0;
+	for (S32 i = 0; i < UUID_BYTES; ++i)
+	{
+		if (i == 4 || i == 6 || i == 8 || i == 10)
+		{
+			// LLUUID::set() does not look at the dashes either.
+			++pos;
+		}
+		const S32 high = hex_value(text[pos++]);
+		const S32 low = hex_value(text[pos++]);
+		if ((high | low) < 0)
+		{
+			return false;
+		}
+		id.mData[i] = (U8)((high << 4) | low);
+	}
+	return true;
+}
+
+bool decode_base64(const char* begin, const char* end, bool skip_whitespace, std::vector<U8>& data)
+{
+	data.clear();
+	data.reserve((end - begin) / 4 * 3);
+
+	U32 quad = 0;
+	S32 sextets = 0;
+	S32 padding = 0;
+	for (const char* ptr = begin; ptr < end; ++ptr)
+	{
+		const U8 value = sBase64.mValues[(U8)*ptr];
+		if (value < 64)
+		{
+			if (padding)
+			{
+				return false;
+			}
+			quad = (quad << 6) | value;
+			if (++sextets == 4)
+			{
+				data.push_back((U8)(quad >> 16));
+				data.push_back((U8)(quad >> 8));
+				data.push_back((U8)quad);
+				quad = 0;
+				sextets = 0;
+			}
+		}
+		else if (value == BASE64_PAD)
+		{
+			// Only at the end of the last quad.
+			if (sextets + padding < 2 || ++padding > 2)
+			{
+				return false;
+			}
+		}
+		else if (!skip_whitespace || !is_base64_whitespace(*ptr))
+		{
+			return false;
+		}
+	}
+	if (padding)
+	{
+		if (sextets + padding != 4)
+		{
+			return false;
+		}
+		quad <<= 6 * padding;
+		data.push_back((U8)(quad >> 16));
+		if (padding == 1)
+		{
+			data.push_back((U8)(quad >> 8));
+		}
+	}
+	else if (sextets)
+	{
+		return false;
+	}
+	return true;
+}
+
+} // namespace llsd
@@ -0,0 +1,170 @@
+/**
+ * @file llsdscan.h
+ * @brief Helpers of the parsers that scan serialized LLSD in memory.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDSCAN_H
+#define LL_LLSDSCAN_H
+
+#include <vector>
+#include <emmintrin.h>
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+
+#include "stdtypes.h"
+
+class LLUUID;
+
+namespace llsd
+{
+
+inline U32 first_set_bit(U32 mask)
+{
+#if LL_WINDOWS
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (U32)index;
+#else
+	return (U32)__builtin_ctz(mask);
+#endif
+}
+
+// The scans below look at 16 bytes at a time while there are that many left.
+
+// Returns the first of '<', '&', ']', a control character or a byte that is
+// not ASCII, or end: what ends the plain text of an XML element.
+inline const char* find_xml_text_special(const char* ptr, const char* end)
+{
+	const __m128i less = _mm_set1_epi8('<');
+	const __m128i amp = _mm_set1_epi8('&');
+	const __m128i bracket = _mm_set1_epi8(']');
+	const __m128i space = _mm_set1_epi8(' ');
+	while (end - ptr >= 16)
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+		// Compared signed, the bytes above 0x7f are below the space too.
+		const __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, less), _mm_cmpeq_epi8(chunk, amp)),
+										  _mm_or_si128(_mm_cmpeq_epi8(chunk, bracket), _mm_cmplt_epi8(chunk, space)));
+		const U32 mask = (U32)_mm_movemask_epi8(hits);
+		if (mask)
+		{
+			return ptr + first_set_bit(mask);
+		}
+		ptr += 16;
+	}
+	for ( ; ptr < end; ++ptr)
+	{
+		const U8 c = (U8)*ptr;
+		if (c == '<' || c == '&' || c == ']' || c < 0x20 || c > 0x7f)
+		{
+			break;
+		}
+	}
+	return ptr;
+}
+
+// Returns the first delim or backslash, or end: what ends the plain run of a
+// quoted notation string.
+inline const char* find_notation_string_special(const char* ptr, const char* end, char delim)
+{
+	const __m128i quote = _mm_set1_epi8(delim);
+	const __m128i backslash = _mm_set1_epi8('\\');
+	while (end - ptr >= 16)
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+		const U32 mask = (U32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+															 _mm_cmpeq_epi8(chunk, backslash)));
+		if (mask)
+		{
+			return ptr + first_set_bit(mask);
+		}
+		ptr += 16;
+	}
+	while (ptr < end && *ptr != delim && *ptr != '\\')
+	{
+		++ptr;
+	}
+	return ptr;
+}
+
+inline bool is_xml_whitespace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+// Returns the first byte that is not XML white space, or end. Most runs are
+// the indentation of pretty printed documents, or nothing at all.
+inline const char* skip_xml_whitespace(const char* ptr, const char* end)
+{
+	if (ptr == end || !is_xml_whitespace(*ptr))
+	{
+		return ptr;
+	}
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	while (end - ptr >= 16)
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+		const __m128i white = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+										   _mm_or_si128(_mm_cmpeq_epi8(chunk, tab), _mm_cmpeq_epi8(chunk, cr)));
+		const U32 mask = ~(U32)_mm_movemask_epi8(white) & 0xffff;
+		if (mask)
+		{
+			return ptr + first_set_bit(mask);
+		}
+		ptr += 16;
+	}
+	while (ptr < end && is_xml_whitespace(*ptr))
+	{
+		++ptr;
+	}
+	return ptr;
+}
+
+// Returns the end of the decimal number at ptr, as operator>>(F64&) reads
+// it: an optional sign, digits, optionally a fraction and optionally an
+// exponent. Returns NULL if there is none, or if it is one that operator>>
+// would not read in full, such as "1e".
+LL_COMMON_API const char* scan_decimal(const char* ptr, const char* end);
+
+// Converts a number found by scan_decimal(). Returns false unless it has at
+// most 15 significant digits and a small exponent, which convert exactly with
+// a single multiplication or division; the callers convert the others the
+// way they used to, through a stream.
+LL_COMMON_API bool decimal_to_real(const char* begin, const char* end, F64& value);
+
+// Decodes the 36 characters of a UUID, the way LLUUID::set() does. Returns
+// false for anything but hexadecimal digits, which LLUUID::set() then reports.
+LL_COMMON_API bool decode_uuid(const char* text, LLUUID& id);
+
+// Decodes padded base64, skipping white space if asked to. Returns false on
+// anything else; the callers hand those to LLBase64.
+LL_COMMON_API bool decode_base64(const char* begin, const char* end, bool skip_whitespace, std::vector<U8>& data);
+
+} // namespace llsd
+
+#endif // LL_LLSDSCAN_H
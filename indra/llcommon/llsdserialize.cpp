@@ -31,6 +31,8 @@
 #include "llpointer.h"
 #include "llstreamtools.h" // for fullread
 #include "llbase64.h"
+#include "llmemorystream.h"
+#include "llsdscan.h"
 
 #include <iostream>
 
@@ -331,6 +333,8 @@ S32 LLSDParser::parse(std::istream& istr, LLSD& data, S32 max_bytes)
 {
 	mCheckLimits = (LLSDSerialize::SIZE_UNLIMITED == max_bytes) ? false : true;
 	mMaxBytesLeft = max_bytes;
+	// Build the whole document in one arena.
+	llsd::ArenaScope arena;
 	return doParse(istr, data);
 }
 
@@ -340,10 +344,35 @@ S32 LLSDParser::parseLines(std::istream& istr, LLSD& data)
 {
 	mCheckLimits = false;
 	mParseLines = true;
+	llsd::ArenaScope arena;
 	return doParse(istr, data);
 }
 
 
+S32 LLSDParser::parse(const char* buffer, size_t length, LLSD& data, S32 max_bytes, size_t* consumed)
+{
+	mCheckLimits = (LLSDSerialize::SIZE_UNLIMITED == max_bytes) ? false : true;
+	mMaxBytesLeft = max_bytes;
+	llsd::ArenaScope arena;
+	size_t parsed = 0;
+	S32 parse_count = doParseBuffer(buffer, length, data, parsed);
+	if (consumed)
+	{
+		*consumed = parsed;
+	}
+	return parse_count;
+}
+
+// virtual
+S32 LLSDParser::doParseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed) const
+{
+	LLMemoryStream istr((const U8*)buffer, (S32)length);
+	S32 parse_count = doParse(istr, data);
+	consumed = length - istr.rdbuf()->in_avail();
+	return parse_count;
+}
+
+
 int LLSDParser::get(std::istream& istr) const
 {
 	if(mCheckLimits) --mMaxBytesLeft;
@@ -865,6 +894,510 @@ bool LLSDNotationParser::parseBinary(std::istream& istr, LLSD& data) const
 	return true;
 }
 
+namespace
+{
+	// Deeper documents are left to the recursion of doParse().
+	const S32 MAX_SCAN_DEPTH = 256;
+
+	inline bool is_notation_space(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	inline bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// Reads a notation document out of a buffer the way
+	// LLSDNotationParser::doParse() reads it out of a stream. It gives up,
+	// returning PARSE_FAILURE, on anything it would not read exactly as
+	// doParse() does, which includes every malformed document; the document
+	// is then parsed by doParse() instead.
+	class LLSDNotationScanner
+	{
+	public:
+		LLSDNotationScanner(const char* buffer, size_t length, bool check_limits, S32 max_bytes)
+		:	mStart(buffer),
+			mPos(buffer),
+			mEnd(buffer + length),
+			mCheckLimits(check_limits),
+			mMaxBytes(max_bytes)
+		{
+		}
+
+		// Returns the number of values parsed into data, 0 if there was
+		// nothing but white space left.
+		S32 parseValue(LLSD& data, S32 depth);
+
+		size_t consumed() const		{ return mPos - mStart; }
+
+	private:
+		S32 parseMap(LLSD& map, S32 depth);
+		S32 parseArray(LLSD& array, S32 depth);
+		bool parseBoolean(LLSD& data, const char* word, bool value);
+		bool parseInteger(LLSD& data);
+		bool parseReal(LLSD& data);
+		bool parseUUID(LLSD& data);
+		bool parseString(std::string& value);
+		bool parseDelimited(char delim, std::string& value);
+		bool parseBinary(LLSD& data);
+		bool readLength(S32& length);
+		bool fits(S32 length) const;
+
+		const char* mStart;
+		const char* mPos;
+		const char* mEnd;
+		bool mCheckLimits;
+		S32 mMaxBytes;
+	};
+
+	S32 LLSDNotationScanner::parseValue(LLSD& data, S32 depth)
+	{
+		while (mPos < mEnd && is_notation_space(*mPos))
+		{
+			++mPos;
+		}
+		if (mPos == mEnd)
+		{
+			return 0;
+		}
+		if (depth > MAX_SCAN_DEPTH)
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+
+		bool parsed = false;
+		switch (*mPos)
+		{
+		case '{':
+		case '[':
+		{
+			// Like doParse(), count the container along with its values.
+			const S32 count = *mPos == '{' ? parseMap(data, depth + 1) : parseArray(data, depth + 1);
+			return count == LLSDParser::PARSE_FAILURE ? count : count + 1;
+		}
+
+		case '!':
+			++mPos;
+			data.clear();
+			return 1;
+
+		case '0':
+			++mPos;
+			data = false;
+			return 1;
+
+		case '1':
+			++mPos;
+			data = true;
+			return 1;
+
+		case 'F':
+		case 'f':
+			parsed = parseBoolean(data, "false", false);
+			break;
+
+		case 'T':
+		case 't':
+			parsed = parseBoolean(data, "true", true);
+			break;
+
+		case 'i':
+			parsed = parseInteger(data);
+			break;
+
+		case 'r':
+			parsed = parseReal(data);
+			break;
+
+		case 'u':
+			parsed = parseUUID(data);
+			break;
+
+		case '\"':
+		case '\'':
+		case 's':
+		{
+			std::string value;
+			parsed = parseString(value);
+			data = value;
+			break;
+		}
+
+		case 'l':
+		case 'd':
+		{
+			if (mEnd - mPos < 2)
+			{
+				break;
+			}
+			const bool is_date = *mPos == 'd';
+			const char delim = mPos[1];
+			mPos += 2;
+			std::string value;
+			parsed = parseDelimited(delim, value);
+			if (parsed)
+			{
+				data = is_date ? LLSD(LLDate(value)) : LLSD(LLURI(value));
+			}
+			break;
+		}
+
+		case 'b':
+			parsed = parseBinary(data);
+			break;
+
+		default:
+			break;
+		}
+		return parsed ? 1 : LLSDParser::PARSE_FAILURE;
+	}
+
+	S32 LLSDNotationScanner::parseMap(LLSD& map, S32 depth)
+	{
+		// map: { string:object, string:object }
+		map = LLSD::emptyMap();
+		S32 parse_count = 0;
+		std::string name;
+		for (++mPos; ; )
+		{
+			while (mPos < mEnd && (*mPos == ',' || is_notation_space(*mPos)))
+			{
+				++mPos;
+			}
+			if (mPos == mEnd)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			if (*mPos == '}')
+			{
+				++mPos;
+				return parse_count;
+			}
+			if ((*mPos != '\"' && *mPos != '\'' && *mPos != 's') || !parseString(name))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+
+			while (mPos < mEnd && (*mPos == ':' || is_notation_space(*mPos)))
+			{
+				++mPos;
+			}
+			if (mPos == mEnd)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			if (*mPos == '}')
+			{
+				// doParse() drops a name without a value.
+				++mPos;
+				return parse_count;
+			}
+			LLSD child;
+			S32 count = parseValue(child, depth);
+			if (count <= 0)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			parse_count += count;
+			// The first of duplicate names stays, as with doParse().
+			map.insert(name, child);
+		}
+	}
+
+	S32 LLSDNotationScanner::parseArray(LLSD& array, S32 depth)
+	{
+		// array: [ object, object, object ]
+		array = LLSD::emptyArray();
+		S32 parse_count = 0;
+		for (++mPos; ; )
+		{
+			while (mPos < mEnd && (*mPos == ',' || is_notation_space(*mPos)))
+			{
+				++mPos;
+			}
+			if (mPos == mEnd)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			if (*mPos == ']')
+			{
+				++mPos;
+				return parse_count;
+			}
+			LLSD child;
+			S32 count = parseValue(child, depth);
+			if (count <= 0)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			parse_count += count;
+			array.append(child);
+		}
+	}
+
+	bool LLSDNotationScanner::parseBoolean(LLSD& data, const char* word, bool value)
+	{
+		// A single letter, or the whole word in any case.
+		++mPos;
+		if (mPos < mEnd && isalpha((U8)*mPos))
+		{
+			for (const char* rest = word + 1; *rest; ++rest, ++mPos)
+			{
+				if (mPos == mEnd || tolower((U8)*mPos) != *rest)
+				{
+					return false;
+				}
+			}
+		}
+		data = value;
+		return true;
+	}
+
+	bool LLSDNotationScanner::parseInteger(LLSD& data)
+	{
+		++mPos;
+		bool negative = false;
+		if (mPos < mEnd && (*mPos == '-' || *mPos == '+'))
+		{
+			negative = *mPos++ == '-';
+		}
+		// Numbers that overflow are left to operator>>.
+		const char* digits = mPos;
+		S64 value = 0;
+		while (mPos < mEnd && is_digit(*mPos) && mPos - digits < 10)
+		{
+			value = value * 10 + (*mPos++ - '0');
+		}
+		value = negative ? -value : value;
+		if (mPos == digits || (mPos < mEnd && is_digit(*mPos)) || value < S32_MIN || value > S32_MAX)
+		{
+			return false;
+		}
+		data = (S32)value;
+		return true;
+	}
+
+	bool LLSDNotationScanner::parseReal(LLSD& data)
+	{
+		++mPos;
+		const char* end = llsd::scan_decimal(mPos, mEnd);
+		if (!end)
+		{
+			return false;
+		}
+		F64 value;
+		if (!llsd::decimal_to_real(mPos, end, value))
+		{
+			std::istringstream istr(std::string(mPos, end));
+			istr >> value;
+			if (istr.fail())
+			{
+				return false;
+			}
+		}
+		mPos = end;
+		data = value;
+		return true;
+	}
+
+	bool LLSDNotationScanner::parseUUID(LLSD& data)
+	{
+		++mPos;
+		if (mEnd - mPos < UUID_STR_LENGTH - 1)
+		{
+			return false;
+		}
+		// operator>>(LLUUID&) would skip white space, and stop at a null.
+		for (const char* ptr = mPos; ptr < mPos + UUID_STR_LENGTH - 1; ++ptr)
+		{
+			if ((U8)*ptr <= ' ')
+			{
+				return false;
+			}
+		}
+		LLUUID id;
+		if (!llsd::decode_uuid(mPos, id))
+		{
+			id.set(std::string(mPos, UUID_STR_LENGTH - 1));
+		}
+		mPos += UUID_STR_LENGTH - 1;
+		data = id;
+		return true;
+	}
+
+	bool LLSDNotationScanner::parseString(std::string& value)
+	{
+		const char c = *mPos++;
+		if (c == '\"' || c == '\'')
+		{
+			return parseDelimited(c, value);
+		}
+
+		// s(size)"raw data"
+		S32 length;
+		if (!readLength(length) || mPos == mEnd || (*mPos != '\"' && *mPos != '\'') || !fits(length))
+		{
+			return false;
+		}
+		++mPos;
+		if (mEnd - mPos < length + 1 || (mPos[length] != '\"' && mPos[length] != '\''))
+		{
+			return false;
+		}
+		value.assign(mPos, length);
+		mPos += length + 1;
+		return true;
+	}
+
+	bool LLSDNotationScanner::parseDelimited(char delim, std::string& value)
+	{
+		value.clear();
+		while (true)
+		{
+			const char* run = llsd::find_notation_string_special(mPos, mEnd, delim);
+			value.append(mPos, run);
+			mPos = run;
+			if (mPos == mEnd)
+			{
+				return false;
+			}
+			if (*mPos++ == delim)
+			{
+				return true;
+			}
+
+			// An escape, as deserialize_string_delim() reads them.
+			if (mPos == mEnd)
+			{
+				return false;
+			}
+			const char c = *mPos++;
+			switch (c)
+			{
+			case 'x':
+				if (mEnd - mPos < 2)
+				{
+					return false;
+				}
+				value += (char)((hex_as_nybble(mPos[0]) << 4) | hex_as_nybble(mPos[1]));
+				mPos += 2;
+				break;
+			case 'a':
+				value += '\a';
+				break;
+			case 'b':
+				value += '\b';
+				break;
+			case 'f':
+				value += '\f';
+				break;
+			case 'n':
+				value += '\n';
+				break;
+			case 'r':
+				value += '\r';
+				break;
+			case 't':
+				value += '\t';
+				break;
+			case 'v':
+				value += '\v';
+				break;
+			default:
+				value += c;
+				break;
+			}
+		}
+	}
+
+	bool LLSDNotationScanner::parseBinary(LLSD& data)
+	{
+		// binary: b64"SGVsbG8=" or b(size)"raw data"; base 16 is left to doParse().
+		++mPos;
+		if (mPos < mEnd && *mPos == '(')
+		{
+			S32 length;
+			if (!readLength(length) || mPos == mEnd || *mPos != '\"')
+			{
+				return false;
+			}
+			++mPos;
+			// Like parseBinary(), take any character after the data as its end.
+			if (!fits(length) || mEnd - mPos < length + 1)
+			{
+				return false;
+			}
+			std::vector<U8> value((const U8*)mPos, (const U8*)mPos + length);
+			mPos += length + 1;
+			data = value;
+			return true;
+		}
+
+		if (mEnd - mPos < 4 || strncmp(mPos, "64\"", 3) != 0)
+		{
+			return false;
+		}
+		mPos += 3;
+		const char* end = (const char*)memchr(mPos, '\"', mEnd - mPos);
+		std::vector<U8> value;
+		if (!end || end == mPos || !llsd::decode_base64(mPos, end, false, value))
+		{
+			return false;
+		}
+		mPos = end + 1;
+		data = value;
+		return true;
+	}
+
+	// Reads "(size)", with the size in decimal as the formatters write it.
+	bool LLSDNotationScanner::readLength(S32& length)
+	{
+		if (mPos == mEnd || *mPos != '(')
+		{
+			return false;
+		}
+		const char* digits = ++mPos;
+		length = 0;
+		while (mPos < mEnd && is_digit(*mPos) && mPos - digits < 9)
+		{
+			length = length * 10 + (*mPos++ - '0');
+		}
+		if (mPos == digits || (*digits == '0' && mPos - digits > 1) || mPos == mEnd || *mPos != ')')
+		{
+			return false;
+		}
+		++mPos;
+		return true;
+	}
+
+	// Whether a raw value of this length is within max_bytes. This counts
+	// every byte before it, which the stream parser does not always do.
+	bool LLSDNotationScanner::fits(S32 length) const
+	{
+		return !mCheckLimits || length <= mMaxBytes - (S32)(mPos - mStart);
+	}
+}
+
+// virtual
+S32 LLSDNotationParser::doParseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed) const
+{
+	LLSDNotationScanner scanner(buffer, length, mCheckLimits, mMaxBytesLeft);
+	LLSD value;
+	S32 parse_count = scanner.parseValue(value, 0);
+	if (parse_count == PARSE_FAILURE)
+	{
+		return LLSDParser::doParseBuffer(buffer, length, data, consumed);
+	}
+	if (parse_count)
+	{
+		data = value;
+	}
+	consumed = scanner.consumed();
+	return parse_count;
+}
+
 
 /**
  * LLSDBinaryParser
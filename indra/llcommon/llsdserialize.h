@@ -85,6 +85,22 @@ public:
 	 */
 	S32 parseLines(std::istream& istr, LLSD& data);
 
+	/** 
+	 * @brief Call this method to parse a buffer for LLSD.
+	 *
+	 * Like parse(), for a document that is already in memory. The
+	 * notation and XML parsers scan the buffer directly instead of
+	 * reading it through an istream.
+	 * @param buffer The serialized data.
+	 * @param length The number of bytes in the buffer.
+	 * @param data[out] The newly parse structured data.
+	 * @param max_bytes As for parse().
+	 * @param consumed[out] If not NULL, the number of bytes parsed.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	S32 parse(const char* buffer, size_t length, LLSD& data, S32 max_bytes, size_t* consumed = NULL);
+
 	/** 
 	 * @brief Resets the parser so parse() or parseLines() can be called again for another <llsd> chunk.
 	 */
@@ -108,6 +124,19 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const = 0;
 
+	/** 
+	 * @brief Virtual base for parsing a buffer.
+	 *
+	 * The default runs doParse() on an istream over the buffer.
+	 * @param buffer The serialized data.
+	 * @param length The number of bytes in the buffer.
+	 * @param data[out] The newly parse structured data.
+	 * @param consumed[out] The number of bytes parsed.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	virtual S32 doParseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -246,6 +275,13 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Scans the buffer for the values, falling back on doParse()
+	 * for anything the scan does not read exactly as doParse() would,
+	 * malformed documents included.
+	 */
+	virtual S32 doParseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed) const;
+
 private:
 	/** 
 	 * @brief Parse a map from the istream
@@ -319,6 +355,13 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Scans the buffer for the elements, falling back on expat
+	 * for anything beyond the elements of LLSD, such as comments and
+	 * unknown elements, and for malformed documents.
+	 */
+	virtual S32 doParseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -756,6 +799,11 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	static S32 fromNotation(LLSD& sd, const char* buffer, size_t length)
+	{
+		LLPointer<LLSDNotationParser> p = new LLSDNotationParser;
+		return p->parse(buffer, length, sd, (S32)length);
+	}
 	
 	/*
 	 * XML Methods
@@ -778,19 +826,20 @@ public:
 		LLPointer<LLSDXMLParser> p = new LLSDXMLParser(emit_errors);
 		return p->parse(str, sd, LLSDSerialize::SIZE_UNLIMITED);
 	}
-	// Line oriented parser, 30% faster than fromXML(), but can
-	// only be used when you know you have the complete XML
-	// document available in the stream.
-	static S32 fromXMLDocument(LLSD& sd, std::istream& str, bool emit_errors=true)
-	{
-		LLPointer<LLSDXMLParser> p = new LLSDXMLParser(emit_errors);
-		return p->parseLines(str, sd);
-	}
+	// Reads the rest of the stream and parses it as a buffer, faster
+	// than fromXML(), but can only be used when you know you have the
+	// complete XML document available in the stream.
+	static S32 fromXMLDocument(LLSD& sd, std::istream& str, bool emit_errors=true);
 	static S32 fromXML(LLSD& sd, std::istream& str, bool emit_errors=true)
 	{
 		return fromXMLEmbedded(sd, str, emit_errors);
 //		return fromXMLDocument(sd, str, emit_errors);
 	}
+	static S32 fromXML(LLSD& sd, const char* buffer, size_t length, bool emit_errors=true)
+	{
+		LLPointer<LLSDXMLParser> p = new LLSDXMLParser(emit_errors);
+		return p->parse(buffer, length, sd, LLSDSerialize::SIZE_UNLIMITED);
+	}
 
 	/*
 	 * Binary Methods
@@ -812,6 +861,11 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	static S32 fromBinary(LLSD& sd, const char* buffer, size_t length)
+	{
+		LLPointer<LLSDBinaryParser> p = new LLSDBinaryParser;
+		return p->parse(buffer, length, sd, (S32)length);
+	}
 };
 
 //dirty little zip functions -- yell at davep
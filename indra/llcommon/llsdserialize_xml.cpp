@@ -27,6 +27,8 @@
 #include "linden_common.h"
 #include "llsdserialize_xml.h"
 #include "llbase64.h"
+#include "llmemorystream.h"
+#include "llsdscan.h"
 
 #include <iostream>
 #include <deque>
@@ -244,6 +246,7 @@ public:
 	
 	S32 parse(std::istream& input, LLSD& data);
 	S32 parseLines(std::istream& input, LLSD& data);
+	S32 parseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed);
 
 	void parsePart(const char *buf, int len);
 	
@@ -280,7 +283,10 @@ private:
 		ELEMENT_UNKNOWN
 	};
 	static Element readElement(const XML_Char* name);
+	static void setValue(Element element, const char* content, size_t length, LLSD& value);
 	
+	class Scanner;
+
 	static const XML_Char* findAttribute(const XML_Char* name, const XML_Char** pairs);
 	
 	bool mEmitErrors;
@@ -700,6 +706,28 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 	LLSD& value = *mStack.back();
 	mStack.pop_back();
 	
+	switch (element)
+	{
+		case ELEMENT_UNDEF:
+			value.clear();
+			break;
+		
+		case ELEMENT_UNKNOWN:
+			value.clear();
+			break;
+			
+		default:
+			// other values, map and array, have already been set
+			setValue(element, mCurrentContent.data(), mCurrentContent.size(), value);
+			break;
+	}
+
+	mCurrentContent.clear();
+}
+
+// static
+void LLSDXMLParser::Impl::setValue(Element element, const char* content, size_t length, LLSD& value)
+{
 	switch (element)
 	{
 		case ELEMENT_UNDEF:
@@ -707,27 +735,51 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 			break;
 		
 		case ELEMENT_BOOL:
-			value = (mCurrentContent == "true" || mCurrentContent == "1");
+			value = (length == 4 && !strncmp(content, "true", 4)) || (length == 1 && *content == '1');
 			break;
 		
 		case ELEMENT_INTEGER:
 			{
+				// Plain numbers that fit, as sscanf would read them.
+				const char* digits = content + (length && *content == '-' ? 1 : 0);
+				const char* end = content + length;
+				S64 number = 0;
+				const char* ptr = digits;
+				while (ptr < end && *ptr >= '0' && *ptr <= '9' && ptr - digits < 10)
+				{
+					number = number * 10 + (*ptr++ - '0');
+				}
+				number = digits == content ? number : -number;
+				if (ptr == end && ptr != digits && number >= S32_MIN && number <= S32_MAX)
+				{
+					value = (S32)number;
+					break;
+				}
+				std::string text(content, length);
 				S32 i;
 				// sscanf okay here with different locales - ints don't change for different locale settings like floats do.
-				if ( sscanf(mCurrentContent.c_str(), "%d", &i ) == 1 )
+				if ( sscanf(text.c_str(), "%d", &i ) == 1 )
 				{	// See if sscanf works - it's faster
 					value = i;
 				}
 				else
 				{
-					value = LLSD(mCurrentContent).asInteger();
+					value = LLSD(text).asInteger();
 				}
 			}
 			break;
 		
 		case ELEMENT_REAL:
 			{
-				value = LLSD(mCurrentContent).asReal();
+				// Most numbers convert exactly without a stream.
+				F64 r;
+				if (llsd::scan_decimal(content, content + length) == content + length &&
+					llsd::decimal_to_real(content, content + length, r))
+				{
+					value = r;
+					break;
+				}
+				value = LLSD(std::string(content, length)).asReal();
 				// removed since this breaks when locale has decimal separator that isn't '.'
 				// investigated changing local to something compatible each time but deemed higher
 				// risk that just using LLSD.asReal() each time.
@@ -744,49 +796,56 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 			break;
 		
 		case ELEMENT_STRING:
-			value = mCurrentContent;
+			value = LLSD::String(content, length);
 			break;
 		
 		case ELEMENT_UUID:
-			value = LLSD(mCurrentContent).asUUID();
+			{
+				LLUUID id;
+				if (length == UUID_STR_LENGTH - 1 && llsd::decode_uuid(content, id))
+				{
+					value = id;
+				}
+				else
+				{
+					value = LLSD(std::string(content, length)).asUUID();
+				}
+			}
 			break;
 		
 		case ELEMENT_DATE:
-			value = LLSD(mCurrentContent).asDate();
+			value = LLSD(std::string(content, length)).asDate();
 			break;
 		
 		case ELEMENT_URI:
-			value = LLSD(mCurrentContent).asURI();
+			value = LLSD(std::string(content, length)).asURI();
 			break;
 		
 		case ELEMENT_BINARY:
 		{
-			// Regex is expensive, but only fix for whitespace in base64,
-			// created by python and other non-linden systems - DEV-39358
-			// Fortunately we have very little binary passing now,
-			// so performance impact shold be negligible. + poppy 2009-09-04
-			boost::regex r;
-			r.assign("\\s");
-			std::string stripped = boost::regex_replace(mCurrentContent, r, "");
-			size_t len = LLBase64::requiredDecryptionSpace(stripped);
 			std::vector<U8> data;
-			data.resize(len);
-			len = LLBase64::decode(stripped, &data[0], len);
-			data.resize(len);
+			if (!llsd::decode_base64(content, content + length, true, data))
+			{
+				// Regex is expensive, but only fix for whitespace in base64,
+				// created by python and other non-linden systems - DEV-39358
+				// Fortunately we have very little binary passing now,
+				// so performance impact shold be negligible. + poppy 2009-09-04
+				boost::regex r;
+				r.assign("\\s");
+				std::string stripped = boost::regex_replace(std::string(content, length), r, "");
+				size_t len = LLBase64::requiredDecryptionSpace(stripped);
+				data.resize(len);
+				len = LLBase64::decode(stripped, &data[0], len);
+				data.resize(len);
+			}
 			value = data;
 			break;
 		}
 		
-		case ELEMENT_UNKNOWN:
-			value.clear();
-			break;
-			
 		default:
-			// other values, map and array, have already been set
+			// map and array are set when they start
 			break;
 	}
-
-	mCurrentContent.clear();
 }
 
 void LLSDXMLParser::Impl::characterDataHandler(const XML_Char* data, int length)
@@ -885,6 +944,571 @@ LLSDXMLParser::Impl::Element LLSDXMLParser::Impl::readElement(const XML_Char* na
 }
 
 
+// Reads an LLSD document out of a buffer the way expat and the handlers
+// above read it, as long as it holds nothing but the elements of LLSD,
+// white space between them and an XML declaration. It gives up, returning
+// PARSE_FAILURE, on anything else, such as comments, unknown elements or a
+// malformed document, which expat then parses and reports on instead.
+class LLSDXMLParser::Impl::Scanner
+{
+public:
+	Scanner(const char* buffer, size_t length)
+	:	mStart(buffer),
+		mPos(buffer),
+		mEnd(buffer + length),
+		mParseCount(0)
+	{
+	}
+
+	S32 parse(LLSD& data);
+
+	size_t consumed() const		{ return mPos - mStart; }
+
+private:
+	struct Tag
+	{
+		Element mElement;
+		bool mEnd;		// </name>
+		bool mEmpty;	// <name/>
+	};
+
+	bool readDeclaration();
+	bool readTag(Tag& tag);
+	bool readEndTag(Element element);
+	bool readText(const char*& text, size_t& length);
+	bool readReference();
+	bool readCharacter();
+	bool parseValue(const Tag& tag, LLSD& data, S32 depth);
+	bool parseMap(LLSD& map, S32 depth);
+	bool parseArray(LLSD& array, S32 depth);
+
+	bool nextTag(Tag& tag)
+	{
+		mPos = llsd::skip_xml_whitespace(mPos, mEnd);
+		return mPos < mEnd && *mPos == '<' && readTag(tag);
+	}
+
+	const char* mStart;
+	const char* mPos;
+	const char* mEnd;
+	S32 mParseCount;
+	std::string mText;	// Text that differs from the buffer, after references.
+	std::string mKey;
+};
+
+// Deeper documents are left to expat.
+static const S32 MAX_SCAN_DEPTH = 256;
+
+S32 LLSDXMLParser::Impl::Scanner::parse(LLSD& data)
+{
+	if (mEnd - mPos >= 5 && !strncmp(mPos, "<?xml", 5) && !readDeclaration())
+	{
+		return LLSDParser::PARSE_FAILURE;
+	}
+
+	Tag tag;
+	if (!nextTag(tag) || tag.mElement != ELEMENT_LLSD || tag.mEnd || tag.mEmpty || !nextTag(tag))
+	{
+		return LLSDParser::PARSE_FAILURE;
+	}
+	if (!tag.mEnd && (!parseValue(tag, data, 0) || !nextTag(tag)))
+	{
+		return LLSDParser::PARSE_FAILURE;
+	}
+	// One value at most; expat stops at the end of the llsd element.
+	if (!tag.mEnd || tag.mElement != ELEMENT_LLSD)
+	{
+		return LLSDParser::PARSE_FAILURE;
+	}
+	return mParseCount;
+}
+
+// <?xml version="1.0" encoding="UTF-8" standalone="yes"?>, where encoding
+// and standalone are optional. The encoding is UTF-8 whatever it says, as
+// reset() tells expat.
+bool LLSDXMLParser::Impl::Scanner::readDeclaration()
+{
+	static const char* const NAMES[] = { "version", "encoding", "standalone" };
+	static const S32 NAME_COUNT = LL_ARRAY_SIZE(NAMES);
+
+	mPos += 5;
+	S32 next = 0;
+	while (true)
+	{
+		const char* separator = mPos;
+		mPos = llsd::skip_xml_whitespace(mPos, mEnd);
+		if (mEnd - mPos >= 2 && mPos[0] == '?' && mPos[1] == '>')
+		{
+			mPos += 2;
+			return next > 0;
+		}
+		if (mPos == separator)
+		{
+			return false;
+		}
+
+		S32 which = next;
+		size_t name_length = 0;
+		for ( ; which < NAME_COUNT; ++which)
+		{
+			name_length = strlen(NAMES[which]);
+			if ((size_t)(mEnd - mPos) > name_length && !strncmp(mPos, NAMES[which], name_length))
+			{
+				break;
+			}
+		}
+		// The version comes first.
+		if (which == NAME_COUNT || (next == 0 && which != 0))
+		{
+			return false;
+		}
+		mPos = llsd::skip_xml_whitespace(mPos + name_length, mEnd);
+		if (mPos == mEnd || *mPos++ != '=')
+		{
+			return false;
+		}
+		mPos = llsd::skip_xml_whitespace(mPos, mEnd);
+		if (mPos == mEnd || (*mPos != '\"' && *mPos != '\''))
+		{
+			return false;
+		}
+		const char quote = *mPos++;
+		const char* value = mPos;
+		const char* end = (const char*)memchr(mPos, quote, mEnd - mPos);
+		if (!end)
+		{
+			return false;
+		}
+		const size_t length = end - value;
+		mPos = end + 1;
+		next = which + 1;
+
+		if (which == 0)
+		{
+			if (length != 3 || strncmp(value, "1.0", 3))
+			{
+				return false;
+			}
+		}
+		else if (which == 1)
+		{
+			if (!length || !isalpha((U8)*value))
+			{
+				return false;
+			}
+			for (const char* ptr = value + 1; ptr < end; ++ptr)
+			{
+				if (!isalnum((U8)*ptr) && *ptr != '.' && *ptr != '_' && *ptr != '-')
+				{
+					return false;
+				}
+			}
+		}
+		else if (!(length == 3 && !strncmp(value, "yes", 3)) && !(length == 2 && !strncmp(value, "no", 2)))
+		{
+			return false;
+		}
+	}
+}
+
+// Reads a tag of one of the LLSD elements. The only attribute read is the
+// encoding of a binary element, which must be base64.
+bool LLSDXMLParser::Impl::Scanner::readTag(Tag& tag)
+{
+	++mPos;
+	tag.mEnd = mPos < mEnd && *mPos == '/';
+	tag.mEmpty = false;
+	if (tag.mEnd)
+	{
+		++mPos;
+	}
+
+	const char* name = mPos;
+	while (mPos < mEnd && *mPos >= 'a' && *mPos <= 'z')
+	{
+		++mPos;
+	}
+	const size_t name_length = mPos - name;
+	XML_Char element_name[8];
+	if (!name_length || name_length >= sizeof(element_name) || mPos == mEnd ||
+		(*mPos != '>' && *mPos != '/' && !llsd::is_xml_whitespace(*mPos)))
+	{
+		return false;
+	}
+	memcpy(element_name, name, name_length);
+	element_name[name_length] = '\0';
+	tag.mElement = readElement(element_name);
+	if (tag.mElement == ELEMENT_UNKNOWN)
+	{
+		return false;
+	}
+
+	bool has_encoding = false;
+	while (true)
+	{
+		const char* separator = mPos;
+		mPos = llsd::skip_xml_whitespace(mPos, mEnd);
+		if (mPos == mEnd)
+		{
+			return false;
+		}
+		if (*mPos == '>')
+		{
+			++mPos;
+			return true;
+		}
+		if (*mPos == '/' && !tag.mEnd)
+		{
+			tag.mEmpty = true;
+			++mPos;
+			if (mPos == mEnd || *mPos != '>')
+			{
+				return false;
+			}
+			++mPos;
+			return true;
+		}
+
+		static const size_t ENCODING_LENGTH = 8;
+		if (tag.mEnd || tag.mElement != ELEMENT_BINARY || has_encoding || mPos == separator ||
+			(size_t)(mEnd - mPos) <= ENCODING_LENGTH || strncmp(mPos, "encoding", ENCODING_LENGTH))
+		{
+			return false;
+		}
+		mPos = llsd::skip_xml_whitespace(mPos + ENCODING_LENGTH, mEnd);
+		if (mPos == mEnd || *mPos++ != '=')
+		{
+			return false;
+		}
+		mPos = llsd::skip_xml_whitespace(mPos, mEnd);
+		if (mEnd - mPos < 8 || (*mPos != '\"' && *mPos != '\'') || strncmp(mPos + 1, "base64", 6) || mPos[7] != *mPos)
+		{
+			return false;
+		}
+		mPos += 8;
+		has_encoding = true;
+	}
+}
+
+bool LLSDXMLParser::Impl::Scanner::readEndTag(Element element)
+{
+	Tag tag;
+	return mPos < mEnd && *mPos == '<' && readTag(tag) && tag.mEnd && tag.mElement == element;
+}
+
+// Reads the text of an element up to the next tag. The text is left in the
+// buffer unless it has references, carriage returns or anything that is not
+// ASCII, when it is copied to mText.
+bool LLSDXMLParser::Impl::Scanner::readText(const char*& text, size_t& length)
+{
+	const char* start = mPos;
+	mPos = llsd::find_xml_text_special(mPos, mEnd);
+	if (mPos == mEnd)
+	{
+		return false;
+	}
+	if (*mPos == '<')
+	{
+		text = start;
+		length = mPos - start;
+		return true;
+	}
+
+	mText.assign(start, mPos);
+	while (mPos < mEnd && *mPos != '<')
+	{
+		const char c = *mPos;
+		if (c == '&')
+		{
+			if (!readReference())
+			{
+				return false;
+			}
+		}
+		else if (c == '\r')
+		{
+			// Line ends become newlines, as expat reports them.
+			mText += '\n';
+			if (++mPos < mEnd && *mPos == '\n')
+			{
+				++mPos;
+			}
+		}
+		else if (c == ']')
+		{
+			if (mEnd - mPos >= 3 && mPos[1] == ']' && mPos[2] == '>')
+			{
+				return false;
+			}
+			mText += c;
+			++mPos;
+		}
+		else if (c == '\n' || c == '\t')
+		{
+			mText += c;
+			++mPos;
+		}
+		else if (!readCharacter())
+		{
+			return false;
+		}
+		const char* run = llsd::find_xml_text_special(mPos, mEnd);
+		mText.append(mPos, run);
+		mPos = run;
+	}
+	text = mText.data();
+	length = mText.size();
+	return mPos < mEnd;
+}
+
+// Reads one of the five predefined entities, or a character reference.
+bool LLSDXMLParser::Impl::Scanner::readReference()
+{
+	static const ptrdiff_t MAX_REFERENCE = 12;
+	const char* name = mPos + 1;
+	const char* end = (const char*)memchr(name, ';', llmin(mEnd - name, MAX_REFERENCE));
+	if (!end)
+	{
+		return false;
+	}
+	const size_t length = end - name;
+	mPos = end + 1;
+
+	if (length == 2 && !strncmp(name, "lt", 2))
+	{
+		mText += '<';
+	}
+	else if (length == 2 && !strncmp(name, "gt", 2))
+	{
+		mText += '>';
+	}
+	else if (length == 3 && !strncmp(name, "amp", 3))
+	{
+		mText += '&';
+	}
+	else if (length == 4 && !strncmp(name, "quot", 4))
+	{
+		mText += '\"';
+	}
+	else if (length == 4 && !strncmp(name, "apos", 4))
+	{
+		mText += '\'';
+	}
+	else if (length >= 2 && *name == '#')
+	{
+		const bool hex = name[1] == 'x';
+		const char* digit = name + (hex ? 2 : 1);
+		if (digit == end)
+		{
+			return false;
+		}
+		U32 code = 0;
+		for ( ; digit < end; ++digit)
+		{
+			S32 value = -1;
+			if (*digit >= '0' && *digit <= '9')
+			{
+				value = *digit - '0';
+			}
+			else if (hex && *digit >= 'a' && *digit <= 'f')
+			{
+				value = *digit - 'a' + 10;
+			}
+			else if (hex && *digit >= 'A' && *digit <= 'F')
+			{
+				value = *digit - 'A' + 10;
+			}
+			if (value < 0)
+			{
+				return false;
+			}
+			code = code * (hex ? 16 : 10) + value;
+			if (code > 0x10ffff)
+			{
+				return false;
+			}
+		}
+		// The characters XML allows.
+		if (code < 0x20 ? (code != 0x9 && code != 0xa && code != 0xd) :
+			((code >= 0xd800 && code <= 0xdfff) || code == 0xfffe || code == 0xffff))
+		{
+			return false;
+		}
+		if (code < 0x80)
+		{
+			mText += (char)code;
+		}
+		else if (code < 0x800)
+		{
+			mText += (char)(0xc0 | (code >> 6));
+			mText += (char)(0x80 | (code & 0x3f));
+		}
+		else if (code < 0x10000)
+		{
+			mText += (char)(0xe0 | (code >> 12));
+			mText += (char)(0x80 | ((code >> 6) & 0x3f));
+			mText += (char)(0x80 | (code & 0x3f));
+		}
+		else
+		{
+			mText += (char)(0xf0 | (code >> 18));
+			mText += (char)(0x80 | ((code >> 12) & 0x3f));
+			mText += (char)(0x80 | ((code >> 6) & 0x3f));
+			mText += (char)(0x80 | (code & 0x3f));
+		}
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+// Reads a character beyond ASCII, which must be UTF-8 that expat accepts.
+bool LLSDXMLParser::Impl::Scanner::readCharacter()
+{
+	const U8* bytes = (const U8*)mPos;
+	size_t length;
+	U32 code;
+	if (bytes[0] >= 0xc2 && bytes[0] <= 0xdf)
+	{
+		length = 2;
+		code = bytes[0] & 0x1f;
+	}
+	else if (bytes[0] >= 0xe0 && bytes[0] <= 0xef)
+	{
+		length = 3;
+		code = bytes[0] & 0x0f;
+	}
+	else if (bytes[0] >= 0xf0 && bytes[0] <= 0xf4)
+	{
+		length = 4;
+		code = bytes[0] & 0x07;
+	}
+	else
+	{
+		// Control characters, and bytes that cannot start a character.
+		return false;
+	}
+	if ((size_t)(mEnd - mPos) < length)
+	{
+		return false;
+	}
+	for (size_t i = 1; i < length; ++i)
+	{
+		if ((bytes[i] & 0xc0) != 0x80)
+		{
+			return false;
+		}
+		code = (code << 6) | (bytes[i] & 0x3f);
+	}
+	// Overlong forms, surrogates and the two non-characters.
+	if ((length == 3 && code < 0x800) || (length == 4 && (code < 0x10000 || code > 0x10ffff)) ||
+		(code >= 0xd800 && code <= 0xdfff) || code == 0xfffe || code == 0xffff)
+	{
+		return false;
+	}
+	mText.append(mPos, length);
+	mPos += length;
+	return true;
+}
+
+bool LLSDXMLParser::Impl::Scanner::parseValue(const Tag& tag, LLSD& data, S32 depth)
+{
+	if (tag.mEnd || tag.mElement == ELEMENT_LLSD || tag.mElement == ELEMENT_KEY || depth > MAX_SCAN_DEPTH)
+	{
+		return false;
+	}
+
+	++mParseCount;
+	switch (tag.mElement)
+	{
+		case ELEMENT_MAP:
+			data = LLSD::emptyMap();
+			return tag.mEmpty || parseMap(data, depth + 1);
+
+		case ELEMENT_ARRAY:
+			data = LLSD::emptyArray();
+			return tag.mEmpty || parseArray(data, depth + 1);
+
+		default:
+		{
+			const char* text = mPos;
+			size_t length = 0;
+			if (!tag.mEmpty && (!readText(text, length) || !readEndTag(tag.mElement)))
+			{
+				return false;
+			}
+			setValue(tag.mElement, text, length, data);
+			return true;
+		}
+	}
+}
+
+bool LLSDXMLParser::Impl::Scanner::parseMap(LLSD& map, S32 depth)
+{
+	Tag tag;
+	while (nextTag(tag))
+	{
+		if (tag.mEnd)
+		{
+			return tag.mElement == ELEMENT_MAP;
+		}
+
+		// Every value follows its key. A value without one, or an empty
+		// key, is skipped by the handlers, which is left to them.
+		const char* text;
+		size_t length;
+		if (tag.mElement != ELEMENT_KEY || tag.mEmpty || !readText(text, length) || !length ||
+			!readEndTag(ELEMENT_KEY) || !nextTag(tag) || tag.mEnd)
+		{
+			return false;
+		}
+		mKey.assign(text, length);
+		// The last value of a repeated key is kept, as with the handlers.
+		if (!parseValue(tag, map[mKey], depth))
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+bool LLSDXMLParser::Impl::Scanner::parseArray(LLSD& array, S32 depth)
+{
+	Tag tag;
+	while (nextTag(tag))
+	{
+		if (tag.mEnd)
+		{
+			return tag.mElement == ELEMENT_ARRAY;
+		}
+		if (!parseValue(tag, array.append(LLSD()), depth))
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+S32 LLSDXMLParser::Impl::parseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed)
+{
+	Scanner scanner(buffer, length);
+	LLSD value;
+	S32 parse_count = scanner.parse(value);
+	if (parse_count != LLSDParser::PARSE_FAILURE)
+	{
+		data = value;
+		consumed = scanner.consumed();
+		return parse_count;
+	}
+
+	LLMemoryStream input((const U8*)buffer, (S32)length);
+	parse_count = parse(input, data);
+	consumed = length - input.rdbuf()->in_avail();
+	return parse_count;
+}
+
 
 
 
@@ -921,8 +1545,24 @@ S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 	return impl.parse(input, data);
 }
 
+// virtual
+S32 LLSDXMLParser::doParseBuffer(const char* buffer, size_t length, LLSD& data, size_t& consumed) const
+{
+	return impl.parseBuffer(buffer, length, data, consumed);
+}
+
 //	virtual 
 void LLSDXMLParser::doReset()
 {
 	impl.reset();
 }
+
+// static
+S32 LLSDSerialize::fromXMLDocument(LLSD& sd, std::istream& str, bool emit_errors)
+{
+	// Like parseLines(), skip the line ends before the document.
+	clear_eol(str);
+	std::string buffer((std::istreambuf_iterator<char>(str)), std::istreambuf_iterator<char>());
+	LLPointer<LLSDXMLParser> p = new LLSDXMLParser(emit_errors);
+	return p->parse(buffer.data(), buffer.size(), sd, LLSDSerialize::SIZE_UNLIMITED);
+}
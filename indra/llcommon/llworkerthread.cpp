@@ -34,8 +34,9 @@
 //============================================================================
 // Run on MAIN thread
 
-LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, bool should_pause) :
-	LLQueuedThread(name, threaded, should_pause)
+LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, bool should_pause,
+							   U32 max_jobs, LLJobSystem::EPriority job_priority) :
+	LLQueuedThread(name, threaded, should_pause, max_jobs, job_priority)
 {
 	mDeleteMutex = new LLMutex();
 }
@@ -277,7 +278,11 @@ void LLWorkerClass::setWorking(bool working)
 bool LLWorkerClass::yield()
 {
 	LLThread::yield();
-	mWorkerThread->checkPause();
+	if (!mWorkerThread->isPooled())
+	{
+		// A pool worker must not block on our pause condition.
+		mWorkerThread->checkPause();
+	}
 	bool res;
 	mMutex.lock();
 	res = (getFlags() & WCF_ABORT_REQUESTED) ? true : false;
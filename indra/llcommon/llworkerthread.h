@@ -83,7 +83,8 @@ private:
 	LLMutex* mDeleteMutex;
 	
 public:
-	LLWorkerThread(const std::string& name, bool threaded = true, bool should_pause = false);
+	LLWorkerThread(const std::string& name, bool threaded = true, bool should_pause = false,
+				   U32 max_jobs = 0, LLJobSystem::EPriority job_priority = LLJobSystem::PRIORITY_NORMAL);
 	~LLWorkerThread();
 
 	/*virtual*/ S32 update(F32 max_time_ms);
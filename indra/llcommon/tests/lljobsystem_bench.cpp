@@ -0,0 +1,227 @@
+/**
+ * @file lljobsystem_bench.cpp
+ * @brief Stress test of LLJobSystem under mixed cache/fetch/decode loads.
+ *
+ * Usage: lljobsystem_bench [workers] [scale]
+ *
+ * Three synthetic subsystems submit jobs shaped like the real ones: short
+ * cache jobs (hash a 16 KB block), fetch jobs that mostly wait, and long
+ * CPU bound decode jobs. Each load mix is run twice: once with a thread per
+ * subsystem, as before the job system, then on the shared pool with the
+ * same per-subsystem priorities and caps the viewer uses. Wall time,
+ * throughput and the number of stolen jobs are reported for both.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llatomic.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "lljobsystem.h"
+#include "lltimer.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+enum ELoad { LOAD_CACHE, LOAD_FETCH, LOAD_DECODE, LOAD_COUNT };
+
+static const char* LOAD_NAMES[LOAD_COUNT] = { "cache", "fetch", "decode" };
+
+// Folded into the output so the work cannot be optimized away.
+static LLAtomicU32 sChecksum(0);
+
+static void cache_job()
+{
+	// Hash a header-sized block, like an entry lookup.
+	U8 block[16 * 1024];
+	for (U32 i = 0; i < sizeof(block); ++i)
+	{
+		block[i] = (U8)(i * 31);
+	}
+	U32 hash = 2166136261u;
+	for (U32 i = 0; i < sizeof(block); ++i)
+	{
+		hash = (hash ^ block[i]) * 16777619u;
+	}
+	sChecksum += hash;
+}
+
+static void fetch_job()
+{
+	// Mostly waiting on the network, a little parsing.
+	std::this_thread::sleep_for(std::chrono::microseconds(300));
+	U32 hash = 0;
+	for (U32 i = 0; i < 2000; ++i)
+	{
+		hash = hash * 33 + i;
+	}
+	sChecksum += hash;
+}
+
+static void decode_job()
+{
+	// About a millisecond of arithmetic on a 64x64 block.
+	F32 block[64 * 64];
+	for (S32 i = 0; i < 64 * 64; ++i)
+	{
+		block[i] = (F32)i;
+	}
+	for (S32 pass = 0; pass < 60; ++pass)
+	{
+		for (S32 i = 1; i < 64 * 64; ++i)
+		{
+			block[i] = block[i] * 0.999f + block[i - 1] * 0.001f;
+		}
+	}
+	sChecksum += (U32)block[64 * 64 - 1];
+}
+
+typedef void (*job_t)();
+static const job_t JOBS[LOAD_COUNT] = { cache_job, fetch_job, decode_job };
+
+// Same priorities and caps as the viewer: the texture cache runs one job at
+// a time at high priority, decoding fills the pool.
+static const LLJobSystem::EPriority PRIORITIES[LOAD_COUNT] =
+	{ LLJobSystem::PRIORITY_HIGH, LLJobSystem::PRIORITY_NORMAL, LLJobSystem::PRIORITY_NORMAL };
+static const U32 CAPS[LOAD_COUNT] = { 1, 8, 0 };
+
+struct Mix
+{
+	const char* mName;
+	U32 mCount[LOAD_COUNT];
+};
+
+// One thread per subsystem, each running its jobs back to back.
+static F64 run_dedicated(const Mix& mix)
+{
+	LLTimer timer;
+	std::vector<std::thread> threads;
+	for (S32 load = 0; load < LOAD_COUNT; ++load)
+	{
+		const U32 count = mix.mCount[load];
+		const job_t job = JOBS[load];
+		threads.push_back(std::thread([count, job]()
+			{
+				for (U32 i = 0; i < count; ++i)
+				{
+					job();
+				}
+			}));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	return timer.getElapsedTimeF64();
+}
+
+static F64 run_pooled(const Mix& mix, U32& stolen)
+{
+	LLJobSystem* jobs = LLJobSystem::getInstance();
+	LLJobSystem::channel_t channels[LOAD_COUNT];
+	for (S32 load = 0; load < LOAD_COUNT; ++load)
+	{
+		channels[load] = jobs->addChannel(llformat("%s %s", mix.mName, LOAD_NAMES[load]), PRIORITIES[load], CAPS[load]);
+	}
+	const U32 stolen_before = jobs->getStolen();
+
+	LLTimer timer;
+	// Interleave the submissions, as the subsystems would.
+	U32 max_count = 0;
+	for (S32 load = 0; load < LOAD_COUNT; ++load)
+	{
+		max_count = llmax(max_count, mix.mCount[load]);
+	}
+	for (U32 i = 0; i < max_count; ++i)
+	{
+		for (S32 load = 0; load < LOAD_COUNT; ++load)
+		{
+			if (i < mix.mCount[load])
+			{
+				jobs->submit(channels[load], JOBS[load]);
+			}
+		}
+	}
+	bool busy = true;
+	while (busy)
+	{
+		busy = false;
+		for (S32 load = 0; load < LOAD_COUNT; ++load)
+		{
+			busy = busy || jobs->getOutstanding(channels[load]) > 0;
+		}
+		if (busy)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+	const F64 elapsed = timer.getElapsedTimeF64();
+
+	for (S32 load = 0; load < LOAD_COUNT; ++load)
+	{
+		llassert_always(jobs->getCompleted(channels[load]) == mix.mCount[load]);
+	}
+	stolen = jobs->getStolen() - stolen_before;
+	return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const U32 workers = argc > 1 ? atoi(argv[1]) : 0;
+	const U32 scale = argc > 2 ? llmax(atoi(argv[2]), 1) : 1;
+	LLJobSystem::initClass(workers);
+	std::cout << LLJobSystem::getInstance()->getNumWorkers() << " workers" << std::endl;
+
+	const Mix mixes[] = {
+		{ "cache heavy",	{ 20000 * scale,	200 * scale,	200 * scale } },
+		{ "fetch heavy",	{ 2000 * scale,		2000 * scale,	200 * scale } },
+		{ "decode heavy",	{ 2000 * scale,		200 * scale,	2000 * scale } },
+		{ "mixed",			{ 10000 * scale,	1000 * scale,	1000 * scale } },
+	};
+
+	for (const Mix& mix : mixes)
+	{
+		U32 total = 0;
+		for (S32 load = 0; load < LOAD_COUNT; ++load)
+		{
+			total += mix.mCount[load];
+		}
+		const F64 dedicated = run_dedicated(mix);
+		U32 stolen = 0;
+		const F64 pooled = run_pooled(mix, stolen);
+
+		std::cout << llformat("%-13s %6u jobs: dedicated %8.1f ms %9.0f jobs/s | pooled %8.1f ms %9.0f jobs/s, %6u stolen | speedup %.2fx",
+							  mix.mName, total, dedicated * 1000.0, total / dedicated,
+							  pooled * 1000.0, total / pooled, stolen, dedicated / pooled)
+				  << std::endl;
+	}
+	std::cout << "checksum " << (U32)sChecksum << std::endl;
+
+	LLJobSystem::cleanupClass();
+	return 0;
+}
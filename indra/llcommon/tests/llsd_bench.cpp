@@ -0,0 +1,219 @@
+/**
+ * @file llsd_bench.cpp
+ * @brief Parsing, walking and freeing LLSD documents, with and without arenas.
+ *
+ * Usage: llsd_bench [items] [passes]
+ *
+ * Builds an inventory listing shaped like an AIS reply, 10000 items by
+ * default, each a map of ids, names, masks and a sale info, and serializes
+ * it as XML, notation and binary. Each serialization is then parsed, walked
+ * and freed several times: once with every value allocated on its own, as
+ * before, and once with the document built in an arena. Every parse must
+ * give back the document serialized.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "llsd.h"
+#include "llsdarena.h"
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "lltimer.h"
+
+#include <iostream>
+#include <sstream>
+
+enum EFormat { FORMAT_XML, FORMAT_NOTATION, FORMAT_BINARY, FORMAT_COUNT };
+
+static const char* FORMAT_NAMES[FORMAT_COUNT] = { "XML", "notation", "binary" };
+
+static LLUUID make_id(U32 i, U32 salt)
+{
+	LLUUID id;
+	for (S32 j = 0; j < UUID_BYTES; ++j)
+	{
+		id.mData[j] = (U8)((i * 2654435761u + salt * 40503u) >> ((j % 4) * 8)) ^ (U8)j;
+	}
+	return id;
+}
+
+static LLSD make_listing(S32 num_items)
+{
+	LLSD items = LLSD::emptyArray();
+	const LLUUID folder_id = make_id(0, 1);
+	for (S32 i = 0; i < num_items; ++i)
+	{
+		LLSD permissions;
+		permissions["owner_id"] = make_id(i, 2);
+		permissions["creator_id"] = make_id(i % 97, 3);
+		permissions["group_id"] = LLUUID::null;
+		permissions["base_mask"] = (LLSD::Integer)0x7fffffff;
+		permissions["owner_mask"] = (LLSD::Integer)0x7fffffff;
+		permissions["group_mask"] = 0;
+		permissions["everyone_mask"] = 0;
+		permissions["next_owner_mask"] = (LLSD::Integer)0x82000;
+		permissions["is_owner_group"] = false;
+
+		LLSD sale_info;
+		sale_info["sale_price"] = i % 500;
+		sale_info["sale_type"] = 0;
+
+		LLSD item;
+		item["item_id"] = make_id(i, 4);
+		item["parent_id"] = folder_id;
+		item["asset_id"] = make_id(i, 5);
+		item["name"] = llformat("Item %d of the listing", i);
+		item["desc"] = (i % 3) ? std::string("(No Description)") : llformat("Described item %d", i);
+		item["type"] = i % 24;
+		item["inv_type"] = i % 20;
+		item["flags"] = i % 7;
+		item["created_at"] = (LLSD::Integer)(1500000000 + i);
+		item["permissions"] = permissions;
+		item["sale_info"] = sale_info;
+		items.append(item);
+	}
+
+	LLSD listing;
+	listing["folder_id"] = folder_id;
+	listing["owner_id"] = make_id(0, 2);
+	listing["version"] = 42;
+	listing["descendents"] = num_items;
+	listing["items"] = items;
+	return listing;
+}
+
+static std::string serialize(const LLSD& sd, EFormat format)
+{
+	std::ostringstream out;
+	switch (format)
+	{
+		case FORMAT_XML:		LLSDSerialize::toXML(sd, out);		break;
+		case FORMAT_NOTATION:	LLSDSerialize::toNotation(sd, out);	break;
+		default:				LLSDSerialize::toBinary(sd, out);	break;
+	}
+	return out.str();
+}
+
+static bool parse(LLSD& sd, const std::string& data, EFormat format)
+{
+	std::istringstream in(data);
+	switch (format)
+	{
+		case FORMAT_XML:		return LLSDSerialize::fromXML(sd, in) > 0;
+		case FORMAT_NOTATION:	return LLSDSerialize::fromNotation(sd, in, data.size()) > 0;
+		default:				return LLSDSerialize::fromBinary(sd, in, data.size()) > 0;
+	}
+}
+
+// What a reader of the reply does: visit every value.
+static U64 walk(const LLSD& sd)
+{
+	switch (sd.type())
+	{
+		case LLSD::TypeMap:
+		{
+			U64 sum = 0;
+			for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+			{
+				sum += it->first.size() + walk(it->second);
+			}
+			return sum;
+		}
+		case LLSD::TypeArray:
+		{
+			U64 sum = 0;
+			for (LLSD::array_const_iterator it = sd.beginArray(); it != sd.endArray(); ++it)
+			{
+				sum += walk(*it);
+			}
+			return sum;
+		}
+		case LLSD::TypeString:
+			return sd.asStringRef().size();
+		case LLSD::TypeUUID:
+			return sd.asUUID().mData[0];
+		default:
+			return (U64)sd.asInteger();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 num_items = argc > 1 ? atoi(argv[1]) : 10000;
+	const S32 passes = argc > 2 ? atoi(argv[2]) : 10;
+
+	const LLSD listing = make_listing(num_items);
+	const U64 expected_walk = walk(listing);
+
+	bool ok = true;
+	for (S32 format = 0; format < FORMAT_COUNT; ++format)
+	{
+		const std::string data = serialize(listing, (EFormat)format);
+		for (S32 arena = 0; arena < 2; ++arena)
+		{
+			llsd::ArenaScope::setEnabled(arena != 0);
+
+			F64 parse_time = 0.0;
+			F64 walk_time = 0.0;
+			F64 free_time = 0.0;
+			for (S32 pass = 0; pass < passes; ++pass)
+			{
+				LLTimer timer;
+				LLSD sd;
+				if (!parse(sd, data, (EFormat)format))
+				{
+					ok = false;
+				}
+				parse_time += timer.getElapsedTimeF64();
+
+				timer.reset();
+				const U64 walked = walk(sd);
+				walk_time += timer.getElapsedTimeF64();
+
+				if (walked != expected_walk || (pass == 0 && !llsd_equals(sd, listing)))
+				{
+					std::cerr << FORMAT_NAMES[format] << ": the parsed document differs from the serialized one" << std::endl;
+					ok = false;
+				}
+
+				timer.reset();
+				sd.clear();
+				free_time += timer.getElapsedTimeF64();
+			}
+
+			std::cout << llformat("%-8s %-5s %6.1f MB/s parse %7.2fms | walk %6.2fms | free %6.2fms per document",
+								  FORMAT_NAMES[format], arena ? "arena" : "heap",
+								  data.size() * passes / parse_time / (1024.0 * 1024.0), parse_time * 1000.0 / passes,
+								  walk_time * 1000.0 / passes, free_time * 1000.0 / passes) << std::endl;
+		}
+	}
+
+	llsd::ArenaScope::setEnabled(true);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+/**
+ * @file llsdparse_bench.cpp
+ * @brief Parsing XML and notation LLSD from streams and from buffers.
+ *
+ * Usage: llsdparse_bench [scale] [passes]
+ *
+ * Builds documents shaped like three large capability replies: an inventory
+ * fetch of folders full of items, an object cost reply and a list of sky
+ * settings. Each is serialized as XML, pretty printed XML and notation, then
+ * parsed from an istream, as before, and from a buffer, which scans it
+ * directly. Both must give the same document.
+ *
+ * Before that, a set of unusual and malformed documents is parsed both ways,
+ * and must give the same result, failures included: the buffer parsers hand
+ * what they do not read themselves to the stream parsers.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "lltimer.h"
+
+#include <iostream>
+#include <sstream>
+
+enum EFormat { FORMAT_XML, FORMAT_PRETTY_XML, FORMAT_NOTATION, FORMAT_COUNT };
+
+static const char* FORMAT_NAMES[FORMAT_COUNT] = { "XML", "pretty XML", "notation" };
+
+static LLUUID make_id(U32 i, U32 salt)
+{
+	LLUUID id;
+	for (S32 j = 0; j < UUID_BYTES; ++j)
+	{
+		id.mData[j] = (U8)((i * 2654435761u + salt * 40503u) >> ((j % 4) * 8)) ^ (U8)j;
+	}
+	return id;
+}
+
+// FetchInventoryDescendents2: folders, each with its categories and items.
+static LLSD make_inventory(S32 scale)
+{
+	LLSD folders = LLSD::emptyArray();
+	for (S32 f = 0; f < scale; ++f)
+	{
+		LLSD folder;
+		folder["folder_id"] = make_id(f, 1);
+		folder["owner_id"] = make_id(0, 2);
+		folder["agent_id"] = make_id(0, 2);
+		folder["version"] = 40 + f;
+		LLSD categories = LLSD::emptyArray();
+		for (S32 c = 0; c < 4; ++c)
+		{
+			LLSD category;
+			category["category_id"] = make_id(f * 4 + c, 6);
+			category["parent_id"] = make_id(f, 1);
+			category["name"] = llformat("Folder & subfolder <%d>", c);
+			category["type"] = -1;
+			category["preferred_type"] = c == 0 ? 8 : -1;
+			categories.append(category);
+		}
+		folder["categories"] = categories;
+
+		LLSD items = LLSD::emptyArray();
+		for (S32 i = f * 50; i < f * 50 + 50; ++i)
+		{
+			LLSD permissions;
+			permissions["owner_id"] = make_id(i, 2);
+			permissions["creator_id"] = make_id(i % 97, 3);
+			permissions["group_id"] = LLUUID::null;
+			permissions["base_mask"] = (LLSD::Integer)0x7fffffff;
+			permissions["owner_mask"] = (LLSD::Integer)0x7fffffff;
+			permissions["group_mask"] = 0;
+			permissions["everyone_mask"] = 0;
+			permissions["next_owner_mask"] = (LLSD::Integer)0x82000;
+			permissions["is_owner_group"] = false;
+
+			LLSD sale_info;
+			sale_info["sale_price"] = i % 500;
+			sale_info["sale_type"] = 0;
+
+			LLSD item;
+			item["item_id"] = make_id(i, 4);
+			item["parent_id"] = make_id(f, 1);
+			item["asset_id"] = make_id(i, 5);
+			item["name"] = llformat("Item %d \"of\" the folder", i);
+			item["desc"] = (i % 3) ? std::string("(No Description)") : llformat("Caf\xc3\xa9 item %d", i);
+			item["type"] = i % 24;
+			item["inv_type"] = i % 20;
+			item["flags"] = i % 7;
+			item["created_at"] = (LLSD::Integer)(1500000000 + i);
+			item["permissions"] = permissions;
+			item["sale_info"] = sale_info;
+			items.append(item);
+		}
+		folder["items"] = items;
+		folder["descendents"] = 54;
+		folders.append(folder);
+	}
+	LLSD reply;
+	reply["folders"] = folders;
+	return reply;
+}
+
+// GetObjectCost: the costs of every object asked about, by id.
+static LLSD make_object_costs(S32 scale)
+{
+	LLSD reply = LLSD::emptyMap();
+	for (S32 i = 0; i < scale * 40; ++i)
+	{
+		LLSD costs;
+		costs["linked_set_resource_cost"] = 1.0 + (i % 300) * 0.5;
+		costs["resource_cost"] = 0.25 + (i % 17) * 0.125;
+		costs["physics_cost"] = (i % 11) * 0.1;
+		costs["linked_set_physics_cost"] = 3.0 + (i % 5) / 3.0;
+		costs["resource_limiting_type"] = "legacy";
+		reply[make_id(i, 7).asString()] = costs;
+	}
+	return reply;
+}
+
+static LLSD make_array(F64 a, F64 b)
+{
+	LLSD array = LLSD::emptyArray();
+	array.append(a);
+	array.append(b);
+	return array;
+}
+
+static LLSD make_array(F64 a, F64 b, F64 c, F64 d)
+{
+	LLSD array = make_array(a, b);
+	array.append(c);
+	array.append(d);
+	return array;
+}
+
+// Sky settings, as a day cycle brings them: colors, layers and ids.
+static LLSD make_skies(S32 scale)
+{
+	LLSD skies = LLSD::emptyArray();
+	for (S32 s = 0; s < scale; ++s)
+	{
+		const F64 t = s * 0.01;
+		LLSD sky;
+		sky["ambient"] = make_array(0.25 + t, 0.3 + t, 0.45 + t, 1.0);
+		sky["blue_density"] = make_array(0.2447, 0.4487, 0.7599 + t, 1.0);
+		sky["blue_horizon"] = make_array(0.4954, 0.4954, 0.6399, 1.0);
+		sky["cloud_color"] = make_array(0.41, 0.41, 0.41, 1.0);
+		sky["cloud_pos_density1"] = make_array(1.6884, 0.5261, 1.0, 1.0);
+		sky["cloud_scroll_rate"] = make_array(0.2, 0.01 + t);
+		sky["cloud_shadow"] = 0.27;
+		sky["cloud_id"] = make_id(s, 8);
+		sky["sun_rotation"] = make_array(0.0, -0.7071, 0.0, 0.7071);
+		sky["gamma"] = 1.0;
+		sky["star_brightness"] = 250.0 + s;
+		sky["max_y"] = 1605;
+		sky["name"] = llformat("Midday %d", s);
+		LLSD layers = LLSD::emptyArray();
+		for (S32 l = 0; l < 3; ++l)
+		{
+			LLSD layer;
+			layer["constant_term"] = 1.0;
+			layer["exp_scale"] = -1.0 / 8000.0 * (l + 1);
+			layer["exp_term"] = 1.0 + l;
+			layer["linear_term"] = 0.0;
+			layer["width"] = 25000.0;
+			layers.append(layer);
+		}
+		sky["rayleigh_config"] = layers;
+		std::vector<U8> hash;
+		for (S32 b = 0; b < 20; ++b)
+		{
+			hash.push_back((U8)(s * 31 + b));
+		}
+		sky["hash"] = hash;
+		skies.append(sky);
+	}
+	return skies;
+}
+
+static std::string serialize(const LLSD& sd, EFormat format)
+{
+	std::ostringstream out;
+	switch (format)
+	{
+		case FORMAT_XML:			LLSDSerialize::toXML(sd, out);			break;
+		case FORMAT_PRETTY_XML:		LLSDSerialize::toPrettyXML(sd, out);	break;
+		default:					LLSDSerialize::toNotation(sd, out);		break;
+	}
+	return out.str();
+}
+
+static S32 parse_stream(LLSD& sd, const std::string& data, bool notation)
+{
+	std::istringstream in(data);
+	return notation ? LLSDSerialize::fromNotation(sd, in, data.size()) : LLSDSerialize::fromXML(sd, in, false);
+}
+
+static S32 parse_buffer(LLSD& sd, const std::string& data, bool notation)
+{
+	return notation ? LLSDSerialize::fromNotation(sd, data.data(), data.size())
+					: LLSDSerialize::fromXML(sd, data.data(), data.size(), false);
+}
+
+// Both ways must agree, on the count and on the document.
+static bool agree(const std::string& data, bool notation)
+{
+	LLSD from_stream;
+	LLSD from_buffer;
+	const S32 stream_count = parse_stream(from_stream, data, notation);
+	const S32 buffer_count = parse_buffer(from_buffer, data, notation);
+	if (stream_count != buffer_count || !llsd_equals(from_stream, from_buffer))
+	{
+		std::cerr << (notation ? "notation" : "XML") << " parsers disagree (" << stream_count << " values against "
+				  << buffer_count << ") on: " << data << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool check_unusual_documents()
+{
+	static const char* const XML_DOCUMENTS[] =
+	{
+		"<llsd><string>a &lt;b&gt; &amp; &quot;c&quot; &apos;d&apos; &#65;&#x42;&#x20AC;&#x1F600;</string></llsd>",
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<llsd><map><key>k</key><integer>5</integer></map></llsd>",
+		"<?xml version='1.0' standalone='yes' ?><llsd><real>1.5</real></llsd>",
+		"<?xml version=\"1.1\"?><llsd><real>1.5</real></llsd>",
+		" <?xml version=\"1.0\"?><llsd><real>1.5</real></llsd>",
+		"<llsd><string>line\r\nline\rline\n\tend</string></llsd>",
+		"<llsd><string>caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80</string></llsd>",
+		"<llsd><string>bad \xc3\x28 utf-8</string></llsd>",
+		"<llsd><string>overlong \xc0\xaf</string></llsd>",
+		"<llsd><string>surrogate \xed\xa0\x80</string></llsd>",
+		"<llsd><string>control \x01</string></llsd>",
+		"<llsd><string>a ]]> b</string></llsd>",
+		"<llsd><string>a ] b ]] c</string></llsd>",
+		"<llsd><string>a <!-- comment --> b</string></llsd>",
+		"<llsd><string><![CDATA[<raw>]]></string></llsd>",
+		"<llsd><string>&unknown;</string></llsd>",
+		"<llsd><string>&#0;</string></llsd>",
+		"<llsd><map><key>a</key><integer>1</integer><key>a</key><integer>2</integer></map></llsd>",
+		"<llsd><map><key></key><integer>1</integer><key>b</key><integer>2</integer></map></llsd>",
+		"<llsd><map><integer>1</integer><key>b</key><integer>2</integer></map></llsd>",
+		"<llsd><map><key>a</key><key>b</key><integer>2</integer></map></llsd>",
+		"<llsd><map><key>a</key></map></llsd>",
+		"<llsd><array><undef/><map/><array /><string/><integer/><real/><uuid/><boolean/><binary/></array></llsd>",
+		"<llsd><array><boolean>true</boolean><boolean>1</boolean><boolean>TRUE</boolean><boolean>0</boolean></array></llsd>",
+		"<llsd><array><integer>12</integer><integer> 12</integer><integer>-7</integer><integer>12abc</integer>"
+			"<integer>2147483647</integer><integer>-2147483648</integer><integer>2147483648</integer><integer>99999999999</integer><integer>1.9</integer><integer>x</integer></array></llsd>",
+		"<llsd><array><real>1.5</real><real> 1.5</real><real>1.5 </real><real>-0</real><real>.5</real><real>1e400</real>"
+			"<real>1.7976931348623157e308</real><real>0.1000000000000000055511151231257827</real><real>nan</real>"
+			"<real>1e-5</real><real>123456789012345678</real><real>+2.5E+3</real></array></llsd>",
+		"<llsd><array><uuid>67153d5b-3659-afb4-8510-adda2c034649</uuid><uuid>67153D5B-3659-AFB4-8510-ADDA2C034649</uuid>"
+			"<uuid>67153d5b36599afb448510aadda2c034649</uuid><uuid>not a uuid</uuid></array></llsd>",
+		"<llsd><array><binary>SGVsbG8=</binary><binary encoding=\"base64\">SGVs\n bG8h</binary>"
+			"<binary encoding=\"base16\">48</binary><binary>SGVsbG8</binary></array></llsd>",
+		"<llsd><array><date>2006-02-01T14:29:53Z</date><uri>http://example.com/a?b=c&amp;d</uri></array></llsd>",
+		"<llsd><array><foo>1</foo><integer>2</integer></array></llsd>",
+		"<llsd><integer>1</integer><integer>2</integer></llsd>",
+		"<llsd></llsd>",
+		"<llsd><map><key>a</key><integer>1</integer></map>",
+		"<llsd><map><key>a</key><integer>1</integer></array></llsd>",
+		"<llsd xmlns=\"x\"><integer>1</integer></llsd>",
+		"<llsd><map>junk<key>a</key>junk<integer>1</integer></map></llsd>",
+		"<llsd><map>\n  <key>a</key>\n  <integer>1</integer>\n</map></llsd>trailing",
+		"",
+	};
+	static const char* const NOTATION_DOCUMENTS[] =
+	{
+		"{'a':i1,\"b\":r2.5,'c':s(3)\"xyz\",'d':u67153d5b-3659-afb4-8510-adda2c034649}",
+		"['esc\\n\\t\\x41\\'\\\\', \"dq\\\"\", s(0)\"\"]",
+		"[!,0,1,t,f,T,F,true,false,TRUE,FALSE,tRuE]",
+		"[tru]",
+		"[i2147483647,i-2147483648,i99999999999,i+5,i-,i 5]",
+		"[i5.5]",
+		"[i2147483648]",
+		"[i-2147483649]",
+		"[r1.5,r-0,r1e5,r1.e5,r1e,r.5,r1e400,r0.1000000000000000055511151231257827,rnan]",
+		"[u67153d5b-3659-afb4-8510-adda2c034649,u00000000-0000-0000-0000-00000000000g]",
+		"[u6715 d5b-3659-afb4-8510-adda2c034649]",
+		"[b64\"SGVsbG8=\",b(5)\"Hello\",b16\"48656c6c6f\",b64\"\",b64\"SGVsbG8\"]",
+		"[b(5)\"Hel\"]",
+		"[d\"2006-02-01T14:29:53Z\",l\"http://example.com/\"]",
+		"{'a':i1,'a':i2}",
+		"{'a' i1 'b':i2}",
+		"{'a'}",
+		"{'a':i1,x'b':i2}",
+		"{s(1)\"k\":[[[{}]]]}",
+		"[s(010)\"0123456789\"]",
+		"[s(99)\"short\"]",
+		"   ",
+		"[1,2",
+		"{'a':i1} trailing",
+		"i5",
+		"?",
+	};
+
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(XML_DOCUMENTS) / sizeof(XML_DOCUMENTS[0]); ++i)
+	{
+		ok = agree(XML_DOCUMENTS[i], false) && ok;
+	}
+	for (size_t i = 0; i < sizeof(NOTATION_DOCUMENTS) / sizeof(NOTATION_DOCUMENTS[0]); ++i)
+	{
+		ok = agree(NOTATION_DOCUMENTS[i], true) && ok;
+	}
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_NONE);
+
+	const S32 scale = argc > 1 ? atoi(argv[1]) : 200;
+	const S32 passes = argc > 2 ? atoi(argv[2]) : 10;
+
+	bool ok = check_unusual_documents();
+
+	static const char* const DOCUMENT_NAMES[] = { "inventory", "object cost", "skies" };
+	const LLSD documents[] = { make_inventory(scale), make_object_costs(scale), make_skies(scale) };
+	for (S32 doc = 0; doc < 3; ++doc)
+	{
+		for (S32 format = 0; format < FORMAT_COUNT; ++format)
+		{
+			const std::string data = serialize(documents[doc], (EFormat)format);
+			const bool notation = format == FORMAT_NOTATION;
+
+			LLSD reference;
+			parse_stream(reference, data, notation);
+
+			F64 times[2] = { 0.0, 0.0 };
+			for (S32 buffer = 0; buffer < 2; ++buffer)
+			{
+				for (S32 pass = 0; pass < passes; ++pass)
+				{
+					LLSD sd;
+					LLTimer timer;
+					const S32 count = buffer ? parse_buffer(sd, data, notation) : parse_stream(sd, data, notation);
+					times[buffer] += timer.getElapsedTimeF64();
+					if (count <= 0 || (pass == 0 && !llsd_equals(sd, reference)))
+					{
+						std::cerr << DOCUMENT_NAMES[doc] << " as " << FORMAT_NAMES[format]
+								  << ": the parsers give different documents" << std::endl;
+						ok = false;
+					}
+				}
+			}
+
+			const F64 megabytes = data.size() * passes / (1024.0 * 1024.0);
+			std::cout << llformat("%-12s %-10s %6.2f MB | stream %6.1f MB/s | buffer %6.1f MB/s | %4.1fx",
+								  DOCUMENT_NAMES[doc], FORMAT_NAMES[format], data.size() / (1024.0 * 1024.0),
+								  megabytes / times[0], megabytes / times[1], times[0] / times[1]) << std::endl;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
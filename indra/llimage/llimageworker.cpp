@@ -29,21 +29,54 @@
 #include "llimageworker.h"
 #include "llimagedxt.h"
 
+#include <thread>
+
 //----------------------------------------------------------------------------
 
+static U32 decode_pool_size(bool threaded, U32 num_workers)
+{
+	if (!threaded)
+	{
+		return 0;
+	}
+	if (!num_workers)
+	{
+		// Leave a core to the main thread.
+		U32 cores = std::thread::hardware_concurrency();
+		num_workers = llclamp(cores > 1 ? cores - 1 : 1U, 1U, 16U);
+	}
+	return num_workers;
+}
+
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
-	: LLQueuedThread("imagedecode", threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, U32 num_workers)
+	: LLQueuedThread("imagedecode", threaded, false,
+					 decode_pool_size(threaded, num_workers), LLJobSystem::PRIORITY_NORMAL)
 {
 	mCreationMutex = new LLMutex();
+	if (threaded)
+	{
+		LL_INFOS() << "Image decode pool started with " << getNumWorkers() << " threads" << LL_ENDL;
+	}
 }
 
 //virtual 
 LLImageDecodeThread::~LLImageDecodeThread()
 {
+	// Wait for the jobs in flight before our members go away.
+	shutdown();
 	delete mCreationMutex ;
 }
 
+U32 LLImageDecodeThread::getNumWorkers() const
+{
+	if (isPooled())
+	{
+		return llmin(mMaxJobs, LLJobSystem::getInstance()->getNumWorkers());
+	}
+	return mThreaded ? 1 : 0;
+}
+
 // MAIN THREAD
 // virtual
 S32 LLImageDecodeThread::update(F32 max_time_ms)
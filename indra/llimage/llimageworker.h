@@ -31,6 +31,11 @@
 #include "llpointer.h"
 #include "llworkerthread.h"
 
+// Decodes as jobs on the shared LLJobSystem, up to num_workers at a time.
+// Every job takes the next request from the one priority queue, so requests
+// are still started in priority order and each Responder is called exactly
+// once, from whichever worker finished the decode. Without a job system this
+// falls back to a single decode thread.
 class LLImageDecodeThread : public LLQueuedThread
 {
 public:
@@ -72,9 +77,13 @@ public:
 	};
 	
 public:
-	LLImageDecodeThread(bool threaded = true);
+	// num_workers == 0 sizes the pool from the hardware concurrency.
+	LLImageDecodeThread(bool threaded = true, U32 num_workers = 0);
 	virtual ~LLImageDecodeThread();
 
+	// Number of requests that can be decoded at the same time.
+	U32 getNumWorkers() const;
+
 	handle_t decodeImage(LLImageFormatted* image,
 						 U32 priority, S32 discard, BOOL needs_aux,
 						 Responder* responder);
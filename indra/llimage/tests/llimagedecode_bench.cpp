@@ -0,0 +1,150 @@
+/**
+ * @file llimagedecode_bench.cpp
+ * @brief Decode throughput of the LLImageDecodeThread pool per worker count.
+ *
+ * Usage: llimagedecode_bench <directory of .j2c files> [max workers]
+ *
+ * Every .j2c file of the directory is loaded once, then the whole corpus is
+ * decoded through an LLImageDecodeThread allowed 1, 2, 4... concurrent jobs
+ * on the job system and the throughput is reported for each pool size.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llapr.h"
+#include "llatomic.h"
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llerrorcontrol.h"
+#include "llimagej2c.h"
+#include "llimageworker.h"
+#include "lljobsystem.h"
+#include "lltimer.h"
+
+#include <iostream>
+#include <thread>
+
+class BenchResponder : public LLImageDecodeThread::Responder
+{
+public:
+	BenchResponder(LLAtomicU32& done, LLAtomicU32& failed) : mDone(done), mFailed(failed) { }
+	/*virtual*/ void completed(bool success, LLImageRaw* raw, LLImageRaw* aux)
+	{
+		if (!success)
+		{
+			mFailed++;
+		}
+		mDone++;
+	}
+private:
+	LLAtomicU32& mDone;
+	LLAtomicU32& mFailed;
+};
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <directory of .j2c files> [max workers]" << std::endl;
+		return 1;
+	}
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+	LLImage::initClass();
+
+	std::string dir = argv[1];
+	U32 max_workers = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+	LLJobSystem::initClass(llmax(max_workers, 1U));
+
+	// Load the corpus once; every pass decodes the same compressed buffers.
+	std::vector<LLPointer<LLImageJ2C> > corpus;
+	U64 compressed_bytes = 0;
+	LLDirIterator iter(dir, "*.j2c");
+	std::string name;
+	while (iter.next(name))
+	{
+		LLPointer<LLImageJ2C> image = new LLImageJ2C;
+		if (image->loadAndValidate(dir + gDirUtilp->getDirDelimiter() + name))
+		{
+			compressed_bytes += image->getDataSize();
+			corpus.push_back(image);
+		}
+	}
+	if (corpus.empty())
+	{
+		std::cerr << "No valid .j2c file found in " << dir << std::endl;
+		return 1;
+	}
+	std::cout << corpus.size() << " images, " << compressed_bytes / 1024 << " KB compressed" << std::endl;
+
+	std::vector<U32> pool_sizes;
+	for (U32 workers = 1; workers < max_workers; workers *= 2)
+	{
+		pool_sizes.push_back(workers);
+	}
+	pool_sizes.push_back(llmax(max_workers, 1U));
+
+	F64 single_worker_time = 0.0;
+	for (U32 workers : pool_sizes)
+	{
+		LLImageDecodeThread* pool = new LLImageDecodeThread(true, workers);
+		LLAtomicU32 done(0);
+		LLAtomicU32 failed(0);
+
+		LLTimer timer;
+		for (LLImageJ2C* image : corpus)
+		{
+			// Decode from a fresh copy so every pass starts from the same state.
+			LLPointer<LLImageJ2C> copy = new LLImageJ2C;
+			memcpy(copy->allocateData(image->getDataSize()), image->getData(), image->getDataSize());
+			pool->decodeImage(copy, LLQueuedThread::PRIORITY_NORMAL, 0, FALSE, new BenchResponder(done, failed));
+		}
+		while (done < corpus.size())
+		{
+			pool->update(1.f);
+			ms_sleep(1);
+		}
+		const F64 elapsed = timer.getElapsedTimeF64();
+		if (workers == 1)
+		{
+			single_worker_time = elapsed;
+		}
+
+		std::cout << llformat("%2u workers: %7.1f ms, %7.1f images/s, %6.2f MB/s compressed, speedup %.2fx",
+							  pool->getNumWorkers(), elapsed * 1000.0, corpus.size() / elapsed,
+							  compressed_bytes / elapsed / (1024.0 * 1024.0), single_worker_time / elapsed);
+		if (failed)
+		{
+			std::cout << " (" << (U32)failed << " failed)";
+		}
+		std::cout << std::endl;
+
+		pool->shutdown();
+		delete pool;
+	}
+
+	LLJobSystem::cleanupClass();
+	LLImage::cleanupClass();
+	return 0;
+}
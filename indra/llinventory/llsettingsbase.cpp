@@ -28,7 +28,10 @@
 #include "llsettingsbase.h"
 
 #include "llmath.h"
+#include "llvector4a.h"
 #include <algorithm>
+#include <deque>
+#include <boost/align/aligned_allocator.hpp>
 
 #include "llsdserialize.h"
 
@@ -67,7 +70,8 @@ LLSettingsBase::LLSettingsBase():
     mSettings(LLSD::emptyMap()),
     mDirty(true),
     mAssetID(),
-    mBlendedFactor(0.0)
+    mBlendedFactor(0.0),
+    mBlendResultOut(false)
 {
 }
 
@@ -75,7 +79,12 @@ LLSettingsBase::LLSettingsBase(const LLSD setting) :
     mSettings(setting),
     mDirty(true),
     mAssetID(),
-    mBlendedFactor(0.0)
+    mBlendedFactor(0.0),
+    mBlendResultOut(false)
+{
+}
+
+LLSettingsBase::~LLSettingsBase()
 {
 }
 
@@ -345,6 +354,620 @@ LLSettingsBase::stringset_t LLSettingsBase::getSkipInterpolateKeys() const
     return skipSet;
 }
 
+//=========================================================================
+// The layout of a blend between two settings maps, compiled once.
+//
+// Every number interpolateSDMap() would lerp gets a lane: its values in the
+// two maps sit at the same index of two float arrays, which are lerped four
+// lanes at a time, and quaternions are slerped from four lanes in a row. The
+// blended map is built once, and each blend only writes the lanes, and the
+// values it switches or keeps whole, back into it. Reading the two maps into
+// the lanes checks them against the layout they were compiled for; when it
+// changed, the plan is compiled again.
+//
+// replaceSettingsWithBlend() hands the map to the settings, which hold it
+// alone, and the next replaceSettings() takes it back, so writing it does not
+// copy it. A blend that finds the map still with the settings compiles again.
+//
+// Anything interpolateSDMap() does not blend value by value, such as types
+// differing between the two maps, leaves the plan unusable, and those maps
+// are blended by interpolateSDMap() itself until their layout changes.
+class LLSettingsBase::BlendPlan
+{
+public:
+    BlendPlan() : mUsable(false), mNumLanes(0), mDefaults(NULL) { }
+
+    // Reads both maps into the lanes, false if their layout is not the one compiled.
+    bool    bind(const LLSD &settings, const LLSD &other);
+    void    compile(const LLSettingsBase &owner, const LLSD &settings, const LLSD &other, const parammapping_t &defaults);
+    // Blends the lanes into the result, false if the result's layout was changed.
+    bool    blend(BlendFactor mix);
+    void    invalidate()                { mShape[0].clear(); mShape[1].clear(); }
+
+    bool    isUsable() const            { return mUsable; }
+    // Undefined while the settings hold the map; see replaceSettingsWithBlend().
+    LLSD&   getResult()                 { return mResult; }
+
+private:
+    typedef std::vector<LLVector4a, boost::alignment::aligned_allocator<LLVector4a, 16> > lanes_t;
+
+    // A value of a source map, in the order bind() visits them.
+    struct ShapeOp
+    {
+        std::string mKey;               // in the map holding it, if any
+        LLSD::Type  mType;
+        size_t      mSize;              // of maps and arrays
+        S32         mLane;              // read as a number into this lane, if any
+        S32         mSlot;              // referred to by this slot, if any
+    };
+    typedef std::vector<ShapeOp> shape_t;
+
+    enum EWrite
+    {
+        WRITE_DESCEND,                  // a map or an array: write what it holds
+        WRITE_REAL,                     // the lane
+        WRITE_INTEGER,                  // the lane, rounded
+        WRITE_COPY,                     // the value in the slot
+        WRITE_SWITCH                    // the value in one slot or the other, at the break point
+    };
+    struct WriteOp
+    {
+        WriteOp(EWrite write, size_t arg, size_t arg2 = 0) : mWrite(write), mArg(arg), mArg2(arg2) { }
+
+        EWrite      mWrite;
+        size_t      mArg;               // the size, lane or slot
+        size_t      mArg2;              // the other slot, or the first key of a map
+    };
+
+    // What interpolateSDMap() makes of a key.
+    enum EEntry
+    {
+        ENTRY_INTERPOLATE,
+        ENTRY_SETTINGS,
+        ENTRY_OTHER
+    };
+    struct Entry
+    {
+        EEntry      mEntry;
+        const LLSD *mValue;
+        bool        mValueLive;         // from the map blended from, rather than a default
+        const LLSD *mOther;
+        bool        mOtherLive;
+    };
+
+    void    buildShape(S32 side, const LLSD &node, const std::string &key);
+    bool    readShape(const LLSD &node, const shape_t &shape, size_t &op, F32 *lanes, std::vector<const LLSD *> &slots) const;
+    bool    writeNode(LLSD &node, size_t &op, const F32 *lanes, BlendFactor mix) const;
+
+    void    compileMap(const LLSD &settings, bool settings_live, const LLSD &other, bool other_live, LLSD &result);
+    void    compileValue(const std::string &key, const Entry &entry, LLSD &result);
+    size_t  addLane(const LLSD &value, bool value_live, const LLSD &other, bool other_live);
+    size_t  addSlot(S32 side, const LLSD &node, bool live);
+    void    annotate(S32 side, const LLSD &node, S32 lane, S32 slot);
+    const LLSD &addConstant(const LLSD &value);
+
+    bool                    mUsable;
+    LLSD                    mResult;
+    shape_t                 mShape[2];      // of the maps blended from, and to
+    std::vector<WriteOp>    mWriteOps;
+    std::vector<std::string> mMapKeys;      // of the maps written, in the order of the write ops
+    std::vector<const LLSD *> mSlots;
+    std::vector<size_t>     mSlerps;        // the first of the four lanes of each quaternion
+    lanes_t                 mLanes[3];      // from, to, and blended
+    size_t                  mNumLanes;
+    std::deque<LLSD>        mConstants;     // defaults and placeholders the slots may refer to
+
+    // Only while compiling.
+    const parammapping_t   *mDefaults;
+    stringset_t             mSkip;
+    stringset_t             mSlerpKeys;
+    std::map<const LLSD *, size_t> mShapeIndex[2];
+    std::vector<F32>        mConstantLanes[2];
+};
+
+void LLSettingsBase::BlendPlan::buildShape(S32 side, const LLSD &node, const std::string &key)
+{
+    ShapeOp op;
+    op.mKey = key;
+    op.mType = node.type();
+    op.mSize = (node.isMap() || node.isArray()) ? (size_t)node.size() : 0;
+    op.mLane = -1;
+    op.mSlot = -1;
+    mShapeIndex[side][&node] = mShape[side].size();
+    mShape[side].push_back(op);
+
+    if (node.isMap())
+    {
+        for (LLSD::map_const_iterator it = node.beginMap(); it != node.endMap(); ++it)
+        {
+            buildShape(side, it->second, it->first);
+        }
+    }
+    else if (node.isArray())
+    {
+        for (LLSD::array_const_iterator it = node.beginArray(); it != node.endArray(); ++it)
+        {
+            buildShape(side, *it, LLStringUtil::null);
+        }
+    }
+}
+
+bool LLSettingsBase::BlendPlan::readShape(const LLSD &node, const shape_t &shape, size_t &op, F32 *lanes, std::vector<const LLSD *> &slots) const
+{
+    const ShapeOp &expected = shape[op++];
+    if (node.type() != expected.mType)
+    {
+        return false;
+    }
+    if (expected.mLane >= 0)
+    {
+        lanes[expected.mLane] = (F32)node.asReal();
+    }
+    if (expected.mSlot >= 0)
+    {
+        slots[expected.mSlot] = &node;
+    }
+
+    if (node.isMap())
+    {
+        if ((size_t)node.size() != expected.mSize)
+        {
+            return false;
+        }
+        for (LLSD::map_const_iterator it = node.beginMap(); it != node.endMap(); ++it)
+        {
+            if (it->first != shape[op].mKey || !readShape(it->second, shape, op, lanes, slots))
+            {
+                return false;
+            }
+        }
+    }
+    else if (node.isArray())
+    {
+        if ((size_t)node.size() != expected.mSize)
+        {
+            return false;
+        }
+        for (LLSD::array_const_iterator it = node.beginArray(); it != node.endArray(); ++it)
+        {
+            if (!readShape(*it, shape, op, lanes, slots))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool LLSettingsBase::BlendPlan::bind(const LLSD &settings, const LLSD &other)
+{
+    if (mShape[0].empty() || mShape[1].empty())
+    {
+        return false;
+    }
+
+    size_t op = 0;
+    if (!readShape(settings, mShape[0], op, mLanes[0].empty() ? NULL : mLanes[0][0].getF32ptr(), mSlots))
+    {
+        return false;
+    }
+    op = 0;
+    return readShape(other, mShape[1], op, mLanes[1].empty() ? NULL : mLanes[1][0].getF32ptr(), mSlots);
+}
+
+bool LLSettingsBase::BlendPlan::blend(BlendFactor mix)
+{
+    const F32 fmix = (F32)mix;
+    for (size_t i = 0; i < mLanes[2].size(); ++i)
+    {
+        mLanes[2][i].setLerp(mLanes[0][i], mLanes[1][i], fmix);
+    }
+
+    if (mLanes[2].empty())
+    {
+        size_t op = 0;
+        return writeNode(mResult, op, NULL, mix);
+    }
+
+    const F32 *from = mLanes[0][0].getF32ptr();
+    const F32 *to = mLanes[1][0].getF32ptr();
+    F32 *blended = mLanes[2][0].getF32ptr();
+    for (std::vector<size_t>::const_iterator it = mSlerps.begin(); it != mSlerps.end(); ++it)
+    {
+        const F32 *a = from + *it;
+        const F32 *b = to + *it;
+        LLQuaternion q = slerp(fmix, LLQuaternion(a[0], a[1], a[2], a[3]), LLQuaternion(b[0], b[1], b[2], b[3]));
+        memcpy(blended + *it, q.mQ, sizeof(q.mQ));
+    }
+
+    size_t op = 0;
+    return writeNode(mResult, op, blended, mix);
+}
+
+bool LLSettingsBase::BlendPlan::writeNode(LLSD &node, size_t &op, const F32 *lanes, BlendFactor mix) const
+{
+    const WriteOp &write = mWriteOps[op++];
+    switch (write.mWrite)
+    {
+        case WRITE_DESCEND:
+            // Someone may have changed the map since the last blend, while
+            // the settings held it.
+            if ((size_t)node.size() != write.mArg)
+            {
+                return false;
+            }
+            if (node.isMap())
+            {
+                size_t key = write.mArg2;
+                for (LLSD::map_iterator it = node.beginMap(); it != node.endMap(); ++it)
+                {
+                    if (it->first != mMapKeys[key++] || !writeNode(it->second, op, lanes, mix))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else
+            {
+                for (LLSD::array_iterator it = node.beginArray(); it != node.endArray(); ++it)
+                {
+                    if (!writeNode(*it, op, lanes, mix))
+                    {
+                        return false;
+                    }
+                }
+            }
+            break;
+        case WRITE_REAL:
+            node = LLSD::Real(lanes[write.mArg]);
+            break;
+        case WRITE_INTEGER:
+            node = LLSD::Integer(llroundf(lanes[write.mArg]));
+            break;
+        case WRITE_COPY:
+            node = *mSlots[write.mArg];
+            break;
+        case WRITE_SWITCH:
+            node = *mSlots[(mix > BREAK_POINT) ? write.mArg2 : write.mArg];
+            break;
+    }
+    return true;
+}
+
+void LLSettingsBase::BlendPlan::compile(const LLSettingsBase &owner, const LLSD &settings, const LLSD &other, const parammapping_t &defaults)
+{
+    mUsable = settings.isMap() && other.isMap();
+    mResult = LLSD::emptyMap();
+    mWriteOps.clear();
+    mMapKeys.clear();
+    mSlots.clear();
+    mSlerps.clear();
+    mNumLanes = 0;
+    mConstants.clear();
+
+    mDefaults = &defaults;
+    mSkip = owner.getSkipInterpolateKeys();
+    mSlerpKeys = owner.getSlerpKeys();
+    for (S32 side = 0; side < 2; ++side)
+    {
+        mShape[side].clear();
+        mShapeIndex[side].clear();
+        mConstantLanes[side].clear();
+        buildShape(side, side ? other : settings, LLStringUtil::null);
+    }
+
+    if (mUsable)
+    {
+        compileMap(settings, true, other, true, mResult);
+    }
+
+    // Four lanes to a vector, the last one padded with zeros. The lanes read
+    // from the maps are filled by bind(), the constant ones only here.
+    const size_t vectors = (mNumLanes + 3) / 4;
+    for (S32 i = 0; i < 3; ++i)
+    {
+        mLanes[i].resize(vectors);
+        for (size_t v = 0; v < vectors; ++v)
+        {
+            mLanes[i][v].clear();
+        }
+    }
+    for (S32 side = 0; side < 2; ++side)
+    {
+        if (!mConstantLanes[side].empty())
+        {
+            memcpy(mLanes[side][0].getF32ptr(), &mConstantLanes[side][0], mNumLanes * sizeof(F32));
+        }
+    }
+
+    mDefaults = NULL;
+    mSkip.clear();
+    mSlerpKeys.clear();
+    for (S32 side = 0; side < 2; ++side)
+    {
+        mShapeIndex[side].clear();
+        mConstantLanes[side].clear();
+    }
+}
+
+// Follows interpolateSDMap() key by key.
+void LLSettingsBase::BlendPlan::compileMap(const LLSD &settings, bool settings_live, const LLSD &other, bool other_live, LLSD &result)
+{
+    std::map<std::string, Entry> entries;
+
+    for (LLSD::map_const_iterator it = settings.beginMap(); it != settings.endMap(); ++it)
+    {
+        const std::string &key_name = it->first;
+        if (mSkip.find(key_name) != mSkip.end())
+            continue;
+
+        Entry entry = { ENTRY_INTERPOLATE, &it->second, settings_live, NULL, false };
+        LLSD::map_const_iterator other_it = other.map().find(key_name);
+        if (other_it != other.endMap())
+        {
+            entry.mOther = &other_it->second;
+            entry.mOtherLive = other_live;
+        }
+        else
+        {
+            parammapping_t::const_iterator def_iter = mDefaults->find(key_name);
+            if (def_iter != mDefaults->end())
+            {
+                entry.mOther = &addConstant(def_iter->second.getDefaultValue());
+            }
+            else if (it->second.isMap())
+            {
+                entry.mOther = &addConstant(LLSD::emptyMap());
+            }
+            else
+            {
+                entry.mEntry = ENTRY_SETTINGS;
+            }
+        }
+        entries[key_name] = entry;
+    }
+
+    LLSD::map_const_iterator flags_it = settings.map().find(SETTING_FLAGS);
+    if (flags_it != settings.endMap())
+    {
+        // Or'ed with the other flags, and then replaced by them below if
+        // there are any, as interpolateSDMap() does. Kept as they are if
+        // there are none, once they are an integer.
+        if (flags_it->second.type() != LLSD::TypeInteger)
+        {
+            mUsable = false;
+        }
+        Entry entry = { ENTRY_SETTINGS, &flags_it->second, settings_live, NULL, false };
+        entries[SETTING_FLAGS] = entry;
+    }
+
+    for (LLSD::map_const_iterator it = other.beginMap(); it != other.endMap(); ++it)
+    {
+        const std::string &key_name = it->first;
+        if (mSkip.find(key_name) != mSkip.end() || settings.has(key_name))
+            continue;
+
+        Entry entry = { ENTRY_INTERPOLATE, NULL, false, &it->second, other_live };
+        parammapping_t::const_iterator def_iter = mDefaults->find(key_name);
+        if (def_iter != mDefaults->end())
+        {
+            entry.mValue = &addConstant(def_iter->second.getDefaultValue());
+        }
+        else if (it->second.isMap())
+        {
+            entry.mValue = &addConstant(LLSD::emptyMap());
+        }
+        else
+        {
+            continue;
+        }
+        entries[key_name] = entry;
+    }
+
+    for (LLSD::map_const_iterator it = other.beginMap(); it != other.endMap(); ++it)
+    {
+        if (mSkip.find(it->first) == mSkip.end() || !settings.has(it->first))
+            continue;
+
+        Entry entry = { ENTRY_OTHER, NULL, false, &it->second, other_live };
+        entries[it->first] = entry;
+    }
+
+    mWriteOps.push_back(WriteOp(WRITE_DESCEND, entries.size(), mMapKeys.size()));
+    for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        mMapKeys.push_back(it->first);
+    }
+    for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        const Entry &entry = it->second;
+        LLSD &value = result[it->first];
+        switch (entry.mEntry)
+        {
+            case ENTRY_INTERPOLATE:
+                compileValue(it->first, entry, value);
+                break;
+            case ENTRY_SETTINGS:
+                value = *entry.mValue;
+                mWriteOps.push_back(WriteOp(WRITE_COPY, addSlot(0, *entry.mValue, entry.mValueLive)));
+                break;
+            case ENTRY_OTHER:
+                value = *entry.mOther;
+                mWriteOps.push_back(WriteOp(WRITE_COPY, addSlot(1, *entry.mOther, entry.mOtherLive)));
+                break;
+        }
+    }
+}
+
+// Follows interpolateSDValue().
+void LLSettingsBase::BlendPlan::compileValue(const std::string &key, const Entry &entry, LLSD &result)
+{
+    const LLSD &value = *entry.mValue;
+    const LLSD &other = *entry.mOther;
+    if (value.type() != other.type())
+    {
+        // Left to interpolateSDMap(), which warns about it.
+        mUsable = false;
+        return;
+    }
+
+    switch (value.type())
+    {
+        case LLSD::TypeInteger:
+            result = LLSD::Integer(0);
+            mWriteOps.push_back(WriteOp(WRITE_INTEGER, addLane(value, entry.mValueLive, other, entry.mOtherLive)));
+            break;
+        case LLSD::TypeReal:
+            result = LLSD::Real(0.0);
+            mWriteOps.push_back(WriteOp(WRITE_REAL, addLane(value, entry.mValueLive, other, entry.mOtherLive)));
+            break;
+        case LLSD::TypeMap:
+            result = LLSD::emptyMap();
+            compileMap(value, entry.mValueLive, other, entry.mOtherLive, result);
+            break;
+        case LLSD::TypeArray:
+        {
+            static const LLSD undefined;
+
+            // A quaternion always makes four lanes, whatever the arrays hold.
+            const bool slerped = mSlerpKeys.find(key) != mSlerpKeys.end();
+            const size_t len = slerped ? 4 : (size_t)std::max(value.size(), other.size());
+            if (slerped)
+            {
+                mSlerps.push_back(mNumLanes);
+            }
+
+            result = LLSD::emptyArray();
+            mWriteOps.push_back(WriteOp(WRITE_DESCEND, len));
+            for (size_t i = 0; i < len; ++i)
+            {
+                const bool has_value = i < (size_t)value.size();
+                const bool has_other = i < (size_t)other.size();
+                result.append(LLSD::Real(0.0));
+                mWriteOps.push_back(WriteOp(WRITE_REAL, addLane(has_value ? value[(LLSD::Integer)i] : undefined, entry.mValueLive && has_value,
+                                                                 has_other ? other[(LLSD::Integer)i] : undefined, entry.mOtherLive && has_other)));
+            }
+            break;
+        }
+        case LLSD::TypeUUID:
+            result = value;
+            mWriteOps.push_back(WriteOp(WRITE_COPY, addSlot(0, value, entry.mValueLive)));
+            break;
+        default:
+        {
+            result = value;
+            const size_t from = addSlot(0, value, entry.mValueLive);
+            mWriteOps.push_back(WriteOp(WRITE_SWITCH, from, addSlot(1, other, entry.mOtherLive)));
+            break;
+        }
+    }
+}
+
+size_t LLSettingsBase::BlendPlan::addLane(const LLSD &value, bool value_live, const LLSD &other, bool other_live)
+{
+    const size_t lane = mNumLanes++;
+    mConstantLanes[0].push_back((F32)value.asReal());
+    mConstantLanes[1].push_back((F32)other.asReal());
+    if (value_live)
+    {
+        annotate(0, value, (S32)lane, -1);
+    }
+    if (other_live)
+    {
+        annotate(1, other, (S32)lane, -1);
+    }
+    return lane;
+}
+
+size_t LLSettingsBase::BlendPlan::addSlot(S32 side, const LLSD &node, bool live)
+{
+    const size_t slot = mSlots.size();
+    mSlots.push_back(&node);
+    if (live)
+    {
+        annotate(side, node, -1, (S32)slot);
+    }
+    return slot;
+}
+
+void LLSettingsBase::BlendPlan::annotate(S32 side, const LLSD &node, S32 lane, S32 slot)
+{
+    std::map<const LLSD *, size_t>::const_iterator it = mShapeIndex[side].find(&node);
+    if (it == mShapeIndex[side].end())
+    {
+        mUsable = false;
+        return;
+    }
+
+    // Each value of the maps is read into one lane or slot at most.
+    ShapeOp &op = mShape[side][it->second];
+    if (op.mLane >= 0 || op.mSlot >= 0)
+    {
+        mUsable = false;
+        return;
+    }
+    if (lane >= 0)
+    {
+        op.mLane = lane;
+    }
+    if (slot >= 0)
+    {
+        op.mSlot = slot;
+    }
+}
+
+const LLSD &LLSettingsBase::BlendPlan::addConstant(const LLSD &value)
+{
+    mConstants.push_back(value);
+    return mConstants.back();
+}
+
+LLSD& LLSettingsBase::blendSDMap(const LLSettingsBase &other, BlendFactor mix)
+{
+    if (!mBlendPlan)
+    {
+        mBlendPlan.reset(new BlendPlan);
+    }
+
+    BlendPlan &plan = *mBlendPlan;
+    if (!plan.bind(mSettings, other.mSettings) || plan.getResult().isUndefined())
+    {
+        // First blend, either map changed layout, or the settings kept the
+        // last result. Compiling leaves the lanes and slots read from the
+        // maps just as binding does.
+        plan.compile(*this, mSettings, other.mSettings, other.getParameterMap());
+    }
+
+    if (!plan.isUsable() || !plan.blend(mix))
+    {
+        if (plan.isUsable())
+        {
+            plan.invalidate();
+        }
+        plan.getResult() = interpolateSDMap(mSettings, other.mSettings, other.getParameterMap(), mix);
+    }
+    return plan.getResult();
+}
+
+void LLSettingsBase::replaceSettingsWithBlend()
+{
+    LLSD &result = mBlendPlan->getResult();
+    replaceSettings(result);
+    result.clear();
+    mBlendResultOut = true;
+}
+
+void LLSettingsBase::reclaimBlendResult()
+{
+    if (mBlendResultOut)
+    {
+        // The plan checks the map against its layout before writing to it,
+        // in case it was changed meanwhile.
+        mBlendResultOut = false;
+        std::swap(mBlendPlan->getResult(), mSettings);
+    }
+}
+
 LLSD LLSettingsBase::getSettings() const
 {
     return mSettings;
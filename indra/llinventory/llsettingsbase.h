@@ -31,6 +31,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <memory>
 #include <boost/signals2.hpp>
 
 #include "llsd.h"
@@ -94,7 +95,7 @@ public:
 
     typedef PTR_NAMESPACE::shared_ptr<LLSettingsBase> ptr_t;
 
-    virtual ~LLSettingsBase() { };
+    virtual ~LLSettingsBase();
 
     //---------------------------------------------------------------------
     virtual std::string getSettingsType() const = 0;
@@ -180,6 +181,7 @@ public:
         mBlendedFactor = 0.0;
         setDirtyFlag(true);
         mReplaced = true;
+        reclaimBlendResult();
         mSettings = settings;
     }
 
@@ -340,6 +342,16 @@ protected:
     LLSD    interpolateSDMap(const LLSD &settings, const LLSD &other, const parammapping_t& defaults, BlendFactor mix) const;
     LLSD    interpolateSDValue(const std::string& name, const LLSD &value, const LLSD &other, const parammapping_t& defaults, BlendFactor mix, const stringset_t& slerps) const;
 
+    // interpolateSDMap(mSettings, other.mSettings, other.getParameterMap(), mix),
+    // through a plan compiled for the layout of the two maps and kept until it
+    // changes. The returned map belongs to the plan until
+    // replaceSettingsWithBlend().
+    LLSD&   blendSDMap(const LLSettingsBase &other, BlendFactor mix);
+    // replaceSettings() with the map blendSDMap() returned, handed over rather
+    // than shared, so that the settings hold it alone. The next
+    // replaceSettings() gives it back to the plan to be written in place.
+    void    replaceSettingsWithBlend();
+
     /// when lerping between settings, some may require special handling.  
     /// Get a list of these key to be skipped by the default settings lerp.
     /// (handling should be performed in the override of lerpSettings.
@@ -380,6 +392,12 @@ private:
     LLSD        combineSDMaps(const LLSD &first, const LLSD &other) const;
 
     BlendFactor mBlendedFactor;
+
+    class BlendPlan;
+    std::unique_ptr<BlendPlan> mBlendPlan;
+    bool        mBlendResultOut;    // mSettings is the map the plan handed over
+
+    void        reclaimBlendResult();
 };
 
 
@@ -0,0 +1,213 @@
+/**
+ * @file llsettingsblend_bench.cpp
+ * @brief Per frame cost of blending sky and water settings.
+ *
+ * Usage: llsettingsblend_bench [frames]
+ *
+ * Blends the default sky and water towards altered copies of themselves, the
+ * way LLSettingsBlender does every frame of a transition: the target is reset
+ * to the initial settings and blended towards the final ones. The map blend
+ * is timed through interpolateSDMap(), as blend() did it, and through the
+ * compiled plan of blendSDMap(), and blend() itself is timed as it is now.
+ * Both map blends must agree, to float precision, at every step of the
+ * transition.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llsettingssky.h"
+#include "../llsettingswater.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "lltimer.h"
+
+#include <iostream>
+
+static const S32 STEPS = 64;
+
+// Settings the bench can build and blend without the viewer.
+template<class T>
+class BenchSettings : public T
+{
+public:
+    typedef std::shared_ptr<BenchSettings<T> > bench_ptr_t;
+
+    BenchSettings(const LLSD &data) : T(data) { }
+
+    virtual typename T::ptr_t buildClone() const SETTINGS_OVERRIDE
+    {
+        return std::make_shared<BenchSettings<T> >(this->cloneSettings());
+    }
+
+    // Every default, as the viewer's settings have the shader parameters.
+    virtual LLSettingsBase::parammapping_t getParameterMap() const SETTINGS_OVERRIDE
+    {
+        static LLSettingsBase::parammapping_t param_map;
+        if (param_map.empty())
+        {
+            const LLSD defaults = T::defaults();
+            for (LLSD::map_const_iterator it = defaults.beginMap(); it != defaults.endMap(); ++it)
+            {
+                param_map[it->first] = LLSettingsBase::DefaultParam(-1, it->second);
+            }
+        }
+        return param_map;
+    }
+
+    LLSD interpolate(const BenchSettings<T> &other, LLSettingsBase::BlendFactor mix) const
+    {
+        return this->interpolateSDMap(this->mSettings, other.mSettings, other.getParameterMap(), mix);
+    }
+
+    LLSD compiled(const BenchSettings<T> &other, LLSettingsBase::BlendFactor mix)
+    {
+        return this->blendSDMap(other, mix);
+    }
+};
+
+// A final state for the transition: every number a quarter larger.
+static LLSD alter(const LLSD &value)
+{
+    if (value.isMap())
+    {
+        LLSD altered(LLSD::emptyMap());
+        for (LLSD::map_const_iterator it = value.beginMap(); it != value.endMap(); ++it)
+        {
+            altered[it->first] = alter(it->second);
+        }
+        return altered;
+    }
+    if (value.isArray())
+    {
+        LLSD altered(LLSD::emptyArray());
+        for (LLSD::array_const_iterator it = value.beginArray(); it != value.endArray(); ++it)
+        {
+            altered.append(alter(*it));
+        }
+        return altered;
+    }
+    if (value.isReal())
+    {
+        return LLSD::Real(value.asReal() * 1.25 + 0.01);
+    }
+    return value;
+}
+
+static bool same(const LLSD &a, const LLSD &b)
+{
+    if (a.type() != b.type() || a.size() != b.size())
+    {
+        return false;
+    }
+    if (a.isMap())
+    {
+        for (LLSD::map_const_iterator it = a.beginMap(); it != a.endMap(); ++it)
+        {
+            if (!b.has(it->first) || !same(it->second, b[it->first]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (a.isArray())
+    {
+        for (S32 i = 0; i < a.size(); ++i)
+        {
+            if (!same(a[i], b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (a.isReal())
+    {
+        return fabs(a.asReal() - b.asReal()) <= 1e-5 * llmax(1.0, fabs(a.asReal()));
+    }
+    return a.asString() == b.asString();
+}
+
+template<class T>
+static bool run(const char *name, S32 frames)
+{
+    typedef BenchSettings<T> bench_t;
+    const LLSD from = T::defaults();
+    typename bench_t::bench_ptr_t initial = std::make_shared<bench_t>(from);
+    typename bench_t::bench_ptr_t to = std::make_shared<bench_t>(alter(from));
+    typename bench_t::bench_ptr_t target = std::make_shared<bench_t>(from);
+
+    bool ok = true;
+    for (S32 step = 0; step <= STEPS; ++step)
+    {
+        const F64 mix = (F64)step / STEPS;
+        target->replaceSettings(initial->getSettings());
+        if (!same(target->interpolate(*to, mix), target->compiled(*to, mix)))
+        {
+            std::cerr << name << ": the blends differ at " << mix << std::endl;
+            ok = false;
+        }
+    }
+
+    LLTimer timer;
+    for (S32 frame = 0; frame < frames; ++frame)
+    {
+        target->replaceSettings(initial->getSettings());
+        target->replaceSettings(target->interpolate(*to, (F64)(frame % STEPS) / STEPS));
+    }
+    const F64 interpolate_time = timer.getElapsedTimeF64();
+
+    timer.reset();
+    for (S32 frame = 0; frame < frames; ++frame)
+    {
+        target->replaceSettings(initial->getSettings());
+        target->replaceSettings(target->compiled(*to, (F64)(frame % STEPS) / STEPS));
+    }
+    const F64 compiled_time = timer.getElapsedTimeF64();
+
+    timer.reset();
+    for (S32 frame = 0; frame < frames; ++frame)
+    {
+        target->replaceSettings(initial->getSettings());
+        target->blend(to, (F64)(frame % STEPS) / STEPS);
+    }
+    const F64 blend_time = timer.getElapsedTimeF64();
+
+    std::cout << llformat("%-6s interpolateSDMap %6.2fus | compiled %6.2fus | blend() %6.2fus per frame", name,
+                          interpolate_time * 1000000.0 / frames, compiled_time * 1000000.0 / frames,
+                          blend_time * 1000000.0 / frames) << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    LLError::initForApplication(".");
+    LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+    const S32 frames = argc > 1 ? atoi(argv[1]) : 100000;
+
+    bool ok = run<LLSettingsSky>("sky", frames);
+    ok = run<LLSettingsWater>("water", frames) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file aicurlepoll.cpp
+ * @brief Implementation of AICurlEpoll.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#if LL_LINUX
+
+#include "aicurlepoll.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+AICurlEpoll::AICurlEpoll(void) : mEpollFd(epoll_create1(EPOLL_CLOEXEC)), mLastSerial(0)
+{
+  if (mEpollFd == -1)
+  {
+	LL_WARNS() << "epoll_create1() failed: " << errno << ", " << strerror(errno) << "; the curl thread uses select()." << LL_ENDL;
+  }
+}
+
+AICurlEpoll::~AICurlEpoll()
+{
+  if (mEpollFd != -1)
+  {
+	close(mEpollFd);
+  }
+}
+
+void AICurlEpoll::set_action(curl_socket_t s, int action)
+{
+  if (s < 0)
+  {
+	return;
+  }
+  if ((size_t)s >= mRegistrations.size())
+  {
+	Registration const none = { 0, CURL_POLL_NONE };
+	mRegistrations.resize(llmax((size_t)s + 1, 2 * mRegistrations.size()), none);
+  }
+  Registration& reg = mRegistrations[s];
+  // An event argument is needed for EPOLL_CTL_DEL before linux 2.6.9.
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+
+  if (action == CURL_POLL_NONE || action == CURL_POLL_REMOVE)
+  {
+	if (reg.mSerial)
+	{
+	  // This fails when the socket was closed already, but then the kernel removed it.
+	  epoll_ctl(mEpollFd, EPOLL_CTL_DEL, s, &ev);
+	  reg.mSerial = 0;
+	  reg.mAction = CURL_POLL_NONE;
+	}
+	return;
+  }
+
+  int op = EPOLL_CTL_MOD;
+  if (!reg.mSerial)
+  {
+	op = EPOLL_CTL_ADD;
+	if (!++mLastSerial)
+	  ++mLastSerial;				// Zero means not registered.
+	reg.mSerial = mLastSerial;
+  }
+  reg.mAction = action;
+  ev.events = ((action & CURL_POLL_IN) ? EPOLLIN : 0) | ((action & CURL_POLL_OUT) ? EPOLLOUT : 0);
+  ev.data.u64 = ((U64)reg.mSerial << 32) | (U32)s;
+  int res = epoll_ctl(mEpollFd, op, s, &ev);
+  if (res == -1 && op == EPOLL_CTL_ADD && errno == EEXIST)
+  {
+	// Still registered under a duplicate of a socket that was closed without being removed.
+	res = epoll_ctl(mEpollFd, EPOLL_CTL_MOD, s, &ev);
+  }
+  else if (res == -1 && op == EPOLL_CTL_MOD && errno == ENOENT)
+  {
+	// The socket was closed without being removed, which removed it, and the number was reused.
+	res = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, s, &ev);
+  }
+  if (res == -1)
+  {
+	// The transfer on this socket will stall and be timed out.
+	LL_WARNS() << "epoll_ctl() failed for socket " << s << ": " << errno << ", " << strerror(errno) << LL_ENDL;
+  }
+}
+
+int AICurlEpoll::wait(long timeout_ms)
+{
+  return epoll_wait(mEpollFd, mEvents, MAX_EVENTS, (int)timeout_ms);
+}
+
+bool AICurlEpoll::get_event(int i, curl_socket_t& fd_out, int& ev_bitmask_out) const
+{
+  llassert(0 <= i && i < MAX_EVENTS);
+  U64 const data = mEvents[i].data.u64;
+  curl_socket_t const fd = (curl_socket_t)(U32)data;
+  if ((size_t)fd >= mRegistrations.size() || mRegistrations[fd].mSerial != (U32)(data >> 32))
+  {
+	return false;
+  }
+  int const action = mRegistrations[fd].mAction;
+  U32 events = mEvents[i].events;
+  // Like select(), report a socket with an error or hang up as ready for whatever was asked.
+  if ((events & (EPOLLERR | EPOLLHUP)))
+	events |= EPOLLIN | EPOLLOUT;
+  int ev_bitmask = 0;
+  if ((events & EPOLLIN) && (action & CURL_POLL_IN))
+	ev_bitmask |= CURL_CSELECT_IN;
+  if ((events & EPOLLOUT) && (action & CURL_POLL_OUT))
+	ev_bitmask |= CURL_CSELECT_OUT;
+  if ((events & EPOLLERR))
+	ev_bitmask |= CURL_CSELECT_ERR;
+  fd_out = fd;
+  ev_bitmask_out = ev_bitmask;
+  return ev_bitmask != 0;
+}
+
+#endif // LL_LINUX
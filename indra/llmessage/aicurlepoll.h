@@ -0,0 +1,87 @@
+/**
+ * @file aicurlepoll.h
+ * @brief The sockets the curl thread waits on, in an epoll instance.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef AICURLEPOLL_H
+#define AICURLEPOLL_H
+
+#if LL_LINUX
+
+#include "stdtypes.h"
+#include <curl/curl.h>
+#include <sys/epoll.h>
+#include <vector>
+
+// The sockets that the curl thread waits on, registered once in an epoll
+// instance instead of being copied into fd_sets before every select().
+// Waiting then costs the same however many sockets are open, and is not
+// limited to file descriptors below FD_SETSIZE.
+//
+// Sockets are registered with the action that libcurl last asked for in its
+// socket callback. Every registration gets a serial number that is returned
+// with its events, so that events of a socket that was removed, or closed and
+// reopened under the same number, while handling earlier events of the same
+// wait() can be recognized and dropped.
+class AICurlEpoll
+{
+  public:
+	AICurlEpoll(void);
+	~AICurlEpoll();
+
+	// Return true if the epoll instance could be created. If not, use select().
+	bool valid(void) const { return mEpollFd != -1; }
+
+	// Wait for the curl action (CURL_POLL_IN, CURL_POLL_OUT or CURL_POLL_INOUT) on s.
+	// CURL_POLL_NONE and CURL_POLL_REMOVE stop waiting on s.
+	void set_action(curl_socket_t s, int action);
+
+	// Wait at most timeout_ms for events. Returns the number of events, 0 on timeout or -1 on error (see errno).
+	int wait(long timeout_ms);
+
+	// Return the socket of event i of the last wait() and its CURL_CSELECT_* bitmask, for socket_action().
+	// Returns false if the event is stale: the socket was removed or replaced since the wait.
+	bool get_event(int i, curl_socket_t& fd_out, int& ev_bitmask_out) const;
+
+  private:
+	struct Registration {
+	  U32 mSerial;					// Zero when the socket is not registered.
+	  int mAction;
+	};
+
+	static int const MAX_EVENTS = 256;	// More ready sockets are returned by the next wait().
+
+	int mEpollFd;
+	U32 mLastSerial;
+	std::vector<Registration> mRegistrations;	// Indexed by socket.
+	struct epoll_event mEvents[MAX_EVENTS];
+
+	// Not copyable: owns mEpollFd.
+	AICurlEpoll(AICurlEpoll const&);
+	AICurlEpoll& operator=(AICurlEpoll const&);
+};
+
+#endif // LL_LINUX
+
+#endif // AICURLEPOLL_H
@@ -35,6 +35,7 @@
 #include "aicurlperservice.h"
 #include "aiaverage.h"
 #include "aicurltimer.h"
+#include "aicurlepoll.h"
 #include "lltimer.h"		// ms_sleep, get_clock_count
 #include "llhttpstatuscodes.h"
 #include "llbuffer.h"
@@ -202,6 +203,8 @@ int ioctlsocket(int fd, int, unsigned long* nonblocking_enable)
 #endif // DEBUG_WINDOWS_CODE_ON_LINUX
 
 #define WINDOWS_CODE (LL_WINDOWS || DEBUG_WINDOWS_CODE_ON_LINUX)
+// On linux the curl thread waits with epoll, falling back to select() if no epoll instance can be created.
+#define USE_EPOLL (LL_LINUX && !DEBUG_WINDOWS_CODE_ON_LINUX)
 
 #undef AICurlPrivate
 
@@ -805,7 +808,16 @@ void CurlSocketInfo::set_action(int action)
   Dout(dc::curl, "CurlSocketInfo::set_action(" << action_str(mAction) << " --> " << action_str(action) << ") [" << (void*)mEasyRequest.get_ptr().get() << "]");
   int toggle_action = mAction ^ action; 
   mAction = action;
-  if ((toggle_action & CURL_POLL_IN))
+#if USE_EPOLL
+  bool const use_poll_sets = !mMultiHandle.mEpoll;
+  if (toggle_action && !use_poll_sets)
+  {
+	mMultiHandle.mEpoll->set_action(mSocketFd, action);
+  }
+#else
+  bool const use_poll_sets = true;
+#endif
+  if ((toggle_action & CURL_POLL_IN) && use_poll_sets)
   {
 	if ((action & CURL_POLL_IN))
 	  mMultiHandle.mReadPollSet->add(this);
@@ -816,7 +828,8 @@ void CurlSocketInfo::set_action(int action)
   {
 	if ((action & CURL_POLL_OUT))
 	{
-	  mMultiHandle.mWritePollSet->add(this);
+	  if (use_poll_sets)
+		mMultiHandle.mWritePollSet->add(this);
 	  if (mTimeout)
 	  {
 		  // Note that this detection normally doesn't work because mTimeout will be zero.
@@ -826,7 +839,8 @@ void CurlSocketInfo::set_action(int action)
 	}
 	else
 	{
-	  mMultiHandle.mWritePollSet->remove(this);
+	  if (use_poll_sets)
+		mMultiHandle.mWritePollSet->remove(this);
 
 	  // The following is a bit of a hack, needed because of the lack of proper timeout callbacks in libcurl.
 	  // The removal of CURL_POLL_OUT could be part of the SSL handshake, therefore check if we're already connected:
@@ -1388,6 +1402,12 @@ void AICurlThread::run(void)
 
   {
 	AICurlMultiHandle_wat multi_handle_w(AICurlMultiHandle::getInstance());
+#if USE_EPOLL
+	if (multi_handle_w->mEpoll)
+	{
+	  multi_handle_w->mEpoll->set_action(mWakeUpFd, CURL_POLL_IN);
+	}
+#endif
 	while(mRunning)
 	{
 	  // If mRunning is true then we can only get here if mWakeUpFd != CURL_SOCKET_BAD.
@@ -1412,31 +1432,10 @@ void AICurlThread::run(void)
 	  }
 
 	  // If we get here then mWakeUpFlag has been false since we grabbed the lock.
-	  // We're now entering select(), during which the main thread will write to the pipe/socket
+	  // We're now entering select() or epoll_wait(), during which the main thread will write to the pipe/socket
 	  // to wake us up, because it can't get the lock.
 
-	  // Copy the next batch of file descriptors from the PollSets mFileDescriptors into their mFdSet.
-	  multi_handle_w->mReadPollSet->refresh();
-	  refresh_t wres = multi_handle_w->mWritePollSet->refresh();
-	  // Add wake up fd if any, and pass NULL to select() if a set is empty.
-	  fd_set* read_fd_set = multi_handle_w->mReadPollSet->access();
-	  FD_SET(mWakeUpFd, read_fd_set);
-	  fd_set* write_fd_set = ((wres & empty)) ? NULL : multi_handle_w->mWritePollSet->access();
-	  // Calculate nfds (ignored on windows).
-#if !WINDOWS_CODE
-	  curl_socket_t const max_rfd = llmax(multi_handle_w->mReadPollSet->get_max_fd(), mWakeUpFd);
-	  curl_socket_t const max_wfd = multi_handle_w->mWritePollSet->get_max_fd();
-	  int nfds = llmax(max_rfd, max_wfd) + 1;
-	  llassert(1 <= nfds && nfds <= FD_SETSIZE);
-	  llassert((max_rfd == -1) == (read_fd_set == NULL) &&
-			   (max_wfd == -1) == (write_fd_set == NULL));	// Needed on Windows.
-	  llassert((max_rfd == -1 || multi_handle_w->mReadPollSet->is_set(max_rfd)) &&
-			   (max_wfd == -1 || multi_handle_w->mWritePollSet->is_set(max_wfd)));
-#else
-	  int nfds = 64;
-#endif
 	  int ready = 0;
-	  struct timeval timeout;
 	  // Update AICurlTimer::sTime_1ms.
 	  AICurlTimer::sTime_1ms = get_clock_count() * AICurlTimer::sClockWidth_1ms;
 	  Dout(dc::curl, "AICurlTimer::sTime_1ms = " << AICurlTimer::sTime_1ms);
@@ -1473,104 +1472,143 @@ void AICurlThread::run(void)
 		  LL_INFOS() << "Timeout of select() call by curl thread reset (to " << timeout_ms << " ms)." << LL_ENDL;
 		mZeroTimeout = 0;
 	  }
-	  timeout.tv_sec = timeout_ms / 1000;
-	  timeout.tv_usec = (timeout_ms % 1000) * 1000;
-#ifdef CWDEBUG
-#ifdef DEBUG_CURLIO
-	  Dout(dc::curl|flush_cf|continued_cf, "select(" << nfds << ", " << DebugFdSet(nfds, read_fd_set) << ", " << DebugFdSet(nfds, write_fd_set) << ", NULL, timeout = " << timeout_ms << " ms) = ");
-#else
-	  static int last_nfds = -1;
-	  static long last_timeout_ms = -1;
-	  static int same_count = 0;
-	  bool same = (nfds == last_nfds && timeout_ms == last_timeout_ms);
-	  if (!same)
+#if USE_EPOLL
+	  AICurlEpoll* epoll = multi_handle_w->mEpoll;
+	  if (epoll)
 	  {
-		if (same_count > 1)
-		  Dout(dc::curl, "Last select() call repeated " << same_count << " times.");
-		Dout(dc::curl|flush_cf|continued_cf, "select(" << nfds << ", ..., timeout = " << timeout_ms << " ms) = ");
-		same_count = 1;
+		// The sockets, and the wake up fd, were registered when libcurl asked for them.
+		ready = epoll->wait(timeout_ms);
+		mWakeUpFlagMutex.unlock();
+		if (ready == -1)
+		{
+		  if (errno != EINTR)
+			LL_WARNS() << "epoll_wait() failed: " << errno << ", " << strerror(errno) << LL_ENDL;
+		  continue;
+		}
 	  }
 	  else
-	  {
-		++same_count;
-	  }
 #endif
+	  {
+		// Copy the next batch of file descriptors from the PollSets mFileDescriptors into their mFdSet.
+		multi_handle_w->mReadPollSet->refresh();
+		refresh_t wres = multi_handle_w->mWritePollSet->refresh();
+		// Add wake up fd if any, and pass NULL to select() if a set is empty.
+		fd_set* read_fd_set = multi_handle_w->mReadPollSet->access();
+		FD_SET(mWakeUpFd, read_fd_set);
+		fd_set* write_fd_set = ((wres & empty)) ? NULL : multi_handle_w->mWritePollSet->access();
+		// Calculate nfds (ignored on windows).
+#if !WINDOWS_CODE
+		curl_socket_t const max_rfd = llmax(multi_handle_w->mReadPollSet->get_max_fd(), mWakeUpFd);
+		curl_socket_t const max_wfd = multi_handle_w->mWritePollSet->get_max_fd();
+		int nfds = llmax(max_rfd, max_wfd) + 1;
+		llassert(1 <= nfds && nfds <= FD_SETSIZE);
+		llassert((max_rfd == -1) == (read_fd_set == NULL) &&
+				 (max_wfd == -1) == (write_fd_set == NULL));	// Needed on Windows.
+		llassert((max_rfd == -1 || multi_handle_w->mReadPollSet->is_set(max_rfd)) &&
+				 (max_wfd == -1 || multi_handle_w->mWritePollSet->is_set(max_wfd)));
+#else
+		int nfds = 64;
 #endif
-	  ready = select(nfds, read_fd_set, write_fd_set, NULL, &timeout);
-	  mWakeUpFlagMutex.unlock();
+		struct timeval timeout;
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_usec = (timeout_ms % 1000) * 1000;
 #ifdef CWDEBUG
 #ifdef DEBUG_CURLIO
-	  Dout(dc::finish|cond_error_cf(ready == -1), ready);
+		Dout(dc::curl|flush_cf|continued_cf, "select(" << nfds << ", " << DebugFdSet(nfds, read_fd_set) << ", " << DebugFdSet(nfds, write_fd_set) << ", NULL, timeout = " << timeout_ms << " ms) = ");
 #else
-	  static int last_ready = -2;
-	  static int last_errno = 0;
-	  if (!same)
+		static int last_nfds = -1;
+		static long last_timeout_ms = -1;
+		static int same_count = 0;
+		bool same = (nfds == last_nfds && timeout_ms == last_timeout_ms);
+		if (!same)
+		{
+		  if (same_count > 1)
+			Dout(dc::curl, "Last select() call repeated " << same_count << " times.");
+		  Dout(dc::curl|flush_cf|continued_cf, "select(" << nfds << ", ..., timeout = " << timeout_ms << " ms) = ");
+		  same_count = 1;
+		}
+		else
+		{
+		  ++same_count;
+		}
+#endif
+#endif
+		ready = select(nfds, read_fd_set, write_fd_set, NULL, &timeout);
+		mWakeUpFlagMutex.unlock();
+#ifdef CWDEBUG
+#ifdef DEBUG_CURLIO
 		Dout(dc::finish|cond_error_cf(ready == -1), ready);
-	  else if (ready != last_ready || (ready == -1 && errno != last_errno))
-	  {
-		if (same_count > 1)
-		  Dout(dc::curl, "Last select() call repeated " << same_count << " times.");
-		Dout(dc::curl|cond_error_cf(ready == -1), "select(" << last_nfds << ", ..., timeout = " << last_timeout_ms << " ms) = " << ready);
-		same_count = 1;
-	  }
-	  last_nfds = nfds;
-	  last_timeout_ms = timeout_ms;
-	  last_ready = ready;
-	  if (ready == -1)
-		last_errno = errno;
+#else
+		static int last_ready = -2;
+		static int last_errno = 0;
+		if (!same)
+		  Dout(dc::finish|cond_error_cf(ready == -1), ready);
+		else if (ready != last_ready || (ready == -1 && errno != last_errno))
+		{
+		  if (same_count > 1)
+			Dout(dc::curl, "Last select() call repeated " << same_count << " times.");
+		  Dout(dc::curl|cond_error_cf(ready == -1), "select(" << last_nfds << ", ..., timeout = " << last_timeout_ms << " ms) = " << ready);
+		  same_count = 1;
+		}
+		last_nfds = nfds;
+		last_timeout_ms = timeout_ms;
+		last_ready = ready;
+		if (ready == -1)
+		  last_errno = errno;
 #endif
 #endif
-	  // Select returns the total number of bits set in each of the fd_set's (upon return),
-	  // or -1 when an error occurred. A value of 0 means that a timeout occurred.
-	  if (ready == -1)
-	  {
-		LL_WARNS() << "select() failed: " << errno << ", " << strerror(errno) << LL_ENDL;
-		if (errno == EBADF)
+		// Select returns the total number of bits set in each of the fd_set's (upon return),
+		// or -1 when an error occurred. A value of 0 means that a timeout occurred.
+		if (ready == -1)
 		{
-		  // Somewhere (fmodex?) one of our file descriptors was closed. Try to recover by finding out which.
-		  llassert_always(!is_bad(mWakeUpFd, false));		// We can't recover from this.
-		  PollSet* found = NULL;
-		  // Run over all read file descriptors.
-		  multi_handle_w->mReadPollSet->refresh();
-		  multi_handle_w->mReadPollSet->reset();
-		  curl_socket_t fd;
-		  while ((fd = multi_handle_w->mReadPollSet->get()) != CURL_SOCKET_BAD)
+		  LL_WARNS() << "select() failed: " << errno << ", " << strerror(errno) << LL_ENDL;
+		  if (errno == EBADF)
 		  {
-			if (is_bad(fd, false))
+			// Somewhere (fmodex?) one of our file descriptors was closed. Try to recover by finding out which.
+			llassert_always(!is_bad(mWakeUpFd, false));		// We can't recover from this.
+			PollSet* found = NULL;
+			// Run over all read file descriptors.
+			multi_handle_w->mReadPollSet->refresh();
+			multi_handle_w->mReadPollSet->reset();
+			curl_socket_t fd;
+			while ((fd = multi_handle_w->mReadPollSet->get()) != CURL_SOCKET_BAD)
 			{
-			  found = multi_handle_w->mReadPollSet;
-			  break;
+			  if (is_bad(fd, false))
+			  {
+				found = multi_handle_w->mReadPollSet;
+				break;
+			  }
+			  multi_handle_w->mReadPollSet->next();
 			}
-			multi_handle_w->mReadPollSet->next();
-		  }
-		  if (!found)
-		  {
-			// Try all write file descriptors.
-			refresh_t wres = multi_handle_w->mWritePollSet->refresh();
-			if (!(wres & empty))
+			if (!found)
 			{
-			  multi_handle_w->mWritePollSet->reset();
-			  while ((fd = multi_handle_w->mWritePollSet->get()) != CURL_SOCKET_BAD)
+			  // Try all write file descriptors.
+			  refresh_t wres = multi_handle_w->mWritePollSet->refresh();
+			  if (!(wres & empty))
 			  {
-				if (is_bad(fd, true))
+				multi_handle_w->mWritePollSet->reset();
+				while ((fd = multi_handle_w->mWritePollSet->get()) != CURL_SOCKET_BAD)
 				{
-				  found = multi_handle_w->mWritePollSet;
-				  break;
+				  if (is_bad(fd, true))
+				  {
+					found = multi_handle_w->mWritePollSet;
+					break;
+				  }
+				  multi_handle_w->mWritePollSet->next();
 				}
-				multi_handle_w->mWritePollSet->next();
 			  }
 			}
+			llassert_always(found);	// It makes no sense to continue if we can't recover.
+			// Find the corresponding CurlSocketInfo
+			CurlSocketInfo* sp = found->contains(fd);
+			llassert_always(sp);		// fd was just *read* from this sp.
+			sp->mark_dead();													// Make sure it's never used again.
+			AICurlEasyRequest_wat curl_easy_request_w(*sp->getEasyRequest());
+			curl_easy_request_w->pause(CURLPAUSE_ALL);						// Keep libcurl at bay.
+			curl_easy_request_w->bad_file_descriptor(curl_easy_request_w);	// Make the main thread cleanly terminate this transaction.
 		  }
-		  llassert_always(found);	// It makes no sense to continue if we can't recover.
-		  // Find the corresponding CurlSocketInfo
-		  CurlSocketInfo* sp = found->contains(fd);
-		  llassert_always(sp);		// fd was just *read* from this sp.
-		  sp->mark_dead();													// Make sure it's never used again.
-		  AICurlEasyRequest_wat curl_easy_request_w(*sp->getEasyRequest());
-		  curl_easy_request_w->pause(CURLPAUSE_ALL);						// Keep libcurl at bay.
-		  curl_easy_request_w->bad_file_descriptor(curl_easy_request_w);	// Make the main thread cleanly terminate this transaction.
+		  continue;
 		}
-		continue;
 	  }
 	  // Update the clocks.
 	  AICurlTimer::sTime_1ms = get_clock_count() * AICurlTimer::sClockWidth_1ms;
@@ -1596,6 +1634,29 @@ void AICurlThread::run(void)
 		// Handle stalling transactions.
 		multi_handle_w->handle_stalls();
 	  }
+#if USE_EPOLL
+	  else if (epoll)
+	  {
+		// Handle the events in the order that epoll returned them.
+		curl_socket_t fd;
+		int ev_bitmask;
+		for (int i = 0; i < ready; ++i)
+		{
+		  // Handling an event can cause libcurl to remove sockets, making their events stale.
+		  if (!epoll->get_event(i, fd, ev_bitmask))
+			continue;
+		  if (fd == mWakeUpFd)
+		  {
+			// Process commands from main-thread. This can add or remove sockets too.
+			wakeup(multi_handle_w);
+		  }
+		  else
+		  {
+			multi_handle_w->socket_action(fd, ev_bitmask);
+		  }
+		}
+	  }
+#endif
 	  else
 	  {
 		if (multi_handle_w->mReadPollSet->is_set(mWakeUpFd))
@@ -1632,10 +1693,18 @@ void AICurlThread::run(void)
 
 LLAtomicU32 MultiHandle::sTotalAdded;
 
-MultiHandle::MultiHandle(void) : mTimeout(-1), mReadPollSet(NULL), mWritePollSet(NULL)
+MultiHandle::MultiHandle(void) : mTimeout(-1), mReadPollSet(NULL), mWritePollSet(NULL), mEpoll(NULL)
 {
   mReadPollSet = new PollSet;
   mWritePollSet = new PollSet;
+#if USE_EPOLL
+  mEpoll = new AICurlEpoll;
+  if (!mEpoll->valid())
+  {
+	delete mEpoll;
+	mEpoll = NULL;
+  }
+#endif
   check_multi_code(curl_multi_setopt(mMultiHandle, CURLMOPT_SOCKETFUNCTION, &MultiHandle::socket_callback));
   check_multi_code(curl_multi_setopt(mMultiHandle, CURLMOPT_SOCKETDATA, this));
   check_multi_code(curl_multi_setopt(mMultiHandle, CURLMOPT_TIMERFUNCTION, &MultiHandle::timer_callback));
@@ -1655,6 +1724,9 @@ MultiHandle::~MultiHandle()
   }
   delete mWritePollSet;
   delete mReadPollSet;
+#if USE_EPOLL
+  delete mEpoll;
+#endif
 }
 
 void MultiHandle::handle_stalls(void)
@@ -36,6 +36,8 @@
 
 #undef AICurlPrivate
 
+class AICurlEpoll;
+
 namespace AICurlPrivate {
 namespace curlthread {
 
@@ -114,6 +116,7 @@ class MultiHandle : public CurlMultiHandle
 
 	PollSet* mReadPollSet;
 	PollSet* mWritePollSet;
+	AICurlEpoll* mEpoll;			// When not NULL the sockets are waited on with epoll and the poll sets are not used.
 };
 
 } // namespace curlthread
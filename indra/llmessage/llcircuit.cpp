@@ -134,11 +134,10 @@ LLCircuitData::~LLCircuitData()
 
 	// remove all pending reliable messages on this circuit
 	std::vector<TPACKETID> doomed;
-	reliable_iter iter;
-	reliable_iter end = mUnackedPackets.end();
-	for(iter = mUnackedPackets.begin(); iter != end; ++iter)
+	TPACKETID packet_id;
+	for (packet_id = mUnackedPackets.getOldestID(); LLReliablePacket** slotp = mUnackedPackets.findNext(packet_id); ++packet_id)
 	{
-		packetp = iter->second;
+		packetp = *slotp;
 		gMessageSystem->mFailedResendPackets++;
 		if(gMessageSystem->mVerboseLog)
 		{
@@ -157,10 +156,9 @@ LLCircuitData::~LLCircuitData()
 	}
 
 	// remove all pending final retry reliable messages on this circuit
-	end = mFinalRetryPackets.end();
-	for(iter = mFinalRetryPackets.begin(); iter != end; ++iter)
+	for (packet_id = mFinalRetryPackets.getOldestID(); LLReliablePacket** slotp = mFinalRetryPackets.findNext(packet_id); ++packet_id)
 	{
-		packetp = iter->second;
+		packetp = *slotp;
 		gMessageSystem->mFailedResendPackets++;
 		if(gMessageSystem->mVerboseLog)
 		{
@@ -192,48 +190,33 @@ LLCircuitData::~LLCircuitData()
 
 void LLCircuitData::ackReliablePacket(TPACKETID packet_num)
 {
-	reliable_iter iter;
-	LLReliablePacket *packetp;
+	ackReliablePackets(&packet_num, 1);
+}
 
-	iter = mUnackedPackets.find(packet_num);
-	if (iter != mUnackedPackets.end())
-	{
-		packetp = iter->second;
 
-		if(gMessageSystem->mVerboseLog)
+void LLCircuitData::ackReliablePackets(const TPACKETID* packet_nums, S32 count)
+{
+	for (S32 i = 0; i < count; ++i)
+	{
+		const TPACKETID packet_num = packet_nums[i];
+		reliable_ring* packets = &mUnackedPackets;
+		LLReliablePacket** slotp = mUnackedPackets.find(packet_num);
+		if (!slotp)
 		{
-			std::ostringstream str;
-			str << "MSG: <- " << packetp->mHost << "\tRELIABLE ACKED:\t"
-				<< packetp->mPacketID;
-			LL_INFOS() << str.str() << LL_ENDL;
+			packets = &mFinalRetryPackets;
+			slotp = mFinalRetryPackets.find(packet_num);
 		}
-		if (packetp->mCallback)
+		if (!slotp)
 		{
-			if (packetp->mTimeout < F32Seconds(0.f))   // negative timeout will always return timeout even for successful ack, for debugging
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);					
-			}
-			else
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_NOERR);
-			}
+			// Couldn't find this packet on either of the unacked lists.
+			// maybe it's a duplicate ack?
+			continue;
 		}
 
-		// Update stats
-		mUnackedPacketCount--;
-		mUnackedPacketBytes -= packetp->mBufferLength;
+		// Take it off its list first: the callback may send more.
+		LLReliablePacket* packetp = *slotp;
+		packets->erase(packet_num);
 
-		// Cleanup
-		delete packetp;
-		mUnackedPackets.erase(iter);
-		return;
-	}
-
-	iter = mFinalRetryPackets.find(packet_num);
-	if (iter != mFinalRetryPackets.end())
-	{
-		packetp = iter->second;
-		// LL_INFOS() << "Packet " << packet_num << " removed from the pending list" << LL_ENDL;
 		if(gMessageSystem->mVerboseLog)
 		{
 			std::ostringstream str;
@@ -259,12 +242,6 @@ void LLCircuitData::ackReliablePacket(TPACKETID packet_num)
 
 		// Cleanup
 		delete packetp;
-		mFinalRetryPackets.erase(iter);
-	}
-	else
-	{
-		// Couldn't find this packet on either of the unacked lists.
-		// maybe it's a duplicate ack?
 	}
 }
 
@@ -276,18 +253,14 @@ S32 LLCircuitData::resendUnackedPackets(const F64Seconds now)
 	LLReliablePacket *packetp;
 
 
-	//
-	// Theoretically we should search through the list for the packet with the oldest
-	// packet ID, as otherwise when we WRAP we will resend reliable packets out of order.
-	// Since resends are ALREADY out of order, and wrapping is highly rare (16+million packets),
-	// I'm not going to worry about this for now - djs
-	//
+	// The ring keeps the packets in the order they were sent, even when the
+	// packet IDs wrap, so the oldest are resent first.
 
-	reliable_iter iter;
+	TPACKETID packet_id;
 	BOOL have_resend_overflow = FALSE;
-	for (iter = mUnackedPackets.begin(); iter != mUnackedPackets.end();)
+	for (packet_id = mUnackedPackets.getOldestID(); LLReliablePacket** slotp = mUnackedPackets.findNext(packet_id); ++packet_id)
 	{
-		packetp = iter->second;
+		packetp = *slotp;
 
 		// Only check overflow if we haven't had one yet.
 		if (!have_resend_overflow)
@@ -308,12 +281,8 @@ S32 LLCircuitData::resendUnackedPackets(const F64Seconds now)
 					// This circuit has overflowed.  Do not retry.  Do not pass go.
 					packetp->mRetries = 0;
 					// Remove it from this list and add it to the final list.
-					mUnackedPackets.erase(iter++);
-					mFinalRetryPackets[packetp->mPacketID] = packetp;
-				}
-				else
-				{
-					++iter;
+					mUnackedPackets.erase(packet_id);
+					mFinalRetryPackets.insert(packet_id, packetp);
 				}
 				// Move on to the next unacked packet.
 				continue;
@@ -368,27 +337,19 @@ S32 LLCircuitData::resendUnackedPackets(const F64Seconds now)
 			if (!packetp->mRetries)
 			{
 				// Last resend, remove it from this list and add it to the final list.
-				mUnackedPackets.erase(iter++);
-				mFinalRetryPackets[packetp->mPacketID] = packetp;
-			}
-			else
-			{
-				// Don't remove it yet, it still gets to try to resend at least once.
-				++iter;
+				mUnackedPackets.erase(packet_id);
+				mFinalRetryPackets.insert(packet_id, packetp);
 			}
+			// Otherwise don't remove it yet, it still gets to try to resend at least once.
 			resent_packets++;
 		}
-		else
-		{
-			// Don't need to do anything with this packet, keep iterating.
-			++iter;
-		}
+		// Otherwise don't need to do anything with this packet, keep iterating.
 	}
 
 
-	for (iter = mFinalRetryPackets.begin(); iter != mFinalRetryPackets.end();)
+	for (packet_id = mFinalRetryPackets.getOldestID(); LLReliablePacket** slotp = mFinalRetryPackets.findNext(packet_id); ++packet_id)
 	{
-		packetp = iter->second;
+		packetp = *slotp;
 		if (now > packetp->mExpirationTime)
 		{
 			// fail (too many retries)
@@ -416,13 +377,9 @@ S32 LLCircuitData::resendUnackedPackets(const F64Seconds now)
 			mUnackedPacketCount--;
 			mUnackedPacketBytes -= packetp->mBufferLength;
 
-			mFinalRetryPackets.erase(iter++);
+			mFinalRetryPackets.erase(packet_id);
 			delete packetp;
 		}
-		else
-		{
-			++iter;
-		}
 	}
 
 	return mUnackedPacketCount;
@@ -576,11 +533,11 @@ void LLCircuitData::addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLR
 
 	if (params && params->mRetries)
 	{
-		mUnackedPackets[packet_info->mPacketID] = packet_info;
+		mUnackedPackets.insert(packet_info->mPacketID, packet_info);
 	}
 	else
 	{
-		mFinalRetryPackets[packet_info->mPacketID] = packet_info;
+		mFinalRetryPackets.insert(packet_info->mPacketID, packet_info);
 	}
 }
 
@@ -866,91 +823,34 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 	// the ping was sent.
 
 	// Find the current oldest reliable packetID
-	// This is to handle the case if we actually manage to wrap our
-	// packet IDs - the oldest will actually have a higher packet ID
-	// than the current.
-	BOOL wrapped = FALSE;
-	reliable_iter iter;
-	iter = mUnackedPackets.upper_bound(getPacketOutID());
-	if (iter == mUnackedPackets.end())
+	// The rings keep their packets in send order, across a wrap of the
+	// packet IDs, so the oldest is the first of one of them: whichever
+	// was sent longer before the current packet.
+	TPACKETID packet_id = 0;
+	if (mUnackedPackets.empty() && mFinalRetryPackets.empty())
 	{
-		// Nothing AFTER this one, so we want the lowest packet ID
-		// then.
-		iter = mUnackedPackets.begin();
-		wrapped = TRUE;
+		// Wow!  No unacked packets at all!
+		// Send the ID of the last packet we sent out.
+		// This will flush all of the destination's
+		// unacked packets, theoretically.
+		packet_id = getPacketOutID();
 	}
-
-	TPACKETID packet_id = 0;
-
-	// Check against the "final" packets
-	BOOL wrapped_final = FALSE;
-	reliable_iter iter_final;
-	iter_final = mFinalRetryPackets.upper_bound(getPacketOutID());
-	if (iter_final == mFinalRetryPackets.end())
+	else if (mFinalRetryPackets.empty())
 	{
-		iter_final = mFinalRetryPackets.begin();
-		wrapped_final = TRUE;
+		packet_id = mUnackedPackets.getOldestID();
 	}
-
-	//LL_INFOS() << mHost << " - unacked count " << mUnackedPackets.size() << LL_ENDL;
-	//LL_INFOS() << mHost << " - final count " << mFinalRetryPackets.size() << LL_ENDL;
-	if (wrapped != wrapped_final)
+	else if (mUnackedPackets.empty())
 	{
-		// One of the "unacked" or "final" lists hasn't wrapped.  Whichever one
-		// hasn't has the oldest packet.
-		if (!wrapped)
-		{
-			// Hasn't wrapped, so the one on the
-			// unacked packet list is older
-			packet_id = iter->first;
-			//LL_INFOS() << mHost << ": nowrapped unacked" << LL_ENDL;
-		}
-		else
-		{
-			packet_id = iter_final->first;
-			//LL_INFOS() << mHost << ": nowrapped final" << LL_ENDL;
-		}
+		packet_id = mFinalRetryPackets.getOldestID();
 	}
 	else
 	{
-		// They both wrapped, we can just use the minimum of the two.
-		if ((iter == mUnackedPackets.end()) && (iter_final == mFinalRetryPackets.end()))
-		{
-			// Wow!  No unacked packets at all!
-			// Send the ID of the last packet we sent out.
-			// This will flush all of the destination's
-			// unacked packets, theoretically.
-			//LL_INFOS() << mHost << ": No unacked!" << LL_ENDL;
-			packet_id = getPacketOutID();
-		}
-		else
-		{
-			BOOL had_unacked = FALSE;
-			if (iter != mUnackedPackets.end())
-			{
-				// Unacked list has the lowest so far
-				packet_id = iter->first;
-				had_unacked = TRUE;
-				//LL_INFOS() << mHost << ": Unacked" << LL_ENDL;
-			}
-
-			if (iter_final != mFinalRetryPackets.end())
-			{
-				// Use the lowest of the unacked list and the final list
-				if (had_unacked)
-				{
-					// Both had a packet, use the lowest.
-					packet_id = llmin(packet_id, iter_final->first);
-					//LL_INFOS() << mHost << ": Min of unacked/final" << LL_ENDL;
-				}
-				else
-				{
-					// Only the final had a packet, use it.
-					packet_id = iter_final->first;
-					//LL_INFOS() << mHost << ": Final!" << LL_ENDL;
-				}
-			}
-		}
+		const TPACKETID out_id = getPacketOutID();
+		const TPACKETID unacked_id = mUnackedPackets.getOldestID();
+		const TPACKETID final_id = mFinalRetryPackets.getOldestID();
+		const U32 unacked_age = (out_id - unacked_id) % LL_MAX_OUT_PACKET_ID;
+		const U32 final_age = (out_id - final_id) % LL_MAX_OUT_PACKET_ID;
+		packet_id = unacked_age >= final_age ? unacked_id : final_id;
 	}
 
 	// Send off the another ping.
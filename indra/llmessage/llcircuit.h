@@ -37,6 +37,7 @@
 #include "net.h"
 #include "llhost.h"
 #include "llpacketack.h"
+#include "llpacketidring.h"
 #include "lluuid.h"
 #include "llthrottle.h"
 
@@ -50,6 +51,7 @@ const F32Milliseconds LL_AVERAGED_PING_MIN(100);    // increased to avoid retran
 const U32Milliseconds INITIAL_PING_VALUE_MSEC(1000); // initial value for the ping delay, or for ping delay for an unknown circuit
 
 const TPACKETID LL_MAX_OUT_PACKET_ID = 0x01000000;
+static_assert(LLPacketIDRing<void*>::ID_MASK + 1 == LL_MAX_OUT_PACKET_ID, "packet ID rings must wrap with the packet IDs");
 const int LL_ERR_CIRCUIT_GONE   = -23017;
 const int LL_ERR_TCP_TIMEOUT    = -23016;
 
@@ -93,6 +95,8 @@ public:
 	void		pingTimerStart();
 	void		pingTimerStop(const U8 ping_id);
 	void			ackReliablePacket(TPACKETID packet_num);
+	// The acks of one packet or PacketAck message, applied together.
+	void			ackReliablePackets(const TPACKETID* packet_nums, S32 count);
 
 	// remote computer information
 	const LLUUID& getRemoteID() const { return mRemoteID; }
@@ -240,11 +244,11 @@ protected:
 	std::vector<TPACKETID> mAcks;
 	F32 mAckCreationTime; // first ack creation time
 
-	typedef std::map<TPACKETID, LLReliablePacket *> reliable_map;
-	typedef reliable_map::iterator					reliable_iter;
+	// Reliable packets sent and not acked yet, by packet ID.
+	typedef LLPacketIDRing<LLReliablePacket *> reliable_ring;
 
-	reliable_map							mUnackedPackets;
-	reliable_map							mFinalRetryPackets;
+	reliable_ring							mUnackedPackets;
+	reliable_ring							mFinalRetryPackets;
 
 	S32										mUnackedPacketCount;
 	S32										mUnackedPacketBytes;
@@ -326,8 +326,15 @@ void LLHTTPClient::ResponderBase::decode_llsd_body(LLChannelDescriptors const& c
 	bool const should_be_llsd = isGoodStatus(mStatus);
 	if (should_be_llsd)
 	{
-		LLBufferStream istr(channels, buffer.get());
-		if (LLSDSerialize::fromXML(mContent, istr) == LLSDParser::PARSE_FAILURE)
+		// The body is complete: copy it out of the buffer once and parse it in memory,
+		// which is much faster than parsing it through an LLBufferStream.
+		S32 length = buffer->count(channels.in());
+		std::vector<char> body(length);
+		if (length)
+		{
+			buffer->readAfter(channels.in(), NULL, (U8*)&body[0], length);
+		}
+		if (LLSDSerialize::fromXML(mContent, length ? &body[0] : NULL, length) == LLSDParser::PARSE_FAILURE)
 		{
 			// Unfortunately we can't show the body of the message... I think this is a pretty serious error
 			// though, so if this ever happens it has to be investigated by making a copy of the buffer
@@ -335,7 +342,6 @@ void LLHTTPClient::ResponderBase::decode_llsd_body(LLChannelDescriptors const& c
 			LL_WARNS() << "Failed to deserialize LLSD. " << mURL << " [" << mStatus << "]: " << mReason << LL_ENDL;
 			AICurlInterface::Stats::llsd_body_parse_error++;
 		}
-		// LLSDSerialize::fromXML destructed buffer, we can't initialize mContent now.
 		return;
 	}
 	// Put the body in mContent as-is.
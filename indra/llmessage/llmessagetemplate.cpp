@@ -72,6 +72,60 @@ void LLMsgData::addDataFast(char *blockname, char *varname, const void *data, S3
 	}
 }
 
+// LLMessageNameIndex functions
+
+LLMessageNameIndex::LLMessageNameIndex()
+:	mMultiplier(0),
+	mShift(0)
+{
+	Slot empty = { NULL, -1 };
+	mSlots.assign(1, empty);
+}
+
+void LLMessageNameIndex::build(const std::vector<const char*>& names)
+{
+	Slot empty = { NULL, -1 };
+	mSlots.assign(1, empty);
+	mMultiplier = 0;
+	mShift = 0;
+	if (names.empty())
+	{
+		return;
+	}
+
+	// Start at twice as many slots as names, and try a few multipliers at
+	// each size; a template has no more than a few dozen names.
+	U32 bits = 1;
+	while (((size_t)1 << bits) < names.size() * 2)
+	{
+		++bits;
+	}
+	U64 multiplier = 0x9e3779b97f4a7c15ULL;
+	for (; bits < 16; ++bits)
+	{
+		for (S32 attempt = 0; attempt < 32; ++attempt)
+		{
+			mSlots.assign((size_t)1 << bits, empty);
+			mMultiplier = multiplier;
+			mShift = 64 - bits;
+			bool collided = false;
+			for (size_t i = 0; i < names.size() && !collided; ++i)
+			{
+				Slot& slot = mSlots[(size_t)(((U64)(uintptr_t)names[i] * mMultiplier) >> mShift)];
+				collided = slot.mName != NULL;
+				slot.mName = names[i];
+				slot.mIndex = (S32)i;
+			}
+			if (!collided)
+			{
+				return;
+			}
+			multiplier = (multiplier * 6364136223846793005ULL + 1442695040888963407ULL) | 1;
+		}
+	}
+	LL_ERRS() << "Could not index " << names.size() << " names, is one of them there twice?" << LL_ENDL;
+}
+
 // LLMessageVariable functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageVariable &msg)
@@ -132,6 +186,18 @@ std::ostream& operator<<(std::ostream& s, LLMessageBlock &msg)
 	return s;
 }
 
+void LLMessageBlock::indexVariables()
+{
+	std::vector<const char*> names;
+	names.reserve(mMemberVariables.size());
+	for (message_variable_map_t::const_iterator iter = mMemberVariables.begin();
+		 iter != mMemberVariables.end(); ++iter)
+	{
+		names.push_back(mMemberVariables.toValue(iter)->getName());
+	}
+	mVariableIndex.build(names);
+}
+
 // LLMessageTemplate functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageTemplate &msg)
@@ -195,3 +261,14 @@ void LLMessageTemplate::banUdp()
 	}
 }
 
+void LLMessageTemplate::indexBlocks()
+{
+	std::vector<const char*> names;
+	names.reserve(mMemberBlocks.size());
+	for (message_block_map_t::const_iterator iter = mMemberBlocks.begin();
+		 iter != mMemberBlocks.end(); ++iter)
+	{
+		names.push_back(mMemberBlocks.toValue(iter)->mName);
+	}
+	mBlockIndex.build(names);
+}
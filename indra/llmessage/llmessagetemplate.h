@@ -172,6 +172,38 @@ protected:
 };
 
 
+// The index of a block in a template, or of a variable in a block, by name.
+// Names are interned by LLMessageStringTable, so a name is its pointer: the
+// table is built when the template is read, with a multiplier that hashes
+// every name to a slot of its own, and a lookup is a multiply, a shift and
+// one compare, however many names there are.
+class LLMessageNameIndex
+{
+public:
+	LLMessageNameIndex();
+
+	// Indexes names by their position.
+	void build(const std::vector<const char*>& names);
+
+	// The index of name, or -1.
+	S32 find(const char* name) const
+	{
+		const Slot& slot = mSlots[(size_t)(((U64)(uintptr_t)name * mMultiplier) >> mShift)];
+		return slot.mName == name ? slot.mIndex : -1;
+	}
+
+private:
+	struct Slot
+	{
+		const char*	mName;
+		S32			mIndex;
+	};
+
+	std::vector<Slot>	mSlots;		// A power of two of them.
+	U64					mMultiplier;
+	U32					mShift;
+};
+
 typedef enum e_message_block_type
 {
 	MBT_NULL,
@@ -211,6 +243,7 @@ public:
 		{
 			mTotalSize = -1;
 		}
+		indexVariables();
 	}
 
 	EMsgVariableType getVariableType(char *name)
@@ -229,6 +262,12 @@ public:
 		return iter != mMemberVariables.end() ? mMemberVariables.toValue(iter) : NULL;
 	}
 
+	// The position of the variable in mMemberVariables, or -1.
+	S32 getVariableIndex(const char* name) const
+	{
+		return mVariableIndex.find(name);
+	}
+
 	friend std::ostream&	 operator<<(std::ostream& s, LLMessageBlock &msg);
 
 	typedef LLIndexedVector<LLMessageVariable*, const char *, 8> message_variable_map_t;
@@ -237,6 +276,11 @@ public:
 	EMsgBlockType							mType;
 	S32										mNumber;
 	S32										mTotalSize;
+
+private:
+	void indexVariables();
+
+	LLMessageNameIndex						mVariableIndex;
 };
 
 
@@ -291,7 +335,8 @@ public:
 		mBanFromTrusted(false),
 		mBanFromUntrusted(false),
 		mHandlerFunc(NULL), 
-		mUserData(NULL)
+		mUserData(NULL),
+		mHandlerSkipsDeferredWork(false)
 	{ 
 		mName = LLMessageStringTable::getInstance()->getString(name);
 	}
@@ -321,6 +366,7 @@ public:
 		{
 			mTotalSize = -1;
 		}
+		indexBlocks();
 	}
 
 	LLMessageBlock *getBlock(char *name)
@@ -375,6 +421,17 @@ public:
 		return FALSE;
 	}
 
+	// Whether the handler may run before the work other handlers left for
+	// later is finished; see LLMessageSystem::finishDeferredWork().
+	void setHandlerSkipsDeferredWork(bool skips)
+	{
+		mHandlerSkipsDeferredWork = skips;
+	}
+	bool getHandlerSkipsDeferredWork() const
+	{
+		return mHandlerSkipsDeferredWork;
+	}
+
 	bool isUdpBanned() const
 	{
 		return mDeprecation == MD_UDPBLACKLISTED;
@@ -395,6 +452,12 @@ public:
 		return iter != mMemberBlocks.end()? mMemberBlocks.toValue(iter): NULL;
 	}
 
+	// The position of the block in mMemberBlocks, or -1.
+	S32 getBlockIndex(const char* name) const
+	{
+		return mBlockIndex.find(name);
+	}
+
 public:
 	typedef LLIndexedVector<LLMessageBlock*, char*, 8> message_block_map_t;
 	message_block_map_t						mMemberBlocks;
@@ -417,9 +480,14 @@ public:
 	bool									mBanFromUntrusted;
 
 private:
+	void indexBlocks();
+
+	LLMessageNameIndex						mBlockIndex;
+
 	// message handler function (this is set by each application)
 	void									(*mHandlerFunc)(LLMessageSystem *msgsystem, void **user_data);
 	void									**mUserData;
+	bool									mHandlerSkipsDeferredWork;
 };
 
 #endif // LL_LLMESSAGETEMPLATE_H
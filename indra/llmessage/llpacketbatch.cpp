@@ -0,0 +1,263 @@
+/**
+ * @file llpacketbatch.cpp
+ * @brief Datagrams received and sent in batches.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpacketbatch.h"
+
+#if LL_LINUX
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+#endif
+
+#if LL_LINUX
+struct LLReceiveRing::Batch
+{
+	struct mmsghdr mHeaders[RECEIVE_BATCH];
+	struct iovec mIOVecs[RECEIVE_BATCH];
+	struct sockaddr_in mAddresses[RECEIVE_BATCH];
+	char mControl[RECEIVE_BATCH][CMSG_SPACE(sizeof(struct in_pktinfo))];
+};
+#endif
+
+LLReceiveRing::LLReceiveRing(U32 capacity)
+:	mHead(0),
+	mCachedTail(0),
+	mTail(0),
+	mCachedHead(0)
+{
+	U32 size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	mMask = size - 1;
+	mPackets = new Packet[size];
+#if LL_LINUX
+	mBatch = new Batch;
+#endif
+}
+
+LLReceiveRing::~LLReceiveRing()
+{
+#if LL_LINUX
+	delete mBatch;
+#endif
+	delete[] mPackets;
+}
+
+U32 LLReceiveRing::receive(S32 socket)
+{
+	const U32 tail = mTail.load(std::memory_order_relaxed);
+	U32 free_packets = getCapacity() - (tail - mCachedHead);
+	if (free_packets < RECEIVE_BATCH)
+	{
+		mCachedHead = mHead.load(std::memory_order_acquire);
+		free_packets = getCapacity() - (tail - mCachedHead);
+		if (!free_packets)
+		{
+			return 0;
+		}
+	}
+	const U32 count = llmin(free_packets, RECEIVE_BATCH);
+
+	U32 received = 0;
+#if LL_LINUX
+	for (U32 i = 0; i < count; ++i)
+	{
+		Packet& packet = mPackets[(tail + i) & mMask];
+		mBatch->mIOVecs[i].iov_base = packet.mData;
+		mBatch->mIOVecs[i].iov_len = NET_BUFFER_SIZE;
+		struct msghdr& msg = mBatch->mHeaders[i].msg_hdr;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &mBatch->mAddresses[i];
+		msg.msg_namelen = sizeof(struct sockaddr_in);
+		msg.msg_iov = &mBatch->mIOVecs[i];
+		msg.msg_iovlen = 1;
+		msg.msg_control = mBatch->mControl[i];
+		msg.msg_controllen = sizeof(mBatch->mControl[i]);
+	}
+	int ret = recvmmsg(socket, mBatch->mHeaders, count, MSG_DONTWAIT, NULL);
+	if (ret <= 0)
+	{
+		return 0;
+	}
+	received = (U32)ret;
+	for (U32 i = 0; i < received; ++i)
+	{
+		Packet& packet = mPackets[(tail + i) & mMask];
+		struct msghdr& msg = mBatch->mHeaders[i].msg_hdr;
+		const struct sockaddr_in& address = mBatch->mAddresses[i];
+		packet.mSize = (S32)mBatch->mHeaders[i].msg_len;
+		packet.mSender = LLHost(address.sin_addr.s_addr, ntohs(address.sin_port));
+		// The address the datagram was sent to, as receive_packet() finds it.
+		U32 receiving_ip = INVALID_HOST_IP_ADDRESS;
+		for (struct cmsghdr* cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr; cmsgptr = CMSG_NXTHDR(&msg, cmsgptr))
+		{
+			if (cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO)
+			{
+				receiving_ip = ((struct in_pktinfo*)CMSG_DATA(cmsgptr))->ipi_spec_dst.s_addr;
+			}
+		}
+		packet.mReceivingIF = LLHost(receiving_ip, INVALID_PORT);
+	}
+#else
+	while (received < count)
+	{
+		Packet& packet = mPackets[(tail + received) & mMask];
+		S32 size = receive_packet(socket, packet.mData);
+		if (size <= 0)
+		{
+			break;
+		}
+		packet.mSize = size;
+		packet.mSender = get_sender();
+		packet.mReceivingIF = get_receiving_interface();
+		++received;
+	}
+#endif
+
+	if (received)
+	{
+		mTail.store(tail + received, std::memory_order_release);
+	}
+	return received;
+}
+
+bool LLReceiveRing::isFull()
+{
+	const U32 tail = mTail.load(std::memory_order_relaxed);
+	if (tail - mCachedHead < getCapacity())
+	{
+		return false;
+	}
+	mCachedHead = mHead.load(std::memory_order_acquire);
+	return tail - mCachedHead >= getCapacity();
+}
+
+const LLReceiveRing::Packet* LLReceiveRing::front()
+{
+	const U32 head = mHead.load(std::memory_order_relaxed);
+	if (head == mCachedTail)
+	{
+		// Picks up everything received since, at once.
+		mCachedTail = mTail.load(std::memory_order_acquire);
+		if (head == mCachedTail)
+		{
+			return NULL;
+		}
+	}
+	return &mPackets[head & mMask];
+}
+
+void LLReceiveRing::pop()
+{
+	const U32 head = mHead.load(std::memory_order_relaxed);
+	llassert(head != mCachedTail);
+	mHead.store(head + 1, std::memory_order_release);
+}
+
+#if LL_LINUX
+struct LLSendBatch::Batch
+{
+	struct mmsghdr mHeaders[MAX_PACKETS];
+	struct iovec mIOVecs[MAX_PACKETS];
+	struct sockaddr_in mAddresses[MAX_PACKETS];
+};
+#endif
+
+LLSendBatch::LLSendBatch()
+{
+	mPackets.reserve(MAX_PACKETS);
+#if LL_LINUX
+	mBatch = new Batch;
+#endif
+}
+
+LLSendBatch::~LLSendBatch()
+{
+#if LL_LINUX
+	delete mBatch;
+#endif
+}
+
+void LLSendBatch::add(const char* datap, S32 size, U32 ip, U32 port)
+{
+	llassert(!isFull());
+	Destination packet = { (U32)mData.size(), size, ip, port };
+	mData.insert(mData.end(), datap, datap + size);
+	mPackets.push_back(packet);
+}
+
+S32 LLSendBatch::flush(S32 socket)
+{
+	U32 sent = 0;
+#if LL_LINUX
+	const U32 count = (U32)mPackets.size();
+	for (U32 i = 0; i < count; ++i)
+	{
+		const Destination& packet = mPackets[i];
+		struct sockaddr_in& address = mBatch->mAddresses[i];
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = packet.mIP;
+		address.sin_port = htons(packet.mPort);
+		mBatch->mIOVecs[i].iov_base = mData.data() + packet.mOffset;
+		mBatch->mIOVecs[i].iov_len = packet.mSize;
+		struct msghdr& msg = mBatch->mHeaders[i].msg_hdr;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &address;
+		msg.msg_namelen = sizeof(address);
+		msg.msg_iov = &mBatch->mIOVecs[i];
+		msg.msg_iovlen = 1;
+	}
+	if (count)
+	{
+		int ret = sendmmsg(socket, mBatch->mHeaders, count, 0);
+		if (ret > 0)
+		{
+			sent = (U32)ret;
+		}
+	}
+#endif
+
+	// Whatever was not sent yet, for instance because the socket buffer
+	// filled up, goes out one at a time, retrying the way send_packet() does.
+	S32 failed = 0;
+	for (U32 i = sent; i < mPackets.size(); ++i)
+	{
+		const Destination& packet = mPackets[i];
+		if (!send_packet(socket, mData.data() + packet.mOffset, packet.mSize, packet.mIP, packet.mPort))
+		{
+			++failed;
+		}
+	}
+	mPackets.clear();
+	mData.clear();
+	return failed;
+}
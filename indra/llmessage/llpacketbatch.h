@@ -0,0 +1,131 @@
+/**
+ * @file llpacketbatch.h
+ * @brief Datagrams received and sent in batches.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETBATCH_H
+#define LL_LLPACKETBATCH_H
+
+#include <atomic>
+#include <vector>
+
+#include "llhost.h"
+#include "net.h"
+
+// A fixed pool of datagram buffers used as a ring, filled by one thread and
+// emptied by another without locks. The filling side reads the datagrams
+// waiting on the socket straight into free buffers, up to RECEIVE_BATCH at a
+// time (in one recvmmsg() call on linux), and hands them over all at once.
+// The emptying side takes them one at a time, in the order they arrived.
+class LLReceiveRing
+{
+public:
+	struct Packet
+	{
+		S32		mSize;
+		LLHost	mSender;
+		LLHost	mReceivingIF;
+		char	mData[NET_BUFFER_SIZE];
+	};
+
+	static const U32 RECEIVE_BATCH = 64;
+
+	// capacity is rounded up to a power of two.
+	LLReceiveRing(U32 capacity);
+	~LLReceiveRing();
+
+	// Filling thread. Reads the datagrams waiting on socket into free
+	// buffers, at most RECEIVE_BATCH of them. Returns how many were read:
+	// zero when none are waiting or when the ring is full.
+	U32 receive(S32 socket);
+	bool isFull();
+
+	// Emptying thread. Returns the oldest packet, or NULL when there is
+	// none; it stays valid until pop().
+	const Packet* front();
+	void pop();
+
+	U32 getCapacity() const		{ return mMask + 1; }
+
+private:
+	U32 mMask;
+	Packet* mPackets;
+
+	// Written by the emptying thread, on its own cache line.
+	char mPad0[64];
+	std::atomic<U32> mHead;
+	U32 mCachedTail;			// Last mTail the emptying thread saw.
+
+	// Written by the filling thread.
+	char mPad1[64];
+	std::atomic<U32> mTail;
+	U32 mCachedHead;			// Last mHead the filling thread saw.
+	char mPad2[64];
+
+#if LL_LINUX
+	struct Batch;
+	Batch* mBatch;				// recvmmsg() arguments.
+#endif
+
+	// Not copyable: owns mPackets.
+	LLReceiveRing(const LLReceiveRing&);
+	LLReceiveRing& operator=(const LLReceiveRing&);
+};
+
+// Datagrams queued to be sent together, in one sendmmsg() call on linux and
+// one after another elsewhere. The data is copied when queued.
+class LLSendBatch
+{
+public:
+	static const U32 MAX_PACKETS = 64;
+
+	LLSendBatch();
+	~LLSendBatch();
+
+	void add(const char* datap, S32 size, U32 ip, U32 port);
+	bool isEmpty() const	{ return mPackets.empty(); }
+	bool isFull() const		{ return mPackets.size() >= MAX_PACKETS; }
+
+	// Sends every queued datagram. Returns how many could not be sent.
+	S32 flush(S32 socket);
+
+private:
+	struct Destination
+	{
+		U32 mOffset;
+		S32 mSize;
+		U32 mIP;
+		U32 mPort;
+	};
+
+	std::vector<Destination> mPackets;
+	std::vector<char> mData;
+
+#if LL_LINUX
+	struct Batch;
+	Batch* mBatch;				// sendmmsg() arguments.
+#endif
+};
+
+#endif // LL_LLPACKETBATCH_H
@@ -31,6 +31,7 @@
 #include "net.h"
 #include "lltimer.h"
 #include "llhost.h"
+#include "llpacketbatch.h"
 
 ///////////////////////////////////////////////////////////
 
@@ -59,6 +60,11 @@ LLPacketBuffer::LLPacketBuffer (S32 hSocket)
 	init(hSocket);
 }
 
+LLPacketBuffer::LLPacketBuffer(LLReceiveRing& ring)
+{
+	init(ring);
+}
+
 ///////////////////////////////////////////////////////////
 
 LLPacketBuffer::~LLPacketBuffer ()
@@ -74,3 +80,17 @@ void LLPacketBuffer::init (S32 hSocket)
 	mReceivingIF = ::get_receiving_interface();
 }
 
+void LLPacketBuffer::init(LLReceiveRing& ring)
+{
+	const LLReceiveRing::Packet* packetp = ring.front();
+	if (!packetp)
+	{
+		mSize = 0;
+		return;
+	}
+	mSize = packetp->mSize;
+	memcpy(mData, packetp->mData, mSize);	/* Flawfinder: ignore */
+	mHost = packetp->mSender;
+	mReceivingIF = packetp->mReceivingIF;
+	ring.pop();
+}
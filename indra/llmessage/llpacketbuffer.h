@@ -31,11 +31,14 @@
 #include "net.h"		// for NET_BUFFER_SIZE
 #include "llhost.h"
 
+class LLReceiveRing;
+
 class LLPacketBuffer
 {
 public:
 	LLPacketBuffer(const LLHost &host, const char *datap, const S32 size);
 	LLPacketBuffer(S32 hSocket);           // receive a packet
+	LLPacketBuffer(LLReceiveRing& ring);   // take a packet received by the receive thread
 	~LLPacketBuffer();
 
 	S32			getSize() const					{ return mSize; }
@@ -43,6 +46,7 @@ public:
 	LLHost		getHost() const					{ return mHost; }
 	LLHost		getReceivingInterface() const	{ return mReceivingIF; }
 	void init(S32 hSocket);
+	void init(LLReceiveRing& ring);
 
 protected:
 	char	mData[NET_BUFFER_SIZE];        // packet data		/* Flawfinder : ignore */
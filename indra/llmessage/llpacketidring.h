@@ -0,0 +1,270 @@
+/**
+ * @file llpacketidring.h
+ * @brief Entries keyed by packet ID, in a ring indexed by sequence.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETIDRING_H
+#define LL_LLPACKETIDRING_H
+
+#include <algorithm>
+#include <vector>
+
+#include "lldefs.h"
+#include "stdtypes.h"
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+
+// Entries keyed by the IDs of packets sent in sequence, as handed out by
+// LLCircuitData::nextPacketOutID(). The ring spans the oldest entry to the
+// newest one: the entry of an ID is in slot ID % capacity, and a bitmap
+// tells the slots in use. IDs wrap at ID_MASK + 1, and "oldest" means
+// first sent, across the wrap. Finding, adding and removing an entry cost
+// the same however many there are, and nothing is allocated once the ring
+// is as wide as the packets in flight.
+template <class T>
+class LLPacketIDRing
+{
+public:
+	static const TPACKETID ID_MASK = 0x00ffffff;	// Packet IDs are 24 bits.
+
+	LLPacketIDRing()
+	:	mBase(0),
+		mEnd(0),
+		mCount(0)
+	{
+	}
+
+	bool empty() const		{ return mCount == 0; }
+	S32 size() const		{ return mCount; }
+
+	// Only meaningful when not empty.
+	TPACKETID getOldestID() const	{ return mBase; }
+
+	// Adds the entry of id, or replaces it. An id before the oldest entry
+	// or after the newest widens the ring to it, on whichever side is nearer.
+	void insert(TPACKETID id, const T& value)
+	{
+		id &= ID_MASK;
+		if (!mCount)
+		{
+			if (mSlots.empty())
+			{
+				grow(MIN_CAPACITY);
+			}
+			mBase = id;
+			mEnd = (id + 1) & ID_MASK;
+		}
+		else
+		{
+			const U32 span = distance(mBase, mEnd);
+			if (distance(mBase, id) >= span)
+			{
+				const U32 after = distance(mEnd, id);
+				const U32 before = distance(id, mBase);
+				const U32 new_span = span + (after < before ? after + 1 : before);
+				if (new_span > (U32)mSlots.size())
+				{
+					grow(new_span);
+				}
+				if (after < before)
+				{
+					mEnd = (id + 1) & ID_MASK;
+				}
+				else
+				{
+					mBase = id;
+				}
+			}
+		}
+
+		const U32 slot = id & (U32)(mSlots.size() - 1);
+		if (!isInUse(slot))
+		{
+			mInUse[slot >> 6] |= (U64)1 << (slot & 63);
+			++mCount;
+		}
+		mSlots[slot] = value;
+	}
+
+	// The entry of id, or NULL.
+	T* find(TPACKETID id)
+	{
+		id &= ID_MASK;
+		if (!mCount || distance(mBase, id) >= distance(mBase, mEnd))
+		{
+			return NULL;
+		}
+		const U32 slot = id & (U32)(mSlots.size() - 1);
+		return isInUse(slot) ? &mSlots[slot] : NULL;
+	}
+
+	// Removes the entry of id; false when there was none.
+	bool erase(TPACKETID id)
+	{
+		id &= ID_MASK;
+		if (!mCount || distance(mBase, id) >= distance(mBase, mEnd))
+		{
+			return false;
+		}
+		const U32 slot = id & (U32)(mSlots.size() - 1);
+		if (!isInUse(slot))
+		{
+			return false;
+		}
+		mInUse[slot >> 6] &= ~((U64)1 << (slot & 63));
+		mSlots[slot] = T();
+		if (!--mCount)
+		{
+			mBase = mEnd;
+		}
+		else if (id == mBase)
+		{
+			// Acks mostly come in order, so this only looks a slot or two on.
+			TPACKETID next = (id + 1) & ID_MASK;
+			findNext(next);
+			mBase = next;
+		}
+		return true;
+	}
+
+	// Moves id on to the first entry at or after it, and returns that entry;
+	// NULL when there is none. An id just before the oldest entry moves to
+	// it, so entries can be erased while walking the ring:
+	//   for (TPACKETID id = ring.getOldestID(); T* entryp = ring.findNext(id); ++id)
+	T* findNext(TPACKETID& id)
+	{
+		id &= ID_MASK;
+		if (!mCount)
+		{
+			return NULL;
+		}
+		const U32 span = distance(mBase, mEnd);
+		U32 offset = distance(mBase, id);
+		if (offset >= span)
+		{
+			if (distance(id, mBase) >= distance(mEnd, id))
+			{
+				return NULL;
+			}
+			offset = 0;
+		}
+
+		const U32 mask = (U32)(mSlots.size() - 1);
+		U32 slot = (mBase + offset) & mask;
+		U32 remaining = span - offset;
+		while (remaining)
+		{
+			const U32 bit = slot & 63;
+			const U32 chunk = llmin(64 - bit, remaining);
+			U64 bits = mInUse[slot >> 6] >> bit;
+			if (chunk < 64)
+			{
+				bits &= ((U64)1 << chunk) - 1;
+			}
+			if (bits)
+			{
+				offset += first_set_bit(bits);
+				id = (mBase + offset) & ID_MASK;
+				return &mSlots[(mBase + offset) & mask];
+			}
+			offset += chunk;
+			remaining -= chunk;
+			slot = (slot + chunk) & mask;
+		}
+		return NULL;
+	}
+
+	// Removes every entry, keeping the room for them.
+	void clear()
+	{
+		std::fill(mSlots.begin(), mSlots.end(), T());
+		std::fill(mInUse.begin(), mInUse.end(), (U64)0);
+		mBase = mEnd = 0;
+		mCount = 0;
+	}
+
+private:
+	static const U32 MIN_CAPACITY = 64;
+
+	// How far b is after a.
+	static U32 distance(TPACKETID a, TPACKETID b)
+	{
+		return (b - a) & ID_MASK;
+	}
+
+	static U32 first_set_bit(U64 bits)
+	{
+#if LL_WINDOWS
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return (U32)index;
+#else
+		return (U32)__builtin_ctzll(bits);
+#endif
+	}
+
+	bool isInUse(U32 slot) const
+	{
+		return (mInUse[slot >> 6] >> (slot & 63)) & 1;
+	}
+
+	// Makes room for span IDs, moving the entries to their new slots.
+	void grow(U32 span)
+	{
+		U32 capacity = llmax((U32)mSlots.size(), MIN_CAPACITY);
+		while (capacity < span)
+		{
+			capacity <<= 1;
+		}
+
+		std::vector<T> slots(capacity);
+		std::vector<U64> in_use(capacity / 64, 0);
+		if (mCount)
+		{
+			const U32 old_mask = (U32)(mSlots.size() - 1);
+			const U32 old_span = distance(mBase, mEnd);
+			for (U32 offset = 0; offset < old_span; ++offset)
+			{
+				const TPACKETID id = (mBase + offset) & ID_MASK;
+				if (isInUse(id & old_mask))
+				{
+					const U32 slot = id & (capacity - 1);
+					slots[slot] = mSlots[id & old_mask];
+					in_use[slot >> 6] |= (U64)1 << (slot & 63);
+				}
+			}
+		}
+		mSlots.swap(slots);
+		mInUse.swap(in_use);
+	}
+
+	std::vector<T>		mSlots;		// Power of two of them, at least 64.
+	std::vector<U64>	mInUse;		// One bit a slot.
+	TPACKETID			mBase;		// ID of the oldest entry.
+	TPACKETID			mEnd;		// One past the ID of the newest entry.
+	S32					mCount;
+};
+
+#endif // LL_LLPACKETIDRING_H
@@ -40,6 +40,7 @@
 #include "lltimer.h"
 #include "llproxy.h"
 #include "llrand.h"
+#include "llthread.h"
 #include "message.h"
 #include "u64.h"
 
@@ -47,6 +48,50 @@
 #include "llmessagelog.h"
 //</edit>
 
+// Packets that the receive thread can hold for the main thread, on top of
+// the kernel buffer of the socket.
+static const U32 RECEIVE_RING_SIZE = 1024;
+// How long the receive thread waits for a packet before checking whether it should quit.
+static const S32 RECEIVE_WAIT_MS = 50;
+
+// Drains the socket into a LLReceiveRing, so that packets keep being taken
+// off the kernel buffer while the main thread is busy rendering a frame.
+class LLPacketReceiveThread : public LLThread
+{
+public:
+	LLPacketReceiveThread(S32 socket)
+	:	LLThread("UDP receive"),
+		mSocket(socket),
+		mRing(RECEIVE_RING_SIZE)
+	{
+	}
+
+	LLReceiveRing& getRing()	{ return mRing; }
+
+protected:
+	/*virtual*/ void run();
+
+private:
+	S32 mSocket;
+	LLReceiveRing mRing;
+};
+
+void LLPacketReceiveThread::run()
+{
+	while (!isQuitting())
+	{
+		if (mRing.isFull())
+		{
+			// The main thread is behind; the socket buffers what arrives meanwhile.
+			ms_sleep(1);
+		}
+		else if (!mRing.receive(mSocket))
+		{
+			wait_for_packet(mSocket, RECEIVE_WAIT_MS);
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////
 LLPacketRing::LLPacketRing () :
 	mUseInThrottle(FALSE),
@@ -59,13 +104,17 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mReceiveThread(NULL),
+	mBatchingSends(false),
+	mSendFailures(0)
 {
 }
 
 ///////////////////////////////////////////////////////////
 LLPacketRing::~LLPacketRing ()
 {
+	stopReceiveThread();
 	cleanup();
 }
 	
@@ -89,6 +138,40 @@ void LLPacketRing::cleanup ()
 	}
 }
 
+///////////////////////////////////////////////////////////
+void LLPacketRing::startReceiveThread(S32 socket)
+{
+	if (!mReceiveThread)
+	{
+		mReceiveThread = new LLPacketReceiveThread(socket);
+		mReceiveThread->start();
+	}
+}
+
+void LLPacketRing::stopReceiveThread()
+{
+	if (mReceiveThread)
+	{
+		mReceiveThread->shutdown();
+		delete mReceiveThread;
+		mReceiveThread = NULL;
+	}
+}
+
+bool LLPacketRing::waitForReceivedPacket(F32 seconds)
+{
+	LLTimer timer;
+	while (!mReceiveThread->getRing().front())
+	{
+		if (timer.getElapsedTimeF32() >= seconds)
+		{
+			return false;
+		}
+		ms_sleep(1);
+	}
+	return true;
+}
+
 ///////////////////////////////////////////////////////////
 void LLPacketRing::dropPackets (U32 num_to_drop)
 {
@@ -171,7 +254,14 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 		while (!done)
 		{
 			LLPacketBuffer *packetp;
-			packetp = new LLPacketBuffer(socket);
+			if (mReceiveThread)
+			{
+				packetp = new LLPacketBuffer(mReceiveThread->getRing());
+			}
+			else
+			{
+				packetp = new LLPacketBuffer(socket);
+			}
 
 			if (packetp->getSize())
 			{
@@ -227,11 +317,12 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 	}
 	else
 	{
-		// no delay, pull straight from net
+		// no delay, pull straight from net (or from what the receive thread pulled)
 		if (LLProxy::isSOCKSProxyEnabled())
 		{
 			U8 buffer[NET_BUFFER_SIZE + SOCKS_HEADER_SIZE];
-			packet_size = receive_packet(socket, static_cast<char*>(static_cast<void*>(buffer)));
+			LLHost proxy_host;
+			packet_size = receiveDatagram(socket, static_cast<char*>(static_cast<void*>(buffer)), proxy_host, mLastReceivingIF);
 			
 			if (packet_size > SOCKS_HEADER_SIZE)
 			{
@@ -250,12 +341,9 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 		}
 		else
 		{
-			packet_size = receive_packet(socket, datap);
-			mLastSender = ::get_sender();
+			packet_size = receiveDatagram(socket, datap, mLastSender, mLastReceivingIF);
 		}
 
-		mLastReceivingIF = ::get_receiving_interface();
-
 		if (packet_size)  // did we actually get a packet?
 		{
 			if (mDropPercentage && (ll_frand(100.f) < mDropPercentage))
@@ -352,12 +440,65 @@ BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LL
 	return status;
 }
 
+S32 LLPacketRing::flushSends(int h_socket)
+{
+	mBatchingSends = false;
+	S32 failed = mSendFailures;
+	mSendFailures = 0;
+	if (!mSendBatch.isEmpty())
+	{
+		failed += mSendBatch.flush(h_socket);
+	}
+	return failed;
+}
+
+S32 LLPacketRing::receiveDatagram(S32 socket, char *datap, LLHost& sender, LLHost& receiving_if)
+{
+	if (!mReceiveThread)
+	{
+		S32 packet_size = receive_packet(socket, datap);
+		sender = ::get_sender();
+		receiving_if = ::get_receiving_interface();
+		return packet_size;
+	}
+
+	LLReceiveRing& ring = mReceiveThread->getRing();
+	const LLReceiveRing::Packet* packetp = ring.front();
+	if (!packetp)
+	{
+		return 0;
+	}
+	S32 packet_size = packetp->mSize;
+	memcpy(datap, packetp->mData, packet_size);	/*Flawfinder: ignore*/
+	sender = packetp->mSender;
+	receiving_if = packetp->mReceivingIF;
+	ring.pop();
+	return packet_size;
+}
+
+BOOL LLPacketRing::sendDatagram(int h_socket, const char * send_buffer, S32 buf_size, U32 ip, U32 port)
+{
+#if LL_LINUX
+	if (mBatchingSends)
+	{
+		// Goes out with the rest of the batch in one sendmmsg() call.
+		if (mSendBatch.isFull())
+		{
+			mSendFailures += mSendBatch.flush(h_socket);
+		}
+		mSendBatch.add(send_buffer, buf_size, ip, port);
+		return TRUE;
+	}
+#endif
+	return send_packet(h_socket, send_buffer, buf_size, ip, port);
+}
+
 BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host)
 {
 	
 	if (!LLProxy::isSOCKSProxyEnabled())
 	{
-		return send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
+		return sendDatagram(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
 	}
 
 	char headered_send_buffer[NET_BUFFER_SIZE + SOCKS_HEADER_SIZE];
@@ -371,7 +512,7 @@ BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 bu
 
 	memcpy(headered_send_buffer + SOCKS_HEADER_SIZE, send_buffer, buf_size);
 
-	return send_packet(	h_socket,
+	return sendDatagram(h_socket,
 						headered_send_buffer,
 						buf_size + SOCKS_HEADER_SIZE,
 						LLProxy::getInstance()->getUDPProxy().getAddress(),
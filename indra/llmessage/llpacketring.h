@@ -31,11 +31,14 @@
 #include <queue>
 
 #include "llhost.h"
+#include "llpacketbatch.h"
 #include "llpacketbuffer.h"
 //#include "llproxy.h"
 #include "llthrottle.h"
 #include "net.h"
 
+class LLPacketReceiveThread;
+
 class LLPacketRing
 {
 public:
@@ -54,6 +57,18 @@ public:
 	S32  receiveFromRing (S32 socket, char *datap);
 
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
+	// Until flushSends(), sendPacket() queues packets to send them together.
+	void beginSendBatch()						{ mBatchingSends = true; }
+	// Sends the queued packets. Returns how many could not be sent.
+	S32  flushSends(int h_socket);
+
+	// From now on, packets are received on a thread of their own, and
+	// receivePacket() takes them from it instead of from the socket.
+	void startReceiveThread(S32 socket);
+	void stopReceiveThread();
+	bool hasReceiveThread() const				{ return mReceiveThread != NULL; }
+	// Waits at most seconds for the receive thread to receive a packet.
+	bool waitForReceivedPacket(F32 seconds);
 
 	inline LLHost getLastSender();
 	inline LLHost getLastReceivingInterface();
@@ -83,8 +98,15 @@ protected:
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 
+	LLPacketReceiveThread* mReceiveThread;
+	bool mBatchingSends;
+	LLSendBatch mSendBatch;
+	S32 mSendFailures;				// Packets of full batches that could not be sent, since flushSends().
+
 private:
 	BOOL sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host);
+	S32  receiveDatagram(S32 socket, char *datap, LLHost& sender, LLHost& receiving_if);
+	BOOL sendDatagram(int h_socket, const char * send_buffer, S32 buf_size, U32 ip, U32 port);
 };
 
 
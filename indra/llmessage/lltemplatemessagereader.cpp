@@ -42,16 +42,16 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 												 number_template_map) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
-	mCurrentRMessageData(NULL),
-	mMessageNumbers(number_template_map)
+	mDecoded(false),
+	mMessageNumbers(number_template_map),
+	mIndexedTemplateCount(0)
 {
+	indexTemplates();
 }
 
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
 }
 
 //virtual
@@ -59,8 +59,52 @@ void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = NULL;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
+	mDecoded = false;
+}
+
+void LLTemplateMessageReader::indexTemplates()
+{
+	std::fill(mHighFrequencyTemplates, mHighFrequencyTemplates + 256, (LLMessageTemplate*)NULL);
+	std::fill(mMediumFrequencyTemplates, mMediumFrequencyTemplates + 256, (LLMessageTemplate*)NULL);
+	std::fill(mFixedTemplates, mFixedTemplates + 256, (LLMessageTemplate*)NULL);
+	mLowFrequencyTemplates.clear();
+
+	for (message_template_number_map_t::const_iterator iter = mMessageNumbers.begin();
+		 iter != mMessageNumbers.end(); ++iter)
+	{
+		const U32 num = iter->first;
+		if (num < 256)
+		{
+			mHighFrequencyTemplates[num] = iter->second;
+		}
+		else if ((num >> 8) == 0xFF)
+		{
+			mMediumFrequencyTemplates[num & 0xFF] = iter->second;
+		}
+		else if ((num >> 16) == 0xFFFF)
+		{
+			const U32 id = num & 0xFFFF;
+			if (id >= 0xFF00)
+			{
+				mFixedTemplates[id & 0xFF] = iter->second;
+			}
+			else
+			{
+				if (id >= mLowFrequencyTemplates.size())
+				{
+					mLowFrequencyTemplates.resize(id + 1, NULL);
+				}
+				mLowFrequencyTemplates[id] = iter->second;
+			}
+		}
+	}
+	mIndexedTemplateCount = mMessageNumbers.size();
+}
+
+inline const LLTemplateMessageReader::DecodedBlock* LLTemplateMessageReader::findBlock(const char* blockname) const
+{
+	const S32 index = mCurrentRMessageTemplate->getBlockIndex(blockname);
+	return index >= 0 && index < (S32)mDecodedBlocks.size() ? &mDecodedBlocks[index] : NULL;
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -72,79 +116,73 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{
-		LL_ERRS() << "Invalid mCurrentMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "No message decoded in getData!" << LL_ENDL;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const DecodedBlock* blockp = findBlock(blockname);
+	if (!blockp || blocknum < 0 || blocknum >= blockp->mCount)
 	{
 		LL_ERRS() << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << LL_ENDL;
+			<< " not in message " << mCurrentRMessageTemplate->mName << LL_ENDL;
 		return;
 	}
 
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgBlkData::msg_var_data_map_t &var_data_map = msg_block_data->mMemberVarData;
-
-	if (var_data_map.find(vnamep) == var_data_map.end())
+	const S32 var_index = blockp->mBlock->getVariableIndex(varname);
+	if (var_index < 0)
 	{
-		LL_ERRS() << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << LL_ENDL;
+		LL_ERRS() << "Variable "<< varname << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return;
 	}
 
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
+	const DecodedField& field = mDecodedFields[blockp->mFirstField + blocknum * blockp->mVariableCount + var_index];
+	const U8* data = mFieldData.data() + field.mOffset;
 
-	if (size && size != vardata.getSize())
+	if (size && size != field.mSize)
 	{
-		LL_ERRS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_ERRS() << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << field.mSize
 			<< " but copying into buffer of size " << size
 			<< LL_ENDL;
 		return;
 	}
 
 
-	const S32 vardata_size = vardata.getSize();
+	const S32 vardata_size = field.mSize;
 	if( max_size >= vardata_size )
 	{   
 		switch( vardata_size )
 		{ 
 		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
+			*((U8*)datap) = *data;
 			break;
 		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
+			memcpy(datap, data, 2);
 			break;
 		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
+			memcpy(datap, data, 4);
 			break;
 		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
+			memcpy(datap, data, 8);
 			break;
 		default:
-			memcpy(datap, vardata.getData(), vardata_size);
+			memcpy(datap, data, vardata_size);
 			break;
 		}
 	}
 	else
 	{
-		LL_WARNS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_WARNS() << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << field.mSize
 			<< " but truncated to max size of " << max_size
 			<< LL_ENDL;
 
-		memcpy(datap, vardata.getData(), max_size);
+		memcpy(datap, data, max_size);
 	}
 }
 
@@ -157,22 +195,14 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{
-		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "No message decoded in getNumberOfBlocks!" << LL_ENDL;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
-	{
-		return 0;
-	}
-
-	return (iter->second)->mBlockNumber;
+	const DecodedBlock* blockp = findBlock(blockname);
+	return blockp ? blockp->mCount : 0;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -184,43 +214,36 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "No message decoded in getSize!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const DecodedBlock* blockp = findBlock(blockname);
+	if (!blockp || !blockp->mCount)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " not in message "
+			<< mCurrentRMessageTemplate->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const S32 var_index = blockp->mBlock->getVariableIndex(varname);
+	if (var_index < 0)
 	{	// don't crash
 		LL_INFOS() << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	if (blockp->mBlock->mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		LL_ERRS() << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	return mDecodedFields[blockp->mFirstField + var_index].mSize;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -232,35 +255,29 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "No message decoded in getSize!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const DecodedBlock* blockp = findBlock(blockname);
+	if (!blockp || blocknum < 0 || blocknum >= blockp->mCount)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " #" << blocknum << " not in message " 
+			<< mCurrentRMessageTemplate->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const S32 var_index = blockp->mBlock->getVariableIndex(varname);
+	if (var_index < 0)
 	{	// don't crash
-		LL_INFOS() << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+		LL_INFOS() << "Variable " << varname << " not in message "
+			<<  mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	return mDecodedFields[blockp->mFirstField + blocknum * blockp->mVariableCount + var_index].mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -456,17 +473,25 @@ BOOL LLTemplateMessageReader::decodeTemplate(
 		return(FALSE);
 	}
 
+	if (mIndexedTemplateCount != mMessageNumbers.size())
+	{
+		indexTemplates();
+	}
+
 	U32 num = 0;
+	LLMessageTemplate* temp = NULL;
 
 	if (header[0] != 255)
 	{
 		// high frequency message
 		num = header[0];
+		temp = mHighFrequencyTemplates[header[0]];
 	}
 	else if ((buffer_size >= ((S32) LL_MINIMUM_VALID_PACKET_SIZE + 1)) && (header[1] != 255))
 	{
 		// medium frequency message
 		num = (255 << 8) | header[1];
+		temp = mMediumFrequencyTemplates[header[1]];
 	}
 	else if ((buffer_size >= ((S32) LL_MINIMUM_VALID_PACKET_SIZE + 3)) && (header[1] == 255))
 	{
@@ -484,6 +509,14 @@ BOOL LLTemplateMessageReader::decodeTemplate(
 		// independant of endian-ness:
 		message_id_U16 = ntohs(message_id_U16);
 		num = 0xFFFF0000 | message_id_U16;
+		if (message_id_U16 >= 0xFF00)
+		{
+			temp = mFixedTemplates[message_id_U16 & 0xFF];
+		}
+		else if (message_id_U16 < mLowFrequencyTemplates.size())
+		{
+			temp = mLowFrequencyTemplates[message_id_U16];
+		}
 	}
 	else // bogus packet received (too short)
 	{
@@ -493,7 +526,6 @@ BOOL LLTemplateMessageReader::decodeTemplate(
 		return(FALSE);
 	}
 
-	LLMessageTemplate* temp = get_ptr_in_map(mMessageNumbers,num);
 	if (temp)
 	{
 		*msg_template = temp;
@@ -531,6 +563,27 @@ void LLTemplateMessageReader::logRanOffEndOfPacket( const LLHost& host, const S3
 	gMessageSystem->callExceptionFunc(MX_RAN_OFF_END_OF_PACKET);
 }
 
+inline void LLTemplateMessageReader::addField(const LLMessageVariable* variable, const U8* data, S32 size)
+{
+	DecodedField field;
+	field.mOffset = (S32)mFieldData.size();
+	field.mSize = size;
+	mDecodedFields.push_back(field);
+	if (!data)
+	{
+		mFieldData.resize(mFieldData.size() + size);
+	}
+	else
+	{
+#ifdef LL_BIG_ENDIAN
+		mFieldData.resize(mFieldData.size() + size);
+		htonmemcpy(mFieldData.data() + field.mOffset, data, variable->getType(), size);
+#else
+		mFieldData.insert(mFieldData.end(), data, data + size);
+#endif
+	}
+}
+
 static LLTrace::BlockTimerStatHandle FTM_PROCESS_MESSAGES("Process Messages");
 
 // decode a given message
@@ -538,16 +591,19 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 {
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
+	llassert( !mDecoded );
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
+	// reset the working data set, keeping its room
+	mDecoded = true;
+	mDecodedBlocks.clear();
+	mDecodedFields.clear();
+	mFieldData.clear();
+	bool has_blocks = false;
 	
 	// loop through the template building the data structure as we go
 	LLMessageTemplate::message_block_map_t::const_iterator iter;
@@ -597,26 +653,18 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = NULL;
+		// add the block to the message, its fields follow
+		DecodedBlock cur_data_block;
+		cur_data_block.mBlock = mbci;
+		cur_data_block.mVariableCount = (S32)mbci->mMemberVariables.size();
+		cur_data_block.mFirstField = (S32)mDecodedFields.size();
+		cur_data_block.mCount = repeat_number;
+		mDecodedBlocks.push_back(cur_data_block);
+		has_blocks |= repeat_number > 0;
 
 		// now loop through the block
 		for (i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
-			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-			}
-
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
-
 			// now read the variables
 			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
 					 mbci->mMemberVariables.begin();
@@ -624,10 +672,6 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 			{
 				const LLMessageVariable* mvci = mbci->mMemberVariables.toValue(iter);
 
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci->getName(), mvci->getType());
-
 				// what type of variable?
 				if (mvci->getType() == MVT_VARIABLE)
 				{
@@ -667,7 +711,7 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci->getName(), &buffer[decode_pos], tsize, mvci->getType());
+					addField(mvci, &buffer[decode_pos], tsize);
 					decode_pos += tsize;
 				}
 				else
@@ -680,17 +724,11 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 							logRanOffEndOfPacket(sender, decode_pos, mvci->getSize());
 
 						// default to 0s.
-						U32 size = mvci->getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci->getName(), &(data[0]),
-												size, mvci->getType());
+						addField(mvci, NULL, mvci->getSize());
 					}
 					else
 					{
-						cur_data_block->addData(mvci->getName(),
-												&buffer[decode_pos], 
-												mvci->getSize(),
-												mvci->getType());
+						addField(mvci, &buffer[decode_pos], mvci->getSize());
 					}
 					decode_pos += mvci->getSize();
 				}
@@ -698,7 +736,7 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 		}
 	}
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
+	if (!has_blocks
 		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
 	{
 		LL_DEBUGS() << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << LL_ENDL;
@@ -716,6 +754,10 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 
 		{
 			LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
+			if (!mCurrentRMessageTemplate->getHandlerSkipsDeferredWork())
+			{
+				gMessageSystem->finishDeferredWork(true);
+			}
 			if( !mCurrentRMessageTemplate->callHandlerFunc(gMessageSystem) )
 			{
 				LL_WARNS() << "Message from " << sender << " with no handler function received: " << mCurrentRMessageTemplate->mName << LL_ENDL;
@@ -795,9 +837,9 @@ BOOL LLTemplateMessageReader::validateMessage(const U8* buffer,
 }
 
 BOOL LLTemplateMessageReader::readMessage(const U8* buffer, 
-										  const LLHost& sender)
+										  const LLHost& sender, bool custom)
 {
-	return decodeData(buffer, sender, false);
+	return decodeData(buffer, sender, custom);
 }
 
 //virtual 
@@ -830,9 +872,41 @@ bool LLTemplateMessageReader::isUdpBanned() const
 //virtual 
 void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
 {
-	if(NULL == mCurrentRMessageTemplate)
+	if(NULL == mCurrentRMessageTemplate || !mDecoded)
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+
+	// The message the way the builders take it: each repeat of a block
+	// keyed by its name plus the repeat number.
+	LLMsgData data(mCurrentRMessageTemplate->mName);
+	std::vector<U8> wire_data;
+	for (std::vector<DecodedBlock>::const_iterator iter = mDecodedBlocks.begin();
+		 iter != mDecodedBlocks.end(); ++iter)
+	{
+		const LLMessageBlock* mbci = iter->mBlock;
+		const DecodedField* fieldp = mDecodedFields.data() + iter->mFirstField;
+		for (S32 i = 0; i < iter->mCount; ++i)
+		{
+			LLMsgBlkData* cur_data_block = new LLMsgBlkData(mbci->mName, iter->mCount);
+			cur_data_block->mName = mbci->mName + i;
+			data.addBlock(cur_data_block);
+
+			for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = 
+					 mbci->mMemberVariables.begin();
+				 var_iter != mbci->mMemberVariables.end(); ++var_iter, ++fieldp)
+			{
+				const LLMessageVariable* mvci = mbci->mMemberVariables.toValue(var_iter);
+				cur_data_block->addVariable(mvci->getName(), mvci->getType());
+				// addData() swaps from network order, the fields are in host order
+				wire_data.resize(llmax(fieldp->mSize, 1));
+				if (fieldp->mSize)
+				{
+					htonmemcpy(&wire_data[0], mFieldData.data() + fieldp->mOffset, mvci->getType(), fieldp->mSize);
+				}
+				cur_data_block->addData(mvci->getName(), &wire_data[0], fieldp->mSize, mvci->getType());
+			}
+		}
+	}
+	builder.copyFromMessageData(data);
 }
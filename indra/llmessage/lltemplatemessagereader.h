@@ -30,9 +30,11 @@
 #include "llmessagereader.h"
 
 #include <map>
+#include <vector>
 
+class LLMessageBlock;
 class LLMessageTemplate;
-class LLMsgData;
+class LLMessageVariable;
 
 class LLTemplateMessageReader : public LLMessageReader
 {
@@ -100,7 +102,8 @@ public:
 
 	BOOL validateMessage(const U8* buffer, S32 buffer_size, 
 						 const LLHost& sender, bool trusted = false, bool custom = false);
-	BOOL readMessage(const U8* buffer, const LLHost& sender);
+	// custom decodes the message without handling it, as the message log does.
+	BOOL readMessage(const U8* buffer, const LLHost& sender, bool custom = false);
 
 	bool isTrusted() const;
 	bool isBanned(bool trusted_source) const;
@@ -108,6 +111,32 @@ public:
 	
 private:
 
+	// A block of the template, as it is in the message being read: its
+	// fields are mCount runs of one field per variable of the block.
+	struct DecodedBlock
+	{
+		const LLMessageBlock*	mBlock;
+		S32						mVariableCount;
+		S32						mFirstField;	// In mDecodedFields.
+		S32						mCount;			// 0 when the block is not in the message.
+	};
+
+	// Where the data of a field is in mFieldData, in host byte order.
+	struct DecodedField
+	{
+		S32						mOffset;
+		S32						mSize;
+	};
+
+	// The decoded block named blockname, or NULL when the template has none.
+	const DecodedBlock* findBlock(const char* blockname) const;
+
+	// Adds the next field of the message, zeros when data is NULL.
+	void addField(const LLMessageVariable* variable, const U8* data, S32 size);
+
+	// Fills the dispatch tables from mMessageNumbers.
+	void indexTemplates();
+
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
@@ -121,8 +150,24 @@ private:
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
+	bool mDecoded;
+
+	// The message being read, laid out by its template, one DecodedBlock
+	// for each of its blocks. Kept between messages, so reading one does
+	// not allocate once the buffers are as large as the largest message.
+	std::vector<DecodedBlock> mDecodedBlocks;
+	std::vector<DecodedField> mDecodedFields;
+	std::vector<U8> mFieldData;
+
+	// The templates of mMessageNumbers by the number in the message header:
+	// high and medium frequency messages by their one byte, low frequency
+	// ones by their two, with the fixed numbers 0xFFFFFFxx in a table apart.
 	message_template_number_map_t& mMessageNumbers;
+	size_t mIndexedTemplateCount;
+	LLMessageTemplate* mHighFrequencyTemplates[256];
+	LLMessageTemplate* mMediumFrequencyTemplates[256];
+	LLMessageTemplate* mFixedTemplates[256];
+	std::vector<LLMessageTemplate*> mLowFrequencyTemplates;
 	friend class LLFloaterMessageLogItem;
 };
 
@@ -233,6 +233,8 @@ void LLMessageSystem::init()
 
 	mTimingCallback = NULL;
 	mTimingCallbackData = NULL;
+	mFinishDeferredWorkCallback = NULL;
+	mFinishDeferredWorkData = NULL;
 
 	mMessageBuilder = NULL;
 	mMessageReader = NULL;
@@ -289,6 +291,11 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 		mbError = TRUE;
 		mErrorCode = error;
 	}
+	else
+	{
+		// Keep packets coming off the socket while the main thread is busy.
+		mPacketRing->startReceiveThread(mSocket);
+	}
 //	LL_DEBUGS("Messaging") <<  << "*** port: " << mPort << LL_ENDL;
 
 	//
@@ -366,6 +373,7 @@ LLMessageSystem::~LLMessageSystem()
 	
 	if (!mbError)
 	{
+		mPacketRing->stopReceiveThread();
 		end_net(mSocket);
 	}
 	mSocket = 0;
@@ -407,6 +415,12 @@ void LLMessageSystem::clearReceiveState()
 
 BOOL LLMessageSystem::poll(F32 seconds)
 {
+	if (mPacketRing->hasReceiveThread())
+	{
+		// The receive thread takes the packets off the socket.
+		return mPacketRing->waitForReceivedPacket(seconds);
+	}
+
 	S32 num_socks;
 	apr_status_t status;
 	status = apr_poll(&(mPollInfop->mPollFD), 1, &num_socks,(U64)(seconds*1000000.f));
@@ -615,17 +629,18 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 
 			if(cdp && (acks > 0) && ((S32)(acks * sizeof(TPACKETID)) < (true_rcv_size)))
 			{
-				TPACKETID packet_id;
+				// At most 255 acks ride on a packet.
+				TPACKETID packet_ids[256];
 				U32 mem_id=0;
 				for(S32 i = 0; i < acks; ++i)
 				{
 					true_rcv_size -= sizeof(TPACKETID);
 					memcpy(&mem_id, &mTrueReceiveBuffer[true_rcv_size], /* Flawfinder: ignore*/
 					     sizeof(TPACKETID));
-					packet_id = ntohl(mem_id);
-					//LL_INFOS("Messaging") << "got ack: " << packet_id << LL_ENDL;
-					cdp->ackReliablePacket(packet_id);
+					packet_ids[i] = ntohl(mem_id);
+					//LL_INFOS("Messaging") << "got ack: " << packet_ids[i] << LL_ENDL;
 				}
+				cdp->ackReliablePackets(packet_ids, acks);
 				if (!cdp->getUnackedPacketCount())
 				{
 					// Remove this circuit from the list of circuits with unacked packets
@@ -795,6 +810,9 @@ S32	LLMessageSystem::getReceiveBytes() const
 
 void LLMessageSystem::processAcks(F32 collect_time)
 {
+	// Resends, acks and transfer retransmits go out together at the end.
+	mPacketRing->beginSendBatch();
+
 	F64Seconds mt_sec = getMessageTimeSeconds();
 	{
 		gTransferManager.updateTransfers();
@@ -861,6 +879,8 @@ void LLMessageSystem::processAcks(F32 collect_time)
 		mResendDumpTime = mt_sec;
 		mCircuitInfo.dumpResends();
 	}
+
+	mSendPacketFailureCount += mPacketRing->flushSends(mSocket);
 }
 
 void LLMessageSystem::copyMessageReceivedToSend()
@@ -2250,12 +2270,16 @@ void	process_packet_ack(LLMessageSystem *msgsystem, void** /*user_data*/)
 	
 		S32 ack_count = msgsystem->getNumberOfBlocksFast(_PREHASH_Packets);
 
+		// A message has at most 255 blocks of a variable block.
+		TPACKETID packet_ids[256];
+		ack_count = llmin(ack_count, 256);
 		for (S32 i = 0; i < ack_count; i++)
 		{
 			msgsystem->getU32Fast(_PREHASH_Packets, _PREHASH_ID, packet_id, i);
 //			LL_DEBUGS("Messaging") << "ack recvd' from " << host << " for packet " << (TPACKETID)packet_id << LL_ENDL;
-			cdp->ackReliablePacket(packet_id);
+			packet_ids[i] = packet_id;
 		}
+		cdp->ackReliablePackets(packet_ids, ack_count);
 		if (!cdp->getUnackedPacketCount())
 		{
 			// Remove this circuit from the list of circuits with unacked packets
@@ -3016,6 +3040,10 @@ bool LLMessageSystem::callHandler(const char *name,
 		return false;
 	}
 
+	if (!msg_template->getHandlerSkipsDeferredWork())
+	{
+		finishDeferredWork(true);
+	}
 	return msg_template->callHandlerFunc(msg);
 }
 
@@ -3063,6 +3091,25 @@ void LLMessageSystem::setTimingFunc(msg_timing_callback func, void* data)
 	mTimingCallbackData = data;
 }
 
+void LLMessageSystem::setFinishDeferredWorkFunc(deferred_work_callback func, void* data)
+{
+	mFinishDeferredWorkCallback = func;
+	mFinishDeferredWorkData = data;
+}
+
+void LLMessageSystem::setHandlerSkipsDeferredWork(const char* name)
+{
+	LLMessageTemplate* msgtemplate = get_ptr_in_map(mMessageTemplates, LLMessageStringTable::getInstance()->getString(name));
+	if (msgtemplate)
+	{
+		msgtemplate->setHandlerSkipsDeferredWork(true);
+	}
+	else
+	{
+		LL_ERRS("Messaging") << name << " is not a known message name!" << LL_ENDL;
+	}
+}
+
 BOOL LLMessageSystem::isCircuitCodeKnown(U32 code) const
 {
 	if(mCircuitCodes.find(code) == mCircuitCodes.end())
@@ -4040,6 +4087,8 @@ bool LLMessageSystem::checkAllMessages(S64 frame_count, LLPumpIO* http_pump)
 		return true;
 	}
 	U32 packetsIn = mPacketsIn;
+	// The replies may look at what the deferred work updates.
+	finishDeferredWork(true);
 	http_pump->pump();
 	http_pump->callback();
 	return (mPacketsIn - packetsIn) > 0;
@@ -332,6 +332,26 @@ public:
 		return mTimingCallbackData;
 	}
 
+	// A handler may leave work for later, such as decoding its message on
+	// another thread, if it sets a function that finishes the work. Without
+	// wait, the function finishes what it can without blocking. With wait, it
+	// finishes everything left, and it is called before every other handler,
+	// before the HTTP pump and at the end of each batch of messages, so that
+	// nothing else sees the effects of a message late.
+	typedef void (*deferred_work_callback)(void* data, bool wait);
+	void setFinishDeferredWorkFunc(deferred_work_callback func, void* data = NULL);
+	// The handler of name runs without the work left for later finished
+	// first, as the handlers that leave it do. Only for handlers that never
+	// look at what the work updates.
+	void setHandlerSkipsDeferredWork(const char* name);
+	void finishDeferredWork(bool wait)
+	{
+		if (mFinishDeferredWorkCallback)
+		{
+			mFinishDeferredWorkCallback(mFinishDeferredWorkData, wait);
+		}
+	}
+
 	// This method returns true if the code is in the circuit codes map.
 	BOOL isCircuitCodeKnown(U32 code) const;
 
@@ -812,6 +832,9 @@ private:
 	msg_timing_callback mTimingCallback;
 	void* mTimingCallbackData;
 
+	deferred_work_callback mFinishDeferredWorkCallback;
+	void* mFinishDeferredWorkData;
+
 	void init(); // ctor shared initialisation.
 
 	LLHost mLastSender;
@@ -40,6 +40,7 @@
 	#include <arpa/inet.h>
 	#include <fcntl.h>
 	#include <errno.h>
+	#include <poll.h>
 #endif
 
 // linden library includes
@@ -338,6 +339,17 @@ S32 receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+BOOL wait_for_packet(int hSocket, S32 timeout_ms)
+{
+	fd_set read_fds;
+	FD_ZERO(&read_fds);
+	FD_SET(hSocket, &read_fds);
+	struct timeval timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_usec = (timeout_ms % 1000) * 1000;
+	return select(0, &read_fds, NULL, NULL, &timeout) > 0;
+}
+
 // Returns TRUE on success.
 BOOL send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort)
 {
@@ -598,6 +610,15 @@ int receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+BOOL wait_for_packet(int hSocket, S32 timeout_ms)
+{
+	struct pollfd poll_fd;
+	poll_fd.fd = hSocket;
+	poll_fd.events = POLLIN;
+	poll_fd.revents = 0;
+	return poll(&poll_fd, 1, timeout_ms) > 0;
+}
+
 BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient, int nPort)
 {
 	int		ret;
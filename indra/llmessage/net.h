@@ -43,6 +43,9 @@ void	end_net(S32& socket_out);
 // returns size of packet or -1 in case of error
 S32		receive_packet(int hSocket, char * receiveBuffer);
 
+// Waits at most timeout_ms for a packet to arrive. Returns TRUE if one is waiting.
+BOOL	wait_for_packet(int hSocket, S32 timeout_ms);
+
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
 //void	get_sender(char * tmp);
@@ -204,7 +204,10 @@ void	init_patch_decoding(LLBitPack &bitpack)
 	bitpack.resetBitPacking();
 }
 
-void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp)
+// The decoders below only touch their arguments; the decode_* functions wrap
+// them and keep the patch size and word bits in globals for decode_patch().
+
+static void unpack_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp)
 {
 	U16 retvalu16;
 
@@ -225,14 +228,16 @@ void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp)
 	retvalu8 = 0;
 	bitpack.bitUnpack(&retvalu8, 8);
 	gopp->layer_type = retvalu8;
+}
+
+void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp)
+{
+	unpack_patch_group_header(bitpack, gopp);
 
 	gPatchSize = gopp->patch_size; 
 }
 
-// <FS:CR> Aurora Sim
-//void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph)
-void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, bool b_large_patch)
-// </FS:CR> Aurora Sim
+static void unpack_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, bool b_large_patch)
 {
 	U8 retvalu8;
 
@@ -298,14 +303,104 @@ void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, bool b_large_pat
 	//ph->patchids = retvalu16;
 	ph->patchids = retvalu32;
 // </FS:CR> Aurora Sim
+}
 
-	gWordBits = (ph->quant_wbits & 0xf) + 2;
+// <FS:CR> Aurora Sim
+//void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph)
+void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, bool b_large_patch)
+// </FS:CR> Aurora Sim
+{
+	unpack_patch_header(bitpack, ph, b_large_patch);
+	if (END_OF_PATCHES != ph->quant_wbits)
+	{
+		gWordBits = (ph->quant_wbits & 0xf) + 2;
+	}
 }
 
-void	decode_patch(LLBitPack &bitpack, S32 *patches)
+#ifndef LL_BIG_ENDIAN
+// Reads the coefficient codes of a patch straight from the bitpack buffer
+// through a 64 bit cache, rather than with one bitUnpack() per field. Bits
+// past the end of the buffer read as 0. The bitpack carries on after the
+// last bit read once the reader is destroyed.
+class LLPatchBitReader
+{
+public:
+	LLPatchBitReader(LLBitPack &bitpack)
+	:	mBitPack(bitpack),
+		mBuffer(bitpack.getBuffer()),
+		mSize(bitpack.getMaxSize()),
+		mCache(0),
+		mCacheBits(0)
+	{
+		U32 position = bitpack.getUnpackBitPosition();
+		mNextByte = position / 8;
+		if (position % 8)
+		{
+			read(position % 8);
+		}
+	}
+
+	~LLPatchBitReader()
+	{
+		mBitPack.setUnpackBitPosition(mNextByte * 8 - mCacheBits);
+	}
+
+	// 1 to 32 bits, the first one read ends up most significant.
+	U32 read(U32 bits)
+	{
+		if (mCacheBits < bits)
+		{
+			refill();
+		}
+		U32 value = (U32)(mCache >> (64 - bits));
+		mCache <<= bits;
+		mCacheBits -= bits;
+		return value;
+	}
+
+private:
+	void refill()
+	{
+		while (mCacheBits <= 56)
+		{
+			U64 byte = mNextByte < mSize ? mBuffer[mNextByte] : 0;
+			mCache |= byte << (56 - mCacheBits);
+			mNextByte++;
+			mCacheBits += 8;
+		}
+	}
+
+	LLBitPack	&mBitPack;
+	const U8	*mBuffer;
+	U32			mSize;
+	U32			mNextByte;
+	U64			mCache;
+	U32			mCacheBits;
+};
+
+// bitUnpack() of more than 8 bits fills a little endian value 8 bits at a
+// time, the first 8 bits read making its lowest byte.
+static inline U32 bitunpack_order(U32 value, S32 wbits)
+{
+	if (wbits <= 8)
+	{
+		return value;
+	}
+	U32 result = 0;
+	for (S32 shift = 0; wbits > 0; shift += 8)
+	{
+		S32 bits = wbits < 8 ? wbits : 8;
+		wbits -= bits;
+		result |= ((value >> wbits) & ((1 << bits) - 1)) << shift;
+	}
+	return result;
+}
+#endif
+
+static void unpack_patch(LLBitPack &bitpack, S32 *patches, S32 patch_size, S32 wbits)
 {
 #ifdef LL_BIG_ENDIAN
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
+	S32		i, j;
 	U8		tempu8;
 	U16		tempu16;
 	U32		tempu32;
@@ -378,35 +473,28 @@ void	decode_patch(LLBitPack &bitpack, S32 *patches)
 		}
 	}
 #else
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
+	S32		i, j;
 	U32		temp;
+	LLPatchBitReader reader(bitpack);
 	for (i = 0; i < patch_size*patch_size; i++)
 	{
-		temp = 0;
-		bitpack.bitUnpack((U8 *)&temp, 1);
-		if (temp)
+		if (reader.read(1))
 		{
 			// either 0 EOB or Value
-			temp = 0;
-			bitpack.bitUnpack((U8 *)&temp, 1);
-			if (temp)
+			if (reader.read(1))
 			{
 				// value
-				temp = 0;
-				bitpack.bitUnpack((U8 *)&temp, 1);
-				if (temp)
+				if (reader.read(1))
 				{
 					// negative
-					temp = 0;
-					bitpack.bitUnpack((U8 *)&temp, wbits);
+					temp = bitunpack_order(reader.read(wbits), wbits);
 					patches[i] = temp;
 					patches[i] *= -1;
 				}
 				else
 				{
 					// positive
-					temp = 0;
-					bitpack.bitUnpack((U8 *)&temp, wbits);
+					temp = bitunpack_order(reader.read(wbits), wbits);
 					patches[i] = temp;
 				}
 			}
@@ -427,3 +515,45 @@ void	decode_patch(LLBitPack &bitpack, S32 *patches)
 #endif
 }
 
+void	decode_patch(LLBitPack &bitpack, S32 *patches)
+{
+	unpack_patch(bitpack, patches, gPatchSize, gWordBits);
+}
+
+S32		decode_patch_group(LLBitPack &bitpack, LLPatchGroup &group, bool b_large_patch, S32 max_patches)
+{
+	unpack_patch_group_header(bitpack, &group.mGroupHeader);
+	group.mPatchHeaders.clear();
+	group.mValues.clear();
+
+	const S32 patch_size = group.mGroupHeader.patch_size;
+	if (  (patch_size != NORMAL_PATCH_SIZE)
+		&&(patch_size != LARGE_PATCH_SIZE))
+	{
+		LL_WARNS() << "Unsupported patch size " << patch_size << " in patch group" << LL_ENDL;
+		return 0;
+	}
+	const S32 patch_values = patch_size*patch_size;
+
+	LLPatchHeader	ph;
+	S32		patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	while (!max_patches || group.getPatchCount() < max_patches)
+	{
+		if (bitpack.getUnpackBitPosition() >= bitpack.getMaxSize() * 8)
+		{
+			LL_WARNS() << "Patch group without end of patches" << LL_ENDL;
+			break;
+		}
+		unpack_patch_header(bitpack, &ph, b_large_patch);
+		if (END_OF_PATCHES == ph.quant_wbits)
+		{
+			break;
+		}
+		unpack_patch(bitpack, patch, patch_size, (ph.quant_wbits & 0xf) + 2);
+
+		group.mPatchHeaders.push_back(ph);
+		group.mValues.resize(group.mValues.size() + patch_values);
+		decompress_patch_values(&group.mValues[group.mValues.size() - patch_values], patch_size, patch, &ph, patch_size);
+	}
+	return group.getPatchCount();
+}
@@ -30,6 +30,7 @@
 class LLBitPack;
 class LLGroupHeader;
 class LLPatchHeader;
+class LLPatchGroup;
 
 void	init_patch_coding(LLBitPack &bitpack);
 void	code_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp);
@@ -45,5 +46,10 @@ void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp);
 void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, bool b_large_patch = false);
 // </FS:CR> Aurora Sim
 void	decode_patch(LLBitPack &bitpack, S32 *patches);
+// Decodes and decompresses a whole group: the group header, then patches up
+// to END_OF_PATCHES, or max_patches of them when not 0. Does not use the
+// decoder globals above, so it may run on any thread. Returns the number of
+// patches decoded.
+S32		decode_patch_group(LLBitPack &bitpack, LLPatchGroup &group, bool b_large_patch, S32 max_patches = 0);
 
 #endif
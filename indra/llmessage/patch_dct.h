@@ -27,6 +27,8 @@
 #ifndef LL_PATCH_DCT_H
 #define LL_PATCH_DCT_H
 
+#include <vector>
+
 class LLVector3;
 
 // Code Values
@@ -79,6 +81,31 @@ public:
 // </FS:CR> Aurora Sim
 };
 
+// Every patch of one LayerData group, decompressed. Filled by
+// decode_patch_group(), which only touches its arguments, so a group can be
+// decoded on any thread.
+class LLPatchGroup
+{
+public:
+	LLPatchGroup()
+	{
+		mGroupHeader.stride = 0;
+		mGroupHeader.patch_size = 0;
+		mGroupHeader.layer_type = 0;
+	}
+
+	S32 getPatchCount() const				{ return (S32)mPatchHeaders.size(); }
+	// patch_size x patch_size values, row after row.
+	const F32* getPatchValues(S32 index) const
+	{
+		return &mValues[index * mGroupHeader.patch_size * mGroupHeader.patch_size];
+	}
+
+	LLGroupHeader mGroupHeader;
+	std::vector<LLPatchHeader> mPatchHeaders;
+	std::vector<F32> mValues;
+};
+
 // Compression routines
 void init_patch_compressor(S32 patch_size, S32 patch_stride, S32 layer_type);
 void prescan_patch(F32 *patch, LLPatchHeader *php, F32 &zmax, F32 &zmin);
@@ -90,5 +117,7 @@ void set_group_of_patch_header(LLGroupHeader *gopp);
 void init_patch_decompressor(S32 size);
 void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph);
 void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph);
+// Thread safe: does not use the group of patch header, size is 16 or 32.
+void decompress_patch_values(F32 *patch, S32 stride, const S32 *cpatch, const LLPatchHeader *ph, S32 size);
 
 #endif
@@ -29,6 +29,7 @@
 #include "llmath.h"
 //#include "vmath.h"
 #include "v3math.h"
+#include "llsimdmath.h"
 #include "patch_dct.h"
 
 LLGroupHeader	*gGOPP;
@@ -38,42 +39,44 @@ void set_group_of_patch_header(LLGroupHeader *gopp)
 	gGOPP = gopp;
 }
 
-F32 gPatchDequantizeTable[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
-void build_patch_dequantize_table(S32 size)
+// Dequantization, inverse cosine and zigzag tables for one patch size.
+// They are built once and never written again, so any thread may decompress
+// with them.
+class LLPatchIDCTTables
+{
+public:
+	LLPatchIDCTTables(S32 size);
+
+	S32 mSize;
+	LL_ALIGN_16(F32 mDequantize[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	LL_ALIGN_16(F32 mICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	S32 mDeCopy[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+};
+
+LLPatchIDCTTables::LLPatchIDCTTables(S32 size)
+	: mSize(size)
 {
 	S32 i, j;
 	for (j = 0; j < size; j++)
 	{
 		for (i = 0; i < size; i++)
 		{
-			gPatchDequantizeTable[j*size + i] = (1.f + 2.f*(i+j));
+			mDequantize[j*size + i] = (1.f + 2.f*(i+j));
 		}
 	}
-}
-
-S32	gCurrentDeSize = 0;
-
-F32	gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 
-void setup_patch_icosines(S32 size)
-{
 	S32 n, u;
 	F32 oosob = F_PI*0.5f/size;
-
 	for (u = 0; u < size; u++)
 	{
 		for (n = 0; n < size; n++)
 		{
-			gPatchICosines[u*size+n] = cosf((2.f*n+1.f)*u*oosob);
+			mICosines[u*size+n] = cosf((2.f*n+1.f)*u*oosob);
 		}
 	}
-}
-
-S32	gDeCopyMatrix[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 
-void build_decopy_matrix(S32 size)
-{
-	S32 i, j, count;
+	// Zigzag order of the coefficients
+	S32 count;
 	BOOL	b_diag = FALSE;
 	BOOL	b_right = TRUE;
 
@@ -84,7 +87,7 @@ void build_decopy_matrix(S32 size)
 	while (  (i < size)
 		   &&(j < size))
 	{
-		gDeCopyMatrix[j*size + i] = count;
+		mDeCopy[j*size + i] = count;
 
 		count++;
 
@@ -135,542 +138,182 @@ void build_decopy_matrix(S32 size)
 	}
 }
 
-void init_patch_decompressor(S32 size)
-{
-	if (size != gCurrentDeSize)
-	{
-		gCurrentDeSize = size;
-		build_patch_dequantize_table(size);
-		setup_patch_icosines(size);
-		build_decopy_matrix(size);
-	}
-}
-
-inline void idct_line(F32 *linein, F32 *lineout, S32 line)
+// NULL for a patch size the IDCT does not handle.
+static const LLPatchIDCTTables* get_patch_idct_tables(S32 size)
 {
-	S32 n;
-	F32 total;
-	F32 *pcp = gPatchICosines;
-
-#ifdef _PATCH_SIZE_16_AND_32_ONLY
-	F32 oosob = 2.f/16.f;
-	S32	line_size = line*NORMAL_PATCH_SIZE;
-	F32 *tlinein, *tpcp;
-
-
-	for (n = 0; n < NORMAL_PATCH_SIZE; n++)
+	static const LLPatchIDCTTables normal_tables(NORMAL_PATCH_SIZE);
+	static const LLPatchIDCTTables large_tables(LARGE_PATCH_SIZE);
+	if (size == NORMAL_PATCH_SIZE)
 	{
-		tpcp = pcp + n;
-		tlinein = linein + line_size;
-	
-		total = OO_SQRT2*(*(tlinein++));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		*(lineout + line_size + n) = total*oosob;
+		return &normal_tables;
 	}
-#else
-	F32 oosob = 2.f/size;
-	S32	size = gGOPP->patch_size;
-	S32	line_size = line*size;
-	S32 u;
-	for (n = 0; n < size; n++)
-	{
-		total = OO_SQRT2*linein[line_size];
-		for (u = 1; u < size; u++)
-		{
-			total += linein[line_size + u]*pcp[u*size+n];
-		}
-		lineout[line_size + n] = total*oosob;
-	}
-#endif
-}
-
-inline void idct_line_large_slow(F32 *linein, F32 *lineout, S32 line)
-{
-	S32 n;
-	F32 total;
-	F32 *pcp = gPatchICosines;
-
-	F32 oosob = 2.f/32.f;
-	S32	line_size = line*LARGE_PATCH_SIZE;
-	F32 *tlinein, *tpcp;
-
-
-	for (n = 0; n < LARGE_PATCH_SIZE; n++)
+	if (size == LARGE_PATCH_SIZE)
 	{
-		tpcp = pcp + n;
-		tlinein = linein + line_size;
-	
-		total = OO_SQRT2*(*(tlinein++));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		*(lineout + line_size + n) = total*oosob;
+		return &large_tables;
 	}
+	LL_WARNS() << "Unsupported patch size " << size << LL_ENDL;
+	return NULL;
 }
 
-// Nota Bene: assumes that coefficients beyond 128 are 0!
+S32	gCurrentDeSize = 0;
 
-void idct_line_large(F32 *linein, F32 *lineout, S32 line)
+void init_patch_decompressor(S32 size)
 {
-	S32 n;
-	F32 total;
-	F32 *pcp = gPatchICosines;
-
-	F32 oosob = 2.f/32.f;
-	S32	line_size = line*LARGE_PATCH_SIZE;
-	F32 *tlinein, *tpcp;
-	F32 *baselinein = linein + line_size;
-	F32 *baselineout = lineout + line_size;
-
-
-	for (n = 0; n < LARGE_PATCH_SIZE; n++)
+	if (size != gCurrentDeSize)
 	{
-		tpcp = pcp++;
-		tlinein = baselinein;
-	
-		total = OO_SQRT2*(*(tlinein++));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein++)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein)*(*(tpcp));
-
-		*baselineout++ = total*oosob;
+		gCurrentDeSize = size;
+		get_patch_idct_tables(size);
 	}
 }
 
-inline void idct_column(F32 *linein, F32 *lineout, S32 column)
+// Separable inverse DCT, on four columns (then four outputs of a line) per
+// SSE register, with one independent sum per register so they pipeline.
+// Every lane sums its terms in the same order as the scalar version did, so
+// the result is unchanged.
+template <S32 SIZE>
+static void idct_patch(F32 *block, const F32 *pcp)
 {
-	S32 n;
-	F32 total;
-	F32 *pcp = gPatchICosines;
-
-#ifdef _PATCH_SIZE_16_AND_32_ONLY
-	F32 *tlinein, *tpcp;
-
-	for (n = 0; n < NORMAL_PATCH_SIZE; n++)
+	enum { GROUPS = SIZE / 4 };
+	LL_ALIGN_16(F32 temp[SIZE*SIZE]);
+	const __m128 oo_sqrt2 = _mm_set1_ps(OO_SQRT2);
+	__m128 total[GROUPS];
+	S32 n, u, g;
+
+	// Columns
+	for (n = 0; n < SIZE; n++)
 	{
-		tpcp = pcp + n;
-		tlinein = linein + column;
-
-		total = OO_SQRT2*(*tlinein);
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-		total += *(tlinein += NORMAL_PATCH_SIZE)*(*(tpcp += NORMAL_PATCH_SIZE));
-
-		*(lineout + (n<<4) + column) = total;
+		for (g = 0; g < GROUPS; g++)
+		{
+			total[g] = _mm_mul_ps(oo_sqrt2, _mm_load_ps(block + g*4));
+		}
+		for (u = 1; u < SIZE; u++)
+		{
+			const __m128 cosine = _mm_set1_ps(pcp[u*SIZE + n]);
+			for (g = 0; g < GROUPS; g++)
+			{
+				total[g] = _mm_add_ps(total[g], _mm_mul_ps(_mm_load_ps(block + u*SIZE + g*4), cosine));
+			}
+		}
+		for (g = 0; g < GROUPS; g++)
+		{
+			_mm_store_ps(temp + n*SIZE + g*4, total[g]);
+		}
 	}
 
-#else
-	S32	size = gGOPP->patch_size;
-	S32 u;
-	S32 u_size;
-
-	for (n = 0; n < size; n++)
+	// Lines
+	const __m128 oosob = _mm_set1_ps(2.f/SIZE);
+	for (n = 0; n < SIZE; n++)
 	{
-		total = OO_SQRT2*linein[column];
-		for (u = 1; u < size; u++)
+		const F32 *linein = temp + n*SIZE;
+		const __m128 first = _mm_mul_ps(oo_sqrt2, _mm_set1_ps(linein[0]));
+		for (g = 0; g < GROUPS; g++)
 		{
-			u_size = u*size;
-			total += linein[u_size + column]*pcp[u_size+n];
+			total[g] = first;
+		}
+		for (u = 1; u < SIZE; u++)
+		{
+			const __m128 value = _mm_set1_ps(linein[u]);
+			for (g = 0; g < GROUPS; g++)
+			{
+				total[g] = _mm_add_ps(total[g], _mm_mul_ps(value, _mm_load_ps(pcp + u*SIZE + g*4)));
+			}
+		}
+		for (g = 0; g < GROUPS; g++)
+		{
+			_mm_store_ps(block + n*SIZE + g*4, _mm_mul_ps(total[g], oosob));
 		}
-		lineout[size*n + column] = total;
 	}
-#endif
 }
 
-inline void idct_column_large_slow(F32 *linein, F32 *lineout, S32 column)
+// Dequantizes cpatch into block, in natural order, and runs the inverse DCT.
+// Sets the mult and addval that scale the block back to patch values.
+static bool dequantize_patch(F32 *block, const S32 *cpatch, const LLPatchHeader *ph, S32 size,
+							 F32 &mult, F32 &addval)
 {
-	S32 n;
-	F32 total;
-	F32 *pcp = gPatchICosines;
-
-	F32 *tlinein, *tpcp;
-
-	for (n = 0; n < LARGE_PATCH_SIZE; n++)
+	const LLPatchIDCTTables *tablesp = get_patch_idct_tables(size);
+	if (!tablesp)
 	{
-		tpcp = pcp + n;
-		tlinein = linein + column;
-
-		total = OO_SQRT2*(*tlinein);
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-		total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		*(lineout + (n<<5) + column) = total;
+		return false;
 	}
-}
-
-// Nota Bene: assumes that coefficients beyond 128 are 0!
-
-void idct_column_large(F32 *linein, F32 *lineout, S32 column)
-{
-	S32 n, m;
-	F32 total;
-	F32 *pcp = gPatchICosines;
-
-	F32 *tlinein, *tpcp;
-	F32 *baselinein = linein + column;
-	F32 *baselineout = lineout + column;
+	const LLPatchIDCTTables &tables = *tablesp;
+	const S32 *decopy_matrix = tables.mDeCopy;
+	const F32 *dq = tables.mDequantize;
+	S32 i;
 
-	for (n = 0; n < LARGE_PATCH_SIZE; n++)
+	for (i = 0; i < size*size; i += 4)
 	{
-		tpcp = pcp++;
-		tlinein = baselinein;
-
-		total = OO_SQRT2*(*tlinein);
-		for (m = 1; m < NORMAL_PATCH_SIZE; m++)
-			total += *(tlinein += LARGE_PATCH_SIZE)*(*(tpcp += LARGE_PATCH_SIZE));
-
-		*(baselineout + (n<<5)) = total;
+		__m128i coefficients = _mm_setr_epi32(cpatch[decopy_matrix[i]], cpatch[decopy_matrix[i + 1]],
+											  cpatch[decopy_matrix[i + 2]], cpatch[decopy_matrix[i + 3]]);
+		_mm_store_ps(block + i, _mm_mul_ps(_mm_cvtepi32_ps(coefficients), _mm_load_ps(dq + i)));
 	}
-}
 
-inline void idct_patch(F32 *block)
-{
-	F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
-
-#ifdef _PATCH_SIZE_16_AND_32_ONLY
-	idct_column(block, temp, 0);	
-	idct_column(block, temp, 1);	
-	idct_column(block, temp, 2);	
-	idct_column(block, temp, 3);	
-
-	idct_column(block, temp, 4);	
-	idct_column(block, temp, 5);	
-	idct_column(block, temp, 6);	
-	idct_column(block, temp, 7);	
-
-	idct_column(block, temp, 8);	
-	idct_column(block, temp, 9);	
-	idct_column(block, temp, 10);	
-	idct_column(block, temp, 11);	
-
-	idct_column(block, temp, 12);	
-	idct_column(block, temp, 13);	
-	idct_column(block, temp, 14);	
-	idct_column(block, temp, 15);	
-
-	idct_line(temp, block, 0);	
-	idct_line(temp, block, 1);	
-	idct_line(temp, block, 2);	
-	idct_line(temp, block, 3);	
-
-	idct_line(temp, block, 4);	
-	idct_line(temp, block, 5);	
-	idct_line(temp, block, 6);	
-	idct_line(temp, block, 7);	
-
-	idct_line(temp, block, 8);	
-	idct_line(temp, block, 9);	
-	idct_line(temp, block, 10);	
-	idct_line(temp, block, 11);	
-
-	idct_line(temp, block, 12);	
-	idct_line(temp, block, 13);	
-	idct_line(temp, block, 14);	
-	idct_line(temp, block, 15);	
-#else
-	S32 i;
-	S32	size = gGOPP->patch_size;
-	for (i = 0; i < size; i++)
+	if (size == NORMAL_PATCH_SIZE)
 	{
-		idct_column(block, temp, i);	
+		idct_patch<NORMAL_PATCH_SIZE>(block, tables.mICosines);
 	}
-	for (i = 0; i < size; i++)
+	else
 	{
-		idct_line(temp, block, i);	
+		idct_patch<LARGE_PATCH_SIZE>(block, tables.mICosines);
 	}
-#endif
-}
-
-inline void idct_patch_large(F32 *block)
-{
-	F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
-
-	idct_column_large_slow(block, temp, 0);	
-	idct_column_large_slow(block, temp, 1);	
-	idct_column_large_slow(block, temp, 2);	
-	idct_column_large_slow(block, temp, 3);	
-
-	idct_column_large_slow(block, temp, 4);	
-	idct_column_large_slow(block, temp, 5);	
-	idct_column_large_slow(block, temp, 6);	
-	idct_column_large_slow(block, temp, 7);	
-
-	idct_column_large_slow(block, temp, 8);	
-	idct_column_large_slow(block, temp, 9);	
-	idct_column_large_slow(block, temp, 10);	
-	idct_column_large_slow(block, temp, 11);	
-
-	idct_column_large_slow(block, temp, 12);	
-	idct_column_large_slow(block, temp, 13);	
-	idct_column_large_slow(block, temp, 14);	
-	idct_column_large_slow(block, temp, 15);	
-
-	idct_column_large_slow(block, temp, 16);	
-	idct_column_large_slow(block, temp, 17);	
-	idct_column_large_slow(block, temp, 18);	
-	idct_column_large_slow(block, temp, 19);	
-
-	idct_column_large_slow(block, temp, 20);	
-	idct_column_large_slow(block, temp, 21);	
-	idct_column_large_slow(block, temp, 22);	
-	idct_column_large_slow(block, temp, 23);	
-
-	idct_column_large_slow(block, temp, 24);	
-	idct_column_large_slow(block, temp, 25);	
-	idct_column_large_slow(block, temp, 26);	
-	idct_column_large_slow(block, temp, 27);	
-
-	idct_column_large_slow(block, temp, 28);	
-	idct_column_large_slow(block, temp, 29);	
-	idct_column_large_slow(block, temp, 30);	
-	idct_column_large_slow(block, temp, 31);	
-
-	idct_line_large_slow(temp, block, 0);	
-	idct_line_large_slow(temp, block, 1);	
-	idct_line_large_slow(temp, block, 2);	
-	idct_line_large_slow(temp, block, 3);	
-
-	idct_line_large_slow(temp, block, 4);	
-	idct_line_large_slow(temp, block, 5);	
-	idct_line_large_slow(temp, block, 6);	
-	idct_line_large_slow(temp, block, 7);	
-
-	idct_line_large_slow(temp, block, 8);	
-	idct_line_large_slow(temp, block, 9);	
-	idct_line_large_slow(temp, block, 10);	
-	idct_line_large_slow(temp, block, 11);	
-
-	idct_line_large_slow(temp, block, 12);	
-	idct_line_large_slow(temp, block, 13);	
-	idct_line_large_slow(temp, block, 14);	
-	idct_line_large_slow(temp, block, 15);	
-
-	idct_line_large_slow(temp, block, 16);	
-	idct_line_large_slow(temp, block, 17);	
-	idct_line_large_slow(temp, block, 18);	
-	idct_line_large_slow(temp, block, 19);	
-
-	idct_line_large_slow(temp, block, 20);	
-	idct_line_large_slow(temp, block, 21);	
-	idct_line_large_slow(temp, block, 22);	
-	idct_line_large_slow(temp, block, 23);	
-
-	idct_line_large_slow(temp, block, 24);	
-	idct_line_large_slow(temp, block, 25);	
-	idct_line_large_slow(temp, block, 26);	
-	idct_line_large_slow(temp, block, 27);	
-
-	idct_line_large_slow(temp, block, 28);	
-	idct_line_large_slow(temp, block, 29);	
-	idct_line_large_slow(temp, block, 30);	
-	idct_line_large_slow(temp, block, 31);	
-}
-
-S32	gDitherNoise = 128;
-
-void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
-{
-	S32		i, j;
-
-	F32		block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE], *tblock = block;
-	F32		*tpatch;
 
-	LLGroupHeader	*gopp = gGOPP;
-	S32		size = gopp->patch_size;
 	F32		range = ph->range;
 	S32		prequant = (ph->quant_wbits >> 4) + 2;
 	S32		quantize = 1<<prequant;
 	F32		hmin = ph->dc_offset;
-	S32		stride = gopp->stride;
-
 	F32		ooq = 1.f/(F32)quantize;
-	F32     *dq = gPatchDequantizeTable;
-	S32		*decopy_matrix = gDeCopyMatrix;
-
-	F32		mult = ooq*range;
-	F32		addval = mult*(F32)(1<<(prequant - 1))+hmin;
 
-	for (i = 0; i < size*size; i++)
-	{
-		*(tblock++) = *(cpatch + *(decopy_matrix++))*(*dq++);
-	}
+	mult = ooq*range;
+	addval = mult*(F32)(1<<(prequant - 1))+hmin;
+	return true;
+}
 
-	if (size == 16)
-	{
-		idct_patch(block);
-	}
-	else
+void decompress_patch_values(F32 *patch, S32 stride, const S32 *cpatch, const LLPatchHeader *ph, S32 size)
+{
+	LL_ALIGN_16(F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	F32 mult, addval;
+	if (!dequantize_patch(block, cpatch, ph, size, mult, addval))
 	{
-		idct_patch_large(block);
+		return;
 	}
 
+	const __m128 multv = _mm_set1_ps(mult);
+	const __m128 addvalv = _mm_set1_ps(addval);
+	S32 i, j;
 	for (j = 0; j < size; j++)
 	{
-		tpatch = patch + j*stride;
-		tblock = block + j*size;
-		for (i = 0; i < size; i++)
+		F32 *tpatch = patch + j*stride;
+		const F32 *tblock = block + j*size;
+		for (i = 0; i < size; i += 4)
 		{
-			*(tpatch++) = *(tblock++)*mult+addval;
+			_mm_storeu_ps(tpatch + i, _mm_add_ps(_mm_mul_ps(_mm_load_ps(tblock + i), multv), addvalv));
 		}
 	}
 }
 
+void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
+{
+	decompress_patch_values(patch, gGOPP->stride, cpatch, ph, gGOPP->patch_size);
+}
+
 
 void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 {
 	S32		i, j;
 
-	F32			block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE], *tblock = block;
+	LL_ALIGN_16(F32	block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	const F32	*tblock;
 	LLVector3	*tvec;
 
 	LLGroupHeader	*gopp = gGOPP;
 	S32		size = gopp->patch_size;
-	F32		range = ph->range;
-	S32		prequant = (ph->quant_wbits >> 4) + 2;
-	S32		quantize = 1<<prequant;
-	F32		hmin = ph->dc_offset;
 	S32		stride = gopp->stride;
+	F32		mult, addval;
 
-	F32		ooq = 1.f/(F32)quantize;
-	F32     *dq = gPatchDequantizeTable;
-	S32		*decopy_matrix = gDeCopyMatrix;
-
-	F32		mult = ooq*range;
-	F32		addval = mult*(F32)(1<<(prequant - 1))+hmin;
-
-//	BOOL	b_diag = FALSE;
-//	BOOL	b_right = TRUE;
-
-	for (i = 0; i < size*size; i++)
+	if (!dequantize_patch(block, cpatch, ph, size, mult, addval))
 	{
-		*(tblock++) = *(cpatch + *(decopy_matrix++))*(*dq++);
+		return;
 	}
 
-	if (size == 16)
-		idct_patch(block);
-	else
-		idct_patch_large(block);
-
 	for (j = 0; j < size; j++)
 	{
 		tvec = v + j*stride;
@@ -681,4 +324,3 @@ void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 		}
 	}
 }
-
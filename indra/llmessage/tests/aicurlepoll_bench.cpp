@@ -0,0 +1,470 @@
+/**
+ * @file aicurlepoll_bench.cpp
+ * @brief Driving libcurl from a loop around select() and around AICurlEpoll.
+ *
+ * Usage: aicurlepoll_bench [requests] [active connections] [idle connections]
+ *
+ * A stand-in HTTP server on the loopback interface answers small GET
+ * requests over keep-alive connections, in a thread of its own. The curl
+ * thread loop is then played out twice with a multi handle driven by
+ * socket and timer callbacks: once waiting in select() on fd_sets rebuilt
+ * from the sockets every time, as the curl thread used to, and once waiting
+ * in AICurlEpoll. Requests are kept going on the active connections until
+ * all are done. The idle connections hold requests the server never
+ * answers, like stalled fetches and the event poll, which select() has to
+ * look at every time and epoll does not.
+ *
+ * Reported are the requests per second and the CPU time of the thread that
+ * runs the loop; the server is not counted.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../aicurlepoll.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <thread>
+
+static const size_t BODY_SIZE = 1024;
+
+static F64 seconds(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (F64)ts.tv_sec + (F64)ts.tv_nsec * 1e-9;
+}
+
+// Answers every GET on a connection in order, except those for /idle.
+class StandInServer
+{
+public:
+	StandInServer() : mListenFd(-1), mPort(0), mStop(false) {}
+
+	bool start()
+	{
+		mListenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t len = sizeof(addr);
+		if (mListenFd == -1 || bind(mListenFd, (struct sockaddr*)&addr, sizeof(addr)) ||
+			listen(mListenFd, 1024) || getsockname(mListenFd, (struct sockaddr*)&addr, &len))
+		{
+			return false;
+		}
+		mPort = ntohs(addr.sin_port);
+		mResponse = llformat("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %d\r\n\r\n",
+							 (S32)BODY_SIZE) + std::string(BODY_SIZE, 'x');
+		mThread = std::thread(&StandInServer::run, this);
+		return true;
+	}
+
+	void stop()
+	{
+		mStop = true;
+		mThread.join();
+		for (std::map<int, Connection>::iterator it = mConnections.begin(); it != mConnections.end(); ++it)
+		{
+			close(it->first);
+		}
+		close(mListenFd);
+	}
+
+	U16 getPort() const { return mPort; }
+
+private:
+	struct Connection
+	{
+		std::string mIn;
+		std::string mOut;
+	};
+
+	void run()
+	{
+		int epfd = epoll_create1(EPOLL_CLOEXEC);
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = mListenFd;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, mListenFd, &ev);
+		struct epoll_event events[64];
+		char buf[16384];
+		while (!mStop)
+		{
+			int n = epoll_wait(epfd, events, 64, 20);
+			for (int i = 0; i < n; ++i)
+			{
+				int fd = events[i].data.fd;
+				if (fd == mListenFd)
+				{
+					int conn;
+					while ((conn = accept4(mListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+					{
+						int one = 1;
+						setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+						mConnections[conn];
+						ev.events = EPOLLIN;
+						ev.data.fd = conn;
+						epoll_ctl(epfd, EPOLL_CTL_ADD, conn, &ev);
+					}
+					continue;
+				}
+				Connection& connection = mConnections[fd];
+				bool closed = false;
+				if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+				{
+					ssize_t len;
+					while ((len = read(fd, buf, sizeof(buf))) > 0)
+					{
+						connection.mIn.append(buf, len);
+					}
+					closed = len == 0 || (len == -1 && errno != EAGAIN);
+					size_t end;
+					while ((end = connection.mIn.find("\r\n\r\n")) != std::string::npos)
+					{
+						if (connection.mIn.compare(0, 10, "GET /idle ") != 0)
+						{
+							connection.mOut += mResponse;
+						}
+						connection.mIn.erase(0, end + 4);
+					}
+				}
+				while (!closed && !connection.mOut.empty())
+				{
+					ssize_t len = write(fd, connection.mOut.data(), connection.mOut.size());
+					if (len <= 0)
+					{
+						closed = errno != EAGAIN;
+						break;
+					}
+					connection.mOut.erase(0, len);
+				}
+				if (closed)
+				{
+					epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+					close(fd);
+					mConnections.erase(fd);
+					continue;
+				}
+				ev.events = EPOLLIN | (connection.mOut.empty() ? 0 : EPOLLOUT);
+				ev.data.fd = fd;
+				epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+			}
+		}
+		close(epfd);
+	}
+
+	int mListenFd;
+	U16 mPort;
+	std::atomic<bool> mStop;
+	std::thread mThread;
+	std::string mResponse;
+	std::map<int, Connection> mConnections;
+};
+
+// The part of the curl thread loop that waits for sockets.
+class Waiter
+{
+public:
+	virtual ~Waiter() {}
+	virtual const char* getName() const = 0;
+	virtual void setAction(curl_socket_t s, int action) = 0;
+	// Waits at most timeout_ms and calls socket_action for every ready socket. Returns the number ready.
+	virtual int wait(CURLM* multi, long timeout_ms) = 0;
+};
+
+class SelectWaiter : public Waiter
+{
+public:
+	SelectWaiter() : mTooLarge(false) {}
+
+	const char* getName() const { return "select()"; }
+
+	void setAction(curl_socket_t s, int action)
+	{
+		mTooLarge = mTooLarge || s >= FD_SETSIZE;
+		for (size_t i = 0; i < mSockets.size(); ++i)
+		{
+			if (mSockets[i].first == s)
+			{
+				mSockets[i] = mSockets.back();
+				mSockets.pop_back();
+				break;
+			}
+		}
+		if (action != CURL_POLL_NONE && action != CURL_POLL_REMOVE)
+		{
+			mSockets.push_back(std::make_pair(s, action));
+		}
+	}
+
+	int wait(CURLM* multi, long timeout_ms)
+	{
+		if (mTooLarge)
+		{
+			return -1;
+		}
+		fd_set read_fd_set, write_fd_set;
+		FD_ZERO(&read_fd_set);
+		FD_ZERO(&write_fd_set);
+		int nfds = 0;
+		for (size_t i = 0; i < mSockets.size(); ++i)
+		{
+			if ((mSockets[i].second & CURL_POLL_IN))
+				FD_SET(mSockets[i].first, &read_fd_set);
+			if ((mSockets[i].second & CURL_POLL_OUT))
+				FD_SET(mSockets[i].first, &write_fd_set);
+			nfds = llmax(nfds, mSockets[i].first + 1);
+		}
+		struct timeval timeout;
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_usec = (timeout_ms % 1000) * 1000;
+		int ready = select(nfds, &read_fd_set, &write_fd_set, NULL, &timeout);
+		if (ready <= 0)
+		{
+			return ready;
+		}
+		// Sockets added by socket_action() are in neither set.
+		std::vector<std::pair<curl_socket_t, int> > sockets(mSockets);
+		for (size_t i = 0; i < sockets.size(); ++i)
+		{
+			int ev_bitmask = (FD_ISSET(sockets[i].first, &read_fd_set) ? CURL_CSELECT_IN : 0) |
+							 (FD_ISSET(sockets[i].first, &write_fd_set) ? CURL_CSELECT_OUT : 0);
+			if (ev_bitmask)
+			{
+				int running;
+				curl_multi_socket_action(multi, sockets[i].first, ev_bitmask, &running);
+			}
+		}
+		return ready;
+	}
+
+private:
+	std::vector<std::pair<curl_socket_t, int> > mSockets;
+	bool mTooLarge;
+};
+
+class EpollWaiter : public Waiter
+{
+public:
+	const char* getName() const { return "AICurlEpoll"; }
+
+	void setAction(curl_socket_t s, int action)
+	{
+		mEpoll.set_action(s, action);
+	}
+
+	int wait(CURLM* multi, long timeout_ms)
+	{
+		int ready = mEpoll.wait(timeout_ms);
+		for (int i = 0; i < ready; ++i)
+		{
+			curl_socket_t fd;
+			int ev_bitmask;
+			if (mEpoll.get_event(i, fd, ev_bitmask))
+			{
+				int running;
+				curl_multi_socket_action(multi, fd, ev_bitmask, &running);
+			}
+		}
+		return ready;
+	}
+
+private:
+	AICurlEpoll mEpoll;
+};
+
+struct Run
+{
+	Waiter* mWaiter;
+	long mTimeout;
+	S32 mCompleted;
+	S32 mFailed;
+	F64 mSeconds;
+	F64 mCPUSeconds;
+};
+
+static int socket_callback(CURL*, curl_socket_t s, int action, void* userp, void*)
+{
+	static_cast<Run*>(userp)->mWaiter->setAction(s, action);
+	return 0;
+}
+
+static int timer_callback(CURLM*, long timeout_ms, void* userp)
+{
+	static_cast<Run*>(userp)->mTimeout = timeout_ms;
+	return 0;
+}
+
+static size_t write_callback(char*, size_t size, size_t nmemb, void* userp)
+{
+	*static_cast<size_t*>(userp) += size * nmemb;
+	return size * nmemb;
+}
+
+static CURL* make_request(const std::string& url, size_t* received)
+{
+	CURL* easy = curl_easy_init();
+	curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(easy, CURLOPT_PROXY, "");
+	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &write_callback);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, received);
+	curl_easy_setopt(easy, CURLOPT_PRIVATE, received);
+	return easy;
+}
+
+static void run_requests(Run& run, U16 port, S32 requests, S32 active, S32 idle)
+{
+	CURLM* multi = curl_multi_init();
+	curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, &socket_callback);
+	curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, &run);
+	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, &timer_callback);
+	curl_multi_setopt(multi, CURLMOPT_TIMERDATA, &run);
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)(active + idle));
+
+	const std::string base = llformat("http://127.0.0.1:%d/", (S32)port);
+	std::vector<size_t> received(active + idle, 0);
+	std::vector<CURL*> easies;
+	for (S32 i = 0; i < active + idle; ++i)
+	{
+		easies.push_back(make_request(base + (i < active ? "asset" : "idle"), &received[i]));
+		curl_multi_add_handle(multi, easies.back());
+	}
+
+	run.mTimeout = 0;
+	run.mCompleted = run.mFailed = 0;
+	S32 started = active;
+	const F64 start = seconds(CLOCK_MONOTONIC);
+	const F64 start_cpu = seconds(CLOCK_THREAD_CPUTIME_ID);
+	while (run.mCompleted + run.mFailed < requests)
+	{
+		int ready = run.mWaiter->wait(multi, run.mTimeout < 0 ? 100 : run.mTimeout);
+		if (ready < 0)
+		{
+			std::cerr << run.mWaiter->getName() << " failed" << std::endl;
+			run.mFailed = requests;
+			break;
+		}
+		if (!ready)
+		{
+			int running;
+			curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+		}
+		CURLMsg* msg;
+		int queued;
+		while ((msg = curl_multi_info_read(multi, &queued)))
+		{
+			if (msg->msg != CURLMSG_DONE)
+			{
+				continue;
+			}
+			CURL* easy = msg->easy_handle;
+			size_t* bytes;
+			long status = 0;
+			curl_easy_getinfo(easy, CURLINFO_PRIVATE, &bytes);
+			curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+			if (msg->data.result == CURLE_OK && status == 200 && *bytes == BODY_SIZE)
+				++run.mCompleted;
+			else
+				++run.mFailed;
+			curl_multi_remove_handle(multi, easy);
+			if (started < requests)
+			{
+				*bytes = 0;
+				curl_multi_add_handle(multi, easy);
+				++started;
+			}
+		}
+	}
+	run.mSeconds = seconds(CLOCK_MONOTONIC) - start;
+	run.mCPUSeconds = seconds(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+
+	for (size_t i = 0; i < easies.size(); ++i)
+	{
+		curl_multi_remove_handle(multi, easies[i]);
+		curl_easy_cleanup(easies[i]);
+	}
+	curl_multi_cleanup(multi);
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 requests = argc > 1 ? atoi(argv[1]) : 50000;
+	const S32 active = argc > 2 ? atoi(argv[2]) : 16;
+	const S32 idle = argc > 3 ? atoi(argv[3]) : 400;
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	StandInServer server;
+	if (!server.start())
+	{
+		std::cerr << "Could not start the stand-in server: " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	bool ok = true;
+	SelectWaiter select_waiter;
+	EpollWaiter epoll_waiter;
+	Waiter* waiters[2] = { &select_waiter, &epoll_waiter };
+	F64 cpu_per_request[2] = { 0.0, 0.0 };
+	std::cout << llformat("%d requests of %d bytes, %d active and %d idle connections", requests, (S32)BODY_SIZE,
+						  active, idle) << std::endl;
+	for (S32 w = 0; w < 2; ++w)
+	{
+		Run run;
+		run.mWaiter = waiters[w];
+		run_requests(run, server.getPort(), requests, active, idle);
+		if (run.mFailed)
+		{
+			std::cerr << run.mWaiter->getName() << ": " << run.mFailed << " requests failed" << std::endl;
+			ok = false;
+		}
+		cpu_per_request[w] = run.mCPUSeconds / llmax(run.mCompleted, 1);
+		std::cout << llformat("%-12s %8.0f requests/s, curl thread CPU %6.2fs (%3.0f%%), %5.1fus a request | %4.2fx",
+							  run.mWaiter->getName(), run.mCompleted / run.mSeconds, run.mCPUSeconds,
+							  run.mCPUSeconds * 100.0 / run.mSeconds, cpu_per_request[w] * 1e6,
+							  cpu_per_request[0] / cpu_per_request[w]) << std::endl;
+	}
+
+	server.stop();
+	curl_global_cleanup();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+/**
+ * @file llmessagedecode_bench.cpp
+ * @brief Decoding object update messages, and reading their fields, as the template reader did and does.
+ *
+ * Usage: llmessagedecode_bench <message_template.msg> [messages] [passes]
+ *
+ * Builds a stream of the messages a region sends an agent arriving in it,
+ * 1000 by default, from the message template: ObjectUpdate with three full
+ * object updates, ObjectUpdateCompressed with five, ImprovedTerseObjectUpdate
+ * with ten, and PacketAck, in the proportions 4:3:2:1. Fields are random,
+ * and variable ones the sizes they have at login: texture entries of 100 to
+ * 250 bytes, compressed updates of 150 to 250, terse updates of 44. The
+ * stream is decoded 200 times by default, first alone, then reading every
+ * field of every block after each message, as the object update handlers do.
+ *
+ * It is decoded as the reader did, finding the template in a std::map by
+ * number, and each field by name in a std::map of blocks keyed by name plus
+ * repeat number, copied into an allocation of its own; then by
+ * LLTemplateMessageReader, which finds the template in direct-index tables
+ * and each field by perfect hashed name, in buffers it keeps. Both must read
+ * the same bytes. Reported are the CPU time a message, and the heap
+ * allocations made while decoding.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmessagetemplate.h"
+#include "../llmessagetemplateparser.h"
+#include "../lltemplatemessagebuilder.h"
+#include "../lltemplatemessagereader.h"
+#include "../message_prehash.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <new>
+
+typedef std::map<U32, LLMessageTemplate*> number_map_t;
+typedef std::map<const char*, LLMessageTemplate*> name_map_t;
+
+// Heap allocations, counted while sCountAllocations is set.
+static bool sCountAllocations = false;
+static U64 sAllocations = 0;
+
+void* operator new(size_t size)
+{
+	if (sCountAllocations)
+	{
+		++sAllocations;
+	}
+	void* p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// The reader as it was, less its error reporting: the bench only builds
+// packets that decode.
+class MapReader
+{
+public:
+	MapReader(const number_map_t& numbers) : mNumbers(numbers), mTemplate(NULL), mData(NULL) {}
+	~MapReader()	{ delete mData; }
+
+	bool decode(const U8* buffer, S32 size)
+	{
+		delete mData;
+		mData = NULL;
+
+		const U8* header = buffer + LL_PACKET_ID_SIZE;
+		U32 num = 0;
+		if (header[0] != 255)
+		{
+			num = header[0];
+		}
+		else if (header[1] != 255)
+		{
+			num = (255 << 8) | header[1];
+		}
+		else
+		{
+			U16 message_id_U16 = 0;
+			memcpy(&message_id_U16, &header[2], 2);
+			num = 0xFFFF0000 | ntohs(message_id_U16);
+		}
+		mTemplate = get_ptr_in_map(mNumbers, num);
+		if (!mTemplate)
+		{
+			return false;
+		}
+
+		S32 decode_pos = LL_PACKET_ID_SIZE + (S32)mTemplate->mFrequency + buffer[PHL_OFFSET];
+		mData = new LLMsgData(mTemplate->mName);
+		for (LLMessageTemplate::message_block_map_t::const_iterator iter = mTemplate->mMemberBlocks.begin();
+			 iter != mTemplate->mMemberBlocks.end(); ++iter)
+		{
+			const LLMessageBlock* mbci = mTemplate->mMemberBlocks.toValue(iter);
+			S32 repeat_number = 1;
+			if (mbci->mType == MBT_MULTIPLE)
+			{
+				repeat_number = mbci->mNumber;
+			}
+			else if (mbci->mType == MBT_VARIABLE)
+			{
+				repeat_number = decode_pos < size ? buffer[decode_pos++] : 0;
+			}
+
+			for (S32 i = 0; i < repeat_number; ++i)
+			{
+				LLMsgBlkData* cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
+				cur_data_block->mName = mbci->mName + i;
+				mData->addBlock(cur_data_block);
+
+				for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = mbci->mMemberVariables.begin();
+					 var_iter != mbci->mMemberVariables.end(); ++var_iter)
+				{
+					const LLMessageVariable* mvci = mbci->mMemberVariables.toValue(var_iter);
+					cur_data_block->addVariable(mvci->getName(), mvci->getType());
+					if (mvci->getType() == MVT_VARIABLE)
+					{
+						U32 tsize = 0;
+						if (mvci->getSize() == 1)
+						{
+							tsize = buffer[decode_pos];
+						}
+						else if (mvci->getSize() == 2)
+						{
+							U16 tsizeh = 0;
+							htonmemcpy(&tsizeh, &buffer[decode_pos], MVT_U16, 2);
+							tsize = tsizeh;
+						}
+						else
+						{
+							htonmemcpy(&tsize, &buffer[decode_pos], MVT_U32, 4);
+						}
+						decode_pos += mvci->getSize();
+						cur_data_block->addData(mvci->getName(), &buffer[decode_pos], tsize, mvci->getType());
+						decode_pos += tsize;
+					}
+					else
+					{
+						cur_data_block->addData(mvci->getName(), &buffer[decode_pos], mvci->getSize(), mvci->getType());
+						decode_pos += mvci->getSize();
+					}
+				}
+			}
+		}
+		return !mData->mMemberBlocks.empty() || mTemplate->mMemberBlocks.empty();
+	}
+
+	S32 getNumberOfBlocks(const char* blockname)
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = mData->mMemberBlocks.find((char*)blockname);
+		return iter == mData->mMemberBlocks.end() ? 0 : iter->second->mBlockNumber;
+	}
+
+	S32 getSize(const char* blockname, S32 blocknum, const char* varname)
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = mData->mMemberBlocks.find((char*)blockname + blocknum);
+		if (iter == mData->mMemberBlocks.end())
+		{
+			return LL_BLOCK_NOT_IN_MESSAGE;
+		}
+		LLMsgVarData& vardata = iter->second->mMemberVarData[varname];
+		return vardata.getName() ? vardata.getSize() : LL_VARIABLE_NOT_IN_BLOCK;
+	}
+
+	void getBinaryData(const char* blockname, const char* varname, void* datap, S32 size, S32 blocknum)
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = mData->mMemberBlocks.find((char*)blockname + blocknum);
+		if (iter == mData->mMemberBlocks.end())
+		{
+			return;
+		}
+		LLMsgBlkData::msg_var_data_map_t& var_data_map = iter->second->mMemberVarData;
+		if (var_data_map.find(varname) == var_data_map.end())
+		{
+			return;
+		}
+		LLMsgVarData& vardata = var_data_map[varname];
+		if (size != vardata.getSize())
+		{
+			return;
+		}
+		switch (size)
+		{
+		case 1:
+			*((U8*)datap) = *((U8*)vardata.getData());
+			break;
+		case 2:
+			*((U16*)datap) = *((U16*)vardata.getData());
+			break;
+		case 4:
+			*((U32*)datap) = *((U32*)vardata.getData());
+			break;
+		case 8:
+			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
+			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
+			break;
+		default:
+			memcpy(datap, vardata.getData(), size);
+			break;
+		}
+	}
+
+private:
+	const number_map_t& mNumbers;
+	LLMessageTemplate* mTemplate;
+	LLMsgData* mData;
+};
+
+// The reader as it is, decoding without handling, as the message log does.
+class TemplateReader
+{
+public:
+	TemplateReader(number_map_t& numbers) : mReader(numbers) {}
+
+	bool decode(const U8* buffer, S32 size)
+	{
+		mReader.clearMessage();
+		return mReader.validateMessage(buffer, size, mHost, false, true)
+			&& mReader.readMessage(buffer, mHost, true);
+	}
+
+	S32 getNumberOfBlocks(const char* blockname)
+	{
+		return mReader.getNumberOfBlocks(blockname);
+	}
+
+	S32 getSize(const char* blockname, S32 blocknum, const char* varname)
+	{
+		return mReader.getSize(blockname, blocknum, varname);
+	}
+
+	void getBinaryData(const char* blockname, const char* varname, void* datap, S32 size, S32 blocknum)
+	{
+		mReader.getBinaryData(blockname, varname, datap, size, blocknum);
+	}
+
+private:
+	LLTemplateMessageReader mReader;
+	LLHost mHost;
+};
+
+struct Packet
+{
+	const LLMessageTemplate* mTemplate;
+	std::vector<U8> mData;
+};
+
+static U32 next_random(U32& seed)
+{
+	seed = seed * 1664525 + 1013904223;
+	return seed >> 8;
+}
+
+// How big a variable field is at login.
+static S32 variable_size(const LLMessageTemplate* templatep, const char* varname, U32& seed)
+{
+	if (varname == _PREHASH_TextureEntry)
+	{
+		return templatep->mName == _PREHASH_ObjectUpdate ? 100 + next_random(seed) % 151 : 0;
+	}
+	if (varname == _PREHASH_Data)
+	{
+		if (templatep->mName == _PREHASH_ObjectUpdateCompressed)
+		{
+			return 150 + next_random(seed) % 101;
+		}
+		return templatep->mName == _PREHASH_ImprovedTerseObjectUpdate ? 44 : 0;
+	}
+	if (varname == _PREHASH_ObjectData)
+	{
+		return 60;
+	}
+	if (varname == _PREHASH_ExtraParams)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+static Packet build_packet(LLTemplateMessageBuilder& builder, LLMessageTemplate* templatep, S32 objects, U32& seed)
+{
+	std::vector<U8> data;
+	builder.newMessage(templatep->mName);
+	for (LLMessageTemplate::message_block_map_t::const_iterator iter = templatep->mMemberBlocks.begin();
+		 iter != templatep->mMemberBlocks.end(); ++iter)
+	{
+		const LLMessageBlock* blockp = templatep->mMemberBlocks.toValue(iter);
+		const S32 repeats = blockp->mType == MBT_VARIABLE ? objects : blockp->mNumber;
+		for (S32 i = 0; i < repeats; ++i)
+		{
+			builder.nextBlock(blockp->mName);
+			for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = blockp->mMemberVariables.begin();
+				 var_iter != blockp->mMemberVariables.end(); ++var_iter)
+			{
+				const LLMessageVariable* varp = blockp->mMemberVariables.toValue(var_iter);
+				const S32 size = varp->getType() == MVT_VARIABLE ? variable_size(templatep, varp->getName(), seed) : varp->getSize();
+				data.resize(llmax(size, 1));
+				for (S32 j = 0; j < size; ++j)
+				{
+					data[j] = (U8)next_random(seed);
+				}
+				builder.addBinaryData(varp->getName(), &data[0], size);
+			}
+		}
+	}
+
+	Packet packet;
+	packet.mTemplate = templatep;
+	packet.mData.resize(MAX_BUFFER_SIZE);
+	packet.mData.resize(builder.buildMessage(&packet.mData[0], MAX_BUFFER_SIZE, 0));
+	builder.clearMessage();
+	return packet;
+}
+
+struct Results
+{
+	Results() : mMessages(0), mFields(0), mChecksum(0), mAllocations(0), mSeconds(0.0) {}
+
+	U64 mMessages;
+	U64 mFields;
+	U64 mChecksum;
+	U64 mAllocations;
+	F64 mSeconds;
+};
+
+// Folds data into checksum, eight bytes at a time so that it costs little
+// next to reading the fields.
+static U64 fold(U64 checksum, const U8* data, S32 size)
+{
+	S32 i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		U64 word;
+		memcpy(&word, data + i, 8);
+		checksum = (checksum ^ word) * 0x100000001b3ULL;
+	}
+	for (; i < size; ++i)
+	{
+		checksum = (checksum ^ data[i]) * 0x100000001b3ULL;
+	}
+	return checksum;
+}
+
+template <class Reader>
+static Results run(Reader& reader, const std::vector<Packet>& stream, S32 passes, bool read_fields)
+{
+	Results results;
+	U8 buffer[MAX_BUFFER_SIZE];
+	U64 checksum = 0xcbf29ce484222325ULL;
+
+	// One pass outside the count, to size the buffers the reader keeps.
+	for (S32 pass = -1; pass < passes; ++pass)
+	{
+		if (!pass)
+		{
+			results = Results();
+			sAllocations = 0;
+			sCountAllocations = true;
+			results.mSeconds = (F64)clock() / CLOCKS_PER_SEC;
+		}
+		for (const Packet& packet : stream)
+		{
+			if (!reader.decode(&packet.mData[0], (S32)packet.mData.size()))
+			{
+				std::cerr << "Could not decode " << packet.mTemplate->mName << std::endl;
+				exit(1);
+			}
+			++results.mMessages;
+			if (!read_fields)
+			{
+				continue;
+			}
+
+			const LLMessageTemplate* templatep = packet.mTemplate;
+			for (LLMessageTemplate::message_block_map_t::const_iterator iter = templatep->mMemberBlocks.begin();
+				 iter != templatep->mMemberBlocks.end(); ++iter)
+			{
+				const LLMessageBlock* blockp = templatep->mMemberBlocks.toValue(iter);
+				const S32 count = reader.getNumberOfBlocks(blockp->mName);
+				for (S32 i = 0; i < count; ++i)
+				{
+					for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = blockp->mMemberVariables.begin();
+						 var_iter != blockp->mMemberVariables.end(); ++var_iter)
+					{
+						const LLMessageVariable* varp = blockp->mMemberVariables.toValue(var_iter);
+						const S32 size = varp->getType() == MVT_VARIABLE ? reader.getSize(blockp->mName, i, varp->getName()) : varp->getSize();
+						if (size > 0)
+						{
+							reader.getBinaryData(blockp->mName, varp->getName(), buffer, size, i);
+							checksum = fold(checksum, buffer, size);
+						}
+						++results.mFields;
+					}
+				}
+			}
+		}
+	}
+
+	results.mSeconds = (F64)clock() / CLOCKS_PER_SEC - results.mSeconds;
+	sCountAllocations = false;
+	results.mAllocations = sAllocations;
+	results.mChecksum = checksum;
+	return results;
+}
+
+static void report(const char* name, const Results& results)
+{
+	std::cout << llformat("%-24s %8.1f ns/message, %10llu allocations, %llu fields read, checksum %016llx",
+						  name, results.mSeconds * 1.0e9 / (F64)results.mMessages,
+						  (unsigned long long)results.mAllocations, (unsigned long long)results.mFields,
+						  (unsigned long long)results.mChecksum) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 messages = argc > 2 ? atoi(argv[2]) : 1000;
+	const S32 passes = argc > 3 ? atoi(argv[3]) : 200;
+	std::ifstream file(argc > 1 ? argv[1] : "");
+	if (!file || messages <= 0 || passes <= 0)
+	{
+		std::cerr << "Usage: " << argv[0] << " <message_template.msg> [messages] [passes]" << std::endl;
+		return 1;
+	}
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	number_map_t numbers;
+	name_map_t names;
+	LLTemplateTokenizer tokens(contents);
+	LLTemplateParser parsed(tokens);
+	for (LLTemplateParser::message_iterator iter = parsed.getMessagesBegin();
+		 iter != parsed.getMessagesEnd(); ++iter)
+	{
+		numbers[(*iter)->mMessageNumber] = *iter;
+		names[(*iter)->mName] = *iter;
+	}
+
+	LLTemplateMessageBuilder builder(names);
+	LLMessageTemplate* object_update = names[_PREHASH_ObjectUpdate];
+	LLMessageTemplate* compressed = names[_PREHASH_ObjectUpdateCompressed];
+	LLMessageTemplate* terse = names[_PREHASH_ImprovedTerseObjectUpdate];
+	LLMessageTemplate* packet_ack = names[_PREHASH_PacketAck];
+	if (!object_update || !compressed || !terse || !packet_ack)
+	{
+		std::cerr << argv[1] << " lacks the object update messages" << std::endl;
+		return 1;
+	}
+
+	std::vector<Packet> stream;
+	U64 bytes = 0;
+	U32 seed = 1;
+	for (S32 i = 0; i < messages; ++i)
+	{
+		const S32 kind = i % 10;
+		if (kind < 4)
+		{
+			stream.push_back(build_packet(builder, object_update, 3, seed));
+		}
+		else if (kind < 7)
+		{
+			stream.push_back(build_packet(builder, compressed, 5, seed));
+		}
+		else if (kind < 9)
+		{
+			stream.push_back(build_packet(builder, terse, 10, seed));
+		}
+		else
+		{
+			stream.push_back(build_packet(builder, packet_ack, 20, seed));
+		}
+		bytes += stream.back().mData.size();
+	}
+	std::cout << messages << " messages of " << bytes / messages << " bytes on average, "
+			  << passes << " passes" << std::endl;
+
+	MapReader map_reader(numbers);
+	TemplateReader template_reader(numbers);
+	bool same = true;
+	for (S32 read_fields = 0; read_fields < 2; ++read_fields)
+	{
+		std::cout << (read_fields ? "Decoding, reading every field:" : "Decoding:") << std::endl;
+		const Results map_results = run(map_reader, stream, passes, read_fields);
+		report("std::map", map_results);
+		const Results template_results = run(template_reader, stream, passes, read_fields);
+		report("LLTemplateMessageReader", template_results);
+		same = same && map_results.mChecksum == template_results.mChecksum;
+		std::cout << llformat("speedup %.2fx, %s", map_results.mSeconds / template_results.mSeconds,
+							  map_results.mChecksum == template_results.mChecksum ? "same fields read" : "MISMATCH") << std::endl;
+	}
+
+	for_each(numbers.begin(), numbers.end(), DeletePairedPointer());
+	return same ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file llpacketbatch_bench.cpp
+ * @brief Taking a flood of packets off a UDP socket per frame and on a receive thread.
+ *
+ * Usage: llpacketbatch_bench [packets per second] [seconds] [frame ms]
+ *
+ * A sender thread floods a socket on the loopback interface with packets
+ * the size of object updates, 30000 a second by default, the way a busy
+ * region does at login. The receiving side renders frames of 25ms and
+ * takes packets off the socket between them: first one recvmsg() at a
+ * time on the main thread, as checkMessages() did, then out of the
+ * LLReceiveRing that a receive thread keeps filling with recvmmsg(), as it
+ * does now. The socket gets the same 400kB buffer as the viewer's. Reported
+ * are the packets that made it, which must arrive in order and intact, and
+ * the CPU time spent receiving.
+ *
+ * Sending the same packets one sendto() at a time and through LLSendBatch
+ * is timed as well.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketbatch.h"
+#include "../net.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "lltimer.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <time.h>
+
+static const S32 MIN_PACKET_SIZE = 200;
+static const S32 MAX_PACKET_SIZE = 1200;
+
+static F64 thread_cpu_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (F64)ts.tv_sec + (F64)ts.tv_nsec * 1e-9;
+}
+
+// Packet seq holds its number and a pattern derived from it.
+static S32 make_packet(U32 seq, char* datap)
+{
+	const S32 size = MIN_PACKET_SIZE + (S32)(seq * 2654435761U % (U32)(MAX_PACKET_SIZE - MIN_PACKET_SIZE));
+	memcpy(datap, &seq, sizeof(seq));
+	for (S32 i = sizeof(seq); i < size; ++i)
+	{
+		datap[i] = (char)(seq + i);
+	}
+	return size;
+}
+
+// Checks that packets arrive intact and in order, and counts them.
+struct Checker
+{
+	Checker() : mReceived(0), mNext(0), mBad(0) {}
+
+	void check(const char* datap, S32 size)
+	{
+		U32 seq;
+		char expected[MAX_PACKET_SIZE];
+		memcpy(&seq, datap, sizeof(seq));
+		if (seq < mNext || make_packet(seq, expected) != size || memcmp(datap, expected, size))
+		{
+			++mBad;
+		}
+		mNext = seq + 1;
+		++mReceived;
+	}
+
+	U32 mReceived;
+	U32 mNext;
+	U32 mBad;
+};
+
+static void flood(S32 socket, U32 port, S32 packets_per_second, F32 seconds, std::atomic<bool>* sending)
+{
+	char data[MAX_PACKET_SIZE];
+	const U32 loopback = ip_string_to_u32(LOOPBACK_ADDRESS_STRING);
+	const U32 total = (U32)(packets_per_second * seconds);
+	LLTimer timer;
+	U32 seq = 0;
+	while (seq < total)
+	{
+		// Keep up with the rate a millisecond at a time.
+		const U32 due = llmin(total, (U32)(timer.getElapsedTimeF64() * packets_per_second));
+		for ( ; seq < due; ++seq)
+		{
+			send_packet(socket, data, make_packet(seq, data), loopback, port);
+		}
+		ms_sleep(1);
+	}
+	*sending = false;
+}
+
+struct Result
+{
+	U32 mSent;
+	Checker mChecker;
+	F64 mCPUSeconds;
+};
+
+static Result receive_flood(S32 receiver, S32 sender, U32 port, S32 rate, F32 seconds, S32 frame_ms, bool threaded)
+{
+	Result result;
+	result.mSent = (U32)(rate * seconds);
+	char buffer[NET_BUFFER_SIZE];
+
+	LLReceiveRing ring(1024);
+	std::atomic<bool> quitting(false);
+	std::atomic<F64> thread_cpu(0.0);
+	std::thread receive_thread;
+	if (threaded)
+	{
+		// What LLPacketReceiveThread::run() does.
+		receive_thread = std::thread([&]() {
+			while (!quitting)
+			{
+				if (ring.isFull())
+				{
+					ms_sleep(1);
+				}
+				else if (!ring.receive(receiver))
+				{
+					wait_for_packet(receiver, 50);
+				}
+			}
+			thread_cpu = thread_cpu_seconds();
+		});
+	}
+
+	const F64 start_cpu = thread_cpu_seconds();
+	std::atomic<bool> sending(true);
+	std::thread flood_thread(flood, sender, port, rate, seconds, &sending);
+	bool last_frame = false;
+	while (!last_frame)
+	{
+		last_frame = !sending;
+		// Render a frame.
+		ms_sleep(frame_ms);
+		if (last_frame)
+		{
+			// Let the receive thread take what is left.
+			ms_sleep(100);
+		}
+		if (threaded)
+		{
+			for (const LLReceiveRing::Packet* packetp = ring.front(); packetp; packetp = ring.front())
+			{
+				result.mChecker.check(packetp->mData, packetp->mSize);
+				ring.pop();
+			}
+		}
+		else
+		{
+			S32 size;
+			while ((size = receive_packet(receiver, buffer)) > 0)
+			{
+				result.mChecker.check(buffer, size);
+			}
+		}
+	}
+	result.mCPUSeconds = thread_cpu_seconds() - start_cpu;
+	flood_thread.join();
+	if (threaded)
+	{
+		quitting = true;
+		receive_thread.join();
+		result.mCPUSeconds += thread_cpu;
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 rate = argc > 1 ? atoi(argv[1]) : 30000;
+	const F32 seconds = argc > 2 ? (F32)atof(argv[2]) : 2.f;
+	const S32 frame_ms = argc > 3 ? atoi(argv[3]) : 25;
+
+	bool ok = true;
+	static const char* NAMES[2] = { "main thread, per frame", "receive thread + ring" };
+	std::cout << llformat("%d packets a second for %.1fs, frames of %dms", rate, seconds, frame_ms) << std::endl;
+	for (S32 threaded = 0; threaded < 2; ++threaded)
+	{
+		// Fresh sockets, so that nothing is left from the previous run.
+		S32 receiver, sender;
+		int port = NET_USE_OS_ASSIGNED_PORT, sender_port = NET_USE_OS_ASSIGNED_PORT;
+		if (start_net(receiver, port) || start_net(sender, sender_port))
+		{
+			std::cerr << "Could not open the sockets" << std::endl;
+			return 1;
+		}
+		Result result = receive_flood(receiver, sender, port, rate, seconds, frame_ms, threaded);
+		if (result.mChecker.mBad)
+		{
+			std::cerr << NAMES[threaded] << ": " << result.mChecker.mBad << " packets out of order or damaged" << std::endl;
+			ok = false;
+		}
+		std::cout << llformat("%-23s %6u of %6u packets, %5.1f%% lost, %.0fms CPU receiving", NAMES[threaded],
+							  result.mChecker.mReceived, result.mSent,
+							  100.0 * (result.mSent - result.mChecker.mReceived) / result.mSent,
+							  result.mCPUSeconds * 1000.0) << std::endl;
+		end_net(receiver);
+		end_net(sender);
+	}
+
+	// Sending, with nobody reading: the kernel drops what does not fit.
+	S32 receiver, sender;
+	int port = NET_USE_OS_ASSIGNED_PORT, sender_port = NET_USE_OS_ASSIGNED_PORT;
+	if (start_net(receiver, port) || start_net(sender, sender_port))
+	{
+		std::cerr << "Could not open the sockets" << std::endl;
+		return 1;
+	}
+	const U32 loopback = ip_string_to_u32(LOOPBACK_ADDRESS_STRING);
+	const U32 to_send = 64 * 1024;
+	char data[MAX_PACKET_SIZE];
+	F64 send_cpu[2];
+	for (S32 batched = 0; batched < 2; ++batched)
+	{
+		LLSendBatch batch;
+		const F64 start = thread_cpu_seconds();
+		for (U32 seq = 0; seq < to_send; ++seq)
+		{
+			const S32 size = make_packet(seq, data);
+			if (!batched)
+			{
+				send_packet(sender, data, size, loopback, port);
+				continue;
+			}
+			if (batch.isFull())
+			{
+				batch.flush(sender);
+			}
+			batch.add(data, size, loopback, port);
+		}
+		batch.flush(sender);
+		send_cpu[batched] = thread_cpu_seconds() - start;
+	}
+	std::cout << llformat("sending %u packets: sendto() %.2fus a packet, LLSendBatch %.2fus a packet | %.1fx", to_send,
+						  send_cpu[0] * 1e6 / to_send, send_cpu[1] * 1e6 / to_send, send_cpu[0] / send_cpu[1]) << std::endl;
+	end_net(receiver);
+	end_net(sender);
+
+	return ok ? 0 : 1;
+}
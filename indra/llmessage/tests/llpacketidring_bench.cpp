@@ -0,0 +1,366 @@
+/**
+ * @file llpacketidring_bench.cpp
+ * @brief Reliable packet bookkeeping in std::map and in LLPacketIDRing, with packet loss.
+ *
+ * Usage: llpacketidring_bench [packets per frame] [frames] [loss percent]
+ *
+ * Plays a circuit sending reliable packets at a high rate, 400 a frame by
+ * default, the way LLCircuitData keeps them: a list of unacked packets and
+ * a list of packets on their final retry. Packets are lost, 5% of them by
+ * default, and so are their resends. The rest are acked five frames later,
+ * in PacketAck sized batches of up to 255. Every frame, the unacked packets
+ * that waited 20 frames for their ack are resent, and moved to the final
+ * list on their last retry; the final list is dropped 20 frames on.
+ *
+ * The lists are a std::map keyed by packet ID, as they were, and an
+ * LLPacketIDRing, as they are now. Both runs must ack, resend and drop the
+ * same packets. Reported are the CPU time, and the heap allocations made
+ * by the lists; the packets themselves come from a pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketidring.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <new>
+
+static const S32 ACK_DELAY = 5;			// frames
+static const S32 RESEND_TIMEOUT = 20;	// frames
+static const S32 RETRIES = 3;
+static const S32 ACKS_PER_BATCH = 255;
+static const TPACKETID FIRST_PACKET_ID = 0x00fff000;	// Wraps during the run.
+
+// Heap allocations, counted while sCountAllocations is set.
+static bool sCountAllocations = false;
+static U64 sAllocations = 0;
+
+void* operator new(size_t size)
+{
+	if (sCountAllocations)
+	{
+		++sAllocations;
+	}
+	void* p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+struct Packet
+{
+	TPACKETID mID;
+	S32 mRetries;
+	S32 mExpiration;
+	Packet* mNextFree;
+};
+
+// Packets and where they are, without allocating once warmed up.
+class PacketPool
+{
+public:
+	PacketPool() : mFree(NULL) {}
+	~PacketPool()
+	{
+		for (Packet* packetp : mBlocks)
+		{
+			delete [] packetp;
+		}
+	}
+
+	Packet* alloc()
+	{
+		if (!mFree)
+		{
+			Packet* block = new Packet[1024];
+			mBlocks.push_back(block);
+			for (S32 i = 0; i < 1024; ++i)
+			{
+				block[i].mNextFree = mFree;
+				mFree = &block[i];
+			}
+		}
+		Packet* packetp = mFree;
+		mFree = packetp->mNextFree;
+		return packetp;
+	}
+
+	void free(Packet* packetp)
+	{
+		packetp->mNextFree = mFree;
+		mFree = packetp;
+	}
+
+private:
+	Packet* mFree;
+	std::vector<Packet*> mBlocks;
+};
+
+// The lists as LLCircuitData kept them.
+class MapList
+{
+public:
+	void insert(TPACKETID id, Packet* packetp)	{ mPackets[id] = packetp; }
+	Packet* find(TPACKETID id)
+	{
+		std::map<TPACKETID, Packet*>::iterator it = mPackets.find(id);
+		return it == mPackets.end() ? NULL : it->second;
+	}
+	void erase(TPACKETID id)	{ mPackets.erase(id); }
+
+	// Calls func on each packet, oldest first; it may erase that packet.
+	template <class F> void walk(F func)
+	{
+		for (std::map<TPACKETID, Packet*>::iterator it = mPackets.begin(); it != mPackets.end();)
+		{
+			std::map<TPACKETID, Packet*>::iterator next = it;
+			++next;
+			func(it->first, it->second);
+			it = next;
+		}
+	}
+
+private:
+	std::map<TPACKETID, Packet*> mPackets;
+};
+
+// The lists as LLCircuitData keeps them.
+class RingList
+{
+public:
+	void insert(TPACKETID id, Packet* packetp)	{ mPackets.insert(id, packetp); }
+	Packet* find(TPACKETID id)
+	{
+		Packet** slotp = mPackets.find(id);
+		return slotp ? *slotp : NULL;
+	}
+	void erase(TPACKETID id)	{ mPackets.erase(id); }
+
+	template <class F> void walk(F func)
+	{
+		for (TPACKETID id = mPackets.getOldestID(); Packet** slotp = mPackets.findNext(id); ++id)
+		{
+			func(id, *slotp);
+		}
+	}
+
+private:
+	LLPacketIDRing<Packet*> mPackets;
+};
+
+struct Results
+{
+	Results() : mSent(0), mAcked(0), mResent(0), mDropped(0), mAllocations(0), mSeconds(0.0) {}
+
+	bool operator==(const Results& other) const
+	{
+		return mSent == other.mSent && mAcked == other.mAcked
+			&& mResent == other.mResent && mDropped == other.mDropped;
+	}
+
+	U64 mSent;
+	U64 mAcked;
+	U64 mResent;
+	U64 mDropped;
+	U64 mAllocations;
+	F64 mSeconds;
+};
+
+struct Ack
+{
+	S32 mFrame;
+	TPACKETID mID;
+};
+
+template <class List>
+static Results run(S32 packets_per_frame, S32 frames, U32 loss_percent)
+{
+	Results results;
+	PacketPool pool;
+	List unacked;
+	List final_retry;
+	std::vector<Ack> acks;	// In flight from acks[ack_head] on.
+	size_t ack_head = 0;
+	std::vector<TPACKETID> batch;
+	batch.reserve(ACKS_PER_BATCH);
+	U32 seed = 1;
+	TPACKETID next_id = FIRST_PACKET_ID;
+
+	// The same packets are lost in both runs.
+	auto lost = [&seed, loss_percent]()
+	{
+		seed = seed * 1664525 + 1013904223;
+		return (seed >> 8) % 100 < loss_percent;
+	};
+	auto transmit = [&](S32 frame, const Packet* packetp)
+	{
+		if (!lost())
+		{
+			Ack ack = { frame + ACK_DELAY, packetp->mID };
+			acks.push_back(ack);
+		}
+	};
+	auto ack = [&](TPACKETID id)
+	{
+		Packet* packetp = unacked.find(id);
+		if (packetp)
+		{
+			unacked.erase(id);
+		}
+		else if ((packetp = final_retry.find(id)))
+		{
+			final_retry.erase(id);
+		}
+		else
+		{
+			return;		// A resend acked twice.
+		}
+		++results.mAcked;
+		pool.free(packetp);
+	};
+
+	// Warm the pool and the lists up to their working size outside the count.
+	for (S32 frame = 0; frame < frames; ++frame)
+	{
+		if (frame == RESEND_TIMEOUT * (RETRIES + 2))
+		{
+			results = Results();
+			sAllocations = 0;
+			sCountAllocations = true;
+			results.mSeconds = (F64)clock() / CLOCKS_PER_SEC;
+		}
+
+		for (S32 i = 0; i < packets_per_frame; ++i)
+		{
+			Packet* packetp = pool.alloc();
+			packetp->mID = next_id;
+			packetp->mRetries = RETRIES;
+			packetp->mExpiration = frame + RESEND_TIMEOUT;
+			next_id = (next_id + 1) & LLPacketIDRing<Packet*>::ID_MASK;
+			unacked.insert(packetp->mID, packetp);
+			transmit(frame, packetp);
+			++results.mSent;
+		}
+
+		// Acks due this frame, a PacketAck message at a time.
+		while (ack_head < acks.size() && acks[ack_head].mFrame <= frame)
+		{
+			batch.clear();
+			while (ack_head < acks.size() && acks[ack_head].mFrame <= frame && (S32)batch.size() < ACKS_PER_BATCH)
+			{
+				batch.push_back(acks[ack_head++].mID);
+			}
+			for (TPACKETID id : batch)
+			{
+				ack(id);
+			}
+		}
+		if (ack_head > acks.size() / 2)
+		{
+			acks.erase(acks.begin(), acks.begin() + ack_head);
+			ack_head = 0;
+		}
+
+		unacked.walk([&](TPACKETID id, Packet* packetp)
+		{
+			if (frame > packetp->mExpiration)
+			{
+				--packetp->mRetries;
+				++results.mResent;
+				transmit(frame, packetp);
+				packetp->mExpiration = frame + RESEND_TIMEOUT;
+				if (!packetp->mRetries)
+				{
+					unacked.erase(id);
+					final_retry.insert(id, packetp);
+				}
+			}
+		});
+		final_retry.walk([&](TPACKETID id, Packet* packetp)
+		{
+			if (frame > packetp->mExpiration)
+			{
+				++results.mDropped;
+				final_retry.erase(id);
+				pool.free(packetp);
+			}
+		});
+	}
+
+	results.mSeconds = (F64)clock() / CLOCKS_PER_SEC - results.mSeconds;
+	sCountAllocations = false;
+	results.mAllocations = sAllocations;
+	return results;
+}
+
+static void report(const char* name, const Results& results)
+{
+	std::cout << llformat("%-16s %8.1f ns/packet sent, %10llu allocations, %llu acked, %llu resent, %llu dropped",
+						  name, results.mSeconds * 1.0e9 / (F64)results.mSent,
+						  (unsigned long long)results.mAllocations, (unsigned long long)results.mAcked,
+						  (unsigned long long)results.mResent, (unsigned long long)results.mDropped) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 packets_per_frame = argc > 1 ? atoi(argv[1]) : 400;
+	const S32 frames = argc > 2 ? atoi(argv[2]) : 20000;
+	const S32 loss_percent = argc > 3 ? atoi(argv[3]) : 5;
+	if (packets_per_frame <= 0 || frames <= RESEND_TIMEOUT * (RETRIES + 2) || loss_percent < 0 || loss_percent > 100)
+	{
+		std::cerr << "Usage: " << argv[0] << " [packets per frame] [frames] [loss percent]" << std::endl;
+		return 1;
+	}
+	std::cout << packets_per_frame << " reliable packets a frame, " << frames << " frames, "
+			  << loss_percent << "% lost" << std::endl;
+
+	const Results map_results = run<MapList>(packets_per_frame, frames, loss_percent);
+	report("std::map", map_results);
+	const Results ring_results = run<RingList>(packets_per_frame, frames, loss_percent);
+	report("LLPacketIDRing", ring_results);
+
+	std::cout << llformat("speedup %.2fx, %s", map_results.mSeconds / ring_results.mSeconds,
+						  map_results == ring_results ? "same packets acked, resent and dropped" : "MISMATCH") << std::endl;
+	return map_results == ring_results ? 0 : 1;
+}
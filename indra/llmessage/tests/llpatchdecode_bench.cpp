@@ -0,0 +1,371 @@
+/**
+ * @file llpatchdecode_bench.cpp
+ * @brief Terrain patch decompression throughput, round tripped through the encoder.
+ *
+ * Usage: llpatchdecode_bench [iterations]
+ *
+ * A synthetic 256m heightfield is compressed with compress_patch() and coded
+ * into LayerData groups of 16 patches, the way the simulator sends land.
+ * Those groups are then decoded with the scalar IDCT the viewer used to run,
+ * with the per patch decode_patch()/decompress_patch() calls, and with
+ * decode_patch_group(). All of them must produce the same heights. The
+ * IDCT alone is also timed on coefficients decoded beforehand.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "bitpack.h"
+#include "llerrorcontrol.h"
+#include "llmath.h"
+#include "llrand.h"
+#include "lltimer.h"
+#include "../patch_code.h"
+#include "../patch_dct.h"
+
+#include <iostream>
+
+static const S32 REGION_WIDTH = 256;
+static const S32 PATCH_SIZE = NORMAL_PATCH_SIZE;
+static const S32 PATCHES_PER_EDGE = REGION_WIDTH / PATCH_SIZE;
+static const S32 PREQUANT = 10;			// what the simulator uses for land
+static const U32 GROUP_BUFFER_SIZE = 64 * 1024;
+
+struct Group
+{
+	std::vector<U8> mData;
+};
+
+// The scalar dequantize and IDCT decompress_patch() used to run.
+class ReferenceDecompressor
+{
+public:
+	ReferenceDecompressor()
+	{
+		F32 oosob = F_PI*0.5f/PATCH_SIZE;
+		for (S32 u = 0; u < PATCH_SIZE; u++)
+		{
+			for (S32 n = 0; n < PATCH_SIZE; n++)
+			{
+				mDequantize[u*PATCH_SIZE + n] = (1.f + 2.f*(u+n));
+				mICosines[u*PATCH_SIZE + n] = cosf((2.f*n+1.f)*u*oosob);
+			}
+		}
+		// Zigzag order, as build_decopy_matrix()
+		S32 i = 0, j = 0, count = 0;
+		bool b_diag = false, b_right = true;
+		while (i < PATCH_SIZE && j < PATCH_SIZE)
+		{
+			mDeCopy[j*PATCH_SIZE + i] = count++;
+			if (!b_diag)
+			{
+				if (b_right)
+				{
+					if (i < PATCH_SIZE - 1) i++; else j++;
+					b_right = false;
+				}
+				else
+				{
+					if (j < PATCH_SIZE - 1) j++; else i++;
+					b_right = true;
+				}
+				b_diag = true;
+			}
+			else if (b_right)
+			{
+				i++; j--;
+				b_diag = !(i == PATCH_SIZE - 1 || j == 0);
+			}
+			else
+			{
+				i--; j++;
+				b_diag = !(i == 0 || j == PATCH_SIZE - 1);
+			}
+		}
+	}
+
+	void decompress(F32* patch, S32 stride, const S32* cpatch, const LLPatchHeader& ph) const
+	{
+		F32 block[PATCH_SIZE*PATCH_SIZE], temp[PATCH_SIZE*PATCH_SIZE];
+		for (S32 i = 0; i < PATCH_SIZE*PATCH_SIZE; i++)
+		{
+			block[i] = cpatch[mDeCopy[i]]*mDequantize[i];
+		}
+		for (S32 column = 0; column < PATCH_SIZE; column++)
+		{
+			for (S32 n = 0; n < PATCH_SIZE; n++)
+			{
+				F32 total = OO_SQRT2*block[column];
+				for (S32 u = 1; u < PATCH_SIZE; u++)
+				{
+					total += block[u*PATCH_SIZE + column]*mICosines[u*PATCH_SIZE + n];
+				}
+				temp[n*PATCH_SIZE + column] = total;
+			}
+		}
+		for (S32 line = 0; line < PATCH_SIZE; line++)
+		{
+			for (S32 n = 0; n < PATCH_SIZE; n++)
+			{
+				F32 total = OO_SQRT2*temp[line*PATCH_SIZE];
+				for (S32 u = 1; u < PATCH_SIZE; u++)
+				{
+					total += temp[line*PATCH_SIZE + u]*mICosines[u*PATCH_SIZE + n];
+				}
+				block[line*PATCH_SIZE + n] = total*(2.f/16.f);
+			}
+		}
+
+		S32 prequant = (ph.quant_wbits >> 4) + 2;
+		F32 mult = (1.f/(F32)(1<<prequant))*ph.range;
+		F32 addval = mult*(F32)(1<<(prequant - 1))+ph.dc_offset;
+		for (S32 j = 0; j < PATCH_SIZE; j++)
+		{
+			for (S32 i = 0; i < PATCH_SIZE; i++)
+			{
+				patch[j*stride + i] = block[j*PATCH_SIZE + i]*mult+addval;
+			}
+		}
+	}
+
+private:
+	F32 mDequantize[PATCH_SIZE*PATCH_SIZE];
+	F32 mICosines[PATCH_SIZE*PATCH_SIZE];
+	S32 mDeCopy[PATCH_SIZE*PATCH_SIZE];
+};
+
+// One group per row of patches, coded as the simulator does.
+static std::vector<Group> encode_region(std::vector<F32>& heights)
+{
+	std::vector<Group> groups;
+	init_patch_compressor(PATCH_SIZE, REGION_WIDTH, 'L');
+	for (S32 y = 0; y < PATCHES_PER_EDGE; y++)
+	{
+		Group group;
+		group.mData.resize(GROUP_BUFFER_SIZE);
+		LLBitPack bitpack(&group.mData[0], GROUP_BUFFER_SIZE);
+		init_patch_coding(bitpack);
+
+		LLGroupHeader group_header;
+		get_patch_group_header(&group_header);
+		code_patch_group_header(bitpack, &group_header);
+
+		for (S32 x = 0; x < PATCHES_PER_EDGE; x++)
+		{
+			F32* patchp = &heights[y*PATCH_SIZE*REGION_WIDTH + x*PATCH_SIZE];
+			LLPatchHeader ph;
+			F32 zmax, zmin;
+			S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+			prescan_patch(patchp, &ph, zmax, zmin);
+			ph.patchids = (x << 5) | y;
+			compress_patch(patchp, cpatch, &ph, PREQUANT);
+			code_patch_header(bitpack, &ph, cpatch);
+			code_patch(bitpack, cpatch, 0);
+		}
+		code_end_of_data(bitpack);
+		group.mData.resize(bitpack.flushBitPack());
+		groups.push_back(group);
+	}
+	return groups;
+}
+
+static F32 max_difference(const std::vector<F32>& a, const std::vector<F32>& b)
+{
+	F32 difference = 0.f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		difference = llmax(difference, fabsf(a[i] - b[i]));
+	}
+	return difference;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 iterations = argc > 1 ? atoi(argv[1]) : 200;
+	if (iterations <= 0)
+	{
+		std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+		return 1;
+	}
+
+	// Rolling hills with some noise, between 20m and 60m.
+	srand(1);
+	std::vector<F32> source(REGION_WIDTH * REGION_WIDTH);
+	for (S32 y = 0; y < REGION_WIDTH; y++)
+	{
+		for (S32 x = 0; x < REGION_WIDTH; x++)
+		{
+			source[y * REGION_WIDTH + x] = 40.f + 15.f * sinf(x * 0.03f) * cosf(y * 0.045f) + 0.25f * ll_frand();
+		}
+	}
+	std::vector<F32> heights = source;
+	std::vector<Group> groups = encode_region(heights);
+	size_t coded_bytes = 0;
+	for (const Group& group : groups)
+	{
+		coded_bytes += group.mData.size();
+	}
+	const F64 patch_count = (F64)PATCHES_PER_EDGE * PATCHES_PER_EDGE * iterations;
+	std::cout << groups.size() << " groups, " << coded_bytes << " bytes per region, " << iterations << " iterations" << std::endl;
+
+	// Scalar IDCT, as the viewer used to decompress.
+	ReferenceDecompressor reference_decompressor;
+	std::vector<F32> reference(REGION_WIDTH * REGION_WIDTH);
+	LLTimer timer;
+	for (S32 k = 0; k < iterations; k++)
+	{
+		for (Group& group : groups)
+		{
+			LLBitPack bitpack(&group.mData[0], group.mData.size());
+			LLGroupHeader group_header;
+			decode_patch_group_header(bitpack, &group_header);
+			LLPatchHeader ph;
+			S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+			while (1)
+			{
+				decode_patch_header(bitpack, &ph);
+				if (ph.quant_wbits == END_OF_PATCHES)
+				{
+					break;
+				}
+				decode_patch(bitpack, cpatch);
+				const S32 x = ph.patchids >> 5, y = ph.patchids & 0x1F;
+				reference_decompressor.decompress(&reference[y*PATCH_SIZE*REGION_WIDTH + x*PATCH_SIZE], REGION_WIDTH, cpatch, ph);
+			}
+		}
+	}
+	const F64 reference_time = timer.getElapsedTimeF64();
+	std::cout << llformat("scalar IDCT:        %8.2f us/patch, round trip error %.3fm",
+						  reference_time * 1.0e6 / patch_count, max_difference(source, reference)) << std::endl;
+
+	// Per patch calls, now on the SSE2 IDCT.
+	std::vector<F32> per_patch(REGION_WIDTH * REGION_WIDTH);
+	timer.reset();
+	for (S32 k = 0; k < iterations; k++)
+	{
+		for (Group& group : groups)
+		{
+			LLBitPack bitpack(&group.mData[0], group.mData.size());
+			LLGroupHeader group_header;
+			decode_patch_group_header(bitpack, &group_header);
+			init_patch_decompressor(group_header.patch_size);
+			group_header.stride = REGION_WIDTH;
+			set_group_of_patch_header(&group_header);
+			LLPatchHeader ph;
+			S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+			while (1)
+			{
+				decode_patch_header(bitpack, &ph);
+				if (ph.quant_wbits == END_OF_PATCHES)
+				{
+					break;
+				}
+				decode_patch(bitpack, cpatch);
+				const S32 x = ph.patchids >> 5, y = ph.patchids & 0x1F;
+				decompress_patch(&per_patch[y*PATCH_SIZE*REGION_WIDTH + x*PATCH_SIZE], cpatch, &ph);
+			}
+		}
+	}
+	const F64 per_patch_time = timer.getElapsedTimeF64();
+	const bool per_patch_identical = max_difference(reference, per_patch) == 0.f;
+	std::cout << llformat("decompress_patch:   %8.2f us/patch, speedup %.2fx, %s",
+						  per_patch_time * 1.0e6 / patch_count, reference_time / per_patch_time,
+						  per_patch_identical ? "identical" : "DIFFERENT") << std::endl;
+
+	// Whole groups, copied into the heightfield as LLSurface does.
+	std::vector<F32> batched(REGION_WIDTH * REGION_WIDTH);
+	LLPatchGroup patch_group;
+	timer.reset();
+	for (S32 k = 0; k < iterations; k++)
+	{
+		for (Group& group : groups)
+		{
+			LLBitPack bitpack(&group.mData[0], group.mData.size());
+			decode_patch_group(bitpack, patch_group, false);
+			for (S32 p = 0; p < patch_group.getPatchCount(); p++)
+			{
+				const U32 patchids = patch_group.mPatchHeaders[p].patchids;
+				const S32 x = patchids >> 5, y = patchids & 0x1F;
+				const F32* values = patch_group.getPatchValues(p);
+				for (S32 j = 0; j < PATCH_SIZE; j++)
+				{
+					memcpy(&batched[(y*PATCH_SIZE + j)*REGION_WIDTH + x*PATCH_SIZE], values + j*PATCH_SIZE, PATCH_SIZE*sizeof(F32));
+				}
+			}
+		}
+	}
+	const F64 batched_time = timer.getElapsedTimeF64();
+	const bool batched_identical = max_difference(reference, batched) == 0.f;
+	std::cout << llformat("decode_patch_group: %8.2f us/patch, speedup %.2fx, %s",
+						  batched_time * 1.0e6 / patch_count, reference_time / batched_time,
+						  batched_identical ? "identical" : "DIFFERENT") << std::endl;
+
+	// The IDCT alone, without the bit unpacking.
+	std::vector<LLPatchHeader> headers;
+	std::vector<S32> coefficients;
+	for (Group& group : groups)
+	{
+		LLBitPack bitpack(&group.mData[0], group.mData.size());
+		LLGroupHeader group_header;
+		decode_patch_group_header(bitpack, &group_header);
+		LLPatchHeader ph;
+		while (1)
+		{
+			decode_patch_header(bitpack, &ph);
+			if (ph.quant_wbits == END_OF_PATCHES)
+			{
+				break;
+			}
+			headers.push_back(ph);
+			coefficients.resize(coefficients.size() + PATCH_SIZE*PATCH_SIZE);
+			decode_patch(bitpack, &coefficients[coefficients.size() - PATCH_SIZE*PATCH_SIZE]);
+		}
+	}
+	F32 values[PATCH_SIZE*PATCH_SIZE];
+	timer.reset();
+	for (S32 k = 0; k < iterations; k++)
+	{
+		for (size_t p = 0; p < headers.size(); p++)
+		{
+			reference_decompressor.decompress(values, PATCH_SIZE, &coefficients[p*PATCH_SIZE*PATCH_SIZE], headers[p]);
+		}
+	}
+	const F64 reference_idct_time = timer.getElapsedTimeF64();
+	timer.reset();
+	for (S32 k = 0; k < iterations; k++)
+	{
+		for (size_t p = 0; p < headers.size(); p++)
+		{
+			decompress_patch_values(values, PATCH_SIZE, &coefficients[p*PATCH_SIZE*PATCH_SIZE], &headers[p], PATCH_SIZE);
+		}
+	}
+	const F64 idct_time = timer.getElapsedTimeF64();
+	std::cout << llformat("IDCT only:          %8.2f us/patch scalar, %.2f us/patch SSE2, speedup %.2fx",
+						  reference_idct_time * 1.0e6 / patch_count, idct_time * 1.0e6 / patch_count,
+						  reference_idct_time / idct_time) << std::endl;
+
+	return per_patch_identical && batched_identical ? 0 : 1;
+}
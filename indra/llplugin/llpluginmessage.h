@@ -85,11 +85,14 @@ public:
 	// get the value of a key as a pointer.
 	void* getValuePointer(const std::string &key) const;
 
-	// Flatten the message into a string
-	std::string generate(void) const;
+	// Flatten the message into a string.
+	// Binary LLSD is much cheaper to write and read than XML, but it holds null characters,
+	// so it may only go to a pipe that frames it (and to a peer that asked for it).
+	std::string generate(bool binary = false) const;
 
 	// Parse an incoming message into component parts
 	// (this clears out all existing state before starting the parse)
+	// Accepts both formats generate() writes.
 	// Returns -1 on failure, otherwise returns the number of key/value pairs in the message.
 	int parse(const std::string &message);
 
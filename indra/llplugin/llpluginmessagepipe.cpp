@@ -34,10 +34,15 @@
 #include "llapr.h"
 
 static const char MESSAGE_DELIMITER = '\0';
+// Starts a binary message; XML messages start with '<'.
+static const char BINARY_MESSAGE_MARKER = '\1';
+// The marker, followed by the length of the message (big endian).
+static const size_t BINARY_MESSAGE_HEADER_SIZE = 5;
 
 LLPluginMessagePipeOwner::LLPluginMessagePipeOwner() :
 	mMessagePipe(NULL),
-	mSocketError(APR_SUCCESS)
+	mSocketError(APR_SUCCESS),
+	mBinaryMessages(false)
 {
 }
 
@@ -66,16 +71,16 @@ bool LLPluginMessagePipeOwner::canSendMessage(void)
 	return (mMessagePipe != NULL);
 }
 
-bool LLPluginMessagePipeOwner::writeMessageRaw(const std::string &message)
+bool LLPluginMessagePipeOwner::writeMessageRaw(const std::string &message, bool binary)
 {
 	bool result = true;
 	if(mMessagePipe != NULL)
 	{
-		result = mMessagePipe->addMessage(message);
+		result = mMessagePipe->addMessage(message, binary);
 	}
 	else
 	{
-		LL_WARNS("Plugin") << "dropping message: " << message << LL_ENDL;
+		LL_WARNS("Plugin") << "dropping message: " << (binary ? "(binary)" : message) << LL_ENDL;
 		result = false;
 	}
 	
@@ -117,13 +122,24 @@ LLPluginMessagePipe::~LLPluginMessagePipe()
 	}
 }
 
-bool LLPluginMessagePipe::addMessage(const std::string &message)
+bool LLPluginMessagePipe::addMessage(const std::string &message, bool binary)
 {
 	// queue the message for later output
 	//LLMutexLock lock(&mOutputMutex);
 	mOutputMutex.lock();
-	mOutput += message;
-	mOutput += MESSAGE_DELIMITER;	// message separator
+	if (binary)
+	{
+		U32 size = message.size();
+		char header[BINARY_MESSAGE_HEADER_SIZE] =
+			{ BINARY_MESSAGE_MARKER, (char)(size >> 24), (char)(size >> 16), (char)(size >> 8), (char)size };
+		mOutput.append(header, BINARY_MESSAGE_HEADER_SIZE);
+		mOutput += message;
+	}
+	else
+	{
+		mOutput += message;
+		mOutput += MESSAGE_DELIMITER;	// message separator
+	}
 	mOutputMutex.unlock();
 	return true;
 }
@@ -281,7 +297,8 @@ bool LLPluginMessagePipe::pumpInput(F64 timeout)
 		// Check for incoming messages
 		if(result)
 		{
-			char input_buf[1024];
+			// Large enough for most messages in one read.
+			char input_buf[8192];
 			apr_size_t request_size;
 			
 			if(timeout == 0.0f)
@@ -385,19 +402,46 @@ bool LLPluginMessagePipe::pumpInput(F64 timeout)
 
 void LLPluginMessagePipe::processInput(void)
 {
-	// Look for input delimiter(s) in the input buffer.
-	int delim;
+	// Look for complete messages in the input buffer.
 	mInputMutex.lock();
-	while((delim = mInput.find(MESSAGE_DELIMITER)) != std::string::npos)
-	{	
+	while(!mInput.empty())
+	{
+		size_t start, size, consumed;
+		if (mInput[0] == BINARY_MESSAGE_MARKER)
+		{
+			if (mInput.size() < BINARY_MESSAGE_HEADER_SIZE)
+			{
+				break;
+			}
+			const U8* header = (const U8*)mInput.data();
+			start = BINARY_MESSAGE_HEADER_SIZE;
+			size = (size_t)header[1] << 24 | (size_t)header[2] << 16 | (size_t)header[3] << 8 | header[4];
+			consumed = start + size;
+			if (mInput.size() < consumed)
+			{
+				break;
+			}
+		}
+		else
+		{
+			size_t delim = mInput.find(MESSAGE_DELIMITER);
+			if (delim == std::string::npos)
+			{
+				break;
+			}
+			start = 0;
+			size = delim;
+			consumed = delim + 1;
+		}
+
 		// Let the owner process this message
 		if (mOwner)
 		{
 			// Pull the message out of the input buffer before calling receiveMessageRaw.
 			// It's now possible for this function to get called recursively (in the case where the plugin makes a blocking request)
 			// and this guarantees that the messages will get dequeued correctly.
-			std::string message(mInput, 0, delim);
-			mInput.erase(0, delim + 1);
+			std::string message(mInput, start, size);
+			mInput.erase(0, consumed);
 			mInputMutex.unlock();
 			mOwner->receiveMessageRaw(message);
 			mInputMutex.lock();
@@ -405,6 +449,7 @@ void LLPluginMessagePipe::processInput(void)
 		else
 		{
 			LL_WARNS("Plugin") << "!mOwner" << LL_ENDL;
+			break;
 		}
 	}
 	mInputMutex.unlock();
@@ -53,8 +53,8 @@ public:
 protected:
 	// returns false if writeMessageRaw() would drop the message
 	bool canSendMessage(void);
-	// call this to send a message over the pipe
-	bool writeMessageRaw(const std::string &message);
+	// call this to send a message over the pipe (binary: message is binary LLSD, see LLPluginMessage::generate)
+	bool writeMessageRaw(const std::string &message, bool binary = false);
 	// call this to attempt to flush all messages for 10 seconds long.
 	bool flushMessages(void);
 	// call this to close the pipe
@@ -62,6 +62,8 @@ protected:
 	
 	LLPluginMessagePipe *mMessagePipe;
 	apr_status_t mSocketError;
+	// True once the other end said that it reads binary messages.
+	bool mBinaryMessages;
 };
 
 class LLPluginMessagePipe
@@ -71,7 +73,10 @@ public:
 	LLPluginMessagePipe(LLPluginMessagePipeOwner *owner, LLSocket::ptr_t socket);
 	virtual ~LLPluginMessagePipe();
 	
-	bool addMessage(const std::string &message);
+	// XML messages are sent null terminated, the way plugins always did; binary messages
+	// hold null characters, so they are sent behind a marker and their length instead.
+	// Input may hold both.
+	bool addMessage(const std::string &message, bool binary = false);
 	void clearOwner(void);
 	
 	bool pump(F64 timeout = 0.0f);
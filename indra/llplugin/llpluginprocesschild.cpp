@@ -131,8 +131,13 @@ void LLPluginProcessChild::idle(void)
 			break;
 			
 			case STATE_CONNECTED:
-				sendMessageToParent(LLPluginMessage(LLPLUGIN_MESSAGE_CLASS_INTERNAL, "hello"));
+			{
+				// Offer binary messages; older viewers ignore this and keep sending XML.
+				LLPluginMessage hello(LLPLUGIN_MESSAGE_CLASS_INTERNAL, "hello");
+				hello.setValueBoolean("binary_messages", true);
+				sendMessageToParent(hello);
 				setState(STATE_PLUGIN_LOADING);
+			}
 			break;
 						
 			case STATE_PLUGIN_LOADING:
@@ -310,12 +315,12 @@ void LLPluginProcessChild::sendMessageToPlugin(const LLPluginMessage &message)
 // This function is called by SLPlugin to send 'message' to the viewer (the parent process).
 void LLPluginProcessChild::sendMessageToParent(const LLPluginMessage &message)
 {
-	std::string buffer = message.generate();
+	std::string buffer = message.generate(mBinaryMessages);
 
-	LL_DEBUGS("Plugin") << "Sending to parent: " << buffer << LL_ENDL;
+	LL_DEBUGS("Plugin") << "Sending to parent: " << message << LL_ENDL;
 
 	// Write the serialized message to the pipe.
-	writeMessageRaw(buffer);
+	writeMessageRaw(buffer, mBinaryMessages);
 }
 
 // This is the SLPlugin process (the child process).
@@ -328,12 +333,12 @@ void LLPluginProcessChild::receiveMessageRaw(const std::string &message)
 {
 	// Incoming message from the TCP Socket
 
-	LL_DEBUGS("Plugin") << "Received from parent: " << message << LL_ENDL;
-
 	// Decode this message
 	LLPluginMessage parsed;
 	parsed.parse(message);
 
+	LL_DEBUGS("Plugin") << "Received from parent: " << parsed << LL_ENDL;
+
 	if(mBlockingRequest)
 	{
 		// We're blocking the plugin waiting for a response.
@@ -366,6 +371,8 @@ void LLPluginProcessChild::receiveMessageRaw(const std::string &message)
 			{
 				mPluginFile = parsed.getValue("file");
 				mPluginDir = parsed.getValue("dir");
+				// The parent reads binary messages from now on.
+				mBinaryMessages = parsed.hasValue("binary_messages") && parsed.getValueBoolean("binary_messages");
 			}
 			else if(message_name == "shm_add")
 			{
@@ -486,11 +493,12 @@ void LLPluginProcessChild::receivePluginMessage(const std::string &message)
 
 	// FIXME: how should we handle queueing here?
 	
+	// Decode this message
+	LLPluginMessage parsed;
+	parsed.parse(message);
+
 	// Intercept certain base messages (responses to ones sent by this class)
 	{
-		// Decode this message
-		LLPluginMessage parsed;
-		parsed.parse(message);
 		
 		if(parsed.hasValue("blocking_request"))
 		{
@@ -573,7 +581,15 @@ void LLPluginProcessChild::receivePluginMessage(const std::string &message)
 	if(passMessage)
 	{
 		LL_DEBUGS("Plugin") << "Passing through to parent: " << message << LL_ENDL;
-		writeMessageRaw(message);
+		if (mBinaryMessages)
+		{
+			// The plugin speaks XML, but it is already parsed: spare the parent parsing it again.
+			writeMessageRaw(parsed.generate(true), true);
+		}
+		else
+		{
+			writeMessageRaw(message);
+		}
 	}
 	
 	while(mBlockingRequest)
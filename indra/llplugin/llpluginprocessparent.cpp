@@ -45,6 +45,7 @@ LLPluginProcessParentOwner::~LLPluginProcessParentOwner()
 }
 
 bool LLPluginProcessParent::sUseReadThread = false;
+bool LLPluginProcessParent::sUseBinaryMessages = true;
 apr_pollset_t *LLPluginProcessParent::sPollSet = NULL;
 LLAPRPool LLPluginProcessParent::sPollSetPool;
 bool LLPluginProcessParent::sPollsetNeedsRebuild = false;
@@ -99,6 +100,7 @@ LLPluginProcessParent::LLPluginProcessParent(LLPluginProcessParentOwner *owner)
 	mBlocked = false;
 	mPolledInput = false;
 	mReceivedShutdown = false;
+	mPluginReadsBinary = false;
 	mPollFD.client_data = NULL;
 	mPollFDPool.create();
 
@@ -173,6 +175,8 @@ void LLPluginProcessParent::init(const std::string &launcher_filename, const std
 	mPluginDir = plugin_dir;
 	mCPUUsage = 0.0f;
 	mDebug = debug;	
+	mPluginReadsBinary = false;
+	mBinaryMessages = false;
 	setState(STATE_INITIALIZED);
 }
 
@@ -495,7 +499,15 @@ void LLPluginProcessParent::idle(void)
 					LLPluginMessage message(LLPLUGIN_MESSAGE_CLASS_INTERNAL, "load_plugin");
 					message.setValue("file", mPluginFile);
 					message.setValue("dir", mPluginDir);
+					// Plugins that did not offer binary messages ignore this and keep getting XML.
+					bool binary = sUseBinaryMessages && mPluginReadsBinary;
+					if (binary)
+					{
+						message.setValueBoolean("binary_messages", true);
+					}
 					sendMessage(message);
+					// Everything after load_plugin goes out binary; input is read in either format anyway.
+					mBinaryMessages = binary;
 				}
 
 				setState(STATE_LOADING);
@@ -629,18 +641,18 @@ void LLPluginProcessParent::sendMessage(const LLPluginMessage &message)
 		mBlocked = true;
 	}
 	
-	std::string buffer = message.generate();
+	std::string buffer = message.generate(mBinaryMessages);
 #if LL_DEBUG
 	if (message.getName() == "mouse_event")
 	{
-		LL_DEBUGS("PluginMouseEvent") << "Sending: " << buffer << LL_ENDL;
+		LL_DEBUGS("PluginMouseEvent") << "Sending: " << message << LL_ENDL;
 	}
 	else
 	{
-		LL_DEBUGS("Plugin") << "Sending: " << buffer << LL_ENDL;
+		LL_DEBUGS("Plugin") << "Sending: " << message << LL_ENDL;
 	}
 #endif
-	writeMessageRaw(buffer);
+	writeMessageRaw(buffer, mBinaryMessages);
 	
 	// Try to send message immediately.
 	if(mMessagePipe)
@@ -917,11 +929,11 @@ void LLPluginProcessParent::servicePoll()
 // It parses the message and passes it on to LLPluginProcessParent::receiveMessage.
 void LLPluginProcessParent::receiveMessageRaw(const std::string &message)
 {
-	LL_DEBUGS("PluginRaw") << "Received: " << message << LL_ENDL;
-	
 	LLPluginMessage parsed;
 	if(parsed.parse(message) != -1)
 	{
+		LL_DEBUGS("PluginRaw") << "Received: " << parsed << LL_ENDL;
+
 		if(parsed.hasValue("blocking_request"))
 		{
 			mBlocked = true;
@@ -993,6 +1005,7 @@ void LLPluginProcessParent::receiveMessage(const LLPluginMessage &message)
 			if(mState == STATE_CONNECTED)
 			{
 				// Plugin host has launched.  Tell it which plugin to load.
+				mPluginReadsBinary = message.hasValue("binary_messages") && message.getValueBoolean("binary_messages");
 				setState(STATE_HELLO);
 			}
 			else
@@ -125,6 +125,8 @@ public:
 	static bool canPollThreadRun() { return (sPollSet || sPollsetNeedsRebuild || sUseReadThread); };
 	static void setUseReadThread(bool use_read_thread);
 	static bool getUseReadThread() { return sUseReadThread; };
+	// Plugins that offer binary messages get them from the next launch on.
+	static void setUseBinaryMessages(bool use_binary_messages) { sUseBinaryMessages = use_binary_messages; };
 private:
 
 	enum EState
@@ -179,6 +181,7 @@ private:
 	bool mBlocked;
 	bool mPolledInput;
 	bool mReceivedShutdown;
+	bool mPluginReadsBinary;		// The hello message offered binary messages.
 
 	LLProcessLauncher mDebugger;
 	
@@ -186,6 +189,7 @@ private:
 	F32 mPluginLockupTimeout;		// If we don't receive a heartbeat in this many seconds, we declare the plugin locked up.
 
 	static bool sUseReadThread;
+	static bool sUseBinaryMessages;
 	apr_pollfd_t mPollFD;
 	LLAPRPool mPollFDPool;
 	static apr_pollset_t *sPollSet;
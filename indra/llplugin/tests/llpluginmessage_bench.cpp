@@ -0,0 +1,289 @@
+/**
+ * @file llpluginmessage_bench.cpp
+ * @brief Plugin message throughput between a parent and a stub child process, XML against binary LLSD.
+ *
+ * Usage: llpluginmessage_bench [messages] [port]
+ *
+ * The parent listens on 127.0.0.1 (port 61917 by default) and launches itself
+ * as the child, which connects back and echoes every message in the format it
+ * came in, the way SLPlugin answers the viewer. The parent streams mouse
+ * events, texture updates and cookie syncs through LLPluginMessagePipe with at
+ * most 64 of them outstanding, and parses every echo; once as XML, and once as
+ * binary LLSD. Every echo must hold what was sent. Serializing and parsing
+ * alone is also timed, without the sockets.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "llhost.h"
+#include "llpluginmessage.h"
+#include "llpluginmessageclasses.h"
+#include "llpluginmessagepipe.h"
+#include "llprocesslauncher.h"
+#include "lltimer.h"
+
+#include <iostream>
+
+static const U32 DEFAULT_PORT = 61917;
+static const S32 MAX_OUTSTANDING = 64;
+static const F64 CONNECT_TIMEOUT = 10.0;
+
+// The messages a media surface keeps exchanging with its plugin.
+static LLPluginMessage make_message(S32 i)
+{
+	switch (i % 4)
+	{
+		case 0:
+		case 1:
+		{
+			LLPluginMessage message(LLPLUGIN_MESSAGE_CLASS_MEDIA, "mouse_event");
+			message.setValue("event", "move");
+			message.setValueS32("button", 0);
+			message.setValueS32("x", i % 1024);
+			message.setValueS32("y", (i * 7) % 1024);
+			message.setValue("modifiers", "");
+			return message;
+		}
+		case 2:
+		{
+			LLPluginMessage message(LLPLUGIN_MESSAGE_CLASS_MEDIA, "updated");
+			message.setValueS32("left", 0);
+			message.setValueS32("top", i % 512);
+			message.setValueS32("right", 1024);
+			message.setValueS32("bottom", i % 512 + 16);
+			message.setValueReal("current_time", i * 0.016);
+			return message;
+		}
+		default:
+		{
+			LLPluginMessage message(LLPLUGIN_MESSAGE_CLASS_MEDIA_BROWSER, "set_cookies");
+			message.setValue("cookies", llformat("session_id=%08x%08x%08x%08x; Domain=.secondlife.com; Path=/; "
+												 "Expires=Wed, 13 Jan 2021 22:23:01 GMT; Secure; HttpOnly", i, i * 3, i * 5, i * 7));
+			return message;
+		}
+	}
+}
+
+class BenchPipeOwner : public LLPluginMessagePipeOwner
+{
+public:
+	BenchPipeOwner() : mReceived(0), mQuit(false) { }
+
+	void send(const LLPluginMessage& message, bool binary)
+	{
+		writeMessageRaw(message.generate(binary), binary);
+	}
+
+	bool pump(F64 timeout)
+	{
+		return mMessagePipe && mMessagePipe->pump(timeout) && mSocketError == APR_SUCCESS;
+	}
+
+	S32 mReceived;
+	bool mQuit;
+};
+
+// Echoes what it gets, as SLPlugin would answer.
+class StubChild : public BenchPipeOwner
+{
+public:
+	/*virtual*/ void receiveMessageRaw(const std::string& raw)
+	{
+		LLPluginMessage message;
+		message.parse(raw);
+		++mReceived;
+		if (message.getClass() == LLPLUGIN_MESSAGE_CLASS_INTERNAL && message.getName() == "quit")
+		{
+			mQuit = true;
+			return;
+		}
+		send(message, !raw.empty() && raw[0] == '{');
+	}
+};
+
+// Checks the echoes against what it sent.
+class BenchParent : public BenchPipeOwner
+{
+public:
+	BenchParent() : mErrors(0) { }
+
+	/*virtual*/ void receiveMessageRaw(const std::string& raw)
+	{
+		LLPluginMessage message;
+		if (message.parse(raw) == -1)
+		{
+			++mErrors;
+		}
+		else
+		{
+			const LLPluginMessage expected = make_message(mReceived);
+			if (message.getName() != expected.getName() ||
+				(expected.hasValue("y") && message.getValueS32("y") != expected.getValueS32("y")) ||
+				(expected.hasValue("cookies") && message.getValue("cookies") != expected.getValue("cookies")))
+			{
+				++mErrors;
+			}
+		}
+		++mReceived;
+	}
+
+	S32 mErrors;
+};
+
+static int run_child(U32 port)
+{
+	LLSocket::ptr_t socket = LLSocket::create(LLSocket::STREAM_TCP);
+	if (!socket || !socket->blockingConnect(LLHost("127.0.0.1", port)))
+	{
+		std::cerr << "child: could not connect to port " << port << std::endl;
+		return 1;
+	}
+	StubChild child;
+	new LLPluginMessagePipe(&child, socket);
+	while (!child.mQuit && child.pump(0.01))
+	{
+	}
+	return 0;
+}
+
+// Streams num_messages messages through the child, returns the seconds it took.
+static F64 stream(BenchParent& parent, S32 num_messages, bool binary, U64& bytes)
+{
+	parent.mReceived = 0;
+	bytes = 0;
+	LLTimer timer;
+	S32 sent = 0;
+	while (parent.mReceived < num_messages)
+	{
+		while (sent < num_messages && sent - parent.mReceived < MAX_OUTSTANDING)
+		{
+			const LLPluginMessage message = make_message(sent++);
+			bytes += message.generate(binary).size();
+			parent.send(message, binary);
+		}
+		if (!parent.pump(0.001))
+		{
+			std::cerr << "parent: lost the child" << std::endl;
+			return -1.0;
+		}
+	}
+	return timer.getElapsedTimeF64();
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc > 2 && std::string(argv[1]) == "child")
+	{
+		return run_child(atoi(argv[2]));
+	}
+
+	const S32 num_messages = argc > 1 ? atoi(argv[1]) : 100000;
+	const U32 port = argc > 2 ? atoi(argv[2]) : DEFAULT_PORT;
+
+	// Serializing and parsing alone.
+	F64 codec_time[2];
+	for (S32 binary = 0; binary < 2; ++binary)
+	{
+		LLTimer timer;
+		for (S32 i = 0; i < num_messages; ++i)
+		{
+			LLPluginMessage parsed;
+			parsed.parse(make_message(i).generate(binary != 0));
+		}
+		codec_time[binary] = timer.getElapsedTimeF64();
+	}
+
+	LLSocket::ptr_t listen_socket = LLSocket::create(LLSocket::STREAM_TCP, port);
+	if (!listen_socket)
+	{
+		std::cerr << "could not listen on port " << port << std::endl;
+		return 1;
+	}
+
+	LLProcessLauncher child;
+	child.setExecutable(argv[0]);
+	child.addArgument("child");
+	child.addArgument(llformat("%u", port));
+	if (child.launch() != 0)
+	{
+		std::cerr << "could not launch " << argv[0] << std::endl;
+		return 1;
+	}
+
+	LLSocket::ptr_t socket;
+	LLTimer connect_timer;
+	while (!socket && connect_timer.getElapsedTimeF64() < CONNECT_TIMEOUT)
+	{
+		apr_status_t status;
+		socket = LLSocket::create(status, listen_socket);
+		if (!socket)
+		{
+			ms_sleep(10);
+		}
+	}
+	if (!socket)
+	{
+		std::cerr << "the child did not connect" << std::endl;
+		return 1;
+	}
+
+	BenchParent parent;
+	new LLPluginMessagePipe(&parent, socket);
+
+	U64 bytes[2];
+	F64 stream_time[2];
+	for (S32 binary = 0; binary < 2; ++binary)
+	{
+		stream_time[binary] = stream(parent, num_messages, binary != 0, bytes[binary]);
+		if (stream_time[binary] < 0.0)
+		{
+			return 1;
+		}
+	}
+
+	LLPluginMessage quit(LLPLUGIN_MESSAGE_CLASS_INTERNAL, "quit");
+	parent.send(quit, false);
+	parent.pump(0.0);
+
+	static const char* const FORMATS[] = { "XML", "binary" };
+	for (S32 binary = 0; binary < 2; ++binary)
+	{
+		std::cout << llformat("%-6s %7.0f messages/s round trip, %5.1f bytes/message, generate+parse %.2fus/message",
+							  FORMATS[binary], num_messages / stream_time[binary], (F64)bytes[binary] / num_messages,
+							  codec_time[binary] * 1000000.0 / num_messages) << std::endl;
+	}
+	if (parent.mErrors)
+	{
+		std::cerr << parent.mErrors << " echoes did not match what was sent" << std::endl;
+	}
+
+	return parent.mErrors ? 1 : 0;
+}
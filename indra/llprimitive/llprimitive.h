@@ -415,13 +415,18 @@ public:
 
 	void copyTEs(const LLPrimitive *primitive);
 	S32 packTEField(U8 *cur_ptr, U8 *data_ptr, U8 data_size, U8 last_face_index, EMsgVariableType type) const;
-	S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
+	static S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
 	BOOL packTEMessage(LLMessageSystem *mesgsys) const;
 	BOOL packTEMessage(LLDataPacker &dp) const;
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num); // Variable num of blocks
 	BOOL unpackTEMessage(LLDataPacker &dp);
 	S32 parseTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num, LLTEContents& tec);
-	S32 applyParsedTEMessage(LLTEContents& tec);
+	// Parses a TextureEntry block for as many faces as it may hold. It does
+	// not look at any primitive, so it can run on any thread; false when the
+	// block is bad.
+	static bool parseTEMessage(LLDataPacker &dp, LLTEContents& tec);
+	// Applies the parsed faces the primitive has.
+	S32 applyParsedTEMessage(const LLTEContents& tec);
 	
 #ifdef CHECK_FOR_FINITE
 	inline void setPosition(const LLVector3& pos);
@@ -506,6 +511,10 @@ protected:
 	U32 				mMiscFlags;			// home for misc bools
 
 	static LLVolumeMgr* sVolumeManager;
+
+private:
+	// Unpacks the fields of tec.packed_buffer for tec.face_count faces.
+	static void unpackTEFields(LLTEContents& tec);
 public:
 	enum
 	{
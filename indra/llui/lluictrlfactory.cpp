@@ -70,6 +70,7 @@
 #include "llui.h"
 #include "lluiimage.h"
 #include "llviewborder.h"
+#include "llxuicache.h"
 
 LLTrace::BlockTimerStatHandle FTM_WIDGET_CONSTRUCTION("Widget Construction");
 LLTrace::BlockTimerStatHandle FTM_INIT_FROM_PARAMS("Widget InitFromParams");
@@ -189,14 +190,21 @@ bool LLUICtrlFactory::getLayeredXMLNode(const std::string &xui_filename, LLXMLNo
 		}
 	}
 
+	std::vector<std::string> paths =
+	gDirUtilp->findSkinnedFilenames(LLDir::XUI, xui_filename);
+
+	std::vector<std::string> files(1, full_filename);
+	files.insert(files.end(), paths.begin(), paths.end());
+	if (LLXUICache::get(xui_filename, files, root))
+	{
+		return true;
+	}
+
 	if (!LLXMLNode::parseFile(full_filename, root, NULL))
 	{
 		LL_WARNS() << "Problem reading UI description file: " << full_filename << LL_ENDL;
 		return false;
 	}
-	
-	std::vector<std::string> paths =
-	gDirUtilp->findSkinnedFilenames(LLDir::XUI, xui_filename);
 
 	for ( auto& layer_filename : paths )
 	{
@@ -218,6 +226,7 @@ bool LLUICtrlFactory::getLayeredXMLNode(const std::string &xui_filename, LLXMLNo
 		}
 	}
 
+	LLXUICache::add(xui_filename, files, root);
 	return true;
 }
 
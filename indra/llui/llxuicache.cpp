@@ -0,0 +1,295 @@
+/**
+ * @file llxuicache.cpp
+ * @brief Parsed XUI files, kept to build floaters and panels without parsing.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llxuicache.h"
+
+#include <sstream>
+
+#include "lldir.h"
+#include "llfile.h"
+#include "llformat.h"
+
+// static
+LLXUICache::entry_map_t LLXUICache::sEntries;
+// static
+bool LLXUICache::sChanged = false;
+
+namespace
+{
+	const char CACHE_MAGIC[4] = { 'X', 'U', 'I', 'C' };
+	// Bump when the layout of the file or the binary form of LLXMLNode changes.
+	const U32 CACHE_VERSION = 1;
+	const U32 MAX_CACHE_STRING = 1 << 24;
+	// A base file and its localized layers, in every skin that may override them.
+	const U32 MAX_SOURCE_FILES = 64;
+
+	void write_value(std::ostream& output, U32 value)
+	{
+		output.write((const char*)&value, sizeof(value));
+	}
+
+	void write_value(std::ostream& output, U64 value)
+	{
+		output.write((const char*)&value, sizeof(value));
+	}
+
+	void write_value(std::ostream& output, const std::string& value)
+	{
+		write_value(output, (U32)value.size());
+		output.write(value.data(), value.size());
+	}
+
+	// Reads the cache file out of memory; every read fails past the end.
+	class CacheReader
+	{
+	public:
+		CacheReader(const std::string& data) : mPos(data.data()), mEnd(data.data() + data.size()) {}
+
+		template<typename T>
+		bool read(T& value)
+		{
+			if ((size_t)(mEnd - mPos) < sizeof(T))
+			{
+				return false;
+			}
+			memcpy(&value, mPos, sizeof(T));
+			mPos += sizeof(T);
+			return true;
+		}
+
+		bool read(std::string& value)
+		{
+			U32 length;
+			if (!read(length) || length > MAX_CACHE_STRING || length > (size_t)(mEnd - mPos))
+			{
+				return false;
+			}
+			value.assign(mPos, length);
+			mPos += length;
+			return true;
+		}
+
+		bool atEnd() const	{ return mPos == mEnd; }
+
+	private:
+		const char* mPos;
+		const char* mEnd;
+	};
+}
+
+// static
+bool LLXUICache::statFile(const std::string& name, SourceFile& file)
+{
+	llstat status;
+	if (LLFile::stat(name, &status))
+	{
+		return false;
+	}
+	file.mName = name;
+	file.mSize = (U64)status.st_size;
+	file.mModified = (S64)status.st_mtime;
+	return true;
+}
+
+// static
+bool LLXUICache::isCurrent(const Entry& entry, const std::vector<std::string>& files)
+{
+	if (entry.mFiles.size() != files.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const SourceFile& cached = entry.mFiles[i];
+		SourceFile current;
+		if (cached.mName != files[i] || !statFile(files[i], current) ||
+			current.mSize != cached.mSize || current.mModified != cached.mModified)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// static
+bool LLXUICache::get(const std::string& xui_filename, const std::vector<std::string>& files, LLXMLNodePtr& root)
+{
+	entry_map_t::iterator it = sEntries.find(xui_filename);
+	if (it == sEntries.end())
+	{
+		return false;
+	}
+	Entry& entry = it->second;
+	if (!isCurrent(entry, files))
+	{
+		sEntries.erase(it);
+		sChanged = true;
+		return false;
+	}
+	if (entry.mRoot.isNull() &&
+		!LLXMLNode::readBinary((const U8*)entry.mBinary.data(), (U32)entry.mBinary.size(), entry.mRoot))
+	{
+		LL_WARNS() << "Discarding the corrupt cached tree of " << xui_filename << LL_ENDL;
+		sEntries.erase(it);
+		sChanged = true;
+		return false;
+	}
+	// Whoever builds from the tree may change it.
+	root = entry.mRoot->deepCopy();
+	return true;
+}
+
+// static
+void LLXUICache::add(const std::string& xui_filename, const std::vector<std::string>& files, LLXMLNodePtr root)
+{
+	Entry entry;
+	entry.mFiles.resize(files.size());
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!statFile(files[i], entry.mFiles[i]))
+		{
+			return;
+		}
+	}
+	entry.mRoot = root->deepCopy();
+	sEntries[xui_filename] = entry;
+	sChanged = true;
+}
+
+// static
+void LLXUICache::clear()
+{
+	sEntries.clear();
+	sChanged = false;
+}
+
+// static
+std::string LLXUICache::getCacheFilename()
+{
+	const std::string name = llformat("xui_%s_%s.cache", gDirUtilp->getSkinFolder().c_str(),
+									  gDirUtilp->getLanguage().c_str());
+	return gDirUtilp->getExpandedFilename(LL_PATH_CACHE, LLDir::getScrubbedFileName(name));
+}
+
+// static
+bool LLXUICache::loadFromFile(const std::string& filename)
+{
+	llifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	const std::string data = contents.str();
+
+	CacheReader reader(data);
+	char magic[sizeof(CACHE_MAGIC)];
+	U32 version, num_entries;
+	if (!reader.read(magic) || memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) ||
+		!reader.read(version) || version != CACHE_VERSION || !reader.read(num_entries))
+	{
+		LL_INFOS() << "Ignoring the XUI cache file " << filename << " of another version" << LL_ENDL;
+		return false;
+	}
+
+	U32 num_read = 0;
+	for ( ; num_read < num_entries; ++num_read)
+	{
+		std::string xui_filename;
+		U32 num_files;
+		if (!reader.read(xui_filename) || !reader.read(num_files) || num_files > MAX_SOURCE_FILES)
+		{
+			break;
+		}
+		Entry entry;
+		entry.mFiles.resize(num_files);
+		bool ok = true;
+		for (U32 f = 0; f < num_files && ok; ++f)
+		{
+			SourceFile& source = entry.mFiles[f];
+			ok = reader.read(source.mName) && reader.read(source.mSize) && reader.read(source.mModified);
+		}
+		if (!ok || !reader.read(entry.mBinary))
+		{
+			break;
+		}
+		// Trees parsed in this session are newer.
+		sEntries.insert(std::make_pair(xui_filename, entry));
+	}
+	if (num_read != num_entries || !reader.atEnd())
+	{
+		LL_WARNS() << "Read " << num_read << " of " << num_entries << " trees from the corrupt XUI cache file " << filename << LL_ENDL;
+		sChanged = true;
+	}
+	return true;
+}
+
+// static
+bool LLXUICache::saveToFile(const std::string& filename)
+{
+	if (!sChanged)
+	{
+		return true;
+	}
+
+	std::ostringstream output;
+	output.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	write_value(output, CACHE_VERSION);
+	write_value(output, (U32)sEntries.size());
+	for (entry_map_t::iterator it = sEntries.begin(); it != sEntries.end(); ++it)
+	{
+		Entry& entry = it->second;
+		if (entry.mBinary.empty())
+		{
+			std::ostringstream binary;
+			entry.mRoot->writeBinary(binary);
+			entry.mBinary = binary.str();
+		}
+		write_value(output, it->first);
+		write_value(output, (U32)entry.mFiles.size());
+		for (std::vector<SourceFile>::const_iterator file = entry.mFiles.begin(); file != entry.mFiles.end(); ++file)
+		{
+			write_value(output, file->mName);
+			write_value(output, file->mSize);
+			write_value(output, (U64)file->mModified);
+		}
+		write_value(output, entry.mBinary);
+	}
+
+	llofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LL_WARNS() << "Could not write the XUI cache file " << filename << LL_ENDL;
+		return false;
+	}
+	const std::string data = output.str();
+	file.write(data.data(), data.size());
+	sChanged = false;
+	return true;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file llxuicache.h
+ * @brief Parsed XUI files, kept to build floaters and panels without parsing.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLXUICACHE_H
+#define LL_LLXUICACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llxmlnode.h"
+
+// The trees of the XUI files that LLUICtrlFactory::getLayeredXMLNode() read,
+// each layered from its base and localized files. A tree is handed out again,
+// as a copy, for as long as the files it was layered from are the same and
+// none of them changed size or modification time; a new skin or language
+// layers from other files, which misses.
+//
+// The trees can be kept in a cache file between sessions, in the binary form
+// of LLXMLNode. Trees read from the file are decoded the first time they are
+// asked for.
+class LLXUICache
+{
+public:
+	// Sets root to a copy of the tree cached for xui_filename, if it was
+	// layered from exactly these files and they have not changed since.
+	static bool get(const std::string& xui_filename, const std::vector<std::string>& files, LLXMLNodePtr& root);
+
+	// Caches a copy of root, layered from files, for xui_filename.
+	static void add(const std::string& xui_filename, const std::vector<std::string>& files, LLXMLNodePtr root);
+
+	static void clear();
+
+	// The cache file of the current skin and language.
+	static std::string getCacheFilename();
+
+	// Adds the trees of a cache file, keeping those already cached.
+	static bool loadFromFile(const std::string& filename);
+	// Writes the cache file, if anything was added since it was loaded.
+	static bool saveToFile(const std::string& filename);
+
+private:
+	struct SourceFile
+	{
+		std::string mName;
+		U64 mSize;
+		S64 mModified;
+	};
+
+	struct Entry
+	{
+		std::vector<SourceFile> mFiles;
+		LLXMLNodePtr mRoot;		// NULL until mBinary is decoded.
+		std::string mBinary;	// Empty until written to or read from the cache file.
+	};
+
+	static bool statFile(const std::string& name, SourceFile& file);
+	static bool isCurrent(const Entry& entry, const std::vector<std::string>& files);
+
+	typedef std::map<std::string, Entry> entry_map_t;
+	static entry_map_t sEntries;
+	static bool sChanged;
+};
+
+#endif // LL_LLXUICACHE_H
@@ -29,17 +29,23 @@
 #include "llvfs.h"
 
 #include <sys/stat.h>
+#include <algorithm>
 #include <set>
 #include <map>
+#include <vector>
 #if LL_WINDOWS
 #include <share.h>
+#include <io.h>
+#include "llwin32headerslean.h"
 #elif LL_SOLARIS
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
 #else
 #include <sys/file.h>
+#include <unistd.h>
 #endif
+#include <errno.h>
     
 #include "llstl.h"
 #include "lltimer.h"
@@ -113,7 +119,7 @@ void LLVFSFileBlock::init()
 {
 	mSize = 0;
 	mIndexLocation = -1;
-	mAccessTime = (U32)time(NULL);
+	touch();
 
 	for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
 	{
@@ -161,7 +167,8 @@ void LLVFSFileBlock::serialize(U8 *buffer)
 	buffer += 4;
 	swizzleCopy(buffer, &mLength, 4);
 	buffer +=4;
-	swizzleCopy(buffer, &mAccessTime, 4);
+	U32 access_time = getAccessTime();
+	swizzleCopy(buffer, &access_time, 4);
 	buffer +=4;
 	memcpy(buffer, &mFileID.mData, 16); /* Flawfinder: ignore */
 	buffer += 16;
@@ -179,7 +186,9 @@ void LLVFSFileBlock::deserialize(U8 *buffer, const S32 index_loc)
 	buffer += 4;
 	swizzleCopy(&mLength, buffer, 4);
 	buffer += 4;
-	swizzleCopy(&mAccessTime, buffer, 4);
+	U32 access_time;
+	swizzleCopy(&access_time, buffer, 4);
+	mAccessTime.store(access_time, std::memory_order_relaxed);
 	buffer += 4;
 	memcpy(&mFileID.mData, buffer, 16);
 	buffer += 16;
@@ -193,21 +202,13 @@ void LLVFSFileBlock::deserialize(U8 *buffer, const S32 index_loc)
 BOOL LLVFSFileBlock::insertLRU(LLVFSFileBlock* const& first,
 					  LLVFSFileBlock* const& second)
 {
-	return (first->mAccessTime == second->mAccessTime)
+	const U32 first_time = first->getAccessTime();
+	const U32 second_time = second->getAccessTime();
+	return (first_time == second_time)
 		? *first < *second
-		: first->mAccessTime < second->mAccessTime;
+		: first_time < second_time;
 }
 
-// Helper structure for doing lru w/ stl... is there a simpler way?
-struct LLVFSFileBlock_less
-{
-	bool operator()(LLVFSFileBlock* const& lhs, LLVFSFileBlock* const& rhs) const
-	{
-		return (LLVFSFileBlock::insertLRU(lhs, rhs)) ? true : false;
-	}
-};
-
-
 const S32 LLVFSFileBlock::SERIAL_SIZE = 34;
      
 
@@ -216,8 +217,6 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 	mDataFP(NULL),
 	mIndexFP(NULL)
 {
-	mDataMutex = new LLMutex;
-
 	S32 i;
 	for (i = 0; i < VFSLOCK_COUNT; i++)
 	{
@@ -332,7 +331,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 				block->mFileType >= LLAssetType::AT_NONE &&
 				block->mFileType < LLAssetType::AT_COUNT)
 			{
-				mFileBlocks.insert(fileblock_map::value_type(*block, block));
+				getShard(*block).mFileBlocks.insert(fileblock_map::value_type(*block, block));
 				files_by_loc.push_back(block);
 			}
 			else
@@ -418,7 +417,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 						<< LL_ENDL;
 
 					// Duplicate entries.  Nuke them both for safety.
-					mFileBlocks.erase(*cur_file_block);	// remove ID/type entry
+					getShard(*cur_file_block).mFileBlocks.erase(*cur_file_block);	// remove ID/type entry
 					if (cur_file_block->mLength > 0)
 					{
 						// convert to hole
@@ -427,10 +426,8 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 								cur_file_block->mLocation,
 								cur_file_block->mLength));
 					}
-					lockData();						// needed for sync()
 					sync(cur_file_block, TRUE);		// remove first on disk
 					sync(last_file_block, TRUE);	// remove last on disk
-					unlockData();					// needed for sync()
 					last_file_block = cur_file_block;
 					++cur;
 					continue;
@@ -542,7 +539,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
     
 LLVFS::~LLVFS()
 {
-	if (mDataMutex->isLocked())
+	if (mAllocMutex.isLocked() || mIndexMutex.isLocked())
 	{
 		LL_ERRS("VFS") << "LLVFS destroyed with mutex locked" << LL_ENDL;
 	}
@@ -550,12 +547,15 @@ LLVFS::~LLVFS()
 	unlockAndClose(mIndexFP);
 	mIndexFP = NULL;
 
-	fileblock_map::const_iterator it;
-	for (it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
 	{
-		delete (*it).second;
+		fileblock_map& file_blocks = mShards[i].mFileBlocks;
+		for (fileblock_map::const_iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
+		{
+			delete (*it).second;
+		}
+		file_blocks.clear();
 	}
-	mFileBlocks.clear();
 	
 	mFreeBlocksByLength.clear();
 
@@ -570,8 +570,6 @@ LLVFS::~LLVFS()
 		std::string marker = mDataFilename + ".open";
 		LLFile::remove(marker);
 	}
-
-	delete mDataMutex;
 }
 
 
@@ -627,7 +625,8 @@ void LLVFS::presizeDataFile(const U32 size)
 	fseek(mDataFP, size-1, SEEK_SET);
 	S32 tmp = 0;
 	tmp = (S32)fwrite(&tmp, 1, 1, mDataFP);
-	// fflush(mDataFP);
+	// everything else goes through readData()/writeData(), past the stdio buffer
+	fflush(mDataFP);
 
 	// also remove any index, since this vfs is now blank
 	LLFile::remove(mIndexFilename);
@@ -642,95 +641,96 @@ void LLVFS::presizeDataFile(const U32 size)
 	}
 }
 
+// Readers store the access time under a read lock; two of them racing on it
+// is harmless, it is only used to order LRU eviction.
 BOOL LLVFS::getExists(const LLUUID &file_id, const LLAssetType::EType file_type)
 {
 	LLVFSFileBlock *block = NULL;
-		
+
 	if (!isValid())
 	{
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 	}
 
-	lockData();
-	
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.rdlock();
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		block = (*it).second;
-		block->mAccessTime = (U32)time(NULL);
+		block->touch();
 	}
 
 	BOOL res = (block && block->mLength > 0) ? TRUE : FALSE;
-	
-	unlockData();
-	
+
+	shard.mLock.rdunlock();
+
 	return res;
 }
-    
+
 S32	 LLVFS::getSize(const LLUUID &file_id, const LLAssetType::EType file_type)
 {
 	S32 size = 0;
-	
+
 	if (!isValid())
 	{
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 
 	}
 
-	lockData();
-	
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.rdlock();
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 
-		block->mAccessTime = (U32)time(NULL);
+		block->touch();
 		size = block->mSize;
 	}
 
-	unlockData();
-	
+	shard.mLock.rdunlock();
+
 	return size;
 }
-    
+
 S32  LLVFS::getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type)
 {
 	S32 size = 0;
-	
+
 	if (!isValid())
 	{
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 	}
 
-	lockData();
-	
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.rdlock();
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 
-		block->mAccessTime = (U32)time(NULL);
+		block->touch();
 		size = block->mLength;
 	}
 
-	unlockData();
+	shard.mLock.rdunlock();
 
 	return size;
 }
 
 BOOL LLVFS::checkAvailable(S32 max_size)
 {
-	lockData();
-	
-	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(max_size); // first entry >= size
-	const BOOL res(iter == mFreeBlocksByLength.end() ? FALSE : TRUE);
+	LLMutexLock lock(mAllocMutex);
 
-	unlockData();
-	
-	return res;
+	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(std::make_pair(max_size, 0U)); // first entry >= size
+	return iter == mFreeBlocksByLength.end() ? FALSE : TRUE;
 }
 
 BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size)
@@ -749,16 +749,6 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 		return FALSE;
 	}
 
-	lockData();
-	
-	LLVFSFileSpecifier spec(file_id, file_type);
-	LLVFSFileBlock *block = NULL;
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
-	{
-		block = (*it).second;
-	}
-    
 	// round all sizes upward to KB increments
 	// SJB: Need to not round for the new texture-pipeline code so we know the correct
 	//      max file size. Need to investigate the potential problems with this...
@@ -770,70 +760,89 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 			max_size &= ~FILE_BLOCK_MASK;
 		}
     }
-	
-	if (block && block->mLength > 0)
-	{    
-		block->mAccessTime = (U32)time(NULL);
-    
-		if (max_size == block->mLength)
+
+	LLVFSFileSpecifier spec(file_id, file_type);
+	Shard& shard = getShard(spec);
+
+	// Each pass either resizes the file or finds no free block large enough,
+	// in which case least recently used files are removed and it tries again.
+	while (1)
+	{
+		shard.mLock.wrlock();
+
+		LLVFSFileBlock *block = NULL;
+		fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+		if (it != shard.mFileBlocks.end())
 		{
-			unlockData();
-			return TRUE;
+			block = (*it).second;
 		}
-		else if (max_size < block->mLength)
+		const bool resizing = block && block->mLength > 0;
+
+		if (resizing)
 		{
-			// this file is shrinking
-			LLVFSBlock *free_block = new LLVFSBlock(block->mLocation + max_size, block->mLength - max_size);
+			block->touch();
 
-			addFreeBlock(free_block);
-    
-			block->mLength = max_size;
-    
-			if (block->mLength < block->mSize)
+			if (max_size == block->mLength)
 			{
-				// JC: Was a warning, but Ian says it's bad.
-				LL_ERRS() << "Truncating virtual file " << file_id << " to " << block->mLength << " bytes" << LL_ENDL;
-				block->mSize = block->mLength;
+				shard.mLock.wrunlock();
+				return TRUE;
+			}
+			else if (max_size < block->mLength)
+			{
+				// this file is shrinking
+				LLVFSBlock *free_block = new LLVFSBlock(block->mLocation + max_size, block->mLength - max_size);
+
+				mAllocMutex.lock();
+				addFreeBlock(free_block);
+				mAllocMutex.unlock();
+
+				block->mLength = max_size;
+
+				if (block->mLength < block->mSize)
+				{
+					// JC: Was a warning, but Ian says it's bad.
+					LL_ERRS() << "Truncating virtual file " << file_id << " to " << block->mLength << " bytes" << LL_ENDL;
+					block->mSize = block->mLength;
+				}
+
+				sync(block);
+				//mergeFreeBlocks();
+
+				shard.mLock.wrunlock();
+				return TRUE;
 			}
-    
-			sync(block);
-			//mergeFreeBlocks();
 
-			unlockData();
-			return TRUE;
-		}
-		else if (max_size > block->mLength)
-		{
 			// this file is growing
 			// first check for an adjacent free block to grow into
 			S32 size_increase = max_size - block->mLength;
 
+			mAllocMutex.lock();
+
 			// Find the first free block with and addres > block->mLocation
 			LLVFSBlock *free_block;
 			blocks_location_map_t::iterator iter = mFreeBlocksByLocation.upper_bound(block->mLocation);
 			if (iter != mFreeBlocksByLocation.end())
 			{
 				free_block = iter->second;
-			
+
 				if (free_block->mLocation == block->mLocation + block->mLength &&
 					free_block->mLength >= size_increase)
 				{
 					// this free block is at the end of the file and is large enough
-
-					// Must call useFreeSpace before sync(), as sync()
-					// unlocks data structures.
 					useFreeSpace(free_block, size_increase);
+					mAllocMutex.unlock();
+
 					block->mLength += size_increase;
 					sync(block);
 
-					unlockData();
+					shard.mLock.wrunlock();
 					return TRUE;
 				}
 			}
-			
+
 			// no adjecent free block, find one in the list
-			free_block = findFreeBlock(max_size, block);
-    
+			free_block = findFreeBlock(max_size);
+
 			if (free_block)
 			{
 				// Save location where data is going, useFreeSpace will move free_block->mLocation;
@@ -842,89 +851,92 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 				//mark the free block as used so it does not
 				//interfere with other operations such as addFreeBlock
 				useFreeSpace(free_block, max_size);		// useFreeSpace takes ownership (and may delete) free_block
+				mAllocMutex.unlock();
 
-				if (block->mLength > 0)
+				if (block->mSize > 0)
 				{
-					// create a new free block where this file used to be
-					LLVFSBlock *new_free_block = new LLVFSBlock(block->mLocation, block->mLength);
-
-					addFreeBlock(new_free_block);
-					
-					if (block->mSize > 0)
+					// move the file into the new block; the shard lock keeps
+					// readers of this file out until it is done
+					std::vector<U8> buffer(block->mSize);
+					if (readData(&buffer[0], block->mLocation, block->mSize) == block->mSize)
 					{
-						// move the file into the new block
-						std::vector<U8> buffer(block->mSize);
-						fseek(mDataFP, block->mLocation, SEEK_SET);
-						if (fread(&buffer[0], block->mSize, 1, mDataFP) == 1)
+						if (writeData(&buffer[0], new_data_location, block->mSize) != block->mSize)
 						{
-							fseek(mDataFP, new_data_location, SEEK_SET);
-							if (fwrite(&buffer[0], block->mSize, 1, mDataFP) != 1)
-							{
-								LL_WARNS() << "Short write" << LL_ENDL;
-							}
-						} else {
-							LL_WARNS() << "Short read" << LL_ENDL;
+							LL_WARNS() << "Short write" << LL_ENDL;
 						}
+					} else {
+						LL_WARNS() << "Short read" << LL_ENDL;
 					}
 				}
-    
+
+				// only now that the data has moved can the old space be reused
+				LLVFSBlock *new_free_block = new LLVFSBlock(block->mLocation, block->mLength);
+				mAllocMutex.lock();
+				addFreeBlock(new_free_block);
+				mAllocMutex.unlock();
+
 				block->mLocation = new_data_location;
-    
-				block->mLength = max_size;
 
+				block->mLength = max_size;
 
 				sync(block);
 
-				unlockData();
+				shard.mLock.wrunlock();
 				return TRUE;
 			}
-			else
+			mAllocMutex.unlock();
+		}
+		else
+		{
+			// find a free block in the list
+			mAllocMutex.lock();
+			LLVFSBlock *free_block = findFreeBlock(max_size);
+
+			if (free_block)
 			{
-				LL_WARNS() << "VFS: No space (" << max_size << ") to resize existing vfile " << file_id << LL_ENDL;
-				//dumpMap();
-				unlockData();
-				dumpStatistics();
-				return FALSE;
+				U32 location = free_block->mLocation;
+				useFreeSpace(free_block, max_size);
+				mAllocMutex.unlock();
+
+				if (block)
+				{
+					block->mLocation = location;
+					block->mLength = max_size;
+				}
+				else
+				{
+					// this file doesn't exist, create it
+					block = new LLVFSFileBlock(file_id, file_type, location, max_size);
+					shard.mFileBlocks.insert(fileblock_map::value_type(spec, block));
+				}
+
+				block->touch();
+
+				sync(block);
+
+				shard.mLock.wrunlock();
+				return TRUE;
 			}
+			mAllocMutex.unlock();
 		}
-	}
-	else
-	{
-		// find a free block in the list
-		LLVFSBlock *free_block = findFreeBlock(max_size);
-    
-		if (free_block)
-		{        
-			if (block)
+
+		shard.mLock.wrunlock();
+
+		if (!makeFreeSpace(max_size, spec))
+		{
+			if (resizing)
 			{
-				block->mLocation = free_block->mLocation;
-				block->mLength = max_size;
+				LL_WARNS() << "VFS: No space (" << max_size << ") to resize existing vfile " << file_id << LL_ENDL;
 			}
 			else
 			{
-				// this file doesn't exist, create it
-				block = new LLVFSFileBlock(file_id, file_type, free_block->mLocation, max_size);
-				mFileBlocks.insert(fileblock_map::value_type(spec, block));
+				LL_WARNS() << "VFS: No space (" << max_size << ") for new virtual file " << file_id << LL_ENDL;
 			}
-
-			// Must call useFreeSpace before sync(), as sync()
-			// unlocks data structures.
-			useFreeSpace(free_block, max_size);
-			block->mAccessTime = (U32)time(NULL);
-
-			sync(block);
-		}
-		else
-		{
-			LL_WARNS() << "VFS: No space (" << max_size << ") for new virtual file " << file_id << LL_ENDL;
 			//dumpMap();
-			unlockData();
 			dumpStatistics();
 			return FALSE;
 		}
 	}
-	unlockData();
-	return TRUE;
 }
 
 
@@ -942,28 +954,37 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 		LL_ERRS() << "Attempt to write to read-only VFS" << LL_ENDL;
 	}
 
-	lockData();
-	
 	LLVFSFileSpecifier new_spec(new_id, new_type);
 	LLVFSFileSpecifier old_spec(file_id, file_type);
-	
-	fileblock_map::iterator it = mFileBlocks.find(old_spec);
-	if (it != mFileBlocks.end())
+
+	// The file may change shard; lock both, lowest index first.
+	const S32 old_index = getShardIndex(old_spec);
+	const S32 new_index = getShardIndex(new_spec);
+	Shard& old_shard = mShards[old_index];
+	Shard& new_shard = mShards[new_index];
+	mShards[llmin(old_index, new_index)].mLock.wrlock();
+	if (old_index != new_index)
+	{
+		mShards[llmax(old_index, new_index)].mLock.wrlock();
+	}
+
+	fileblock_map::iterator it = old_shard.mFileBlocks.find(old_spec);
+	if (it != old_shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *src_block = (*it).second;
 
 		// this will purge the data but leave the file block in place, w/ locks, if any
 		// WAS: removeFile(new_id, new_type); NOW uses removeFileBlock() to avoid mutex lock recursion
-		fileblock_map::iterator new_it = mFileBlocks.find(new_spec);
-		if (new_it != mFileBlocks.end())
+		fileblock_map::iterator new_it = new_shard.mFileBlocks.find(new_spec);
+		if (new_it != new_shard.mFileBlocks.end())
 		{
 			LLVFSFileBlock *new_block = (*new_it).second;
 			removeFileBlock(new_block);
 		}
-		
+
 		// if there's something in the target location, remove it but inherit its locks
-		it = mFileBlocks.find(new_spec);
-		if (it != mFileBlocks.end())
+		it = new_shard.mFileBlocks.find(new_spec);
+		if (it != new_shard.mFileBlocks.end())
 		{
 			LLVFSFileBlock *dest_block = (*it).second;
 
@@ -975,17 +996,17 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 				}
 				dest_block->mLocks[i] = src_block->mLocks[i];
 			}
-			
-			mFileBlocks.erase(new_spec);
+
+			new_shard.mFileBlocks.erase(new_spec);
 			delete dest_block;
 		}
 
 		src_block->mFileID = new_id;
 		src_block->mFileType = new_type;
-		src_block->mAccessTime = (U32)time(NULL);
-   
-		mFileBlocks.erase(old_spec);
-		mFileBlocks.insert(fileblock_map::value_type(new_spec, src_block));
+		src_block->touch();
+
+		old_shard.mFileBlocks.erase(old_spec);
+		new_shard.mFileBlocks.insert(fileblock_map::value_type(new_spec, src_block));
 
 		sync(src_block);
 	}
@@ -993,24 +1014,31 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 	{
 		LL_WARNS() << "VFS: Attempt to rename nonexistent vfile " << file_id << ":" << file_type << LL_ENDL;
 	}
-	unlockData();
+
+	if (old_index != new_index)
+	{
+		mShards[llmax(old_index, new_index)].mLock.wrunlock();
+	}
+	mShards[llmin(old_index, new_index)].mLock.wrunlock();
 }
 
-// mDataMutex must be LOCKED before calling this
+// The shard of fileblock must be write LOCKED before calling this
 void LLVFS::removeFileBlock(LLVFSFileBlock *fileblock)
 {
 	// convert this into an unsaved, dummy fileblock to preserve locks
 	// a more rubust solution would store the locks in a seperate data structure
 	sync(fileblock, TRUE);
-	
+
 	if (fileblock->mLength > 0)
 	{
 		// turn this file into an empty block
 		LLVFSBlock *free_block = new LLVFSBlock(fileblock->mLocation, fileblock->mLength);
-		
+
+		mAllocMutex.lock();
 		addFreeBlock(free_block);
+		mAllocMutex.unlock();
 	}
-	
+
 	fileblock->mLocation = 0;
 	fileblock->mSize = 0;
 	fileblock->mLength = BLOCK_LENGTH_INVALID;
@@ -1030,11 +1058,12 @@ void LLVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type
 		LL_ERRS() << "Attempt to write to read-only VFS" << LL_ENDL;
 	}
 
-    lockData();
-	
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.wrlock();
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 		removeFileBlock(block);
@@ -1044,14 +1073,14 @@ void LLVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type
 		LL_WARNS() << "VFS: attempting to remove nonexistent file " << file_id << " type " << file_type << LL_ENDL;
 	}
 
-	unlockData();
+	shard.mLock.wrunlock();
 }
-    
-    
+
+
 S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length)
 {
 	S32 bytesread = 0;
-	
+
 	if (!isValid())
 	{
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
@@ -1060,17 +1089,18 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 	llassert(length >= 0);
 
 	BOOL do_read = FALSE;
-	
-    lockData();
-	
+
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.rdlock();
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 
-		block->mAccessTime = (U32)time(NULL);
-    
+		block->touch();
+
 		if (location > block->mSize)
 		{
 			LL_WARNS() << "VFS: Attempt to read location " << location << " in file " << file_id << " of length " << block->mSize << LL_ENDL;
@@ -1086,17 +1116,18 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 		}
 	}
 
+	// The read lock is held over the read so the file cannot move or be
+	// removed under it.
 	if (do_read)
 	{
-		fseek(mDataFP, location, SEEK_SET);
-		bytesread = (S32)fread(buffer, 1, length, mDataFP);
+		bytesread = readData(buffer, location, length);
 	}
-	
-	unlockData();
+
+	shard.mLock.rdunlock();
 
 	return bytesread;
 }
-    
+
 S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length)
 {
 	if (!isValid())
@@ -1107,14 +1138,15 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
 	{
 		LL_ERRS() << "Attempt to write to read-only VFS" << LL_ENDL;
 	}
-    
+
 	llassert(length > 0);
 
-    lockData();
-    
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.wrlock();
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 
@@ -1124,29 +1156,29 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
 			location = block->mSize;
 		}
 		llassert(location >= 0);
-		
-		block->mAccessTime = (U32)time(NULL);
-    
+
+		block->touch();
+
 		if (block->mLength == BLOCK_LENGTH_INVALID)
 		{
 			// Block was removed, ignore write
 			LL_WARNS() << "VFS: Attempt to write to invalid block"
-					<< " in file " << file_id 
+					<< " in file " << file_id
 					<< " location: " << in_loc
 					<< " bytes: " << length
 					<< LL_ENDL;
-			unlockData();
+			shard.mLock.wrunlock();
 			return length;
 		}
 		else if (location > block->mLength)
 		{
-			LL_WARNS() << "VFS: Attempt to write to location " << location 
-					<< " in file " << file_id 
+			LL_WARNS() << "VFS: Attempt to write to location " << location
+					<< " in file " << file_id
 					<< " type " << S32(file_type)
 					<< " of size " << block->mSize
 					<< " block length " << block->mLength
 					<< LL_ENDL;
-			unlockData();
+			shard.mLock.wrunlock();
 			return length;
 		}
 		else
@@ -1157,41 +1189,40 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
 				length = block->mLength - location;
 			}
 			U32 file_location = location + block->mLocation;
-			
-			fseek(mDataFP, file_location, SEEK_SET);
-			S32 write_len = (S32)fwrite(buffer, 1, length, mDataFP);
+
+			S32 write_len = writeData(buffer, file_location, length);
 			if (write_len != length)
 			{
 				LL_WARNS() << llformat("VFS Write Error: %d != %d",write_len,length) << LL_ENDL;
 			}
-			// fflush(mDataFP);
-			
+
 			if (location + length > block->mSize)
 			{
 				block->mSize = location + write_len;
 				sync(block);
 			}
-			unlockData();
-			
+			shard.mLock.wrunlock();
+
 			return write_len;
 		}
 	}
 	else
 	{
-		unlockData();
+		shard.mLock.wrunlock();
 		return 0;
 	}
 }
- 
+
 void LLVFS::incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
 {
-	lockData();
-
 	LLVFSFileSpecifier spec(file_id, file_type);
+	Shard& shard = getShard(spec);
+	shard.mLock.wrlock();
+
 	LLVFSFileBlock *block;
-	
- 	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+
+ 	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		block = (*it).second;
 	}
@@ -1199,23 +1230,24 @@ void LLVFS::incLock(const LLUUID &file_id, const LLAssetType::EType file_type, E
 	{
 		// Create a dummy block which isn't saved
 		block = new LLVFSFileBlock(file_id, file_type, 0, BLOCK_LENGTH_INVALID);
-    	block->mAccessTime = (U32)time(NULL);
-		mFileBlocks.insert(fileblock_map::value_type(spec, block));
+    	block->touch();
+		shard.mFileBlocks.insert(fileblock_map::value_type(spec, block));
 	}
 
 	block->mLocks[lock]++;
 	mLockCounts[lock]++;
-	
-	unlockData();
+
+	shard.mLock.wrunlock();
 }
 
 void LLVFS::decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
 {
-	lockData();
-
 	LLVFSFileSpecifier spec(file_id, file_type);
- 	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.wrlock();
+
+ 	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 
@@ -1227,27 +1259,28 @@ void LLVFS::decLock(const LLUUID &file_id, const LLAssetType::EType file_type, E
 		{
 			LL_WARNS() << "VFS: Decrementing zero-value lock " << lock << LL_ENDL;
 		}
-		mLockCounts[lock]--;
+		mLockCounts[lock] -= 1;
 	}
 
-	unlockData();
+	shard.mLock.wrunlock();
 }
 
 BOOL LLVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
 {
-	lockData();
-	
 	BOOL res = FALSE;
-	
+
 	LLVFSFileSpecifier spec(file_id, file_type);
- 	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	Shard& shard = getShard(spec);
+	shard.mLock.rdlock();
+
+ 	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
 		res = (block->mLocks[lock] > 0);
 	}
 
-	unlockData();
+	shard.mLock.rdunlock();
 
 	return res;
 }
@@ -1256,31 +1289,98 @@ BOOL LLVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type,
 // protected
 //============================================================================
 
-void LLVFS::eraseBlockLength(LLVFSBlock *block)
+void LLVFS::rdlockAllShards()
 {
-	// find the corresponding map entry in the length map and erase it
-	S32 length = block->mLength;
-	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(length);
-	blocks_length_map_t::iterator end = mFreeBlocksByLength.end();
-	bool found_block = false;
-	while(iter != end)
-	{
-		LLVFSBlock *tblock = iter->second;
-		llassert(tblock->mLength == length); // there had -better- be an entry with our length!
-		if (tblock == block)
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		mShards[i].mLock.rdlock();
+	}
+}
+
+void LLVFS::rdunlockAllShards()
+{
+	for (S32 i = SHARD_COUNT - 1; i >= 0; --i)
+	{
+		mShards[i].mLock.rdunlock();
+	}
+}
+
+S32 LLVFS::readData(U8 *buffer, U32 location, S32 length)
+{
+	// Positional reads leave the file pointer alone, so any number of
+	// threads can read the data file at once.
+#if LL_WINDOWS
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(mDataFP));
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = location;
+	DWORD bytes = 0;
+	if (!ReadFile(handle, buffer, length, &bytes, &overlapped) && GetLastError() != ERROR_HANDLE_EOF)
+	{
+		return 0;
+	}
+	return (S32)bytes;
+#else
+	const int fd = fileno(mDataFP);
+	S32 total = 0;
+	while (total < length)
+	{
+		ssize_t bytes = pread(fd, buffer + total, length - total, (off_t)location + total);
+		if (bytes < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (bytes <= 0)
 		{
-			mFreeBlocksByLength.erase(iter);
-			found_block = true;
 			break;
 		}
-		++iter;
+		total += (S32)bytes;
 	}
-	if(!found_block)
+	return total;
+#endif
+}
+
+S32 LLVFS::writeData(const U8 *buffer, U32 location, S32 length)
+{
+#if LL_WINDOWS
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(mDataFP));
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = location;
+	DWORD bytes = 0;
+	if (!WriteFile(handle, buffer, length, &bytes, &overlapped))
 	{
-		LL_ERRS() << "eraseBlock could not find block" << LL_ENDL;
+		return 0;
 	}
+	return (S32)bytes;
+#else
+	const int fd = fileno(mDataFP);
+	S32 total = 0;
+	while (total < length)
+	{
+		ssize_t bytes = pwrite(fd, buffer + total, length - total, (off_t)location + total);
+		if (bytes < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (bytes <= 0)
+		{
+			break;
+		}
+		total += (S32)bytes;
+	}
+	return total;
+#endif
 }
 
+void LLVFS::eraseBlockLength(LLVFSBlock *block)
+{
+	// find the corresponding map entry in the length map and erase it
+	if (mFreeBlocksByLength.erase(std::make_pair(block->mLength, block->mLocation)) != 1)
+	{
+		LL_ERRS() << "eraseBlock could not find block" << LL_ENDL;
+	}
+}
 
 // Remove block from both free lists (by location and by length).
 void LLVFS::eraseBlock(LLVFSBlock *block)
@@ -1335,7 +1435,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		eraseBlockLength(prev_block);
 		eraseBlock(next_block);
 		prev_block->mLength += block->mLength + next_block->mLength;
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(prev_block->mLength, prev_block));
+		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(std::make_pair(prev_block->mLength, prev_block->mLocation), prev_block));
 		delete block;
 		block = NULL;
 		delete next_block;
@@ -1348,7 +1448,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		// therefore only need to update the length map. JC
 		eraseBlockLength(prev_block);
 		prev_block->mLength += block->mLength;
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(prev_block->mLength, prev_block)); // multimap insert
+		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(std::make_pair(prev_block->mLength, prev_block->mLocation), prev_block));
 		delete block;
 		block = NULL;
 	}
@@ -1362,7 +1462,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		next_block->mLength += block->mLength;
 		// Don't hint here, next_free_it iterator may be invalid.
 		mFreeBlocksByLocation.insert(blocks_location_map_t::value_type(next_block->mLocation, next_block)); // multimap insert
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(next_block->mLength, next_block)); // multimap insert			
+		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(std::make_pair(next_block->mLength, next_block->mLocation), next_block));
 		delete block;
 		block = NULL;
 	}
@@ -1371,7 +1471,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		// Can't merge with other free blocks.
 		// Hint that insert should go near next_free_it.
  		mFreeBlocksByLocation.insert(next_free_it, blocks_location_map_t::value_type(block->mLocation, block)); // multimap insert
- 		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(block->mLength, block)); // multimap insert
+ 		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(std::make_pair(block->mLength, block->mLocation), block));
 	}
 }
 
@@ -1433,7 +1533,7 @@ void LLVFS::useFreeSpace(LLVFSBlock *free_block, S32 length)
 	}
 }
 
-// NOTE! mDataMutex must be LOCKED before calling this
+// NOTE! The shard of block must be write LOCKED before calling this
 // sync this index entry out to the index file
 // we need to do this constantly to avoid corruption on viewer crash
 void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
@@ -1457,6 +1557,8 @@ void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
 		LL_ERRS() << "VFS syncing zero-length block" << LL_ENDL;
 	}
 
+	LLMutexLock lock(mIndexMutex);
+
     BOOL set_index_to_end = FALSE;
 	long seek_pos = block->mIndexLocation;
 		
@@ -1476,7 +1578,7 @@ void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
     if (set_index_to_end)
 	{
 		// Need fseek/ftell to update the seek_pos and hence data
-		// structures, so can't unlockData() before this.
+		// structures, so can't unlock mIndexMutex before this.
 		fseek(mIndexFP, 0, SEEK_END);
 		seek_pos = ftell(mIndexFP);
 	}
@@ -1515,110 +1617,117 @@ void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
 	return;
 }
 
-// mDataMutex must be LOCKED before calling this
-// Can initiate LRU-based file removal to make space.
-// The immune file block will not be removed.
-LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
+// mAllocMutex must be LOCKED before calling this
+// Returns the smallest free block of at least size bytes, or NULL; making
+// room is left to makeFreeSpace(), which must be called with no lock held.
+LLVFSBlock *LLVFS::findFreeBlock(S32 size)
 {
 	if (!isValid())
 	{
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 	}
 
-	LLVFSBlock *block = NULL;
-	BOOL have_lru_list = FALSE;
-	
-	typedef std::set<LLVFSFileBlock*, LLVFSFileBlock_less> lru_set;
-	lru_set lru_list;
-    
-	LLTimer timer;
+	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(std::make_pair(size, 0U)); // first entry >= size
+	return iter != mFreeBlocksByLength.end() ? iter->second : NULL;
+}
 
-	while (! block)
+struct LLVFSLRUEntry
+{
+	U32 mAccessTime;
+	LLVFSFileSpecifier mSpec;
+
+	bool operator<(const LLVFSLRUEntry& rhs) const
 	{
-		// look for a suitable free block
-		blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(size); // first entry >= size
-		if (iter != mFreeBlocksByLength.end())
-			block = iter->second;
-    	
-		// no large enough free blocks, time to clean out some junk
-		if (! block)
-		{
-			// create a list of files sorted by usage time
-			// this is far faster than sorting a linked list
-			if (! have_lru_list)
-			{
-				for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
-				{
-					LLVFSFileBlock *tmp = (*it).second;
+		return (mAccessTime == rhs.mAccessTime) ? mSpec < rhs.mSpec : mAccessTime < rhs.mAccessTime;
+	}
+};
 
-					if (tmp != immune &&
-						tmp->mLength > 0 &&
-						! tmp->mLocks[VFSLOCK_READ] &&
-						! tmp->mLocks[VFSLOCK_APPEND] &&
-						! tmp->mLocks[VFSLOCK_OPEN])
-					{
-						lru_list.insert(tmp);
-					}
-				}
-				
-				have_lru_list = TRUE;
-			}
+// No lock may be held when calling this.
+BOOL LLVFS::makeFreeSpace(S32 size, const LLVFSFileSpecifier& immune)
+{
+	LLTimer timer;
 
-			if (lru_list.size() == 0)
-			{
-				// No more files to delete, and still not enough room!
-				LL_WARNS() << "VFS: Can't make " << size << " bytes of free space in VFS, giving up" << LL_ENDL;
-				break;
-			}
+	// create a list of files sorted by usage time, one shard at a time so
+	// the rest of the VFS stays usable meanwhile
+	std::vector<LLVFSLRUEntry> lru_list;
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		Shard& shard = mShards[i];
+		shard.mLock.rdlock();
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			LLVFSFileBlock *tmp = (*it).second;
 
-			// is the oldest file big enough?  (Should be about half the time)
-			lru_set::iterator it = lru_list.begin();
-			LLVFSFileBlock *file_block = *it;
-			if (file_block->mLength >= size && file_block != immune)
+			if (tmp->mLength > 0 &&
+				! tmp->mLocks[VFSLOCK_READ] &&
+				! tmp->mLocks[VFSLOCK_APPEND] &&
+				! tmp->mLocks[VFSLOCK_OPEN] &&
+				!((*it).first == immune))
 			{
-				// ditch this file and look again for a free block - should find it
-				// TODO: it'll be faster just to assign the free block and break
-				LL_INFOS() << "LRU: Removing " << file_block->mFileID << ":" << file_block->mFileType << LL_ENDL;
-				lru_list.erase(it);
-				removeFileBlock(file_block);
-				file_block = NULL;
-				continue;
+				LLVFSLRUEntry entry;
+				entry.mAccessTime = tmp->getAccessTime();
+				entry.mSpec = (*it).first;
+				lru_list.push_back(entry);
 			}
-
-			
-			//LL_INFOS() << "VFS: LRU: Aggressive: " << (S32)lru_list.size() << " files remain" << LL_ENDL;
-			//dumpLockCounts();
-			
-			// Now it's time to aggressively make more space
-			// Delete the oldest 5MB of the vfs or enough to hold the file, which ever is larger
-			// This may yield too much free space, but we'll use it up soon enough
-			U32 cleanup_target = (size > VFS_CLEANUP_SIZE) ? size : VFS_CLEANUP_SIZE;
-			U32 cleaned_up = 0;
-		   	for (it = lru_list.begin();
-				 it != lru_list.end() && cleaned_up < cleanup_target;
-				 )
+		}
+		shard.mLock.rdunlock();
+	}
+	std::sort(lru_list.begin(), lru_list.end());
+
+	// If the oldest file is big enough, removing it is all it takes (should
+	// be about half the time). Otherwise delete the oldest 5MB of the vfs or
+	// enough to hold the file, which ever is larger. This may yield too much
+	// free space, but we'll use it up soon enough
+	const S32 cleanup_target = llmax(size, VFS_CLEANUP_SIZE);
+	S32 cleaned_up = 0;
+	S32 removed = 0;
+	for (std::vector<LLVFSLRUEntry>::iterator lru_it = lru_list.begin();
+		 lru_it != lru_list.end() && cleaned_up < cleanup_target;
+		 ++lru_it)
+	{
+		// The file may have been used, locked or removed since the list was made.
+		Shard& shard = getShard(lru_it->mSpec);
+		shard.mLock.wrlock();
+		fileblock_map::iterator it = shard.mFileBlocks.find(lru_it->mSpec);
+		if (it != shard.mFileBlocks.end())
+		{
+			LLVFSFileBlock *file_block = (*it).second;
+			if (file_block->mLength > 0 &&
+				file_block->getAccessTime() == lru_it->mAccessTime &&
+				! file_block->mLocks[VFSLOCK_READ] &&
+				! file_block->mLocks[VFSLOCK_APPEND] &&
+				! file_block->mLocks[VFSLOCK_OPEN])
 			{
-				file_block = *it;
-				
 				// TODO: it would be great to be able to batch all these sync() calls
-				// LL_INFOS() << "LRU2: Removing " << file_block->mFileID << ":" << file_block->mFileType << " last accessed" << file_block->mAccessTime << LL_ENDL;
-
-				cleaned_up += file_block->mLength;
-				lru_list.erase(it++);
+				LL_INFOS() << "LRU: Removing " << file_block->mFileID << ":" << file_block->mFileType << LL_ENDL;
+				if (!removed && file_block->mLength >= size)
+				{
+					cleaned_up = cleanup_target;
+				}
+				else
+				{
+					cleaned_up += file_block->mLength;
+				}
 				removeFileBlock(file_block);
-				file_block = NULL;
+				++removed;
 			}
-			//mergeFreeBlocks();
 		}
+		shard.mLock.wrunlock();
 	}
-    
+
 	F32 time = timer.getElapsedTimeF32();
 	if (time > 0.5f)
 	{
-		LL_WARNS() << "VFS: Spent " << time << " seconds in findFreeBlock!" << LL_ENDL;
+		LL_WARNS() << "VFS: Spent " << time << " seconds in makeFreeSpace!" << LL_ENDL;
 	}
 
-	return block;
+	if (!removed)
+	{
+		// No more files to delete, and still not enough room!
+		LL_WARNS() << "VFS: Can't make " << size << " bytes of free space in VFS, giving up" << LL_ENDL;
+		return FALSE;
+	}
+	return TRUE;
 }
 
 //============================================================================
@@ -1635,17 +1744,15 @@ void LLVFS::pokeFiles()
 	
 	// only write data if we actually read 4 bytes
 	// otherwise we're writing garbage and screwing up the file
-	fseek(mDataFP, 0, SEEK_SET);
-	if (fread(&word, sizeof(word), 1, mDataFP) == 1)
+	if (readData((U8*)&word, 0, sizeof(word)) == sizeof(word))
 	{
-		fseek(mDataFP, 0, SEEK_SET);
-		if (fwrite(&word, sizeof(word), 1, mDataFP) != 1)
+		if (writeData((U8*)&word, 0, sizeof(word)) != sizeof(word))
 		{
 			LL_WARNS() << "Could not write to data file" << LL_ENDL;
 		}
-		fflush(mDataFP);
 	}
 
+	LLMutexLock lock(mIndexMutex);
 	fseek(mIndexFP, 0, SEEK_SET);
 	if (fread(&word, sizeof(word), 1, mIndexFP) == 1)
 	{
@@ -1661,11 +1768,18 @@ void LLVFS::pokeFiles()
     
 void LLVFS::dumpMap()
 {
+	rdlockAllShards();
+	LLMutexLock lock_alloc(mAllocMutex);
+
 	LL_INFOS() << "Files:" << LL_ENDL;
-	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
 	{
-		LLVFSFileBlock *file_block = (*it).second;
-		LL_INFOS() << "Location: " << file_block->mLocation << "\tLength: " << file_block->mLength << "\t" << file_block->mFileID << "\t" << file_block->mFileType << LL_ENDL;
+		fileblock_map& file_blocks = mShards[i].mFileBlocks;
+		for (fileblock_map::iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
+		{
+			LLVFSFileBlock *file_block = (*it).second;
+			LL_INFOS() << "Location: " << file_block->mLocation << "\tLength: " << file_block->mLength << "\t" << file_block->mFileID << "\t" << file_block->mFileType << LL_ENDL;
+		}
 	}
     
 	LL_INFOS() << "Free Blocks:" << LL_ENDL;
@@ -1676,14 +1790,17 @@ void LLVFS::dumpMap()
 		LLVFSBlock *free_block = iter->second;
 		LL_INFOS() << "Location: " << free_block->mLocation << "\tLength: " << free_block->mLength << LL_ENDL;
 	}
+
+	rdunlockAllShards();
 }
     
 // verify that the index file contents match the in-memory file structure
 // Very slow, do not call routinely. JC
 void LLVFS::audit()
 {
-	// Lock the mutex through this whole function.
-	LLMutexLock lock_data(mDataMutex);
+	// Keep the index still through this whole function.
+	rdlockAllShards();
+	mIndexMutex.lock();
 	
 	fflush(mIndexFP);
 
@@ -1722,10 +1839,11 @@ void LLVFS::audit()
 			block->mSize <= block->mLength &&
 			block->mFileType >= LLAssetType::AT_NONE &&
 			block->mFileType < LLAssetType::AT_COUNT &&
-			block->mAccessTime <= cur_time &&
+			block->getAccessTime() <= cur_time &&
 			block->mFileID != LLUUID::null)
 		{
-			if (mFileBlocks.find(*block) == mFileBlocks.end())
+			const fileblock_map& file_blocks = getShard(*block).mFileBlocks;
+			if (file_blocks.find(*block) == file_blocks.end())
 			{
 				LL_WARNS() << "VFile " << block->mFileID << ":" << block->mFileType << " on disk, not in memory, loc " << block->mIndexLocation << LL_ENDL;
 			}
@@ -1775,7 +1893,12 @@ void LLVFS::audit()
     
 	if (!vfs_corrupt)
 	{
-		for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+		fileblock_map file_blocks;
+		for (S32 i = 0; i < SHARD_COUNT; ++i)
+		{
+			file_blocks.insert(mShards[i].mFileBlocks.begin(), mShards[i].mFileBlocks.end());
+		}
+		for (fileblock_map::iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
 		{
 			LLVFSFileBlock* block = (*it).second;
 
@@ -1813,9 +1936,11 @@ void LLVFS::audit()
 		}
     
 		LL_INFOS() << "VFS: audit OK" << LL_ENDL;
-		// mutex released by LLMutexLock() destructor.
 	}
 
+	mIndexMutex.unlock();
+	rdunlockAllShards();
+
 	for_each(audit_blocks.begin(), audit_blocks.end(), DeletePointer());
 }
     
@@ -1824,29 +1949,35 @@ void LLVFS::audit()
 // Slow, do not call in release.
 void LLVFS::checkMem()
 {
-	lockData();
+	rdlockAllShards();
+	mIndexMutex.lock();
 	
-	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
 	{
-		LLVFSFileBlock *block = (*it).second;
-		llassert(block->mFileType >= LLAssetType::AT_NONE &&
-				 block->mFileType < LLAssetType::AT_COUNT &&
-				 block->mFileID != LLUUID::null);
-    
-		for (std::deque<S32>::iterator iter = mIndexHoles.begin();
-			 iter != mIndexHoles.end(); ++iter)
+		fileblock_map& file_blocks = mShards[i].mFileBlocks;
+		for (fileblock_map::iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
 		{
-			S32 index_loc = *iter;
-			if (index_loc == block->mIndexLocation)
+			LLVFSFileBlock *block = (*it).second;
+			llassert(block->mFileType >= LLAssetType::AT_NONE &&
+					 block->mFileType < LLAssetType::AT_COUNT &&
+					 block->mFileID != LLUUID::null);
+
+			for (std::deque<S32>::iterator iter = mIndexHoles.begin();
+				 iter != mIndexHoles.end(); ++iter)
 			{
-				LL_WARNS() << "VFile block " << block->mFileID << ":" << block->mFileType << " is marked as a hole" << LL_ENDL;
+				S32 index_loc = *iter;
+				if (index_loc == block->mIndexLocation)
+				{
+					LL_WARNS() << "VFile block " << block->mFileID << ":" << block->mFileType << " is marked as a hole" << LL_ENDL;
+				}
 			}
 		}
 	}
     
 	LL_INFOS() << "VFS: mem check OK" << LL_ENDL;
 
-	unlockData();
+	mIndexMutex.unlock();
+	rdunlockAllShards();
 }
 
 void LLVFS::dumpLockCounts()
@@ -1860,7 +1991,8 @@ void LLVFS::dumpLockCounts()
 
 void LLVFS::dumpStatistics()
 {
-	lockData();
+	rdlockAllShards();
+	mAllocMutex.lock();
 	
 	// Investigate file blocks.
 	std::map<S32, S32> size_counts;
@@ -1870,31 +2002,37 @@ void LLVFS::dumpStatistics()
 	S32 max_file_size = 0;
 	S32 total_file_size = 0;
 	S32 invalid_file_count = 0;
-	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+	S32 file_block_count = 0;
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
 	{
-		LLVFSFileBlock *file_block = (*it).second;
-		if (file_block->mLength == BLOCK_LENGTH_INVALID)
-		{
-			invalid_file_count++;
-		}
-		else if (file_block->mLength <= 0)
+		fileblock_map& file_blocks = mShards[i].mFileBlocks;
+		for (fileblock_map::iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
 		{
-			LL_INFOS() << "Bad file block at: " << file_block->mLocation << "\tLength: " << file_block->mLength << "\t" << file_block->mFileID << "\t" << file_block->mFileType << LL_ENDL;
-			size_counts[file_block->mLength]++;
-			location_counts[file_block->mLocation]++;
-		}
-		else
-		{
-			total_file_size += file_block->mLength;
-		}
+			LLVFSFileBlock *file_block = (*it).second;
+			file_block_count++;
+			if (file_block->mLength == BLOCK_LENGTH_INVALID)
+			{
+				invalid_file_count++;
+			}
+			else if (file_block->mLength <= 0)
+			{
+				LL_INFOS() << "Bad file block at: " << file_block->mLocation << "\tLength: " << file_block->mLength << "\t" << file_block->mFileID << "\t" << file_block->mFileType << LL_ENDL;
+				size_counts[file_block->mLength]++;
+				location_counts[file_block->mLocation]++;
+			}
+			else
+			{
+				total_file_size += file_block->mLength;
+			}
 
-		if (file_block->mLength > max_file_size)
-		{
-			max_file_size = file_block->mLength;
-		}
+			if (file_block->mLength > max_file_size)
+			{
+				max_file_size = file_block->mLength;
+			}
 
-		filetype_counts[file_block->mFileType].first++;
-		filetype_counts[file_block->mFileType].second += file_block->mLength;
+			filetype_counts[file_block->mFileType].first++;
+			filetype_counts[file_block->mFileType].second += file_block->mLength;
+		}
 	}
     
 	for (std::map<S32,S32>::iterator it = size_counts.begin(); it != size_counts.end(); ++it)
@@ -1947,7 +2085,7 @@ void LLVFS::dumpStatistics()
 	}
 
 	LL_INFOS() << "Invalid blocks: " << invalid_file_count << LL_ENDL;
-	LL_INFOS() << "File blocks:    " << mFileBlocks.size() << LL_ENDL;
+	LL_INFOS() << "File blocks:    " << file_block_count << LL_ENDL;
 
 	S32 length_list_count = (S32)mFreeBlocksByLength.size();
 	S32 location_list_count = (S32)mFreeBlocksByLocation.size();
@@ -1994,7 +2132,8 @@ void LLVFS::dumpStatistics()
  			first_block = second_block;
  		}
 	}
-	unlockData();
+	mAllocMutex.unlock();
+	rdunlockAllShards();
 }
 
 // Debug Only!
@@ -2034,34 +2173,42 @@ std::string get_extension(LLAssetType::EType type)
 
 void LLVFS::listFiles()
 {
-	lockData();
+	rdlockAllShards();
 	
-	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
 	{
-		LLVFSFileSpecifier file_spec = it->first;
-		LLVFSFileBlock *file_block = it->second;
-		S32 length = file_block->mLength;
-		S32 size = file_block->mSize;
-		if (length != BLOCK_LENGTH_INVALID && size > 0)
+		fileblock_map& file_blocks = mShards[i].mFileBlocks;
+		for (fileblock_map::iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
 		{
-			LLUUID id = file_spec.mFileID;
-			std::string extension = get_extension(file_spec.mFileType);
-			LL_INFOS() << " File: " << id
-					<< " Type: " << LLAssetType::getDesc(file_spec.mFileType)
-					<< " Size: " << size
-					<< LL_ENDL;
+			LLVFSFileSpecifier file_spec = it->first;
+			LLVFSFileBlock *file_block = it->second;
+			S32 length = file_block->mLength;
+			S32 size = file_block->mSize;
+			if (length != BLOCK_LENGTH_INVALID && size > 0)
+			{
+				LLUUID id = file_spec.mFileID;
+				std::string extension = get_extension(file_spec.mFileType);
+				LL_INFOS() << " File: " << id
+						<< " Type: " << LLAssetType::getDesc(file_spec.mFileType)
+						<< " Size: " << size
+						<< LL_ENDL;
+			}
 		}
 	}
 	
-	unlockData();
+	rdunlockAllShards();
 }
 
 std::map<LLVFSFileSpecifier, LLVFSFileBlock*> LLVFS::getFileList()
 {
 	//have to do this so as not to mess with the gods of threading
-	lockData();
-	fileblock_map mFileList = mFileBlocks;
-	unlockData();
+	fileblock_map mFileList;
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		mShards[i].mLock.rdlock();
+		mFileList.insert(mShards[i].mFileBlocks.begin(), mShards[i].mFileBlocks.end());
+		mShards[i].mLock.rdunlock();
+	}
 
 	return mFileList;
 }
@@ -2069,10 +2216,11 @@ std::map<LLVFSFileSpecifier, LLVFSFileBlock*> LLVFS::getFileList()
 #include "llapr.h"
 void LLVFS::dumpFiles()
 {
-	lockData();
+	// getData() takes the shard locks itself, so work from a snapshot.
+	fileblock_map file_blocks = getFileList();
 	
 	S32 files_extracted = 0;
-	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+	for (fileblock_map::iterator it = file_blocks.begin(); it != file_blocks.end(); ++it)
 	{
 		LLVFSFileSpecifier file_spec = it->first;
 		LLVFSFileBlock *file_block = it->second;
@@ -2084,9 +2232,7 @@ void LLVFS::dumpFiles()
 			LLAssetType::EType type = file_spec.mFileType;
 			std::vector<U8> buffer(size);
 
-			unlockData();
-			getData(id, type, &buffer[0], 0, size);
-			lockData();
+			size = getData(id, type, &buffer[0], 0, size);
 			
 			std::string extension = get_extension(type);
 			std::string filename = id.asString() + extension;
@@ -2099,10 +2245,8 @@ void LLVFS::dumpFiles()
 			files_extracted++;
 		}
 	}
-	
-	unlockData();
 
-	LL_INFOS() << "Extracted " << files_extracted << " files out of " << mFileBlocks.size() << LL_ENDL;
+	LL_INFOS() << "Extracted " << files_extracted << " files out of " << file_blocks.size() << LL_ENDL;
 }
 
 //============================================================================
@@ -27,7 +27,9 @@
 #ifndef LL_LLVFS_H
 #define LL_LLVFS_H
 
+#include <atomic>
 #include <deque>
+#include <map>
 #include "lluuid.h"
 #include "llassettype.h"
 #include "llthread.h"
@@ -100,15 +102,26 @@ public:
 	void deserialize(U8 *buffer, const S32 index_loc);
 	static BOOL insertLRU(LLVFSFileBlock* const& first,
 						  LLVFSFileBlock* const& second);
+	// Readers stamp the access time under the shard lock taken for reading
+	// only, while the LRU sort and the index writes read it.
+	void touch()				{ mAccessTime.store((U32)time(NULL), std::memory_order_relaxed); }
+	U32  getAccessTime() const	{ return mAccessTime.load(std::memory_order_relaxed); }
+
 	S32  mSize;
 	S32  mIndexLocation; // location of index entry
-	U32  mAccessTime;
+	std::atomic<U32> mAccessTime;
 	BOOL mLocks[VFSLOCK_COUNT]; // number of outstanding locks of each type
 
 	static const S32 SERIAL_SIZE;
 };
 //<edit>
 
+// The index is split in shards by file id, each behind its own read/write
+// lock; reads only take their shard's lock for reading and then read the data
+// file positionally, so they run in parallel with each other and with writes
+// to other shards. The free list and the index file each have their own mutex.
+// Lock order: shard (two shards: lowest index first), then mAllocMutex,
+// then mIndexMutex.
 class LLVFS
 {
 private:
@@ -133,7 +146,7 @@ public:
 	BOOL isValid() const			{ return (VFSVALID_OK == mValid); }
 	EVFSValid getValidState() const	{ return mValid; }
 
-	// ---------- The following fucntions lock/unlock mDataMutex ----------
+	// ---------- The following functions lock the shard of the file ----------
 	BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
 	S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
 
@@ -169,40 +182,61 @@ public:
 	void listFiles();
 	void dumpFiles();
 
+//<edit>
+public:
+	typedef std::map<LLVFSFileSpecifier, LLVFSFileBlock*> fileblock_map;
+	std::map<LLVFSFileSpecifier, LLVFSFileBlock*> getFileList();
+//</edit>
+
 protected:
+	enum { SHARD_COUNT = 16 };	// must be power of 2
+
+	struct Shard
+	{
+		AIRWLock mLock;
+		fileblock_map mFileBlocks;
+	};
+
+	Shard& getShard(const LLVFSFileSpecifier& spec) { return mShards[getShardIndex(spec)]; }
+	static S32 getShardIndex(const LLVFSFileSpecifier& spec) { return spec.mFileID.mData[0] & (SHARD_COUNT - 1); }
+	// Diagnostics only: read lock every shard, in order.
+	void rdlockAllShards();
+	void rdunlockAllShards();
+
+	// The shard of the block must be write locked.
 	void removeFileBlock(LLVFSFileBlock *fileblock);
 	
+	// mAllocMutex must be locked.
 	void eraseBlockLength(LLVFSBlock *block);
 	void eraseBlock(LLVFSBlock *block);
 	void addFreeBlock(LLVFSBlock *block);
 	//void mergeFreeBlocks();
 	void useFreeSpace(LLVFSBlock *free_block, S32 length);
+	LLVFSBlock *findFreeBlock(S32 size);
+
+	// Locks mIndexMutex; the shard of the block must be write locked.
 	void sync(LLVFSFileBlock *block, BOOL remove = FALSE);
 	void presizeDataFile(const U32 size);
 
+	// Positional access to the data file; safe to call from several threads at once.
+	S32 readData(U8 *buffer, U32 location, S32 length);
+	S32 writeData(const U8 *buffer, U32 location, S32 length);
+
 	static LLFILE *openAndLock(const std::string& filename, const char* mode, BOOL read_lock);
 	static void unlockAndClose(FILE *fp);
 	
-	// Can initiate LRU-based file removal to make space.
-	// The immune file block will not be removed.
-	LLVFSBlock *findFreeBlock(S32 size, LLVFSFileBlock *immune = NULL);
+	// LRU-based file removal to make space, with no lock held.
+	// The immune file will not be removed. Returns FALSE when nothing could be removed.
+	BOOL makeFreeSpace(S32 size, const LLVFSFileSpecifier& immune);
 
-	// lock/unlock data mutex (mDataMutex)
-	void lockData() { mDataMutex->lock(); }
-	void unlockData() { mDataMutex->unlock(); }	
-	
 protected:
-	LLMutex* mDataMutex;
+	Shard mShards[SHARD_COUNT];
 
-//<edit>
-public:
-	typedef std::map<LLVFSFileSpecifier, LLVFSFileBlock*> fileblock_map;
-	std::map<LLVFSFileSpecifier, LLVFSFileBlock*> getFileList();
-//</edit>
-protected:
-	fileblock_map mFileBlocks;
+	LLMutex mAllocMutex;	// protects the free lists
+	LLMutex mIndexMutex;	// protects mIndexFP and mIndexHoles
 
-	typedef std::multimap<S32, LLVFSBlock*>	blocks_length_map_t;
+	// Keyed by (length, location) so a given free block is found in O(log n).
+	typedef std::map<std::pair<S32, U32>, LLVFSBlock*> blocks_length_map_t;
 	blocks_length_map_t 	mFreeBlocksByLength;
 	typedef std::multimap<U32, LLVFSBlock*>	blocks_location_map_t;
 	blocks_location_map_t 	mFreeBlocksByLocation;
@@ -218,7 +252,7 @@ protected:
 
 	EVFSValid mValid;
 
-	S32 mLockCounts[VFSLOCK_COUNT];
+	LLAtomicS32 mLockCounts[VFSLOCK_COUNT];
 	BOOL mRemoveAfterCrash;
 };
 
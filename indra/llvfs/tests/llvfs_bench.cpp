@@ -0,0 +1,185 @@
+/**
+ * @file llvfs_bench.cpp
+ * @brief Concurrent read/write throughput of the sharded LLVFS.
+ *
+ * Usage: llvfs_bench [directory] [seconds per run]
+ *
+ * Creates a scratch VFS in the directory (default: current directory), fills
+ * it with a few thousand texture sized files and then runs a mix of 80%
+ * reads, 15% overwrites and 5% remove/recreate from 1, 2, 4 and 8 threads.
+ * Each thread count is run twice: once with every call wrapped in one
+ * global mutex, which is how the VFS behaved before it was sharded, then
+ * with the VFS locking on its own. Operations per second are reported.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llatomic.h"
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "llfile.h"
+#include "llformat.h"
+#include "lltimer.h"
+#include "llvfs.h"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static const S32 NUM_FILES = 4000;
+static const S32 FILE_SIZE = 16 * 1024;			// a texture's first discard level
+static const U32 VFS_SIZE = 256 * 1024 * 1024;	// room for all files, with churn
+
+static std::vector<LLUUID> sFileIDs;
+static LLAtomicU32 sChecksum(0);
+
+// Serializes every call when set, standing in for the old single VFS mutex.
+static LLMutex* sGlobalMutex = NULL;
+
+class GlobalLock
+{
+public:
+	GlobalLock()	{ if (sGlobalMutex) sGlobalMutex->lock(); }
+	~GlobalLock()	{ if (sGlobalMutex) sGlobalMutex->unlock(); }
+};
+
+static void fill(U8* buffer, U32 seed)
+{
+	for (S32 i = 0; i < FILE_SIZE; ++i)
+	{
+		buffer[i] = (U8)(seed + i * 7);
+	}
+}
+
+static void worker(LLVFS* vfs, U32 seed, F64 seconds, LLAtomicU32& ops)
+{
+	std::vector<U8> buffer(FILE_SIZE);
+	U32 rand = seed * 2654435761u + 1;
+	U32 count = 0;
+	U32 hash = 0;
+	LLTimer timer;
+	while (timer.getElapsedTimeF64() < seconds)
+	{
+		rand = rand * 1664525u + 1013904223u;
+		const LLUUID& id = sFileIDs[(rand >> 8) % NUM_FILES];
+		const U32 op = (rand >> 24) % 100;
+		if (op < 80)
+		{
+			GlobalLock lock;
+			S32 read = vfs->getData(id, LLAssetType::AT_TEXTURE, &buffer[0], 0, FILE_SIZE);
+			hash += read > 0 ? buffer[read - 1] : 0;
+		}
+		else if (op < 95)
+		{
+			fill(&buffer[0], rand);
+			GlobalLock lock;
+			vfs->storeData(id, LLAssetType::AT_TEXTURE, &buffer[0], 0, FILE_SIZE);
+		}
+		else
+		{
+			fill(&buffer[0], rand);
+			GlobalLock lock;
+			if (vfs->getExists(id, LLAssetType::AT_TEXTURE))
+			{
+				vfs->removeFile(id, LLAssetType::AT_TEXTURE);
+			}
+			if (vfs->setMaxSize(id, LLAssetType::AT_TEXTURE, FILE_SIZE))
+			{
+				vfs->storeData(id, LLAssetType::AT_TEXTURE, &buffer[0], 0, FILE_SIZE);
+			}
+		}
+		++count;
+	}
+	sChecksum += hash;
+	ops += count;
+}
+
+static F64 run(LLVFS* vfs, U32 num_threads, F64 seconds)
+{
+	LLAtomicU32 ops(0);
+	std::vector<std::thread> threads;
+	LLTimer timer;
+	for (U32 i = 0; i < num_threads; ++i)
+	{
+		threads.push_back(std::thread(worker, vfs, i + 1, seconds, std::ref(ops)));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	return (U32)ops / timer.getElapsedTimeF64();
+}
+
+int main(int argc, char** argv)
+{
+	LLCommon::initClass();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const std::string dir = argc > 1 ? argv[1] : ".";
+	const F64 seconds = argc > 2 ? atof(argv[2]) : 2.0;
+	const std::string index_file = dir + "/llvfs_bench.index";
+	const std::string data_file = dir + "/llvfs_bench.data";
+	LLFile::remove(index_file);
+	LLFile::remove(data_file);
+
+	LLVFS* vfs = LLVFS::createLLVFS(index_file, data_file, FALSE, VFS_SIZE, FALSE);
+	if (!vfs || !vfs->isValid())
+	{
+		std::cerr << "Could not create a VFS in " << dir << std::endl;
+		return 1;
+	}
+
+	std::vector<U8> buffer(FILE_SIZE);
+	for (S32 i = 0; i < NUM_FILES; ++i)
+	{
+		LLUUID id;
+		id.generate();
+		sFileIDs.push_back(id);
+		fill(&buffer[0], i);
+		vfs->setMaxSize(id, LLAssetType::AT_TEXTURE, FILE_SIZE);
+		vfs->storeData(id, LLAssetType::AT_TEXTURE, &buffer[0], 0, FILE_SIZE);
+	}
+
+	LLMutex global_mutex;
+	const U32 thread_counts[] = { 1, 2, 4, 8 };
+	for (U32 num_threads : thread_counts)
+	{
+		sGlobalMutex = &global_mutex;
+		const F64 global = run(vfs, num_threads, seconds);
+		sGlobalMutex = NULL;
+		const F64 sharded = run(vfs, num_threads, seconds);
+
+		std::cout << llformat("%u threads: global lock %9.0f ops/s | sharded %9.0f ops/s | speedup %.2fx",
+							  num_threads, global, sharded, sharded / global)
+				  << std::endl;
+	}
+	std::cout << "checksum " << (U32)sChecksum << std::endl;
+
+	delete vfs;
+	LLFile::remove(index_file);
+	LLFile::remove(data_file);
+	LLCommon::cleanupClass();
+	return 0;
+}
@@ -678,29 +678,15 @@ void LLControlGroup::setUntypedValue(const std::string& name, const LLSD& val)
 	}
 }
 void LLControlGroup::saveColorSettings (std::string setting_name,LLColor4 setting_color) {
-    char *sql;
-    sqlite3_stmt *stmt;
-	sqlite3 *db;
-	if (LLSqlMgr::instance().isInit()) {
-		db = LLSqlMgr::instance().getDB();
-	} else {
-		db = LLSqlMgr::instance().getAllAgentsDB();
-	}
-    
-    sql = "DELETE FROM COLOR_SETTINGS WHERE ID=?";
-    sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    sqlite3_bind_text(stmt, 1,  setting_name.c_str(), strlen(setting_name.c_str()), 0);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    sql = "INSERT INTO COLOR_SETTINGS (ID,R,G,B,A) VALUES (?,?,?,?,?)";
-    sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    sqlite3_bind_text(stmt, 1,  setting_name.c_str(), strlen(setting_name.c_str()), 0);
-    sqlite3_bind_double(stmt, 2, setting_color.mV[VRED]);
-    sqlite3_bind_double(stmt, 3,setting_color.mV[VGREEN] );
-    sqlite3_bind_double(stmt, 4,setting_color.mV[VBLUE] );
-    sqlite3_bind_double(stmt, 5,setting_color.mV[VALPHA] );
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+	// Queued for the DB thread: a color picker drag must not wait on the disk.
+	LLSqlMgr::EDatabase db = LLSqlMgr::instance().isInit() ? LLSqlMgr::AGENT_DB : LLSqlMgr::ALL_AGENTS_DB;
+	LLSD binds;
+	binds.append(setting_name);
+	binds.append(setting_color.mV[VRED]);
+	binds.append(setting_color.mV[VGREEN]);
+	binds.append(setting_color.mV[VBLUE]);
+	binds.append(setting_color.mV[VALPHA]);
+	LLSqlMgr::instance().queueWrite(db, "INSERT OR REPLACE INTO COLOR_SETTINGS (ID,R,G,B,A) VALUES (?,?,?,?,?)", binds);
 }
 
 //---------------------------------------------------------------
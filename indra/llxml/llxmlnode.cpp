@@ -140,12 +140,13 @@ LLXMLNode::LLXMLNode(const LLXMLNode& rhs) :
 LLXMLNodePtr LLXMLNode::deepCopy()
 {
 	LLXMLNodePtr newnode = LLXMLNodePtr(new LLXMLNode(*this));
+	newnode->mLineNumber = mLineNumber;
 	if (mChildren.notNull())
 	{
-		for (LLXMLChildList::iterator iter = mChildren->map.begin();
-			 iter != mChildren->map.end(); ++iter)	
+		// Copy the children in document order, which the map of names does not keep.
+		for (LLXMLNode* child = mChildren->head; child; child = child->mNext)
 		{
-			LLXMLNodePtr temp_ptr_for_gcc(iter->second->deepCopy());
+			LLXMLNodePtr temp_ptr_for_gcc(child->deepCopy());
 			newnode->addChild(temp_ptr_for_gcc);
 		}
 	}
@@ -878,6 +879,240 @@ bool LLXMLNode::parseStream(
 }
 
 
+namespace
+{
+	const S32 BINARY_MAX_DEPTH = 256;
+	// The flags byte of a node: the type and encoding, and whether the
+	// rarely used fields follow.
+	const U8 BINARY_ATTRIBUTE = 0x01;
+	const U8 BINARY_TYPE_SHIFT = 1;
+	const U8 BINARY_TYPE_MASK = 0x0e;
+	const U8 BINARY_ENCODING_SHIFT = 4;
+	const U8 BINARY_ENCODING_MASK = 0x30;
+	const U8 BINARY_EXTRA_FIELDS = 0x40;
+
+	void write_binary(std::ostream& output, U32 value)
+	{
+		// Seven bits at a time, lowest first.
+		char bytes[5];
+		S32 count = 0;
+		while (value >= 0x80)
+		{
+			bytes[count++] = (char)(value | 0x80);
+			value >>= 7;
+		}
+		bytes[count++] = (char)value;
+		output.write(bytes, count);
+	}
+
+	void write_binary(std::ostream& output, const std::string& value)
+	{
+		write_binary(output, (U32)value.size());
+		output.write(value.data(), value.size());
+	}
+}
+
+// Reads what LLXMLNode::writeBinary() writes, out of a buffer.
+class LLXMLBinaryReader
+{
+public:
+	LLXMLBinaryReader(const U8* buffer, U32 length) : mPos(buffer), mEnd(buffer + length) {}
+
+	bool read(U32& value)
+	{
+		value = 0;
+		for (S32 shift = 0; shift < 35 && mPos < mEnd; shift += 7)
+		{
+			const U8 byte = *mPos++;
+			value |= (U32)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool read(U8& value)
+	{
+		if (mPos == mEnd)
+		{
+			return false;
+		}
+		value = *mPos++;
+		return true;
+	}
+
+	bool read(std::string& value)
+	{
+		U32 length;
+		if (!read(length) || length > (U32)(mEnd - mPos))
+		{
+			return false;
+		}
+		value.assign((const char*)mPos, length);
+		mPos += length;
+		return true;
+	}
+
+	const U8* mPos;
+	const U8* mEnd;
+};
+
+void LLXMLNode::writeBinary(std::ostream& output) const
+{
+	std::map<const LLStringTableEntry*, U32> names;
+	writeBinaryNode(output, names);
+}
+
+// protected
+void LLXMLNode::writeBinaryNode(std::ostream& output, std::map<const LLStringTableEntry*, U32>& names) const
+{
+	// A name is written the first time it is used, and by its index after that.
+	std::map<const LLStringTableEntry*, U32>::iterator name = names.find(mName);
+	if (name != names.end())
+	{
+		write_binary(output, name->second + 1);
+	}
+	else
+	{
+		names.insert(std::make_pair(mName, (U32)names.size()));
+		write_binary(output, 0);
+		write_binary(output, std::string(mName ? mName->mString : ""));
+	}
+
+	const bool extra_fields = !mID.empty() || mVersionMajor || mVersionMinor || mLength || mPrecision != 64;
+	U8 flags = (U8)((mType << BINARY_TYPE_SHIFT) | (mEncoding << BINARY_ENCODING_SHIFT));
+	if (mIsAttribute)
+	{
+		flags |= BINARY_ATTRIBUTE;
+	}
+	if (extra_fields)
+	{
+		flags |= BINARY_EXTRA_FIELDS;
+	}
+	output.put((char)flags);
+	write_binary(output, mValue);
+	write_binary(output, (U32)(mLineNumber + 1));
+	if (extra_fields)
+	{
+		write_binary(output, mID);
+		write_binary(output, mVersionMajor);
+		write_binary(output, mVersionMinor);
+		write_binary(output, mLength);
+		write_binary(output, mPrecision);
+	}
+
+	write_binary(output, (U32)mAttributes.size());
+	for (LLXMLAttribList::const_iterator iter = mAttributes.begin(); iter != mAttributes.end(); ++iter)
+	{
+		iter->second->writeBinaryNode(output, names);
+	}
+
+	U32 num_children = 0;
+	for (LLXMLNode* child = mChildren.notNull() ? mChildren->head.get() : NULL; child; child = child->mNext)
+	{
+		++num_children;
+	}
+	write_binary(output, num_children);
+	for (LLXMLNode* child = mChildren.notNull() ? mChildren->head.get() : NULL; child; child = child->mNext)
+	{
+		child->writeBinaryNode(output, names);
+	}
+}
+
+// static
+bool LLXMLNode::readBinary(const U8* buffer, U32 length, LLXMLNodePtr& node)
+{
+	LLXMLBinaryReader reader(buffer, length);
+	std::vector<LLStringTableEntry*> names;
+	node = readBinaryNode(reader, names, 0);
+	if (reader.mPos != reader.mEnd)
+	{
+		node = NULL;
+	}
+	return node.notNull();
+}
+
+// static, protected
+LLXMLNodePtr LLXMLNode::readBinaryNode(LLXMLBinaryReader& reader, std::vector<LLStringTableEntry*>& names, S32 depth)
+{
+	U32 index;
+	if (depth > BINARY_MAX_DEPTH || !reader.read(index))
+	{
+		return NULL;
+	}
+	if (!index)
+	{
+		std::string name;
+		if (!reader.read(name))
+		{
+			return NULL;
+		}
+		names.push_back(gStringTable.addStringEntry(name));
+		index = (U32)names.size();
+	}
+	if (index > names.size())
+	{
+		return NULL;
+	}
+
+	U8 flags;
+	U32 line_number;
+	if (!reader.read(flags))
+	{
+		return NULL;
+	}
+	const U32 type = (flags & BINARY_TYPE_MASK) >> BINARY_TYPE_SHIFT;
+	const U32 encoding = (flags & BINARY_ENCODING_MASK) >> BINARY_ENCODING_SHIFT;
+	LLXMLNodePtr node = new LLXMLNode(names[index - 1], (flags & BINARY_ATTRIBUTE) ? TRUE : FALSE);
+	if (type > TYPE_NODEREF || encoding > ENCODING_HEX ||
+		!reader.read(node->mValue) || !reader.read(line_number))
+	{
+		return NULL;
+	}
+	node->mType = (ValueType)type;
+	node->mEncoding = (Encoding)encoding;
+	node->mLineNumber = (S32)line_number - 1;
+	if ((flags & BINARY_EXTRA_FIELDS) &&
+		(!reader.read(node->mID) || !reader.read(node->mVersionMajor) || !reader.read(node->mVersionMinor) ||
+		 !reader.read(node->mLength) || !reader.read(node->mPrecision)))
+	{
+		return NULL;
+	}
+
+	U32 num_attributes;
+	if (!reader.read(num_attributes))
+	{
+		return NULL;
+	}
+	for (U32 i = 0; i < num_attributes; ++i)
+	{
+		LLXMLNodePtr attribute = readBinaryNode(reader, names, depth + 1);
+		if (attribute.isNull() || !attribute->mIsAttribute)
+		{
+			return NULL;
+		}
+		node->addChild(attribute);
+	}
+
+	U32 num_children;
+	if (!reader.read(num_children))
+	{
+		return NULL;
+	}
+	for (U32 i = 0; i < num_children; ++i)
+	{
+		LLXMLNodePtr child = readBinaryNode(reader, names, depth + 1);
+		if (child.isNull() || child->mIsAttribute)
+		{
+			return NULL;
+		}
+		node->addChild(child);
+	}
+	return node;
+}
+
 BOOL LLXMLNode::isFullyDefault()
 {
 	if (mDefault.isNull())
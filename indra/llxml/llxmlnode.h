@@ -75,6 +75,7 @@ struct CompareAttributes
 // Defines a simple node hierarchy for reading and writing task objects
 
 class LLXMLNode;
+class LLXMLBinaryReader;
 typedef LLPointer<LLXMLNode> LLXMLNodePtr;
 typedef std::multimap<std::string, LLXMLNodePtr > LLXMLNodeList;
 typedef std::multimap<const LLStringTableEntry *, LLXMLNodePtr > LLXMLChildList;
@@ -155,6 +156,12 @@ public:
 	static LLXMLNodePtr replaceNode(LLXMLNodePtr node, LLXMLNodePtr replacement_node);
 	
 	static bool getLayeredXMLNode(LLXMLNodePtr& root, const std::vector<std::string>& paths);
+
+	// Compact binary form of a whole tree, for caches of parsed files. It is
+	// read back without expat, and is only meant to be read by the same build.
+	// readBinary() returns false, with node NULL, on truncated or corrupt data.
+	void writeBinary(std::ostream& output) const;
+	static bool readBinary(const U8* buffer, U32 length, LLXMLNodePtr& node);
 	
 
 	// Write standard XML file header:
@@ -343,6 +350,9 @@ protected:
 	static const char *parseFloat(const char *str, F64 *dest, U32 precision, Encoding encoding);
 
 	BOOL isFullyDefault();
+
+	void writeBinaryNode(std::ostream& output, std::map<const LLStringTableEntry*, U32>& names) const;
+	static LLXMLNodePtr readBinaryNode(LLXMLBinaryReader& reader, std::vector<LLStringTableEntry*>& names, S32 depth);
 };
 
 #endif // LL_LLXMLNODE
@@ -0,0 +1,172 @@
+/**
+ * @file llxmlnode_bench.cpp
+ * @brief Getting XUI trees by parsing, by copying a cached tree and from the binary form.
+ *
+ * Usage: llxmlnode_bench [widgets] [passes]
+ *
+ * Builds a floater description shaped like the preferences floater: tab
+ * panels full of widgets, each with a dozen attributes. It is then turned
+ * into a tree of nodes several times: by parsing the XML, as floaters were
+ * built before, by copying a tree that was parsed once, as the XUI cache
+ * hands them out, and by reading the binary form the cache is saved as.
+ * Every tree must write back the same XML, in the same order.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "lltimer.h"
+#include "llxmlnode.h"
+
+#include <iostream>
+#include <sstream>
+
+static const char* WIDGETS[] = { "check_box", "slider", "spinner", "combo_box", "text", "button", "line_editor" };
+
+static std::string make_floater(S32 num_widgets)
+{
+	std::ostringstream xml;
+	xml << "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\" ?>\n"
+		<< "<floater can_close=\"true\" can_drag_on_left=\"false\" can_minimize=\"true\" can_resize=\"false\"\n"
+		<< "     height=\"460\" width=\"620\" name=\"Preferences\" title=\"Preferences\">\n"
+		<< "\t<tab_container bottom=\"-440\" height=\"400\" left=\"0\" name=\"pref core\" tab_position=\"left\" width=\"620\">\n";
+	const S32 num_panels = 12;
+	for (S32 p = 0; p < num_panels; ++p)
+	{
+		xml << "\t\t<panel border=\"true\" bottom=\"-400\" height=\"400\" label=\"Panel " << p
+			<< "\" left=\"1\" name=\"panel_" << p << "\" width=\"500\">\n";
+		for (S32 w = p; w < num_widgets; w += num_panels)
+		{
+			const char* widget = WIDGETS[w % 7];
+			xml << "\t\t\t<" << widget << " bottom_delta=\"-" << 16 + w % 9 << "\" follows=\"left|top\" font=\"SansSerifSmall\""
+				<< " height=\"16\" initial_value=\"" << w * 0.25 << "\" label=\"Setting &quot;" << w << "&quot;\""
+				<< " left=\"" << 10 + w % 200 << "\" control_name=\"Setting" << w << "\" name=\"" << widget << "_" << w << "\""
+				<< " tool_tip=\"What setting " << w << " does &amp; why\" width=\"" << 100 + w % 150 << "\"";
+			if (w % 7 == 3)
+			{
+				xml << ">\n";
+				for (S32 i = 0; i < 3; ++i)
+				{
+					xml << "\t\t\t\t<combo_item name=\"item_" << i << "\" value=\"" << i << "\">Choice " << i << "</combo_item>\n";
+				}
+				xml << "\t\t\t</" << widget << ">\n";
+			}
+			else if (w % 7 == 4)
+			{
+				xml << ">Some text for setting " << w << "</" << widget << ">\n";
+			}
+			else
+			{
+				xml << " />\n";
+			}
+		}
+		xml << "\t\t</panel>\n";
+	}
+	xml << "\t</tab_container>\n"
+		<< "\t<string name=\"unsaved\">You have unsaved changes.</string>\n"
+		<< "</floater>\n";
+	return xml.str();
+}
+
+static std::string write_xml(LLXMLNodePtr& root)
+{
+	std::ostringstream out;
+	root->writeToOstream(out);
+	return out.str();
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 num_widgets = argc > 1 ? atoi(argv[1]) : 600;
+	const S32 passes = argc > 2 ? atoi(argv[2]) : 50;
+
+	std::string xml = make_floater(num_widgets);
+	LLXMLNodePtr cached;
+	if (!LLXMLNode::parseBuffer((U8*)&xml[0], xml.size(), cached, NULL))
+	{
+		std::cerr << "Could not parse the floater" << std::endl;
+		return 1;
+	}
+	const std::string expected = write_xml(cached);
+
+	std::ostringstream binary_out;
+	cached->writeBinary(binary_out);
+	const std::string binary = binary_out.str();
+
+	bool ok = true;
+	F64 times[3] = { 0.0, 0.0, 0.0 };
+	static const char* NAMES[3] = { "parse XML", "copy cached tree", "read binary form" };
+	for (S32 method = 0; method < 3; ++method)
+	{
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			LLXMLNodePtr root;
+			LLTimer timer;
+			if (method == 0)
+			{
+				LLXMLNode::parseBuffer((U8*)&xml[0], xml.size(), root, NULL);
+			}
+			else if (method == 1)
+			{
+				root = cached->deepCopy();
+			}
+			else
+			{
+				LLXMLNode::readBinary((const U8*)binary.data(), binary.size(), root);
+			}
+			times[method] += timer.getElapsedTimeF64();
+
+			if (root.isNull() || (pass == 0 && write_xml(root) != expected))
+			{
+				std::cerr << NAMES[method] << ": the tree differs from the parsed one" << std::endl;
+				ok = false;
+			}
+		}
+	}
+
+	// A truncated binary form must be refused, not half read.
+	for (size_t length = 0; length < binary.size(); length += 1 + binary.size() / 97)
+	{
+		LLXMLNodePtr root;
+		if (LLXMLNode::readBinary((const U8*)binary.data(), length, root) || root.notNull())
+		{
+			std::cerr << "A binary form truncated to " << length << " bytes was read" << std::endl;
+			ok = false;
+		}
+	}
+
+	std::cout << llformat("%d widgets, %d bytes of XML, %d bytes of binary form", num_widgets, (S32)xml.size(),
+						  (S32)binary.size()) << std::endl;
+	for (S32 method = 0; method < 3; ++method)
+	{
+		std::cout << llformat("%-17s %7.3fms per floater | %4.1fx", NAMES[method], times[method] * 1000.0 / passes,
+							  times[0] / times[method]) << std::endl;
+	}
+
+	return ok ? 0 : 1;
+}
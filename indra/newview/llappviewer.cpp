@@ -37,8 +37,12 @@
 #include "hippolimits.h"
 
 #include "llversioninfo.h"
+#include "llsqlmgr.h"
+#include "lllogchat.h"
+#include "llterraincompositor.h"
 #include "llfeaturemanager.h"
 #include "lluictrlfactory.h"
+#include "llxuicache.h"
 #include "lltexteditor.h"
 #include "llerrorcontrol.h"
 #include "lleventtimer.h"
@@ -120,6 +124,7 @@
 
 #include "llnotify.h"
 #include "llviewerkeyboard.h"
+#include "lljobsystem.h"
 #include "lllfsthread.h"
 #include "llworkerthread.h"
 #include "lltexturecache.h"
@@ -186,6 +191,7 @@
 #include "llgesturemgr.h"
 #include "llsky.h"
 #include "llvlmanager.h"
+#include "llobjectupdatedecoder.h"
 #include "llviewercamera.h"
 #include "lldrawpoolbump.h"
 #include "llvieweraudio.h"
@@ -1072,6 +1078,11 @@ bool LLAppViewer::init()
 	}
 	LL_INFOS("InitInfo") << "Cache initialization is done." << LL_ENDL ;
 
+	if (gSavedSettings.getBOOL("XUICacheFile"))
+	{
+		LLXUICache::loadFromFile(LLXUICache::getCacheFilename());
+	}
+
 	// Initialize the repeater service.
 	LLMainLoopRepeater::instance().start();
 
@@ -1839,6 +1850,11 @@ bool LLAppViewer::cleanup()
 	LLPrimitive::cleanupVolumeManager();
 	LLWorldMapView::cleanupClass();
 	LLFolderViewItem::cleanupClass();
+	if (gSavedSettings.getBOOL("XUICacheFile"))
+	{
+		LLXUICache::saveToFile(LLXUICache::getCacheFilename());
+	}
+	LLXUICache::clear();
 	LLUI::cleanupClass();
 	
 	//
@@ -1962,6 +1978,17 @@ bool LLAppViewer::cleanup()
     sTextureFetch = nullptr;
 	delete sImageDecodeThread;
     sImageDecodeThread = nullptr;
+	LLTerrainCompositeThread::cleanupClass();
+	LLVLDecodeThread::cleanupClass();
+	gObjectUpdateDecoder.clear();
+	LLObjectUpdateDecodeThread::cleanupClass();
+	LLJobSystem::cleanupClass();
+
+	// Commit whatever the UI queued for the settings DB and stop its thread.
+	LLSqlMgr::instance().close();
+
+	// Write out the chat and IM lines still queued and close the logs.
+	LLLogChat::cleanupClass();
 
 
 
@@ -2088,12 +2115,18 @@ bool LLAppViewer::initThreads()
 	AICurlInterface::startCurlThread(&gSavedSettings);
 
 	LLImage::initClass();
+
+	// Worker pool shared by the texture cache, image decode and terrain threads below.
+	LLJobSystem::initClass(gSavedSettings.getU32("JobSystemWorkers"));
 	
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
 	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true, gSavedSettings.getU32("ImageDecodeThreads"));
+	LLTerrainCompositeThread::initClass(enable_threads && true);
+	LLVLDecodeThread::initClass(enable_threads && gSavedSettings.getBOOL("LayerDataDecodeThread"));
+	LLObjectUpdateDecodeThread::initClass(enable_threads && gSavedSettings.getBOOL("ObjectUpdateDecodeThread"));
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(),
 													sImageDecodeThread,
@@ -3571,7 +3604,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 15;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
@@ -4730,6 +4763,9 @@ void LLAppViewer::idleNetwork()
 			total_decoded++;
 			gPacketsIn++;
 
+			// Apply the object updates decoded so far.
+			gMessageSystem->finishDeferredWork(false);
+
 			if (total_decoded > MESSAGE_MAX_PER_FRAME)
 			{
 				break;
@@ -4746,6 +4782,10 @@ void LLAppViewer::idleNetwork()
 #endif
 		}
 
+		// Apply the rest of the object updates before anything else looks
+		// at the objects this frame.
+		gMessageSystem->finishDeferredWork(true);
+
 		// Handle per-frame message system processing.
 		gMessageSystem->processAcks();
 
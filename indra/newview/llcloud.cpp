@@ -72,9 +72,6 @@ enum
 	LL_PUFF_DYING = 1
 };
 
-// Used for patch decoder
-S32 gBuffer[16*16];
-
 
 //static
 S32 LLCloudPuff::sPuffCount = 0;
@@ -430,20 +427,15 @@ F32 LLCloudLayer::getDensityRegion(const LLVector3 &pos_region)
 	return density;
 }
 
-void LLCloudLayer::decompress(LLBitPack &bitpack, LLGroupHeader *group_headerp)
+void LLCloudLayer::decompress(const LLPatchGroup &group)
 {
-	LLPatchHeader  patch_header;
-
-	init_patch_decompressor(group_headerp->patch_size);
-
-	// Don't use the packed group_header stride because the strides used on
-	// simulator and viewer are not equal.
-	group_headerp->stride = group_headerp->patch_size; 		// offset required to step up one row
-	set_group_of_patch_header(group_headerp);
-
-	decode_patch_header(bitpack, &patch_header);
-	decode_patch(bitpack, gBuffer);
-	decompress_patch(mDensityp, gBuffer, &patch_header); 
+	if (group.getPatchCount() < 1 || group.mGroupHeader.patch_size != CLOUD_GRIDS_PER_EDGE)
+	{
+		LL_WARNS() << "Unexpected cloud layer data, " << group.getPatchCount()
+				   << " patches of size " << group.mGroupHeader.patch_size << LL_ENDL;
+		return;
+	}
+	memcpy(mDensityp, group.getPatchValues(0), CLOUD_GRIDS_PER_EDGE * CLOUD_GRIDS_PER_EDGE * sizeof(F32));
 }
 
 void LLCloudLayer::updatePuffs(const F32 dt)
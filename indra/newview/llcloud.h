@@ -85,8 +85,7 @@ class LLWind;
 class LLVOClouds;
 class LLViewerRegion;
 class LLCloudLayer;
-class LLBitPack;
-class LLGroupHeader;
+class LLPatchGroup;
 
 #if ENABLE_CLASSIC_CLOUDS
 const S32 CLOUD_GROUPS_PER_EDGE = 4;
@@ -176,7 +175,7 @@ public:
 
 	F32 getDensityRegion(const LLVector3 &pos_region);		// "position" is in local coordinates
 
-	void decompress(LLBitPack &bitpack, LLGroupHeader *group_header);
+	void decompress(const LLPatchGroup &group);
 
 	LLCloudLayer* getNeighbor(const S32 n) const					{ return mNeighbors[n]; }
 
@@ -60,7 +60,6 @@
 #include "llsdserialize.h"
 #include "llxuiparser.h"
 #include "llsqlmgr.h"
-#include "sqlite3.h"
 using namespace LLOldEvents;
 typedef LLMemberListener<LLView> view_listener_t;
 void open_landmark(LLViewerInventoryItem* inv_item, const std::string& title, BOOL show_keep_discard, const LLUUID& source_id, BOOL take_focus);
@@ -1676,24 +1675,13 @@ void LLFavoritesOrderStorage::load()
 {
 
 	LL_INFOS() << "Loading fav bar order" << LL_ENDL;
-	 
-	char *sql;
-	sqlite3_stmt *stmt;
-	sqlite3 *db = LLSqlMgr::instance().getDB();
-    sql = "SELECT FAV_UUID, FAV_ORDER FROM FAV_BAR_ORDER";
-	sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-	while ( sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *id = sqlite3_column_text(stmt, 0);
-      int order = sqlite3_column_int(stmt, 1);
-      mSortIndexes.insert(std::make_pair(LLUUID(std::string(reinterpret_cast<const char*>(id))), (S32)order));
-	
-      
-      
-    }
 
-	sqlite3_finalize(stmt);
-
-		
+	LLSqlMgr::rows_t rows = LLSqlMgr::instance().queueRead(LLSqlMgr::AGENT_DB,
+		"SELECT FAV_UUID, FAV_ORDER FROM FAV_BAR_ORDER").get();
+	for (const LLSD& row : rows)
+	{
+		mSortIndexes.insert(std::make_pair(LLUUID(row[0].asString()), (S32)row[1].asInteger()));
+	}
 }
 
 void LLFavoritesOrderStorage::saveFavoritesSLURLs()
@@ -1843,27 +1831,15 @@ void LLFavoritesOrderStorage::storeFavoriteSLURL(const LLUUID& asset_id, std::st
 
 void LLFavoritesOrderStorage::save()
 {
-	
-	char *sql;
-	sqlite3_stmt *stmt;
-	sqlite3 *db = LLSqlMgr::instance().getDB();
-	sql = "DELETE FROM FAV_BAR_ORDER";
-	sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	sql = "INSERT INTO FAV_BAR_ORDER (FAV_UUID,FAV_ORDER) VALUES (?,?)";
-	sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-		for(sort_index_map_t::const_iterator iter = mSortIndexes.begin(); iter != mSortIndexes.end(); ++iter)
-		{
-			
-			sqlite3_bind_text(stmt, 1,  iter->first.asString().c_str(), strlen(iter->first.asString().c_str()), 0);
-			sqlite3_bind_int(stmt,2, iter->second);
-			sqlite3_step(stmt);
-			sqlite3_reset(stmt);
-		}
-	sqlite3_finalize(stmt);
-            
-
+	// Queued for the DB thread, which commits pending writes in batched transactions.
+	LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "DELETE FROM FAV_BAR_ORDER");
+	for(sort_index_map_t::const_iterator iter = mSortIndexes.begin(); iter != mSortIndexes.end(); ++iter)
+	{
+		LLSD binds;
+		binds.append(iter->first);
+		binds.append(iter->second);
+		LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "INSERT INTO FAV_BAR_ORDER (FAV_UUID,FAV_ORDER) VALUES (?,?)", binds);
+	}
 }
 
 
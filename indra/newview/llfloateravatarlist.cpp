@@ -278,6 +278,7 @@ LLFloaterAvatarList::~LLFloaterAvatarList()
 
 	gSavedSettings.setLLSD("RadarSortOrder", sort);
 	mAvatars.clear();
+	mAvatarIndex.clear();
 }
 
 //static
@@ -617,13 +618,19 @@ void LLFloaterAvatarList::updateAvatarList(const LLViewerRegion* region, bool fi
 		const LLVector3d& origin(region->getOriginGlobal());
 		const F32 max_range(radar_range_radius() * radar_range_radius());
 
+		// Nobody in a region that is wholly out of range can be in range.
+		const F64 width(region->getWidth());
+		const F64 dx(llmax(llmax(origin.mdV[VX] - mypos.mdV[VX], mypos.mdV[VX] - origin.mdV[VX] - width), 0.0));
+		const F64 dy(llmax(llmax(origin.mdV[VY] - mypos.mdV[VY], mypos.mdV[VY] - origin.mdV[VY] - width), 0.0));
+		const bool region_in_range(!max_range || dx * dx + dy * dy <= max_range);
+
 		static LLCachedControl<bool> announce(gSavedSettings, "RadarChatKeys");
 		std::queue<LLUUID> announce_keys;
 
 		bool no_names(gRlvHandler.hasBehaviour(RLV_BHVR_SHOWNAMETAGS));
 		bool anon_names(!no_names && gRlvHandler.hasBehaviour(RLV_BHVR_SHOWNAMES));
 		const std::string& rlv_hidden(RlvStrings::getString(RLV_STRING_HIDDEN));
-		for (size_t i = 0, size = map_avs.size(); i < size; ++i)
+		for (size_t i = 0, size = region_in_range ? map_avs.size() : 0; i < size; ++i)
 		{
 			const LLUUID& avid = map_avids[i];
 			LLVector3d position(unpackLocalToGlobalPosition(map_avs[i], origin));
@@ -646,6 +653,7 @@ void LLFloaterAvatarList::updateAvatarList(const LLViewerRegion* region, bool fi
 				// Avatar not there yet, add it
 				if (announce && gAgent.getRegion()->pointInRegionGlobal(position)) announce_keys.push(avid);
 				mAvatars.push_back(LLAvatarListEntryPtr(entry = new LLAvatarListEntry(avid, name, position)));
+				mAvatarIndex[avid] = entry;
 			}
 
 			// Announce position
@@ -691,14 +699,15 @@ void LLFloaterAvatarList::expireAvatarList(const std::list<LLUUID>& ids)
 {
 	if (!ids.empty())
 	{
-		uuid_vec_t existing_avs;
+		uuid_set_t existing_avs;
 		std::vector<LLViewerRegion*> neighbors;
 		gAgent.getRegion()->getNeighboringRegions(neighbors);
 		for (const LLViewerRegion* region : neighbors)
-			existing_avs.insert(existing_avs.end(), region->mMapAvatarIDs.begin(), region->mMapAvatarIDs.end());
+			existing_avs.insert(region->mMapAvatarIDs.begin(), region->mMapAvatarIDs.end());
 		for (const LLUUID& id : ids)
 		{
-			if (std::find(existing_avs.begin(), existing_avs.end(), id) != existing_avs.end()) continue; // Now in another region we know.
+			if (existing_avs.count(id)) continue; // Now in another region we know.
+			if (!mAvatarIndex.erase(id)) continue;
 			av_list_t::iterator it(std::find_if(mAvatars.begin(), mAvatars.end(), LLAvatarListEntry::uuidMatch(id)));
 			if (it != mAvatars.end())
 				mAvatars.erase(it);
@@ -820,11 +829,11 @@ void LLFloaterAvatarList::refreshAvatarList()
 			//<edit> custom colors for certain types of avatars!
 			getCustomColorRLV(av_id, color, LLWorld::getInstance()->getRegionFromPosGlobal(entry->getPosition()), name_restricted);
 			//Genesis : Add Contact set to name
-			std::string csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(av_id.asString());
+			const std::string& csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(av_id);
 			if (!csName.empty()) {
 				if (gSavedSettings.getBOOL("ShowContactSetOnRadar"))
 					name.value = entry->getName()+ " (" + csName + ")";
-				name.color = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(av_id.asString());
+				name.color = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(av_id);
 			} else {
 				name.color = color*0.5f + unselected_color*0.5f;
 			}
@@ -1084,7 +1093,10 @@ void LLFloaterAvatarList::refreshAvatarList()
 	}
 
 	for (auto& dead : dead_entries)
+	{
+		mAvatarIndex.erase(dead->getID());
 		mAvatars.erase(std::remove(mAvatars.begin(), mAvatars.end(), dead), mAvatars.end());
+	}
 
 	if (mAvatars.empty())
 		setTitle(getString("Title"));
@@ -1205,8 +1217,8 @@ void LLFloaterAvatarList::trackAvatar(const LLAvatarListEntry* entry) const
 
 LLAvatarListEntry* LLFloaterAvatarList::getAvatarEntry(const LLUUID& avatar) const
 {
-	av_list_t::const_iterator iter = std::find_if(mAvatars.begin(),mAvatars.end(),LLAvatarListEntry::uuidMatch(avatar));
-	return (iter != mAvatars.end()) ? iter->get() : NULL;
+	boost::unordered_map<LLUUID, LLAvatarListEntry*>::const_iterator iter = mAvatarIndex.find(avatar);
+	return (iter != mAvatarIndex.end()) ? iter->second : NULL;
 }
 
 BOOL LLFloaterAvatarList::handleKeyHere(KEY key, MASK mask)
@@ -28,6 +28,7 @@
 #include <set>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 class LLFloaterAvatarList;
 
@@ -337,6 +338,8 @@ private:
 	 */
 	LLScrollListCtrl*			mAvatarList;
 	av_list_t	mAvatars;
+	// The entries of mAvatars by avatar ID
+	boost::unordered_map<LLUUID, LLAvatarListEntry*> mAvatarIndex;
 	bool		mDirtyAvatarSorting;
 	bool		mCleanup = false;
 
@@ -246,10 +246,10 @@ void add_timestamped_line(LLViewerTextEditor* edit, LLChat chat, const LLColor4&
 	bool hasContactSet = FALSE;
 	LLColor4 contactSetColor;
 	if (chat.mSourceType == CHAT_SOURCE_AGENT && chat.mFromID.notNull()) {
-		std::string csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(chat.mFromID.asString());
+		const std::string& csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(chat.mFromID);
 		if (!csName.empty() && gSavedSettings.getBOOL("ShowContactSetOnLocalChat")) {
 			hasContactSet = TRUE;
-			contactSetColor = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(chat.mFromID.asString());
+			contactSetColor = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(chat.mFromID);
 			LLStyleSP style(new LLStyle);
 			style->mItalic = is_irc;
 			style->setColor(contactSetColor);
@@ -548,6 +548,7 @@ void LLFolderView::filter( LLInventoryFilter& filter )
 {
 	LL_RECORD_BLOCK_TIME(FTM_FILTER);
 	filter.setFilterCount(llclamp(gSavedSettings.getS32("FilterItemsPerFrame"), 1, 5000));
+	filter.setFilterTimeLimit(llclamp(gSavedSettings.getF32("FilterTimePerFrame"), 0.f, 100.f) / 1000.f);
 
 	if (getCompletedFilterGeneration() < filter.getCurrentGeneration())
 	{
@@ -835,7 +835,7 @@ void LLFloaterIMPanel::addHistoryLine(const std::string &utf8msg, LLColor4 incol
 			LLStyleSP source_style = LLStyleMap::instance().lookupAgent(source);
 			source_style->mItalic = is_irc;
 			mHistoryEditor->appendText(show_name,false,prepend_newline,source_style, system);
-			std::string csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(source.asString());
+			const std::string& csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(source);
 			if (!csName.empty()) {
 				mHistoryEditor->appendText(" (" + csName +")",false,prepend_newline,source_style, system);
 				
@@ -1195,6 +1195,7 @@ void show_genesis_group_support(const LLUUID& id)
 
 void show_log_browser(const std::string& name, const LLUUID& id)
 {
+	LLLogChat::flush(); // The browser should see the lines still queued
 	const std::string file(LLLogChat::makeLogFileName(name, id));
 	if (!LLFile::isfile(file))
 	{
@@ -97,9 +97,9 @@ LLColor4 agent_chat_color(const LLUUID& id, const std::string& name, bool local_
 	static const LLCachedControl<bool> color_friend_chat("ColorFriendChat");
 	if (color_friend_chat && LLAvatarTracker::instance().isBuddy(id))
 		return gSavedSettings.getColor4("AscentFriendColor");
-	std::string csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(id.asString());
+	const std::string& csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(id);
 	if (!csName.empty()) {
-		return LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(id.asString());
+		return LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(id);
 	}
 	static const LLCachedControl<bool> color_eo_chat("ColorEstateOwnerChat");
 	if (color_eo_chat)
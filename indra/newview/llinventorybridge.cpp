@@ -3208,6 +3208,11 @@ void LLFolderBridge::openItem()
 	LLInventoryModel* model = getInventoryModel();
 	if(!model) return;
 	if(mUUID.isNull()) return;
+	LLInventoryPanel* panel = mInventoryPanel.get();
+	if (panel)
+	{
+		panel->buildDeferredViews(mUUID);
+	}
 	bool fetching_inventory = model->fetchDescendentsOf(mUUID);
 	// Only change folder type if we have the folder contents.
 	if (!fetching_inventory)
@@ -0,0 +1,586 @@
+/**
+ * @file llinventorycache.cpp
+ * @brief Reading and writing the inventory cache: the binary format that
+ * is mapped in place, and the gzipped text format it replaced.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorycache.h"
+
+#include "llfile.h"
+#include "lljobsystem.h"
+#include "llmemorystream.h"
+#include "llstring.h"
+#include "llinventory.h"
+#include "llthread.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#ifdef LL_STANDALONE
+#include <zlib.h>
+#else
+#include "zlib/zlib.h"
+#endif
+
+static const size_t READ_CHUNK_SIZE = 256 * 1024;		// inflated per gzread()
+static const size_t READ_BATCH_SIZE = 1024 * 1024;		// text handed to one job, a few thousand records
+static const U32 WRITE_BATCH_RECORDS = 2048;
+
+static LLJobSystem::channel_t get_channel()
+{
+	// Channels live as long as the job system.
+	static LLJobSystem::channel_t channel = LLJobSystem::NO_CHANNEL;
+	if (channel == LLJobSystem::NO_CHANNEL && LLJobSystem::getInstance())
+	{
+		channel = LLJobSystem::getInstance()->addChannel("InventoryCache", LLJobSystem::PRIORITY_HIGH, 0);
+	}
+	return channel;
+}
+
+// The jobs of one read() or write().
+class LLInventoryCacheJobs
+{
+public:
+	LLInventoryCacheJobs() : mPending(0) {}
+	~LLInventoryCacheJobs() { wait(); }
+
+	// Runs func on the job system, or right away without one. done, when
+	// given, is set once func has returned.
+	void run(const std::function<void()>& func, bool* done = NULL)
+	{
+		LLJobSystem* jobs = LLJobSystem::getInstance();
+		LLJobSystem::channel_t channel = get_channel();
+		if (!jobs || channel == LLJobSystem::NO_CHANNEL)
+		{
+			func();
+			if (done)
+			{
+				*done = true;
+			}
+			return;
+		}
+
+		mCondition.lock();
+		++mPending;
+		mCondition.unlock();
+		jobs->submit(channel, [this, func, done]()
+			{
+				func();
+				mCondition.lock();
+				if (done)
+				{
+					*done = true;
+				}
+				--mPending;
+				mCondition.broadcast();
+				mCondition.unlock();
+			});
+	}
+
+	// Waits until *done is set, or until every job has run.
+	void wait(const bool* done = NULL)
+	{
+		mCondition.lock();
+		while (done ? !*done : mPending > 0)
+		{
+			mCondition.wait();
+		}
+		mCondition.unlock();
+	}
+
+private:
+	LLCondition mCondition;
+	S32 mPending;
+};
+
+static void parse_batch(LLInventoryCache::Batch* batch, const std::string& text)
+{
+	LLMemoryStream input((const U8*)text.data(), text.size());
+	// *NOTE: This buffer size is hard coded into scanf() below.
+	char buffer[MAX_STRING];		/*Flawfinder: ignore*/
+	char keyword[MAX_STRING];		/*Flawfinder: ignore*/
+	while (input.good())
+	{
+		input.getline(buffer, MAX_STRING);
+		if (sscanf(buffer, " %254s", keyword) < 1)	/* Flawfinder: ignore */
+		{
+			continue;
+		}
+		if (0 == strcmp("inv_category", keyword) || 0 == strcmp("inv_item", keyword))
+		{
+			batch->parseRecord(keyword, input);
+		}
+		else
+		{
+			LL_WARNS("Inventory") << "Unknown token in inventory file '" << keyword << "'" << LL_ENDL;
+		}
+	}
+}
+
+static gzFile open_gz(const std::string& filename, const char* mode)
+{
+#if LL_WINDOWS
+	return gzopen_w(utf8str_to_utf16str(filename).c_str(), mode);
+#else
+	return gzopen(filename.c_str(), mode);
+#endif
+}
+
+//static
+LLInventoryCache::EStatus LLInventoryCache::read(const std::string& filename, S32 version,
+												 const batch_factory_t& factory, std::vector<Batch*>& batches)
+{
+	gzFile src = open_gz(filename, "rb");
+	if (!src)
+	{
+		return CACHE_MISSING;
+	}
+
+	EStatus status = CACHE_OK;
+	std::vector<char> chunk(READ_CHUNK_SIZE);
+	std::string pending;
+	bool header_read = false;
+	LLInventoryCacheJobs jobs;
+	while (true)
+	{
+		int bytes = gzread(src, chunk.data(), chunk.size());
+		if (bytes < 0)
+		{
+			LL_WARNS("Inventory") << "Error inflating " << filename << ": " << gzerror(src, NULL) << LL_ENDL;
+			status = CACHE_CORRUPT;
+			break;
+		}
+		const bool at_end = (bytes == 0);
+		pending.append(chunk.data(), bytes);
+
+		if (!header_read)
+		{
+			size_t eol = pending.find('\n');
+			if (eol == std::string::npos && !at_end)
+			{
+				continue;
+			}
+			char keyword[MAX_STRING];		/*Flawfinder: ignore*/
+			S32 file_version = 0;
+			if (sscanf(pending.substr(0, eol).c_str(), " %254s %d", keyword, &file_version) != 2 ||	/* Flawfinder: ignore */
+				0 != strcmp("inv_cache_version", keyword) || file_version != version)
+			{
+				status = CACHE_OBSOLETE;
+				break;
+			}
+			pending.erase(0, eol == std::string::npos ? pending.size() : eol + 1);
+			header_read = true;
+		}
+
+		// Cut before the last record that may still be incomplete.
+		size_t cut = pending.size();
+		if (!at_end)
+		{
+			if (pending.size() < READ_BATCH_SIZE)
+			{
+				continue;
+			}
+			cut = pending.rfind("\n\tinv_");
+			if (cut == std::string::npos)
+			{
+				continue;
+			}
+			++cut;
+		}
+		if (cut)
+		{
+			Batch* batch = factory();
+			batches.push_back(batch);
+			std::shared_ptr<std::string> text = std::make_shared<std::string>(pending, 0, cut);
+			pending.erase(0, cut);
+			jobs.run([batch, text]() { parse_batch(batch, *text); });
+		}
+		if (at_end)
+		{
+			break;
+		}
+	}
+	gzclose(src);
+	jobs.wait();
+	return status;
+}
+
+//static
+bool LLInventoryCache::write(const std::string& filename, S32 version, U32 count, const export_func_t& func)
+{
+	std::string tmpfile = filename + ".t";
+	gzFile dst = open_gz(tmpfile, "wb");
+	if (!dst)
+	{
+		LL_WARNS("Inventory") << "unable to save inventory to: " << filename << LL_ENDL;
+		return false;
+	}
+
+	std::string header = llformat("\tinv_cache_version\t%d\n", version);
+	bool success = gzwrite(dst, header.data(), header.size()) > 0;
+
+	const U32 num_batches = (count + WRITE_BATCH_RECORDS - 1) / WRITE_BATCH_RECORDS;
+	std::vector<std::string> texts(num_batches);
+	std::unique_ptr<bool[]> done(new bool[num_batches]());
+	{
+		LLInventoryCacheJobs jobs;
+		for (U32 b = 0; b < num_batches; ++b)
+		{
+			jobs.run([&func, &texts, b, count]()
+				{
+					std::ostringstream output;
+					const U32 end = llmin(count, (b + 1) * WRITE_BATCH_RECORDS);
+					for (U32 i = b * WRITE_BATCH_RECORDS; i < end; ++i)
+					{
+						func(i, output);
+					}
+					texts[b] = output.str();
+				}, &done[b]);
+		}
+		// zlib compresses on this thread, in file order, while the
+		// batches further on are still being exported.
+		for (U32 b = 0; success && b < num_batches; ++b)
+		{
+			jobs.wait(&done[b]);
+			success = texts[b].empty() || gzwrite(dst, texts[b].data(), texts[b].size()) > 0;
+			std::string().swap(texts[b]);
+		}
+		if (!success)
+		{
+			LL_WARNS("Inventory") << "gzwrite failed: " << gzerror(dst, NULL) << LL_ENDL;
+		}
+	}	// waits for any job left after an error
+
+	success = (gzclose(dst) == Z_OK) && success;
+	if (!success)
+	{
+		LLFile::remove(tmpfile);
+		return false;
+	}
+#if LL_WINDOWS
+	// Rename in windows needs the dstfile to not exist.
+	LLFile::remove(filename, ENOENT);
+#endif
+	return LLFile::rename(tmpfile, filename) == 0;
+}
+
+//----------------------------------------------------------------------------
+// LLInventoryCacheFile
+
+static const char CACHE_FILE_MAGIC[4] = { 'I', 'N', 'V', 'B' };
+
+namespace
+{
+	struct folder_id_less
+	{
+		bool operator()(const LLInventoryCacheFile::Folder& folder, const LLUUID& id) const
+		{
+			return folder.mID < id;
+		}
+	};
+
+	struct item_id_less
+	{
+		bool operator()(const LLInventoryCacheFile::ItemIndex& index, const LLUUID& id) const
+		{
+			return index.mID < id;
+		}
+	};
+}
+
+LLInventoryCacheFile::LLInventoryCacheFile()
+:	mHeader(NULL),
+	mFolders(NULL),
+	mItems(NULL),
+	mIndex(NULL),
+	mLinks(NULL),
+	mPool(NULL)
+{
+}
+
+bool LLInventoryCacheFile::open(const std::string& filename, S32 version)
+{
+	close();
+	if (!LLFile::isfile(filename) || !mFile.open(filename, LLMappedFile::COPY_ON_WRITE))
+	{
+		return false;
+	}
+
+	const size_t size = mFile.getSize();
+	const U8* data = mFile.getData();
+	const Header* header = (const Header*)data;
+	if (size < sizeof(Header) || memcmp(header->mMagic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC)))
+	{
+		LL_WARNS("Inventory") << "Not an inventory cache: " << filename << LL_ENDL;
+		mFile.close();
+		return false;
+	}
+	if (header->mVersion != version)
+	{
+		LL_INFOS("Inventory") << "Inventory cache " << filename << " is version " << header->mVersion
+							  << ", expected " << version << LL_ENDL;
+		mFile.close();
+		return false;
+	}
+	const U64 expected_size = sizeof(Header) + (U64)header->mNumFolders * sizeof(Folder) +
+							  (U64)header->mNumItems * (sizeof(Item) + sizeof(ItemIndex)) +
+							  (U64)header->mNumLinks * sizeof(U32) + header->mPoolSize;
+	if (expected_size != size || !header->mPoolSize || data[size - 1] != '\0' ||
+		header->mNumLinks > header->mNumItems)
+	{
+		LL_WARNS("Inventory") << "Corrupted inventory cache " << filename << LL_ENDL;
+		mFile.close();
+		return false;
+	}
+
+	const Folder* folders = (const Folder*)(data + sizeof(Header));
+	const Item* items = (const Item*)(folders + header->mNumFolders);
+	const ItemIndex* index = (const ItemIndex*)(items + header->mNumItems);
+	const U32* links = (const U32*)(index + header->mNumItems);
+	for (U32 i = 0; i < header->mNumFolders; ++i)
+	{
+		const Folder& folder = folders[i];
+		if ((i && !(folders[i - 1].mID < folder.mID)) ||
+			(U64)folder.mFirstItem + folder.mNumItems > header->mNumItems)
+		{
+			LL_WARNS("Inventory") << "Corrupted folder table in inventory cache " << filename << LL_ENDL;
+			mFile.close();
+			return false;
+		}
+	}
+	for (U32 i = 0; i < header->mNumLinks; ++i)
+	{
+		if (links[i] >= header->mNumItems)
+		{
+			LL_WARNS("Inventory") << "Corrupted link table in inventory cache " << filename << LL_ENDL;
+			mFile.close();
+			return false;
+		}
+	}
+
+	mFilename = filename;
+	mHeader = header;
+	mFolders = folders;
+	mItems = items;
+	mIndex = index;
+	mLinks = links;
+	mPool = (const char*)(links + header->mNumLinks);
+	return true;
+}
+
+void LLInventoryCacheFile::close()
+{
+	mFile.close();
+	mHeader = NULL;
+	mFolders = NULL;
+	mItems = NULL;
+	mIndex = NULL;
+	mLinks = NULL;
+	mPool = NULL;
+}
+
+const LLInventoryCacheFile::Folder* LLInventoryCacheFile::findFolder(const LLUUID& id) const
+{
+	if (!mHeader)
+	{
+		return NULL;
+	}
+	const Folder* end = mFolders + mHeader->mNumFolders;
+	const Folder* folder = std::lower_bound(mFolders, end, id, folder_id_less());
+	return (folder != end && folder->mID == id) ? folder : NULL;
+}
+
+const LLInventoryCacheFile::Item* LLInventoryCacheFile::findItem(const LLUUID& id) const
+{
+	if (!mHeader)
+	{
+		return NULL;
+	}
+	const ItemIndex* end = mIndex + mHeader->mNumItems;
+	const ItemIndex* index = std::lower_bound(mIndex, end, id, item_id_less());
+	if (index == end || index->mID != id || index->mItem >= mHeader->mNumItems)
+	{
+		return NULL;
+	}
+	return mItems + index->mItem;
+}
+
+const char* LLInventoryCacheFile::getString(U32 offset) const
+{
+	// The pool ends with a NUL, checked by open().
+	return (mHeader && offset < mHeader->mPoolSize) ? mPool + offset : "";
+}
+
+void LLInventoryCacheFile::importItem(const Item& record, LLInventoryItem* item) const
+{
+	LLPermissions perm;
+	perm.init(record.mCreatorID, record.mOwnerID, record.mLastOwnerID, record.mGroupID);
+	perm.initMasks(record.mBaseMask, record.mOwnerMask, record.mEveryoneMask, record.mGroupMask,
+				   record.mNextOwnerMask);
+	perm.yesReallySetOwner(record.mOwnerID, record.mGroupOwned != 0);
+
+	item->setUUID(record.mID);
+	item->setParent(record.mParentID);
+	item->setType((LLAssetType::EType)record.mType);
+	item->setInventoryType((LLInventoryType::EType)record.mInventoryType);
+	item->setAssetUUID(record.mAssetID);
+	item->setPermissions(perm);
+	item->setSaleInfo(LLSaleInfo((LLSaleInfo::EForSale)record.mSaleType, record.mSalePrice));
+	item->setFlags(record.mFlags);
+	item->setCreationDate((time_t)record.mCreationDate);
+	item->rename(getString(record.mName));
+	item->setDescription(getString(record.mDescription));
+}
+
+LLInventoryCacheFile::Writer::Writer()
+{
+	// Offset 0 is the empty string.
+	mPool.push_back('\0');
+	mPoolOffsets[std::string()] = 0;
+}
+
+void LLInventoryCacheFile::Writer::addFolder(const LLUUID& id, S32 version)
+{
+	Folder folder;
+	folder.mID = id;
+	folder.mVersion = version;
+	folder.mFirstItem = (U32)mItems.size();
+	folder.mNumItems = 0;
+	mFolders.push_back(folder);
+}
+
+void LLInventoryCacheFile::Writer::addItem(const LLInventoryItem* item)
+{
+	// LLViewerInventoryItem follows links in most accessors; the base class
+	// gives the item's own values, as LLInventoryItem::exportLegacyStream()
+	// writes them.
+	const LLPermissions& perm = item->LLInventoryItem::getPermissions();
+	const LLSaleInfo& sale_info = item->LLInventoryItem::getSaleInfo();
+
+	Item record;
+	record.mID = item->getUUID();
+	record.mParentID = item->getParentUUID();
+	record.mAssetID = item->LLInventoryItem::getAssetUUID();
+	record.mCreatorID = perm.getCreator();
+	record.mOwnerID = perm.getOwner();
+	record.mLastOwnerID = perm.getLastOwner();
+	record.mGroupID = perm.getGroup();
+	record.mBaseMask = perm.getMaskBase();
+	record.mOwnerMask = perm.getMaskOwner();
+	record.mGroupMask = perm.getMaskGroup();
+	record.mEveryoneMask = perm.getMaskEveryone();
+	record.mNextOwnerMask = perm.getMaskNextOwner();
+	record.mFlags = item->LLInventoryItem::getFlags();
+	record.mSalePrice = sale_info.getSalePrice();
+	record.mCreationDate = (S32)item->LLInventoryItem::getCreationDate();
+	record.mName = addString(item->LLInventoryItem::getName());
+	record.mDescription = addString(item->LLInventoryItem::getDescription());
+	record.mType = (S8)item->getActualType();
+	record.mInventoryType = (S8)item->LLInventoryItem::getInventoryType();
+	record.mSaleType = (U8)sale_info.getSaleType();
+	record.mGroupOwned = perm.isGroupOwned() ? 1 : 0;
+	pushItem(record);
+}
+
+void LLInventoryCacheFile::Writer::addItem(const LLInventoryCacheFile& file, const Item& record)
+{
+	Item copy = record;
+	copy.mName = addString(file.getString(record.mName));
+	copy.mDescription = addString(file.getString(record.mDescription));
+	pushItem(copy);
+}
+
+U32 LLInventoryCacheFile::Writer::addString(const std::string& str)
+{
+	// Descriptions in particular repeat a lot.
+	std::pair<boost::unordered_map<std::string, U32>::iterator, bool> inserted =
+		mPoolOffsets.insert(std::make_pair(str, (U32)mPool.size()));
+	if (inserted.second)
+	{
+		mPool.append(str.c_str(), str.size() + 1);
+	}
+	return inserted.first->second;
+}
+
+void LLInventoryCacheFile::Writer::pushItem(const Item& record)
+{
+	llassert(!mFolders.empty() && record.mParentID == mFolders.back().mID);
+	if (LLAssetType::lookupIsLinkType((LLAssetType::EType)record.mType))
+	{
+		mLinks.push_back((U32)mItems.size());
+	}
+	mItems.push_back(record);
+	++mFolders.back().mNumItems;
+}
+
+bool LLInventoryCacheFile::Writer::write(const std::string& filename, S32 version)
+{
+	std::vector<Folder> folders(mFolders);
+	std::sort(folders.begin(), folders.end(),
+			  [](const Folder& a, const Folder& b) { return a.mID < b.mID; });
+	std::vector<ItemIndex> index(mItems.size());
+	for (U32 i = 0; i < (U32)mItems.size(); ++i)
+	{
+		index[i].mID = mItems[i].mID;
+		index[i].mItem = i;
+	}
+	std::sort(index.begin(), index.end(),
+			  [](const ItemIndex& a, const ItemIndex& b) { return a.mID < b.mID; });
+
+	Header header;
+	memcpy(header.mMagic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+	header.mVersion = version;
+	header.mNumFolders = (U32)folders.size();
+	header.mNumItems = (U32)mItems.size();
+	header.mNumLinks = (U32)mLinks.size();
+	header.mPoolSize = (U32)mPool.size();
+
+	std::string tmpfile = filename + ".t";
+	LLFILE* fp = LLFile::fopen(tmpfile, "wb");
+	if (!fp)
+	{
+		LL_WARNS("Inventory") << "unable to save inventory to: " << filename << LL_ENDL;
+		return false;
+	}
+	bool success = fwrite(&header, sizeof(Header), 1, fp) == 1;
+	success = success && (folders.empty() || fwrite(folders.data(), sizeof(Folder), folders.size(), fp) == folders.size());
+	success = success && (mItems.empty() || fwrite(mItems.data(), sizeof(Item), mItems.size(), fp) == mItems.size());
+	success = success && (index.empty() || fwrite(index.data(), sizeof(ItemIndex), index.size(), fp) == index.size());
+	success = success && (mLinks.empty() || fwrite(mLinks.data(), sizeof(U32), mLinks.size(), fp) == mLinks.size());
+	success = success && fwrite(mPool.data(), 1, mPool.size(), fp) == mPool.size();
+	success = (fclose(fp) == 0) && success;
+	if (!success)
+	{
+		LL_WARNS("Inventory") << "unable to save inventory to: " << filename << LL_ENDL;
+		LLFile::remove(tmpfile);
+		return false;
+	}
+#if LL_WINDOWS
+	// Rename in windows needs the dstfile to not exist.
+	LLFile::remove(filename, ENOENT);
+#endif
+	return LLFile::rename(tmpfile, filename) == 0;
+}
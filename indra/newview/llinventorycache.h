@@ -0,0 +1,210 @@
+/**
+ * @file llinventorycache.h
+ * @brief Reading and writing the inventory cache: the binary format that
+ * is mapped in place, and the gzipped text format it replaced.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include "llmappedfile.h"
+#include "lluuid.h"
+
+class LLInventoryItem;
+
+// The legacy text format: an "inv_cache_version" line followed by
+// "inv_category" and "inv_item" records, gzipped. The viewer only reads it
+// now, to import a cache written before LLInventoryCacheFile.
+//
+// read() inflates the file a chunk at a time, cuts the text at record
+// boundaries and hands each batch of records to the job system, so the
+// records are parsed while the rest of the file is still being inflated.
+// write() has the records exported in batches on the job system and
+// compresses them, in order, as they come back.
+class LLInventoryCache
+{
+public:
+	// Parses the records of one batch, in file order, on a job system
+	// worker. Batches are created on the calling thread.
+	class Batch
+	{
+	public:
+		virtual ~Batch() {}
+		// The stream is positioned after the record's keyword line, and the
+		// record must be read up to its closing brace.
+		virtual void parseRecord(const std::string& keyword, std::istream& input) = 0;
+	};
+	typedef std::function<Batch*()> batch_factory_t;
+
+	enum EStatus
+	{
+		CACHE_OK,
+		CACHE_MISSING,
+		CACHE_OBSOLETE,		// written with another inv_cache_version
+		CACHE_CORRUPT
+	};
+
+	// On return every batch has been parsed. The caller owns the batches,
+	// which are in file order, whatever the status.
+	static EStatus read(const std::string& filename, S32 version,
+						const batch_factory_t& factory, std::vector<Batch*>& batches);
+
+	// Exports record index (0 <= index < count) to the stream; called on
+	// job system workers, for several records at the same time.
+	typedef std::function<void(U32 index, std::ostream& output)> export_func_t;
+
+	static bool write(const std::string& filename, S32 version, U32 count, const export_func_t& func);
+};
+
+// The binary cache, read in place from a mapping:
+//
+//   Header
+//   Folder[mNumFolders]		sorted by id
+//   Item[mNumItems]			the items of each folder follow each other
+//   ItemIndex[mNumItems]		sorted by id
+//   U32[mNumLinks]			indices of the link items
+//   char[mPoolSize]			names and descriptions, NUL terminated
+//
+// Only the folder table is checked by open(), so that the items of a folder
+// are not even paged in until the folder is first needed.
+class LLInventoryCacheFile
+{
+public:
+	struct Header
+	{
+		char mMagic[4];
+		S32 mVersion;
+		U32 mNumFolders;
+		U32 mNumItems;
+		U32 mNumLinks;
+		U32 mPoolSize;
+	};
+
+	struct Folder
+	{
+		LLUUID mID;
+		S32 mVersion;
+		U32 mFirstItem;
+		U32 mNumItems;
+	};
+
+	struct Item
+	{
+		LLUUID mID;
+		LLUUID mParentID;
+		LLUUID mAssetID;
+		LLUUID mCreatorID;
+		LLUUID mOwnerID;
+		LLUUID mLastOwnerID;
+		LLUUID mGroupID;
+		U32 mBaseMask;
+		U32 mOwnerMask;
+		U32 mGroupMask;
+		U32 mEveryoneMask;
+		U32 mNextOwnerMask;
+		U32 mFlags;
+		S32 mSalePrice;
+		S32 mCreationDate;
+		U32 mName;				// offsets into the string pool
+		U32 mDescription;
+		S8 mType;
+		S8 mInventoryType;
+		U8 mSaleType;
+		U8 mGroupOwned;
+	};
+
+	struct ItemIndex
+	{
+		LLUUID mID;
+		U32 mItem;
+	};
+
+	LLInventoryCacheFile();
+
+	// Fails when the file is missing, was written for another version, or
+	// does not hold together.
+	bool open(const std::string& filename, S32 version);
+	void close();
+
+	bool isOpen() const					{ return mHeader != NULL; }
+	const std::string& getFilename() const	{ return mFilename; }
+	U32 getNumFolders() const			{ return mHeader ? mHeader->mNumFolders : 0; }
+	const Folder* getFolders() const	{ return mFolders; }
+	U32 getNumLinks() const				{ return mHeader ? mHeader->mNumLinks : 0; }
+	const Item& getLink(U32 index) const	{ return mItems[mLinks[index]]; }
+
+	const Folder* findFolder(const LLUUID& id) const;
+	const Item* findItem(const LLUUID& id) const;
+	const Item* getItems(const Folder& folder) const	{ return mItems + folder.mFirstItem; }
+	const char* getString(U32 offset) const;
+
+	// Sets every field of the item from the record.
+	void importItem(const Item& record, LLInventoryItem* item) const;
+
+	// Collects folders and their items in memory, then writes them in the
+	// format open() reads.
+	class Writer
+	{
+	public:
+		Writer();
+
+		// The items added next belong to this folder.
+		void addFolder(const LLUUID& id, S32 version);
+		void addItem(const LLInventoryItem* item);
+		// Copies a record of another file, which may be closed afterwards.
+		void addItem(const LLInventoryCacheFile& file, const Item& record);
+
+		// Through a temporary file, so that an interrupted write leaves the
+		// old cache alone.
+		bool write(const std::string& filename, S32 version);
+
+	private:
+		U32 addString(const std::string& str);
+		void pushItem(const Item& record);
+
+		std::vector<Folder> mFolders;
+		std::vector<Item> mItems;
+		std::vector<U32> mLinks;
+		std::string mPool;
+		boost::unordered_map<std::string, U32> mPoolOffsets;
+	};
+
+private:
+	LLMappedFile mFile;
+	std::string mFilename;
+	const Header* mHeader;
+	const Folder* mFolders;
+	const Item* mItems;
+	const ItemIndex* mIndex;
+	const U32* mLinks;
+	const char* mPool;
+};
+
+#endif // LL_LLINVENTORYCACHE_H
@@ -73,6 +73,8 @@ LLInventoryFilter::LLInventoryFilter(const Params& p)
 :	mFilterOps(p.filter_ops),
 	mFilterSubString(p.substring),
 	mName(p.name),
+	mSubStringMatchGeneration(-1),
+	mFilterTimeLimit(0.f),
 	mFilterModified(FILTER_NONE),
 	mEmptyLookupMessage("InventoryNoMatchingItems"),
 	mCurrentGeneration(0),
@@ -103,7 +105,7 @@ bool LLInventoryFilter::check(LLFolderViewItem* item)
 		return passed_clipboard;
 	}
 
-	mSubStringMatchOffset = mFilterSubString.size() ? item->getSearchableLabel().find(mFilterSubString) : std::string::npos;
+	mSubStringMatchOffset = mFilterSubString.size() ? findSubString(item, item_id) : std::string::npos;
 
 	const bool passed_filtertype = checkAgainstFilterType(item);
 	const bool passed_permissions = checkAgainstPermissions(item);
@@ -118,6 +120,51 @@ bool LLInventoryFilter::check(LLFolderViewItem* item)
 	return passed;
 }
 
+// Only the matches are searched for the offset to highlight. The index holds
+// names, so searching descriptions or creators, or anything outside gInventory,
+// falls back to searching the label.
+std::string::size_type LLInventoryFilter::findSubString(LLFolderViewItem* item, const LLUUID& item_id)
+{
+	const std::string& searchable = item->getSearchableLabel();
+	if ((item->getRoot()->getSearchType() & ~1) || !updateSubStringMatches())
+	{
+		return searchable.find(mFilterSubString);
+	}
+
+	const S32 entry = LLInventoryFilterIndex::instance().getEntry(item_id);
+	if (entry < 0 || mSubStringMatches[entry])
+	{
+		return searchable.find(mFilterSubString);
+	}
+
+	// The name does not hold the string, but the label suffix, e.g. "(worn)",
+	// still might, so search from where a match would reach past the name.
+	const std::string::size_type name_size = item->getLabel().size();
+	if (searchable.size() <= name_size)
+	{
+		return std::string::npos;
+	}
+	const std::string::size_type start = name_size >= mFilterSubString.size() ? name_size - mFilterSubString.size() + 1 : 0;
+	return searchable.find(mFilterSubString, start);
+}
+
+// Looks the filter string up again whenever the index changed since.
+bool LLInventoryFilter::updateSubStringMatches()
+{
+	LLInventoryFilterIndex& index = LLInventoryFilterIndex::instance();
+	if (mSubStringMatchGeneration >= 0 && mSubStringMatchGeneration == index.getGeneration())
+	{
+		return true;
+	}
+	if (!index.find(mFilterSubString, mSubStringMatches))
+	{
+		mSubStringMatchGeneration = -1;
+		return false;
+	}
+	mSubStringMatchGeneration = index.getGeneration();
+	return true;
+}
+
 bool LLInventoryFilter::checkFolder(const LLFolderViewFolder* folder) const
 {
 	if (!folder)
@@ -670,6 +717,8 @@ void LLInventoryFilter::setFilterSubString(const std::string& string)
 			&& !filter_sub_string_new.substr(0, mFilterSubString.size()).compare(mFilterSubString);
 
 		mFilterSubString = filter_sub_string_new;
+		mSubStringMatches.clear();
+		mSubStringMatchGeneration = -1;
 		if (less_restrictive)
 		{
 			setModified(FILTER_LESS_RESTRICTIVE);
@@ -1269,6 +1318,17 @@ S32 LLInventoryFilter::getFilterCount() const
 void LLInventoryFilter::decrementFilterCount() 
 { 
 	mFilterCount--; 
+	// Reading the clock costs more than filtering an item, so only now and then.
+	if (mFilterTimeLimit > 0.f && !(mFilterCount & 31) && mFilterTimer.getElapsedTimeF32() > mFilterTimeLimit)
+	{
+		mFilterCount = -1;
+	}
+}
+
+void LLInventoryFilter::setFilterTimeLimit(F32 seconds)
+{
+	mFilterTimeLimit = seconds;
+	mFilterTimer.reset();
 }
 
 S32 LLInventoryFilter::getCurrentGeneration() const 
@@ -1328,3 +1388,87 @@ bool LLInventoryFilter::FilterOps::DateRange::validateBlock( bool   emit_errors
 	}
 	return valid;
 }
+
+///----------------------------------------------------------------------------
+/// Class LLInventoryFilterIndex
+///----------------------------------------------------------------------------
+LLInventoryFilterIndex::LLInventoryFilterIndex()
+:	mBuilt(false)
+{
+	gInventory.addObserver(this);
+}
+
+LLInventoryFilterIndex::~LLInventoryFilterIndex()
+{
+	if (gInventory.containsObserver(this))
+	{
+		gInventory.removeObserver(this);
+	}
+}
+
+void LLInventoryFilterIndex::changed(U32 mask)
+{
+	if (!mBuilt)
+	{
+		return;
+	}
+	if (!(mask & (LLInventoryObserver::LABEL | LLInventoryObserver::ADD |
+				  LLInventoryObserver::REMOVE | LLInventoryObserver::REBUILD)))
+	{
+		return;
+	}
+
+	// Renaming an item also reports its links, whose name is the item's.
+	const LLInventoryModel::changed_items_t& changed_ids = gInventory.getChangedIDs();
+	for (const LLUUID& id : changed_ids)
+	{
+		const LLInventoryObject* object = gInventory.getObject(id);
+		if (object)
+		{
+			mIndex.add(id, object->getName());
+		}
+		else
+		{
+			mIndex.remove(id);
+		}
+	}
+}
+
+S32 LLInventoryFilterIndex::getEntry(const LLUUID& id)
+{
+	return build() ? mIndex.getEntry(id) : -1;
+}
+
+bool LLInventoryFilterIndex::find(const std::string& substring, std::vector<bool>& matches)
+{
+	if (!build())
+	{
+		return false;
+	}
+	mIndex.find(substring, matches);
+	return true;
+}
+
+bool LLInventoryFilterIndex::build()
+{
+	if (mBuilt)
+	{
+		return true;
+	}
+	if (!gInventory.isInventoryUsable())
+	{
+		return false;
+	}
+
+	// Cached items are indexed from the cache file: building the index does
+	// not materialize the folders still pending.
+	LLTimer timer;
+	gInventory.forEachName([this](const LLUUID& id, const std::string& name)
+		{
+			mIndex.add(id, name);
+		});
+	mBuilt = true;
+	LL_INFOS("Inventory") << "Indexed " << mIndex.size() << " inventory names in "
+						  << timer.getElapsedTimeF32() << " seconds" << LL_ENDL;
+	return true;
+}
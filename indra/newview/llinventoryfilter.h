@@ -27,8 +27,12 @@
 #ifndef LLINVENTORYFILTER_H
 #define LLINVENTORYFILTER_H
 
+#include "llinventoryobserver.h"
+#include "llinventorysearchindex.h"
 #include "llinventorytype.h"
 #include "llpermissionsflags.h"
+#include "llsingleton.h"
+#include "lltimer.h"
 
 class LLFolderViewItem;
 class LLFolderViewFolder;
@@ -176,7 +180,7 @@ public:
 	};
 
 	LLInventoryFilter(const Params& p = Params());
-	LLInventoryFilter(const LLInventoryFilter& other) { *this = other; }
+	LLInventoryFilter(const LLInventoryFilter& other) : mSubStringMatchGeneration(-1), mFilterTimeLimit(0.f) { *this = other; }
 	virtual ~LLInventoryFilter() {}
 
 	// +-------------------------------------------------------------------+
@@ -265,6 +269,8 @@ public:
 	void 				setFilterCount(S32 count);
 	S32 				getFilterCount() const;
 	void 				decrementFilterCount();
+	// Also ends the pass once this many seconds went by since the call, if not zero.
+	void				setFilterTimeLimit(F32 seconds);
 
 	// +-------------------------------------------------------------------+
 	// + Default
@@ -297,6 +303,8 @@ private:
 	bool 				checkAgainstPermissions(const LLInventoryItem* item) const;
 	bool 				checkAgainstFilterLinks(const LLFolderViewItem* item) const;
 	bool				checkAgainstClipboard(const LLUUID& object_id) const;
+	std::string::size_type findSubString(LLFolderViewItem* item, const LLUUID& item_id);
+	bool				updateSubStringMatches();
 
 	U32						mOrder;
 
@@ -308,6 +316,11 @@ private:
 	std::string				mFilterSubStringOrig;
 	const std::string		mName;
 
+	// By index entry, whether the name holds mFilterSubString, as of the
+	// LLInventoryFilterIndex generation it was looked up at.
+	std::vector<bool>		mSubStringMatches;
+	S32						mSubStringMatchGeneration;
+
 	S32						mCurrentGeneration;
     // The following makes checking for pass/no pass possible even if the item is not checked against the current generation
     // Any item that *did not pass* the "required generation" will *not pass* the current one
@@ -316,10 +329,36 @@ private:
 	S32						mFirstSuccessGeneration;
 
 	S32						mFilterCount;
+	LLTimer					mFilterTimer;
+	F32						mFilterTimeLimit;
 	EFilterModified 		mFilterModified;
 
 	std::string 			mFilterText;
 	std::string 			mEmptyLookupMessage;
 };
 
+// The names of everything in gInventory, for LLInventoryFilter to look a
+// filter string up in instead of searching every folder view. Built the
+// first time it is needed, and then kept up to date as the model changes.
+class LLInventoryFilterIndex : public LLInventoryObserver, public LLSingleton<LLInventoryFilterIndex>
+{
+	friend class LLSingleton<LLInventoryFilterIndex>;
+	LLInventoryFilterIndex();
+public:
+	virtual ~LLInventoryFilterIndex();
+
+	/*virtual*/ void changed(U32 mask);
+
+	// See LLInventorySearchIndex. Both fail until the inventory is usable.
+	S32 getEntry(const LLUUID& id);
+	bool find(const std::string& substring, std::vector<bool>& matches);
+	S32 getGeneration() const	{ return mIndex.getGeneration(); }
+
+private:
+	bool build();
+
+	LLInventorySearchIndex mIndex;
+	bool mBuilt;
+};
+
 #endif
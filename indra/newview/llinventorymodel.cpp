@@ -38,6 +38,7 @@
 #include "llinventoryclipboard.h"
 #include "llinventorypanel.h"
 #include "llinventorybridge.h"
+#include "llinventorycache.h"
 #include "llinventoryfunctions.h"
 #include "llinventoryobserver.h"
 #include "llinventorypanel.h"
@@ -113,7 +114,13 @@ bool LLCanCache::operator()(LLInventoryCategory* cat, LLInventoryItem* item)
 	{
 		// HACK: downcast
 		LLViewerInventoryCategory* c = (LLViewerInventoryCategory*)cat;
-		if(c->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		if (mModel->isFolderPending(c->getUUID()))
+		{
+			// Nothing changed since it was loaded from the cache.
+			mCachedCatIDs.insert(c->getUUID());
+			rv = true;
+		}
+		else if(c->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
 		{
 			S32 descendents_server = c->getDescendentCount();
 			S32 descendents_actual = c->getViewerDescendentCount();
@@ -146,6 +153,9 @@ LLInventoryModel::LLInventoryModel()
 	mParentChildCategoryTree(),
 	mParentChildItemTree(),
 	mBacklinkMMap(),
+	mCacheFiles(),
+	mPendingFolders(),
+	mPendingItemCount(0),
 	mLastItem(nullptr),
 	mIsNotifyObservers(FALSE),
 	mModifyMask(LLInventoryObserver::ALL),
@@ -330,6 +340,10 @@ LLViewerInventoryItem* LLInventoryModel::getItem(const LLUUID& id) const
 			item = iter->second;
 			mLastItem = item;
 		}
+		else if (!mPendingFolders.empty())
+		{
+			item = materializeItem(id);
+		}
 	}
 	return item;
 }
@@ -347,7 +361,7 @@ LLViewerInventoryCategory* LLInventoryModel::getCategory(const LLUUID& id) const
 
 S32 LLInventoryModel::getItemCount() const
 {
-	return mItemMap.size();
+	return mItemMap.size() + mPendingItemCount;
 }
 
 S32 LLInventoryModel::getCategoryCount() const
@@ -365,7 +379,7 @@ void LLInventoryModel::getDirectDescendentsOf(const LLUUID& cat_id,
 											  item_array_t*& items) const
 {
 	categories = get_ptr_in_map(mParentChildCategoryTree, cat_id);
-	items = get_ptr_in_map(mParentChildItemTree, cat_id);
+	items = getItemArray(cat_id);
 }
 
 // Same but just categories.
@@ -818,7 +832,7 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 	}
 
 	LLViewerInventoryItem* item = nullptr;
-	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
+	item_array_t* item_array = getItemArray(id);
 
 	// Move onto items
 	if(item_array)
@@ -981,12 +995,12 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item, U32 mask)
 			
 		if(old_parent_id != new_parent_id)
 		{
-			item_array_t * item_array = get_ptr_in_map(mParentChildItemTree, old_parent_id);
+			item_array_t * item_array = getItemArray(old_parent_id);
 			if(item_array)
 			{
 				vector_replace_with_last(*item_array, old_item);
 			}
-			item_array = get_ptr_in_map(mParentChildItemTree, new_parent_id);
+			item_array = getItemArray(new_parent_id);
 			if(item_array)
 			{
 				if (update_parent_on_server)
@@ -1025,7 +1039,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item, U32 mask)
 		{
 			const LLUUID category_id = findCategoryUUIDForType(LLFolderType::assetTypeToFolderType(new_item->getType()));
 			new_item->setParent(category_id);
-			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, category_id);
+			item_array_t* item_array = getItemArray(category_id);
 			if( item_array )
 			{
 				LLInventoryModel::LLCategoryUpdate update(category_id, 1);
@@ -1058,7 +1072,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item, U32 mask)
 				accountForUpdate(update);
 
 			}
-			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, parent_id);
+			item_array_t* item_array = getItemArray(parent_id);
 			if(item_array)
 			{
 				item_array->push_back(new_item);
@@ -1070,7 +1084,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item, U32 mask)
 								  << new_item->getName() << LL_ENDL;
 				parent_id = findCategoryUUIDForType(LLFolderType::FT_LOST_AND_FOUND);
 				new_item->setParent(parent_id);
-				item_array = get_ptr_in_map(mParentChildItemTree, parent_id);
+				item_array = getItemArray(parent_id);
 				if(item_array)
 				{
 					LLInventoryModel::LLCategoryUpdate update(parent_id, 1);
@@ -1135,7 +1149,7 @@ LLInventoryModel::cat_array_t* LLInventoryModel::getUnlockedCatArray(const LLUUI
 
 LLInventoryModel::item_array_t* LLInventoryModel::getUnlockedItemArray(const LLUUID& id)
 {
-	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
+	item_array_t* item_array = getItemArray(id);
 	if (item_array)
 	{
 		llassert_always(mItemLock[id] == false);
@@ -1547,6 +1561,13 @@ void LLInventoryModel::deleteObject(const LLUUID& id, bool fix_broken_links, boo
 	addChangedMask(LLInventoryObserver::REMOVE, id);
 	gInventory.notifyObservers();
 
+	// Cached items that were never needed go with their folder.
+	pending_folder_map_t::iterator pending_it = mPendingFolders.find(id);
+	if (pending_it != mPendingFolders.end())
+	{
+		mPendingItemCount -= pending_it->second.mNumItems;
+		mPendingFolders.erase(pending_it);
+	}
 	item_list = getUnlockedItemArray(id);
 	if(item_list)
 	{
@@ -1751,32 +1772,42 @@ void LLInventoryModel::cache(
 	if(!root_cat) return;
 	cat_array_t categories;
 	categories.push_back(root_cat);
-	item_array_t items;
 
+	// Only the folders are walked, so that the pending ones are not
+	// materialized: saveToFile() copies their items from the old cache.
 	LLCanCache can_cache(this);
 	can_cache(root_cat, nullptr);
-	collectDescendentsIf(
-		parent_folder_id,
-		categories,
-		items,
-		INCLUDE_TRASH,
-		can_cache);
+	uuid_vec_t folder_ids(1, parent_folder_id);
+	while (!folder_ids.empty())
+	{
+		cat_array_t* cat_array = get_ptr_in_map(mParentChildCategoryTree, folder_ids.back());
+		folder_ids.pop_back();
+		if (!cat_array)
+		{
+			continue;
+		}
+		for (LLViewerInventoryCategory* cat : *cat_array)
+		{
+			if (can_cache(cat, nullptr))
+			{
+				categories.push_back(cat);
+			}
+			folder_ids.push_back(cat->getUUID());
+		}
+	}
 	std::string agent_id_str;
 	std::string inventory_filename;
 	agent_id.toString(agent_id_str);
 	std::string path(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, agent_id_str));
 	inventory_filename = llformat(CACHE_FORMAT_STRING, path.c_str());
-	saveToFile(inventory_filename, categories, items);
-	std::string gzip_filename(inventory_filename);
-	gzip_filename.append(".gz");
-	if(gzip_file(inventory_filename, gzip_filename))
-	{
-		LL_DEBUGS(LOG_INV) << "Successfully compressed " << inventory_filename << LL_ENDL;
-		LLFile::remove(inventory_filename);
-	}
-	else
+	std::string binary_filename(inventory_filename);
+	binary_filename.append(".bin");
+	if (saveToFile(binary_filename, categories))
 	{
-		LL_WARNS(LOG_INV) << "Unable to compress " << inventory_filename << LL_ENDL;
+		// Imported by loadSkeleton() if it was there.
+		std::string gzip_filename(inventory_filename);
+		gzip_filename.append(".gz");
+		LLFile::remove(gzip_filename, ENOENT);
 	}
 }
 
@@ -1889,6 +1920,153 @@ void LLInventoryModel::addItem(LLViewerInventoryItem* item)
 	}
 }
 
+bool LLInventoryModel::isFolderPending(const LLUUID& cat_id) const
+{
+	return mPendingFolders.find(cat_id) != mPendingFolders.end();
+}
+
+void LLInventoryModel::forEachName(const name_func_t& func) const
+{
+	for (const auto& cat : mCategoryMap)
+	{
+		func(cat.first, cat.second->getName());
+	}
+	for (const auto& item : mItemMap)
+	{
+		func(item.first, item.second->getName());
+	}
+	for (const auto& pending : mPendingFolders)
+	{
+		const LLInventoryCacheFile* cache_file = pending.second.mFile;
+		const LLInventoryCacheFile::Folder* folder = cache_file->findFolder(pending.first);
+		if (!folder)
+		{
+			continue;
+		}
+		const LLInventoryCacheFile::Item* record = cache_file->getItems(*folder);
+		for (U32 i = 0; i < folder->mNumItems; ++i, ++record)
+		{
+			func(record->mID, cache_file->getString(record->mName));
+		}
+	}
+}
+
+LLInventoryModel::item_array_t* LLInventoryModel::getItemArray(const LLUUID& cat_id) const
+{
+	materializeFolder(cat_id);
+	return get_ptr_in_map(mParentChildItemTree, cat_id);
+}
+
+// Creates the cached items of a pending folder. Any accessor may be the
+// first to look into the folder, hence const like them.
+void LLInventoryModel::materializeFolder(const LLUUID& cat_id) const
+{
+	if (mPendingFolders.empty())
+	{
+		return;
+	}
+	pending_folder_map_t::iterator pending_it = mPendingFolders.find(cat_id);
+	if (pending_it == mPendingFolders.end())
+	{
+		return;
+	}
+	// No longer pending before anything is created: checking the links
+	// below may look into other folders, this one included.
+	const LLInventoryCacheFile* cache_file = pending_it->second.mFile;
+	mPendingItemCount -= pending_it->second.mNumItems;
+	mPendingFolders.erase(pending_it);
+
+	LLViewerInventoryCategory* cat = getCategory(cat_id);
+	const LLInventoryCacheFile::Folder* folder = cache_file->findFolder(cat_id);
+	if (!folder)
+	{
+		LL_WARNS(LOG_INV) << "Folder " << cat_id << " missing from " << cache_file->getFilename() << LL_ENDL;
+		if (cat)
+		{
+			cat->setVersion(LLViewerInventoryCategory::VERSION_UNKNOWN);
+		}
+		return;
+	}
+
+	LLInventoryModel* self = const_cast<LLInventoryModel*>(this);
+	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, cat_id);
+	item_array_t links;
+	bool invalid = false;
+	const LLInventoryCacheFile::Item* record = cache_file->getItems(*folder);
+	for (U32 i = 0; i < folder->mNumItems; ++i, ++record)
+	{
+		if (mItemMap.find(record->mID) != mItemMap.end())
+		{
+			continue;
+		}
+		LLPointer<LLViewerInventoryItem> item = new LLViewerInventoryItem;
+		cache_file->importItem(*record, item);
+		if (item->getActualType() == LLAssetType::AT_UNKNOWN)
+		{
+			invalid = true;
+		}
+		else if (item->getIsLinkType())
+		{
+			links.push_back(item);
+		}
+		else
+		{
+			self->addItem(item);
+			if (item_array)
+			{
+				item_array->push_back(item);
+			}
+		}
+	}
+	// After the other items, which they may point to.
+	for (LLViewerInventoryItem* item : links)
+	{
+		if (item->getIsBrokenLink())
+		{
+			LL_DEBUGS(LOG_INV) << "Cached link item without baseobj present ( name: "
+							   << item->getName() << " itemID: " << item->getUUID()
+							   << " assetID: " << item->getAssetUUID()
+							   << " ).  Ignoring it." << LL_ENDL;
+			self->removeBacklinkInfo(item->getUUID(), item->getLinkedUUID());
+			invalid = true;
+			continue;
+		}
+		self->addItem(item);
+		if (item_array)
+		{
+			item_array->push_back(item);
+		}
+	}
+	if (invalid && cat)
+	{
+		// Fetched again when next opened.
+		LL_DEBUGS(LOG_INV) << "Invalidating category name: " << cat->getName() << " UUID: " << cat_id
+						   << " due to invalid descendents cache" << LL_ENDL;
+		cat->setVersion(LLViewerInventoryCategory::VERSION_UNKNOWN);
+	}
+}
+
+// An item missing from mItemMap may still be waiting in a pending folder.
+LLViewerInventoryItem* LLInventoryModel::materializeItem(const LLUUID& item_id) const
+{
+	for (const auto& cache_file : mCacheFiles)
+	{
+		const LLInventoryCacheFile::Item* record = cache_file.second->findItem(item_id);
+		if (record && isFolderPending(record->mParentID))
+		{
+			materializeFolder(LLUUID(record->mParentID));
+			const auto iter = mItemMap.find(item_id);
+			if (iter != mItemMap.cend())
+			{
+				mLastItem = iter->second;
+				return iter->second;
+			}
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
 // Empty the entire contents
 void LLInventoryModel::empty()
 {
@@ -1904,6 +2082,9 @@ void LLInventoryModel::empty()
 		DeletePairedPointer());
 	mParentChildItemTree.clear();
 	mBacklinkMMap.clear(); // forget all backlink information.
+	mPendingFolders.clear();
+	mPendingItemCount = 0;
+	mCacheFiles.clear(); // unmaps the cache files
 	mCategoryMap.clear(); // remove all references (should delete entries)
 	mItemMap.clear(); // remove all references (should delete entries)
 	mLastItem = NULL;
@@ -1978,6 +2159,13 @@ LLInventoryModel::EHasChildren LLInventoryModel::categoryHasChildren(const LLUUI
 {
 	LLViewerInventoryCategory* cat = getCategory(cat_id);
 	if(!cat) return CHILDREN_NO;
+	// The items of a pending folder are not in mParentChildItemTree yet,
+	// whatever its descendent count says.
+	pending_folder_map_t::const_iterator pending_it = mPendingFolders.find(cat_id);
+	if (pending_it != mPendingFolders.end() && pending_it->second.mNumItems > 0)
+	{
+		return CHILDREN_YES;
+	}
 	if(cat->getDescendentCount() > 0)
 	{
 		return CHILDREN_YES;
@@ -2086,27 +2274,66 @@ bool LLInventoryModel::loadSkeleton(
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
-		bool remove_inventory_file = false;
-		if(fp)
+		std::string binary_filename(inventory_filename);
+		binary_filename.append(".bin");
+		std::unique_ptr<LLInventoryCacheFile>& cache_file = mCacheFiles[owner_id];
+		if (!cache_file)
 		{
-			fclose(fp);
-			fp = nullptr;
-			if(gunzip_file(gzip_filename, inventory_filename))
+			cache_file.reset(new LLInventoryCacheFile);
+		}
+		bool is_cache_obsolete = false;
+		if (cache_file->open(binary_filename, sCurrentInvCacheVersion))
+		{
+			// Only the folders are looked at now. The items of the folders
+			// whose version still matches stay in the mapping until the
+			// folder is first needed, see materializeFolder().
+			const LLInventoryCacheFile::Folder* folder = cache_file->getFolders();
+			const LLInventoryCacheFile::Folder* folders_end = folder + cache_file->getNumFolders();
+			// Both are sorted by id.
+			for (const auto& temp_cat : temp_cats)
 			{
-				// we only want to remove the inventory file if it was
-				// gzipped before we loaded, and we successfully
-				// gunziped it.
-				remove_inventory_file = true;
+				LLViewerInventoryCategory* llvic = temp_cat;
+				const LLUUID& cat_id = llvic->getUUID();
+				while (folder != folders_end && folder->mID < cat_id)
+				{
+					++folder;
+				}
+				if (folder != folders_end && folder->mID == cat_id && folder->mVersion == llvic->getVersion())
+				{
+					++cached_category_count;
+					if (folder->mNumItems)
+					{
+						LLPendingFolder& pending = mPendingFolders[cat_id];
+						pending.mFile = cache_file.get();
+						pending.mNumItems = folder->mNumItems;
+						mPendingItemCount += folder->mNumItems;
+						child_counts[cat_id].mValue += folder->mNumItems;
+						cached_item_count += folder->mNumItems;
+					}
+				}
+				else
+				{
+					llvic->setVersion(NO_VERSION);
+				}
+				addCategory(temp_cat);
+				++child_counts[temp_cat->getParentUUID()];
 			}
-			else
+
+			// Links are known by their targets before they are created,
+			// for collectLinksTo().
+			for (U32 i = 0, count = cache_file->getNumLinks(); i < count; ++i)
 			{
-				LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
+				const LLInventoryCacheFile::Item& link = cache_file->getLink(i);
+				if (isFolderPending(link.mParentID))
+				{
+					addBacklinkInfo(link.mID, link.mAssetID);
+				}
 			}
 		}
-		bool is_cache_obsolete = false;
-		if (loadFromFile(inventory_filename, categories, items, categories_to_update, is_cache_obsolete))
+		else if (loadFromFile(gzip_filename, categories, items, categories_to_update, is_cache_obsolete))
 		{
+			// A text cache from before the binary format, imported. It is
+			// replaced by a binary one on logout.
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
 			// will go through each category loaded and if the version
@@ -2281,11 +2508,6 @@ bool LLInventoryModel::loadSkeleton(
 			}
 		}
 
-		if(remove_inventory_file)
-		{
-			// clean up the gunzipped file.
-			LLFile::remove(inventory_filename);
-		}
 		if(is_cache_obsolete)
 		{
 			// If out of date, remove the gzipped file too.
@@ -2604,6 +2826,65 @@ bool LLUUIDAndName::operator>(const LLUUIDAndName& rhs) const
 	return (mID > rhs.mID);
 }
 
+namespace
+{
+	// The records of one batch of the inventory cache, parsed on a job
+	// system worker.
+	class LLInventoryCacheBatch : public LLInventoryCache::Batch
+	{
+	public:
+		/*virtual*/ void parseRecord(const std::string& keyword, std::istream& input)
+		{
+			if (keyword == "inv_category")
+			{
+				LLPointer<LLViewerInventoryCategory> inv_cat = new LLViewerInventoryCategory(LLUUID::null);
+				if(inv_cat->importLocal(input))
+				{
+					mCategories.push_back(inv_cat);
+				}
+				else
+				{
+					LL_WARNS(LOG_INV) << "loadInventoryFromFile().  Ignoring invalid inventory category: " << inv_cat->getName() << LL_ENDL;
+					//delete inv_cat; // automatic when inv_cat is reassigned or destroyed
+				}
+			}
+			else
+			{
+				LLPointer<LLViewerInventoryItem> inv_item = new LLViewerInventoryItem;
+				if( inv_item->importLocal(input) )
+				{
+					// *FIX: Need a better solution, this prevents the
+					// application from freezing, but breaks inventory
+					// caching.
+					if(inv_item->getUUID().isNull())
+					{
+						//delete inv_item; // automatic when inv_cat is reassigned or destroyed
+						LL_WARNS(LOG_INV) << "Ignoring inventory with null item id: "
+										  << inv_item->getName() << LL_ENDL;
+					}
+					else if (inv_item->getType() == LLAssetType::AT_UNKNOWN)
+					{
+						mCatsToUpdate.insert(inv_item->getParentUUID());
+					}
+					else
+					{
+						mItems.push_back(inv_item);
+					}
+				}
+				else
+				{
+					LL_WARNS(LOG_INV) << "loadInventoryFromFile().  Ignoring invalid inventory item: " << inv_item->getName() << LL_ENDL;
+					//delete inv_item; // automatic when inv_cat is reassigned or destroyed
+				}
+			}
+		}
+
+		LLInventoryModel::cat_array_t mCategories;
+		LLInventoryModel::item_array_t mItems;
+		LLInventoryModel::changed_items_t mCatsToUpdate;
+	};
+}
+
 // static
 bool LLInventoryModel::loadFromFile(const std::string& filename,
 									LLInventoryModel::cat_array_t& categories,
@@ -2617,138 +2898,132 @@ bool LLInventoryModel::loadFromFile(const std::string& filename,
 		return false;
 	}
 	LL_INFOS(LOG_INV) << "LLInventoryModel::loadFromFile(" << filename << ")" << LL_ENDL;
-	LLFILE* file = LLFile::fopen(filename, "rb");		/*Flawfinder: ignore*/
-	if(!file)
+
+	// The file is inflated and parsed in batches, on the job system.
+	std::vector<LLInventoryCache::Batch*> batches;
+	LLInventoryCache::EStatus status =
+		LLInventoryCache::read(filename, sCurrentInvCacheVersion,
+							   []() { return new LLInventoryCacheBatch; }, batches);
+	is_cache_obsolete = (status == LLInventoryCache::CACHE_OBSOLETE);
+	if (status == LLInventoryCache::CACHE_MISSING)
 	{
 		LL_INFOS(LOG_INV) << "unable to load inventory from: " << filename << LL_ENDL;
-		return false;
 	}
-	// *NOTE: This buffer size is hard coded into scanf() below.
-	char buffer[MAX_STRING];		/*Flawfinder: ignore*/
-	char keyword[MAX_STRING];		/*Flawfinder: ignore*/
-	char value[MAX_STRING];			/*Flawfinder: ignore*/
-	is_cache_obsolete = true;  		// Obsolete until proven current
-	while(!feof(file) && fgets(buffer, MAX_STRING, file)) 
+
+	size_t num_categories = 0;
+	size_t num_items = 0;
+	for (LLInventoryCache::Batch* batch : batches)
+	{
+		num_categories += ((LLInventoryCacheBatch*)batch)->mCategories.size();
+		num_items += ((LLInventoryCacheBatch*)batch)->mItems.size();
+	}
+	categories.reserve(categories.size() + num_categories);
+	items.reserve(items.size() + num_items);
+	for (LLInventoryCache::Batch* batch : batches)
 	{
-		sscanf(buffer, " %126s %126s", keyword, value);	/* Flawfinder: ignore */
-		if(0 == strcmp("inv_cache_version", keyword))
+		LLInventoryCacheBatch* cache_batch = (LLInventoryCacheBatch*)batch;
+		if (status == LLInventoryCache::CACHE_OK)
 		{
-			S32 version;
-			int succ = sscanf(value,"%d",&version);
-			if ((1 == succ) && (version == sCurrentInvCacheVersion))
-			{
-				// Cache is up to date
-				is_cache_obsolete = false;
-				continue;
-			}
-			else
-			{
-				// Cache is out of date
-				break;
-			}
+			categories.insert(categories.end(), cache_batch->mCategories.begin(), cache_batch->mCategories.end());
+			items.insert(items.end(), cache_batch->mItems.begin(), cache_batch->mItems.end());
+			cats_to_update.insert(cache_batch->mCatsToUpdate.begin(), cache_batch->mCatsToUpdate.end());
 		}
-		else if(0 == strcmp("inv_category", keyword))
+		delete batch;
+	}
+	return status == LLInventoryCache::CACHE_OK;
+}
+
+bool LLInventoryModel::saveToFile(const std::string& filename,
+								  const cat_array_t& categories)
+{
+	if(filename.empty())
+	{
+		LL_ERRS(LOG_INV) << "Filename is Null!" << LL_ENDL;
+		return false;
+	}
+	LL_INFOS(LOG_INV) << "LLInventoryModel::saveToFile(" << filename << ")" << LL_ENDL;
+
+	LLInventoryCacheFile::Writer writer;
+	for (LLViewerInventoryCategory* cat : categories)
+	{
+		if(cat->getVersion() == LLViewerInventoryCategory::VERSION_UNKNOWN)
 		{
-			if (is_cache_obsolete)
-				break;
-			
-			LLPointer<LLViewerInventoryCategory> inv_cat = new LLViewerInventoryCategory(LLUUID::null);
-			if(inv_cat->importFileLocal(file))
-			{
-				categories.push_back(inv_cat);
-			}
-			else
-			{
-				LL_WARNS(LOG_INV) << "loadInventoryFromFile().  Ignoring invalid inventory category: " << inv_cat->getName() << LL_ENDL;
-				//delete inv_cat; // automatic when inv_cat is reassigned or destroyed
-			}
+			continue;
 		}
-		else if(0 == strcmp("inv_item", keyword))
+		const LLUUID& cat_id = cat->getUUID();
+		pending_folder_map_t::const_iterator pending_it = mPendingFolders.find(cat_id);
+		if (pending_it != mPendingFolders.end())
 		{
-			if (is_cache_obsolete)
-				break;
-
-			LLPointer<LLViewerInventoryItem> inv_item = new LLViewerInventoryItem;
-			if( inv_item->importFileLocal(file) )
+			// Still as cached, unless the server has a newer version the
+			// items were never fetched for.
+			const LLInventoryCacheFile* cache_file = pending_it->second.mFile;
+			const LLInventoryCacheFile::Folder* folder = cache_file->findFolder(cat_id);
+			if (folder && folder->mVersion == cat->getVersion())
 			{
-				// *FIX: Need a better solution, this prevents the
-				// application from freezing, but breaks inventory
-				// caching.
-				if(inv_item->getUUID().isNull())
+				writer.addFolder(cat_id, cat->getVersion());
+				const LLInventoryCacheFile::Item* records = cache_file->getItems(*folder);
+				for (U32 i = 0; i < folder->mNumItems; ++i)
 				{
-					//delete inv_item; // automatic when inv_cat is reassigned or destroyed
-					LL_WARNS(LOG_INV) << "Ignoring inventory with null item id: "
-									  << inv_item->getName() << LL_ENDL;
-						
-				}
-				else
-				{
-					if (inv_item->getType() == LLAssetType::AT_UNKNOWN)
-					{
-						cats_to_update.insert(inv_item->getParentUUID());
-					}
-					else
-					{
-						items.push_back(inv_item);
-					}
+					writer.addItem(*cache_file, records[i]);
 				}
 			}
-			else
-			{
-				LL_WARNS(LOG_INV) << "loadInventoryFromFile().  Ignoring invalid inventory item: " << inv_item->getName() << LL_ENDL;
-				//delete inv_item; // automatic when inv_cat is reassigned or destroyed
-			}
 		}
 		else
 		{
-			LL_WARNS(LOG_INV) << "Unknown token in inventory file '" << keyword << "'"
-							  << LL_ENDL;
+			writer.addFolder(cat_id, cat->getVersion());
+			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, cat_id);
+			if (item_array)
+			{
+				for (LLViewerInventoryItem* item : *item_array)
+				{
+					writer.addItem(item);
+				}
+			}
 		}
 	}
-	fclose(file);
-	if (is_cache_obsolete)
-		return false;
-	return true;
-}
 
-// static
-bool LLInventoryModel::saveToFile(const std::string& filename,
-								  const cat_array_t& categories,
-								  const item_array_t& items)
-{
-	if(filename.empty())
+	// The file may still be mapped for the folders that are pending: it is
+	// unmapped while it gets replaced, then the new one is mapped instead.
+	std::vector<LLInventoryCacheFile*> remapped;
+	for (const auto& cache_file : mCacheFiles)
 	{
-		LL_ERRS(LOG_INV) << "Filename is Null!" << LL_ENDL;
-		return false;
+		if (cache_file.second->isOpen() && cache_file.second->getFilename() == filename)
+		{
+			cache_file.second->close();
+			remapped.push_back(cache_file.second.get());
+		}
 	}
-	LL_INFOS(LOG_INV) << "LLInventoryModel::saveToFile(" << filename << ")" << LL_ENDL;
-	LLFILE* file = LLFile::fopen(filename, "wb");		/*Flawfinder: ignore*/
-	if(!file)
+	bool success = writer.write(filename, sCurrentInvCacheVersion);
+	if (!success)
 	{
 		LL_WARNS(LOG_INV) << "unable to save inventory to: " << filename << LL_ENDL;
-		return false;
 	}
-
-	fprintf(file, "\tinv_cache_version\t%d\n",sCurrentInvCacheVersion);
-	S32 count = categories.size();
-	S32 i;
-	for(i = 0; i < count; ++i)
+	for (LLInventoryCacheFile* cache_file : remapped)
 	{
-		LLViewerInventoryCategory* cat = categories[i];
-		if(cat->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		if (cache_file->open(filename, sCurrentInvCacheVersion))
 		{
-			cat->exportFileLocal(file);
+			continue;
+		}
+		// Their items are gone: fetch them again.
+		for (pending_folder_map_t::iterator it = mPendingFolders.begin(); it != mPendingFolders.end(); )
+		{
+			if (it->second.mFile == cache_file)
+			{
+				LLViewerInventoryCategory* cat = getCategory(it->first);
+				if (cat)
+				{
+					cat->setVersion(LLViewerInventoryCategory::VERSION_UNKNOWN);
+				}
+				mPendingItemCount -= it->second.mNumItems;
+				it = mPendingFolders.erase(it);
+			}
+			else
+			{
+				++it;
+			}
 		}
 	}
-
-	count = items.size();
-	for(i = 0; i < count; ++i)
-	{
-		items[i]->exportFile(file);
-	}
-
-	fclose(file);
-	return true;
+	return success;
 }
 
 // message handling functionality
@@ -3782,26 +4057,28 @@ bool LLInventoryModel::validate() const
 						<< getLibraryRootFolderID() << ")" << LL_ENDL;
 			}
 		}
-		cat_array_t* cats;
-		item_array_t* items;
-		getDirectDescendentsOf(cat_id,cats,items);
+		// Without materializing the pending folders.
+		cat_array_t* cats = get_ptr_in_map(mParentChildCategoryTree, cat_id);
+		item_array_t* items = get_ptr_in_map(mParentChildItemTree, cat_id);
 		if (!cats || !items)
 		{
 			LL_WARNS() << "invalid direct descendents for " << cat_id << LL_ENDL;
 			valid = false;
 			continue;
 		}
+		pending_folder_map_t::const_iterator pending_it = mPendingFolders.find(cat_id);
+		const size_t pending_items = pending_it != mPendingFolders.end() ? pending_it->second.mNumItems : 0;
 		if (cat->getDescendentCount() == LLViewerInventoryCategory::DESCENDENT_COUNT_UNKNOWN)
 		{
 			desc_unknown_count++;
 		}
-		else if (cats->size() + items->size() != cat->getDescendentCount())
+		else if (cats->size() + items->size() + pending_items != cat->getDescendentCount())
 		{
 			LL_WARNS() << "invalid desc count for " << cat_id << " name [" << cat->getName()
 					<< "] parent " << cat->getParentUUID()
 					<< " cached " << cat->getDescendentCount()
-					<< " expected " << cats->size() << "+" << items->size()
-					<< "=" << cats->size() +items->size() << LL_ENDL;
+					<< " expected " << cats->size() << "+" << items->size() << "+" << pending_items
+					<< "=" << cats->size() + items->size() + pending_items << LL_ENDL;
 			valid = false;
 		}
 		if (cat->getVersion() == LLViewerInventoryCategory::VERSION_UNKNOWN)
@@ -3883,8 +4160,7 @@ bool LLInventoryModel::validate() const
 		if (!parent_id.isNull())
 		{
 			cat_array_t* cats;
-			item_array_t* items;
-			getDirectDescendentsOf(parent_id,cats,items);
+			getDirectDescendentsOf(parent_id,cats);
 			if (!cats)
 			{
 				LL_WARNS() << "cat " << cat_id << " name [" << cat->getName()
@@ -28,6 +28,9 @@
 #define LL_LLINVENTORYMODEL_H
 
 #include <boost/unordered_map.hpp>
+#include <functional>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -45,6 +48,7 @@
 class AIHTTPTimeoutPolicy;
 extern AIHTTPTimeoutPolicy FetchItemHttpHandler_timeout;
 
+class LLInventoryCacheFile;
 class LLInventoryObserver;
 class LLInventoryObject;
 class LLInventoryItem;
@@ -172,6 +176,30 @@ private:
 	bool hasBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id) const;
 	void addBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id);
 	void removeBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id);
+
+	// Folders loaded from the binary cache whose items were not needed
+	// yet. The items stay in the mapping of their owner's cache file until
+	// materializeFolder() creates them, when the folder is first looked into.
+	typedef std::map<LLUUID, std::unique_ptr<LLInventoryCacheFile> > cache_file_map_t;
+	cache_file_map_t mCacheFiles; // key = owner id
+	struct LLPendingFolder
+	{
+		LLInventoryCacheFile* mFile;
+		S32 mNumItems;
+	};
+	typedef boost::unordered_map<LLUUID, LLPendingFolder> pending_folder_map_t;
+	mutable pending_folder_map_t mPendingFolders;
+	mutable S32 mPendingItemCount; // sum of their mNumItems
+	void materializeFolder(const LLUUID& cat_id) const;
+	LLViewerInventoryItem* materializeItem(const LLUUID& item_id) const;
+	// The child items of a folder, materialized.
+	item_array_t* getItemArray(const LLUUID& cat_id) const;
+public:
+	bool isFolderPending(const LLUUID& cat_id) const;
+	// Calls func with the id and name of every folder and item, those still
+	// in the cache of pending folders included, without materializing any.
+	typedef std::function<void(const LLUUID& id, const std::string& name)> name_func_t;
+	void forEachName(const name_func_t& func) const;
 	
 	//--------------------------------------------------------------------
 	// Login
@@ -560,9 +588,10 @@ protected:
 							 item_array_t& items,
 							 changed_items_t& cats_to_update,
 							 bool& is_cache_obsolete); 
-	static bool saveToFile(const std::string& filename,
-						   const cat_array_t& categories,
-						   const item_array_t& items); 
+	// Writes the binary cache. The items of pending folders are copied
+	// from the file they are still in.
+	bool saveToFile(const std::string& filename,
+					const cat_array_t& categories);
 
 	//--------------------------------------------------------------------
 	// Message handling functionality
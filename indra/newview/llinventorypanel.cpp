@@ -368,6 +368,12 @@ LLView* LLInventoryPanel::fromXML(LLXMLNodePtr node, LLView *parent, LLUICtrlFac
 
 void LLInventoryPanel::draw()
 {
+	// A filter picks among the views of every item.
+	if (!mDeferredFolders.empty() && getFilter().isActive())
+	{
+		buildAllDeferredViews();
+	}
+
 	// Select the desired item (in case it wasn't loaded when the selection was requested)
 	updateSelection();
 
@@ -963,8 +969,19 @@ LLFolderViewItem* LLInventoryPanel::buildNewViews(const LLUUID& id)
 		|| (folder_view_item && objectp->getType() == LLAssetType::AT_CATEGORY))
 	{
 		LLViewerInventoryCategory::cat_array_t* categories;
-		LLViewerInventoryItem::item_array_t* items;
-		mInventory->lockDirectDescendentArrays(id, categories, items);
+		LLViewerInventoryItem::item_array_t* items = NULL;
+		// The cached items of a pending folder are not created for their
+		// views to be built; see buildDeferredViews().
+		const bool defer_items = id.notNull() && mInventory->isFolderPending(id);
+		if (defer_items)
+		{
+			mInventory->getDirectDescendentsOf(id, categories);
+			mDeferredFolders.insert(id);
+		}
+		else
+		{
+			mInventory->lockDirectDescendentArrays(id, categories, items);
+		}
 		
 		if(categories)
 		{
@@ -987,12 +1004,51 @@ LLFolderViewItem* LLInventoryPanel::buildNewViews(const LLUUID& id)
 				buildNewViews(item->getUUID());
 			}
 		}
-		mInventory->unlockDirectDescendentArrays(id);
+		if (!defer_items)
+		{
+			mInventory->unlockDirectDescendentArrays(id);
+		}
 	}
 	
 	return folder_view_item;
 }
 
+void LLInventoryPanel::buildDeferredViews(const LLUUID& folder_id)
+{
+	std::set<LLUUID>::iterator it = mDeferredFolders.find(folder_id);
+	if (it == mDeferredFolders.end())
+	{
+		return;
+	}
+	mDeferredFolders.erase(it);
+
+	LLViewerInventoryCategory::cat_array_t* categories;
+	LLViewerInventoryItem::item_array_t* items;
+	mInventory->lockDirectDescendentArrays(folder_id, categories, items);
+	if (items)
+	{
+		for (const LLPointer<LLViewerInventoryItem>& item : *items)
+		{
+			buildNewViews(item->getUUID());
+		}
+	}
+	mInventory->unlockDirectDescendentArrays(folder_id);
+
+	LLFolderViewFolder* folder = getFolderByID(folder_id);
+	if (folder)
+	{
+		folder->requestSort();
+	}
+}
+
+void LLInventoryPanel::buildAllDeferredViews()
+{
+	while (!mDeferredFolders.empty())
+	{
+		buildDeferredViews(*mDeferredFolders.begin());
+	}
+}
+
 // bit of a hack to make sure the inventory is open.
 void LLInventoryPanel::openStartFolderOrMyInventory()
 {
@@ -1316,6 +1372,11 @@ LLFolderViewFolder* LLInventoryPanel::getFolderByID(const LLUUID& id)
 
 void LLInventoryPanel::setSelectionByID( const LLUUID& obj_id, BOOL    take_keyboard_focus )
 {
+	const LLInventoryObject* obj = mInventory->getObject(obj_id);
+	if (obj)
+	{
+		buildDeferredViews(obj->getParentUUID());
+	}
 	mFolderRoot.get()->setSelectionByID(obj_id, take_keyboard_focus);
 	/*
 	LLFolderViewItem* itemp = getItemByID(obj_id);
@@ -262,11 +262,18 @@ protected:
 	virtual void		buildFolderView();
 	LLFolderViewItem*	buildNewViews(const LLUUID& id);
 	BOOL				getIsHiddenFolderType(LLFolderType::EType folder_type) const;
+public:
+	// Builds the item views of a folder that was pending in the model when
+	// its view was built, when it is first opened, selected into or filtered.
+	void				buildDeferredViews(const LLUUID& folder_id);
+	void				buildAllDeferredViews();
+protected:
 	
 	virtual LLFolderView*		createFolderView(LLInvFVBridge * bridge, bool useLabelSuffix);
 	virtual LLFolderViewFolder*	createFolderViewFolder(LLInvFVBridge * bridge);
 	virtual LLFolderViewItem*	createFolderViewItem(LLInvFVBridge * bridge);
 	BOOL				mViewsInitialized; // Views have been generated
+	std::set<LLUUID>	mDeferredFolders; // Folders whose items have no views yet
 };
 
 class LLPanelMainInventory;
@@ -0,0 +1,204 @@
+/**
+ * @file llinventorysearchindex.cpp
+ * @brief Finds the inventory objects whose name holds a string.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llinventorysearchindex.h"
+
+#include <algorithm>
+
+#include "llstring.h"
+
+// Below this many, stale postings are not worth a rebuild.
+static const U32 MIN_STALE_POSTINGS = 4096;
+
+LLInventorySearchIndex::LLInventorySearchIndex()
+:	mNumPostings(0),
+	mNumStalePostings(0),
+	mGeneration(0)
+{
+}
+
+void LLInventorySearchIndex::add(const LLUUID& id, const std::string& name)
+{
+	std::string upper_name(name);
+	LLStringUtil::toUpper(upper_name);
+
+	U32 entry;
+	boost::unordered_map<LLUUID, U32>::iterator it = mEntryIndex.find(id);
+	if (it != mEntryIndex.end())
+	{
+		entry = it->second;
+		if (mEntries[entry].mName == upper_name)
+		{
+			return;
+		}
+		mNumStalePostings += mEntries[entry].mNumPostings;
+	}
+	else if (!mFreeEntries.empty())
+	{
+		entry = mFreeEntries.back();
+		mFreeEntries.pop_back();
+		mEntryIndex[id] = entry;
+	}
+	else
+	{
+		entry = mEntries.size();
+		mEntries.push_back(Entry());
+		mEntryIndex[id] = entry;
+	}
+
+	mEntries[entry].mID = id;
+	mEntries[entry].mName.swap(upper_name);
+	mEntries[entry].mNumPostings = post(entry);
+	++mGeneration;
+
+	if (mNumStalePostings > MIN_STALE_POSTINGS && mNumStalePostings > mNumPostings / 2)
+	{
+		rebuildPostings();
+	}
+}
+
+void LLInventorySearchIndex::remove(const LLUUID& id)
+{
+	boost::unordered_map<LLUUID, U32>::iterator it = mEntryIndex.find(id);
+	if (it == mEntryIndex.end())
+	{
+		return;
+	}
+	Entry& entry = mEntries[it->second];
+	mNumStalePostings += entry.mNumPostings;
+	entry.mID.setNull();
+	entry.mName.clear();
+	entry.mNumPostings = 0;
+	mFreeEntries.push_back(it->second);
+	mEntryIndex.erase(it);
+	++mGeneration;
+}
+
+void LLInventorySearchIndex::clear()
+{
+	mEntries.clear();
+	mFreeEntries.clear();
+	mEntryIndex.clear();
+	mPostings.clear();
+	mNumPostings = 0;
+	mNumStalePostings = 0;
+	++mGeneration;
+}
+
+U32 LLInventorySearchIndex::post(U32 entry)
+{
+	const std::string& name = mEntries[entry].mName;
+	if (name.size() < 3)
+	{
+		return 0;
+	}
+
+	std::vector<trigram_t> trigrams;
+	trigrams.reserve(name.size() - 2);
+	for (size_t i = 0; i + 3 <= name.size(); ++i)
+	{
+		trigrams.push_back(getTrigram(name.data() + i));
+	}
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	for (trigram_t trigram : trigrams)
+	{
+		mPostings[trigram].push_back(entry);
+	}
+	mNumPostings += trigrams.size();
+	return trigrams.size();
+}
+
+void LLInventorySearchIndex::rebuildPostings()
+{
+	mPostings.clear();
+	mNumPostings = 0;
+	mNumStalePostings = 0;
+	for (U32 entry = 0; entry < mEntries.size(); ++entry)
+	{
+		if (mEntries[entry].mID.notNull())
+		{
+			mEntries[entry].mNumPostings = post(entry);
+		}
+	}
+}
+
+S32 LLInventorySearchIndex::getEntry(const LLUUID& id) const
+{
+	boost::unordered_map<LLUUID, U32>::const_iterator it = mEntryIndex.find(id);
+	return it != mEntryIndex.end() ? (S32)it->second : -1;
+}
+
+void LLInventorySearchIndex::find(const std::string& substring, std::vector<bool>& matches) const
+{
+	matches.assign(mEntries.size(), false);
+	if (substring.empty())
+	{
+		return;
+	}
+
+	if (substring.size() < 3)
+	{
+		// Too short for a trigram, but still one pass over packed names
+		// rather than over the folder views.
+		for (U32 index = 0; index < mEntries.size(); ++index)
+		{
+			const Entry& entry = mEntries[index];
+			if (entry.mID.notNull() && entry.mName.find(substring) != std::string::npos)
+			{
+				matches[index] = true;
+			}
+		}
+		return;
+	}
+
+	const posting_t* candidates = NULL;
+	for (size_t i = 0; i + 3 <= substring.size(); ++i)
+	{
+		boost::unordered_map<trigram_t, posting_t>::const_iterator it = mPostings.find(getTrigram(substring.data() + i));
+		if (it == mPostings.end())
+		{
+			// No name holds this part of the string.
+			return;
+		}
+		if (!candidates || it->second.size() < candidates->size())
+		{
+			candidates = &it->second;
+		}
+	}
+
+	for (U32 index : *candidates)
+	{
+		const Entry& entry = mEntries[index];
+		if (!matches[index] && entry.mID.notNull() && entry.mName.find(substring) != std::string::npos)
+		{
+			matches[index] = true;
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/**
+ * @file llinventorysearchindex.h
+ * @brief Finds the inventory objects whose name holds a string.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYSEARCHINDEX_H
+#define LL_LLINVENTORYSEARCHINDEX_H
+
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include "lluuid.h"
+
+// Names are kept upper case, the way LLFolderViewItem searches them, and
+// each name is posted under every trigram (three byte sequence) it holds.
+// find() only verifies the names posted under the rarest trigram of the
+// string, instead of every name.
+//
+// Removing or renaming an object leaves its old postings behind: find()
+// verifies every candidate anyway, and the postings are rebuilt once the
+// stale ones outnumber the live ones.
+class LLInventorySearchIndex
+{
+public:
+	LLInventorySearchIndex();
+
+	// Adds the object, or renames it.
+	void add(const LLUUID& id, const std::string& name);
+	void remove(const LLUUID& id);
+	void clear();
+
+	// The entry of the object, -1 if it is not in the index. Entries are
+	// reused, so they only stand for an object until the next change.
+	S32 getEntry(const LLUUID& id) const;
+	U32 size() const					{ return mEntryIndex.size(); }
+	// Changes whenever the index does, so that results can be kept.
+	S32 getGeneration() const			{ return mGeneration; }
+
+	// Sets matches[entry] for every object whose name holds the string,
+	// which must be upper case already, and clears the others.
+	void find(const std::string& substring, std::vector<bool>& matches) const;
+
+private:
+	typedef U32 trigram_t;
+	typedef std::vector<U32> posting_t;
+
+	static trigram_t getTrigram(const char* str)
+	{
+		return (trigram_t)(U8)str[0] << 16 | (trigram_t)(U8)str[1] << 8 | (U8)str[2];
+	}
+
+	// Returns the number of postings added.
+	U32 post(U32 entry);
+	void rebuildPostings();
+
+	struct Entry
+	{
+		LLUUID mID;				// null once removed
+		std::string mName;
+		U32 mNumPostings;
+	};
+
+	std::vector<Entry> mEntries;
+	std::vector<U32> mFreeEntries;
+	boost::unordered_map<LLUUID, U32> mEntryIndex;
+	boost::unordered_map<trigram_t, posting_t> mPostings;
+	U32 mNumPostings;
+	U32 mNumStalePostings;
+	S32 mGeneration;
+};
+
+#endif // LL_LLINVENTORYSEARCHINDEX_H
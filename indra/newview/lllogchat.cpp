@@ -33,6 +33,7 @@
 #include "llviewerprecompiledheaders.h"
 
 #include <ctime>
+#include <future>
 #include "lllogchat.h"
 #include "llappviewer.h"
 #include "llfloaterchat.h"
@@ -43,6 +44,221 @@ static std::string get_log_dir_file(const std::string& filename)
 	return gDirUtilp->getExpandedFilename(LL_PATH_PER_ACCOUNT_CHAT_LOGS, filename);
 }
 
+// Appends log lines on its own thread, so that a slow disk (or a network
+// home directory) does not cost frame time. Every conversation keeps its
+// file open, the lines queued for it are written together, and files are
+// flushed whenever the queue runs dry, or every FLUSH_INTERVAL while it
+// does not.
+class LLLogWriterThread : public LLThread
+{
+public:
+	LLLogWriterThread() : LLThread("Chat log writer") { }
+
+	void push(const std::string& filename, const std::string& line);
+	// Blocks until every line queued so far is written and flushed. With
+	// close_files, the files are closed too, so that they can be renamed.
+	void sync(bool close_files);
+
+protected:
+	/*virtual*/ bool runCondition() { return !mQueue.empty(); }	// called with the run condition locked
+	/*virtual*/ void run();
+
+private:
+	struct Request
+	{
+		std::string mFilename;						// empty for a sync() barrier
+		std::string mLine;
+		bool mCloseFiles;
+		std::unique_ptr<std::promise<void> > mDone;
+	};
+
+	struct OpenFile
+	{
+		LLFILE* mFile;
+		U32 mLastUsed;
+	};
+
+	void write(const std::string& filename, const std::string& text);
+	void flushFiles();
+	void closeFiles();
+
+	std::deque<Request> mQueue;		// protected by lockData()/unlockData()
+
+	// Writer thread only.
+	typedef std::map<std::string, OpenFile> file_map_t;
+	file_map_t mFiles;
+	U32 mUseCount = 0;
+	LLTimer mFlushTimer;
+};
+
+static const U32 MAX_OPEN_LOG_FILES = 32;
+static const F32 FLUSH_INTERVAL = 2.f;
+
+static LLLogWriterThread* sWriterThread = NULL;
+static bool sWriterStopped = false;
+
+void LLLogWriterThread::push(const std::string& filename, const std::string& line)
+{
+	Request request;
+	request.mFilename = filename;
+	request.mLine = line;
+	request.mCloseFiles = false;
+	lockData();
+	mQueue.push_back(std::move(request));
+	unlockData();
+	wake();
+}
+
+void LLLogWriterThread::sync(bool close_files)
+{
+	Request barrier;
+	barrier.mCloseFiles = close_files;
+	barrier.mDone.reset(new std::promise<void>);
+	std::future<void> done = barrier.mDone->get_future();
+	lockData();
+	mQueue.push_back(std::move(barrier));
+	unlockData();
+	wake();
+	done.wait();
+}
+
+void LLLogWriterThread::run()
+{
+	while (1)
+	{
+		// Sleeps until something is queued or we are asked to quit.
+		checkPause();
+
+		std::deque<Request> batch;
+		lockData();
+		batch.swap(mQueue);
+		unlockData();
+
+		if (batch.empty())
+		{
+			// Only leave once the queue is drained, so nothing is lost on shutdown.
+			if (isQuitting())
+			{
+				break;
+			}
+			continue;
+		}
+
+		// Coalesce the lines of each file, in order, into a single write.
+		std::map<std::string, std::string> pending;
+		for (Request& request : batch)
+		{
+			if (!request.mFilename.empty())
+			{
+				std::string& text = pending[request.mFilename];
+				text += request.mLine;
+				text += '\n';
+				continue;
+			}
+
+			for (const auto& file : pending)
+			{
+				write(file.first, file.second);
+			}
+			pending.clear();
+			if (request.mCloseFiles)
+			{
+				closeFiles();
+			}
+			else
+			{
+				flushFiles();
+			}
+			request.mDone->set_value();
+		}
+		for (const auto& file : pending)
+		{
+			write(file.first, file.second);
+		}
+
+		lockData();
+		bool idle = mQueue.empty();
+		unlockData();
+		if (idle || mFlushTimer.getElapsedTimeF32() > FLUSH_INTERVAL)
+		{
+			flushFiles();
+		}
+	}
+	closeFiles();
+	LL_INFOS() << "Chat log writer thread EXITING." << LL_ENDL;
+}
+
+void LLLogWriterThread::write(const std::string& filename, const std::string& text)
+{
+	file_map_t::iterator it = mFiles.find(filename);
+	if (it == mFiles.end())
+	{
+		if (mFiles.size() >= MAX_OPEN_LOG_FILES)
+		{
+			// Close the conversation that was logged to the longest ago.
+			file_map_t::iterator oldest = mFiles.begin();
+			for (file_map_t::iterator iter = mFiles.begin(); iter != mFiles.end(); ++iter)
+			{
+				if (iter->second.mLastUsed < oldest->second.mLastUsed)
+				{
+					oldest = iter;
+				}
+			}
+			fclose(oldest->second.mFile);
+			mFiles.erase(oldest);
+		}
+
+		LLFILE* fp = LLFile::fopen(filename, "a");		/*Flawfinder: ignore*/
+		if (!fp)
+		{
+			LL_INFOS() << "Couldn't open chat history log!" << LL_ENDL;
+			return;
+		}
+		OpenFile file = { fp, 0 };
+		it = mFiles.insert(std::make_pair(filename, file)).first;
+	}
+	it->second.mLastUsed = ++mUseCount;
+	fwrite(text.data(), 1, text.size(), it->second.mFile);
+}
+
+void LLLogWriterThread::flushFiles()
+{
+	for (auto& file : mFiles)
+	{
+		fflush(file.second.mFile);
+	}
+	mFlushTimer.reset();
+}
+
+void LLLogWriterThread::closeFiles()
+{
+	for (auto& file : mFiles)
+	{
+		fclose(file.second.mFile);
+	}
+	mFiles.clear();
+	mFlushTimer.reset();
+}
+
+// The offsets of the last lines of the logs read or written this session,
+// so that reopening a conversation reads its tail without searching for it.
+struct LLLogTailIndex
+{
+	S64 mSize = -1;						// of the file, when the index is valid
+	std::deque<S64> mLineStarts;		// starting at 0 if the file has no more lines
+};
+static std::map<std::string, LLLogTailIndex> sTailIndex;
+
+// Logs are appended in text mode.
+#if LL_WINDOWS
+static const S64 NEWLINE_SIZE = 2;
+#else
+static const S64 NEWLINE_SIZE = 1;
+#endif
+
+// Logs written to this session, which need no check for an older file to migrate.
+static std::set<std::string> sLoggedFiles;
+
 //static
 std::string LLLogChat::makeLogFileNameInternal(std::string filename)
 {
@@ -66,6 +282,10 @@ bool LLLogChat::migrateFile(const std::string& old_name, const std::string& file
 	std::string oldfile = makeLogFileNameInternal(old_name);
 	if (!LLFile::isfile(oldfile)) return false; // An old file by this name doesn't exist
 
+	if (sWriterThread) sWriterThread->sync(true); // Let go of both files before moving them around
+	sTailIndex.erase(oldfile);
+	sTailIndex.erase(filename);
+
 	if (LLFile::isfile(filename)) // A file by the new name also exists, but wasn't being tracked yet
 	{
 		auto&& new_untracked_log = llifstream(filename);
@@ -133,7 +353,7 @@ std::string LLLogChat::makeLogFileName(const std::string& username, const LLUUID
 {
 	const auto name = username.empty() ? id.asString() : username; // Fall back on ID if the grid sucks and we have no name
 	std::string filename = makeLogFileNameInternal(name);
-	if (id.notNull() && !LLFile::isfile(filename)) // No existing file by this user's current name, check for possible file rename
+	if (id.notNull() && !sLoggedFiles.count(filename) && !LLFile::isfile(filename)) // No existing file by this user's current name, check for possible file rename
 	{
 		auto& entry = sIDMap[id.asString()];
 		const bool empty = !entry.size();
@@ -222,7 +442,43 @@ void LLLogChat::saveHistory(const std::string& name, const LLUUID& id, const std
 		return;
 	}
 
-	LLFILE* fp = LLFile::fopen(LLLogChat::makeLogFileName(name, id), "a"); 		/*Flawfinder: ignore*/
+	const std::string filename = LLLogChat::makeLogFileName(name, id);
+	sLoggedFiles.insert(filename);
+
+	std::map<std::string, LLLogTailIndex>::iterator it = sTailIndex.find(filename);
+	if (it != sTailIndex.end())
+	{
+		static const LLCachedControl<U32> lines("LogShowHistoryLines", 32);
+		LLLogTailIndex& index = it->second;
+		S64 offset = index.mSize;
+		index.mLineStarts.push_back(offset);
+		// The line may hold several lines of its own.
+		size_t begin = 0;
+		for (size_t pos = line.find('\n'); pos != std::string::npos; pos = line.find('\n', begin))
+		{
+			offset += pos - begin + NEWLINE_SIZE;
+			begin = pos + 1;
+			index.mLineStarts.push_back(offset);
+		}
+		index.mSize = offset + (line.size() - begin) + NEWLINE_SIZE;
+		while (index.mLineStarts.size() > lines)
+		{
+			index.mLineStarts.pop_front();
+		}
+	}
+
+	if (!sWriterThread && !sWriterStopped)
+	{
+		sWriterThread = new LLLogWriterThread;
+		sWriterThread->start();
+	}
+	if (sWriterThread)
+	{
+		sWriterThread->push(filename, line);
+		return;
+	}
+
+	LLFILE* fp = LLFile::fopen(filename, "a"); 		/*Flawfinder: ignore*/
 	if (!fp)
 	{
 		LL_INFOS() << "Couldn't open chat history log!" << LL_ENDL;
@@ -235,8 +491,62 @@ void LLLogChat::saveHistory(const std::string& name, const LLUUID& id, const std
 	}
 }
 
+//static
+void LLLogChat::flush()
+{
+	if (sWriterThread)
+	{
+		sWriterThread->sync(false);
+	}
+}
+
+//static
+void LLLogChat::cleanupClass()
+{
+	if (sWriterThread)
+	{
+		// The thread drains its queue and closes its files before exiting.
+		sWriterThread->shutdown();
+		delete sWriterThread;
+		sWriterThread = NULL;
+	}
+	sWriterStopped = true;
+}
+
 static long const LOG_RECALL_BUFSIZ = 2048;
 
+// Finds where the last 'lines' lines of the file start, reading it
+// backwards LOG_RECALL_BUFSIZ characters at a time.
+static bool find_tail(LLFILE* fptr, S64 size, U32 lines, S64& start)
+{
+	char buffer[LOG_RECALL_BUFSIZ];
+	// Start at the last character of the file, which ends the last line.
+	long pos = size - 1;
+	start = 0;
+	U32 nlines = 0;
+	while (pos > 0 && nlines < lines)
+	{
+		// Read the LOG_RECALL_BUFSIZ characters before pos.
+		size_t size = llmin(LOG_RECALL_BUFSIZ, pos);
+		pos -= size;
+		fseek(fptr, pos, SEEK_SET);
+		if (fread(buffer, 1, size, fptr) != size) return false;
+		// Count the number of newlines in it and set start to the beginning of the first line to return when we found enough.
+		for (char const* p = buffer + size - 1; p >= buffer; --p)
+		{
+			if (*p == '\n')
+			{
+				if (++nlines == lines)
+				{
+					start = pos + (p - buffer) + 1;
+					break;
+				}
+			}
+		}
+	}
+	return true;
+}
+
 void LLLogChat::loadHistory(const std::string& name, const LLUUID& id, std::function<void (ELogLineType, const std::string&)> callback)
 {
 	if (name.empty() && id.isNull())
@@ -249,59 +559,64 @@ void LLLogChat::loadHistory(const std::string& name, const LLUUID& id, std::func
 		static const LLCachedControl<U32> lines("LogShowHistoryLines", 32);
 		if (lines == 0) break;
 
+		// The writer may still hold lines of this conversation.
+		flush();
+
+		const std::string filename = makeLogFileName(name, id);
+		llstat file_status;
+		if (LLFile::stat(filename, &file_status) || file_status.st_size <= 0) break;
+		const S64 size = file_status.st_size;
+
 		// Open the log file.
-		LLFILE* fptr = LLFile::fopen(makeLogFileName(name, id), "rb");
+		LLFILE* fptr = LLFile::fopen(filename, "rb");
 		if (!fptr) break;
 
-		// Set pos to point to the last character of the file, if any.
-		if (fseek(fptr, 0, SEEK_END)) break;
-		long pos = ftell(fptr) - 1;
-		if (pos < 0) break;
-
-		char buffer[LOG_RECALL_BUFSIZ];
-		bool error = false;
-		U32 nlines = 0;
-		while (pos > 0 && nlines < lines)
+		// Start from the lines already known, if the file did not change since.
+		S64 start;
+		LLLogTailIndex& index = sTailIndex[filename];
+		if (index.mSize == size && !index.mLineStarts.empty() &&
+			(index.mLineStarts.size() >= lines || index.mLineStarts.front() == 0))
 		{
-			// Read the LOG_RECALL_BUFSIZ characters before pos.
-			size_t size = llmin(LOG_RECALL_BUFSIZ, pos);
-			pos -= size;
-			fseek(fptr, pos, SEEK_SET);
-			size_t len = fread(buffer, 1, size, fptr);
-			error = len != size;
-			if (error) break;
-			// Count the number of newlines in it and set pos to the beginning of the first line to return when we found enough.
-			for (char const* p = buffer + size - 1; p >= buffer; --p)
-			{
-				if (*p == '\n')
-				{
-					if (++nlines == lines)
-					{
-						pos += p - buffer + 1;
-						break;
-					}
-				}
-			}
+			start = index.mLineStarts[index.mLineStarts.size() - llmin((size_t)lines, index.mLineStarts.size())];
 		}
-		if (error)
+		else if (!find_tail(fptr, size, lines, start))
 		{
+			sTailIndex.erase(filename);
 			fclose(fptr);
 			break;
 		}
 
-		// Set the file pointer at the first line to return.
-		fseek(fptr, pos, SEEK_SET);
+		// Read all the lines to return at once.
+		std::string tail(size - start, '\0');
+		fseek(fptr, start, SEEK_SET);
+		const bool error = fread(&tail[0], 1, tail.size(), fptr) != tail.size();
+		fclose(fptr);
+		if (error)
+		{
+			sTailIndex.erase(filename);
+			break;
+		}
 
-		// Read lines from the file one by one until we reach the end of the file.
-		while (fgets(buffer, LOG_RECALL_BUFSIZ, fptr))
+		index.mSize = size;
+		index.mLineStarts.clear();
+		for (size_t begin = 0; begin < tail.size(); )
 		{
+			size_t end = tail.find('\n', begin);
+			if (end == std::string::npos)
+			{
+				end = tail.size();
+			}
+			index.mLineStarts.push_back(start + begin);
 			// strip newline chars from the end of the string
-			for (S32 i = strlen(buffer) - 1; i >= 0 && (buffer[i] == '\r' || buffer[i] == '\n'); --i)
-				buffer[i] = '\0';
-			callback(LOG_LINE, buffer);
+			size_t len = end - begin;
+			while (len && tail[begin + len - 1] == '\r')
+			{
+				--len;
+			}
+			callback(LOG_LINE, tail.substr(begin, len));
+			begin = end + 1;
 		}
 
-		fclose(fptr);
 		callback(LOG_END, LLStringUtil::null);
 		return;
 	}
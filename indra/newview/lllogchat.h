@@ -48,9 +48,15 @@ public:
 	static void initializeIDMap();
 	static std::string timestamp(bool withdate = false);
 	static std::string makeLogFileName(const std::string& name, const LLUUID& id);
+	// Queues the line for the log writer thread.
 	static void saveHistory(const std::string& name, const LLUUID& id, const std::string& line);
 	static void loadHistory(const std::string& name, const LLUUID& id,
 		                    std::function<void (ELogLineType, const std::string&)> callback);
+	// Blocks until every line saved so far is in its file.
+	static void flush();
+	// Writes out what is still queued and stops the writer thread; lines
+	// saved afterwards are written directly.
+	static void cleanupClass();
 private:
 	static std::string makeLogFileNameInternal(std::string filename);
 	static bool migrateFile(const std::string& old_name, const std::string& filename);
@@ -685,9 +685,9 @@ void LLNetMap::draw()
 			{
 				color = *mark_color;
 			}
-			else if (!LLTaggedAvatarsMgr::instance().getAvatarContactSetName(uuid.asString()).empty()){
+			else if (!LLTaggedAvatarsMgr::instance().getAvatarContactSetName(uuid).empty()){
 				//Genesis Contact set
-				color = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(uuid.asString());
+				color = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(uuid);
 			} else
 			{
 				bool getColorFor(const LLUUID & id, LLViewerRegion * parent_estate, LLColor4 & color, bool name_restricted = false);
@@ -1105,6 +1105,11 @@ void LLNetMap::renderScaledPointGlobal( const LLVector3d& pos, const LLColor4U &
 }
 
 
+F32 LLNetMap::getObjectImageRadius() const
+{
+	return 0.5f * (F32)mObjectImagep->getWidth() / mObjectMapTPM;
+}
+
 void LLNetMap::renderPoint(const LLVector3 &pos_local, const LLColor4U &color, 
 						   S32 diameter, S32 relative_height)
 {
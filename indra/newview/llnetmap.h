@@ -76,9 +76,11 @@ public:
 // [/SL:KB]
 	void			setScale( F32 scale );
 	void			renderScaledPointGlobal( const LLVector3d& pos, const LLColor4U &color, F32 radius );
+	const LLVector3d& getObjectImageCenterGlobal() const	{ return mObjectImageCenterGlobal; }
+	// Meters from the center of the object layer to its edges
+	F32				getObjectImageRadius() const;
 
 private:
-	const LLVector3d& getObjectImageCenterGlobal()	{ return mObjectImageCenterGlobal; }
 	void renderPoint(const LLVector3 &pos, const LLColor4U &color, 
 					 S32 diameter, S32 relative_height = 0);
 
@@ -0,0 +1,521 @@
+/**
+ * @file llobjectupdatedecoder.cpp
+ * @brief Unpacks compressed and terse object updates away from the main thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectupdatedecoder.h"
+
+#include "lldatapacker.h"
+#include "llpartdata.h"
+#include "llvolumemessage.h"
+#include "message.h"
+
+#include "llviewermessage.h"
+#include "llviewerobjectlist.h"
+
+LLObjectUpdateDecoder gObjectUpdateDecoder;
+
+//----------------------------------------------------------------------------
+
+LLObjectUpdateSource::LLObjectUpdateSource()
+:	mPacketID(0),
+	mRegionHandle(0),
+	mTimeDilation(0)
+{
+}
+
+void LLObjectUpdateSource::set(LLMessageSystem* mesgsys)
+{
+	mSender = mesgsys->getSender();
+	mPacketID = mesgsys->getCurrentRecvPacketID();
+	mesgsys->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, mRegionHandle);
+	mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, mTimeDilation);
+}
+
+//----------------------------------------------------------------------------
+
+// Takes a length prefixed binary field out of dp, without copying it: the
+// range is where its data is.
+static LLDecodedObjectUpdate::Range skip_binary_data(LLDataPackerBinaryBuffer& dp, const char* name)
+{
+	LLDecodedObjectUpdate::Range range;
+	S32 size = 0;
+	if (dp.unpackS32(size, name) && size >= 0 && size <= dp.getBufferSize() - dp.getCurrentSize())
+	{
+		range.mOffset = dp.getCurrentSize();
+		range.mSize = size;
+		dp.shift(range.mOffset + size);
+	}
+	else
+	{
+		LL_WARNS() << "Bad " << name << " field in an object update" << LL_ENDL;
+	}
+	return range;
+}
+
+LLDecodedObjectUpdate::LLDecodedObjectUpdate()
+:	mSource(NULL),
+	mDataSize(0),
+	mTextureEntrySize(0),
+	mUpdateFlags(0),
+	mLocalID(0),
+	mPCode(0),
+	mState(0),
+	mHasFootPlane(false),
+	mCRC(0),
+	mMaterial(0),
+	mClickAction(0),
+	mSpecialCode(0),
+	mParentID(0),
+	mTreeData(0),
+	mScratchPadSize(0),
+	mSoundGain(0.f),
+	mSoundFlags(0),
+	mHasVolume(false),
+	mVolumeParamsValid(false),
+	mTEValid(false)
+{
+}
+
+void LLDecodedObjectUpdate::setData(const U8* data, S32 size)
+{
+	mData.assign(size + DATA_PADDING, 0);
+	memcpy(mData.data(), data, size);	/* Flawfinder: ignore */
+	mDataSize = size;
+}
+
+void LLDecodedObjectUpdate::getPacker(const Range& range, LLDataPackerBinaryBuffer& dp) const
+{
+	dp.assignBuffer(const_cast<U8*>(mData.data()) + range.mOffset, range.mSize);
+}
+
+void LLDecodedObjectUpdate::getPacker(LLDataPackerBinaryBuffer& dp) const
+{
+	dp.assignBuffer(const_cast<U8*>(mData.data()), mDataSize);
+}
+
+void LLDecodedObjectUpdate::unpack(EObjectUpdateType update_type)
+{
+	LLDataPackerBinaryBuffer dp;
+	getPacker(dp);
+	if (update_type == OUT_TERSE_IMPROVED)
+	{
+		unpackTerse(dp);
+	}
+	else
+	{
+		unpackFull(dp);
+	}
+}
+
+void LLDecodedObjectUpdate::unpackTerse(LLDataPackerBinaryBuffer& dp)
+{
+	U16 val[4];
+
+	dp.unpackU32(mLocalID, "LocalID");
+	dp.unpackU8(mState, "State");
+
+	U8 value;
+	dp.unpackU8(value, "agent");
+	mHasFootPlane = value != 0;
+	if (mHasFootPlane)
+	{
+		dp.unpackVector4(mFootPlane, "Plane");
+	}
+	dp.unpackVector3(mPosition, "Pos");
+	dp.unpackU16(val[VX], "VelX");
+	dp.unpackU16(val[VY], "VelY");
+	dp.unpackU16(val[VZ], "VelZ");
+	mVelocity.set(U16_to_F32(val[VX], -128.f, 128.f),
+				  U16_to_F32(val[VY], -128.f, 128.f),
+				  U16_to_F32(val[VZ], -128.f, 128.f));
+	dp.unpackU16(val[VX], "AccX");
+	dp.unpackU16(val[VY], "AccY");
+	dp.unpackU16(val[VZ], "AccZ");
+	mAcceleration.set(U16_to_F32(val[VX], -64.f, 64.f),
+					  U16_to_F32(val[VY], -64.f, 64.f),
+					  U16_to_F32(val[VZ], -64.f, 64.f));
+
+	dp.unpackU16(val[VX], "ThetaX");
+	dp.unpackU16(val[VY], "ThetaY");
+	dp.unpackU16(val[VZ], "ThetaZ");
+	dp.unpackU16(val[VS], "ThetaS");
+	mRotation.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
+	mRotation.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
+	mRotation.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
+	mRotation.mQ[VS] = U16_to_F32(val[VS], -1.f, 1.f);
+	dp.unpackU16(val[VX], "AccX");
+	dp.unpackU16(val[VY], "AccY");
+	dp.unpackU16(val[VZ], "AccZ");
+	mAngularVelocity.set(U16_to_F32(val[VX], -64.f, 64.f),
+						 U16_to_F32(val[VY], -64.f, 64.f),
+						 U16_to_F32(val[VZ], -64.f, 64.f));
+
+	if (mTextureEntrySize)
+	{
+		LLDataPackerBinaryBuffer tdp(mTextureEntry.data(), mTextureEntrySize);
+		mTEContents.reset(new LLTEContents);
+		mTEValid = LLPrimitive::parseTEMessage(tdp, *mTEContents);
+	}
+}
+
+void LLDecodedObjectUpdate::unpackFull(LLDataPackerBinaryBuffer& dp)
+{
+	dp.unpackUUID(mFullID, "ID");
+	dp.unpackU32(mLocalID, "LocalID");
+	dp.unpackU8(mPCode, "PCode");
+	dp.unpackU8(mState, "State");
+
+	dp.unpackU32(mCRC, "CRC");
+	dp.unpackU8(mMaterial, "Material");
+	dp.unpackU8(mClickAction, "ClickAction");
+	dp.unpackVector3(mScale, "Scale");
+	dp.unpackVector3(mPosition, "Pos");
+	LLVector3 vec;
+	dp.unpackVector3(vec, "Rot");
+	mRotation.unpackFromVector3(vec);
+
+	dp.unpackU32(mSpecialCode, "SpecialCode");
+	dp.unpackUUID(mOwnerID, "Owner");
+
+	if (mSpecialCode & 0x80)
+	{
+		dp.unpackVector3(mAngularVelocity, "Omega");
+	}
+
+	if (mSpecialCode & 0x20)
+	{
+		dp.unpackU32(mParentID, "ParentID");
+	}
+
+	if (mSpecialCode & 0x2)
+	{
+		dp.unpackU8(mTreeData, "TreeData");
+	}
+	else if (mSpecialCode & 0x1)
+	{
+		dp.unpackU32(mScratchPadSize, "ScratchPadSize");
+		mScratchPad = skip_binary_data(dp, "PartData");
+	}
+
+	if (mSpecialCode & 0x4)
+	{
+		dp.unpackString(mText, "Text");
+		dp.unpackBinaryDataFixed(mTextColor.mV, 4, "Color");
+	}
+
+	if (mSpecialCode & 0x200)
+	{
+		dp.unpackString(mMediaURL, "MediaURL");
+	}
+
+	// Particle systems are unpacked by the object, into its source: only
+	// find where they end.
+	if (mSpecialCode & 0x8)
+	{
+		LLPartSysData part_sys_data;
+		mLegacyParticles.mOffset = dp.getCurrentSize();
+		part_sys_data.unpackLegacy(dp);
+		mLegacyParticles.mSize = dp.getCurrentSize() - mLegacyParticles.mOffset;
+	}
+
+	U8 num_parameters = 0;
+	dp.unpackU8(num_parameters, "num_params");
+	mExtraParams.resize(num_parameters);
+	for (U8 param = 0; param < num_parameters; ++param)
+	{
+		ExtraParam& extra_param = mExtraParams[param];
+		dp.unpackU16(extra_param.mType, "param_type");
+		extra_param.mData = skip_binary_data(dp, "param_data");
+	}
+
+	if (mSpecialCode & 0x10)
+	{
+		F32 cutoff;
+		dp.unpackUUID(mSoundID, "SoundUUID");
+		dp.unpackF32(mSoundGain, "SoundGain");
+		dp.unpackU8(mSoundFlags, "SoundFlags");
+		dp.unpackF32(cutoff, "SoundRadius");
+	}
+
+	if (mSpecialCode & 0x100)
+	{
+		dp.unpackString(mNameValues, "NV");
+	}
+
+	// What follows is only there for volumes, and read by LLVOVolume.
+	mHasVolume = mPCode == LL_PCODE_VOLUME;
+	if (!mHasVolume)
+	{
+		return;
+	}
+
+	mVolumeParamsValid = LLVolumeMessage::unpackVolumeParams(&mVolumeParams, dp);
+
+	mTEContents.reset(new LLTEContents);
+	mTEValid = LLPrimitive::parseTEMessage(dp, *mTEContents);
+	if (!mTEValid)
+	{
+		return;
+	}
+
+	// Read again by LLTextureAnim::unpackTAMessage(), length and all.
+	if (mSpecialCode & 0x40)
+	{
+		mTextureAnim.mOffset = dp.getCurrentSize();
+		skip_binary_data(dp, "TextureAnimation");
+		mTextureAnim.mSize = dp.getCurrentSize() - mTextureAnim.mOffset;
+	}
+
+	if (mSpecialCode & 0x400)
+	{
+		LLPartSysData part_sys_data;
+		mParticles.mOffset = dp.getCurrentSize();
+		part_sys_data.unpack(dp);
+		mParticles.mSize = dp.getCurrentSize() - mParticles.mOffset;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLObjectUpdateMessage::LLObjectUpdateMessage(LLMessageSystem* mesgsys, EObjectUpdateType update_type, void** user_data, LLCondition* decoded)
+:	mUpdateType(update_type),
+	mUserData(user_data),
+	mState(WAITING),
+	mDecoded(decoded)
+{
+	mSource.set(mesgsys);
+
+	const S32 num_objects = mesgsys->getNumberOfBlocksFast(_PREHASH_ObjectData);
+	mUpdates.resize(num_objects);
+	for (S32 i = 0; i < num_objects; ++i)
+	{
+		LLDecodedObjectUpdate& update = mUpdates[i];
+		update.mSource = &mSource;
+
+		const S32 size = llmax(mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data), 0);
+		update.mData.assign(size + LLDecodedObjectUpdate::DATA_PADDING, 0);
+		update.mDataSize = size;
+		if (size > 0)
+		{
+			mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, update.mData.data(), 0, i, size);
+		}
+
+		if (update_type == OUT_TERSE_IMPROVED)
+		{
+			const S32 te_size = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_TextureEntry);
+			if (te_size > 0)
+			{
+				update.mTextureEntry.assign(te_size + LLDecodedObjectUpdate::DATA_PADDING, 0);
+				update.mTextureEntrySize = te_size;
+				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_TextureEntry, update.mTextureEntry.data(), 0, i, te_size);
+			}
+		}
+		else
+		{
+			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, update.mUpdateFlags, i);
+		}
+	}
+}
+
+bool LLObjectUpdateMessage::claim()
+{
+	U32 expected = WAITING;
+	return mState.compare_exchange_strong(expected, DECODING, std::memory_order_acquire);
+}
+
+void LLObjectUpdateMessage::decode()
+{
+	llassert(mState.load(std::memory_order_relaxed) == DECODING);
+	for (std::vector<LLDecodedObjectUpdate>::iterator it = mUpdates.begin(); it != mUpdates.end(); ++it)
+	{
+		it->unpack(mUpdateType);
+	}
+	mState.store(DECODED, std::memory_order_release);
+	if (mDecoded)
+	{
+		// Taking the lock orders this after the check of a waiter about to wait.
+		mDecoded->lock();
+		mDecoded->broadcast();
+		mDecoded->unlock();
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLObjectUpdateDecoder::LLObjectUpdateDecoder()
+:	mFinishing(false)
+{
+}
+
+void LLObjectUpdateDecoder::add(LLMessageSystem* mesgsys, EObjectUpdateType update_type, void** user_data)
+{
+	LLPointer<LLObjectUpdateMessage> message = new LLObjectUpdateMessage(mesgsys, update_type, user_data, &mDecoded);
+	mMessages.push_back(message);
+	if (!LLObjectUpdateDecodeThread::sLocal ||
+		LLObjectUpdateDecodeThread::sLocal->decode(message) == LLQueuedThread::nullHandle())
+	{
+		// No thread will take it.
+		if (message->claim())
+		{
+			message->decode();
+		}
+	}
+}
+
+void LLObjectUpdateDecoder::finish(bool wait)
+{
+	if (mFinishing || mMessages.empty())
+	{
+		return;
+	}
+	mFinishing = true;
+
+	// Applying an update may add messages of its own, e.g. when it fails and
+	// the region is asked for the object again; those wait for the next time.
+	const size_t count = mMessages.size();
+	const S32 old_num_objects = gObjectList.mNumNewObjects;
+	size_t applied = 0;
+	for ( ; applied < count; ++applied)
+	{
+		LLPointer<LLObjectUpdateMessage> message = mMessages[applied];
+		if (!message->isDecoded())
+		{
+			if (!wait)
+			{
+				// Keeps the arrival order: the rest wait for this one.
+				break;
+			}
+			if (message->claim())
+			{
+				// Not started yet: quicker to decode it here than to wait.
+				message->decode();
+			}
+			else
+			{
+				mDecoded.lock();
+				while (!message->isDecoded())
+				{
+					mDecoded.wait();
+				}
+				mDecoded.unlock();
+			}
+		}
+		gObjectList.processDecodedObjectUpdate(*message);
+	}
+	mMessages.erase(mMessages.begin(), mMessages.begin() + applied);
+	if (old_num_objects != gObjectList.mNumNewObjects)
+	{
+		update_attached_sounds();
+	}
+
+	mFinishing = false;
+}
+
+void LLObjectUpdateDecoder::clear()
+{
+	// The decode thread holds its own references to the messages it has.
+	mMessages.clear();
+}
+
+//static
+void LLObjectUpdateDecoder::finishDeferredWork(void* data, bool wait)
+{
+	((LLObjectUpdateDecoder*)data)->finish(wait);
+}
+
+//----------------------------------------------------------------------------
+
+class LLObjectUpdateDecodeThread::Request : public LLQueuedThread::QueuedRequest
+{
+protected:
+	virtual ~Request() // use deleteRequest()
+	{
+	}
+
+public:
+	Request(handle_t handle, LLObjectUpdateMessage* message)
+		: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, FLAG_AUTO_COMPLETE),
+		  mMessage(message)
+	{
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		// The main thread decodes the messages it needs before they are
+		// started here.
+		if (mMessage->claim())
+		{
+			mMessage->decode();
+		}
+		return true;
+	}
+
+private:
+	LLPointer<LLObjectUpdateMessage> mMessage;
+};
+
+//----------------------------------------------------------------------------
+
+/*static*/ LLObjectUpdateDecodeThread* LLObjectUpdateDecodeThread::sLocal = NULL;
+
+// Run on MAIN thread
+//static
+void LLObjectUpdateDecodeThread::initClass(bool local_is_threaded)
+{
+	llassert(sLocal == NULL);
+	sLocal = new LLObjectUpdateDecodeThread(local_is_threaded);
+}
+
+//static
+void LLObjectUpdateDecodeThread::cleanupClass()
+{
+	// Messages still queued are decoded by gObjectUpdateDecoder if it is
+	// ever made to wait for them.
+	delete sLocal;
+	sLocal = NULL;
+}
+
+LLObjectUpdateDecodeThread::LLObjectUpdateDecodeThread(bool threaded)
+	: LLQueuedThread("objectupdatedecode", threaded, false, 2, LLJobSystem::PRIORITY_HIGH)
+{
+}
+
+// MAIN thread
+LLObjectUpdateDecodeThread::handle_t LLObjectUpdateDecodeThread::decode(LLObjectUpdateMessage* message)
+{
+	handle_t handle = generateHandle();
+	Request* req = new Request(handle, message);
+	if (!addRequest(req))
+	{
+		// Quitting: gObjectUpdateDecoder decodes it itself.
+		req->deleteRequest();
+		return nullHandle();
+	}
+	// Unpauses the thread, or decodes now when not threaded.
+	update(0);
+	return handle;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file llobjectupdatedecoder.h
+ * @brief Unpacks compressed and terse object updates away from the main thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTUPDATEDECODER_H
+#define LL_LLOBJECTUPDATEDECODER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llhost.h"
+#include "llpointer.h"
+#include "llprimitive.h"
+#include "llqueuedthread.h"
+#include "llquaternion.h"
+#include "llthread.h"
+#include "lluuid.h"
+#include "llvolume.h"
+#include "v3math.h"
+#include "v4coloru.h"
+#include "v4math.h"
+#include "llviewerobject.h"
+
+class LLDataPackerBinaryBuffer;
+class LLMessageSystem;
+
+// What an object update needs of the message it came in, once the message
+// system has moved on to the next one.
+struct LLObjectUpdateSource
+{
+	LLObjectUpdateSource();
+
+	// Reads the source of the message being handled.
+	void set(LLMessageSystem* mesgsys);
+
+	LLHost		mSender;
+	TPACKETID	mPacketID;
+	U64			mRegionHandle;
+	U16			mTimeDilation;
+};
+
+// One object of an ObjectUpdateCompressed, ObjectUpdateCached or
+// ImprovedTerseObjectUpdate message, unpacked out of its data block.
+// Unpacking looks at no object, so it can run on any thread; the object is
+// then updated from it on the main thread by processUpdateMessage(). The
+// parts that update an object as they are read, particles, extra parameters
+// and texture animation, are only found here, and read by the object.
+class LLDecodedObjectUpdate
+{
+public:
+	// A part of mData.
+	struct Range
+	{
+		Range() : mOffset(0), mSize(0) {}
+
+		S32 mOffset;
+		S32 mSize;
+	};
+
+	struct ExtraParam
+	{
+		U16		mType;
+		Range	mData;
+	};
+
+	static const S32 DATA_PADDING = 64;
+
+	LLDecodedObjectUpdate();
+
+	// Copies a data block, as the object cache keeps them.
+	void setData(const U8* data, S32 size);
+
+	// Unpacks mData, and mTextureEntry for a terse update.
+	void unpack(EObjectUpdateType update_type);
+
+	// Points dp at range of mData. Unpacking does not write to the buffer.
+	void getPacker(const Range& range, LLDataPackerBinaryBuffer& dp) const;
+	// Points dp at all of mData, as the object cache keeps it.
+	void getPacker(LLDataPackerBinaryBuffer& dp) const;
+
+	const LLObjectUpdateSource& getSource() const	{ return *mSource; }
+
+public:
+	const LLObjectUpdateSource* mSource;
+	// The Data field of the block, then DATA_PADDING zeros: a short or bad
+	// block is unpacked without reading past the buffer, as when it was
+	// unpacked out of a buffer the size of the largest one.
+	std::vector<U8>	mData;
+	S32				mDataSize;
+	std::vector<U8>	mTextureEntry;	// The TextureEntry field of a terse update, padded the same.
+	S32				mTextureEntrySize;
+	U32				mUpdateFlags;
+
+	LLUUID			mFullID;		// Only in full updates.
+	U32				mLocalID;
+	LLPCode			mPCode;
+	U8				mState;
+
+	// Terse updates
+	bool			mHasFootPlane;
+	LLVector4		mFootPlane;
+	LLVector3		mVelocity;
+	LLVector3		mAcceleration;
+
+	// Both
+	LLVector3		mPosition;
+	LLQuaternion	mRotation;
+	LLVector3		mAngularVelocity;
+
+	// Full updates
+	U32				mCRC;
+	U8				mMaterial;
+	U8				mClickAction;
+	LLVector3		mScale;
+	U32				mSpecialCode;	// Which of the optional parts follow.
+	LLUUID			mOwnerID;
+	U32				mParentID;
+	U8				mTreeData;
+	U32				mScratchPadSize;
+	Range			mScratchPad;
+	std::string		mText;
+	LLColor4U		mTextColor;
+	std::string		mMediaURL;
+	Range			mLegacyParticles;
+	std::vector<ExtraParam> mExtraParams;
+	LLUUID			mSoundID;
+	F32				mSoundGain;
+	U8				mSoundFlags;
+	std::string		mNameValues;
+
+	// Full updates of volumes
+	bool			mHasVolume;
+	bool			mVolumeParamsValid;
+	LLVolumeParams	mVolumeParams;
+	Range			mTextureAnim;
+	Range			mParticles;
+
+	// Full updates of volumes, and terse updates that carry texture entries.
+	// NULL when there are none; mTEValid is false when the block was bad.
+	std::unique_ptr<LLTEContents> mTEContents;
+	bool			mTEValid;
+
+private:
+	void unpackTerse(LLDataPackerBinaryBuffer& dp);
+	void unpackFull(LLDataPackerBinaryBuffer& dp);
+};
+
+// The object updates of one message. The main thread copies the blocks out
+// of the message, any thread unpacks them, and the main thread applies them.
+class LLObjectUpdateMessage : public LLThreadSafeRefCount
+{
+public:
+	// Copies the object data blocks of the message being handled. decoded,
+	// when not NULL, is signaled each time decode() is done.
+	LLObjectUpdateMessage(LLMessageSystem* mesgsys, EObjectUpdateType update_type, void** user_data, LLCondition* decoded = NULL);
+
+	// ANY THREAD
+	// Takes the message to decode it; false when another thread already has.
+	bool claim();
+	// Unpacks every update of a claimed message, then marks it decoded and
+	// signals the condition it was given.
+	void decode();
+	bool isDecoded() const		{ return mState.load(std::memory_order_acquire) == DECODED; }
+
+	EObjectUpdateType getUpdateType() const					{ return mUpdateType; }
+	void** getUserData() const								{ return mUserData; }
+	const LLObjectUpdateSource& getSource() const			{ return mSource; }
+	const std::vector<LLDecodedObjectUpdate>& getUpdates() const	{ return mUpdates; }
+
+private:
+	enum EState
+	{
+		WAITING,
+		DECODING,
+		DECODED
+	};
+
+	EObjectUpdateType mUpdateType;
+	void** mUserData;
+	LLObjectUpdateSource mSource;
+	std::vector<LLDecodedObjectUpdate> mUpdates;
+	std::atomic<U32> mState;
+	LLCondition* mDecoded;
+};
+
+// Compressed and terse object update messages, held from when they are
+// handled until they are applied in arrival order by finish(). The message
+// system calls finish(false) after each message, and finish(true) before
+// every handler that does not skip it, before the HTTP pump and at the end
+// of idleNetwork().
+class LLObjectUpdateDecoder
+{
+public:
+	LLObjectUpdateDecoder();
+
+	// Hands the message being handled to the decode thread.
+	void add(LLMessageSystem* mesgsys, EObjectUpdateType update_type, void** user_data);
+
+	// Applies the messages added that are decoded, up to the first that is
+	// not. With wait, applies them all: those not started are decoded on this
+	// thread, and those being decoded are waited for.
+	void finish(bool wait);
+
+	// Drops the messages not applied yet.
+	void clear();
+
+	// For LLMessageSystem::setFinishDeferredWorkFunc().
+	static void finishDeferredWork(void* data, bool wait);
+
+private:
+	std::vector<LLPointer<LLObjectUpdateMessage> > mMessages;
+	LLCondition mDecoded;
+	bool mFinishing;
+};
+
+// Unpacks object update messages in the background, for gObjectUpdateDecoder.
+class LLObjectUpdateDecodeThread : public LLQueuedThread
+{
+public:
+	static void initClass(bool local_is_threaded = true); // Setup sLocal
+	static void cleanupClass();		// Delete sLocal
+
+	handle_t decode(LLObjectUpdateMessage* message);
+
+public:
+	static LLObjectUpdateDecodeThread* sLocal;		// Default worker thread
+
+private:
+	LLObjectUpdateDecodeThread(bool threaded);
+
+	class Request;
+};
+
+extern LLObjectUpdateDecoder gObjectUpdateDecoder;
+
+#endif // LL_LLOBJECTUPDATEDECODER_H
@@ -267,7 +267,7 @@ void LLParticipantList::refreshSpeakers()
 
 		++count;
 		//Genesis Contact Set
-		std::string csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(speakerp->mID.asString());
+		const std::string& csName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(speakerp->mID);
 		// Color changes. Only perform for rows that are near or in the viewable area.
 		if (count > start_pos && count <= end_pos)
 		{
@@ -332,7 +332,7 @@ void LLParticipantList::refreshSpeakers()
 						name_cell->setColor(sDefaultListText);
 						
 						if (!csName.empty()){
-							name_cell->setColor(LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(speakerp->mID.asString()));
+							name_cell->setColor(LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(speakerp->mID));
 						}
 					}
 				}
@@ -0,0 +1,192 @@
+/**
+ * @file llregiongrid.h
+ * @brief Finds the objects of a region near a point without looking at the others.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLREGIONGRID_H
+#define LL_LLREGIONGRID_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "v3math.h"
+
+// The objects of one region, binned by their region position into square
+// cells of about MIN_CELL_WIDTH meters, so that a range query only looks at
+// the cells it overlaps. Cells are never smaller than MIN_CELL_WIDTH, and
+// there are never more than MAX_CELLS_PER_SIDE of them across, so a large
+// variable sized region gets larger cells.
+//
+// The grid does not own its objects. Each object keeps a Slot, which the
+// grid keeps pointing at where the object is, so that moving or removing an
+// object costs the same however many the grid holds. Whoever moves an object
+// calls update() again; an object moved to another region is moved to the
+// grid of that region by calling update() on it.
+template<class T>
+class LLRegionGrid
+{
+public:
+	static const U32 MAX_CELLS_PER_SIDE;
+	static const F32 MIN_CELL_WIDTH;
+
+	struct Slot
+	{
+		Slot() : mGrid(NULL), mCell(0), mIndex(0) {}
+
+		LLRegionGrid*	mGrid;		// NULL when not in any grid.
+		U32				mCell;
+		U32				mIndex;
+	};
+
+	LLRegionGrid(F32 region_width)
+	:	mRegionWidth(region_width),
+		mSize(0)
+	{
+		mCellsPerSide = llclamp((U32)llceil(region_width / MIN_CELL_WIDTH), 1U, MAX_CELLS_PER_SIDE);
+		mCellWidth = region_width / (F32)mCellsPerSide;
+		mCells.resize(mCellsPerSide * mCellsPerSide);
+	}
+
+	~LLRegionGrid()
+	{
+		clear();
+	}
+
+	// Puts object in the cell of pos_region, taking it out of the grid slot
+	// says it is in, if that is another grid or another cell.
+	void update(T* object, const LLVector3& pos_region, Slot& slot)
+	{
+		const U32 cell = getCell(pos_region.mV[VX], pos_region.mV[VY]);
+		if (slot.mGrid == this && slot.mCell == cell)
+		{
+			return;
+		}
+		remove(slot);
+
+		std::vector<Entry>& entries = mCells[cell];
+		Entry entry = { object, &slot };
+		entries.push_back(entry);
+		slot.mGrid = this;
+		slot.mCell = cell;
+		slot.mIndex = (U32)entries.size() - 1;
+		++mSize;
+	}
+
+	// Takes the object of slot out of whichever grid it is in.
+	static void remove(Slot& slot)
+	{
+		LLRegionGrid* grid = slot.mGrid;
+		if (!grid)
+		{
+			return;
+		}
+		std::vector<Entry>& entries = grid->mCells[slot.mCell];
+		llassert(slot.mIndex < entries.size() && entries[slot.mIndex].mSlot == &slot);
+		if (slot.mIndex + 1 < entries.size())
+		{
+			entries[slot.mIndex] = entries.back();
+			entries[slot.mIndex].mSlot->mIndex = slot.mIndex;
+		}
+		entries.pop_back();
+		--grid->mSize;
+		slot.mGrid = NULL;
+	}
+
+	// Calls func(object) on every object in a cell that overlaps the
+	// rectangle, in region coordinates: all the objects in the rectangle, and
+	// some near it. Objects a little outside the region, on their way to
+	// another, are kept in its edge cells, and found along with them.
+	template<typename F>
+	void forEachNear(F32 min_x, F32 min_y, F32 max_x, F32 max_y, F& func) const
+	{
+		if (!mSize || max_x < 0.f || max_y < 0.f || min_x >= mRegionWidth || min_y >= mRegionWidth)
+		{
+			return;
+		}
+		const S32 last = (S32)mCellsPerSide - 1;
+		const S32 x0 = llclamp(llfloor(min_x / mCellWidth), 0, last);
+		const S32 x1 = llclamp(llfloor(max_x / mCellWidth), 0, last);
+		const S32 y0 = llclamp(llfloor(min_y / mCellWidth), 0, last);
+		const S32 y1 = llclamp(llfloor(max_y / mCellWidth), 0, last);
+		for (S32 y = y0; y <= y1; ++y)
+		{
+			for (S32 x = x0; x <= x1; ++x)
+			{
+				const std::vector<Entry>& entries = mCells[y * mCellsPerSide + x];
+				for (typename std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+				{
+					func(it->mObject);
+				}
+			}
+		}
+	}
+
+	// Takes every object out of the grid.
+	void clear()
+	{
+		for (typename std::vector<std::vector<Entry> >::iterator cell = mCells.begin(); cell != mCells.end(); ++cell)
+		{
+			for (typename std::vector<Entry>::iterator it = cell->begin(); it != cell->end(); ++it)
+			{
+				it->mSlot->mGrid = NULL;
+			}
+			cell->clear();
+		}
+		mSize = 0;
+	}
+
+	U32 size() const			{ return mSize; }
+	F32 getRegionWidth() const	{ return mRegionWidth; }
+
+private:
+	struct Entry
+	{
+		T*		mObject;
+		Slot*	mSlot;
+	};
+
+	U32 getCell(F32 x, F32 y) const
+	{
+		const S32 last = (S32)mCellsPerSide - 1;
+		return (U32)(llclamp(llfloor(y / mCellWidth), 0, last) * mCellsPerSide +
+					 llclamp(llfloor(x / mCellWidth), 0, last));
+	}
+
+	// Not copyable: the slots of the objects point at this grid.
+	LLRegionGrid(const LLRegionGrid&);
+	LLRegionGrid& operator=(const LLRegionGrid&);
+
+	std::vector<std::vector<Entry> > mCells;
+	F32 mRegionWidth;
+	F32 mCellWidth;
+	U32 mCellsPerSide;
+	U32 mSize;
+};
+
+template<class T>
+const U32 LLRegionGrid<T>::MAX_CELLS_PER_SIDE = 64;
+template<class T>
+const F32 LLRegionGrid<T>::MIN_CELL_WIDTH = 16.f;
+
+#endif // LL_LLREGIONGRID_H
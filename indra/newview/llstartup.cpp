@@ -145,6 +145,7 @@
 #include "llmediafilter.h"
 #include "llmutelist.h"
 #include "llnotify.h"
+#include "llobjectupdatedecoder.h"
 #include "llpanelavatar.h"
 #include "llpaneldirbrowser.h"
 #include "llpaneldirland.h"
@@ -3038,6 +3039,22 @@ void register_viewer_callbacks(LLMessageSystem* msg)
 	msg->setHandlerFunc("ObjectUpdateCompressed",				process_compressed_object_update );
 	msg->setHandlerFunc("ObjectUpdateCached",					process_cached_object_update );
 	msg->setHandlerFuncFast(_PREHASH_ImprovedTerseObjectUpdate, process_terse_object_update_improved );
+	// Compressed and terse updates are decoded in the background and applied
+	// in arrival order as they are done. Every other handler waits for them
+	// to be applied first, unless it is listed below. Only list handlers that
+	// never look up an object or read object state, directly or through what
+	// they call.
+	msg->setFinishDeferredWorkFunc(LLObjectUpdateDecoder::finishDeferredWork, &gObjectUpdateDecoder);
+	msg->setHandlerSkipsDeferredWork("ObjectUpdateCompressed");
+	msg->setHandlerSkipsDeferredWork("ImprovedTerseObjectUpdate");
+	msg->setHandlerSkipsDeferredWork("LayerData");
+	msg->setHandlerSkipsDeferredWork("ImageData");
+	msg->setHandlerSkipsDeferredWork("ImagePacket");
+	msg->setHandlerSkipsDeferredWork("SimStats");
+	msg->setHandlerSkipsDeferredWork("SimulatorViewerTimeMessage");
+	msg->setHandlerSkipsDeferredWork("PacketAck");
+	msg->setHandlerSkipsDeferredWork("StartPingCheck");
+	msg->setHandlerSkipsDeferredWork("CompletePingCheck");
 	msg->setHandlerFunc("SimStats",				process_sim_stats);
 	msg->setHandlerFuncFast(_PREHASH_HealthMessage,			process_health_message );
 	msg->setHandlerFuncFast(_PREHASH_EconomyData,				process_economy_data);
@@ -790,6 +790,12 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 	LLTimer update_timer;
 	BOOL did_update = FALSE;
 
+	// Upload the patches composited in the background since last frame.
+	if (mRegionp && mRegionp->getComposition())
+	{
+		mRegionp->getComposition()->uploadTextures();
+	}
+
 	// If the Z height data has changed, we need to rebuild our
 	// property line vertex arrays.
 	if (!mDirtyPatchList.empty())
@@ -831,28 +837,17 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 	return did_update;
 }
 
-void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
+void LLSurface::decompressDCTPatch(const LLPatchGroup &group, BOOL b_large_patch)
 {
+	const S32 patch_size = group.mGroupHeader.patch_size;
+	std::vector<surface_patch_ref> patches;
+	patches.reserve(group.getPatchCount());
+	bool bad_patch = false;
 
-	LLPatchHeader  ph;
-	S32 j, i;
-	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
-
-	init_patch_decompressor(gopp->patch_size);
-	gopp->stride = mGridsPerEdge;
-	set_group_of_patch_header(gopp);
-
-	while (1)
+	for (S32 n = 0; n < group.getPatchCount(); n++)
 	{
-// <FS:CR> Aurora Sim
-		//decode_patch_header(bitpack, &ph);
-		decode_patch_header(bitpack, &ph, b_large_patch);
-// </FS:CR> Aurora Sim
-		if (ph.quant_wbits == END_OF_PATCHES)
-		{
-			break;
-		}
-
+		const LLPatchHeader& ph = group.mPatchHeaders[n];
+		S32 i, j;
 // <FS:CR> Aurora Sim
 		//i = ph.patchids >> 5;
 		//j = ph.patchids & 0x1F;
@@ -879,15 +874,24 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 				<< " quant_wbits " << (S32)ph.quant_wbits
 				<< " patchids " << (S32)ph.patchids
 				<< LL_ENDL;
-            LLAppViewer::instance()->badNetworkHandler();
-			return;
+			bad_patch = true;
+			break;
 		}
 
+		// The group was decoded patch_size wide, the surface is mGridsPerEdge wide.
 		const surface_patch_ref& patchp = mPatchList[j * mPatchesPerEdge + i];
+		F32* dst = patchp->getDataZ();
+		const F32* src = group.getPatchValues(n);
+		for (S32 row = 0; row < patch_size; row++)
+		{
+			memcpy(dst + row * mGridsPerEdge, src + row * patch_size, patch_size * sizeof(F32));
+		}
+		patches.push_back(patchp);
+	}
 
-		decode_patch(bitpack, patch);
-		decompress_patch(patchp->getDataZ(), patch, &ph);
-
+	// Edges and statistics once every height of the group is in place.
+	for (const surface_patch_ref& patchp : patches)
+	{
 		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
 		patchp->updateNorthEdge();
 		patchp->updateEastEdge();
@@ -913,6 +917,11 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 		}
 		patchp->setHasReceivedData();
 	}
+
+	if (bad_patch)
+	{
+		LLAppViewer::instance()->badNetworkHandler();
+	}
 }
 
 
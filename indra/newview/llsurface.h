@@ -60,8 +60,7 @@ static const S32 ONE_LESS_THAN_NEIGHBOR	= -1;
 const S32 ABOVE_WATERLINE_ALPHA = 32;  // The alpha of water when the land elevation is above the waterline.
 
 class LLViewerRegion;
-class LLBitPack;
-class LLGroupHeader;
+class LLPatchGroup;
 class LLSurfacePatch;
 
 typedef std::shared_ptr<LLSurfacePatch> surface_patch_ref;
@@ -91,7 +90,7 @@ public:
 // <FS:CR> Aurora Sim
 	void rebuildWater();
 // </FS:CR> Aurora Sim
-	virtual void decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch);
+	virtual void decompressDCTPatch(const LLPatchGroup &group, BOOL b_large_patch);
 	virtual void updatePatchVisibilities(LLAgent &agent);
 
 	inline F32 getZ(const U32 k) const				{ return mSurfaceZ[k]; }
@@ -4,7 +4,9 @@
 #include "llsqlmgr.h"
 #include "v4color.h"
 
-LLTaggedAvatarsMgr::LLTaggedAvatarsMgr() 
+static const std::string sNoContactSet;
+
+LLTaggedAvatarsMgr::LLTaggedAvatarsMgr()
 {
 }
 LLTaggedAvatarsMgr::~LLTaggedAvatarsMgr()
@@ -12,277 +14,171 @@ LLTaggedAvatarsMgr::~LLTaggedAvatarsMgr()
 }
 
 
-char LLTaggedAvatarsMgr::init() {
-  return '0';
-}
+void LLTaggedAvatarsMgr::init() {
+   LL_DEBUGS() << "Loading contact sets index from Genesis DB" << LL_ENDL;
+   mContactSets.clear();
+   mTaggedAvatars.clear();
 
+   // Both reads are queued behind any pending write, so the index always
+   // matches what is (about to be) on disk.
+   LLSqlMgr::rows_future_t contact_sets = LLSqlMgr::instance().queueRead(LLSqlMgr::AGENT_DB,
+      "SELECT ID,IFNULL(ALIAS,ID),R,G,B,A FROM CONTACTS_SET");
+   LLSqlMgr::rows_future_t tagged_avatars = LLSqlMgr::instance().queueRead(LLSqlMgr::AGENT_DB,
+      "SELECT AVATAR_ID,CONTACT_SET_ID FROM CONTACT_SET_AVATARS");
 
-void LLTaggedAvatarsMgr::updateContactSet(std::string avatarId, std::string contactSet, std::string avatarName) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   LL_DEBUGS() << "updating Tagged avatars from Genesis DB" << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "INSERT INTO CONTACT_SET_AVATARS(CONTACT_SET_ID,AVATAR_ID,AVATAR_NAME)"  \
-         "VALUES(?,?,?)"  \
-         "ON CONFLICT(AVATAR_ID) DO UPDATE SET"  \
-         "   CONTACT_SET_ID=excluded.CONTACT_SET_ID,"  \
-         "   AVATAR_NAME=excluded.AVATAR_NAME";
-        
+   for (const LLSD& row : contact_sets.get()) {
+      contact_set_t& contact_set = mContactSets[row[0].asString()];
+      contact_set.mName = row[1].asString();
+      contact_set.mColor = LLColor4(F32(row[2].asReal()), F32(row[3].asReal()), F32(row[4].asReal()), F32(row[5].asReal()));
+   }
+   for (const LLSD& row : tagged_avatars.get()) {
+      LLUUID id;
+      if (id.set(row[0].asString(), FALSE)) {
+         mTaggedAvatars[id] = row[1].asString();
+      }
+   }
 
+   LL_INFOS() << "Loaded " << mContactSets.size() << " contact sets and " << mTaggedAvatars.size() << " tagged avatars" << LL_ENDL;
+}
 
 
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   sqlite3_bind_text(stmt, 1,  contactSet.c_str(), strlen(contactSet.c_str()), 0);
-   sqlite3_bind_text(stmt, 2,  avatarId.c_str(), strlen(avatarId.c_str()), 0);
-   sqlite3_bind_text(stmt, 3,  avatarName.c_str(), strlen(avatarName.c_str()), 0);
-   
-   sqlite3_step(stmt);
-   sqlite3_finalize(stmt);
+void LLTaggedAvatarsMgr::updateContactSet(std::string avatarId, std::string contactSet, std::string avatarName) {
+   LL_DEBUGS() << "updating Tagged avatars from Genesis DB" << LL_ENDL;
+   LLUUID id;
+   if (id.set(avatarId, FALSE)) {
+      mTaggedAvatars[id] = contactSet;
+   }
+   LLSD binds;
+   binds.append(contactSet);
+   binds.append(avatarId);
+   binds.append(avatarName);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB,
+      "INSERT INTO CONTACT_SET_AVATARS(CONTACT_SET_ID,AVATAR_ID,AVATAR_NAME)"  \
+      "VALUES(?,?,?)"  \
+      "ON CONFLICT(AVATAR_ID) DO UPDATE SET"  \
+      "   CONTACT_SET_ID=excluded.CONTACT_SET_ID,"  \
+      "   AVATAR_NAME=excluded.AVATAR_NAME", binds);
 
 }
 void LLTaggedAvatarsMgr::deleteContactSet(std::string csId) {
-    char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
    LL_DEBUGS() << "Deleting Contact Set from Genesis DB" << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "DELETE FROM CONTACT_SET_AVATARS WHERE CONTACT_SET_ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  csId.c_str(), strlen(csId.c_str()), 0);
-   sqlite3_step(stmt);
-   sqlite3_finalize(stmt);
-
-   sql = "DELETE FROM CONTACTS_SET WHERE ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  csId.c_str(), strlen(csId.c_str()), 0);
-   sqlite3_step(stmt);
-   sqlite3_finalize(stmt);
+   mContactSets.erase(csId);
+   for (auto it = mTaggedAvatars.begin(); it != mTaggedAvatars.end();) {
+      if (it->second == csId) {
+         mTaggedAvatars.erase(it++);
+      } else {
+         ++it;
+      }
+   }
+   LLSD binds;
+   binds.append(csId);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "DELETE FROM CONTACT_SET_AVATARS WHERE CONTACT_SET_ID=?", binds);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "DELETE FROM CONTACTS_SET WHERE ID=?", binds);
 
 }
 void LLTaggedAvatarsMgr::deleteAvatarContactSet(std::string avatarId) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
    LL_DEBUGS() << "Deleting Tagged avatars from Genesis DB" << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "DELETE FROM CONTACT_SET_AVATARS WHERE AVATAR_ID=?";
-     
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  avatarId.c_str(), strlen(avatarId.c_str()), 0);
-   
-   
-   sqlite3_step(stmt);
-   sqlite3_finalize(stmt);
-   
-}
-std::string LLTaggedAvatarsMgr::getAvatarContactSetId(std::string avatarId) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   std::string contactSetId;
-   LL_DEBUGS() << "Getting contact_set ID from Genesis DB " << avatarId<< LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "SELECT csa.CONTACT_SET_ID FROM CONTACT_SET_AVATARS csa WHERE AVATAR_ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  avatarId.c_str(), strlen(avatarId.c_str()), 0);
-   while ( sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *id = sqlite3_column_text(stmt, 0);
-      contactSetId = std::string(reinterpret_cast<const char*>(id));
+   LLUUID id;
+   if (id.set(avatarId, FALSE)) {
+      mTaggedAvatars.erase(id);
    }
-   sqlite3_finalize(stmt);
-   return contactSetId;
+   LLSD binds;
+   binds.append(avatarId);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "DELETE FROM CONTACT_SET_AVATARS WHERE AVATAR_ID=?", binds);
+
 }
-std::string LLTaggedAvatarsMgr::getAvatarContactSetName(std::string avatarId) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   std::string contactSetId;
-   LL_DEBUGS() << "Getting contact_set name from Genesis DB" << avatarId<< LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "SELECT IFNULL(cs.ALIAS,cs.ID) FROM CONTACT_SET_AVATARS csa , CONTACTS_SET cs WHERE cs.ID=csa.CONTACT_SET_ID AND AVATAR_ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  avatarId.c_str(), strlen(avatarId.c_str()), 0);
-   while ( sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *id = sqlite3_column_text(stmt, 0);
-      contactSetId = std::string(reinterpret_cast<const char*>(id));
+const LLTaggedAvatarsMgr::contact_set_t* LLTaggedAvatarsMgr::getAvatarContactSet(const LLUUID& avatarId) const {
+   auto avatar_it = mTaggedAvatars.find(avatarId);
+   if (avatar_it == mTaggedAvatars.end()) {
+      return NULL;
    }
-   sqlite3_finalize(stmt);
-   return contactSetId;
+   auto cs_it = mContactSets.find(avatar_it->second);
+   return cs_it == mContactSets.end() ? NULL : &cs_it->second;
+}
+const std::string& LLTaggedAvatarsMgr::getAvatarContactSetId(const LLUUID& avatarId) const {
+   auto it = mTaggedAvatars.find(avatarId);
+   return it == mTaggedAvatars.end() ? sNoContactSet : it->second;
+}
+const std::string& LLTaggedAvatarsMgr::getAvatarContactSetName(const LLUUID& avatarId) const {
+   const contact_set_t* contact_set = getAvatarContactSet(avatarId);
+   return contact_set ? contact_set->mName : sNoContactSet;
+}
+LLColor4 LLTaggedAvatarsMgr::getAvatarColorContactSet(const LLUUID& avatarId) const {
+   const contact_set_t* contact_set = getAvatarContactSet(avatarId);
+   return contact_set ? contact_set->mColor : LLColor4();
+}
+const std::string& LLTaggedAvatarsMgr::getAvatarContactSetId(const std::string& avatarId) {
+   return getAvatarContactSetId(LLUUID(avatarId));
+}
+const std::string& LLTaggedAvatarsMgr::getAvatarContactSetName(const std::string& avatarId) {
+   return getAvatarContactSetName(LLUUID(avatarId));
+}
+LLColor4 LLTaggedAvatarsMgr::getAvatarColorContactSet(const std::string& avatarId) {
+   return getAvatarColorContactSet(LLUUID(avatarId));
 }
 void LLTaggedAvatarsMgr::updateColorContactSet(std::string csId, LLColor4 color) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
    const auto rgb_color = color.getValue();
    F32 r = rgb_color[0];
    F32 g = rgb_color[1];
    F32 b = rgb_color[2];
    LL_DEBUGS() << "setting Color contact set  from Genesis DB " << csId << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "UPDATE CONTACTS_SET SET R=?,G=?,B=?,A=1.0 WHERE ID = ?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   sqlite3_bind_double(stmt, 1,  r);
-   sqlite3_bind_double(stmt, 2,  g);
-   sqlite3_bind_double(stmt, 3,  b);
-   sqlite3_bind_text(stmt, 4,  csId.c_str(), strlen(csId.c_str()), 0);
-   sqlite3_step(stmt);
-   
-   sqlite3_finalize(stmt);
-   
-}
-LLColor4 LLTaggedAvatarsMgr::getColorContactSet(std::string csId) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   LLColor4 colorContactSet;
-   LL_DEBUGS() << "getting Color contact set  from Genesis DB " << csId << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "SELECT R,G,B,A FROM CONTACTS_SET where ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  csId.c_str(), strlen(csId.c_str()), 0);
-   while ( sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *id = sqlite3_column_text(stmt, 0);
-    
-      double r = sqlite3_column_double(stmt, 0);
-      double g = sqlite3_column_double(stmt, 1);
-      double b = sqlite3_column_double(stmt, 2);
-      double a = sqlite3_column_double(stmt, 3);
-      colorContactSet = LLColor4(F32(r),F32(g),F32(b),F32(a));
-      
+   auto it = mContactSets.find(csId);
+   if (it != mContactSets.end()) {
+      it->second.mColor = LLColor4(r, g, b, 1.f);
    }
-   sqlite3_finalize(stmt);
-   return colorContactSet;
+   LLSD binds;
+   binds.append(r);
+   binds.append(g);
+   binds.append(b);
+   binds.append(csId);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "UPDATE CONTACTS_SET SET R=?,G=?,B=?,A=1.0 WHERE ID = ?", binds);
+
 }
-std::string LLTaggedAvatarsMgr::getContactSetName(std::string csId) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   std::string result;
-   sqlite3_stmt *stmt;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "SELECT IFNULL(ALIAS,ID) from CONTACTS_SET where ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   sqlite3_bind_text(stmt, 1,  csId.c_str(), strlen(csId.c_str()), 0);
-   while ( sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *name = sqlite3_column_text(stmt, 0);
-      result = std::string(reinterpret_cast<const char*>(name));
-   }
-   return result;
+LLColor4 LLTaggedAvatarsMgr::getColorContactSet(const std::string& csId) {
+   auto it = mContactSets.find(csId);
+   return it == mContactSets.end() ? LLColor4() : it->second.mColor;
 }
-LLColor4 LLTaggedAvatarsMgr::getAvatarColorContactSet(std::string avatarId) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   LLColor4 colorContactSet;
-   LL_DEBUGS() << "Getting contact set color  from Genesis DB" << avatarId<< LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "SELECT csa.AVATAR_ID,R,G,B,A FROM CONTACT_SET_AVATARS csa,CONTACTS_SET cs where csa.CONTACT_SET_ID=cs.ID and csa.AVATAR_ID=?";
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   
-   sqlite3_bind_text(stmt, 1,  avatarId.c_str(), strlen(avatarId.c_str()), 0);
-   while ( sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *id = sqlite3_column_text(stmt, 0);
-    
-      double r = sqlite3_column_double(stmt, 1);
-      double g = sqlite3_column_double(stmt, 2);
-      double b = sqlite3_column_double(stmt, 3);
-      double a = sqlite3_column_double(stmt, 4);
-      colorContactSet = LLColor4(F32(r),F32(g),F32(b),F32(a));
-
-   }
-   sqlite3_finalize(stmt);
-   return colorContactSet;
+const std::string& LLTaggedAvatarsMgr::getContactSetName(const std::string& csId) {
+   auto it = mContactSets.find(csId);
+   return it == mContactSets.end() ? sNoContactSet : it->second.mName;
 }
 std::map<std::string, std::string> LLTaggedAvatarsMgr::getContactSets() {
    std::map<std::string, std::string> contact_sets;
-   char *errMsg = 0;     
-   int rc;   
-   sqlite3_stmt *result;
-   LL_DEBUGS() << "Loading Contact set from Genesis DB" << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   rc = sqlite3_prepare_v2(db, "SELECT ID, IFNULL(ALIAS,ID) from CONTACTS_SET order by 2", -1, &result, NULL);
-  
-   if (rc != SQLITE_OK) {
-    
-      LL_WARNS() << "Cannot read CONTACTS_SET table" << sqlite3_errmsg(db) << LL_ENDL;
-     
-   }
-
-   while ( sqlite3_step(result) == SQLITE_ROW) {
-      const unsigned char *id = sqlite3_column_text(result, 0);
-      const unsigned char *name = sqlite3_column_text(result, 1);
-      
-      contact_sets[std::string(reinterpret_cast<const char*>(id))] = std::string(reinterpret_cast<const char*>(name));
-      
-      
+   for (const auto& contact_set : mContactSets) {
+      contact_sets[contact_set.first] = contact_set.second.mName;
    }
-   sqlite3_finalize(result);
    return contact_sets;
 }
 void LLTaggedAvatarsMgr::updateContactSetName(std::string csId, std::string csAlias) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   std::string result;
    LL_DEBUGS() << "updating  contact set name" << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "UPDATE CONTACTS_SET SET ALIAS = ? WHERE ID= ?";
-
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   sqlite3_bind_text(stmt, 1,  csAlias.c_str(), strlen(csAlias.c_str()), 0);
-   sqlite3_bind_text(stmt, 2,  csId.c_str(), strlen(csId.c_str()), 0);
-   
-   
-   
-   rc=sqlite3_step(stmt);
-  
-   if (rc == SQLITE_DONE) {
-      //enoyer un signal
+   auto it = mContactSets.find(csId);
+   if (it != mContactSets.end()) {
+      it->second.mName = csAlias;
    }
-   sqlite3_finalize(stmt);
-   
+   LLSD binds;
+   binds.append(csAlias);
+   binds.append(csId);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "UPDATE CONTACTS_SET SET ALIAS = ? WHERE ID= ?", binds);
+
 }
 std::string LLTaggedAvatarsMgr::insertContactSet(std::string csId, std::string csAlias) {
-   char *errMsg = 0;     
-   int rc;   
-   char *sql;
-   sqlite3_stmt *stmt;
-   std::string result;
    LL_DEBUGS() << "inserting new contact set" << LL_ENDL;
-   sqlite3 *db = LLSqlMgr::instance().getDB();
-   sql = "INSERT INTO CONTACTS_SET(ID,ALIAS,R,G,B,A)"  \
-         "VALUES(?,?,?,?,?,?)";
-        
-
-   sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-   sqlite3_bind_text(stmt, 1,  csId.c_str(), strlen(csId.c_str()), 0);
-   sqlite3_bind_text(stmt, 2,  csAlias.c_str(), strlen(csAlias.c_str()), 0);
-   sqlite3_bind_double(stmt, 3,0.0 );
-   sqlite3_bind_double(stmt, 4,0.0 );
-   sqlite3_bind_double(stmt, 5,0.0 );
-   sqlite3_bind_double(stmt, 6,1.0 );
-   
-   rc=sqlite3_step(stmt);
-  
-   if (rc == SQLITE_DONE) {
-      //enoyer un signal
+   if (mContactSets.find(csId) != mContactSets.end()) {
+      // ID is the primary key: the DB would refuse the row, so leave it alone.
+      LL_WARNS() << "Contact set " << csId << " already exists" << LL_ENDL;
+      return csId;
    }
-   sqlite3_finalize(stmt);
-   return result;
-}
\ No newline at end of file
+   contact_set_t& contact_set = mContactSets[csId];
+   contact_set.mName = csAlias;
+   contact_set.mColor = LLColor4(0.f, 0.f, 0.f, 1.f);
+
+   LLSD binds;
+   binds.append(csId);
+   binds.append(csAlias);
+   binds.append(0.0);
+   binds.append(0.0);
+   binds.append(0.0);
+   binds.append(1.0);
+   LLSqlMgr::instance().queueWrite(LLSqlMgr::AGENT_DB, "INSERT INTO CONTACTS_SET(ID,ALIAS,R,G,B,A) VALUES(?,?,?,?,?,?)", binds);
+   return csId;
+}
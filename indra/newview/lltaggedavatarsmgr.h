@@ -1,8 +1,10 @@
-
 #include <stdio.h>
 
 #include "sqlite3.h"
+#include "lluuid.h"
 #include "v4color.h"
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/node_hash_map.h>
 
 #ifndef LLTAGGEDAVATARSMGR_H
 #define LLTAGGEDAVATARSMGR_H
@@ -13,25 +15,43 @@ public:
 	LLTaggedAvatarsMgr();
 	~LLTaggedAvatarsMgr();
 
-    // viewer auth version
-	char init();
-    
-    
+    // Loads the contact sets and tagged avatars from the agent DB into the
+    // in-memory index. Must be called once the agent DB has been opened.
+    // A query that fails is logged by the DB thread and loads nothing.
+	void init();
+
+
     std::map<std::string, std::string> getContactSets();
     void updateColorContactSet(std::string csId, LLColor4 color);
     void updateContactSet(std::string avatarId, std::string contactSet,std::string avatarName);
     void updateContactSetName(std::string csId, std::string csAlias);
     void deleteContactSet(std::string csId);
     void deleteAvatarContactSet(std::string avatarId);
-    std::string getAvatarContactSetId(std::string avatarId);
-    std::string getAvatarContactSetName(std::string avatarId);
-    LLColor4 getAvatarColorContactSet(std::string avatarId);
-    LLColor4 getColorContactSet(std::string csId);
-    std::string getContactSetName(std::string csId);
+    const std::string& getAvatarContactSetId(const std::string& avatarId);
+    const std::string& getAvatarContactSetName(const std::string& avatarId);
+    LLColor4 getAvatarColorContactSet(const std::string& avatarId);
+    LLColor4 getColorContactSet(const std::string& csId);
+    const std::string& getContactSetName(const std::string& csId);
     std::string insertContactSet(std::string csId, std::string csAlias);
+
+    // Index lookups for the per-frame callers (name tags, radar, chat...).
+    // These never touch the DB and never allocate.
+    const std::string& getAvatarContactSetId(const LLUUID& avatarId) const;
+    const std::string& getAvatarContactSetName(const LLUUID& avatarId) const;
+    LLColor4 getAvatarColorContactSet(const LLUUID& avatarId) const;
+
 private:
-    std::map<std::string, LLColor4> mTaggedAvatarsColors;
-    std::map<std::string, std::string> mTaggedAvatarsContactSetName;
+    struct contact_set_t
+    {
+        std::string mName;   // IFNULL(ALIAS,ID)
+        LLColor4 mColor;
+    };
+    const contact_set_t* getAvatarContactSet(const LLUUID& avatarId) const;
+
+    // Write-through cache of CONTACTS_SET, keyed by contact set ID.
+    absl::node_hash_map<std::string, contact_set_t> mContactSets;
+    // Write-through cache of CONTACT_SET_AVATARS: avatar -> contact set ID.
+    absl::flat_hash_map<LLUUID, std::string> mTaggedAvatars;
 };
 
 #endif /* LLTAGGEDAVATARSMGR_H */
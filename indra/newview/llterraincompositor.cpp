@@ -0,0 +1,389 @@
+/**
+ * @file llterraincompositor.cpp
+ * @brief Terrain texture compositing, off the main thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llterraincompositor.h"
+
+#include "llmath.h"
+#include "llsimdmath.h"
+
+//============================================================================
+
+LLTerrainCompositeJob::LLTerrainCompositeJob(LLPointer<LLImageRaw> const* details, S32 detail_size,
+											 const F32* composition, U32 width, F32 scale,
+											 S32 tex_width, S32 tex_height,
+											 S32 tex_x_begin, S32 tex_y_begin, S32 tex_x_end, S32 tex_y_end,
+											 F32 tex_x_ratio, F32 tex_y_ratio, F32 st_x_stride, F32 st_y_stride)
+	: mDetailSize(detail_size),
+	  mWidth(width),
+	  mScaleInv(1.f / scale),
+	  mTexWidth(tex_width),
+	  mTexHeight(tex_height),
+	  mTexXBegin(tex_x_begin),
+	  mTexYBegin(tex_y_begin),
+	  mTexXEnd(tex_x_end),
+	  mTexYEnd(tex_y_end),
+	  mTexXRatio(tex_x_ratio),
+	  mTexYRatio(tex_y_ratio),
+	  mSTXStride(st_x_stride),
+	  mSTYStride(st_y_stride),
+	  mDone(0)
+{
+	for (S32 i = 0; i < DETAIL_COUNT; i++)
+	{
+		mDetails[i] = details[i];
+	}
+
+	// Only copy the composition cells that the bilinear samples of the
+	// rectangle can reach; the sample positions only grow with i and j.
+	S32 x_first = 0, x_last = 0, y_first = 0, y_last = 0;
+	if (tex_x_end > tex_x_begin && tex_y_end > tex_y_begin)
+	{
+		x_first = llclamp(llfloor(tex_x_begin * mTexXRatio * mScaleInv), 0, mWidth - 1);
+		x_last = llclamp(llfloor((tex_x_end - 1) * mTexXRatio * mScaleInv) + 1, 0, mWidth - 1);
+		y_first = llclamp(llfloor(tex_y_begin * mTexYRatio * mScaleInv), 0, mWidth - 1);
+		y_last = llclamp(llfloor((tex_y_end - 1) * mTexYRatio * mScaleInv) + 1, 0, mWidth - 1);
+	}
+	mWindowX = x_first;
+	mWindowY = y_first;
+	mWindowWidth = x_last - x_first + 1;
+	mWindow.resize(mWindowWidth * (y_last - y_first + 1));
+	for (S32 y = y_first; y <= y_last; y++)
+	{
+		memcpy(&mWindow[(y - y_first) * mWindowWidth], composition + y * mWidth + x_first, mWindowWidth * sizeof(F32));
+	}
+}
+
+F32 LLTerrainCompositeJob::getValueScaled(F32 x, F32 y) const
+{
+	S32 x1, x2, y1, y2;
+	F32 x_frac, y_frac;
+
+	x_frac = x*mScaleInv;
+	x1 = llfloor(x_frac);
+	x2 = x1 + 1;
+	x_frac -= x1;
+
+	y_frac = y*mScaleInv;
+	y1 = llfloor(y_frac);
+	y2 = y1 + 1;
+	y_frac -= y1;
+
+	x1 = llclamp(x1, 0, mWidth - 1) - mWindowX;
+	x2 = llclamp(x2, 0, mWidth - 1) - mWindowX;
+	y1 = llclamp(y1, 0, mWidth - 1) - mWindowY;
+	y2 = llclamp(y2, 0, mWidth - 1) - mWindowY;
+
+	S32 row1 = y1 * mWindowWidth;
+	S32 row2 = y2 * mWindowWidth;
+
+	F32 row1_left  = mWindow[ row1 + x1 ];
+	F32 row1_right = mWindow[ row1 + x2 ];
+	F32 row2_left  = mWindow[ row2 + x1 ];
+	F32 row2_right = mWindow[ row2 + x2 ];
+
+	F32 row1_interp = row1_left - x_frac * (row1_left - row1_right);
+	F32 row2_interp = row2_left - x_frac * (row2_left - row2_right);
+
+	return row1_interp - y_frac * (row1_interp - row2_interp);
+}
+
+// Same arithmetic as getValueScaled(), so the result does not depend on
+// which texels of the row end up in the SIMD part.
+void LLTerrainCompositeJob::compositionRow(S32 j, F32* values) const
+{
+	const F32 y = j*mTexYRatio;
+	F32 y_frac = y*mScaleInv;
+	S32 y1 = llfloor(y_frac);
+	S32 y2 = y1 + 1;
+	y_frac -= y1;
+	const S32 row1 = (llclamp(y1, 0, mWidth - 1) - mWindowY) * mWindowWidth - mWindowX;
+	const S32 row2 = (llclamp(y2, 0, mWidth - 1) - mWindowY) * mWindowWidth - mWindowX;
+
+	const __m128 x_ratio = _mm_set1_ps(mTexXRatio);
+	const __m128 scale_inv = _mm_set1_ps(mScaleInv);
+	const __m128 y_fracv = _mm_set1_ps(y_frac);
+
+	const S32 count = mTexXEnd - mTexXBegin;
+	S32 k = 0;
+	for (; k + 4 <= count; k += 4)
+	{
+		const S32 i = mTexXBegin + k;
+		__m128 x_frac = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(i, i + 1, i + 2, i + 3)), x_ratio), scale_inv);
+		// x_frac >= 0, so truncating is llfloor()
+		__m128i x1 = _mm_cvttps_epi32(x_frac);
+		x_frac = _mm_sub_ps(x_frac, _mm_cvtepi32_ps(x1));
+
+		LL_ALIGN_16(S32 x1s[4]);
+		LL_ALIGN_16(F32 row1_lefts[4]);
+		LL_ALIGN_16(F32 row1_rights[4]);
+		LL_ALIGN_16(F32 row2_lefts[4]);
+		LL_ALIGN_16(F32 row2_rights[4]);
+		_mm_store_si128((__m128i*)x1s, x1);
+		for (S32 l = 0; l < 4; l++)
+		{
+			const S32 left = llclamp(x1s[l], 0, mWidth - 1);
+			const S32 right = llclamp(x1s[l] + 1, 0, mWidth - 1);
+			row1_lefts[l] = mWindow[row1 + left];
+			row1_rights[l] = mWindow[row1 + right];
+			row2_lefts[l] = mWindow[row2 + left];
+			row2_rights[l] = mWindow[row2 + right];
+		}
+		const __m128 row1_left = _mm_load_ps(row1_lefts);
+		const __m128 row2_left = _mm_load_ps(row2_lefts);
+		const __m128 row1_interp = _mm_sub_ps(row1_left, _mm_mul_ps(x_frac, _mm_sub_ps(row1_left, _mm_load_ps(row1_rights))));
+		const __m128 row2_interp = _mm_sub_ps(row2_left, _mm_mul_ps(x_frac, _mm_sub_ps(row2_left, _mm_load_ps(row2_rights))));
+		_mm_storeu_ps(values + k, _mm_sub_ps(row1_interp, _mm_mul_ps(y_fracv, _mm_sub_ps(row1_interp, row2_interp))));
+	}
+	for (; k < count; k++)
+	{
+		values[k] = getValueScaled((mTexXBegin + k)*mTexXRatio, y);
+	}
+}
+
+void LLTerrainCompositeJob::composite()
+{
+	const U32 tex_comps = COMPONENTS;
+	const U32 st_comps = COMPONENTS;
+	const U32 st_width = mDetailSize;
+	const U32 st_height = mDetailSize;
+
+	const U8* st_data[DETAIL_COUNT];
+	S32 st_data_size[DETAIL_COUNT];
+	for (S32 i = 0; i < DETAIL_COUNT; i++)
+	{
+		st_data[i] = mDetails[i]->getData();
+		st_data_size[i] = mDetails[i]->getDataSize();
+	}
+
+	const S32 row_length = mTexXEnd - mTexXBegin;
+	if (row_length <= 0 || mTexYEnd <= mTexYBegin)
+	{
+		return;
+	}
+	mRawImage = new LLImageRaw(row_length, mTexYEnd - mTexYBegin, tex_comps);
+	U8 *rawp = mRawImage->getData();
+	const U32 tex_stride = row_length * tex_comps;
+	std::vector<F32> composition(row_length);
+
+	// Linearly interpolates between the two detail textures picked by a composition value.
+	auto blend_texel = [&](U8* outp, F32 value, S32 st_offset)
+	{
+		S32 tex0 = llclamp(llfloor(value), 0, 3);
+		S32 tex1 = llclamp(tex0 + 1, 0, 3);
+		value -= tex0;
+		if (st_offset + (S32)st_comps > st_data_size[tex0] || st_offset + (S32)st_comps > st_data_size[tex1])
+		{
+			// SJB: This shouldn't be happening, but does... Rounding error?
+			return;
+		}
+		for (U32 k = 0; k < tex_comps; k++)
+		{
+			F32 a = st_data[tex0][st_offset + k];
+			F32 b = st_data[tex1][st_offset + k];
+			outp[k] = (U8)lltrunc( a + value * (b - a) );
+		}
+	};
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i three = _mm_set1_epi32(3);
+	const __m128i low_byte = _mm_set1_epi32(0xFF);
+
+	F32 sti, stj;
+	stj = (mTexYBegin * mSTYStride) - st_height*(llfloor((mTexYBegin * mSTYStride)/st_height));
+	for (S32 j = mTexYBegin; j < mTexYEnd; j++)
+	{
+		compositionRow(j, &composition[0]);
+
+		U8* outp = rawp + (j - mTexYBegin) * tex_stride;
+		const U32 st_row = lltrunc(stj)*st_width;
+		sti = (mTexXBegin * mSTXStride) - st_width*((U32)(mTexXBegin * mSTXStride)/st_width);
+
+		S32 i = 0;
+		for (; i + 4 <= row_length; i += 4)
+		{
+			const __m128 value = _mm_loadu_ps(&composition[i]);
+			// tex0 = llclamp(llfloor(value), 0, 3)
+			__m128i tex0 = _mm_cvttps_epi32(value);
+			tex0 = _mm_add_epi32(tex0, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(tex0), value)));
+			tex0 = _mm_and_si128(tex0, _mm_cmpgt_epi32(tex0, zero));
+			const __m128i over = _mm_cmpgt_epi32(tex0, three);
+			tex0 = _mm_or_si128(_mm_andnot_si128(over, tex0), _mm_and_si128(over, three));
+			const __m128 frac = _mm_sub_ps(value, _mm_cvtepi32_ps(tex0));
+
+			LL_ALIGN_16(S32 tex0s[4]);
+			_mm_store_si128((__m128i*)tex0s, tex0);
+			S32 st_offsets[4];
+			bool in_bounds = true;
+			for (S32 l = 0; l < 4; l++)
+			{
+				st_offsets[l] = (lltrunc(sti) + st_row) * st_comps;
+				const S32 tex1 = llmin(tex0s[l] + 1, 3);
+				in_bounds &= st_offsets[l] + (S32)st_comps <= st_data_size[tex0s[l]]
+							 && st_offsets[l] + (S32)st_comps <= st_data_size[tex1];
+				sti += mSTXStride;
+				if (sti >= st_width)
+				{
+					sti -= st_width;
+				}
+			}
+
+			if (!in_bounds)
+			{
+				for (S32 l = 0; l < 4; l++)
+				{
+					blend_texel(outp + l * tex_comps, composition[i + l], st_offsets[l]);
+				}
+				outp += 4 * tex_comps;
+				continue;
+			}
+
+			// The 12 components of the 4 texels, 4 per register.
+			const U8* a[4];
+			const U8* b[4];
+			for (S32 l = 0; l < 4; l++)
+			{
+				a[l] = st_data[tex0s[l]] + st_offsets[l];
+				b[l] = st_data[llmin(tex0s[l] + 1, 3)] + st_offsets[l];
+			}
+			const __m128 a0 = _mm_setr_ps(a[0][0], a[0][1], a[0][2], a[1][0]);
+			const __m128 a1 = _mm_setr_ps(a[1][1], a[1][2], a[2][0], a[2][1]);
+			const __m128 a2 = _mm_setr_ps(a[2][2], a[3][0], a[3][1], a[3][2]);
+			const __m128 b0 = _mm_setr_ps(b[0][0], b[0][1], b[0][2], b[1][0]);
+			const __m128 b1 = _mm_setr_ps(b[1][1], b[1][2], b[2][0], b[2][1]);
+			const __m128 b2 = _mm_setr_ps(b[2][2], b[3][0], b[3][1], b[3][2]);
+			const __m128 c0 = _mm_shuffle_ps(frac, frac, _MM_SHUFFLE(1, 0, 0, 0));
+			const __m128 c1 = _mm_shuffle_ps(frac, frac, _MM_SHUFFLE(2, 2, 1, 1));
+			const __m128 c2 = _mm_shuffle_ps(frac, frac, _MM_SHUFFLE(3, 3, 3, 2));
+
+			// (U8)lltrunc(a + c * (b - a)): truncate, then keep the low byte.
+			const __m128i r0 = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(a0, _mm_mul_ps(c0, _mm_sub_ps(b0, a0)))), low_byte);
+			const __m128i r1 = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(a1, _mm_mul_ps(c1, _mm_sub_ps(b1, a1)))), low_byte);
+			const __m128i r2 = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(a2, _mm_mul_ps(c2, _mm_sub_ps(b2, a2)))), low_byte);
+			const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, zero));
+			_mm_storel_epi64((__m128i*)outp, bytes);
+			const S32 last = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+			memcpy(outp + 8, &last, 4);
+			outp += 4 * tex_comps;
+		}
+		for (; i < row_length; i++)
+		{
+			blend_texel(outp, composition[i], (lltrunc(sti) + st_row) * st_comps);
+			outp += tex_comps;
+			sti += mSTXStride;
+			if (sti >= st_width)
+			{
+				sti -= st_width;
+			}
+		}
+
+		stj += mSTYStride;
+		if (stj >= st_height)
+		{
+			stj -= st_height;
+		}
+	}
+}
+
+//============================================================================
+
+class LLTerrainCompositeThread::Request : public LLQueuedThread::QueuedRequest
+{
+protected:
+	virtual ~Request() // use deleteRequest()
+	{
+		// Last access to the job: the main thread may release it from now on.
+		mJob->setDone();
+	}
+
+public:
+	Request(handle_t handle, LLTerrainCompositeJob* job)
+		: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, FLAG_AUTO_COMPLETE),
+		  mJob(job)
+	{
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		mJob->composite();
+		return true;
+	}
+
+private:
+	// Not a reference: those only ever change on the main thread, which
+	// holds the job until it is done.
+	LLTerrainCompositeJob* mJob;
+};
+
+//----------------------------------------------------------------------------
+
+/*static*/ LLTerrainCompositeThread* LLTerrainCompositeThread::sLocal = NULL;
+
+// Run on MAIN thread
+//static
+void LLTerrainCompositeThread::initClass(bool local_is_threaded)
+{
+	llassert(sLocal == NULL);
+	sLocal = new LLTerrainCompositeThread(local_is_threaded);
+}
+
+//static
+S32 LLTerrainCompositeThread::updateClass(U32 ms_elapsed)
+{
+	sLocal->update((F32)ms_elapsed);
+	return sLocal->getPending();
+}
+
+//static
+void LLTerrainCompositeThread::cleanupClass()
+{
+	// Requests still queued are deleted unprocessed, which marks their jobs done.
+	delete sLocal;
+	sLocal = NULL;
+}
+
+LLTerrainCompositeThread::LLTerrainCompositeThread(bool threaded)
+	: LLQueuedThread("terraincomposite", threaded, false, 4, LLJobSystem::PRIORITY_LOW)
+{
+}
+
+// MAIN thread
+LLTerrainCompositeThread::handle_t LLTerrainCompositeThread::composite(LLTerrainCompositeJob* job)
+{
+	handle_t handle = generateHandle();
+	Request* req = new Request(handle, job);
+	if (!addRequest(req))
+	{
+		// Quitting: composite right away rather than never.
+		job->composite();
+		req->deleteRequest();
+		return nullHandle();
+	}
+	// Unpauses the thread, or composites now when not threaded.
+	update(0);
+	return handle;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file llterraincompositor.h
+ * @brief Terrain texture compositing, off the main thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTERRAINCOMPOSITOR_H
+#define LL_LLTERRAINCOMPOSITOR_H
+
+#include "llatomic.h"
+#include "llimage.h"
+#include "llpointer.h"
+#include "llqueuedthread.h"
+#include "llrefcount.h"
+
+#include <vector>
+
+// Everything needed to blend the four detail textures into one patch
+// rectangle of a region's terrain texture. The composition values are
+// copied in, so composite() does not touch the region and can run on any
+// thread. The job is only ever referenced from the main thread.
+class LLTerrainCompositeJob : public LLRefCount
+{
+public:
+	enum { DETAIL_COUNT = 4, COMPONENTS = 3 };
+
+	// MAIN THREAD
+	// 'composition' is the LLViewerLayer data (width x width values, one
+	// per scale meters), only the cells this rectangle samples are kept.
+	LLTerrainCompositeJob(LLPointer<LLImageRaw> const* details, S32 detail_size,
+						  const F32* composition, U32 width, F32 scale,
+						  S32 tex_width, S32 tex_height,
+						  S32 tex_x_begin, S32 tex_y_begin, S32 tex_x_end, S32 tex_y_end,
+						  F32 tex_x_ratio, F32 tex_y_ratio, F32 st_x_stride, F32 st_y_stride);
+
+	// ANY THREAD
+	// Composites the rectangle into a raw image of its own size.
+	void composite();
+
+	// MAIN THREAD
+	// True once the job has left the compositing thread, composited or not.
+	bool isDone() const					{ return mDone != 0; }
+	// The texels of the rectangle; NULL if the job was dropped before it ran.
+	LLImageRaw* getRawImage() const		{ return mRawImage; }
+
+	S32 getTexWidth() const				{ return mTexWidth; }
+	S32 getTexHeight() const			{ return mTexHeight; }
+	S32 getTexXBegin() const			{ return mTexXBegin; }
+	S32 getTexYBegin() const			{ return mTexYBegin; }
+	S32 getTexXEnd() const				{ return mTexXEnd; }
+	S32 getTexYEnd() const				{ return mTexYEnd; }
+
+protected:
+	friend class LLTerrainCompositeThread;
+	void setDone()						{ mDone = 1; }
+
+	// Bilinear sample of the composition values, as LLViewerLayer::getValueScaled().
+	F32 getValueScaled(F32 x, F32 y) const;
+	// Composition values of row j of the target texture, 4 texels at a time.
+	void compositionRow(S32 j, F32* values) const;
+
+	// Holds a reference so the main thread cannot free them under composite().
+	LLPointer<LLImageRaw> mDetails[DETAIL_COUNT];
+	S32 mDetailSize;
+
+	// Composition values window: columns [mWindowX, mWindowX + mWindowWidth), rows likewise.
+	std::vector<F32> mWindow;
+	S32 mWindowX;
+	S32 mWindowY;
+	S32 mWindowWidth;
+	S32 mWidth;
+	F32 mScaleInv;
+
+	S32 mTexWidth;
+	S32 mTexHeight;
+	S32 mTexXBegin;
+	S32 mTexYBegin;
+	S32 mTexXEnd;
+	S32 mTexYEnd;
+	F32 mTexXRatio;
+	F32 mTexYRatio;
+	F32 mSTXStride;
+	F32 mSTYStride;
+
+	LLPointer<LLImageRaw> mRawImage;
+	LLAtomicU32 mDone;
+};
+
+// Composites terrain patches in the background. The main thread keeps a
+// reference to each job it submits and uploads the result once isDone().
+class LLTerrainCompositeThread : public LLQueuedThread
+{
+public:
+	static void initClass(bool local_is_threaded = true); // Setup sLocal
+	static S32 updateClass(U32 ms_elapsed);
+	static void cleanupClass();		// Delete sLocal
+
+	handle_t composite(LLTerrainCompositeJob* job);
+
+public:
+	static LLTerrainCompositeThread* sLocal;		// Default worker thread
+
+private:
+	LLTerrainCompositeThread(bool threaded);
+
+	class Request;
+};
+
+#endif // LL_LLTERRAINCOMPOSITOR_H
@@ -29,6 +29,7 @@
 #include "lltexturecache.h"
 
 #include "llapr.h"
+#include "apr_atomic.h"
 #include "lldir.h"
 #include "llimage.h"
 #include "lllfsthread.h"
@@ -40,7 +41,7 @@
 
 // Cache organization:
 // cache/texture.entries
-//  Unordered array of Entry structs
+//  Unordered array of Entry structs, memory mapped with room for sCacheMaxEntries
 // cache/texture.cache
 //  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
 // cache/textures/[0-F]/UUID.texture
@@ -738,8 +739,9 @@ void LLTextureCacheWorker::endWork(S32 param, bool aborted)
 //////////////////////////////////////////////////////////////////////////////
 
 LLTextureCache::LLTextureCache(bool threaded)
-	: LLWorkerThread("TextureCache", threaded),
-	  mHeaderAPRFile(NULL),
+	// One job at a time: the header and entry files are not safe to share between workers.
+	: LLWorkerThread("TextureCache", threaded, false, 1, LLJobSystem::PRIORITY_HIGH),
+	  mHeaderEntriesCapacity(0),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
 	  mTexturesSizeTotal(0),
 	  mDoPurge(FALSE)
@@ -749,7 +751,7 @@ LLTextureCache::LLTextureCache(bool threaded)
 LLTextureCache::~LLTextureCache()
 {
 	clearDeleteList();
-	writeUpdatedEntries();
+	closeHeaderEntriesFile();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -798,7 +800,7 @@ S32 LLTextureCache::update(F32 max_time_ms)
 	if(!res && timer.getElapsedTimeF32() > MAX_TIME_INTERVAL)
 	{
 		timer.reset();
-		writeUpdatedEntries();
+		flushHeaderEntries();
 	}
 
 	return res;
@@ -900,7 +902,7 @@ void LLTextureCache::purgeCache(ELLPath location)
 	if (!mReadOnly)
 	{
 		setDirNames(location);
-		llassert_always(mHeaderAPRFile == NULL);
+		llassert_always(!mHeaderEntriesMap.isOpen());
 
 		//remove the legacy cache if exists
 		std::string texture_dir = mTexturesDirName;
@@ -985,36 +987,52 @@ U64 LLTextureCache::initCache(ELLPath location, U64 max_size, BOOL texture_cache
 //----------------------------------------------------------------------------
 // mHeaderMutex must be locked for the following functions!
 
-LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
+// Maps the entries file once, with room for sCacheMaxEntries entries. The
+// mapping is kept until the cache is destroyed.
+bool LLTextureCache::openHeaderEntriesFile()
 {
-	llassert_always(mHeaderAPRFile == NULL);
-	apr_int32_t flags = readonly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_BINARY;
-	// All code calling openHeaderEntriesFile, immediately calls closeHeaderEntriesFile,
-	// so this file is very short-lived.
-	mHeaderAPRFile = new LLAPRFile(mHeaderEntriesFileName, flags);
-	if(offset > 0)
+	if (mHeaderEntriesMap.isOpen())
 	{
-	mHeaderAPRFile->seek(APR_SET, offset);
+		return true;
 	}
-	return mHeaderAPRFile;
-}
 
-void LLTextureCache::closeHeaderEntriesFile()
-{
-	if(!mHeaderAPRFile)
+	bool mapped;
+	if (mReadOnly)
 	{
-		return;
+		// Changes stay in memory, like they did when nothing was written back.
+		mapped = mHeaderEntriesMap.open(mHeaderEntriesFileName, LLMappedFile::COPY_ON_WRITE);
 	}
+	else
+	{
+		// A cache shrunk since last run keeps its entries until readHeaderCache() prunes them.
+		U32 capacity = llmax(sCacheMaxEntries, mHeaderEntriesInfo.mEntries);
+		mapped = mHeaderEntriesMap.open(mHeaderEntriesFileName, LLMappedFile::READ_WRITE,
+										sizeof(EntriesInfo) + (size_t)capacity * sizeof(Entry));
+	}
+	if (!mapped || mHeaderEntriesMap.getSize() < sizeof(EntriesInfo))
+	{
+		mHeaderEntriesMap.close();
+		mHeaderEntriesCapacity = 0;
+		return false;
+	}
+	mHeaderEntriesCapacity = (mHeaderEntriesMap.getSize() - sizeof(EntriesInfo)) / sizeof(Entry);
+	return true;
+}
 
-	delete mHeaderAPRFile;
-	mHeaderAPRFile = NULL;
+void LLTextureCache::closeHeaderEntriesFile()
+{
+	mHeaderEntriesMap.close();
+	mHeaderEntriesCapacity = 0;
 }
 
 void LLTextureCache::readEntriesHeader()
 {
 	// mHeaderEntriesInfo initializes to default values so safe not to read it
-		llassert_always(mHeaderAPRFile == NULL);
-	if (LLAPRFile::isExist(mHeaderEntriesFileName))
+	if (mHeaderEntriesMap.isOpen())
+	{
+		memcpy(&mHeaderEntriesInfo, mHeaderEntriesMap.getData(), sizeof(EntriesInfo));
+	}
+	else if (LLAPRFile::isExist(mHeaderEntriesFileName))
 	{
 		LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
 	}
@@ -1028,8 +1046,12 @@ void LLTextureCache::readEntriesHeader()
 
 void LLTextureCache::writeEntriesHeader()
 {
-	llassert_always(mHeaderAPRFile == NULL);
-	if (!mReadOnly)
+	if (mHeaderEntriesMap.isOpen())
+	{
+		// Copy on write when read only, so the file is left alone either way.
+		memcpy(mHeaderEntriesMap.getData(), &mHeaderEntriesInfo, sizeof(EntriesInfo));
+	}
+	else if (!mReadOnly)
 	{
 		LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
 	}
@@ -1039,7 +1061,7 @@ void LLTextureCache::writeEntriesHeader()
 S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
 {
 	S32 idx = -1;
-	
+
 	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
 	if (iter1 != mHeaderIDMap.end())
 	{
@@ -1079,14 +1101,14 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 						break;
 					}
 				}
-				// if (idx < 0) at this point, we will rebuild the LRU 
+				// if (idx < 0) at this point, we will rebuild the LRU
 				//  and retry if called from setHeaderCacheEntry(),
 				//  otherwise this shouldn't happen and will trigger an error
 			}
 			if (idx >= 0)
 			{
 				entry.mID = id;
-				entry.mImageSize = -1; //mark it is a brand-new entry.					
+				entry.mImageSize = -1; //mark it is a brand-new entry.
 				entry.mBodySize = 0;
 			}
 		}
@@ -1096,23 +1118,14 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 		// Remove this entry from the LRU if it exists
 		mLRU.erase(id);
 		// Read the entry
-		idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx);
-		if(iter != mUpdatedEntryMap.end())
-		{
-			entry = iter->second;
-		}
-		else
-		{
-			readEntryFromHeaderImmediately(idx, entry);
-		}
-		if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
+		readEntryFromHeaderImmediately(idx, entry);
+		if(idx >= 0 && entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
 		{
 			LL_WARNS() << "corrupted entry: " << id << " entry image size: " << entry.mImageSize << " entry body size: " << entry.mBodySize << LL_ENDL;
 
 			//erase this entry and the cached texture from the cache.
 			std::string tex_filename = getTextureFileName(id);
 			removeEntry(idx, entry, tex_filename);
-			mUpdatedEntryMap.erase(idx);
 			idx = -1;
 		}
 	}
@@ -1121,57 +1134,36 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
-{	
-	LLAPRFile* aprfile;
-	S32 bytes_written;
-	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-	if(write_header)
-	{
-		aprfile = openHeaderEntriesFile(false, 0);		
-		bytes_written = aprfile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache(); //clear the cache.
-			idx = -1; //mark the idx invalid.
-			return;
-		}
-
-		mHeaderAPRFile->seek(APR_SET, offset);
-	}
-	else
-	{
-		aprfile = openHeaderEntriesFile(false, offset);
-	}
-	bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-	if(bytes_written != sizeof(Entry))
+{
+	if (idx < 0 || (U32)idx >= mHeaderEntriesCapacity)
 	{
 		clearCorruptedCache(); //clear the cache.
 		idx = -1; //mark the idx invalid.
-
 		return;
 	}
-
-	closeHeaderEntriesFile();
-	mUpdatedEntryMap.erase(idx);
+	if(write_header)
+	{
+		writeEntriesHeader();
+	}
+	getMappedEntries()[idx] = entry;
 }
 
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
 {
-		S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-		LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
-		S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
-		closeHeaderEntriesFile();
-
-	if(bytes_read != sizeof(Entry))
+	if (idx < 0 || (U32)idx >= mHeaderEntriesCapacity)
 	{
 		clearCorruptedCache(); //clear the cache.
 		idx = -1;//mark the idx invalid.
+		return;
 	}
+	entry = getMappedEntries()[idx];
 }
 
-//mHeaderMutex is locked before calling this.
-//update an existing entry time stamp, delay writing.
+//update an existing entry time stamp.
+//Does not need mHeaderMutex: only the time of the mapped entry is stored, and
+//the mapping outlives every worker. If the entry was reused meanwhile, the new
+//texture just looks a little more recent to the LRU.
 void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 {
 	static const U32 MAX_ENTRIES_WITHOUT_TIME_STAMP = (U32)(LLTextureCache::sCacheMaxEntries * 0.75f);
@@ -1181,12 +1173,12 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 		return; //there are enough empty entry index space, no need to stamp time.
 	}
 
-	if (idx >= 0)
+	if (idx >= 0 && (U32)idx < mHeaderEntriesCapacity)
 	{
 		if (!mReadOnly)
 		{
 			entry.mTime = time(NULL);
-			mUpdatedEntryMap[idx] = entry;
+			apr_atomic_set32((volatile apr_uint32_t*)&getMappedEntries()[idx].mTime, entry.mTime);
 		}
 	}
 }
@@ -1195,45 +1187,43 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
 {
 	S32 new_body_size = llmax(0, new_data_size - TEXTURE_CACHE_ENTRY_SIZE);
-	
+
 	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize)
 			{
 		return true; //nothing changed.
 			}
-	else 
+	else
 	{
 		bool purge = false;
-			
+
 		lockHeaders();
 
 		bool update_header = false;
 		if(entry.mImageSize < 0) //is a brand-new entry
 			{
 			mHeaderIDMap[entry.mID] = idx;
-			mTexturesSizeMap[entry.mID] = new_body_size;
 			mTexturesSizeTotal += new_body_size;
-			
+
 			// Update Header
 			update_header = true;
 			}
 		else if (entry.mBodySize != new_body_size)
 		{
 			//already in mHeaderIDMap.
-			mTexturesSizeMap[entry.mID] = new_body_size;
 			mTexturesSizeTotal -= entry.mBodySize;
 			mTexturesSizeTotal += new_body_size;
 		}
 		entry.mTime = time(NULL);
-		entry.mImageSize = new_image_size; 
+		entry.mImageSize = new_image_size;
 		entry.mBodySize = new_body_size;
-		
+
 		writeEntryToHeaderImmediately(idx, entry, update_header);
-	
+
 		if (mTexturesSizeTotal > sCacheMaxTexturesSize)
 		{
 			purge = true;
 		}
-		
+
 		unlockHeaders();
 
 		if (purge)
@@ -1245,124 +1235,69 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 	return false;
 }
 
-U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
+// Rebuilds the index from the mapped entries; entries points into the mapping.
+U32 LLTextureCache::openAndReadEntries(Entry*& entries)
 {
 	U32 num_entries = mHeaderEntriesInfo.mEntries;
 
 	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
 	mFreeList.clear();
 	mTexturesSizeTotal = 0;
 
-	LLAPRFile* aprfile = NULL; 
-	if(mUpdatedEntryMap.empty())
+	if (!openHeaderEntriesFile() || num_entries > mHeaderEntriesCapacity)
 	{
-		aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
-	}
-	else //update the header file first.
-	{
-		aprfile = openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile();
-		if(!aprfile)
-		{
-			return 0;
-		}
-		aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
+		LL_WARNS() << "Corrupted header entries, " << num_entries << " entries in a file with room for " << mHeaderEntriesCapacity << LL_ENDL;
+		purgeAllTextures(false);
+		return 0;
 	}
+	entries = getMappedEntries();
+
+	mHeaderIDMap.reserve(num_entries);
 	for (U32 idx=0; idx<num_entries; idx++)
 	{
-		Entry entry;
-		S32 bytes_read = aprfile->read((void*)(&entry), (S32)sizeof(Entry));
-		if (bytes_read < sizeof(Entry))
-		{
-			LL_WARNS() << "Corrupted header entries, failed at " << idx << " / " << num_entries << LL_ENDL;
-			closeHeaderEntriesFile();
-			purgeAllTextures(false);
-			return 0;
-		}
-		entries.push_back(entry);
+		const Entry& entry = entries[idx];
 // 		LL_INFOS() << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << LL_ENDL;
 		if(entry.mImageSize > entry.mBodySize)
 		{
 			mHeaderIDMap[entry.mID] = idx;
-				mTexturesSizeMap[entry.mID] = entry.mBodySize;
-				mTexturesSizeTotal += entry.mBodySize;
-			}
+			mTexturesSizeTotal += entry.mBodySize;
+		}
 		else
 		{
 			mFreeList.insert(idx);
 		}
 	}
-	closeHeaderEntriesFile();
 	return num_entries;
 }
 
-void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
+// Replaces the whole entries table, used when it is compacted.
+void LLTextureCache::writeEntries(const std::vector<Entry>& entries)
 {
 	S32 num_entries = entries.size();
 	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
-	
+
 	if (!mReadOnly)
 	{
-		LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-		U64 write_size = U64(sizeof(Entry)) * num_entries;
-		U64 bytes_written = aprfile->write((void*)(entries.data()), write_size);
-		if (bytes_written != write_size)
+		if ((U32)num_entries > mHeaderEntriesCapacity)
 		{
 			clearCorruptedCache(); //clear the cache.
 			return;
 		}
-		closeHeaderEntriesFile();
-	}
-}
-
-void LLTextureCache::writeUpdatedEntries()
-{
-	lockHeaders();
-	if (!mReadOnly && !mUpdatedEntryMap.empty())
-	{
-		openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile();
-		closeHeaderEntriesFile();
+		if (num_entries)
+		{
+			memcpy(getMappedEntries(), entries.data(), sizeof(Entry) * num_entries);
+		}
+		writeEntriesHeader();
 	}
-	unlockHeaders();
 }
 
-//mHeaderMutex is locked and mHeaderAPRFile is created before calling this.
-void LLTextureCache::updatedHeaderEntriesFile()
+// Entries are stored straight into the mapping; this only hurries the
+// system into writing them out.
+void LLTextureCache::flushHeaderEntries()
 {
-	if (!mReadOnly && !mUpdatedEntryMap.empty() && mHeaderAPRFile)
+	if (!mReadOnly)
 	{
-		//entriesInfo
-		mHeaderAPRFile->seek(APR_SET, 0);
-		S32 bytes_written = mHeaderAPRFile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache(); //clear the cache.
-			return;
-		}
-		
-		//write each updated entry
-		S32 entry_size = (S32)sizeof(Entry);
-		S32 prev_idx = -1;
-		S32 delta_idx;
-		for (idx_entry_map_t::iterator iter = mUpdatedEntryMap.begin(); iter != mUpdatedEntryMap.end(); ++iter)
-		{
-			delta_idx = iter->first - prev_idx - 1;
-			prev_idx = iter->first;
-			if(delta_idx)
-			{
-				mHeaderAPRFile->seek(APR_CUR, delta_idx * entry_size);
-			}
-			
-			bytes_written = mHeaderAPRFile->write((void*)(&iter->second), entry_size);
-			if(bytes_written != entry_size)
-			{
-				clearCorruptedCache(); //clear the cache.
-				return;
-			}
-		}
-		mUpdatedEntryMap.clear();
+		mHeaderEntriesMap.flush();
 	}
 }
 //----------------------------------------------------------------------------
@@ -1381,17 +1316,19 @@ void LLTextureCache::readHeaderCache()
 		if (!mReadOnly)
 		{
 			purgeAllTextures(false);
+			openHeaderEntriesFile();
 		}
 	}
 	else
 	{
-		std::vector<Entry> entries;
+		Entry* entries = NULL;
 		U32 num_entries = openAndReadEntries(entries);
 		if (num_entries)
 		{
 			U32 empty_entries = 0;
 			typedef std::pair<U32, S32> lru_data_t;
-			std::set<lru_data_t> lru;
+			std::vector<lru_data_t> lru;
+			lru.reserve(num_entries);
 			std::set<U32> purge_list;
 			for (U32 i=0; i<num_entries; i++)
 			{
@@ -1403,7 +1340,7 @@ void LLTextureCache::readHeaderCache()
 				}
 				else
 				{
-					lru.insert(std::make_pair(entry.mTime, i));
+					lru.push_back(std::make_pair(entry.mTime, i));
 					if (entry.mBodySize > 0)
 					{
 						if (entry.mBodySize > entry.mImageSize)
@@ -1424,7 +1361,8 @@ void LLTextureCache::readHeaderCache()
 				// We can exit the following loop with the given condition, since if we'd reach the end of the lru set we'd have:
 				// purge_list.size() = lru.size() = num_entries - empty_entries = entries_to_purge + sCacheMaxEntries >= entries_to_purge
 				// So, it's certain that iter will never reach lru.end() first.
-				std::set<lru_data_t>::iterator iter = lru.begin();
+				std::sort(lru.begin(), lru.end());
+				std::vector<lru_data_t>::iterator iter = lru.begin();
 				while (purge_list.size() < entries_to_purge)
 				{
 					purge_list.insert(iter->second);
@@ -1433,13 +1371,14 @@ void LLTextureCache::readHeaderCache()
 			}
 			else
 			{
-				S32 lru_entries = (S32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE);
-				for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
+				// Only the oldest entries are wanted, in no particular order;
+				// no need to sort the whole table.
+				size_t lru_entries = llmin((size_t)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE), lru.size());
+				std::nth_element(lru.begin(), lru.begin() + lru_entries, lru.end());
+				for (size_t i = 0; i < lru_entries; ++i)
 				{
-					mLRU.insert(entries[iter->second].mID);
-// 					LL_INFOS() << "LRU: " << iter->first << " : " << iter->second << LL_ENDL;
-					if (--lru_entries <= 0)
-						break;
+					mLRU.insert(entries[lru[i].second].mID);
+// 					LL_INFOS() << "LRU: " << lru[i].first << " : " << lru[i].second << LL_ENDL;
 				}
 			}
 			
@@ -1463,8 +1402,7 @@ void LLTextureCache::readHeaderCache()
 				}
 				llassert_always(new_entries.size() <= sCacheMaxEntries);
 				mHeaderEntriesInfo.mEntries = new_entries.size();
-				writeEntriesHeader();
-				writeEntriesAndClose(new_entries);
+				writeEntries(new_entries);
 				mHeaderMutex.unlock(); // unlock the mutex before calling again
 				readHeaderCache(); // repeat with new entries file
 				mHeaderMutex.lock();
@@ -1485,7 +1423,7 @@ void LLTextureCache::clearCorruptedCache()
 {
 	LL_WARNS() << "the texture cache is corrupted, need to be cleared." << LL_ENDL;
 
-	closeHeaderEntriesFile();//close possible file handler
+	// The entries file stays mapped: time stamps are stored into it without the lock.
 	purgeAllTextures(false); //clear the cache.
 	
 	if (!mReadOnly) //regenerate the directory tree if not exists.
@@ -1527,11 +1465,8 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 		}
 	}
 	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
 	mTexturesSizeTotal = 0;
 	mFreeList.clear();
-	mTexturesSizeTotal = 0;
-	mUpdatedEntryMap.clear();
 
 	// Info with 0 entries
 	mHeaderEntriesInfo.mVersion = sHeaderCacheVersion;
@@ -1575,33 +1510,24 @@ void LLTextureCache::purgeTextures(bool validate)
 	std::queue<LLUUID> empty;
 	std::swap(sgDelayedPurgeQueue, empty);
 
-	// Read the entries list
-	std::vector<Entry> entries;
-	U32 num_entries = openAndReadEntries(entries);
-	if (!num_entries)
+	// The entries are used in place; the index is up to date already.
+	U32 num_entries = mHeaderEntriesInfo.mEntries;
+	if (!num_entries || num_entries > mHeaderEntriesCapacity)
 	{
 		return; // nothing to purge
 	}
+	Entry* entries = getMappedEntries();
 	
-	// Use mTexturesSizeMap to collect UUIDs of textures with bodies
+	// Collect the live entries of textures with bodies
 	typedef std::vector<std::pair<U32,S32> > time_idx_set_t;
 	time_idx_set_t time_idx_set;
-	for (size_map_t::iterator iter1 = mTexturesSizeMap.begin();
-		 iter1 != mTexturesSizeMap.end(); ++iter1)
+	for (U32 idx = 0; idx < num_entries; ++idx)
 	{
-		if (iter1->second > 0)
+		const Entry& entry = entries[idx];
+		if (entry.mBodySize > 0 && entry.mImageSize > entry.mBodySize)
 		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
-			{
-				S32 idx = iter2->second;
-				time_idx_set.push_back(std::make_pair(entries[idx].mTime, idx));
-// 				LL_INFOS() << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << LL_ENDL;
-			}
-			else
-			{
-				LL_ERRS() << "mTexturesSizeMap / mHeaderIDMap corrupted." << LL_ENDL ;
-			}
+			time_idx_set.push_back(std::make_pair(entry.mTime, (S32)idx));
+// 			LL_INFOS() << "TIME: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << LL_ENDL;
 		}
 	}
 
@@ -1667,9 +1593,9 @@ void LLTextureCache::purgeTextures(bool validate)
 		}
 	}
 
-	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Writing Entries: " << num_entries << LL_ENDL;
+	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Flushing Entries: " << num_entries << LL_ENDL;
 
-	writeEntriesAndClose(entries);
+	flushHeaderEntries();
 	
 	// *FIX:Mani - watchdog back on.
 	LLAppViewer::instance()->resumeMainloopTimeout();
@@ -1712,11 +1638,12 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 // Reads imagesize from the header, updates timestamp
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 {
-	LLMutexLock lock(&mHeaderMutex);
+	mHeaderMutex.lock();
 	S32 idx = openAndReadEntry(id, entry, false);
+	mHeaderMutex.unlock();
 	if (idx >= 0)
 	{
-		updateEntryTimeStamp(idx, entry); // updates time
+		updateEntryTimeStamp(idx, entry); // updates time, lock free
 	}
 	return idx;
 }
@@ -1874,12 +1801,15 @@ void LLTextureCache::addCompleted(Responder* responder, bool success)
 //called after mHeaderMutex is locked.
 void LLTextureCache::removeCachedTexture(const LLUUID& id)
 {
-	if (mTexturesSizeMap.find(id) != mTexturesSizeMap.end())
+	id_map_t::iterator iter = mHeaderIDMap.find(id);
+	if (iter != mHeaderIDMap.end())
 	{
-		mTexturesSizeTotal -= mTexturesSizeMap[id];
-		mTexturesSizeMap.erase(id);
+		if ((U32)iter->second < mHeaderEntriesCapacity)
+		{
+			mTexturesSizeTotal -= getMappedEntries()[iter->second].mBodySize;
+		}
+		mHeaderIDMap.erase(iter);
 	}
-	mHeaderIDMap.erase(id);
 	LLAPRFile::remove(getTextureFileName(id));		
 }
 
@@ -1906,7 +1836,6 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 		entry.mImageSize = -1;
 		entry.mBodySize = 0;
 		mHeaderIDMap.erase(entry.mID);
-		mTexturesSizeMap.erase(entry.mID);		
 		mFreeList.insert(idx);	
 	}
 
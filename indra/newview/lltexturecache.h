@@ -28,12 +28,15 @@
 #define LL_LLTEXTURECACHE_H
 
 #include "lldir.h"
+#include "llmappedfile.h"
 #include "llstl.h"
 #include "llstring.h"
 #include "lluuid.h"
 
 #include "llworkerthread.h"
 
+#include "absl/container/flat_hash_map.h"
+
 class LLImageFormatted;
 class LLTextureCacheWorker;
 
@@ -149,23 +152,23 @@ private:
 	void performDelayedPurge();
 	void purgeAllTextures(bool purge_directories);
 	void purgeTextures(bool validate);
-	LLAPRFile* openHeaderEntriesFile(bool readonly, S32 offset);
+	bool openHeaderEntriesFile();
 	void closeHeaderEntriesFile();
+	Entry* getMappedEntries() const { return (Entry*)(mHeaderEntriesMap.getData() + sizeof(EntriesInfo)); }
 	void readEntriesHeader();
 	void writeEntriesHeader();
 	S32 openAndReadEntry(const LLUUID& id, Entry& entry, bool create);
 	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_body_size);
 	void updateEntryTimeStamp(S32 idx, Entry& entry) ;
-	U32 openAndReadEntries(std::vector<Entry>& entries);
-	void writeEntriesAndClose(const std::vector<Entry>& entries);
+	U32 openAndReadEntries(Entry*& entries);
+	void writeEntries(const std::vector<Entry>& entries);
 	void readEntryFromHeaderImmediately(S32& idx, Entry& entry) ;
 	void writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header = false) ;
 	void removeEntry(S32 idx, Entry& entry, std::string& filename);
 	void removeCachedTexture(const LLUUID& id) ;
 	S32 getHeaderCacheEntry(const LLUUID& id, Entry& entry);
 	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
-	void writeUpdatedEntries() ;
-	void updatedHeaderEntriesFile() ;
+	void flushHeaderEntries();
 	void lockHeaders() { mHeaderMutex.lock(); }
 	void unlockHeaders() { mHeaderMutex.unlock(); }
 	
@@ -174,7 +177,6 @@ private:
 	LLMutex mWorkersMutex;
 	LLMutex mHeaderMutex;
 	LLMutex mListMutex;
-	LLAPRFile* mHeaderAPRFile;
 	
 	typedef std::map<handle_t, LLTextureCacheWorker*> handle_map_t;
 	handle_map_t mReaders;
@@ -192,21 +194,21 @@ private:
 	std::string mHeaderEntriesFileName;
 	std::string mHeaderDataFileName;
 	EntriesInfo mHeaderEntriesInfo;
+	// The entries file, mapped once with room for every entry it may ever
+	// hold; entries are read and written in place and stay mapped until the
+	// cache is destroyed, so time stamps can be stored without the mutex.
+	LLMappedFile mHeaderEntriesMap;
+	U32 mHeaderEntriesCapacity;
 	std::set<S32> mFreeList; // deleted entries
 	uuid_set_t mLRU;
-	typedef std::map<LLUUID,S32> id_map_t;
+	typedef absl::flat_hash_map<LLUUID,S32> id_map_t;
 	id_map_t mHeaderIDMap;
 
-	// BODIES (TEXTURES minus headers)
+	// BODIES (TEXTURES minus headers); body sizes are in the mapped entries.
 	std::string mTexturesDirName;
-	typedef std::map<LLUUID,S32> size_map_t;
-	size_map_t mTexturesSizeMap;
 	S64 mTexturesSizeTotal;
 	LLAtomic32<bool> mDoPurge;
 
-	typedef std::map<S32, Entry> idx_entry_map_t;
-	idx_entry_map_t mUpdatedEntryMap;
-
 	// Statics
 	static F32 sHeaderCacheVersion;
 	static U32 sCacheMaxEntries;
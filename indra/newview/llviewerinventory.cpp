@@ -495,10 +495,10 @@ BOOL LLViewerInventoryItem::importLegacyStream(std::istream& input_stream)
 	return rv;
 }
 
-bool LLViewerInventoryItem::importFileLocal(LLFILE* fp)
+bool LLViewerInventoryItem::importLocal(std::istream& input_stream)
 {
 	// TODO: convert all functions that return BOOL to return bool
-	bool rv = (LLInventoryItem::importFile(fp) ? true : false);
+	bool rv = (LLInventoryItem::importLegacyStream(input_stream) ? true : false);
 	mIsComplete = false;
 	return rv;
 }
@@ -729,7 +729,7 @@ S32 LLViewerInventoryCategory::getViewerDescendentCount() const
 	return descendents_actual;
 }
 
-bool LLViewerInventoryCategory::importFileLocal(LLFILE* fp)
+bool LLViewerInventoryCategory::importLocal(std::istream& input_stream)
 {
 	// *NOTE: This buffer size is hard coded into scanf() below.
 	char buffer[MAX_STRING];		/* Flawfinder: ignore */
@@ -738,12 +738,9 @@ bool LLViewerInventoryCategory::importFileLocal(LLFILE* fp)
 
 	keyword[0] = '\0';
 	valuestr[0] = '\0';
-	while(!feof(fp))
+	while(input_stream.good())
 	{
-		if (fgets(buffer, MAX_STRING, fp) == NULL)
-		{
-			buffer[0] = '\0';
-		}
+		input_stream.getline(buffer, MAX_STRING);
 		
 		sscanf(	/* Flawfinder: ignore */
 			buffer, " %254s %254s", keyword, valuestr); 
@@ -798,21 +795,21 @@ bool LLViewerInventoryCategory::importFileLocal(LLFILE* fp)
 	return true;
 }
 
-bool LLViewerInventoryCategory::exportFileLocal(LLFILE* fp) const
+bool LLViewerInventoryCategory::exportLocal(std::ostream& output_stream) const
 {
 	std::string uuid_str;
-	fprintf(fp, "\tinv_category\t0\n\t{\n");
+	output_stream << "\tinv_category\t0\n\t{\n";
 	mUUID.toString(uuid_str);
-	fprintf(fp, "\t\tcat_id\t%s\n", uuid_str.c_str());
+	output_stream << "\t\tcat_id\t" << uuid_str << "\n";
 	mParentUUID.toString(uuid_str);
-	fprintf(fp, "\t\tparent_id\t%s\n", uuid_str.c_str());
-	fprintf(fp, "\t\ttype\t%s\n", LLAssetType::lookup(mType));
-	fprintf(fp, "\t\tpref_type\t%s\n", LLFolderType::lookup(mPreferredType).c_str());
-	fprintf(fp, "\t\tname\t%s|\n", mName.c_str());
+	output_stream << "\t\tparent_id\t" << uuid_str << "\n";
+	output_stream << "\t\ttype\t" << LLAssetType::lookup(mType) << "\n";
+	output_stream << "\t\tpref_type\t" << LLFolderType::lookup(mPreferredType) << "\n";
+	output_stream << "\t\tname\t" << mName << "|\n";
 	mOwnerID.toString(uuid_str);
-	fprintf(fp, "\t\towner_id\t%s\n", uuid_str.c_str());
-	fprintf(fp, "\t\tversion\t%d\n", mVersion);
-	fprintf(fp,"\t}\n");
+	output_stream << "\t\towner_id\t" << uuid_str << "\n";
+	output_stream << "\t\tversion\t" << mVersion << "\n";
+	output_stream << "\t}\n";
 	return true;
 }
 
@@ -134,7 +134,7 @@ public:
 	// file handling on the viewer. These are not meant for anything
 	// other than cacheing.
 	bool exportFileLocal(LLFILE* fp) const;
-	bool importFileLocal(LLFILE* fp);
+	bool importLocal(std::istream& input_stream);
 
 	// new methods
 	BOOL isComplete() const { return mIsComplete; }
@@ -231,8 +231,8 @@ public:
 
 	// file handling on the viewer. These are not meant for anything
 	// other than caching.
-	bool exportFileLocal(LLFILE* fp) const;
-	bool importFileLocal(LLFILE* fp);
+	bool exportLocal(std::ostream& output_stream) const;
+	bool importLocal(std::istream& input_stream);
 	void determineFolderType();
 	void changeType(LLFolderType::EType new_folder_type);
     void unpackMessage(LLMessageSystem* msg, const char* block, S32 block_num = 0) override;
@@ -802,6 +802,8 @@ void LLViewerMedia::updateMedia(void *dummy_arg)
 	// Enable/disable the plugin read thread
 	static LLCachedControl<bool> pluginUseReadThread(gSavedSettings, "PluginUseReadThread");
 	LLPluginProcessParent::setUseReadThread(pluginUseReadThread);
+	static LLCachedControl<bool> pluginBinaryMessages(gSavedSettings, "PluginBinaryMessages");
+	LLPluginProcessParent::setUseBinaryMessages(pluginBinaryMessages);
 	
 	// HACK: we always try to keep a spare running webkit plugin around to improve launch times.
 	createSpareBrowserMediaSource();
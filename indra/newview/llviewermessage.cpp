@@ -3713,13 +3713,8 @@ void process_compressed_object_update(LLMessageSystem* mesgsys, void** user_data
 		gObjectData += U32Bytes(mesgsys->getReceiveSize());
 	}
 
-	// Update the object...
-	S32 old_num_objects = gObjectList.mNumNewObjects;
+	// Update the object... Postponed sounds are attached when it is applied.
 	gObjectList.processCompressedObjectUpdate(mesgsys, user_data, OUT_FULL_COMPRESSED);
-	if (old_num_objects != gObjectList.mNumNewObjects)
-	{
-		update_attached_sounds();
-	}
 }
 
 void process_cached_object_update(LLMessageSystem* mesgsys, void** user_data)
@@ -3750,12 +3745,7 @@ void process_terse_object_update_improved(LLMessageSystem* mesgsys, void** user_
 		gObjectData += U32Bytes(mesgsys->getReceiveSize());
 	}
 
-	S32 old_num_objects = gObjectList.mNumNewObjects;
 	gObjectList.processCompressedObjectUpdate(mesgsys, user_data, OUT_TERSE_IMPROVED);
-	if (old_num_objects != gObjectList.mNumNewObjects)
-	{
-		update_attached_sounds();
-	}
 }
 
 static LLTrace::BlockTimerStatHandle FTM_PROCESS_OBJECTS("Process Kill Objects");
@@ -94,6 +94,8 @@ void process_object_update(LLMessageSystem *mesgsys, void **user_data);
 void process_compressed_object_update(LLMessageSystem *mesgsys, void **user_data);
 void process_cached_object_update(LLMessageSystem *mesgsys, void **user_data);
 void process_terse_object_update_improved(LLMessageSystem *mesgsys, void **user_data);
+// Attaches the sounds that were waiting for objects just created.
+void update_attached_sounds();
 
 void send_simulator_throttle_settings(const LLHost &host);
 void process_kill_object(	LLMessageSystem *mesgsys, void **user_data);
@@ -66,6 +66,7 @@
 #include "llfloatertools.h"
 #include "llfollowcam.h"
 #include "llhudtext.h"
+#include "llobjectupdatedecoder.h"
 #include "llselectmgr.h"
 #include "llrendersphere.h"
 #include "lltooldraganddrop.h"
@@ -272,6 +273,7 @@ LLViewerObject::LLViewerObject(const LLUUID &id, const LLPCode pcode, LLViewerRe
 	mUserSelected(FALSE),
 	mOnActiveList(FALSE),
 	mOnMap(FALSE),
+	mMapListIndex(-1),
 	mStatic(FALSE),
 	mNumFaces(0),
 	mRotTime(0.f),
@@ -1141,7 +1143,7 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					 void **user_data,
 					 U32 block_num,
 					 const EObjectUpdateType update_type,
-					 LLDataPacker *dp)
+					 const LLDecodedObjectUpdate* update)
 {
 	U32 retval = 0x0;
 
@@ -1152,12 +1154,26 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 		return retval;
 	}
 
+	// Where the update came from: the message being handled, or the one a
+	// decoded update was copied out of.
+	LLObjectUpdateSource message_source;
+	const LLObjectUpdateSource* source = NULL;
+	if (update)
+	{
+		source = &update->getSource();
+	}
+	else if (mesgsys != NULL)
+	{
+		message_source.set(mesgsys);
+		source = &message_source;
+	}
+
 	// Coordinates of objects on simulators are region-local.
 	U64 region_handle = 0;	
 	
-	if(mesgsys != NULL)
+	if (source)
 	{
-		mesgsys->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, region_handle);
+		region_handle = source->mRegionHandle;
 		LLViewerRegion* regionp = LLWorld::getInstance()->getRegionFromHandle(region_handle);
 		if(regionp != mRegionp && regionp && mRegionp)//region cross
 		{
@@ -1195,11 +1211,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 
 	F32 time_dilation = 1.f;
-	if(mesgsys != NULL)
+	if (source)
 	{
-		U16 time_dilation16;
-		mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, time_dilation16);
-		time_dilation = ((F32) time_dilation16) / 65535.f;
+		time_dilation = ((F32) source->mTimeDilation) / 65535.f;
 		mRegionp->setTimeDilation(time_dilation);
 	}
 
@@ -1230,7 +1244,7 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 
 
-	if (!dp)
+	if (!update)
 	{
 		switch(update_type)
 		{
@@ -1435,19 +1449,8 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 	else
 	{
-		// handle the compressed case
-		LLUUID sound_uuid;
-		LLUUID	owner_id;
-		F32    gain = 0;
-		U8     sound_flags = 0;
-		F32		cutoff = 0;
-
-		U16 val[4];
-
-		U8		state;
-
-		dp->unpackU8(state, "State");
-		mAttachmentState = state;
+		// handle the compressed case, unpacked by LLDecodedObjectUpdate
+		mAttachmentState = update->mState;
 
 		switch(update_type)
 		{
@@ -1456,43 +1459,16 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 #ifdef DEBUG_UPDATE_TYPE
 				LL_INFOS() << "CompTI:" << getID() << LL_ENDL;
 #endif
-				U8		value;
-				dp->unpackU8(value, "agent");
-				if (value)
+				if (update->mHasFootPlane)
 				{
-					LLVector4 collision_plane;
-					dp->unpackVector4(collision_plane, "Plane");
-					((LLVOAvatar*)this)->setFootPlane(collision_plane);
+					((LLVOAvatar*)this)->setFootPlane(update->mFootPlane);
 				}
 				test_pos_parent = getPosition();
-				dp->unpackVector3(new_pos_parent, "Pos");
-				dp->unpackU16(val[VX], "VelX");
-				dp->unpackU16(val[VY], "VelY");
-				dp->unpackU16(val[VZ], "VelZ");
-				setVelocity(U16_to_F32(val[VX], -128.f, 128.f),
-							U16_to_F32(val[VY], -128.f, 128.f),
-							U16_to_F32(val[VZ], -128.f, 128.f));
-				dp->unpackU16(val[VX], "AccX");
-				dp->unpackU16(val[VY], "AccY");
-				dp->unpackU16(val[VZ], "AccZ");
-				setAcceleration(U16_to_F32(val[VX], -64.f, 64.f),
-								U16_to_F32(val[VY], -64.f, 64.f),
-								U16_to_F32(val[VZ], -64.f, 64.f));
-
-				dp->unpackU16(val[VX], "ThetaX");
-				dp->unpackU16(val[VY], "ThetaY");
-				dp->unpackU16(val[VZ], "ThetaZ");
-				dp->unpackU16(val[VS], "ThetaS");
-				new_rot.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
-				new_rot.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
-				new_rot.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
-				new_rot.mQ[VS] = U16_to_F32(val[VS], -1.f, 1.f);
-				dp->unpackU16(val[VX], "AccX");
-				dp->unpackU16(val[VY], "AccY");
-				dp->unpackU16(val[VZ], "AccZ");
-				new_angv.set(U16_to_F32(val[VX], -64.f, 64.f),
-							 U16_to_F32(val[VY], -64.f, 64.f),
-							 U16_to_F32(val[VZ], -64.f, 64.f));
+				new_pos_parent = update->mPosition;
+				setVelocity(update->mVelocity);
+				setAcceleration(update->mAcceleration);
+				new_rot = update->mRotation;
+				new_angv = update->mAngularVelocity;
 				setAngularVelocity(new_angv);
 			}
 			break;
@@ -1509,9 +1485,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					gFloaterTools->dirty();
 				}
 
-				dp->unpackU32(crc, "CRC");
+				crc = update->mCRC;
 				mTotalCRC = crc;
-				dp->unpackU8(material, "Material");
+				material = update->mMaterial;
 				U8 old_material = getMaterial();
 				if (old_material != material)
 				{
@@ -1521,52 +1497,45 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 						gPipeline.markMoved(mDrawable, FALSE); // undamped
 					}
 				}
-				dp->unpackU8(click_action, "ClickAction");
+				click_action = update->mClickAction;
 				setClickAction(click_action);
-				dp->unpackVector3(new_scale, "Scale");
-				dp->unpackVector3(new_pos_parent, "Pos");
-				LLVector3 vec;
-				dp->unpackVector3(vec, "Rot");
-				new_rot.unpackFromVector3(vec);
+				new_scale = update->mScale;
+				new_pos_parent = update->mPosition;
+				new_rot = update->mRotation;
 				setAcceleration(LLVector3::zero);
 
-				U32 value;
-				dp->unpackU32(value, "SpecialCode");
-				dp->setPassFlags(value);
-				dp->unpackUUID(owner_id, "Owner");
+				const U32 value = update->mSpecialCode;
+				const LLUUID& owner_id = update->mOwnerID;
 
 				mOwnerID = owner_id;
 
 				if (value & 0x80)
 				{
-					dp->unpackVector3(new_angv, "Omega");
+					new_angv = update->mAngularVelocity;
 					setAngularVelocity(new_angv);
 				}
 
 				if (value & 0x20)
 				{
-					dp->unpackU32(parent_id, "ParentID");
+					parent_id = update->mParentID;
 				}
 				else
 				{
 					parent_id = 0;
 				}
 
-				S32 sp_size;
-				U32 size;
 				if (value & 0x2)
 				{
-					sp_size = 1;
 					delete [] mData;
 					mData = new U8[1];
-					dp->unpackU8(((U8*)mData)[0], "TreeData");
+					((U8*)mData)[0] = update->mTreeData;
 				}
 				else if (value & 0x1)
 				{
-					dp->unpackU32(size, "ScratchPadSize");
+					const U32 size = update->mScratchPadSize;
 					delete [] mData;
 					mData = new U8[size];
-					dp->unpackBinaryData((U8 *)mData, sp_size, "PartData");
+					memcpy(mData, &update->mData[update->mScratchPad.mOffset], llmin(size, (U32)update->mScratchPad.mSize));	/* Flawfinder: ignore */
 				}
 				else
 				{
@@ -1590,9 +1559,8 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 				if (value & 0x4)
 				{
 					//Cache for reset on debug infodisplay toggle.
-					dp->unpackString(mHudTextString, "Text");
-					LLColor4U coloru;
-					dp->unpackBinaryDataFixed(coloru.mV, 4, "Color");
+					mHudTextString = update->mText;
+					LLColor4U coloru = update->mTextColor;
 					coloru.mV[3] = 255 - coloru.mV[3];
 					mHudTextColor = LLColor4(coloru);	//Cache for reset on debug infodisplay toggle.
 					if(mText->getDoFade())	//Fade is disabled when this is being overridden by debug text.
@@ -1613,19 +1581,16 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					mText = NULL;
 				}
 
-				std::string media_url;
-				if (value & 0x200)
-				{
-					dp->unpackString(media_url, "MediaURL");
-				}
-				retval |= checkMediaURL(media_url);
+				retval |= checkMediaURL(update->mMediaURL);
 
 				//
 				// Unpack particle system data (legacy)
 				//
 				if (value & 0x8)
 				{
-					unpackParticleSource(*dp, owner_id, true);
+					LLDataPackerBinaryBuffer pdp;
+					update->getPacker(update->mLegacyParticles, pdp);
+					unpackParticleSource(pdp, owner_id, true);
 				}
 				else if (!(value & 0x400))
 				{
@@ -1639,18 +1604,11 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 				}
 
 				// Unpack extra params
-				U8 num_parameters;
-				dp->unpackU8(num_parameters, "num_params");
-				U8 param_block[MAX_OBJECT_PARAMS_SIZE];
-				for (U8 param=0; param<num_parameters; ++param)
+				for (const LLDecodedObjectUpdate::ExtraParam& param : update->mExtraParams)
 				{
-					U16 param_type;
-					S32 param_size;
-					dp->unpackU16(param_type, "param_type");
-					dp->unpackBinaryData(param_block, param_size, "param_data");
-					//LL_INFOS() << "Param type: " << param_type << ", Size: " << param_size << LL_ENDL;
-					LLDataPackerBinaryBuffer dp2(param_block, param_size);
-					unpackParameterEntry(param_type, &dp2);
+					LLDataPackerBinaryBuffer dp2;
+					update->getPacker(param.mData, dp2);
+					unpackParameterEntry(param.mType, &dp2);
 				}
 
 				for (size_t i = 0; i < mExtraParameterList.size(); ++i)
@@ -1663,36 +1621,20 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					}
 				}
 
-				if (value & 0x10)
-				{
-					dp->unpackUUID(sound_uuid, "SoundUUID");
-					dp->unpackF32(gain, "SoundGain");
-					dp->unpackU8(sound_flags, "SoundFlags");
-					dp->unpackF32(cutoff, "SoundRadius");
-				}
-
 				if (value & 0x100)
 				{
-					std::string name_value_list;
-					dp->unpackString(name_value_list, "NV");
-
-					setNameValueList(name_value_list);
+					setNameValueList(update->mNameValues);
 				}
 
 				mTotalCRC = crc;
 
-				setAttachedSound(sound_uuid, owner_id, gain, sound_flags);
+				// Null when the update has no sound (no 0x10).
+				setAttachedSound(update->mSoundID, owner_id, update->mSoundGain, update->mSoundFlags);
 
-				// only get these flags on updates from sim, not cached ones
 				// Preload these five flags for every object.
 				// Finer shades require the object to be selected, and the selection manager
 				// stores the extended permission info.
-				if(mesgsys != NULL)
-				{
-					U32 flags;
-					mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, block_num);
-					loadFlags(flags);
-				}
+				loadFlags(update->mUpdateFlags);
 			}
 			break;
 
@@ -1720,12 +1662,12 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 				// No parent now, new parent in message -> attach to that parent if possible
 				LLUUID parent_uuid;
 
-				if(mesgsys != NULL)
+				if (source)
 				{
 					LLViewerObjectList::getUUIDFromLocal(parent_uuid,
 														parent_id,
-														mesgsys->getSenderIP(),
-														mesgsys->getSenderPort());
+														source->mSender.getAddress(),
+														source->mSender.getPort());
 				}
 				else
 				{
@@ -1851,10 +1793,10 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					//parent_id
 					U32 ip, port;
 
-					if(mesgsys != NULL)
+					if (source)
 					{
-						ip = mesgsys->getSenderIP();
-						port = mesgsys->getSenderPort();
+						ip = source->mSender.getAddress();
+						port = source->mSender.getPort();
 					}
 					else
 					{
@@ -1899,12 +1841,12 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 				{
 					LLUUID parent_uuid;
 
-					if(mesgsys != NULL)
+					if (source)
 					{
 						LLViewerObjectList::getUUIDFromLocal(parent_uuid,
 														parent_id,
-														gMessageSystem->getSenderIP(),
-														gMessageSystem->getSenderPort());
+														source->mSender.getAddress(),
+														source->mSender.getPort());
 					}
 					else
 					{
@@ -1935,10 +1877,10 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 						//
 						U32 ip, port;
 
-						if(mesgsys != NULL)
+						if (source)
 						{
-							ip = mesgsys->getSenderIP();
-							port = mesgsys->getSenderPort();
+							ip = source->mSender.getAddress();
+							port = source->mSender.getPort();
 						}
 						else
 						{
@@ -2028,9 +1970,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 
 	new_rot.normQuat();
 
-	if (sPingInterpolate && mesgsys != NULL)
+	if (sPingInterpolate && source)
 	{
-		LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit(mesgsys->getSender());
+		LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit(source->mSender);
 		if (cdp)
 		{
 			F32 ping_delay = 0.5f * time_dilation * ( ((F32)cdp->getPingDelay().valueInUnits<LLUnits::Seconds>()) + gFrameDTClamped);
@@ -2051,9 +1993,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 
 	// If we're going to skip this message, why are we
 	// doing all the parenting, etc above?
-	if(mesgsys != NULL)
+	if (source)
 	{
-		U32 packet_id = mesgsys->getCurrentRecvPacketID();
+		U32 packet_id = source->mPacketID;
 		if (packet_id < mLatestRecvPacketID &&
 			mLatestRecvPacketID - packet_id < 65536)
 		{
@@ -4372,6 +4314,7 @@ void LLViewerObject::setPosition(const LLVector3 &pos, BOOL damped)
 		// position caches need to be up to date on root objects
 		updatePositionCaches();
 	}
+	updateMapCells();
 }
 
 void LLViewerObject::setPositionGlobal(const LLVector3d &pos_global, BOOL damped)
@@ -5551,6 +5494,23 @@ BOOL LLViewerObject::isOnMap()
 	return mOnMap;
 }
 
+void LLViewerObject::updateMapCells()
+{
+	if (mOnMap)
+	{
+		gObjectList.updateMapCell(this);
+	}
+	// Children move with their parent; only linkset roots and avatars have any.
+	for (child_list_t::iterator i = mChildList.begin(); i != mChildList.end(); ++i)
+	{
+		LLViewerObject* child = *i;
+		if (child->mOnMap)
+		{
+			gObjectList.updateMapCell(child);
+		}
+	}
+}
+
 
 void LLViewerObject::updateText()
 {
@@ -6371,6 +6331,10 @@ void LLViewerObject::setRegion(LLViewerRegion *regionp)
 
 	mLatestRecvPacketID = 0;
 	mRegionp = regionp;
+	if (mOnMap)
+	{
+		gObjectList.updateMapCell(this);
+	}
 
 	for (child_list_t::iterator i = mChildList.begin(); i != mChildList.end(); ++i)
 	{
@@ -49,6 +49,7 @@
 #include "v3math.h"
 #include "llvertexbuffer.h"
 #include "llbbox.h"
+#include "llregiongrid.h"
 
 class LLAgent;			// TODO: Get rid of this.
 class LLAudioSource;
@@ -57,6 +58,7 @@ class LLBBox;
 class LLColor4;
 class LLControlAvatar;
 class LLDataPacker;
+class LLDecodedObjectUpdate;
 class LLDrawable;
 class LLFrameTimer;
 class LLHost;
@@ -185,11 +187,14 @@ public:
 	};
 
 	static  U32     extractSpatialExtents(LLDataPackerBinaryBuffer *dp, LLVector3& pos, LLVector3& scale, LLQuaternion& rot);
+	// Updates the object from block block_num of the message mesgsys is
+	// handling, or from update, unpacked out of a compressed, terse or
+	// cached update, when there is one.
 	virtual U32		processUpdateMessage(LLMessageSystem *mesgsys,
 										void **user_data,
 										U32 block_num,
 										const EObjectUpdateType update_type,
-										LLDataPacker *dp);
+										const LLDecodedObjectUpdate* update);
 
 	void processTerseData(LLMessageSystem *mesgsys, void **user_data, U32 block_num, S32& this_update_precision, LLVector3& new_pos_parent, LLQuaternion& new_rot, LLVector3& new_angv, LLVector3& test_pos_parent);
 
@@ -811,6 +816,9 @@ protected:
 	void doInventoryCallback();
 	
 	BOOL isOnMap();
+	// Moves this object, and its children that are on the map, to the cells
+	// of their positions in the map object grid of their region.
+	void updateMapCells();
 
 	void unpackParticleSource(const S32 block_num, const LLUUID& owner_id);
 	void unpackParticleSource(LLDataPacker &dp, const LLUUID& owner_id, bool legacy);
@@ -875,6 +883,8 @@ protected:
 	BOOL			mUserSelected;				// Cached user select information
 	BOOL			mOnActiveList;
 	BOOL			mOnMap;						// On the map.
+	S32				mMapListIndex;				// Index in gObjectList's map objects, -1 when not there.
+	LLRegionGrid<LLViewerObject>::Slot mMapSlot;	// Where in the map object grid of its region.
 	BOOL			mStatic;					// Object doesn't move.
 	S32				mNumFaces;
 
@@ -959,6 +969,7 @@ inline void LLViewerObject::setRotation(const LLQuaternion& quat, BOOL damped)
 	LLPrimitive::setRotation(quat);
 	setChanged(ROTATED | SILHOUETTE);
 	updateDrawable(damped);
+	updateMapCells();
 }
 
 inline void LLViewerObject::setRotation(const F32 x, const F32 y, const F32 z, BOOL damped)
@@ -966,6 +977,7 @@ inline void LLViewerObject::setRotation(const F32 x, const F32 y, const F32 z, B
 	LLPrimitive::setRotation(x, y, z);
 	setChanged(ROTATED | SILHOUETTE);
 	updateDrawable(damped);
+	updateMapCells();
 }
 
 class LLViewerObjectMedia
@@ -75,6 +75,7 @@
 #include "u64.h"
 #include "llviewertexturelist.h"
 #include "lldatapacker.h"
+#include "llobjectupdatedecoder.h"
 #ifdef LL_STANDALONE
 #include <zlib.h>
 #else
@@ -259,13 +260,14 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 										   void** user_data, 
 										   U32 i, 
 										   const EObjectUpdateType update_type, 
-										   LLDataPacker* dpp, 
+										   const LLDecodedObjectUpdate* update, 
 										   BOOL just_created)
 {
-	LLMessageSystem* msg = gMessageSystem;
+	// A decoded update no longer has its message at hand.
+	LLMessageSystem* msg = update ? NULL : gMessageSystem;
 
 	// ignore returned flags
-	objectp->processUpdateMessage(msg, user_data, i, update_type, dpp);
+	objectp->processUpdateMessage(msg, user_data, i, update_type, update);
 		
 	if (objectp->isDead())
 	{
@@ -295,6 +297,11 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 	{
 		findOrphans(objectp, msg->getSenderIP(), msg->getSenderPort());
 	}
+	else if (update && update->mSource)
+	{
+		const LLHost& sender = update->getSource().mSender;
+		findOrphans(objectp, sender.getAddress(), sender.getPort());
+	}
 	else
 	{
 		LLViewerRegion* regionp = objectp->getRegion();
@@ -335,12 +342,109 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 	}
 }
 
+LLViewerObject* LLViewerObjectList::findObjectForUpdate(const LLUUID& fullid,
+														const U32 local_id,
+														const LLPCode pcode,
+														LLViewerRegion* regionp,
+														const LLHost& sender,
+														const EObjectUpdateType update_type,
+														bool create, bool cached,
+														S32 msg_size, BOOL& just_created)
+{
+	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
+	just_created = FALSE;
+
+	LLViewerObject* objectp = findObject(fullid);
+
+	// This looks like it will break if the local_id of the object doesn't change
+	// upon boundary crossing, but we check for region id matching later...
+	// Reset object local id and region pointer if things have changed
+	if (objectp && 
+		((objectp->mLocalID != local_id) ||
+		 (objectp->getRegion() != regionp)))
+	{
+		//if (objectp->getRegion())
+		//{
+		//	LL_INFOS() << "Local ID change: Removing object from table, local ID " << objectp->mLocalID 
+		//			<< ", id from message " << local_id << ", from " 
+		//			<< LLHost(objectp->getRegion()->getHost().getAddress(), objectp->getRegion()->getHost().getPort())
+		//			<< ", full id " << fullid 
+		//			<< ", objects id " << objectp->getID()
+		//			<< ", regionp " << (U32) regionp << ", object region " << (U32) objectp->getRegion()
+		//			<< LL_ENDL;
+		//}
+		removeFromLocalIDTable(objectp);
+		setUUIDAndLocal(fullid,
+						local_id,
+						sender.getAddress(),
+						sender.getPort());
+		
+		if (objectp->mLocalID != local_id)
+		{    // Update local ID in object with the one sent from the region
+			objectp->mLocalID = local_id;
+		}
+		
+		if (objectp->getRegion() != regionp)
+		{    // Object changed region, so update it
+			objectp->updateRegion(regionp); // for LLVOAvatar
+		}
+	}
+
+	if (!objectp)
+	{
+		if (!create)
+		{
+			//LL_INFOS() << "terse update for an unknown object:" << fullid << LL_ENDL;
+			recorder.objectUpdateFailure(local_id, update_type, msg_size);
+			return NULL;
+		}
+#ifdef IGNORE_DEAD
+		if (mDeadObjects.find(fullid) != mDeadObjects.end())
+		{
+			mNumDeadObjectUpdates++;
+			//LL_INFOS() << "update for a dead object:" << fullid << LL_ENDL;
+			recorder.objectUpdateFailure(local_id, update_type, msg_size);
+			return NULL;
+		}
+#endif
+
+
+		if(std::find(LLFloaterBlacklist::blacklist_objects.begin(),
+			LLFloaterBlacklist::blacklist_objects.end(),fullid) != LLFloaterBlacklist::blacklist_objects.end())
+		{
+			//LL_INFOS() << "Blacklisted object asset " << fullid.asString() << " blocked." << LL_ENDL; 
+			return NULL;
+		}
+
+
+		objectp = createObject(pcode, regionp, fullid, local_id, sender);
+		if (!objectp)
+		{
+			LL_INFOS() << "createObject failure for object: " << fullid << LL_ENDL;
+			recorder.objectUpdateFailure(local_id, update_type, msg_size);
+			return NULL;
+		}
+		just_created = TRUE;
+		mNumNewObjects++;
+		sCacheHitRate.addValue(cached ? 100.f : 0.f);
+
+	}
+
+
+	if (objectp->isDead())
+	{
+		LL_WARNS() << "Dead object " << objectp->mID << " in UUID map 1!" << LL_ENDL;
+	}
+
+	return objectp;
+}
+
 static LLTrace::BlockTimerStatHandle FTM_PROCESS_OBJECTS("Process Objects");
 
 void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 											 void **user_data,
 											 const EObjectUpdateType update_type,
-											 bool cached, bool compressed)
+											 bool cached)
 {
 	LL_RECORD_BLOCK_TIME(FTM_PROCESS_OBJECTS);	
 	
@@ -358,9 +462,9 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 	num_objects = mesgsys->getNumberOfBlocksFast(_PREHASH_ObjectData);
 
 	// I don't think this case is ever hit.  TODO* Test this.
-	if (!cached && !compressed && update_type != OUT_FULL)
+	if (!cached && update_type != OUT_FULL)
 	{
-		//LL_INFOS() << "TEST: !cached && !compressed && update_type != OUT_FULL" << LL_ENDL;
+		//LL_INFOS() << "TEST: !cached && update_type != OUT_FULL" << LL_ENDL;
 		gTerseObjectUpdates += num_objects;
 		/*
 		S32 size;
@@ -403,9 +507,13 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		return;
 	}
 
-	U8 compressed_dpbuffer[2048];
-	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
-	LLDataPacker *cached_dpp = NULL;
+	// Cache hits are unpacked the way compressed updates are, here on the
+	// main thread.
+	LLObjectUpdateSource cached_source;
+	if (cached)
+	{
+		cached_source.set(mesgsys);
+	}
 	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
 	
 	for (i = 0; i < num_objects; i++)
@@ -414,6 +522,8 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		LLTimer update_timer;
 		BOOL justCreated = FALSE;
 		S32	msg_size = 0;
+		bool create = true;
+		LLDecodedObjectUpdate cached_update;
 
 		if (cached)
 		{
@@ -425,14 +535,17 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		
 			// Lookup data packer and add this id to cache miss lists if necessary.
 			U8 cache_miss_type = LLViewerRegion::CACHE_MISS_TYPE_NONE;
-			cached_dpp = regionp->getDP(id, crc, cache_miss_type);
+			LLDataPackerBinaryBuffer* cached_dpp = regionp->getDP(id, crc, cache_miss_type);
 			if (cached_dpp)
 			{
 				// Cache Hit.
-				cached_dpp->reset();
-				cached_dpp->unpackUUID(fullid, "ID");
-				cached_dpp->unpackU32(local_id, "LocalID");
-				cached_dpp->unpackU8(pcode, "PCode");
+				cached_update.mSource = &cached_source;
+				cached_update.setData(cached_dpp->getBuffer(), cached_dpp->getBufferSize());
+				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, cached_update.mUpdateFlags, i);
+				cached_update.unpack(update_type);
+				fullid = cached_update.mFullID;
+				local_id = cached_update.mLocalID;
+				pcode = cached_update.mPCode;
 			}
 			else
 			{
@@ -442,38 +555,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 				continue; // no data packer, skip this object
 			}
 		}
-		else if (compressed)
-		{
-			S32							uncompressed_length = 2048;
-			compressed_dp.reset();
-			
-			uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-			mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compressed_dpbuffer, 0, i, 2048);
-			compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
-
-			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
-			{
-				U32 flags = 0;
-				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
-				compressed_dp.unpackUUID(fullid, "ID");
-				compressed_dp.unpackU32(local_id, "LocalID");
-				compressed_dp.unpackU8(pcode, "PCode");
-			}
-			else //OUT_TERSE_IMPROVED
-			{
-				compressed_dp.unpackU32(local_id, "LocalID");
-				getUUIDFromLocal(fullid,
-								 local_id,
-								 gMessageSystem->getSenderIP(),
-								 gMessageSystem->getSenderPort());
-				if (fullid.isNull())
-				{
-					LL_DEBUGS() << "update for unknown localid " << local_id << " host " << gMessageSystem->getSender() << ":" << gMessageSystem->getSenderPort() << LL_ENDL;
-					mNumUnknownUpdates++;
-				}
-			}
-		}
-		else if (update_type != OUT_FULL) // !compressed, !OUT_FULL ==> OUT_FULL_CACHED only?
+		else if (update_type != OUT_FULL) // !OUT_FULL ==> OUT_FULL_CACHED only?
 		{
 			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
 			msg_size += sizeof(U32);
@@ -487,143 +569,115 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 				// LL_WARNS() << "update for unknown localid " << local_id << " host " << gMessageSystem->getSender() << LL_ENDL;
 				mNumUnknownUpdates++;
 			}
+			create = false;
 		}
 		else // OUT_FULL only?
 		{
 			mesgsys->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, fullid, i);
 			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			mesgsys->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, pcode, i);
 			msg_size += sizeof(LLUUID);
 			msg_size += sizeof(U32);
+			msg_size += sizeof(U8);
 			// LL_INFOS() << "Full Update, obj " << local_id << ", global ID" << fullid << "from " << mesgsys->getSender() << LL_ENDL;
 		}
-		objectp = findObject(fullid);
-
-		// This looks like it will break if the local_id of the object doesn't change
-		// upon boundary crossing, but we check for region id matching later...
-		// Reset object local id and region pointer if things have changed
-		if (objectp && 
-			((objectp->mLocalID != local_id) ||
-			 (objectp->getRegion() != regionp)))
-		{
-			//if (objectp->getRegion())
-			//{
-			//	LL_INFOS() << "Local ID change: Removing object from table, local ID " << objectp->mLocalID 
-			//			<< ", id from message " << local_id << ", from " 
-			//			<< LLHost(objectp->getRegion()->getHost().getAddress(), objectp->getRegion()->getHost().getPort())
-			//			<< ", full id " << fullid 
-			//			<< ", objects id " << objectp->getID()
-			//			<< ", regionp " << (U32) regionp << ", object region " << (U32) objectp->getRegion()
-			//			<< LL_ENDL;
-			//}
-			removeFromLocalIDTable(objectp);
-			setUUIDAndLocal(fullid,
-							local_id,
-							gMessageSystem->getSenderIP(),
-							gMessageSystem->getSenderPort());
-			
-			if (objectp->mLocalID != local_id)
-			{    // Update local ID in object with the one sent from the region
-				objectp->mLocalID = local_id;
-			}
-			
-			if (objectp->getRegion() != regionp)
-			{    // Object changed region, so update it
-				objectp->updateRegion(regionp); // for LLVOAvatar
-			}
-		}
 
+		objectp = findObjectForUpdate(fullid, local_id, pcode, regionp, gMessageSystem->getSender(),
+									  update_type, create, cached, msg_size, justCreated);
 		if (!objectp)
 		{
-			if (compressed)
-			{
-				if (update_type == OUT_TERSE_IMPROVED)
-				{
-					// LL_INFOS() << "terse update for an unknown object (compressed):" << fullid << LL_ENDL;
-					recorder.objectUpdateFailure(local_id, update_type, msg_size);
-					continue;
-				}
-			}
-			else if (cached) // Cache hit only?
+			continue;
+		}
+
+		if (cached)
+		{
+			objectp->mLocalID = local_id;
+			processUpdateCore(objectp, user_data, i, update_type, &cached_update, justCreated);
+		}
+		else
+		{
+			if (update_type == OUT_FULL)
 			{
+				objectp->mLocalID = local_id;
 			}
-			else
-			{
-				if (update_type != OUT_FULL)
-				{
-					//LL_INFOS() << "terse update for an unknown object:" << fullid << LL_ENDL;
-					recorder.objectUpdateFailure(local_id, update_type, msg_size);
-					continue;
-				}
+			processUpdateCore(objectp, user_data, i, update_type, NULL, justCreated);
+		}
+		recorder.objectUpdateEvent(local_id, update_type, objectp, msg_size);
+		objectp->setLastUpdateType(update_type);
+		objectp->setLastUpdateCached(false);
+	}
 
-				mesgsys->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, pcode, i);
-				msg_size += sizeof(U8);
+	recorder.log(0.2f);
 
-			}
-#ifdef IGNORE_DEAD
-			if (mDeadObjects.find(fullid) != mDeadObjects.end())
-			{
-				mNumDeadObjectUpdates++;
-				//LL_INFOS() << "update for a dead object:" << fullid << LL_ENDL;
-				recorder.objectUpdateFailure(local_id, update_type, msg_size);
-				continue;
-			}
-#endif
+	LLVOAvatar::cullAvatarsByPixelArea();
+}
 
+void LLViewerObjectList::processDecodedObjectUpdate(const LLObjectUpdateMessage& message)
+{
+	LL_RECORD_BLOCK_TIME(FTM_PROCESS_OBJECTS);
 
-			if(std::find(LLFloaterBlacklist::blacklist_objects.begin(),
-				LLFloaterBlacklist::blacklist_objects.end(),fullid) != LLFloaterBlacklist::blacklist_objects.end())
-			{
-				//LL_INFOS() << "Blacklisted object asset " << fullid.asString() << " blocked." << LL_ENDL; 
-				continue;
-			}
+	const EObjectUpdateType update_type = message.getUpdateType();
+	const LLObjectUpdateSource& source = message.getSource();
+	const std::vector<LLDecodedObjectUpdate>& updates = message.getUpdates();
+	const bool terse = update_type == OUT_TERSE_IMPROVED;
 
+	gFullObjectUpdates += (S32)updates.size();
 
-			objectp = createObject(pcode, regionp, fullid, local_id, gMessageSystem->getSender());
-			if (!objectp)
-			{
-				LL_INFOS() << "createObject failure for object: " << fullid << LL_ENDL;
-				recorder.objectUpdateFailure(local_id, update_type, msg_size);
-				continue;
-			}
-			justCreated = TRUE;
-			mNumNewObjects++;
-			sCacheHitRate.addValue(cached ? 100.f : 0.f);
+	LLViewerRegion *regionp = LLWorld::getInstance()->getRegionFromHandle(source.mRegionHandle);
 
-		}
+	if (!regionp)
+	{
+		LL_WARNS() << "Object update from unknown region! " << source.mRegionHandle << LL_ENDL;
+		return;
+	}
 
+	LLDataPackerBinaryBuffer dp;
+	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
 
-		if (objectp->isDead())
+	for (U32 i = 0; i < (U32)updates.size(); i++)
+	{
+		const LLDecodedObjectUpdate& update = updates[i];
+		BOOL justCreated = FALSE;
+		S32	msg_size = 0;
+		U32 local_id = update.mLocalID;
+		LLUUID fullid;
+
+		if (!terse) // OUT_FULL_COMPRESSED only?
 		{
-			LL_WARNS() << "Dead object " << objectp->mID << " in UUID map 1!" << LL_ENDL;
+			fullid = update.mFullID;
 		}
-
-		bool bCached = false;
-		if (compressed)
+		else //OUT_TERSE_IMPROVED
 		{
-			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
-			{
-				objectp->mLocalID = local_id;
-			}
-			processUpdateCore(objectp, user_data, i, update_type, &compressed_dp, justCreated);
-			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
+			getUUIDFromLocal(fullid,
+							 local_id,
+							 source.mSender.getAddress(),
+							 source.mSender.getPort());
+			if (fullid.isNull())
 			{
-				bCached = true;
-				LLViewerRegion::eCacheUpdateResult result = objectp->mRegionp->cacheFullUpdate(objectp, compressed_dp);
-				recorder.cacheFullUpdate(local_id, update_type, result, objectp, msg_size);
+				LL_DEBUGS() << "update for unknown localid " << local_id << " host " << source.mSender << LL_ENDL;
+				mNumUnknownUpdates++;
 			}
 		}
-		else if (cached)
+
+		LLViewerObject* objectp = findObjectForUpdate(fullid, local_id, update.mPCode, regionp, source.mSender,
+													  update_type, !terse, false, msg_size, justCreated);
+		if (!objectp)
+		{
+			continue;
+		}
+
+		bool bCached = false;
+		if (!terse) // OUT_FULL_COMPRESSED only?
 		{
 			objectp->mLocalID = local_id;
-			processUpdateCore(objectp, user_data, i, update_type, cached_dpp, justCreated);
 		}
-		else
+		processUpdateCore(objectp, message.getUserData(), i, update_type, &update, justCreated);
+		if (!terse) // OUT_FULL_COMPRESSED only?
 		{
-			if (update_type == OUT_FULL)
-			{
-				objectp->mLocalID = local_id;
-			}
-			processUpdateCore(objectp, user_data, i, update_type, NULL, justCreated);
+			bCached = true;
+			update.getPacker(dp);
+			LLViewerRegion::eCacheUpdateResult result = objectp->mRegionp->cacheFullUpdate(objectp, dp);
+			recorder.cacheFullUpdate(local_id, update_type, result, objectp, msg_size);
 		}
 		recorder.objectUpdateEvent(local_id, update_type, objectp, msg_size);
 		objectp->setLastUpdateType(update_type);
@@ -639,14 +693,21 @@ void LLViewerObjectList::processCompressedObjectUpdate(LLMessageSystem *mesgsys,
 											 void **user_data,
 											 const EObjectUpdateType update_type)
 {
-	processObjectUpdate(mesgsys, user_data, update_type, false, true);
+	// Applied in order by gObjectUpdateDecoder.finish(), which also plays
+	// the sounds that were waiting for the objects it creates.
+	gObjectUpdateDecoder.add(mesgsys, update_type, user_data);
+	if (!LLObjectUpdateDecodeThread::sLocal)
+	{
+		// Decoded inline: apply it now, as before.
+		gObjectUpdateDecoder.finish(true);
+	}
 }
 
 void LLViewerObjectList::processCachedObjectUpdate(LLMessageSystem *mesgsys,
 											 void **user_data,
 											 const EObjectUpdateType update_type)
 {
-	processObjectUpdate(mesgsys, user_data, update_type, true, false);
+	processObjectUpdate(mesgsys, user_data, update_type, true);
 }	
 
 void LLViewerObjectList::dirtyAllObjectInventory()
@@ -1406,6 +1467,11 @@ void LLViewerObjectList::killAllObjects()
 	if (!mMapObjects.empty())
 	{
 		LL_WARNS() << "Some objects still on map object list!" << LL_ENDL;
+		for (vobj_list_t::iterator iter = mMapObjects.begin(); iter != mMapObjects.end(); ++iter)
+		{
+			(*iter)->mMapListIndex = -1;
+			LLRegionGrid<LLViewerObject>::remove((*iter)->mMapSlot);
+		}
 		mMapObjects.clear();
 	}
 }
@@ -1489,6 +1555,51 @@ void LLViewerObjectList::removeFromActiveList(LLViewerObject* objectp)
 	}
 }
 
+void LLViewerObjectList::addToMap(LLViewerObject *objectp)
+{
+	if (objectp->mMapListIndex == -1)
+	{
+		mMapObjects.push_back(objectp);
+		objectp->mMapListIndex = mMapObjects.size()-1;
+	}
+	updateMapCell(objectp);
+}
+
+void LLViewerObjectList::removeFromMap(LLViewerObject *objectp)
+{
+	LLRegionGrid<LLViewerObject>::remove(objectp->mMapSlot);
+
+	S32 idx = objectp->mMapListIndex;
+	if (idx != -1)
+	{ //remove by moving last element to this object's position
+		llassert(mMapObjects[idx] == objectp);
+
+		objectp->mMapListIndex = -1;
+
+		vobj_list_t::iterator iter = vector_replace_with_last(mMapObjects, mMapObjects.begin() + idx);
+		if (iter != mMapObjects.end())
+			(*iter)->mMapListIndex = idx;
+	}
+}
+
+void LLViewerObjectList::updateMapCell(LLViewerObject *objectp)
+{
+	if (objectp->mMapListIndex == -1)
+	{
+		// Not on the map any more, though still flagged as on it until it dies.
+		return;
+	}
+	LLViewerRegion* regionp = objectp->getRegion();
+	if (regionp)
+	{
+		regionp->getMapObjects().update(objectp, objectp->getPositionRegion(), objectp->mMapSlot);
+	}
+	else
+	{
+		LLRegionGrid<LLViewerObject>::remove(objectp->mMapSlot);
+	}
+}
+
 void LLViewerObjectList::updateActive(LLViewerObject *objectp)
 {
 	if (objectp->isDead())
@@ -1735,7 +1846,21 @@ void LLViewerObjectList::renderObjectsForMap(LLNetMap &netmap)
 	const F32 agent_altitude(gAgent.getPositionGlobal()[VZ]);
 	static const LLCachedControl<U32> delta("MiniMapPrimMaxAltitudeDelta");
 
-	for (vobj_list_t::iterator iter = mMapObjects.begin(); iter != mMapObjects.end(); ++iter)
+	// Only the objects in the cells under the object layer of the map can be drawn on it.
+	static std::vector<LLViewerObject*> map_objects;
+	map_objects.clear();
+	auto add_object = [](LLViewerObject* objectp) { map_objects.push_back(objectp); };
+	const LLVector3d& center = netmap.getObjectImageCenterGlobal();
+	const F64 radius = netmap.getObjectImageRadius();
+	const LLWorld::region_list_t& regions = LLWorld::getInstance()->getRegionList();
+	for (LLWorld::region_list_t::const_iterator iter = regions.begin(); iter != regions.end(); ++iter)
+	{
+		const LLVector3d center_region = center - (*iter)->getOriginGlobal();
+		(*iter)->getMapObjects().forEachNear((F32)(center_region.mdV[VX] - radius), (F32)(center_region.mdV[VY] - radius),
+											 (F32)(center_region.mdV[VX] + radius), (F32)(center_region.mdV[VY] + radius), add_object);
+	}
+
+	for (std::vector<LLViewerObject*>::iterator iter = map_objects.begin(); iter != map_objects.end(); ++iter)
 	{
 		LLViewerObject* objectp = *iter;
 
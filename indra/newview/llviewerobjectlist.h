@@ -49,6 +49,8 @@
 class LLCamera;
 class LLNetMap;
 class LLDebugBeacon;
+class LLDecodedObjectUpdate;
+class LLObjectUpdateMessage;
 
 constexpr U32 CLOSE_BIN_SIZE = 10;
 constexpr U32 NUM_BINS = 128;
@@ -90,10 +92,18 @@ public:
 	void cleanDeadObjects(const BOOL use_timer = TRUE);	// Clean up the dead object list.
 
 	// Simulator and viewer side object updates...
-	void processUpdateCore(LLViewerObject* objectp, void** data, U32 block, const EObjectUpdateType update_type, LLDataPacker* dpp, BOOL justCreated);
-	void processObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type, bool cached=false, bool compressed=false);
+	void processUpdateCore(LLViewerObject* objectp, void** data, U32 block, const EObjectUpdateType update_type, const LLDecodedObjectUpdate* update, BOOL justCreated);
+	void processObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type, bool cached=false);
 	void processCompressedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
+	// Applies a compressed or terse update message once it has been decoded.
+	void processDecodedObjectUpdate(const LLObjectUpdateMessage& message);
 	void processCachedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
+	// Finds the object an update from sender is for, moving it to local_id and
+	// regionp, or creates it when create is set. NULL when the update is dropped.
+	LLViewerObject* findObjectForUpdate(const LLUUID& fullid, const U32 local_id, const LLPCode pcode,
+										LLViewerRegion* regionp, const LLHost& sender,
+										const EObjectUpdateType update_type, bool create, bool cached,
+										S32 msg_size, BOOL& just_created);
 	void updateApparentAngles(LLAgent &agent);
 	void update(LLAgent &agent, LLWorld &world);
 
@@ -147,6 +157,8 @@ public:
 
 	void addToMap(LLViewerObject *objectp);
 	void removeFromMap(LLViewerObject *objectp);
+	// Moves a map object to the cell of its position in its region's grid.
+	void updateMapCell(LLViewerObject *objectp);
 
 	void clearDebugText();
 
@@ -303,19 +315,5 @@ inline LLViewerObject *LLViewerObjectList::getObject(const S32 index)
 	return objectp;
 }
 
-inline void LLViewerObjectList::addToMap(LLViewerObject *objectp)
-{
-	mMapObjects.push_back(objectp);
-}
-
-inline void LLViewerObjectList::removeFromMap(LLViewerObject *objectp)
-{
-	std::vector<LLPointer<LLViewerObject> >::iterator iter = std::find(mMapObjects.begin(), mMapObjects.end(), objectp);
-	if (iter != mMapObjects.end())
-	{
-		mMapObjects.erase(iter);
-	}
-}
-
 
 #endif // LL_VIEWER_OBJECT_LIST_H
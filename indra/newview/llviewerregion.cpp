@@ -65,6 +65,7 @@
 #include "llfloaterperms.h"
 #include "llfloaterregioninfo.h"
 #include "llhttpnode.h"
+#include "llregiongrid.h"
 #include "llregioninfomodel.h"
 #include "llsdutil.h"
 #include "llstartup.h"
@@ -141,7 +142,8 @@ public:
 		    // LLCapabilityListener binds all the globals it expects to need at
 		    // construction time.
 		    mCapabilityListener(host.getString(), gMessageSystem, *region,
-		                        gAgent.getID(), gAgent.getSessionID())
+		                        gAgent.getID(), gAgent.getSessionID()),
+			mMapObjects(NULL)
 	{
 	}
 
@@ -167,7 +169,10 @@ public:
 	// Misc
 	LLVLComposition *mCompositionp;		// Composition layer for the surface
 
+	// Objects seen or asked for since the region was entered; the others
+	// are only in mCacheFile.
 	LLVOCacheEntry::vocache_entry_map_t		mCacheMap;
+	LLVOCacheFile		mCacheFile;
 	// time?
 	// LRU info?
 
@@ -193,6 +198,9 @@ public:
 
 	//spatial partitions for objects in this region
 	std::vector<LLViewerOctreePartition*> mObjectPartition;
+
+	// Objects drawn on the map, binned by position for the net map to find
+	LLRegionGrid<LLViewerObject>* mMapObjects;
 };
 
 // support for secondlife:///app/region/{REGION} SLapps
@@ -449,6 +457,7 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	updateRenderMatrix();
 
 	mImpl->mLandp = new LLSurface('l', NULL);
+	mImpl->mMapObjects = new LLRegionGrid<LLViewerObject>(mWidth);
 
 	// Create the composition layer for the surface
 	mImpl->mCompositionp =
@@ -547,6 +556,7 @@ LLViewerRegion::~LLViewerRegion()
 	delete mImpl->mCompositionp;
 	delete mParcelOverlay;
 	delete mImpl->mLandp;
+	delete mImpl->mMapObjects;
 	delete mImpl->mEventPoll;
 	LLHTTPSender::clearSender(mImpl->mHost);
 	
@@ -601,7 +611,7 @@ void LLViewerRegion::loadObjectCache()
 
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->readFromCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap) ;
+		LLVOCache::getInstance()->readFromCache(mHandle, mImpl->mCacheID, mImpl->mCacheFile) ;
 	}
 }
 
@@ -613,14 +623,14 @@ void LLViewerRegion::saveObjectCache()
 		return;
 	}
 
-	if (mImpl->mCacheMap.empty())
+	if (mImpl->mCacheMap.empty() && !mImpl->mCacheFile.isOpen())
 	{
 		return;
 	}
 
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->writeToCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap, mCacheDirty) ;
+		LLVOCache::getInstance()->writeToCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap, mImpl->mCacheFile, mCacheDirty) ;
 		mCacheDirty = FALSE;
 	}
 
@@ -629,6 +639,7 @@ void LLViewerRegion::saveObjectCache()
 		delete iter->second;
 	}
 	mImpl->mCacheMap.clear();
+	mImpl->mCacheFile.close();
 }
 
 void LLViewerRegion::sendMessage()
@@ -1610,7 +1621,7 @@ LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLViewerObjec
 	U32 local_id = objectp->getLocalID();
 	U32 crc = objectp->getCRC();
 
-	LLVOCacheEntry* entry = get_if_there(mImpl->mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	LLVOCacheEntry* entry = getCacheEntry(local_id);
 
 	if (entry)
 	{
@@ -1657,11 +1668,11 @@ void LLViewerRegion::addToCreatedList(U32 local_id)
 
 // Get data packer for this object, if we have cached data
 // AND the CRC matches. JC
-LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
+LLDataPackerBinaryBuffer *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
 {
 	//llassert(mCacheLoaded);  This assert failes often, changing to early-out -- davep, 2010/10/18
 
-	LLVOCacheEntry* entry = get_if_there(mImpl->mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	LLVOCacheEntry* entry = getCacheEntry(local_id);
 
 	if (entry)
 	{
@@ -1690,6 +1701,21 @@ LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
 	return NULL;
 }
 
+LLVOCacheEntry* LLViewerRegion::getCacheEntry(U32 local_id)
+{
+	LLVOCacheEntry* entry = get_if_there(mImpl->mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	if (!entry && mImpl->mCacheFile.isOpen())
+	{
+		const LLVOCacheFile::Record* record = mImpl->mCacheFile.find(local_id);
+		if (record)
+		{
+			entry = mImpl->mCacheFile.createEntry(*record);
+			mImpl->mCacheMap[local_id] = entry;
+		}
+	}
+	return entry;
+}
+
 void LLViewerRegion::addCacheMissFull(const U32 local_id)
 {
 	mCacheMissFull.push_back(local_id);
@@ -1800,7 +1826,21 @@ void LLViewerRegion::dumpCache()
 		change_bin[changes]++;
 	}
 
-	LL_INFOS() << "Count " << mImpl->mCacheMap.size() << LL_ENDL;
+	// Objects not asked for yet are only in the cache file.
+	S32 count = mImpl->mCacheMap.size();
+	const LLVOCacheFile::Record* records = mImpl->mCacheFile.getRecords();
+	for (S32 j = 0; j < mImpl->mCacheFile.getNumRecords(); ++j)
+	{
+		if (mImpl->mCacheMap.count(records[j].mLocalID))
+		{
+			continue;
+		}
+		hit_bin[llclamp(records[j].mHitCount, 0, BINS-1)]++;
+		change_bin[llclamp(records[j].mCRCChangeCount, 0, BINS-1)]++;
+		++count;
+	}
+
+	LL_INFOS() << "Count " << count << LL_ENDL;
 	for (i = 0; i < BINS; i++)
 	{
 		LL_INFOS() << "Hits " << i << " " << hit_bin[i] << LL_ENDL;
@@ -2348,6 +2388,11 @@ LLSpatialPartition* LLViewerRegion::getSpatialPartition(U32 type)
 	return NULL;
 }
 
+LLRegionGrid<LLViewerObject>& LLViewerRegion::getMapObjects()
+{
+	return *mImpl->mMapObjects;
+}
+
 // the viewer can not yet distinquish between normal- and estate-owned objects
 // so we collapse these two bits and enable the UI if either are set
 const U64 ALLOW_RETURN_ENCROACHING_OBJECT = REGION_FLAGS_ALLOW_RETURN_ENCROACHING_OBJECT
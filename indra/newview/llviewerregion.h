@@ -80,6 +80,7 @@ class LLViewerTexture;
 // [/SL:KB]
 
 class LLViewerRegionImpl;
+template<class T> class LLRegionGrid;
 class LLViewerOctreeGroup;
 
 class LLViewerRegion: public LLCapabilityProvider // implements this interface
@@ -361,7 +362,7 @@ public:
 
 	// handle a full update message
 	eCacheUpdateResult cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinaryBuffer &dp);
-	LLDataPacker *getDP(U32 local_id, U32 crc, U8 &cache_miss_type);
+	LLDataPackerBinaryBuffer *getDP(U32 local_id, U32 crc, U8 &cache_miss_type);
 	void requestCacheMisses();
 	void addCacheMissFull(const U32 local_id);
 
@@ -381,6 +382,9 @@ public:
 
 	LLSpatialPartition* getSpatialPartition(U32 type);
 
+	// The objects of this region drawn on the map, by where they are in it.
+	LLRegionGrid<LLViewerObject>& getMapObjects();
+
 	bool objectIsReturnable(const LLVector3& pos, const std::vector<LLBBox>& boxes) const;
 	bool childrenObjectReturnable( const std::vector<LLBBox>& boxes ) const;
 	bool objectsCrossParcel(const std::vector<LLBBox>& boxes) const;
@@ -417,6 +421,9 @@ protected:
 	void disconnectAllNeighbors();
 	void initStats();
 	void initPartitions();
+	// The cached entry for the object, created from the mapped cache file
+	// the first time the object is asked for.
+	LLVOCacheEntry* getCacheEntry(U32 local_id);
 
 public:
 	LLWind  mWind;
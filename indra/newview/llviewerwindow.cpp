@@ -202,6 +202,7 @@
 
 //Genesis
 #include "llsqlmgr.h"
+#include "lltaggedavatarsmgr.h"
 #include "llversioninfo.h"
 
 //
@@ -2141,6 +2142,21 @@ void LLViewerWindow::adjustControlRectanglesForFirstUse(const LLRect& window)
 	adjust_rect_top_center("FloaterCameraRect3", window);
 }
 
+// Applies the colors the user changed, saved in db, to gColors.
+static void load_color_settings(LLSqlMgr::EDatabase db)
+{
+	LLSqlMgr::rows_t rows = LLSqlMgr::instance().queueRead(db, "SELECT ID,R,G,B,A FROM COLOR_SETTINGS").get();
+	for (const LLSD& row : rows)
+	{
+		const std::string controlName = row[0].asString();
+		if (gColors.controlExists(controlName))
+		{
+			LLColor4 controlValue(F32(row[1].asReal()), F32(row[2].asReal()), F32(row[3].asReal()), F32(row[4].asReal()));
+			gColors.getControl(controlName)->set(controlValue.getValue());
+		}
+	}
+}
+
 void LLViewerWindow::initWorldUI()
 {
 	pre_init_menus();
@@ -2156,27 +2172,7 @@ void LLViewerWindow::initWorldUI()
 		std::string db_path = gDirUtilp->getExpandedFilename(LL_PATH_USER_SETTINGS,
 				llformat("settings_%s.db",  LLVersionInfo::getChannel().c_str()));
 		LLSqlMgr::instance().initALLAgentsDB(db_path);	
-		char *sql;
-		sqlite3_stmt *stmt;
-		sqlite3 *db = LLSqlMgr::instance().getAllAgentsDB();
-		sql = "SELECT ID,R,G,B,A FROM COLOR_SETTINGS";
-		sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-		while ( sqlite3_step(stmt) == SQLITE_ROW) {
-			const unsigned char *id = sqlite3_column_text(stmt, 0);
-			double r = sqlite3_column_double(stmt, 1);
-			double g = sqlite3_column_double(stmt, 2);
-			double b = sqlite3_column_double(stmt, 3);
-			double a = sqlite3_column_double(stmt, 4);
-			
-			std::string controlName = std::string(reinterpret_cast<const char*>(id));
-			LLColor4 controlValue = LLColor4(F32(r),F32(g),F32(b),F32(a));
-			if (gColors.controlExists(controlName)) {
-				gColors.getControl(controlName)->set(controlValue.getValue());
-			}
-			
-		
-		
-		}
+		load_color_settings(LLSqlMgr::ALL_AGENTS_DB);
 }
 
 // initWorldUI that wasn't before logging in. Some of this may require the access the 'LindenUserDir'.
@@ -2226,30 +2222,9 @@ void LLViewerWindow::initWorldUI_postLogin()
 		std::string db_path = gDirUtilp->getExpandedFilename(LL_PATH_PER_SL_ACCOUNT,
 				llformat("settings_%s.db",  LLVersionInfo::getChannel().c_str()));
 		LLSqlMgr::instance().initAgentDB(db_path);	
+		LLTaggedAvatarsMgr::instance().init();
 		//loading user defined color settings
-		char *sql;
-		sqlite3_stmt *stmt;
-		sqlite3 *db = LLSqlMgr::instance().getDB();
-		sql = "SELECT ID,R,G,B,A FROM COLOR_SETTINGS";
-		sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-		while ( sqlite3_step(stmt) == SQLITE_ROW) {
-			const unsigned char *id = sqlite3_column_text(stmt, 0);
-			double r = sqlite3_column_double(stmt, 1);
-			double g = sqlite3_column_double(stmt, 2);
-			double b = sqlite3_column_double(stmt, 3);
-			double a = sqlite3_column_double(stmt, 4);
-			
-			std::string controlName = std::string(reinterpret_cast<const char*>(id));
-			LLColor4 controlValue = LLColor4(F32(r),F32(g),F32(b),F32(a));
-			if (gColors.controlExists(controlName)) {
-				gColors.getControl(controlName)->set(controlValue.getValue());
-			}
-			
-		
-		
-		}
-
-		sqlite3_finalize(stmt);
+		load_color_settings(LLSqlMgr::AGENT_DB);
 
 			
 	}
@@ -45,6 +45,7 @@
 #include "llperlin.h"
 #include "llregionhandle.h" // for from_region_handle
 #include "llviewercontrol.h"
+#include "llterraincompositor.h"
 
 
 
@@ -94,6 +95,19 @@ LLVLComposition::LLVLComposition(LLSurface *surfacep, const U32 width, const F32
 
 LLVLComposition::~LLVLComposition()
 {
+	// The compositing thread reads the jobs until they are done.
+	mPendingJobs.splice(mPendingJobs.end(), mSupersededJobs);
+	for (auto& job : mPendingJobs)
+	{
+		while (!job->isDone())
+		{
+			if (LLTerrainCompositeThread::sLocal)
+			{
+				LLTerrainCompositeThread::updateClass(0);
+			}
+			ms_sleep(1);
+		}
+	}
 }
 
 
@@ -274,9 +288,6 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	//
 
 	// These have already been validated by generateComposition.
-	U8* st_data[4];
-	S32 st_data_size[4]; // for debugging
-
 	for (S32 i = 0; i < 4; i++)
 	{
 		if (mRawImages[i].isNull())
@@ -315,8 +326,6 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 				mRawImages[i] = newraw; // deletes old
 			}
 		}
-		st_data[i] = mRawImages[i]->getData();
-		st_data_size[i] = mRawImages[i]->getDataSize();
 	}
 
 	///////////////////////////////////////
@@ -351,7 +360,6 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 
 	LLViewerTexture *texturep;
 	U32 tex_width, tex_height, tex_comps;
-	U32 tex_stride;
 	F32 tex_x_scalef, tex_y_scalef;
 	S32 tex_x_begin, tex_y_begin, tex_x_end, tex_y_end;
 	F32 tex_x_ratiof, tex_y_ratiof;
@@ -360,7 +368,6 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	tex_width = texturep->getWidth();
 	tex_height = texturep->getHeight();
 	tex_comps = texturep->getComponents();
-	tex_stride = tex_width * tex_comps;
 
 	U32 st_comps = 3;
 	U32 st_width = BASE_SIZE;
@@ -382,84 +389,45 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
 	tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
 
-	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
-	U8 *rawp = raw->getData();
-
 	F32 st_x_stride, st_y_stride;
 	st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
 	st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
 
 	llassert(st_x_stride > 0.f);
 	llassert(st_y_stride > 0.f);
+
 	////////////////////////////////
 	//
-	// Iterate through the target texture, striding through the
-	// subtextures and interpolating appropriately.
+	// Blend the subtextures on the compositing thread; the result is
+	// uploaded by uploadTextures().
 	//
 	//
 
-	F32 sti, stj;
-	S32 st_offset;
-	sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
-	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
-
-	st_offset = (llfloor(stj * st_width) + llfloor(sti)) * st_comps;
-	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+	LLPointer<LLTerrainCompositeJob> job = new LLTerrainCompositeJob(mRawImages, BASE_SIZE, mDatap, mWidth, mScale,
+																	 tex_width, tex_height,
+																	 tex_x_begin, tex_y_begin, tex_x_end, tex_y_end,
+																	 tex_x_ratiof, tex_y_ratiof, st_x_stride, st_y_stride);
+	if (LLTerrainCompositeThread::sLocal)
 	{
-		U32 offset = j * tex_stride + tex_x_begin * tex_comps;
-		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
-		for (S32 i = tex_x_begin; i < tex_x_end; i++)
+		// A newer job for the same patch supersedes a pending one.
+		for (auto iter = mPendingJobs.begin(); iter != mPendingJobs.end(); ++iter)
 		{
-			S32 tex0, tex1;
-			F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
-
-			tex0 = llfloor( composition );
-			tex0 = llclamp(tex0, 0, 3);
-			composition -= tex0;
-			tex1 = tex0 + 1;
-			tex1 = llclamp(tex1, 0, 3);
-
-			st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
-			for (U32 k = 0; k < tex_comps; k++)
+			if ((*iter)->getTexXBegin() == tex_x_begin && (*iter)->getTexYBegin() == tex_y_begin && !(*iter)->isDone())
 			{
-				// Linearly interpolate based on composition.
-				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
-				{
-					// SJB: This shouldn't be happening, but does... Rounding error?
-					//LL_WARNS() << "offset 0 [" << tex0 << "] =" << st_offset << " >= size=" << st_data_size[tex0] << LL_ENDL;
-					//LL_WARNS() << "offset 1 [" << tex1 << "] =" << st_offset << " >= size=" << st_data_size[tex1] << LL_ENDL;
-				}
-				else
-				{
-					F32 a = *(st_data[tex0] + st_offset);
-					F32 b = *(st_data[tex1] + st_offset);
-					rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
-				}
-				offset++;
-				st_offset++;
-			}
-
-			sti += st_x_stride;
-			if (sti >= st_width)
-			{
-				sti -= st_width;
+				mSupersededJobs.push_back(*iter);
+				mPendingJobs.erase(iter);
+				break;
 			}
 		}
-
-		stj += st_y_stride;
-		if (stj >= st_height)
-		{
-			stj -= st_height;
-		}
+		mPendingJobs.push_back(job);
+		LLTerrainCompositeThread::sLocal->composite(job);
 	}
-
-	if (!texturep->hasGLTexture())
+	else
 	{
-		texturep->createGLTexture(0, raw);
+		job->composite();
+		uploadTexture(job);
 	}
-	texturep->setSubImage(raw, tex_x_begin, tex_y_begin, tex_x_end - tex_x_begin, tex_y_end - tex_y_begin);
 	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
-	LLSurface::sTexelsUpdated += (tex_x_end - tex_x_begin) * (tex_y_end - tex_y_begin);
 
 	for (S32 i = 0; i < 4; i++)
 	{
@@ -471,6 +439,73 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	return TRUE;
 }
 
+void LLVLComposition::uploadTexture(LLTerrainCompositeJob* job)
+{
+	LLImageRaw* raw = job->getRawImage();
+	LLViewerTexture* texturep = mSurfacep->getSTexture();
+	if (!raw || !texturep
+		|| texturep->getWidth() != job->getTexWidth() || texturep->getHeight() != job->getTexHeight())
+	{
+		// Dropped at shutdown, or the surface texture changed under the job.
+		return;
+	}
+
+	// setSubImage() wants the rectangle at its place in a full size image.
+	const S32 tex_comps = LLTerrainCompositeJob::COMPONENTS;
+	if (mUploadImage.isNull() || mUploadImage->getWidth() != job->getTexWidth() || mUploadImage->getHeight() != job->getTexHeight())
+	{
+		mUploadImage = new LLImageRaw(job->getTexWidth(), job->getTexHeight(), tex_comps);
+	}
+	const S32 width = job->getTexXEnd() - job->getTexXBegin();
+	const S32 height = job->getTexYEnd() - job->getTexYBegin();
+	for (S32 j = 0; j < height; j++)
+	{
+		memcpy(mUploadImage->getData() + ((job->getTexYBegin() + j) * job->getTexWidth() + job->getTexXBegin()) * tex_comps,
+			   raw->getData() + j * width * tex_comps, width * tex_comps);
+	}
+
+	if (!texturep->hasGLTexture())
+	{
+		texturep->createGLTexture(0, mUploadImage);
+	}
+	texturep->setSubImage(mUploadImage, job->getTexXBegin(), job->getTexYBegin(), width, height);
+	LLSurface::sTexelsUpdated += width * height;
+}
+
+void LLVLComposition::uploadTextures()
+{
+	if (mPendingJobs.empty() && mSupersededJobs.empty())
+	{
+		return;
+	}
+
+	LLTimer upload_timer;
+	for (auto iter = mPendingJobs.begin(); iter != mPendingJobs.end(); )
+	{
+		if ((*iter)->isDone())
+		{
+			uploadTexture(*iter);
+			iter = mPendingJobs.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	for (auto iter = mSupersededJobs.begin(); iter != mSupersededJobs.end(); )
+	{
+		if ((*iter)->isDone())
+		{
+			iter = mSupersededJobs.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	LLSurface::sTextureUpdateTime += upload_timer.getElapsedTimeF32();
+}
+
 LLUUID LLVLComposition::getDetailTextureID(S32 corner)
 {
 	return mDetailTextures[corner]->getID();
@@ -36,7 +36,10 @@
 #include "llviewerlayer.h"
 #include "llviewertexture.h"
 
+#include <list>
+
 class LLSurface;
+class LLTerrainCompositeJob;
 
 class LLVLComposition : public LLViewerLayer
 {
@@ -49,8 +52,12 @@ public:
 	// Viewer side hack to generate composition values
 	BOOL generateHeights(const F32 x, const F32 y, const F32 width, const F32 height);
 	BOOL generateComposition();
-	// Generate texture from composition values.
+	// Generate texture from composition values. The blending itself runs on
+	// LLTerrainCompositeThread when there is one; uploadTextures() then
+	// uploads the result.
 	BOOL generateTexture(const F32 x, const F32 y, const F32 width, const F32 height);		
+	// Upload the patches composited since the last call. MAIN THREAD.
+	void uploadTextures();
 
 	// Use these as indeces ito the get/setters below that use 'corner'
 	enum ECorner
@@ -75,6 +82,8 @@ public:
 	void setParamsReady()		{ mParamsReady = TRUE; }
 	BOOL getParamsReady() const	{ return mParamsReady; }
 protected:
+	void uploadTexture(LLTerrainCompositeJob* job);
+
 	BOOL mParamsReady;
 	LLSurface *mSurfacep;
 	BOOL mTexturesLoaded;
@@ -87,6 +96,13 @@ protected:
 
 	F32 mTexScaleX;
 	F32 mTexScaleY;
+
+	// Jobs submitted to LLTerrainCompositeThread, oldest first.
+	std::list<LLPointer<LLTerrainCompositeJob> > mPendingJobs;
+	// Replaced by a newer job for the same patch; only kept until done.
+	std::list<LLPointer<LLTerrainCompositeJob> > mSupersededJobs;
+	// Full size staging image for setSubImage().
+	LLPointer<LLImageRaw> mUploadImage;
 };
 
 #endif //LL_LLVLCOMPOSITION_H
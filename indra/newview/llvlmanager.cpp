@@ -92,44 +92,55 @@ void LLVLManager::addLayerData(LLVLData *vl_datap, const S32 mesg_size)
 
 void LLVLManager::unpackData(const S32 num_packets)
 {
-	static LLFrameTimer decode_timer;
-	
-	U32 i;
-	for (i = 0; i < mPacketData.size(); i++)
+	// Hand new packets to the decode thread, or decode them right away without one.
+	for (LLVLData* datap : mPacketData)
 	{
-		LLVLData *datap = mPacketData[i];
-
-		LLBitPack bit_pack(datap->mData, datap->mSize);
-		LLGroupHeader goph;
+		if (!datap->mQueued)
+		{
+			datap->mQueued = true;
+			if (LLVLDecodeThread::sLocal)
+			{
+				LLVLDecodeThread::sLocal->decode(datap);
+			}
+			else
+			{
+				datap->decode();
+				datap->mDecoded = 1;
+			}
+		}
+	}
 
-		decode_patch_group_header(bit_pack, &goph);
-		if (LAND_LAYER_CODE == datap->mType)
+	// Apply decoded packets in arrival order, so a newer patch is never
+	// overwritten by an older one.
+	U32 applied = 0;
+	while (applied < mPacketData.size() && mPacketData[applied]->isDecoded())
+	{
+		LLVLData *datap = mPacketData[applied++];
+		if (!datap->mRegionp)
+		{
+			// The region went away while the packet was decoding.
+		}
+		else if (LAND_LAYER_CODE == datap->mType)
 		{
-			datap->mRegionp->getLand().decompressDCTPatch(bit_pack, &goph, FALSE);
+			datap->mRegionp->getLand().decompressDCTPatch(datap->mPatchGroup, FALSE);
 		}
 		else if (WHITECORE_LAND_LAYER_CODE == datap->mType)
 		{
-			datap->mRegionp->getLand().decompressDCTPatch(bit_pack, &goph, TRUE);
+			datap->mRegionp->getLand().decompressDCTPatch(datap->mPatchGroup, TRUE);
 		}
 		else if (WIND_LAYER_CODE == datap->mType || WHITECORE_WIND_LAYER_CODE == datap->mType)
 		{
-			datap->mRegionp->mWind.decompress(bit_pack, &goph);
-
+			datap->mRegionp->mWind.decompress(datap->mPatchGroup);
 		}
 		else if (CLOUD_LAYER_CODE == datap->mType || WHITECORE_CLOUD_LAYER_CODE == datap->mType)
 		{
 #if ENABLE_CLASSIC_CLOUDS
-			datap->mRegionp->mCloudLayer.decompress(bit_pack, &goph);
+			datap->mRegionp->mCloudLayer.decompress(datap->mPatchGroup);
 #endif
 		}
+		delete datap;
 	}
-
-	for (i = 0; i < mPacketData.size(); i++)
-	{
-		delete mPacketData[i];
-	}
-	mPacketData.clear();
-
+	mPacketData.erase(mPacketData.begin(), mPacketData.begin() + applied);
 }
 
 void LLVLManager::resetBitCounts()
@@ -167,15 +178,22 @@ void LLVLManager::cleanupData(LLViewerRegion *regionp)
 	U32 cur = 0;
 	while (cur < mPacketData.size())
 	{
-		if (mPacketData[cur]->mRegionp == regionp)
+		LLVLData *datap = mPacketData[cur];
+		if (datap->mRegionp != regionp)
 		{
-			delete mPacketData[cur];
-			mPacketData.erase(mPacketData.begin() + cur);
+			cur++;
 		}
-		else
+		else if (datap->mQueued && !datap->isDecoded())
 		{
+			// Still being decoded: dropped by unpackData() once done.
+			datap->mRegionp = NULL;
 			cur++;
 		}
+		else
+		{
+			delete datap;
+			mPacketData.erase(mPacketData.begin() + cur);
+		}
 	}
 }
 
@@ -185,6 +203,8 @@ LLVLData::LLVLData(LLViewerRegion *regionp, const S8 type, U8 *data, const S32 s
 	mData = data;
 	mRegionp = regionp;
 	mSize = size;
+	mQueued = false;
+	mDecoded = 0;
 }
 
 LLVLData::~LLVLData()
@@ -193,3 +213,97 @@ LLVLData::~LLVLData()
 	mData = nullptr;
 	mRegionp = nullptr;
 }
+
+void LLVLData::decode()
+{
+	LLBitPack bit_pack(mData, mSize);
+	if (LAND_LAYER_CODE == mType)
+	{
+		decode_patch_group(bit_pack, mPatchGroup, false);
+	}
+	else if (WHITECORE_LAND_LAYER_CODE == mType)
+	{
+		decode_patch_group(bit_pack, mPatchGroup, true);
+	}
+	else if (WIND_LAYER_CODE == mType || WHITECORE_WIND_LAYER_CODE == mType)
+	{
+		// X and Y components.
+		decode_patch_group(bit_pack, mPatchGroup, false, 2);
+	}
+	else if (CLOUD_LAYER_CODE == mType || WHITECORE_CLOUD_LAYER_CODE == mType)
+	{
+		decode_patch_group(bit_pack, mPatchGroup, false, 1);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+class LLVLDecodeThread::Request : public LLQueuedThread::QueuedRequest
+{
+protected:
+	virtual ~Request() // use deleteRequest()
+	{
+		// Last access to the packet: the main thread may apply it from now on.
+		mData->mDecoded = 1;
+	}
+
+public:
+	Request(handle_t handle, LLVLData* datap)
+		: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, FLAG_AUTO_COMPLETE),
+		  mData(datap)
+	{
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		mData->decode();
+		return true;
+	}
+
+private:
+	// gVLManager keeps the packet until it is decoded.
+	LLVLData* mData;
+};
+
+//----------------------------------------------------------------------------
+
+/*static*/ LLVLDecodeThread* LLVLDecodeThread::sLocal = NULL;
+
+// Run on MAIN thread
+//static
+void LLVLDecodeThread::initClass(bool local_is_threaded)
+{
+	llassert(sLocal == NULL);
+	sLocal = new LLVLDecodeThread(local_is_threaded);
+}
+
+//static
+void LLVLDecodeThread::cleanupClass()
+{
+	// Requests still queued are deleted undecoded, which marks their packets
+	// decoded: they are then applied with no patch.
+	delete sLocal;
+	sLocal = NULL;
+}
+
+LLVLDecodeThread::LLVLDecodeThread(bool threaded)
+	: LLQueuedThread("layerdatadecode", threaded, false, 2, LLJobSystem::PRIORITY_HIGH)
+{
+}
+
+// MAIN thread
+LLVLDecodeThread::handle_t LLVLDecodeThread::decode(LLVLData* datap)
+{
+	handle_t handle = generateHandle();
+	Request* req = new Request(handle, datap);
+	if (!addRequest(req))
+	{
+		// Quitting: decode right away rather than never.
+		datap->decode();
+		req->deleteRequest();
+		return nullHandle();
+	}
+	// Unpauses the thread, or decodes now when not threaded.
+	update(0);
+	return handle;
+}
@@ -36,6 +36,9 @@
 // This class manages the data coming in for viewer layers from the network.
 
 #include "stdtypes.h"
+#include "llatomic.h"
+#include "llqueuedthread.h"
+#include "patch_dct.h"
 
 class LLVLData;
 class LLViewerRegion;
@@ -61,6 +64,8 @@ public:
 	void cleanupData(LLViewerRegion *regionp);
 protected:
 
+	// Kept in arrival order: a packet is applied once it and every packet
+	// before it have been decoded.
 	std::vector<LLVLData *> mPacketData;
 	U32 mLandBits;
 	U32 mWindBits;
@@ -75,10 +80,40 @@ public:
 			 const S8 type, U8 *data, const S32 size);
 	~LLVLData();
 
-	LLViewerRegion *mRegionp;
+	// ANY THREAD
+	// Unpacks and decompresses every patch of the packet into mPatchGroup.
+	// Only reads mData, mType and mSize.
+	void decode();
+
+	bool isDecoded() const		{ return mDecoded != 0; }
+
+	LLViewerRegion *mRegionp;	// NULL once the region went away while decoding
 	U8 *mData;
 	S8 mType;
 	S32 mSize;
+
+	LLPatchGroup mPatchGroup;
+	bool mQueued;
+	LLAtomicU32 mDecoded;
+};
+
+// Decodes LayerData packets in the background. The packet stays owned by
+// gVLManager, which applies it on the main thread once isDecoded().
+class LLVLDecodeThread : public LLQueuedThread
+{
+public:
+	static void initClass(bool local_is_threaded = true); // Setup sLocal
+	static void cleanupClass();		// Delete sLocal
+
+	handle_t decode(LLVLData* datap);
+
+public:
+	static LLVLDecodeThread* sLocal;		// Default worker thread
+
+private:
+	LLVLDecodeThread(bool threaded);
+
+	class Request;
 };
 
 extern LLVLManager gVLManager;
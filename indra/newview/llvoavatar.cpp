@@ -2885,12 +2885,12 @@ void LLVOAvatar::updateMeshData()
 U32 LLVOAvatar::processUpdateMessage(LLMessageSystem *mesgsys,
 									 void **user_data,
 									 U32 block_num, const EObjectUpdateType update_type,
-									 LLDataPacker *dp)
+									 const LLDecodedObjectUpdate* update)
 {
 	const BOOL has_name = !getNVPair("FirstName");
 
 	// Do base class updates...
-	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, dp);
+	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, update);
 
 	// Print out arrival information once we have name of avatar.
 	if (has_name && getNVPair("FirstName"))
@@ -3887,8 +3887,8 @@ void LLVOAvatar::idleUpdateNameTagText(BOOL new_name)
 		LLColor4 name_tag_color = getNameTagColor(is_friend);
 
 		clearNameTag();
-		std::string contactSetId = LLTaggedAvatarsMgr::instance().getAvatarContactSetId(getID().asString());
-		std::string contactSetName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(getID().asString());
+		const std::string& contactSetId = LLTaggedAvatarsMgr::instance().getAvatarContactSetId(getID());
+		const std::string& contactSetName = LLTaggedAvatarsMgr::instance().getAvatarContactSetName(getID());
 		std::string groupText;
 		std::string firstnameText;
 		std::string lastnameText;
@@ -4096,7 +4096,7 @@ void LLVOAvatar::idleUpdateNameTagText(BOOL new_name)
 			
 		}
 		if (!contactSetId.empty() && gSavedSettings.getBOOL("ShowContactSetOnAvatarTag")) {
-			LLColor4 contactSetColor = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(getID().asString());
+			LLColor4 contactSetColor = LLTaggedAvatarsMgr::instance().getAvatarColorContactSet(getID());
 			addNameTagLine(contactSetName, contactSetColor, LLFontGL::NORMAL, LLFontGL::getFontSansSerifSmall());
 		}
 		mNameAway = is_away;
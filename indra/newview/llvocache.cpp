@@ -35,9 +35,13 @@
 #include "llvocache.h"
 
 #include "llerror.h"
+#include "lljobsystem.h"
 #include "llregionhandle.h"
 #include "llviewercontrol.h"
 
+#include <algorithm>
+#include <memory>
+
 BOOL check_read(LLAPRFile* apr_file, void* src, S32 n_bytes) 
 {
 	return apr_file->read(src, n_bytes) == n_bytes ;
@@ -76,74 +80,21 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
-	: mBuffer(NULL)
+LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, S32 hit_count, S32 dupe_count, S32 crc_change_count, U8* data, S32 size)
+	:
+	mLocalID(local_id),
+	mCRC(crc),
+	mHitCount(hit_count),
+	mDupeCount(dupe_count),
+	mCRCChangeCount(crc_change_count),
+	mBuffer(NULL)
 {
-	S32 size = -1;
-	BOOL success;
-
-	mDP.assignBuffer(mBuffer, 0);
-	success = check_read(apr_file, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(apr_file, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &size, sizeof(S32));
-
-	// Corruption in the cache entries
-	if ((size > 10000) || (size < 1))
-	{
-		// We've got a bogus size, skip reading it.
-		// We won't bother seeking, because the rest of this file
-		// is likely bogus, and will be tossed anyway.
-			LL_WARNS() << "Bogus cache entry, size " << size << ", aborting!" << LL_ENDL;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
-	{
-		mBuffer = new U8[size];
-		success = check_read(apr_file, mBuffer, size);
-
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
-	}
-
-	if(!success)
-	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
-	}
+	mDP.assignBuffer(data, size);
 }
 
 LLVOCacheEntry::~LLVOCacheEntry()
 {
-	mDP.freeBuffer();
+	delete[] mBuffer;
 }
 
 
@@ -157,7 +108,7 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mHitCount = 0;
 		mCRCChangeCount++;
 
-		mDP.freeBuffer();
+		delete[] mBuffer;
 		mBuffer = new U8[dp.getBufferSize()];
 		mDP.assignBuffer(mBuffer, dp.getBufferSize());
 		mDP = dp;
@@ -193,38 +144,148 @@ void LLVOCacheEntry::dump() const
 		<< LL_ENDL;
 }
 
-BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
+//---------------------------------------------------------------------------
+// LLVOCacheFile
+//---------------------------------------------------------------------------
+
+LLVOCacheFile::LLVOCacheFile()
+	: mRecords(NULL),
+	  mNumRecords(0)
 {
-	BOOL success;
-	success = check_write(apr_file, (void*)&mLocalID, sizeof(U32));
-	if(success)
+}
+
+bool LLVOCacheFile::open(const std::string& filename, const LLUUID& id)
+{
+	close();
+	if (!mFile.open(filename, LLMappedFile::COPY_ON_WRITE))
 	{
-		success = check_write(apr_file, (void*)&mCRC, sizeof(U32));
+		return false;
 	}
-	if(success)
+
+	const size_t size = mFile.getSize();
+	const Header* header = (const Header*)mFile.getData();
+	if (size < sizeof(Header))
 	{
-		success = check_write(apr_file, (void*)&mHitCount, sizeof(S32));
+		LL_WARNS() << "Truncated object cache file " << filename << LL_ENDL;
+		mFile.close();
+		return false;
 	}
-	if(success)
+	if (memcmp(header->mID, id.mData, UUID_BYTES))
 	{
-		success = check_write(apr_file, (void*)&mDupeCount, sizeof(S32));
+		LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
+		mFile.close();
+		return false;
 	}
-	if(success)
+	if (header->mNumRecords < 0 ||
+		(size_t)header->mNumRecords > (size - sizeof(Header)) / sizeof(Record))
 	{
-		success = check_write(apr_file, (void*)&mCRCChangeCount, sizeof(S32));
+		LL_WARNS() << "Bogus record count " << header->mNumRecords << " in " << filename << LL_ENDL;
+		mFile.close();
+		return false;
 	}
-	if(success)
+
+	// Only the table is checked here; object data is left alone until used.
+	const Record* records = (const Record*)(mFile.getData() + sizeof(Header));
+	const size_t data_start = sizeof(Header) + header->mNumRecords * sizeof(Record);
+	for (S32 i = 0; i < header->mNumRecords; ++i)
 	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(apr_file, (void*)&size, sizeof(S32));
-	
-		if(success)
+		const Record& record = records[i];
+		if (!record.mLocalID || (i && record.mLocalID <= records[i - 1].mLocalID) ||
+			record.mSize < 1 || record.mSize > 10000 ||
+			record.mOffset < data_start || record.mOffset + (size_t)record.mSize > size)
 		{
-			success = check_write(apr_file, (void*)mBuffer, size);
+			LL_WARNS() << "Aborting cache file load for " << filename << ", cache file corruption!" << LL_ENDL;
+			mFile.close();
+			return false;
 		}
 	}
 
-	return success ;
+	mRecords = records;
+	mNumRecords = header->mNumRecords;
+	return true;
+}
+
+void LLVOCacheFile::close()
+{
+	mFile.close();
+	mRecords = NULL;
+	mNumRecords = 0;
+}
+
+const LLVOCacheFile::Record* LLVOCacheFile::find(U32 local_id) const
+{
+	const Record* end = mRecords + mNumRecords;
+	const Record* record = std::lower_bound(mRecords, end, local_id,
+											[](const Record& rec, U32 id) { return rec.mLocalID < id; });
+	return (record != end && record->mLocalID == local_id) ? record : NULL;
+}
+
+LLVOCacheEntry* LLVOCacheFile::createEntry(const Record& record) const
+{
+	return new LLVOCacheEntry(record.mLocalID, record.mCRC, record.mHitCount, record.mDupeCount,
+							  record.mCRCChangeCount, mFile.getData() + record.mOffset, record.mSize);
+}
+
+void LLVOCacheFile::write(const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map,
+						  std::vector<U8>& buffer) const
+{
+	// Both sources are sorted by local id; an entry replaces the record it
+	// was created from.
+	std::vector<Record> records;
+	std::vector<const U8*> sources;
+	records.reserve(cache_entry_map.size() + mNumRecords);
+	sources.reserve(cache_entry_map.size() + mNumRecords);
+	size_t data_size = 0;
+
+	LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin();
+	S32 i = 0;
+	while (iter != cache_entry_map.end() || i < mNumRecords)
+	{
+		Record record;
+		if (iter != cache_entry_map.end() && (i == mNumRecords || iter->first <= mRecords[i].mLocalID))
+		{
+			const LLVOCacheEntry* entry = iter->second;
+			if (i < mNumRecords && iter->first == mRecords[i].mLocalID)
+			{
+				++i;
+			}
+			++iter;
+			if (entry->getDataSize() < 1)
+			{
+				continue;
+			}
+			record.mLocalID = entry->getLocalID();
+			record.mCRC = entry->getCRC();
+			record.mHitCount = entry->getHitCount();
+			record.mDupeCount = entry->getDupeCount();
+			record.mCRCChangeCount = entry->getCRCChangeCount();
+			record.mSize = entry->getDataSize();
+			sources.push_back(entry->getData());
+		}
+		else
+		{
+			record = mRecords[i++];
+			sources.push_back(mFile.getData() + record.mOffset);
+		}
+		record.mOffset = data_size;
+		data_size += record.mSize;
+		records.push_back(record);
+	}
+
+	const size_t data_start = sizeof(Header) + records.size() * sizeof(Record);
+	buffer.resize(data_start + data_size);
+
+	Header* header = (Header*)&buffer[0];
+	memcpy(header->mID, id.mData, UUID_BYTES);
+	header->mNumRecords = records.size();
+
+	Record* out = (Record*)&buffer[sizeof(Header)];
+	for (size_t n = 0; n < records.size(); ++n)
+	{
+		out[n] = records[n];
+		out[n].mOffset += data_start;
+		memcpy(&buffer[out[n].mOffset], sources[n], out[n].mSize);
+	}
 }
 
 //-------------------------------------------------------------------
@@ -240,6 +301,8 @@ const char* object_cache_dirname = "objectcache";
 const char* header_filename = "object.cache";
 
 LLVOCache* LLVOCache::sInstance = NULL;
+// Channels live as long as the job system, so instances after a relog share it.
+S32 LLVOCache::sWriteChannel = LLJobSystem::NO_CHANNEL;
 
 //static 
 LLVOCache* LLVOCache::getInstance() 
@@ -274,10 +337,16 @@ LLVOCache::LLVOCache():
 	mCacheSize(1)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
+	if (sWriteChannel == LLJobSystem::NO_CHANNEL && LLJobSystem::getInstance())
+	{
+		// One at a time, so that writes of the same region land in order.
+		sWriteChannel = LLJobSystem::getInstance()->addChannel("ObjectCacheWrites", LLJobSystem::PRIORITY_LOW, 1);
+	}
 }
 
 LLVOCache::~LLVOCache()
 {
+	waitForWrites();
 	if(mEnabled)
 	{
 		writeCacheHeader();
@@ -342,6 +411,7 @@ void LLVOCache::removeCache(ELLPath location)
 	std::string mask = "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
 	LL_INFOS() << "Removing cache at " << cache_dir << LL_ENDL;
+	waitForWrites();
 	gDirUtilp->deleteFilesInDir(cache_dir, mask); //delete all files
 	LLFile::rmdir(cache_dir);
 
@@ -362,6 +432,7 @@ void LLVOCache::removeCache()
 
 	std::string mask = "*";
 	LL_INFOS() << "Removing cache at " << mObjectCacheDirName << LL_ENDL;
+	waitForWrites();
 	gDirUtilp->deleteFilesInDir(mObjectCacheDirName, mask); 
 
 	clearCacheInMemory() ;
@@ -439,6 +510,7 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 
 	std::string filename;
 	getObjectCacheFilename(entry->mHandle, filename);
+	waitForWrites(entry->mHandle);
 	LLAPRFile::remove(filename);
 	entry->mTime = INVALID_TIME ;
 	updateEntry(entry) ; //update the head file.
@@ -587,7 +659,7 @@ BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
 	return check_write(&apr_file, (void*)entry, sizeof(HeaderEntryInfo)) ;
 }
 
-void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
+void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheFile& cache_file) 
 {
 	if(!mEnabled)
 	{
@@ -603,53 +675,13 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
-	bool success = true ;
-	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_READ|APR_BINARY);
-	
-		LLUUID cache_id ;
-		success = check_read(&apr_file, cache_id.mData, UUID_BYTES) ;
-	
-		if(success)
-		{		
-			if(cache_id != id)
-			{
-				LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
-				success = false ;
-			}
-
-			if(success)
-			{
-				S32 num_entries;
-				success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-	
-				if(success)
-				{
-					for (S32 i = 0; i < num_entries; i++)
-					{
-						LLVOCacheEntry* entry = new LLVOCacheEntry(&apr_file);
-						if (!entry->getLocalID())
-						{
-							LL_WARNS() << "Aborting cache file load for " << filename << ", cache file corruption!" << LL_ENDL;
-							delete entry ;
-							success = false ;
-							break ;
-						}
-						cache_entry_map[entry->getLocalID()] = entry;
-					}
-				}
-			}
-		}		
-	}
-	
-	if(!success)
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	// The region may have been left a moment ago.
+	waitForWrites(handle);
+	if(!cache_file.open(filename, id))
 	{
-		if(cache_entry_map.empty())
-		{
-			removeEntry(iter->second) ;
-		}
+		removeEntry(iter->second) ;
 	}
 
 	return ;
@@ -669,7 +701,8 @@ void LLVOCache::purgeEntries(U32 size)
 	mNumEntries = mHandleEntryMap.size() ;
 }
 
-void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) 
+void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map,
+							 LLVOCacheFile& cache_file, BOOL dirty_cache) 
 {
 	if(!mEnabled)
 	{
@@ -725,34 +758,76 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
-	//write to cache file
-	bool success = true ;
+	//serialize here, since the entries go away with the region, then write
+	//the file in the background.
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	std::shared_ptr<std::vector<U8> > buffer = std::make_shared<std::vector<U8> >();
+	cache_file.write(id, cache_entry_map, *buffer);
+	cache_file.close();
+
+	LLJobSystem* jobs = LLJobSystem::getInstance();
+	if(!jobs || sWriteChannel == LLJobSystem::NO_CHANNEL)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY);
-	
-		success = check_write(&apr_file, (void*)id.mData, UUID_BYTES) ;
+		writeRegionFile(filename, *buffer);
+		return ;
+	}
 
-	
-		if(success)
+	{
+		LLMutexLock lock(mPendingWritesMutex);
+		++mPendingWrites[handle];
+	}
+	jobs->submit(sWriteChannel, [this, handle, filename, buffer]()
 		{
-			S32 num_entries = cache_entry_map.size() ;
-			success = check_write(&apr_file, &num_entries, sizeof(S32));
-	
-			for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
+			writeRegionFile(filename, *buffer);
+			LLMutexLock lock(mPendingWritesMutex);
+			std::map<U64, S32>::iterator iter = mPendingWrites.find(handle);
+			if(iter != mPendingWrites.end() && --iter->second <= 0)
 			{
-				success = iter->second->writeToFile(&apr_file) ;
+				mPendingWrites.erase(iter);
 			}
-		}
+		});
+
+	return ;
+}
+
+//static
+void LLVOCache::writeRegionFile(const std::string& filename, const std::vector<U8>& buffer)
+{
+	// Written aside and renamed, so that a crash never leaves half a file.
+	std::string temp_filename = filename + ".tmp";
+	LLFILE* file = LLFile::fopen(temp_filename, "wb");
+	if(!file)
+	{
+		LL_WARNS() << "Could not open " << temp_filename << " for writing" << LL_ENDL;
+		return ;
 	}
+	bool success = fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+	success = (fclose(file) == 0) && success;
 
+	if(success)
+	{
+		LLFile::remove(filename, ENOENT);
+		success = LLFile::rename(temp_filename, filename) == 0;
+	}
 	if(!success)
 	{
-		removeEntry(entry) ;
-
+		LL_WARNS() << "Failed to write object cache file " << filename << LL_ENDL;
+		LLFile::remove(temp_filename, ENOENT);
 	}
-
-	return ;
 }
 
+void LLVOCache::waitForWrites(U64 handle)
+{
+	while(true)
+	{
+		{
+			LLMutexLock lock(mPendingWritesMutex);
+			if(handle ? !mPendingWrites.count(handle) : mPendingWrites.empty())
+			{
+				return ;
+			}
+		}
+		ms_sleep(1);
+	}
+}
@@ -36,6 +36,8 @@
 #include "lluuid.h"
 #include "lldatapacker.h"
 #include "lldir.h"
+#include "llmappedfile.h"
+#include "llthread.h"
 
 
 //---------------------------------------------------------------------------
@@ -46,17 +48,20 @@ class LLVOCacheEntry
 {
 public:
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLAPRFile* apr_file);
+	// Uses the data where it lies (in a mapped cache file), without copying it.
+	LLVOCacheEntry(U32 local_id, U32 crc, S32 hit_count, S32 dupe_count, S32 crc_change_count, U8* data, S32 size);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
 	U32 getLocalID() const			{ return mLocalID; }
 	U32 getCRC() const				{ return mCRC; }
 	S32 getHitCount() const			{ return mHitCount; }
+	S32 getDupeCount() const		{ return mDupeCount; }
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
+	const U8* getData() const		{ return mDP.getBuffer(); }
+	S32 getDataSize() const			{ return mDP.getBufferSize(); }
 
 	void dump() const;
-	BOOL writeToFile(LLAPRFile* apr_file) const;
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
@@ -72,11 +77,61 @@ protected:
 	S32							mDupeCount;
 	S32							mCRCChangeCount;
 	LLDataPackerBinaryBuffer	mDP;
-	U8							*mBuffer;
+	U8							*mBuffer;	// NULL when mDP points into a mapped cache file
+};
+
+//---------------------------------------------------------------------------
+// A region's object cache file, mapped into memory. The file starts with a
+// table of its objects sorted by local id, so a region with thousands of
+// cached objects opens without reading them; an object's data is only
+// touched when the sim reports it as cached.
+class LLVOCacheFile
+{
+public:
+	struct Header
+	{
+		U8 mID[UUID_BYTES];		// the region's cache id
+		S32 mNumRecords;
+	};
+
+	struct Record
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mOffset;			// of the object's data, from the start of the file
+		S32 mSize;
+	};
+
+	LLVOCacheFile();
+
+	bool open(const std::string& filename, const LLUUID& id);
+	void close();
+
+	bool isOpen() const				{ return mRecords != NULL; }
+	S32 getNumRecords() const		{ return mNumRecords; }
+	const Record* getRecords() const	{ return mRecords; }
+	const Record* find(U32 local_id) const;
+
+	// The entry uses the data in place, so it must not be used after close().
+	LLVOCacheEntry* createEntry(const Record& record) const;
+
+	// Serializes the entries, and the records for which there is no entry,
+	// in the format open() reads.
+	void write(const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map,
+			   std::vector<U8>& buffer) const;
+
+private:
+	LLMappedFile	mFile;
+	const Record*	mRecords;
+	S32				mNumRecords;
 };
 
 //
-//Note: LLVOCache is not thread-safe
+//Note: LLVOCache is not thread-safe. Only the region files are written on
+//the job system, see writeToCache().
 //
 class LLVOCache
 {
@@ -119,8 +174,10 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
-	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
-	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
+	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheFile& cache_file) ;
+	// May close cache_file: entries created from it must not be used afterwards.
+	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map,
+					  LLVOCacheFile& cache_file, BOOL dirty_cache) ;
 	void removeEntry(U64 handle) ;
 
 	void setReadOnly(BOOL read_only) {mReadOnly = read_only;} 
@@ -137,6 +194,10 @@ private:
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
 	BOOL updateEntry(const HeaderEntryInfo* entry);
+	// Blocks until the background writes of the region (or of all regions
+	// when handle is 0) are on disk.
+	void waitForWrites(U64 handle = 0);
+	static void writeRegionFile(const std::string& filename, const std::vector<U8>& buffer);
 	
 private:
 	BOOL                 mEnabled;
@@ -150,7 +211,11 @@ private:
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
 
+	LLMutex              mPendingWritesMutex;
+	std::map<U64, S32>   mPendingWrites;	// number of queued writes per region handle
+
 	static LLVOCache* sInstance ;
+	static S32        sWriteChannel ;
 public:
 	static LLVOCache* getInstance() ;
 	static BOOL       hasInstance() ;	
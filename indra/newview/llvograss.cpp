@@ -270,10 +270,10 @@ U32 LLVOGrass::processUpdateMessage(LLMessageSystem *mesgsys,
 										  void **user_data,
 										  U32 block_num,
 										  const EObjectUpdateType update_type,
-										  LLDataPacker *dp)
+										  const LLDecodedObjectUpdate* update)
 {
 	// Do base class updates...
-	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, dp);
+	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, update);
 
 	updateSpecies();
 
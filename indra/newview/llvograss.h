@@ -55,7 +55,7 @@ public:
 											void **user_data,
 											U32 block_num, 
 											const EObjectUpdateType update_type,
-											LLDataPacker *dp);
+											const LLDecodedObjectUpdate* update);
 	static void import(LLFILE *file, LLMessageSystem *mesgsys, const LLVector3 &pos);
 	/*virtual*/ void exportFile(LLFILE *file, const LLVector3 &position);
 
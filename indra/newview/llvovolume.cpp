@@ -78,6 +78,7 @@
 #include "llmediaentry.h"
 #include "llmediadataclient.h"
 #include "llmeshrepository.h"
+#include "llobjectupdatedecoder.h"
 #include "llagent.h"
 #include "llviewermediafocus.h"
 #include "lldatapacker.h"
@@ -331,13 +332,13 @@ void LLVOVolume::cleanupClass()
 U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 										  void **user_data,
 										  U32 block_num, EObjectUpdateType update_type,
-										  LLDataPacker *dp)
+										  const LLDecodedObjectUpdate* update)
 {
 	LLColor4U color;
 	const S32 teDirtyBits = (TEM_CHANGE_TEXTURE|TEM_CHANGE_COLOR|TEM_CHANGE_MEDIA);
 
 	// Do base class updates...
-	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, dp);
+	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, update);
 
 	LLUUID sculpt_id;
 	U8 sculpt_type = 0;
@@ -348,7 +349,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 		sculpt_type = sculpt_params->getSculptType();
 	}
 
-	if (!dp)
+	if (!update)
 	{
 		if (update_type == OUT_FULL)
 		{
@@ -417,11 +418,15 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 	else
 	{
 		// CORY TO DO: Figure out how to get the value here
-		if (update_type != OUT_TERSE_IMPROVED)
+		if (update_type != OUT_TERSE_IMPROVED && !update->mHasVolume)
 		{
-			LLVolumeParams volume_params;
-			BOOL res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
-			if (!res)
+			// Only updates of volumes carry their shape and faces.
+			LL_WARNS() << "Update of volume " << getID() << " for an object of pcode " << (S32)update->mPCode << LL_ENDL;
+		}
+		else if (update_type != OUT_TERSE_IMPROVED)
+		{
+			LLVolumeParams volume_params = update->mVolumeParams;
+			if (!update->mVolumeParamsValid)
 			{
 				LL_WARNS() << "Bogus volume parameters in object " << getID() << LL_ENDL;
 				LL_WARNS() << getRegion()->getOriginGlobal() << LL_ENDL;
@@ -433,11 +438,12 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			{
 				markForUpdate(TRUE);
 			}
-			S32 res2 = unpackTEMessage(*dp);
-			if (TEM_INVALID == res2)
+			if (!update->mTEValid)
 			{
 				// There's something bogus in the data that we're unpacking.
-				dp->dumpBufferToLog();
+				LLDataPackerBinaryBuffer dp;
+				update->getPacker(dp);
+				dp.dumpBufferToLog();
 				LL_WARNS() << "Flushing cache files" << LL_ENDL;
 
 				if(LLVOCache::hasInstance() && getRegion())
@@ -449,6 +455,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			}
 			else 
 			{
+				S32 res2 = applyParsedTEMessage(*update->mTEContents);
 				if (res2 & teDirtyBits) 
 				{
 					updateTEData();
@@ -459,9 +466,14 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 				}
 			}
 
-			U32 value = dp->getPassFlags();
+			U32 value = update->mSpecialCode;
 
-			if (value & 0x40)
+			if (!update->mTEValid)
+			{
+				// Nothing after the bogus TE data was read: leave the texture
+				// animation as it was.
+			}
+			else if ((value & 0x40) && update->mTextureAnim.mSize)
 			{
 				if (!mTextureAnimp)
 				{
@@ -475,7 +487,9 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 					}
 				}
 				mTexAnimMode = 0;
-				mTextureAnimp->unpackTAMessage(*dp);
+				LLDataPackerBinaryBuffer tadp;
+				update->getPacker(update->mTextureAnim, tadp);
+				mTextureAnimp->unpackTAMessage(tadp);
 			}
 			else if (mTextureAnimp)
 			{
@@ -486,28 +500,24 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 				mTexAnimMode = 0;
 			}
 
-			if (value & 0x400)
+			if ((value & 0x400) && update->mParticles.mSize)
 			{ //particle system (new)
-				unpackParticleSource(*dp, mOwnerID, false);
+				LLDataPackerBinaryBuffer pdp;
+				update->getPacker(update->mParticles, pdp);
+				unpackParticleSource(pdp, mOwnerID, false);
 			}
 		}
-		else
+		else if (update->mTEContents && update->mTEValid)
 		{
-			S32 texture_length = mesgsys->getSizeFast(_PREHASH_ObjectData, block_num, _PREHASH_TextureEntry);
-			if (texture_length)
+			// Unpacked out of the TextureEntry field of the terse update.
+			S32 result = applyParsedTEMessage(*update->mTEContents);
+			if (result & teDirtyBits)
 			{
-				U8							tdpbuffer[1024];
-				LLDataPackerBinaryBuffer	tdp(tdpbuffer, 1024);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_TextureEntry, tdpbuffer, 0, block_num, 1024);
-				S32 result = unpackTEMessage(tdp);
-				if (result & teDirtyBits)
-				{
-					updateTEData();
-				}
-				if (result & TEM_CHANGE_MEDIA)
-				{
-					retval |= MEDIA_FLAGS_CHANGED;
-				}
+				updateTEData();
+			}
+			if (result & TEM_CHANGE_MEDIA)
+			{
+				retval |= MEDIA_FLAGS_CHANGED;
 			}
 		}
 	}
@@ -101,7 +101,7 @@ void LLWind::init()
 }
 
 
-void LLWind::decompress(LLBitPack &bitpack, LLGroupHeader *group_headerp)
+void LLWind::decompress(const LLPatchGroup &group)
 {
 	static const LLCachedControl<bool> wind_enabled("WindEnabled",false); 
 	if (!mCloudDensityp || !wind_enabled)
@@ -109,27 +109,15 @@ void LLWind::decompress(LLBitPack &bitpack, LLGroupHeader *group_headerp)
 		return;
 	}
 
-	LLPatchHeader  patch_header;
-	S32 buffer[16*16];
-
-	init_patch_decompressor(group_headerp->patch_size);
-
-	// Don't use the packed group_header stride because the strides used on
-	// simulator and viewer are not equal.
-	group_headerp->stride = group_headerp->patch_size;	
-	set_group_of_patch_header(group_headerp);
-
-	// X component
-	decode_patch_header(bitpack, &patch_header);
-	decode_patch(bitpack, buffer);
-	decompress_patch(mVelX, buffer, &patch_header);
-
-	// Y component
-	decode_patch_header(bitpack, &patch_header);
-	decode_patch(bitpack, buffer);
-	decompress_patch(mVelY, buffer, &patch_header);
-
-
+	// X then Y component, decoded patch_size wide.
+	if (group.getPatchCount() < 2 || group.mGroupHeader.patch_size != mSize)
+	{
+		LL_WARNS() << "Unexpected wind layer data, " << group.getPatchCount()
+				   << " patches of size " << group.mGroupHeader.patch_size << LL_ENDL;
+		return;
+	}
+	memcpy(mVelX, group.getPatchValues(0), mSize * mSize * sizeof(F32));
+	memcpy(mVelY, group.getPatchValues(1), mSize * mSize * sizeof(F32));
 
 	S32 i, j, k;
 	// HACK -- mCloudVelXY is the same as mVelXY, except we add a divergence
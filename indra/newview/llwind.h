@@ -39,8 +39,7 @@
 #include "v3dmath.h"
 
 class LLVector3;
-class LLBitPack;
-class LLGroupHeader;
+class LLPatchGroup;
 
 
 class LLWind  
@@ -53,7 +52,7 @@ public:
 	LLVector3 getCloudVelocity(const LLVector3 &location); // "location" is region-local
 	LLVector3 getVelocityNoisy(const LLVector3 &location, const F32 dim);	// "location" is region-local
 
-	void decompress(LLBitPack &bitpack, LLGroupHeader *group_headerp);
+	void decompress(const LLPatchGroup &group);
 	LLVector3 getAverage();
 	void setCloudDensityPointer(F32 *densityp);
 
@@ -0,0 +1,302 @@
+/**
+ * @file llinventorycache_bench.cpp
+ * @brief Saving and loading a synthetic inventory cache.
+ *
+ * Usage: llinventorycache_bench [directory] [number of items]
+ *
+ * Builds an inventory of 200k items (by default) in 10k folders, then saves
+ * and loads it three ways: the way LLInventoryModel used to, through a plain
+ * text file that gzip_file() and gunzip_file() convert; with LLInventoryCache,
+ * which streams through zlib and parses on the job system; and with the
+ * binary LLInventoryCacheFile, whose load is timed up to the folder table
+ * (what login waits for) and up to every item being created. Every load must
+ * find every record, and the folder table must count the items of a folder
+ * that holds nothing else.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llinventorycache.h"
+#include "llcommon.h"
+#include "llerrorcontrol.h"
+#include "llfile.h"
+#include "llformat.h"
+#include "llinventory.h"
+#include "lljobsystem.h"
+#include "llsys.h"
+#include "lltimer.h"
+
+#include <iostream>
+
+static const S32 CACHE_VERSION = 2;
+static const S32 ITEMS_PER_FOLDER = 20;
+
+typedef std::vector<LLPointer<LLInventoryCategory> > cat_array_t;
+typedef std::vector<LLPointer<LLInventoryItem> > item_array_t;
+
+class BenchBatch : public LLInventoryCache::Batch
+{
+public:
+	/*virtual*/ void parseRecord(const std::string& keyword, std::istream& input)
+	{
+		if (keyword == "inv_category")
+		{
+			LLPointer<LLInventoryCategory> cat = new LLInventoryCategory;
+			if (cat->importLegacyStream(input))
+			{
+				mCategories.push_back(cat);
+			}
+		}
+		else
+		{
+			LLPointer<LLInventoryItem> item = new LLInventoryItem;
+			if (item->importLegacyStream(input))
+			{
+				mItems.push_back(item);
+			}
+		}
+	}
+
+	cat_array_t mCategories;
+	item_array_t mItems;
+};
+
+// LLInventoryModel::saveToFile() and cache() before LLInventoryCache.
+static void save_legacy(const std::string& filename, const cat_array_t& categories, const item_array_t& items)
+{
+	std::string plain_filename = filename + ".plain";
+	LLFILE* file = LLFile::fopen(plain_filename, "wb");
+	fprintf(file, "\tinv_cache_version\t%d\n", CACHE_VERSION);
+	for (const LLPointer<LLInventoryCategory>& cat : categories)
+	{
+		cat->exportFile(file);
+	}
+	for (const LLPointer<LLInventoryItem>& item : items)
+	{
+		item->exportFile(file);
+	}
+	fclose(file);
+	gzip_file(plain_filename, filename);
+	LLFile::remove(plain_filename);
+}
+
+// LLInventoryModel::loadSkeleton() and loadFromFile() before LLInventoryCache.
+static void load_legacy(const std::string& filename, cat_array_t& categories, item_array_t& items)
+{
+	std::string plain_filename = filename + ".plain";
+	gunzip_file(filename, plain_filename);
+	LLFILE* file = LLFile::fopen(plain_filename, "rb");
+	char buffer[MAX_STRING];
+	char keyword[MAX_STRING];
+	char value[MAX_STRING];
+	while (!feof(file) && fgets(buffer, MAX_STRING, file))
+	{
+		sscanf(buffer, " %126s %126s", keyword, value);
+		if (0 == strcmp("inv_category", keyword))
+		{
+			LLPointer<LLInventoryCategory> cat = new LLInventoryCategory;
+			if (cat->importFile(file))
+			{
+				categories.push_back(cat);
+			}
+		}
+		else if (0 == strcmp("inv_item", keyword))
+		{
+			LLPointer<LLInventoryItem> item = new LLInventoryItem;
+			if (item->importFile(file))
+			{
+				items.push_back(item);
+			}
+		}
+	}
+	fclose(file);
+	LLFile::remove(plain_filename);
+}
+
+static S32 file_size(const std::string& filename)
+{
+	llstat file_status;
+	return LLFile::stat(filename, &file_status) ? 0 : (S32)file_status.st_size;
+}
+
+int main(int argc, char** argv)
+{
+	LLCommon::initClass();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+	LLJobSystem::initClass();
+
+	const std::string dir = argc > 1 ? argv[1] : ".";
+	const S32 num_items = argc > 2 ? atoi(argv[2]) : 200000;
+	const S32 num_folders = llmax(1, num_items / ITEMS_PER_FOLDER);
+	const std::string legacy_filename = dir + "/llinventorycache_bench_legacy.inv.gz";
+	const std::string stream_filename = dir + "/llinventorycache_bench.inv.gz";
+	const std::string binary_filename = dir + "/llinventorycache_bench.inv.bin";
+
+	LLUUID owner;
+	owner.generate();
+	cat_array_t categories;
+	for (S32 i = 0; i < num_folders; ++i)
+	{
+		LLUUID id;
+		id.generate();
+		const LLUUID& parent = i ? categories[(i - 1) / 8]->getUUID() : LLUUID::null;
+		categories.push_back(new LLInventoryCategory(id, parent, LLFolderType::FT_NONE, llformat("Folder %d", i)));
+	}
+	item_array_t items;
+	for (S32 i = 0; i < num_items; ++i)
+	{
+		LLUUID id, asset_id;
+		id.generate();
+		asset_id.generate();
+		LLPermissions perm;
+		perm.init(owner, owner, LLUUID::null, LLUUID::null);
+		perm.initMasks(PERM_ALL, PERM_ALL, PERM_NONE, PERM_NONE, PERM_MOVE | PERM_TRANSFER);
+		items.push_back(new LLInventoryItem(id, categories[i % num_folders]->getUUID(), perm, asset_id,
+											LLAssetType::AT_OBJECT, LLInventoryType::IT_OBJECT,
+											llformat("Object %d", i), "Synthetic item",
+											LLSaleInfo::DEFAULT, 0, 1262304000 + i));
+	}
+
+	LLTimer timer;
+	save_legacy(legacy_filename, categories, items);
+	const F64 legacy_save = timer.getElapsedTimeF64();
+
+	timer.reset();
+	const U32 num_categories = categories.size();
+	LLInventoryCache::write(stream_filename, CACHE_VERSION, num_categories + items.size(),
+		[&](U32 index, std::ostream& output)
+		{
+			if (index < num_categories)
+			{
+				categories[index]->exportLegacyStream(output);
+			}
+			else
+			{
+				items[index - num_categories]->exportLegacyStream(output);
+			}
+		});
+	const F64 stream_save = timer.getElapsedTimeF64();
+
+	// LLInventoryModel::saveToFile() has the items of each folder at hand.
+	std::vector<item_array_t> folder_items(num_folders);
+	for (S32 i = 0; i < num_items; ++i)
+	{
+		folder_items[i % num_folders].push_back(items[i]);
+	}
+	timer.reset();
+	{
+		LLInventoryCacheFile::Writer writer;
+		for (S32 i = 0; i < num_folders; ++i)
+		{
+			writer.addFolder(categories[i]->getUUID(), 1);
+			for (const LLPointer<LLInventoryItem>& item : folder_items[i])
+			{
+				writer.addItem(item);
+			}
+		}
+		writer.write(binary_filename, CACHE_VERSION);
+	}
+	const F64 binary_save = timer.getElapsedTimeF64();
+
+	cat_array_t legacy_categories;
+	item_array_t legacy_items;
+	timer.reset();
+	load_legacy(legacy_filename, legacy_categories, legacy_items);
+	const F64 legacy_load = timer.getElapsedTimeF64();
+
+	std::vector<LLInventoryCache::Batch*> batches;
+	timer.reset();
+	LLInventoryCache::EStatus status =
+		LLInventoryCache::read(stream_filename, CACHE_VERSION, []() { return new BenchBatch; }, batches);
+	const F64 stream_load = timer.getElapsedTimeF64();
+
+	LLInventoryCacheFile binary_file;
+	timer.reset();
+	bool binary_ok = binary_file.open(binary_filename, CACHE_VERSION);
+	const F64 binary_open = timer.getElapsedTimeF64();
+	item_array_t binary_items;
+	size_t binary_folders = 0;
+	for (U32 i = 0; binary_ok && i < binary_file.getNumFolders(); ++i)
+	{
+		const LLInventoryCacheFile::Folder& folder = binary_file.getFolders()[i];
+		const LLInventoryCacheFile::Item* records = binary_file.getItems(folder);
+		for (U32 j = 0; j < folder.mNumItems; ++j)
+		{
+			LLPointer<LLInventoryItem> item = new LLInventoryItem;
+			binary_file.importItem(records[j], item);
+			binary_items.push_back(item);
+		}
+		++binary_folders;
+	}
+	const F64 binary_load = timer.getElapsedTimeF64();
+	binary_ok = binary_ok && binary_file.findItem(items.back()->getUUID()) != NULL;
+	// The last folder holds items and no folders. When its version matches,
+	// LLInventoryModel leaves it pending, and categoryHasChildren() answers
+	// from the item count of its folder table entry, with no item created.
+	const LLInventoryCacheFile::Folder* leaf = binary_ok ? binary_file.findFolder(categories.back()->getUUID()) : NULL;
+	const bool leaf_ok = !num_items || (leaf && leaf->mNumItems > 0 && leaf->mNumItems == folder_items.back().size());
+	if (!leaf_ok)
+	{
+		std::cerr << "A folder holding only items has no items in the folder table" << std::endl;
+	}
+	binary_file.close();
+
+	size_t stream_categories = 0;
+	size_t stream_items = 0;
+	for (LLInventoryCache::Batch* batch : batches)
+	{
+		stream_categories += ((BenchBatch*)batch)->mCategories.size();
+		stream_items += ((BenchBatch*)batch)->mItems.size();
+		delete batch;
+	}
+
+	std::cout << llformat("%d folders, %d items on %u workers", num_folders, num_items,
+						  LLJobSystem::getInstance()->getNumWorkers()) << std::endl;
+	std::cout << llformat("save: legacy %.3fs | streamed %.3fs | binary %.3fs",
+						  legacy_save, stream_save, binary_save) << std::endl;
+	std::cout << llformat("load: legacy %.3fs | streamed %.3fs | binary %.3fs, folder table %.4fs",
+						  legacy_load, stream_load, binary_load, binary_open) << std::endl;
+	std::cout << llformat("file size: legacy %d | streamed %d | binary %d bytes",
+						  file_size(legacy_filename), file_size(stream_filename),
+						  file_size(binary_filename)) << std::endl;
+
+	bool ok = status == LLInventoryCache::CACHE_OK && binary_ok && leaf_ok &&
+			  legacy_categories.size() == categories.size() && legacy_items.size() == items.size() &&
+			  stream_categories == categories.size() && stream_items == items.size() &&
+			  binary_folders == categories.size() && binary_items.size() == items.size();
+	if (!ok)
+	{
+		std::cerr << "Record counts differ: legacy " << legacy_categories.size() << "/" << legacy_items.size()
+				  << ", streamed " << stream_categories << "/" << stream_items
+				  << ", binary " << binary_folders << "/" << binary_items.size() << std::endl;
+	}
+
+	LLFile::remove(legacy_filename);
+	LLFile::remove(stream_filename);
+	LLFile::remove(binary_filename);
+	LLJobSystem::cleanupClass();
+	LLCommon::cleanupClass();
+	return ok ? 0 : 1;
+}
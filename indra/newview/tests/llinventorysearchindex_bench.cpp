@@ -0,0 +1,165 @@
+/**
+ * @file llinventorysearchindex_bench.cpp
+ * @brief Looking filter strings up in a synthetic inventory.
+ *
+ * Usage: llinventorysearchindex_bench [number of items]
+ *
+ * Builds an inventory of 100k items (by default) in folders of 20, then types
+ * a few search strings into it one key at a time, the way the inventory
+ * search box is used. Every prefix is matched the way LLFolderViewItem did it,
+ * by searching every upper case label, and with LLInventorySearchIndex; both
+ * must find the same objects. Renaming a tenth of the items then times
+ * keeping the index up to date.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llinventorysearchindex.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "llstring.h"
+#include "lltimer.h"
+
+#include <algorithm>
+#include <iostream>
+
+static const S32 ITEMS_PER_FOLDER = 20;
+
+static const char* const ADJECTIVES[] =
+{
+	"Red", "Blue", "Black", "White", "Leather", "Silk", "Denim", "Wooden", "Glass", "Mesh",
+	"Rigged", "Old", "New", "Fancy", "Plain", "Long", "Short", "Summer", "Winter", "Gothic"
+};
+static const char* const NOUNS[] =
+{
+	"Shirt", "Pants", "Boots", "Hat", "Jacket", "Dress", "Chair", "Table", "Lamp", "Hair",
+	"Skin", "Shape", "Eyes", "Gloves", "Skirt", "Sofa", "House", "Tree", "Sword", "Pose"
+};
+static const char* const SEARCHES[] = { "shirt", "red hat 1", "mesh", "zz", "gothic dress 42" };
+
+struct Object
+{
+	LLUUID mID;
+	std::string mName;
+	std::string mSearchable;	// LLFolderViewItem::mSearchableLabel
+};
+
+static void set_name(Object& object, const std::string& name)
+{
+	object.mName = name;
+	object.mSearchable = name;
+	LLStringUtil::toUpper(object.mSearchable);
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 num_items = argc > 1 ? atoi(argv[1]) : 100000;
+	const S32 num_folders = llmax(1, num_items / ITEMS_PER_FOLDER);
+	const S32 num_adjectives = LL_ARRAY_SIZE(ADJECTIVES);
+	const S32 num_nouns = LL_ARRAY_SIZE(NOUNS);
+
+	std::vector<Object> objects(num_folders + num_items);
+	for (S32 i = 0; i < (S32)objects.size(); ++i)
+	{
+		objects[i].mID.generate();
+		if (i < num_folders)
+		{
+			set_name(objects[i], llformat("%s Folder %d", NOUNS[i % num_nouns], i));
+		}
+		else
+		{
+			set_name(objects[i], llformat("%s %s %d", ADJECTIVES[i % num_adjectives],
+										  NOUNS[(i / num_adjectives) % num_nouns], i % 1000));
+		}
+	}
+
+	LLTimer timer;
+	LLInventorySearchIndex index;
+	for (const Object& object : objects)
+	{
+		index.add(object.mID, object.mName);
+	}
+	const F64 build_time = timer.getElapsedTimeF64();
+
+	bool ok = true;
+	F64 scan_time = 0.0;
+	F64 index_time = 0.0;
+	S32 lookups = 0;
+	for (const char* search : SEARCHES)
+	{
+		std::string typed(search);
+		LLStringUtil::toUpper(typed);
+		for (size_t length = 1; length <= typed.size(); ++length)
+		{
+			const std::string substring = typed.substr(0, length);
+
+			timer.reset();
+			size_t scan_matches = 0;
+			for (const Object& object : objects)
+			{
+				if (object.mSearchable.find(substring) != std::string::npos)
+				{
+					++scan_matches;
+				}
+			}
+			scan_time += timer.getElapsedTimeF64();
+
+			timer.reset();
+			std::vector<bool> matches;
+			index.find(substring, matches);
+			index_time += timer.getElapsedTimeF64();
+
+			++lookups;
+			const size_t index_matches = std::count(matches.begin(), matches.end(), true);
+			if (index_matches != scan_matches)
+			{
+				std::cerr << "\"" << substring << "\": " << scan_matches << " names hold it, the index found "
+						  << index_matches << std::endl;
+				ok = false;
+			}
+		}
+	}
+
+	timer.reset();
+	for (S32 i = num_folders; i < (S32)objects.size(); i += 10)
+	{
+		set_name(objects[i], llformat("Renamed %s %d", NOUNS[i % num_nouns], i));
+		index.add(objects[i].mID, objects[i].mName);
+	}
+	const F64 rename_time = timer.getElapsedTimeF64();
+
+	std::vector<bool> renamed;
+	index.find("RENAMED", renamed);
+	ok = ok && std::count(renamed.begin(), renamed.end(), true) == (num_items + 9) / 10;
+
+	std::cout << llformat("%d folders, %d items, indexed in %.3fs", num_folders, num_items, build_time) << std::endl;
+	std::cout << llformat("%d keystrokes: every label %.2fms | index %.2fms per keystroke",
+						  lookups, scan_time * 1000.0 / lookups, index_time * 1000.0 / lookups) << std::endl;
+	std::cout << llformat("%d renames: %.3fs", (num_items + 9) / 10, rename_time) << std::endl;
+
+	return ok ? 0 : 1;
+}
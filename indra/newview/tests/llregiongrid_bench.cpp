@@ -0,0 +1,159 @@
+/**
+ * @file llregiongrid_bench.cpp
+ * @brief Finding the map objects under the net map, by scanning and with LLRegionGrid.
+ *
+ * Usage: llregiongrid_bench [number of objects] [frames]
+ *
+ * Scatters 20k objects (by default) over a region, as in a dense sim, then
+ * looks for those under object layers of the net map of several sizes, the
+ * way renderObjectsForMap() did by testing every map object and the way it
+ * does with the grid of the region. Both must find the same objects. Every
+ * frame a tenth of the objects also move, the way vehicles and scripted
+ * objects do, which times keeping the grid up to date.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llregiongrid.h"
+#include "llerrorcontrol.h"
+#include "llformat.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+#include <iostream>
+
+static const F32 REGION_WIDTH = 256.f;
+static const F32 RADII[] = { 16.f, 32.f, 64.f, 128.f };
+
+struct Object
+{
+	LLVector3 mPosition;
+	LLRegionGrid<Object>::Slot mSlot;
+};
+
+struct Counter
+{
+	Counter(const LLVector3& center, F32 radius) : mCenter(center), mRadius(radius), mCount(0) {}
+
+	// renderPoint() drops the objects outside the object layer.
+	void operator()(const Object* object)
+	{
+		if (fabsf(object->mPosition.mV[VX] - mCenter.mV[VX]) < mRadius &&
+			fabsf(object->mPosition.mV[VY] - mCenter.mV[VY]) < mRadius)
+		{
+			++mCount;
+		}
+	}
+
+	LLVector3 mCenter;
+	F32 mRadius;
+	S32 mCount;
+};
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	const S32 num_objects = argc > 1 ? atoi(argv[1]) : 20000;
+	const S32 frames = argc > 2 ? atoi(argv[2]) : 200;
+	const S32 num_radii = sizeof(RADII) / sizeof(RADII[0]);
+
+	std::vector<Object> objects(num_objects);
+	LLRegionGrid<Object> grid(REGION_WIDTH);
+	for (Object& object : objects)
+	{
+		object.mPosition.set(ll_frand(REGION_WIDTH), ll_frand(REGION_WIDTH), ll_frand(REGION_WIDTH));
+		grid.update(&object, object.mPosition, object.mSlot);
+	}
+
+	bool ok = true;
+	F64 move_time = 0.0;
+	std::vector<F64> scan_times(num_radii, 0.0);
+	std::vector<F64> grid_times(num_radii, 0.0);
+	std::vector<S32> found(num_radii, 0);
+	LLTimer timer;
+	for (S32 frame = 0; frame < frames; ++frame)
+	{
+		timer.reset();
+		for (S32 i = frame % 10; i < num_objects; i += 10)
+		{
+			Object& object = objects[i];
+			object.mPosition.mV[VX] = llclamp(object.mPosition.mV[VX] + ll_frand(8.f) - 4.f, -2.f, REGION_WIDTH + 2.f);
+			object.mPosition.mV[VY] = llclamp(object.mPosition.mV[VY] + ll_frand(8.f) - 4.f, -2.f, REGION_WIDTH + 2.f);
+			grid.update(&object, object.mPosition, object.mSlot);
+		}
+		move_time += timer.getElapsedTimeF64();
+
+		const LLVector3 center(ll_frand(REGION_WIDTH), ll_frand(REGION_WIDTH), 0.f);
+		for (S32 r = 0; r < num_radii; ++r)
+		{
+			const F32 radius = RADII[r];
+
+			timer.reset();
+			Counter scanned(center, radius);
+			for (const Object& object : objects)
+			{
+				scanned(&object);
+			}
+			scan_times[r] += timer.getElapsedTimeF64();
+
+			timer.reset();
+			Counter near(center, radius);
+			grid.forEachNear(center.mV[VX] - radius, center.mV[VY] - radius,
+							 center.mV[VX] + radius, center.mV[VY] + radius, near);
+			grid_times[r] += timer.getElapsedTimeF64();
+
+			found[r] += near.mCount;
+			if (near.mCount != scanned.mCount)
+			{
+				std::cerr << llformat("Radius %.0fm: %d objects under the map, the grid found %d",
+									  radius, scanned.mCount, near.mCount) << std::endl;
+				ok = false;
+			}
+		}
+	}
+
+	// Taking every object out leaves the grid empty.
+	for (S32 i = num_objects - 1; i >= 0; --i)
+	{
+		LLRegionGrid<Object>::remove(objects[i].mSlot);
+	}
+	if (grid.size())
+	{
+		std::cerr << grid.size() << " objects left in the grid" << std::endl;
+		ok = false;
+	}
+
+	std::cout << llformat("%d objects, %d frames, moving %d objects a frame: %.3fms a frame", num_objects, frames,
+						  num_objects / 10, move_time * 1000.0 / frames) << std::endl;
+	for (S32 r = 0; r < num_radii; ++r)
+	{
+		std::cout << llformat("radius %3.0fm, %5d objects: scan %.3fms, grid %.3fms | %5.1fx", RADII[r],
+							  found[r] / frames, scan_times[r] * 1000.0 / frames, grid_times[r] * 1000.0 / frames,
+							  scan_times[r] / grid_times[r]) << std::endl;
+	}
+
+	return ok ? 0 : 1;
+}
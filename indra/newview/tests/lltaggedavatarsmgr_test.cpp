@@ -0,0 +1,145 @@
+/**
+ * @file lltaggedavatarsmgr_test.cpp
+ * @brief LLTaggedAvatarsMgr contact set index tests and lookup benchmark
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../lltaggedavatarsmgr.h"
+#include "llsqlmgr.h"
+#include "lltimer.h"
+
+#include <atomic>
+#include <iostream>
+#include <new>
+
+//----------------------------------------------------------------------------
+// Global allocation counter, so the benchmark can prove that index lookups
+// never hit the heap.
+
+static std::atomic<U64> sAllocations(0);
+
+void* operator new(size_t size)
+{
+	++sAllocations;
+	if (void* p = malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+//----------------------------------------------------------------------------
+
+namespace tut
+{
+	static const S32 NUM_TAGGED_AVATARS = 10000;
+
+	struct taggedavatarsmgr
+	{
+		taggedavatarsmgr()
+		{
+			LLSqlMgr::instance().initAgentDB(":memory:");
+			LLTaggedAvatarsMgr::instance().init();
+		}
+		~taggedavatarsmgr()
+		{
+			LLSqlMgr::instance().close();
+		}
+	};
+
+	typedef test_group<taggedavatarsmgr> taggedavatarsmgr_t;
+	typedef taggedavatarsmgr_t::object taggedavatarsmgr_object_t;
+	tut::taggedavatarsmgr_t tut_taggedavatarsmgr("LLTaggedAvatarsMgr");
+
+	// The index is coherent with the write-through mutators.
+	template<> template<>
+	void taggedavatarsmgr_object_t::test<1>()
+	{
+		LLTaggedAvatarsMgr& mgr = LLTaggedAvatarsMgr::instance();
+		LLUUID avatar;
+		avatar.generate();
+
+		ensure("untagged avatar has no contact set", mgr.getAvatarContactSetName(avatar).empty());
+
+		mgr.updateContactSet(avatar.asString(), "Contact set 1", "Test Resident");
+		ensure_equals("contact set id", mgr.getAvatarContactSetId(avatar), std::string("Contact set 1"));
+		ensure_equals("contact set name", mgr.getAvatarContactSetName(avatar), std::string("Contact set 1"));
+		ensure("contact set color", mgr.getAvatarColorContactSet(avatar) == LLColor4(1.f, 0.f, 0.f, 1.f));
+
+		mgr.updateContactSetName("Contact set 1", "Friends");
+		mgr.updateColorContactSet("Contact set 1", LLColor4(0.f, 0.5f, 0.f, 1.f));
+		ensure_equals("renamed contact set", mgr.getAvatarContactSetName(avatar), std::string("Friends"));
+		ensure("recolored contact set", mgr.getAvatarColorContactSet(avatar) == LLColor4(0.f, 0.5f, 0.f, 1.f));
+
+		// A reload from the DB must give back exactly what was written through.
+		mgr.init();
+		ensure_equals("reloaded contact set name", mgr.getAvatarContactSetName(avatar), std::string("Friends"));
+
+		// An existing ID is refused, as the DB refuses it.
+		mgr.insertContactSet("Contact set 2", "Duplicate");
+		ensure_equals("duplicate contact set", mgr.getContactSetName("Contact set 2"), std::string("Contact set 2"));
+		mgr.init();
+		ensure_equals("duplicate contact set after reload", mgr.getContactSetName("Contact set 2"), std::string("Contact set 2"));
+
+		mgr.deleteContactSet("Contact set 1");
+		ensure("deleted contact set", mgr.getAvatarContactSetId(avatar).empty());
+		mgr.init();
+		ensure("deleted contact set after reload", mgr.getAvatarContactSetId(avatar).empty());
+	}
+
+	// Lookup benchmark with 10k tagged avatars: no allocation per lookup.
+	template<> template<>
+	void taggedavatarsmgr_object_t::test<2>()
+	{
+		LLTaggedAvatarsMgr& mgr = LLTaggedAvatarsMgr::instance();
+		std::vector<LLUUID> avatars(NUM_TAGGED_AVATARS * 2);
+		for (S32 i = 0; i < (S32)avatars.size(); ++i)
+		{
+			avatars[i].generate();
+			// Only every other avatar is tagged, so misses are measured too.
+			if (i & 1)
+			{
+				mgr.updateContactSet(avatars[i].asString(), (i & 2) ? "Contact set 2" : "Contact set 3", "Resident");
+			}
+		}
+
+		const S32 passes = 50;
+		size_t tagged = 0;
+		LLTimer timer;
+		const U64 allocations = sAllocations;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (const LLUUID& id : avatars)
+			{
+				const std::string& name = mgr.getAvatarContactSetName(id);
+				if (!name.empty())
+				{
+					LLColor4 color = mgr.getAvatarColorContactSet(id);
+					tagged += mgr.getAvatarContactSetId(id).size() + (color.mV[VALPHA] > 0.f);
+				}
+			}
+		}
+		const F64 elapsed = timer.getElapsedTimeF64();
+		const U64 lookup_allocations = sAllocations - allocations;
+
+		const F64 lookups = (F64)passes * avatars.size();
+		std::cout << "\nLLTaggedAvatarsMgr: " << lookups << " lookups over " << NUM_TAGGED_AVATARS
+				  << " tagged avatars in " << elapsed * 1000.0 << " ms ("
+				  << elapsed * 1.0e9 / lookups << " ns/lookup), "
+				  << lookup_allocations << " allocations" << std::endl;
+
+		ensure("tagged avatars found", tagged > 0);
+		ensure_equals("allocations during lookups", lookup_allocations, (U64)0);
+	}
+}
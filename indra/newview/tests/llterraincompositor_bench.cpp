@@ -0,0 +1,267 @@
+/**
+ * @file llterraincompositor_bench.cpp
+ * @brief Terrain compositing throughput over synthetic height and detail data.
+ *
+ * Usage: llterraincompositor_bench [terrain texture size]
+ *
+ * Composites every patch of a synthetic 256m region with the scalar loop
+ * LLVLComposition::generateTexture() used to run, then with
+ * LLTerrainCompositeJob inline and through LLTerrainCompositeThread, and
+ * checks that all of them produce the same texels.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llterraincompositor.h"
+#include "llerrorcontrol.h"
+#include "llmath.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+#include <iostream>
+
+static const S32 REGION_WIDTH = 256;	// composition values, one per meter
+static const S32 PATCH_WIDTH = 16;		// meters
+static const S32 DETAIL_SIZE = 128;		// LLVLComposition's BASE_SIZE
+static const F32 TEX_SCALE = 16.f;		// LLVLComposition::mTexScaleX/Y defaults
+
+struct Region
+{
+	std::vector<F32> mComposition;
+	LLPointer<LLImageRaw> mDetails[LLTerrainCompositeJob::DETAIL_COUNT];
+	S32 mTexSize;
+};
+
+struct Patch
+{
+	S32 mTexXBegin, mTexYBegin, mTexXEnd, mTexYEnd;
+	F32 mTexRatio, mSTStride;
+};
+
+static Patch get_patch(const Region& region, S32 px, S32 py)
+{
+	// Same arithmetic as LLVLComposition::generateTexture(), with a scale of 1.
+	const F32 tex_scalef = (F32)region.mTexSize / (F32)REGION_WIDTH;
+	Patch patch;
+	patch.mTexXBegin = (S32)((F32)(px * PATCH_WIDTH) * tex_scalef);
+	patch.mTexYBegin = (S32)((F32)(py * PATCH_WIDTH) * tex_scalef);
+	patch.mTexXEnd = (S32)((F32)((px + 1) * PATCH_WIDTH) * tex_scalef);
+	patch.mTexYEnd = (S32)((F32)((py + 1) * PATCH_WIDTH) * tex_scalef);
+	patch.mTexRatio = (F32)REGION_WIDTH / (F32)region.mTexSize;
+	patch.mSTStride = ((F32)DETAIL_SIZE / TEX_SCALE)*((F32)REGION_WIDTH / (F32)region.mTexSize);
+	return patch;
+}
+
+static LLPointer<LLTerrainCompositeJob> make_job(const Region& region, const Patch& patch)
+{
+	return new LLTerrainCompositeJob(region.mDetails, DETAIL_SIZE, &region.mComposition[0], REGION_WIDTH, 1.f,
+									 region.mTexSize, region.mTexSize,
+									 patch.mTexXBegin, patch.mTexYBegin, patch.mTexXEnd, patch.mTexYEnd,
+									 patch.mTexRatio, patch.mTexRatio, patch.mSTStride, patch.mSTStride);
+}
+
+// LLViewerLayer::getValueScaled() with a scale of 1.
+static F32 get_value_scaled(const Region& region, F32 x, F32 y)
+{
+	S32 x1 = llfloor(x), y1 = llfloor(y);
+	F32 x_frac = x - x1, y_frac = y - y1;
+	S32 x2 = llclamp(x1 + 1, 0, REGION_WIDTH - 1), y2 = llclamp(y1 + 1, 0, REGION_WIDTH - 1);
+	x1 = llclamp(x1, 0, REGION_WIDTH - 1);
+	y1 = llclamp(y1, 0, REGION_WIDTH - 1);
+	const F32* data = &region.mComposition[0];
+	F32 row1_left = data[y1 * REGION_WIDTH + x1], row1_right = data[y1 * REGION_WIDTH + x2];
+	F32 row2_left = data[y2 * REGION_WIDTH + x1], row2_right = data[y2 * REGION_WIDTH + x2];
+	F32 row1_interp = row1_left - x_frac * (row1_left - row1_right);
+	F32 row2_interp = row2_left - x_frac * (row2_left - row2_right);
+	return row1_interp - y_frac * (row1_interp - row2_interp);
+}
+
+// The per texel loop LLVLComposition::generateTexture() used to run on the main thread.
+static void composite_reference(const Region& region, const Patch& patch, U8* rawp)
+{
+	const U32 comps = 3, st_width = DETAIL_SIZE, st_height = DETAIL_SIZE;
+	const U32 tex_stride = region.mTexSize * comps;
+	const S32 st_data_size = region.mDetails[0]->getDataSize();
+	F32 sti, stj = (patch.mTexYBegin * patch.mSTStride) - st_height*(llfloor((patch.mTexYBegin * patch.mSTStride)/st_height));
+	for (S32 j = patch.mTexYBegin; j < patch.mTexYEnd; j++)
+	{
+		U32 offset = j * tex_stride + patch.mTexXBegin * comps;
+		sti = (patch.mTexXBegin * patch.mSTStride) - st_width*((U32)(patch.mTexXBegin * patch.mSTStride)/st_width);
+		for (S32 i = patch.mTexXBegin; i < patch.mTexXEnd; i++)
+		{
+			F32 composition = get_value_scaled(region, i*patch.mTexRatio, j*patch.mTexRatio);
+			S32 tex0 = llclamp(llfloor(composition), 0, 3);
+			composition -= tex0;
+			S32 tex1 = llclamp(tex0 + 1, 0, 3);
+			S32 st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * comps;
+			for (U32 k = 0; k < comps; k++, offset++, st_offset++)
+			{
+				if (st_offset < st_data_size)
+				{
+					F32 a = region.mDetails[tex0]->getData()[st_offset];
+					F32 b = region.mDetails[tex1]->getData()[st_offset];
+					rawp[offset] = (U8)lltrunc( a + composition * (b - a) );
+				}
+			}
+			sti += patch.mSTStride;
+			if (sti >= st_width) sti -= st_width;
+		}
+		stj += patch.mSTStride;
+		if (stj >= st_height) stj -= st_height;
+	}
+}
+
+// Compares the patch rectangle of the whole texture 'reference' with the job's result.
+static bool same_texels(const Region& region, const Patch& patch, const U8* reference, const LLImageRaw* result)
+{
+	if (!result)
+	{
+		return false;
+	}
+	const U32 width = (patch.mTexXEnd - patch.mTexXBegin) * 3;
+	for (S32 j = patch.mTexYBegin; j < patch.mTexYEnd; j++)
+	{
+		const U32 offset = (j * region.mTexSize + patch.mTexXBegin) * 3;
+		if (memcmp(reference + offset, result->getData() + (j - patch.mTexYBegin) * width, width))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	Region region;
+	region.mTexSize = argc > 1 ? atoi(argv[1]) : 256;
+	if (region.mTexSize < PATCH_WIDTH || region.mTexSize > 4096)
+	{
+		std::cerr << "Usage: " << argv[0] << " [terrain texture size, 16 to 4096]" << std::endl;
+		return 1;
+	}
+
+	// Rolling hills across all four detail textures, and noisy details.
+	srand(1);
+	region.mComposition.resize(REGION_WIDTH * REGION_WIDTH);
+	for (S32 y = 0; y < REGION_WIDTH; y++)
+	{
+		for (S32 x = 0; x < REGION_WIDTH; x++)
+		{
+			F32 height = 1.5f + 1.2f * sinf(x * 0.05f) * cosf(y * 0.07f) + 0.3f * ll_frand();
+			region.mComposition[y * REGION_WIDTH + x] = llclamp(height, 0.f, 3.f);
+		}
+	}
+	for (S32 i = 0; i < LLTerrainCompositeJob::DETAIL_COUNT; i++)
+	{
+		region.mDetails[i] = new LLImageRaw(DETAIL_SIZE, DETAIL_SIZE, 3);
+		U8* data = region.mDetails[i]->getData();
+		for (S32 k = 0; k < region.mDetails[i]->getDataSize(); k++)
+		{
+			data[k] = (U8)(rand() & 0xFF);
+		}
+	}
+
+	const S32 patches_per_edge = REGION_WIDTH / PATCH_WIDTH;
+	const S32 patch_count = patches_per_edge * patches_per_edge;
+	std::vector<Patch> patches;
+	for (S32 py = 0; py < patches_per_edge; py++)
+	{
+		for (S32 px = 0; px < patches_per_edge; px++)
+		{
+			patches.push_back(get_patch(region, px, py));
+		}
+	}
+	const F64 texels = (F64)region.mTexSize * region.mTexSize;
+	std::cout << patch_count << " patches, " << region.mTexSize << "x" << region.mTexSize << " terrain texture" << std::endl;
+
+	// Scalar reference, as the main thread used to do it.
+	LLPointer<LLImageRaw> reference = new LLImageRaw(region.mTexSize, region.mTexSize, 3);
+	LLTimer timer;
+	for (const Patch& patch : patches)
+	{
+		composite_reference(region, patch, reference->getData());
+	}
+	const F64 scalar_time = timer.getElapsedTimeF64();
+	std::cout << llformat("scalar reference: %8.2f ms/region, %7.1f Mtexels/s",
+						  scalar_time * 1000.0, texels / scalar_time / 1.0e6) << std::endl;
+
+	// SIMD kernel, inline.
+	std::vector<LLPointer<LLTerrainCompositeJob> > jobs;
+	for (const Patch& patch : patches)
+	{
+		jobs.push_back(make_job(region, patch));
+	}
+	timer.reset();
+	for (auto& job : jobs)
+	{
+		job->composite();
+	}
+	const F64 simd_time = timer.getElapsedTimeF64();
+	bool identical = true;
+	for (S32 i = 0; i < patch_count; i++)
+	{
+		identical &= same_texels(region, patches[i], reference->getData(), jobs[i]->getRawImage());
+	}
+	std::cout << llformat("SIMD kernel:      %8.2f ms/region, %7.1f Mtexels/s, speedup %.2fx, %s",
+						  simd_time * 1000.0, texels / simd_time / 1.0e6, scalar_time / simd_time,
+						  identical ? "identical" : "DIFFERENT") << std::endl;
+
+	// Through the compositing thread: what the main thread still pays is
+	// building and submitting the jobs.
+	LLTerrainCompositeThread::initClass(true);
+	jobs.clear();
+	timer.reset();
+	F64 main_thread_time = 0.0;
+	for (const Patch& patch : patches)
+	{
+		LLTimer submit_timer;
+		LLPointer<LLTerrainCompositeJob> job = make_job(region, patch);
+		LLTerrainCompositeThread::sLocal->composite(job);
+		jobs.push_back(job);
+		main_thread_time += submit_timer.getElapsedTimeF64();
+	}
+	for (auto& job : jobs)
+	{
+		while (!job->isDone())
+		{
+			ms_sleep(0);
+		}
+	}
+	const F64 threaded_time = timer.getElapsedTimeF64();
+	bool threaded_identical = true;
+	for (S32 i = 0; i < patch_count; i++)
+	{
+		threaded_identical &= same_texels(region, patches[i], reference->getData(), jobs[i]->getRawImage());
+	}
+	std::cout << llformat("threaded:         %8.2f ms/region, main thread %.3f ms (%.1f us/patch), %s",
+						  threaded_time * 1000.0, main_thread_time * 1000.0, main_thread_time * 1.0e6 / patch_count,
+						  threaded_identical ? "identical" : "DIFFERENT") << std::endl;
+	jobs.clear();
+	LLTerrainCompositeThread::cleanupClass();
+
+	return identical && threaded_identical ? 0 : 1;
+}